@@ -1321,6 +1321,14 @@ typedef struct _DMF_PORTABLE_EVENT
 #endif // defined(DMF_USER_MODE)
 } DMF_PORTABLE_EVENT;
 
+#if defined(DMF_USER_MODE)
+// Cache of recycled buffers used by a User-mode lookaside list.
+// It is allocated separately because memory objects created from the list
+// may outlive the object that owns the list.
+//
+typedef struct _DMF_PORTABLE_LOOKASIDELIST_CACHE DMF_PORTABLE_LOOKASIDELIST_CACHE;
+#endif // defined(DMF_USER_MODE)
+
 typedef struct _DMF_PORTABLE_LOOKASIDELIST
 {
 #if defined(DMF_USER_MODE)
@@ -1328,24 +1336,73 @@ typedef struct _DMF_PORTABLE_LOOKASIDELIST
     POOL_TYPE PoolType;
     ULONG PoolTag;
     size_t BufferSize;
+    // Object that represents the lookaside list. Deleting it (or its parent)
+    // releases all the cached buffers.
+    //
+    WDFOBJECT WdflookasideList;
+    DMF_PORTABLE_LOOKASIDELIST_CACHE* Cache;
 #else
     WDFLOOKASIDE WdflookasideList;
 #endif // defined(DMF_USER_MODE)
 } DMF_PORTABLE_LOOKASIDELIST;
 
+// Usage statistics of a lookaside list.
+//
+typedef struct _DMF_PORTABLE_LOOKASIDELIST_STATISTICS
+{
+    // Number of memory objects created from the list.
+    //
+    ULONG TotalAllocates;
+    // Number of memory objects whose buffer came from the cache.
+    //
+    ULONG AllocateHits;
+    // Number of memory objects whose buffer had to be allocated.
+    //
+    ULONG AllocateMisses;
+    // Number of memory objects deleted.
+    //
+    ULONG TotalFrees;
+    // Number of buffers returned to the cache when memory objects are deleted.
+    //
+    ULONG FreeHits;
+    // Number of buffers freed because the cache was full.
+    //
+    ULONG FreeMisses;
+    // Current maximum number of buffers the cache holds.
+    //
+    ULONG Depth;
+    // Number of buffers currently in the cache.
+    //
+    ULONG CachedBuffers;
+} DMF_PORTABLE_LOOKASIDELIST_STATISTICS;
+
 typedef struct _DMF_PORTABLE_RUNDOWN
 {
 #if !defined(DMF_USER_MODE)
     EX_RUNDOWN_REF RundownRef;
 #else
-    // TODO: Equivalent code will go here. Change is pending.
-    //       Until then, Client must implement another solution
-    //       in User-mode.
+    // Bit 0 indicates rundown is in progress. The remaining bits hold the
+    // number of references (same layout as EX_RUNDOWN_REF in Kernel-mode).
     //
-    ULONG PlaceHolder;
+    volatile LONG Count;
 #endif // !defined(DMF_USER_MODE)
 } DMF_PORTABLE_RUNDOWN_REF;
 
+// One-shot completion that a thread waits on until another thread signals it.
+// It needs no allocation or cleanup so it can be on the stack of the thread that waits.
+// In Kernel-mode it must be in nonpaged memory (not in memory allocated from paged pool).
+//
+typedef struct _DMF_PORTABLE_COMPLETION
+{
+#if !defined(DMF_USER_MODE)
+    KEVENT Event;
+#else
+    // Set to non-zero when the completion is signaled.
+    //
+    volatile LONG Signaled;
+#endif // !defined(DMF_USER_MODE)
+} DMF_PORTABLE_COMPLETION;
+
 // Definitions used to determine OS version to determine
 // availability of some OS features.
 //
@@ -1430,6 +1487,19 @@ DMF_Portable_LookasideListCreateMemory(
     _Out_ WDFMEMORY* Memory
     );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Portable_LookasideListDelete(
+    _Inout_ DMF_PORTABLE_LOOKASIDELIST* LookasidePointer
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+DMF_Portable_LookasideListStatisticsGet(
+    _In_ DMF_PORTABLE_LOOKASIDELIST* LookasidePointer,
+    _Out_ DMF_PORTABLE_LOOKASIDELIST_STATISTICS* Statistics
+    );
+
 VOID
 DMF_Portable_Rundown_Initialize(
     _Inout_ DMF_PORTABLE_RUNDOWN_REF* RundownRef
@@ -1461,6 +1531,24 @@ DMF_Portable_Rundown_Completed(
     _Inout_ DMF_PORTABLE_RUNDOWN_REF* RundownRef
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_Portable_Completion_Initialize(
+    _Out_ DMF_PORTABLE_COMPLETION* Completion
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_Portable_Completion_Signal(
+    _Inout_ DMF_PORTABLE_COMPLETION* Completion
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Portable_Completion_Wait(
+    _Inout_ DMF_PORTABLE_COMPLETION* Completion
+    );
+
 _Must_inspect_result_
 BOOLEAN
 DMF_Portable_VersionCheck(
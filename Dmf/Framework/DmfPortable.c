@@ -32,6 +32,17 @@ Environment:
 #define MAJOR_VERSION_WINDOWS_10  10
 #define MINOR_VERSION_WINDOWS_10  0
 
+#if !defined(DMF_KERNEL_MODE)
+// User-mode rundown protection uses the same encoding as EX_RUNDOWN_REF:
+// Bit 0 indicates rundown is active and each reference adds 2.
+//
+#define DMF_PORTABLE_RUNDOWN_ACTIVE             0x1
+#define DMF_PORTABLE_RUNDOWN_COUNT_INCREMENT    0x2
+// Interval between checks while waiting for references to drain.
+//
+#define DMF_PORTABLE_RUNDOWN_WAIT_MS            1
+#endif // !defined(DMF_KERNEL_MODE)
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -504,6 +515,370 @@ Return Value:
     FuncExitVoid(DMF_TRACE);
 }
 
+#if defined(DMF_USER_MODE)
+
+// User-mode lookaside lists keep a cache of recycled buffers. The depth of the cache
+// adapts to the observed miss ratio using the same limits and heuristic as Kernel-mode
+// lookaside lists.
+//
+#define DMF_PORTABLE_LOOKASIDE_MINIMUM_DEPTH        4
+#define DMF_PORTABLE_LOOKASIDE_MAXIMUM_DEPTH        256
+// Number of allocations between adjustments of the depth.
+//
+#define DMF_PORTABLE_LOOKASIDE_ADJUST_INTERVAL      256
+// If fewer than this many allocations (per thousand) miss the cache, the depth is lowered.
+//
+#define DMF_PORTABLE_LOOKASIDE_MISS_RATIO_MINIMUM   5
+#define DMF_PORTABLE_LOOKASIDE_DEPTH_DECREMENT      10
+
+struct _DMF_PORTABLE_LOOKASIDELIST_CACHE
+{
+    // Buffers available for reuse. While a buffer is in this list, its first bytes
+    // hold its list entry.
+    //
+    SLIST_HEADER ListHead;
+    // Size of each buffer. It is never less than the size of the list entry.
+    //
+    size_t AllocationSize;
+    ULONG PoolTag;
+    // Maximum number of buffers held in ListHead.
+    //
+    volatile LONG Depth;
+    // One reference for the lookaside list object and one for each memory object
+    // created from the list.
+    //
+    volatile LONG ReferenceCount;
+    // Set when the lookaside list object is deleted. After that, buffers are no
+    // longer cached.
+    //
+    volatile LONG Deleted;
+    // Statistics.
+    //
+    volatile LONG TotalAllocates;
+    volatile LONG AllocateMisses;
+    volatile LONG TotalFrees;
+    volatile LONG FreeMisses;
+    // Value of AllocateMisses when the depth was last adjusted.
+    //
+    LONG LastAllocateMisses;
+};
+
+// Context of the object that represents the lookaside list.
+//
+typedef struct
+{
+    DMF_PORTABLE_LOOKASIDELIST_CACHE* Cache;
+} DMF_PORTABLE_LOOKASIDELIST_OBJECT_CONTEXT;
+WDF_DECLARE_CONTEXT_TYPE(DMF_PORTABLE_LOOKASIDELIST_OBJECT_CONTEXT);
+
+// Context of each memory object created from the lookaside list.
+//
+typedef struct
+{
+    DMF_PORTABLE_LOOKASIDELIST_CACHE* Cache;
+    VOID* Buffer;
+} DMF_PORTABLE_LOOKASIDELIST_MEMORY_CONTEXT;
+WDF_DECLARE_CONTEXT_TYPE(DMF_PORTABLE_LOOKASIDELIST_MEMORY_CONTEXT);
+
+static
+VOID
+DmfPortableLookasideCacheFlush(
+    _Inout_ DMF_PORTABLE_LOOKASIDELIST_CACHE* Cache
+    )
+/*++
+
+Routine Description:
+
+    Frees all the buffers held in a given lookaside cache.
+
+Arguments:
+
+    Cache - The given lookaside cache.
+
+Return Value:
+
+    None
+
+--*/
+{
+    SLIST_ENTRY* listEntry;
+
+    listEntry = InterlockedFlushSList(&Cache->ListHead);
+    while (listEntry != NULL)
+    {
+        SLIST_ENTRY* nextListEntry;
+
+        nextListEntry = listEntry->Next;
+        DMF_GenericMemoryFree(listEntry,
+                              Cache->PoolTag);
+        listEntry = nextListEntry;
+    }
+}
+
+static
+VOID
+DmfPortableLookasideCacheDereference(
+    _Inout_ DMF_PORTABLE_LOOKASIDELIST_CACHE* Cache
+    )
+/*++
+
+Routine Description:
+
+    Releases a reference to a given lookaside cache. When the last reference is released
+    the cached buffers and the cache itself are freed.
+
+Arguments:
+
+    Cache - The given lookaside cache.
+
+Return Value:
+
+    None
+
+--*/
+{
+    LONG referenceCount;
+
+    referenceCount = InterlockedDecrement(&Cache->ReferenceCount);
+    DmfAssert(referenceCount >= 0);
+    if (0 == referenceCount)
+    {
+        DmfAssert(Cache->Deleted);
+        DmfPortableLookasideCacheFlush(Cache);
+        DMF_GenericMemoryFree(Cache,
+                              Cache->PoolTag);
+    }
+}
+
+static
+VOID
+DmfPortableLookasideCacheDepthAdjust(
+    _Inout_ DMF_PORTABLE_LOOKASIDELIST_CACHE* Cache
+    )
+/*++
+
+Routine Description:
+
+    Adjusts the depth of a given lookaside cache based on the ratio of allocations that
+    missed the cache since the last adjustment. If few allocations missed, the depth is
+    lowered and the excess buffers are freed. Otherwise, the depth is raised in proportion
+    to the miss ratio.
+    NOTE: This is called every DMF_PORTABLE_LOOKASIDE_ADJUST_INTERVAL allocations so
+          concurrent calls are very unlikely. If they happen, the result is still a
+          depth between the minimum and maximum.
+
+Arguments:
+
+    Cache - The given lookaside cache.
+
+Return Value:
+
+    None
+
+--*/
+{
+    LONG allocateMisses;
+    LONG missRatio;
+    LONG depth;
+    SLIST_ENTRY* listEntry;
+
+    allocateMisses = Cache->AllocateMisses;
+    missRatio = ((allocateMisses - Cache->LastAllocateMisses) * 1000) / DMF_PORTABLE_LOOKASIDE_ADJUST_INTERVAL;
+    Cache->LastAllocateMisses = allocateMisses;
+
+    depth = Cache->Depth;
+    if (missRatio < DMF_PORTABLE_LOOKASIDE_MISS_RATIO_MINIMUM)
+    {
+        depth -= DMF_PORTABLE_LOOKASIDE_DEPTH_DECREMENT;
+        if (depth < DMF_PORTABLE_LOOKASIDE_MINIMUM_DEPTH)
+        {
+            depth = DMF_PORTABLE_LOOKASIDE_MINIMUM_DEPTH;
+        }
+    }
+    else
+    {
+        depth += ((missRatio * (DMF_PORTABLE_LOOKASIDE_MAXIMUM_DEPTH - depth)) / (1000 * 2)) + 5;
+        if (depth > DMF_PORTABLE_LOOKASIDE_MAXIMUM_DEPTH)
+        {
+            depth = DMF_PORTABLE_LOOKASIDE_MAXIMUM_DEPTH;
+        }
+    }
+    InterlockedExchange(&Cache->Depth,
+                        depth);
+
+    // Free buffers that no longer fit in the cache.
+    //
+    while ((LONG)QueryDepthSList(&Cache->ListHead) > depth)
+    {
+        listEntry = InterlockedPopEntrySList(&Cache->ListHead);
+        if (NULL == listEntry)
+        {
+            break;
+        }
+        DMF_GenericMemoryFree(listEntry,
+                              Cache->PoolTag);
+    }
+}
+
+static
+VOID*
+DmfPortableLookasideCacheBufferAllocate(
+    _Inout_ DMF_PORTABLE_LOOKASIDELIST_CACHE* Cache
+    )
+/*++
+
+Routine Description:
+
+    Gets a buffer from a given lookaside cache. If the cache is empty, a new buffer
+    is allocated.
+
+Arguments:
+
+    Cache - The given lookaside cache.
+
+Return Value:
+
+    The buffer or NULL if the cache is empty and no memory is available.
+
+--*/
+{
+    VOID* buffer;
+    LONG totalAllocates;
+
+    totalAllocates = InterlockedIncrement(&Cache->TotalAllocates);
+
+    buffer = InterlockedPopEntrySList(&Cache->ListHead);
+    if (NULL == buffer)
+    {
+        InterlockedIncrement(&Cache->AllocateMisses);
+        buffer = DMF_GenericMemoryAllocate(POOL_FLAG_NON_PAGED,
+                                           Cache->AllocationSize,
+                                           Cache->PoolTag);
+    }
+
+    if (0 == ((ULONG)totalAllocates % DMF_PORTABLE_LOOKASIDE_ADJUST_INTERVAL))
+    {
+        DmfPortableLookasideCacheDepthAdjust(Cache);
+    }
+
+    return buffer;
+}
+
+static
+VOID
+DmfPortableLookasideCacheBufferFree(
+    _Inout_ DMF_PORTABLE_LOOKASIDELIST_CACHE* Cache,
+    _In_ VOID* Buffer
+    )
+/*++
+
+Routine Description:
+
+    Returns a buffer to a given lookaside cache. If the cache is full (or the lookaside
+    list has been deleted), the buffer is freed.
+
+Arguments:
+
+    Cache - The given lookaside cache.
+    Buffer - The buffer to return.
+
+Return Value:
+
+    None
+
+--*/
+{
+    InterlockedIncrement(&Cache->TotalFrees);
+
+    if ((! Cache->Deleted) &&
+        ((LONG)QueryDepthSList(&Cache->ListHead) < Cache->Depth))
+    {
+        InterlockedPushEntrySList(&Cache->ListHead,
+                                  (SLIST_ENTRY*)Buffer);
+    }
+    else
+    {
+        InterlockedIncrement(&Cache->FreeMisses);
+        DMF_GenericMemoryFree(Buffer,
+                              Cache->PoolTag);
+    }
+}
+
+_Function_class_(EVT_WDF_OBJECT_CONTEXT_DESTROY)
+VOID
+DmfPortableLookasideListMemoryContextDestroy(
+    _In_ WDFOBJECT Object
+    )
+/*++
+
+Routine Description:
+
+    Called when a memory object created from a lookaside list is destroyed. Its buffer
+    is returned to the lookaside cache.
+
+Arguments:
+
+    Object - The memory object.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_PORTABLE_LOOKASIDELIST_MEMORY_CONTEXT* memoryContext;
+
+    memoryContext = WdfObjectGet_DMF_PORTABLE_LOOKASIDELIST_MEMORY_CONTEXT(Object);
+
+    DmfPortableLookasideCacheBufferFree(memoryContext->Cache,
+                                        memoryContext->Buffer);
+    DmfPortableLookasideCacheDereference(memoryContext->Cache);
+}
+
+_Function_class_(EVT_WDF_OBJECT_CONTEXT_CLEANUP)
+VOID
+DmfPortableLookasideListObjectContextCleanup(
+    _In_ WDFOBJECT Object
+    )
+/*++
+
+Routine Description:
+
+    Called when the object that represents a lookaside list is deleted. Cached buffers
+    are freed. Buffers of memory objects that are still outstanding are freed when those
+    memory objects are destroyed.
+
+Arguments:
+
+    Object - The object that represents the lookaside list.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_PORTABLE_LOOKASIDELIST_OBJECT_CONTEXT* objectContext;
+    DMF_PORTABLE_LOOKASIDELIST_CACHE* cache;
+
+    objectContext = WdfObjectGet_DMF_PORTABLE_LOOKASIDELIST_OBJECT_CONTEXT(Object);
+    cache = objectContext->Cache;
+    if (NULL == cache)
+    {
+        // Context allocation succeeded but the cache was not created.
+        //
+        return;
+    }
+    objectContext->Cache = NULL;
+
+    InterlockedExchange(&cache->Deleted,
+                        TRUE);
+    DmfPortableLookasideCacheFlush(cache);
+    DmfPortableLookasideCacheDereference(cache);
+}
+
+#endif // defined(DMF_USER_MODE)
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -520,6 +895,9 @@ DMF_Portable_LookasideListCreate(
 Routine Description:
 
     Portable Function for the KMDF only WdfLookasideListCreate function.
+    In User-mode, the lookaside list is an object (parented as specified by LookasideAttributes)
+    that keeps a cache of recycled buffers. The depth of the cache adapts to the rate
+    at which memory objects are created and deleted.
 
 Arguments:
 
@@ -537,15 +915,20 @@ Return Value:
 --*/
 {
     NTSTATUS ntStatus;
+#if defined(DMF_USER_MODE)
+    WDF_OBJECT_ATTRIBUTES objectContextAttributes;
+    DMF_PORTABLE_LOOKASIDELIST_OBJECT_CONTEXT* objectContext;
+    DMF_PORTABLE_LOOKASIDELIST_CACHE* cache;
+#endif // defined(DMF_USER_MODE)
 
     FuncEntry(DMF_TRACE);
 
     DmfAssert(LookasidePointer != NULL);
+    DmfAssert(BufferSize != 0);
 
 #if defined(DMF_USER_MODE)
-    UNREFERENCED_PARAMETER(LookasideAttributes);
-
-    ntStatus = STATUS_SUCCESS;
+    RtlZeroMemory(LookasidePointer,
+                  sizeof(DMF_PORTABLE_LOOKASIDELIST));
 
     if (MemoryAttributes)
     {
@@ -553,16 +936,64 @@ Return Value:
                       MemoryAttributes,
                       sizeof(WDF_OBJECT_ATTRIBUTES));
     }
-    else
-    {
-        RtlZeroMemory(&LookasidePointer->MemoryAttributes,
-                      sizeof(WDF_OBJECT_ATTRIBUTES));
-    }
     LookasidePointer->BufferSize = BufferSize;
     LookasidePointer->PoolType = PoolType;
     LookasidePointer->PoolTag = PoolTag;
+
+    ntStatus = WdfObjectCreate(LookasideAttributes,
+                               &LookasidePointer->WdflookasideList);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfObjectCreate fails: ntStatus=%!STATUS!", ntStatus);
+        LookasidePointer->WdflookasideList = NULL;
+        goto Exit;
+    }
+
+    // The cache is released when the lookaside list object is deleted.
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&objectContextAttributes,
+                                            DMF_PORTABLE_LOOKASIDELIST_OBJECT_CONTEXT);
+    objectContextAttributes.EvtCleanupCallback = DmfPortableLookasideListObjectContextCleanup;
+    ntStatus = WdfObjectAllocateContext(LookasidePointer->WdflookasideList,
+                                        &objectContextAttributes,
+                                        (VOID**)&objectContext);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfObjectAllocateContext fails: ntStatus=%!STATUS!", ntStatus);
+        WdfObjectDelete(LookasidePointer->WdflookasideList);
+        LookasidePointer->WdflookasideList = NULL;
+        goto Exit;
+    }
+    objectContext->Cache = NULL;
+
+    cache = (DMF_PORTABLE_LOOKASIDELIST_CACHE*)DMF_GenericMemoryAllocate(POOL_FLAG_NON_PAGED,
+                                                                          sizeof(DMF_PORTABLE_LOOKASIDELIST_CACHE),
+                                                                          PoolTag);
+    if (NULL == cache)
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_GenericMemoryAllocate fails");
+        WdfObjectDelete(LookasidePointer->WdflookasideList);
+        LookasidePointer->WdflookasideList = NULL;
+        goto Exit;
+    }
+
+    RtlZeroMemory(cache,
+                  sizeof(DMF_PORTABLE_LOOKASIDELIST_CACHE));
+    InitializeSListHead(&cache->ListHead);
+    // Cached buffers hold their list entry so they must be large enough for it.
+    //
+    cache->AllocationSize = (BufferSize > sizeof(SLIST_ENTRY)) ? BufferSize : sizeof(SLIST_ENTRY);
+    cache->PoolTag = PoolTag;
+    cache->Depth = DMF_PORTABLE_LOOKASIDE_MINIMUM_DEPTH;
+    cache->ReferenceCount = 1;
+
+    objectContext->Cache = cache;
+    LookasidePointer->Cache = cache;
+
+Exit:
+    ;
 #else
-    DmfAssert(BufferSize != 0);
     // 'Error annotation: __formal(1,BufferSize) cannot be zero.'
     //
     #pragma warning(suppress:28160)
@@ -595,6 +1026,8 @@ DMF_Portable_LookasideListCreateMemory(
 Routine Description:
 
     Portable Function for the KMDF only WDFMemoryCreateFromLookaside function.
+    In User-mode, the buffer of the memory object is taken from the lookaside cache when
+    possible and is returned to the cache when the memory object is deleted.
 
 Arguments:
 
@@ -608,18 +1041,70 @@ Return Value:
 --*/
 {
     NTSTATUS ntStatus;
+#if defined(DMF_USER_MODE)
+    DMF_PORTABLE_LOOKASIDELIST_CACHE* cache;
+    DMF_PORTABLE_LOOKASIDELIST_MEMORY_CONTEXT* memoryContext;
+    WDF_OBJECT_ATTRIBUTES memoryContextAttributes;
+    WDFMEMORY memory;
+    VOID* buffer;
+#endif // defined(DMF_USER_MODE)
 
     FuncEntry(DMF_TRACE);
 
     DmfAssert(LookasidePointer != NULL);
 
 #if defined(DMF_USER_MODE)
-    ntStatus = WdfMemoryCreate(&LookasidePointer->MemoryAttributes,
-                               LookasidePointer->PoolType,
-                               LookasidePointer->PoolTag,
-                               LookasidePointer->BufferSize,
-                               Memory,
-                               NULL);
+    *Memory = NULL;
+
+    cache = LookasidePointer->Cache;
+    DmfAssert(cache != NULL);
+
+    buffer = DmfPortableLookasideCacheBufferAllocate(cache);
+    if (NULL == buffer)
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DmfPortableLookasideCacheBufferAllocate fails");
+        goto Exit;
+    }
+
+    ntStatus = WdfMemoryCreatePreallocated((LookasidePointer->MemoryAttributes.Size != 0) ? &LookasidePointer->MemoryAttributes : WDF_NO_OBJECT_ATTRIBUTES,
+                                           buffer,
+                                           LookasidePointer->BufferSize,
+                                           &memory);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreatePreallocated fails: ntStatus=%!STATUS!", ntStatus);
+        DmfPortableLookasideCacheBufferFree(cache,
+                                            buffer);
+        goto Exit;
+    }
+
+    // The buffer is returned to the cache when the memory object is destroyed.
+    // This context is separate from MemoryAttributes so that Client's context and callbacks are preserved.
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&memoryContextAttributes,
+                                            DMF_PORTABLE_LOOKASIDELIST_MEMORY_CONTEXT);
+    memoryContextAttributes.EvtDestroyCallback = DmfPortableLookasideListMemoryContextDestroy;
+    ntStatus = WdfObjectAllocateContext(memory,
+                                        &memoryContextAttributes,
+                                        (VOID**)&memoryContext);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfObjectAllocateContext fails: ntStatus=%!STATUS!", ntStatus);
+        WdfObjectDelete(memory);
+        DmfPortableLookasideCacheBufferFree(cache,
+                                            buffer);
+        goto Exit;
+    }
+
+    InterlockedIncrement(&cache->ReferenceCount);
+    memoryContext->Cache = cache;
+    memoryContext->Buffer = buffer;
+
+    *Memory = memory;
+
+Exit:
+    ;
 #else
     ntStatus = WdfMemoryCreateFromLookaside(LookasidePointer->WdflookasideList,
                                             Memory);
@@ -630,6 +1115,110 @@ Return Value:
     return ntStatus;
 }
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Portable_LookasideListDelete(
+    _Inout_ DMF_PORTABLE_LOOKASIDELIST* LookasidePointer
+    )
+/*++
+
+Routine Description:
+
+    Deletes a lookaside list created by DMF_Portable_LookasideListCreate(). In User-mode,
+    the cached buffers are freed. Memory objects created from the list that are still
+    outstanding remain valid.
+
+Arguments:
+
+    LookasidePointer - Storage area for the Lookaside list object.
+
+Return Value:
+
+    None
+
+--*/
+{
+    FuncEntry(DMF_TRACE);
+
+    DmfAssert(LookasidePointer != NULL);
+
+    if (LookasidePointer->WdflookasideList != NULL)
+    {
+        WdfObjectDelete(LookasidePointer->WdflookasideList);
+        LookasidePointer->WdflookasideList = NULL;
+    }
+#if defined(DMF_USER_MODE)
+    LookasidePointer->Cache = NULL;
+#endif // defined(DMF_USER_MODE)
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+DMF_Portable_LookasideListStatisticsGet(
+    _In_ DMF_PORTABLE_LOOKASIDELIST* LookasidePointer,
+    _Out_ DMF_PORTABLE_LOOKASIDELIST_STATISTICS* Statistics
+    )
+/*++
+
+Routine Description:
+
+    Retrieves usage statistics of a given lookaside list. The values are read without
+    synchronization so they are approximate when the list is in use.
+    NOTE: Kernel-mode lookaside lists do not expose their statistics.
+
+Arguments:
+
+    LookasidePointer - Storage area for the Lookaside list object.
+    Statistics - Where the statistics are written.
+
+Return Value:
+
+    STATUS_SUCCESS in User-mode.
+    STATUS_NOT_SUPPORTED in Kernel-mode.
+
+--*/
+{
+    NTSTATUS ntStatus;
+#if defined(DMF_USER_MODE)
+    DMF_PORTABLE_LOOKASIDELIST_CACHE* cache;
+#endif // defined(DMF_USER_MODE)
+
+    DmfAssert(LookasidePointer != NULL);
+    DmfAssert(Statistics != NULL);
+
+    RtlZeroMemory(Statistics,
+                  sizeof(DMF_PORTABLE_LOOKASIDELIST_STATISTICS));
+
+#if defined(DMF_USER_MODE)
+    cache = LookasidePointer->Cache;
+    if (NULL == cache)
+    {
+        ntStatus = STATUS_INVALID_DEVICE_STATE;
+        goto Exit;
+    }
+
+    Statistics->TotalAllocates = (ULONG)cache->TotalAllocates;
+    Statistics->AllocateMisses = (ULONG)cache->AllocateMisses;
+    Statistics->AllocateHits = Statistics->TotalAllocates - Statistics->AllocateMisses;
+    Statistics->TotalFrees = (ULONG)cache->TotalFrees;
+    Statistics->FreeMisses = (ULONG)cache->FreeMisses;
+    Statistics->FreeHits = Statistics->TotalFrees - Statistics->FreeMisses;
+    Statistics->Depth = (ULONG)cache->Depth;
+    Statistics->CachedBuffers = QueryDepthSList(&cache->ListHead);
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+    ;
+#else
+    UNREFERENCED_PARAMETER(LookasidePointer);
+    ntStatus = STATUS_NOT_SUPPORTED;
+#endif // defined(DMF_USER_MODE)
+
+    return ntStatus;
+}
+
 VOID
 DMF_Portable_Rundown_Initialize(
     _Inout_ DMF_PORTABLE_RUNDOWN_REF* RundownRef
@@ -653,12 +1242,8 @@ Return Value:
 #if defined(DMF_KERNEL_MODE)
     ExInitializeRundownProtection(&RundownRef->RundownRef);
 #else
-    // TODO: Equivalent code will go here. Change is pending.
-    //       Until then, Client must implement another solution
-    //       in User-mode.
-    //
-    UNREFERENCED_PARAMETER(RundownRef);
-    DmfAssert(FALSE);
+    InterlockedExchange(&RundownRef->Count,
+                        0);
 #endif // defined(DMF_KERNEL_MODE)
 }
 
@@ -685,12 +1270,8 @@ Return Value:
 #if defined(DMF_KERNEL_MODE)
     ExReInitializeRundownProtection(&RundownRef->RundownRef);
 #else
-    // TODO: Equivalent code will go here. Change is pending.
-    //       Until then, Client must implement another solution
-    //       in User-mode.
-    //
-    UNREFERENCED_PARAMETER(RundownRef);
-    DmfAssert(FALSE);
+    InterlockedExchange(&RundownRef->Count,
+                        0);
 #endif // defined(DMF_KERNEL_MODE)
 }
 
@@ -721,13 +1302,27 @@ Return Value:
 #if defined(DMF_KERNEL_MODE)
     returnValue = ExAcquireRundownProtection(&RundownRef->RundownRef);
 #else
-    // TODO: Equivalent code will go here. Change is pending.
-    //       Until then, Client must implement another solution
-    //       in User-mode.
-    //
-    UNREFERENCED_PARAMETER(RundownRef);
-    DmfAssert(FALSE);
+    LONG currentCount;
+
     returnValue = FALSE;
+    for (;;)
+    {
+        currentCount = RundownRef->Count;
+        if (currentCount & DMF_PORTABLE_RUNDOWN_ACTIVE)
+        {
+            // Rundown has started. No more references are allowed.
+            //
+            break;
+        }
+
+        if (InterlockedCompareExchange(&RundownRef->Count,
+                                       currentCount + DMF_PORTABLE_RUNDOWN_COUNT_INCREMENT,
+                                       currentCount) == currentCount)
+        {
+            returnValue = TRUE;
+            break;
+        }
+    }
 #endif // defined(DMF_KERNEL_MODE)
     
     return returnValue;
@@ -756,12 +1351,12 @@ Return Value:
 #if defined(DMF_KERNEL_MODE)
     ExReleaseRundownProtection(&RundownRef->RundownRef);
 #else
-    // TODO: Equivalent code will go here. Change is pending.
-    //       Until then, Client must implement another solution
-    //       in User-mode.
-    //
-    UNREFERENCED_PARAMETER(RundownRef);
-    DmfAssert(FALSE);
+    LONG previousCount;
+
+    previousCount = InterlockedExchangeAdd(&RundownRef->Count,
+                                           -DMF_PORTABLE_RUNDOWN_COUNT_INCREMENT);
+    DmfAssert(previousCount >= DMF_PORTABLE_RUNDOWN_COUNT_INCREMENT);
+    UNREFERENCED_PARAMETER(previousCount);
 #endif // defined(DMF_KERNEL_MODE)
 }
 
@@ -789,12 +1384,16 @@ Return Value:
 #if defined(DMF_KERNEL_MODE)
     ExWaitForRundownProtectionRelease(&RundownRef->RundownRef);
 #else
-    // TODO: Equivalent code will go here. Change is pending.
-    //       Until then, Client must implement another solution
-    //       in User-mode.
+    // Prevent new references, then wait for the existing references to be released.
+    // Rundown only happens during teardown so polling is acceptable here and avoids
+    // allocating a wait object that Clients would otherwise need to free.
     //
-    UNREFERENCED_PARAMETER(RundownRef);
-    DmfAssert(FALSE);
+    InterlockedOr(&RundownRef->Count,
+                  DMF_PORTABLE_RUNDOWN_ACTIVE);
+    while (RundownRef->Count != DMF_PORTABLE_RUNDOWN_ACTIVE)
+    {
+        Sleep(DMF_PORTABLE_RUNDOWN_WAIT_MS);
+    }
 #endif // defined(DMF_KERNEL_MODE)
 }
 
@@ -822,14 +1421,134 @@ Return Value:
 #if defined(DMF_KERNEL_MODE)
     ExRundownCompleted(&RundownRef->RundownRef);
 #else
-    // TODO: Equivalent code will go here. Change is pending.
-    //       Until then, Client must implement another solution
-    //       in User-mode.
+    DmfAssert(RundownRef->Count == DMF_PORTABLE_RUNDOWN_ACTIVE);
+    InterlockedExchange(&RundownRef->Count,
+                        DMF_PORTABLE_RUNDOWN_ACTIVE);
+#endif // defined(DMF_KERNEL_MODE)
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_Portable_Completion_Initialize(
+    _Out_ DMF_PORTABLE_COMPLETION* Completion
+    )
+/*++
+
+Routine Description:
+
+    Initialize a given DMF_PORTABLE_COMPLETION structure so that it is not signaled.
+    It can be initialized again after it has been waited on.
+
+Arguments:
+
+    Completion - The given DMF_PORTABLE_COMPLETION structure.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DmfAssert(Completion != NULL);
+
+#if defined(DMF_KERNEL_MODE)
+    KeInitializeEvent(&Completion->Event,
+                      NotificationEvent,
+                      FALSE);
+#else
+    InterlockedExchange(&Completion->Signaled,
+                        FALSE);
+#endif // defined(DMF_KERNEL_MODE)
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_Portable_Completion_Signal(
+    _Inout_ DMF_PORTABLE_COMPLETION* Completion
+    )
+/*++
+
+Routine Description:
+
+    Signal a given DMF_PORTABLE_COMPLETION structure and wake up the thread that waits on it.
+    NOTE: The caller must not access the structure after this call because the waiting thread
+          may reuse or free it as soon as it wakes up.
+
+Arguments:
+
+    Completion - The given DMF_PORTABLE_COMPLETION structure.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DmfAssert(Completion != NULL);
+
+#if defined(DMF_KERNEL_MODE)
+    KeSetEvent(&Completion->Event,
+               0,
+               FALSE);
+#else
+    InterlockedExchange(&Completion->Signaled,
+                        TRUE);
+    // The waiting thread may have already seen the new value and returned, in which case
+    // no thread is woken up. This function only uses the address, not its contents.
+    //
+    WakeByAddressSingle((VOID*)&Completion->Signaled);
+#endif // defined(DMF_KERNEL_MODE)
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Portable_Completion_Wait(
+    _Inout_ DMF_PORTABLE_COMPLETION* Completion
+    )
+/*++
+
+Routine Description:
+
+    Wait (infinitely) until a given DMF_PORTABLE_COMPLETION structure is signaled.
+
+Arguments:
+
+    Completion - The given DMF_PORTABLE_COMPLETION structure.
+
+Return Value:
+
+    None
+
+--*/
+{
+    PAGED_CODE();
+
+    DmfAssert(Completion != NULL);
+
+#if defined(DMF_KERNEL_MODE)
+    KeWaitForSingleObject(&Completion->Event,
+                          Executive,
+                          KernelMode,
+                          FALSE,
+                          NULL);
+#else
+    LONG notSignaled;
+
+    // Sleep on the address of the flag (instead of a kernel object) so that no handle
+    // is created or closed. The loop handles spurious wake ups.
     //
-    UNREFERENCED_PARAMETER(RundownRef);
-    DmfAssert(FALSE);
+    notSignaled = FALSE;
+    while (! Completion->Signaled)
+    {
+        WaitOnAddress((VOID*)&Completion->Signaled,
+                      &notSignaled,
+                      sizeof(notSignaled),
+                      INFINITE);
+    }
 #endif // defined(DMF_KERNEL_MODE)
 }
+#pragma code_seg()
 
 _Must_inspect_result_
 BOOLEAN
@@ -0,0 +1,2786 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfHost.c
+
+Abstract:
+
+    User-mode implementation of the WDF objects (memory, locks, timers and objects with
+    typed contexts), of the Win32 functions used by DMF_USER_MODE paths (including those of
+    Framework/DmfPortable.c) and of the DMF Module support functions used by the Modules in
+    the host build. Objects form a tree the
+    same way WDF objects do: deleting an object deletes its children first. Modules are
+    created, opened, closed and destroyed the way DMF does it for dynamic Modules.
+
+Environment:
+
+    Host (POSIX)
+
+--*/
+
+#include "DmfIncludeInternal.h"
+#include "DmfModules.Library.h"
+#include "DmfModules.Library.Trace.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Definitions
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef enum
+{
+    DmfHostObjectType_Invalid = 0,
+    DmfHostObjectType_Base,
+    DmfHostObjectType_Device,
+    DmfHostObjectType_Memory,
+    DmfHostObjectType_SpinLock,
+    DmfHostObjectType_WaitLock,
+    DmfHostObjectType_Timer,
+    DmfHostObjectType_Module,
+    DmfHostObjectType_Maximum
+} DmfHostObjectType;
+
+typedef struct
+{
+    // Buffer owned (or not, if preallocated) by the memory object.
+    //
+    VOID* Buffer;
+    size_t BufferSize;
+    BOOLEAN Preallocated;
+} DMF_HOST_MEMORY;
+
+typedef struct
+{
+    // Thread that calls EvtTimerFunc.
+    //
+    pthread_t Thread;
+    // Signaled when the timer is started, stopped or deleted and when EvtTimerFunc returns.
+    //
+    pthread_cond_t Condition;
+    PFN_WDF_TIMER EvtTimerFunc;
+    ULONG Period;
+    // Monotonic time in nanoseconds when the timer expires. Zero means the timer is not queued.
+    //
+    ULONGLONG DueTime;
+    // Indicates EvtTimerFunc is running.
+    //
+    BOOLEAN CallbackRunning;
+    // Indicates the timer is being deleted.
+    //
+    BOOLEAN Exiting;
+} DMF_HOST_TIMER;
+
+typedef struct
+{
+    DMF_MODULE_DESCRIPTOR ModuleDescriptor;
+    DMF_CALLBACKS_DMF CallbacksDmf;
+    // Client Driver's device.
+    //
+    WDFDEVICE Device;
+    // Copy of the Client's Module Config.
+    //
+    VOID* ModuleConfig;
+    // Indicates the Module locks are used at PASSIVE_LEVEL.
+    //
+    BOOLEAN PassiveLevel;
+    // Indicates DeviceOpen succeeded so DeviceClose must be called.
+    //
+    BOOLEAN IsOpened;
+    // Thread that holds the Module lock.
+    //
+    ULONG_PTR LockOwner;
+    pthread_mutex_t* AuxiliaryLocks;
+} DMF_HOST_MODULE;
+
+// Header of each context allocated for an object. The context follows the header.
+//
+typedef struct _DMF_HOST_CONTEXT
+{
+    // Next context allocated for the same object.
+    //
+    struct _DMF_HOST_CONTEXT* NextContext;
+    // Type of the context or NULL if only callbacks were given.
+    //
+    PCWDF_OBJECT_CONTEXT_TYPE_INFO ContextTypeInfo;
+    PFN_WDF_OBJECT_CONTEXT_CLEANUP EvtCleanupCallback;
+    PFN_WDF_OBJECT_CONTEXT_DESTROY EvtDestroyCallback;
+} DMF_HOST_CONTEXT;
+
+// Contexts start at an offset that satisfies the alignment of any type.
+//
+#define DMF_HOST_CONTEXT_OFFSET         ((sizeof(DMF_HOST_CONTEXT) + 15) & ~(size_t)15)
+
+struct _DMF_HOST_OBJECT
+{
+    DmfHostObjectType ObjectType;
+    // Parent object and the entry in the parent's list of children.
+    //
+    WDFOBJECT ParentObject;
+    LIST_ENTRY ListEntry;
+    // Child objects. They are deleted (last created first) before this object.
+    //
+    LIST_ENTRY ChildObjectList;
+    // Contexts in the order they were allocated. WdfObjectAllocateContext() appends to
+    // this list while other threads may be reading it.
+    //
+    DMF_HOST_CONTEXT* ContextList;
+    // Lock of spin lock, wait lock, timer and Module objects.
+    //
+    pthread_mutex_t Lock;
+    union
+    {
+        DMF_HOST_MEMORY Memory;
+        DMF_HOST_TIMER Timer;
+        DMF_HOST_MODULE Module;
+    } u;
+};
+
+// Passed to DMF_ChildModulesAdd() as PDMFMODULE_INIT.
+//
+typedef struct
+{
+    // Parent Module of the Child Modules.
+    //
+    DMFMODULE DmfModule;
+    // Status of the first Child Module that could not be created.
+    //
+    NTSTATUS NtStatus;
+} DMF_HOST_MODULE_INIT;
+
+// Protects the lists of child objects.
+//
+static pthread_mutex_t DmfHost_ObjectTreeLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Its address identifies the current thread.
+//
+static __thread UCHAR DmfHost_ThreadTag;
+
+// Traces at or below this level are printed (DMF_HOST_TRACE_LEVEL environment variable).
+//
+static ULONG DmfHost_TraceLevel = MAXULONG;
+
+#define NANOSECONDS_PER_MILLISECOND     (1000ULL * 1000ULL)
+#define NANOSECONDS_PER_SECOND          (1000ULL * 1000ULL * 1000ULL)
+// Difference between 1601-01-01 (system time) and 1970-01-01 (Unix time) in seconds.
+//
+#define SYSTEM_TIME_TO_UNIX_SECONDS     11644473600ULL
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+static
+ULONGLONG
+DmfHost_NanosecondsGet(
+    _In_ clockid_t ClockId
+    )
+/*++
+
+Routine Description:
+
+    Read a clock in nanoseconds.
+
+Arguments:
+
+    ClockId - The clock to read.
+
+Return Value:
+
+    The time in nanoseconds.
+
+--*/
+{
+    struct timespec timeSpec;
+
+    clock_gettime(ClockId,
+                  &timeSpec);
+    return ((ULONGLONG)timeSpec.tv_sec * NANOSECONDS_PER_SECOND) + (ULONGLONG)timeSpec.tv_nsec;
+}
+
+static
+VOID
+DmfHost_TimeSpecGet(
+    _In_ ULONGLONG Nanoseconds,
+    _Out_ struct timespec* TimeSpec
+    )
+/*++
+
+Routine Description:
+
+    Convert a time in nanoseconds to a timespec.
+
+Arguments:
+
+    Nanoseconds - The time in nanoseconds.
+    TimeSpec - Receives the time.
+
+Return Value:
+
+    None
+
+--*/
+{
+    TimeSpec->tv_sec = (time_t)(Nanoseconds / NANOSECONDS_PER_SECOND);
+    TimeSpec->tv_nsec = (long)(Nanoseconds % NANOSECONDS_PER_SECOND);
+}
+
+static
+ULONG_PTR
+DmfHost_CurrentThreadGet(
+    VOID
+    )
+{
+    return (ULONG_PTR)&DmfHost_ThreadTag;
+}
+
+_Must_inspect_result_
+static
+NTSTATUS
+DmfHost_ContextAllocate(
+    _In_ WDFOBJECT Object,
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES ContextAttributes,
+    _Outptr_opt_ VOID** Context
+    )
+/*++
+
+Routine Description:
+
+    Allocate the context and callbacks given by attributes and append them to an object's
+    list of contexts. Nothing is allocated if the attributes have neither a context nor
+    callbacks.
+
+Arguments:
+
+    Object - The object.
+    ContextAttributes - Attributes with the type of the context and its callbacks.
+    Context - Receives the context (NULL if the attributes have no context type).
+
+Return Value:
+
+    STATUS_SUCCESS, STATUS_OBJECT_NAME_EXISTS or STATUS_INSUFFICIENT_RESOURCES.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_HOST_CONTEXT* context;
+    DMF_HOST_CONTEXT** nextContext;
+    size_t contextSize;
+
+    if (Context != NULL)
+    {
+        *Context = NULL;
+    }
+
+    if ((WDF_NO_OBJECT_ATTRIBUTES == ContextAttributes) ||
+        ((NULL == ContextAttributes->ContextTypeInfo) &&
+         (NULL == ContextAttributes->EvtCleanupCallback) &&
+         (NULL == ContextAttributes->EvtDestroyCallback)))
+    {
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    contextSize = 0;
+    if (ContextAttributes->ContextTypeInfo != NULL)
+    {
+        if (WdfObjectGetTypedContextWorker(Object,
+                                           ContextAttributes->ContextTypeInfo) != NULL)
+        {
+            ntStatus = STATUS_OBJECT_NAME_EXISTS;
+            goto Exit;
+        }
+        contextSize = ContextAttributes->ContextTypeInfo->ContextSize;
+        if (ContextAttributes->ContextSizeOverride > contextSize)
+        {
+            contextSize = ContextAttributes->ContextSizeOverride;
+        }
+    }
+
+    // WDF zeroes the context.
+    //
+    context = (DMF_HOST_CONTEXT*)calloc(1,
+                                        DMF_HOST_CONTEXT_OFFSET + contextSize);
+    if (NULL == context)
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        goto Exit;
+    }
+    context->ContextTypeInfo = ContextAttributes->ContextTypeInfo;
+    context->EvtCleanupCallback = ContextAttributes->EvtCleanupCallback;
+    context->EvtDestroyCallback = ContextAttributes->EvtDestroyCallback;
+
+    // Contexts are only appended. Readers see either the old end of the list or the new
+    // context fully initialized.
+    //
+    pthread_mutex_lock(&Object->Lock);
+    nextContext = &Object->ContextList;
+    while (*nextContext != NULL)
+    {
+        nextContext = &(*nextContext)->NextContext;
+    }
+    __atomic_store_n(nextContext,
+                     context,
+                     __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&Object->Lock);
+
+    if ((Context != NULL) &&
+        (context->ContextTypeInfo != NULL))
+    {
+        *Context = (UCHAR*)context + DMF_HOST_CONTEXT_OFFSET;
+    }
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
+static
+VOID
+DmfHost_ObjectDestroy(
+    _In_ WDFOBJECT Object
+    );
+
+_Must_inspect_result_
+static
+NTSTATUS
+DmfHost_ObjectCreate(
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+    _In_opt_ WDFOBJECT DefaultParentObject,
+    _In_ DmfHostObjectType ObjectType,
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES DescriptorContextAttributes,
+    _Out_ WDFOBJECT* Object
+    )
+/*++
+
+Routine Description:
+
+    Allocate an object with its contexts and insert it in its parent's list of children.
+
+Arguments:
+
+    Attributes - Optional attributes of the object.
+    DefaultParentObject - Parent used if Attributes does not set one.
+    ObjectType - Type of the object.
+    DescriptorContextAttributes - Optional attributes of a context allocated before the
+                                  context in Attributes (the Module's context).
+    Object - Receives the object.
+
+Return Value:
+
+    STATUS_SUCCESS or STATUS_INSUFFICIENT_RESOURCES.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDFOBJECT object;
+
+    *Object = NULL;
+
+    object = (WDFOBJECT)calloc(1,
+                               sizeof(struct _DMF_HOST_OBJECT));
+    if (NULL == object)
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        goto Exit;
+    }
+
+    object->ObjectType = ObjectType;
+    object->ParentObject = DefaultParentObject;
+    InitializeListHead(&object->ChildObjectList);
+    InitializeListHead(&object->ListEntry);
+    pthread_mutex_init(&object->Lock,
+                       NULL);
+
+    if ((Attributes != WDF_NO_OBJECT_ATTRIBUTES) &&
+        (Attributes->ParentObject != NULL))
+    {
+        object->ParentObject = Attributes->ParentObject;
+    }
+
+    ntStatus = DmfHost_ContextAllocate(object,
+                                       DescriptorContextAttributes,
+                                       NULL);
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = DmfHost_ContextAllocate(object,
+                                           Attributes,
+                                           NULL);
+    }
+    if (! NT_SUCCESS(ntStatus))
+    {
+        // The object has no children and no callbacks have been called yet so the
+        // Module specific parts of the object are not touched.
+        //
+        object->ObjectType = DmfHostObjectType_Base;
+        DmfHost_ObjectDestroy(object);
+        goto Exit;
+    }
+
+    if (object->ParentObject != NULL)
+    {
+        pthread_mutex_lock(&DmfHost_ObjectTreeLock);
+        InsertTailList(&object->ParentObject->ChildObjectList,
+                       &object->ListEntry);
+        pthread_mutex_unlock(&DmfHost_ObjectTreeLock);
+    }
+
+    *Object = object;
+
+Exit:
+
+    return ntStatus;
+}
+
+static
+VOID
+DmfHost_TimerDelete(
+    _In_ WDFTIMER Timer
+    );
+
+static
+VOID
+DmfHost_ObjectDestroy(
+    _In_ WDFOBJECT Object
+    )
+/*++
+
+Routine Description:
+
+    Delete an object that has been removed from its parent's list of children.
+    Modules are closed first. Then, the children are deleted (last created first).
+
+Arguments:
+
+    Object - The object to delete.
+
+Return Value:
+
+    None
+
+--*/
+{
+    WDFOBJECT childObject;
+    PLIST_ENTRY listEntry;
+    DMF_HOST_CONTEXT* context;
+
+    if (DmfHostObjectType_Module == Object->ObjectType)
+    {
+        DMF_HOST_MODULE* module = &Object->u.Module;
+
+        if (module->IsOpened)
+        {
+            module->IsOpened = FALSE;
+            if (module->CallbacksDmf.DeviceClose != NULL)
+            {
+                module->CallbacksDmf.DeviceClose(Object);
+            }
+        }
+    }
+    else if (DmfHostObjectType_Timer == Object->ObjectType)
+    {
+        DmfHost_TimerDelete(Object);
+    }
+
+    for (;;)
+    {
+        pthread_mutex_lock(&DmfHost_ObjectTreeLock);
+        if (IsListEmpty(&Object->ChildObjectList))
+        {
+            pthread_mutex_unlock(&DmfHost_ObjectTreeLock);
+            break;
+        }
+        listEntry = RemoveTailList(&Object->ChildObjectList);
+        InitializeListHead(listEntry);
+        pthread_mutex_unlock(&DmfHost_ObjectTreeLock);
+
+        childObject = CONTAINING_RECORD(listEntry,
+                                        struct _DMF_HOST_OBJECT,
+                                        ListEntry);
+        DmfHost_ObjectDestroy(childObject);
+    }
+
+    // As in WDF, all the cleanup callbacks are called before the destroy callbacks.
+    //
+    for (context = Object->ContextList; context != NULL; context = context->NextContext)
+    {
+        if (context->EvtCleanupCallback != NULL)
+        {
+            context->EvtCleanupCallback(Object);
+        }
+    }
+    for (context = Object->ContextList; context != NULL; context = context->NextContext)
+    {
+        if (context->EvtDestroyCallback != NULL)
+        {
+            context->EvtDestroyCallback(Object);
+        }
+    }
+
+    switch (Object->ObjectType)
+    {
+        case DmfHostObjectType_Memory:
+        {
+            if (! Object->u.Memory.Preallocated)
+            {
+                free(Object->u.Memory.Buffer);
+            }
+            break;
+        }
+        case DmfHostObjectType_Timer:
+        {
+            pthread_cond_destroy(&Object->u.Timer.Condition);
+            break;
+        }
+        case DmfHostObjectType_Module:
+        {
+            DMF_HOST_MODULE* module = &Object->u.Module;
+            ULONG lockIndex;
+
+            DmfAssert(0 == module->LockOwner);
+            if (module->AuxiliaryLocks != NULL)
+            {
+                for (lockIndex = 0; lockIndex < module->ModuleDescriptor.NumberOfAuxiliaryLocks; lockIndex++)
+                {
+                    pthread_mutex_destroy(&module->AuxiliaryLocks[lockIndex]);
+                }
+                free(module->AuxiliaryLocks);
+            }
+            free(module->ModuleConfig);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+
+    while (Object->ContextList != NULL)
+    {
+        context = Object->ContextList;
+        Object->ContextList = context->NextContext;
+        free(context);
+    }
+    pthread_mutex_destroy(&Object->Lock);
+    free(Object);
+}
+
+static
+VOID*
+DmfHost_TimerThread(
+    _In_ VOID* Argument
+    )
+/*++
+
+Routine Description:
+
+    Calls the timer's callback each time it expires until the timer is deleted.
+
+Arguments:
+
+    Argument - The timer.
+
+Return Value:
+
+    NULL
+
+--*/
+{
+    WDFTIMER timer;
+    DMF_HOST_TIMER* hostTimer;
+    ULONGLONG currentTime;
+    struct timespec dueTimeSpec;
+
+    timer = (WDFTIMER)Argument;
+    hostTimer = &timer->u.Timer;
+
+    pthread_mutex_lock(&timer->Lock);
+    while (! hostTimer->Exiting)
+    {
+        if (0 == hostTimer->DueTime)
+        {
+            pthread_cond_wait(&hostTimer->Condition,
+                              &timer->Lock);
+            continue;
+        }
+
+        currentTime = DmfHost_NanosecondsGet(CLOCK_MONOTONIC);
+        if (currentTime < hostTimer->DueTime)
+        {
+            DmfHost_TimeSpecGet(hostTimer->DueTime,
+                                &dueTimeSpec);
+            pthread_cond_timedwait(&hostTimer->Condition,
+                                   &timer->Lock,
+                                   &dueTimeSpec);
+            continue;
+        }
+
+        if (hostTimer->Period > 0)
+        {
+            hostTimer->DueTime = currentTime + (hostTimer->Period * NANOSECONDS_PER_MILLISECOND);
+        }
+        else
+        {
+            hostTimer->DueTime = 0;
+        }
+
+        hostTimer->CallbackRunning = TRUE;
+        pthread_mutex_unlock(&timer->Lock);
+        hostTimer->EvtTimerFunc(timer);
+        pthread_mutex_lock(&timer->Lock);
+        hostTimer->CallbackRunning = FALSE;
+        pthread_cond_broadcast(&hostTimer->Condition);
+    }
+    pthread_mutex_unlock(&timer->Lock);
+
+    return NULL;
+}
+
+static
+VOID
+DmfHost_TimerDelete(
+    _In_ WDFTIMER Timer
+    )
+/*++
+
+Routine Description:
+
+    Stop a timer and wait for its thread to end.
+
+Arguments:
+
+    Timer - The timer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_HOST_TIMER* hostTimer;
+
+    hostTimer = &Timer->u.Timer;
+
+    // The timer cannot be deleted by its own callback because its thread cannot wait for itself.
+    //
+    DmfAssert(! pthread_equal(hostTimer->Thread,
+                              pthread_self()));
+
+    pthread_mutex_lock(&Timer->Lock);
+    hostTimer->Exiting = TRUE;
+    hostTimer->DueTime = 0;
+    pthread_cond_broadcast(&hostTimer->Condition);
+    pthread_mutex_unlock(&Timer->Lock);
+
+    pthread_join(hostTimer->Thread,
+                 NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Win32 functions used by DMF_USER_MODE paths
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+DWORD
+GetCurrentProcessorNumber(
+    VOID
+    )
+{
+    int processorIndex;
+
+    processorIndex = sched_getcpu();
+    if (processorIndex < 0)
+    {
+        processorIndex = 0;
+    }
+
+    return (DWORD)processorIndex;
+}
+
+DWORD
+GetMaximumProcessorCount(
+    _In_ WORD GroupNumber
+    )
+{
+    long numberOfProcessors;
+
+    UNREFERENCED_PARAMETER(GroupNumber);
+
+    numberOfProcessors = sysconf(_SC_NPROCESSORS_CONF);
+    if (numberOfProcessors < 1)
+    {
+        numberOfProcessors = 1;
+    }
+
+    return (DWORD)numberOfProcessors;
+}
+
+VOID
+QueryInterruptTime(
+    _Out_ PULONGLONG InterruptTime
+    )
+{
+    // Interrupt time is in 100 nanosecond units.
+    //
+    *InterruptTime = DmfHost_NanosecondsGet(CLOCK_MONOTONIC) / 100;
+}
+
+// Events and thread handles. All the handles share one lock and one condition that is
+// broadcast each time a handle is signaled.
+//
+
+typedef enum
+{
+    DmfHostHandleType_Invalid = 0,
+    DmfHostHandleType_Event,
+    DmfHostHandleType_Thread,
+} DmfHostHandleType;
+
+typedef struct
+{
+    DmfHostHandleType HandleType;
+    // Indicates the event stays signaled until it is reset.
+    //
+    BOOLEAN ManualReset;
+    // Events: the event is set. Threads: the thread has returned.
+    //
+    BOOLEAN Signaled;
+    // Indicates CloseHandle() was called before the thread returned. The thread frees
+    // the handle when it returns.
+    //
+    BOOLEAN Closed;
+    LPTHREAD_START_ROUTINE StartAddress;
+    VOID* Parameter;
+} DMF_HOST_HANDLE;
+
+static pthread_mutex_t DmfHost_HandleLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t DmfHost_HandleCondition;
+static pthread_once_t DmfHost_HandleConditionOnce = PTHREAD_ONCE_INIT;
+
+// Set when a Win32 function fails.
+//
+static __thread DWORD DmfHost_LastError;
+
+static
+VOID
+DmfHost_HandleConditionInitialize(
+    VOID
+    )
+{
+    pthread_condattr_t conditionAttributes;
+
+    // Timeouts are measured with the monotonic clock.
+    //
+    pthread_condattr_init(&conditionAttributes);
+    pthread_condattr_setclock(&conditionAttributes,
+                              CLOCK_MONOTONIC);
+    pthread_cond_init(&DmfHost_HandleCondition,
+                      &conditionAttributes);
+    pthread_condattr_destroy(&conditionAttributes);
+}
+
+static
+BOOLEAN
+DmfHost_HandleConditionWait(
+    _In_ DWORD Milliseconds,
+    _In_ ULONGLONG DueTime
+    )
+/*++
+
+Routine Description:
+
+    Wait for a handle to be signaled. DmfHost_HandleLock is held.
+
+Arguments:
+
+    Milliseconds - INFINITE or the timeout of the caller's wait.
+    DueTime - Monotonic time in nanoseconds when the caller's wait times out.
+
+Return Value:
+
+    FALSE if the wait has timed out.
+
+--*/
+{
+    struct timespec dueTimeSpec;
+
+    if (INFINITE == Milliseconds)
+    {
+        pthread_cond_wait(&DmfHost_HandleCondition,
+                          &DmfHost_HandleLock);
+        return TRUE;
+    }
+
+    if (DmfHost_NanosecondsGet(CLOCK_MONOTONIC) >= DueTime)
+    {
+        return FALSE;
+    }
+
+    DmfHost_TimeSpecGet(DueTime,
+                        &dueTimeSpec);
+    pthread_cond_timedwait(&DmfHost_HandleCondition,
+                           &DmfHost_HandleLock,
+                           &dueTimeSpec);
+    return TRUE;
+}
+
+static
+VOID*
+DmfHost_ThreadStart(
+    _In_ VOID* Argument
+    )
+/*++
+
+Routine Description:
+
+    Calls the thread's start routine then signals the thread handle.
+
+Arguments:
+
+    Argument - The thread handle.
+
+Return Value:
+
+    NULL
+
+--*/
+{
+    DMF_HOST_HANDLE* handle;
+    BOOLEAN closed;
+
+    handle = (DMF_HOST_HANDLE*)Argument;
+
+    handle->StartAddress(handle->Parameter);
+
+    pthread_mutex_lock(&DmfHost_HandleLock);
+    handle->Signaled = TRUE;
+    closed = handle->Closed;
+    pthread_cond_broadcast(&DmfHost_HandleCondition);
+    pthread_mutex_unlock(&DmfHost_HandleLock);
+
+    if (closed)
+    {
+        free(handle);
+    }
+
+    return NULL;
+}
+
+DWORD
+GetLastError(
+    VOID
+    )
+{
+    return DmfHost_LastError;
+}
+
+VOID
+Sleep(
+    _In_ DWORD Milliseconds
+    )
+{
+    struct timespec sleepTime;
+
+    if (0 == Milliseconds)
+    {
+        // Give up the rest of the time slice.
+        //
+        sched_yield();
+        return;
+    }
+
+    DmfHost_TimeSpecGet(Milliseconds * NANOSECONDS_PER_MILLISECOND,
+                        &sleepTime);
+    while ((nanosleep(&sleepTime,
+                      &sleepTime) != 0) &&
+           (EINTR == errno))
+    {
+    }
+}
+
+HANDLE
+CreateEvent(
+    _In_opt_ LPSECURITY_ATTRIBUTES EventAttributes,
+    _In_ BOOL ManualReset,
+    _In_ BOOL InitialState,
+    _In_opt_ PCSTR Name
+    )
+{
+    DMF_HOST_HANDLE* handle;
+
+    UNREFERENCED_PARAMETER(EventAttributes);
+    UNREFERENCED_PARAMETER(Name);
+
+    pthread_once(&DmfHost_HandleConditionOnce,
+                 DmfHost_HandleConditionInitialize);
+
+    handle = (DMF_HOST_HANDLE*)calloc(1,
+                                      sizeof(DMF_HOST_HANDLE));
+    if (NULL == handle)
+    {
+        DmfHost_LastError = ERROR_NOT_ENOUGH_MEMORY;
+        return NULL;
+    }
+
+    handle->HandleType = DmfHostHandleType_Event;
+    handle->ManualReset = (ManualReset != FALSE);
+    handle->Signaled = (InitialState != FALSE);
+
+    return (HANDLE)handle;
+}
+
+BOOL
+SetEvent(
+    _In_ HANDLE Event
+    )
+{
+    DMF_HOST_HANDLE* handle;
+
+    handle = (DMF_HOST_HANDLE*)Event;
+    DmfAssert(DmfHostHandleType_Event == handle->HandleType);
+
+    pthread_mutex_lock(&DmfHost_HandleLock);
+    handle->Signaled = TRUE;
+    pthread_cond_broadcast(&DmfHost_HandleCondition);
+    pthread_mutex_unlock(&DmfHost_HandleLock);
+
+    return TRUE;
+}
+
+BOOL
+ResetEvent(
+    _In_ HANDLE Event
+    )
+{
+    DMF_HOST_HANDLE* handle;
+
+    handle = (DMF_HOST_HANDLE*)Event;
+    DmfAssert(DmfHostHandleType_Event == handle->HandleType);
+
+    pthread_mutex_lock(&DmfHost_HandleLock);
+    handle->Signaled = FALSE;
+    pthread_mutex_unlock(&DmfHost_HandleLock);
+
+    return TRUE;
+}
+
+HANDLE
+CreateThread(
+    _In_opt_ LPSECURITY_ATTRIBUTES ThreadAttributes,
+    _In_ SIZE_T StackSize,
+    _In_ LPTHREAD_START_ROUTINE StartAddress,
+    _In_opt_ VOID* Parameter,
+    _In_ DWORD CreationFlags,
+    _Out_opt_ DWORD* ThreadId
+    )
+{
+    DMF_HOST_HANDLE* handle;
+    pthread_t thread;
+
+    UNREFERENCED_PARAMETER(ThreadAttributes);
+    UNREFERENCED_PARAMETER(StackSize);
+
+    // Threads cannot be created suspended on the host.
+    //
+    DmfAssert(0 == CreationFlags);
+
+    pthread_once(&DmfHost_HandleConditionOnce,
+                 DmfHost_HandleConditionInitialize);
+
+    handle = (DMF_HOST_HANDLE*)calloc(1,
+                                      sizeof(DMF_HOST_HANDLE));
+    if (NULL == handle)
+    {
+        DmfHost_LastError = ERROR_NOT_ENOUGH_MEMORY;
+        return NULL;
+    }
+
+    handle->HandleType = DmfHostHandleType_Thread;
+    handle->StartAddress = StartAddress;
+    handle->Parameter = Parameter;
+
+    if (pthread_create(&thread,
+                       NULL,
+                       DmfHost_ThreadStart,
+                       handle) != 0)
+    {
+        free(handle);
+        DmfHost_LastError = ERROR_NOT_ENOUGH_MEMORY;
+        return NULL;
+    }
+    // The thread is waited for with its handle, not joined.
+    //
+    pthread_detach(thread);
+
+    if (ThreadId != NULL)
+    {
+        *ThreadId = (DWORD)(ULONG_PTR)handle;
+    }
+
+    return (HANDLE)handle;
+}
+
+DWORD
+WaitForSingleObjectEx(
+    _In_ HANDLE Handle,
+    _In_ DWORD Milliseconds,
+    _In_ BOOL Alertable
+    )
+{
+    return WaitForMultipleObjectsEx(1,
+                                    &Handle,
+                                    TRUE,
+                                    Milliseconds,
+                                    Alertable);
+}
+
+DWORD
+WaitForMultipleObjectsEx(
+    _In_ DWORD Count,
+    _In_reads_(Count) CONST HANDLE* Handles,
+    _In_ BOOL WaitAll,
+    _In_ DWORD Milliseconds,
+    _In_ BOOL Alertable
+    )
+/*++
+
+Routine Description:
+
+    Wait for any or all of the given events and threads to be signaled. There are no APCs
+    on the host so the wait is never alerted.
+
+Arguments:
+
+    Count - Number of handles.
+    Handles - The handles.
+    WaitAll - TRUE to wait for all the handles to be signaled at the same time.
+    Milliseconds - Timeout or INFINITE.
+    Alertable - Not used.
+
+Return Value:
+
+    WAIT_OBJECT_0 (plus the index of the signaled handle if WaitAll is FALSE), WAIT_TIMEOUT
+    or WAIT_FAILED.
+
+--*/
+{
+    DMF_HOST_HANDLE* handle;
+    ULONGLONG dueTime;
+    DWORD returnValue;
+    DWORD handleIndex;
+    DWORD signaledCount;
+
+    UNREFERENCED_PARAMETER(Alertable);
+
+    if ((0 == Count) ||
+        (Count > MAXIMUM_WAIT_OBJECTS))
+    {
+        return WAIT_FAILED;
+    }
+
+    dueTime = 0;
+    if (Milliseconds != INFINITE)
+    {
+        dueTime = DmfHost_NanosecondsGet(CLOCK_MONOTONIC) + (Milliseconds * NANOSECONDS_PER_MILLISECOND);
+    }
+
+    pthread_mutex_lock(&DmfHost_HandleLock);
+    for (;;)
+    {
+        signaledCount = 0;
+        returnValue = WAIT_TIMEOUT;
+        for (handleIndex = 0; handleIndex < Count; handleIndex++)
+        {
+            handle = (DMF_HOST_HANDLE*)Handles[handleIndex];
+            if (handle->Signaled)
+            {
+                signaledCount++;
+                if ((! WaitAll) &&
+                    (WAIT_TIMEOUT == returnValue))
+                {
+                    returnValue = WAIT_OBJECT_0 + handleIndex;
+                }
+            }
+        }
+
+        if (WaitAll && (signaledCount == Count))
+        {
+            returnValue = WAIT_OBJECT_0;
+        }
+
+        if (returnValue != WAIT_TIMEOUT)
+        {
+            // Satisfying the wait resets the automatic reset events it was waiting for.
+            //
+            for (handleIndex = 0; handleIndex < Count; handleIndex++)
+            {
+                handle = (DMF_HOST_HANDLE*)Handles[handleIndex];
+                if ((WaitAll || (returnValue == WAIT_OBJECT_0 + handleIndex)) &&
+                    (DmfHostHandleType_Event == handle->HandleType) &&
+                    (! handle->ManualReset))
+                {
+                    handle->Signaled = FALSE;
+                }
+            }
+            break;
+        }
+
+        if (! DmfHost_HandleConditionWait(Milliseconds,
+                                          dueTime))
+        {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&DmfHost_HandleLock);
+
+    return returnValue;
+}
+
+BOOL
+CloseHandle(
+    _In_ HANDLE Object
+    )
+{
+    DMF_HOST_HANDLE* handle;
+    BOOLEAN threadRunning;
+
+    handle = (DMF_HOST_HANDLE*)Object;
+
+    pthread_mutex_lock(&DmfHost_HandleLock);
+    threadRunning = ((DmfHostHandleType_Thread == handle->HandleType) &&
+                     (! handle->Signaled));
+    handle->Closed = TRUE;
+    pthread_mutex_unlock(&DmfHost_HandleLock);
+
+    // A running thread frees its handle when it returns.
+    //
+    if (! threadRunning)
+    {
+        free(handle);
+    }
+
+    return TRUE;
+}
+
+HANDLE
+GetCurrentThread(
+    VOID
+    )
+{
+    // Same value as on Windows.
+    //
+    return (HANDLE)(LONG_PTR)-2;
+}
+
+DWORD_PTR
+SetThreadAffinityMask(
+    _In_ HANDLE Thread,
+    _In_ DWORD_PTR ThreadAffinityMask
+    )
+{
+    cpu_set_t cpuSet;
+    DWORD_PTR previousAffinityMask;
+    ULONG processorIndex;
+
+    // Only the current thread's affinity is set by DMF.
+    //
+    DmfAssert(GetCurrentThread() == Thread);
+    UNREFERENCED_PARAMETER(Thread);
+
+    if (pthread_getaffinity_np(pthread_self(),
+                               sizeof(cpuSet),
+                               &cpuSet) != 0)
+    {
+        DmfHost_LastError = ERROR_INVALID_PARAMETER;
+        return 0;
+    }
+
+    previousAffinityMask = 0;
+    for (processorIndex = 0; processorIndex < sizeof(DWORD_PTR) * 8; processorIndex++)
+    {
+        if (CPU_ISSET(processorIndex,
+                      &cpuSet))
+        {
+            previousAffinityMask |= ((DWORD_PTR)1 << processorIndex);
+        }
+    }
+
+    CPU_ZERO(&cpuSet);
+    for (processorIndex = 0; processorIndex < sizeof(DWORD_PTR) * 8; processorIndex++)
+    {
+        if (ThreadAffinityMask & ((DWORD_PTR)1 << processorIndex))
+        {
+            CPU_SET(processorIndex,
+                    &cpuSet);
+        }
+    }
+
+    if (pthread_setaffinity_np(pthread_self(),
+                               sizeof(cpuSet),
+                               &cpuSet) != 0)
+    {
+        DmfHost_LastError = ERROR_INVALID_PARAMETER;
+        return 0;
+    }
+
+    return previousAffinityMask;
+}
+
+BOOL
+WaitOnAddress(
+    _In_ volatile VOID* Address,
+    _In_ VOID* CompareAddress,
+    _In_ SIZE_T AddressSize,
+    _In_opt_ DWORD Milliseconds
+    )
+/*++
+
+Routine Description:
+
+    Wait until the value at an address differs from a given value or until woken by
+    WakeByAddressSingle()/WakeByAddressAll(). As on Windows, the caller must handle
+    spurious wake ups.
+
+Arguments:
+
+    Address - The address to wait on.
+    CompareAddress - Address of the value the caller has seen at Address.
+    AddressSize - Size of the value (1, 2, 4 or 8 bytes).
+    Milliseconds - Timeout or INFINITE.
+
+Return Value:
+
+    FALSE if the wait has timed out.
+
+--*/
+{
+    ULONGLONG dueTime;
+    BOOL returnValue;
+
+    pthread_once(&DmfHost_HandleConditionOnce,
+                 DmfHost_HandleConditionInitialize);
+
+    dueTime = 0;
+    if (Milliseconds != INFINITE)
+    {
+        dueTime = DmfHost_NanosecondsGet(CLOCK_MONOTONIC) + (Milliseconds * NANOSECONDS_PER_MILLISECOND);
+    }
+
+    returnValue = TRUE;
+    pthread_mutex_lock(&DmfHost_HandleLock);
+    // The waker changes the value before it takes the lock to wake so the change cannot
+    // be missed between this comparison and the wait.
+    //
+    if (0 == memcmp((VOID*)Address,
+                    CompareAddress,
+                    AddressSize))
+    {
+        returnValue = DmfHost_HandleConditionWait(Milliseconds,
+                                                  dueTime);
+    }
+    pthread_mutex_unlock(&DmfHost_HandleLock);
+
+    return returnValue;
+}
+
+VOID
+WakeByAddressSingle(
+    _In_ VOID* Address
+    )
+{
+    // Waiters share one condition so all are woken. They check their own address.
+    //
+    WakeByAddressAll(Address);
+}
+
+VOID
+WakeByAddressAll(
+    _In_ VOID* Address
+    )
+{
+    UNREFERENCED_PARAMETER(Address);
+
+    pthread_once(&DmfHost_HandleConditionOnce,
+                 DmfHost_HandleConditionInitialize);
+
+    pthread_mutex_lock(&DmfHost_HandleLock);
+    pthread_cond_broadcast(&DmfHost_HandleCondition);
+    pthread_mutex_unlock(&DmfHost_HandleLock);
+}
+
+// Interlocked singly linked lists.
+//
+
+static
+VOID
+DmfHost_SListLock(
+    _Inout_ PSLIST_HEADER ListHead
+    )
+{
+    while (__atomic_exchange_n(&ListHead->Lock,
+                               1,
+                               __ATOMIC_ACQUIRE))
+    {
+        while (__atomic_load_n(&ListHead->Lock,
+                               __ATOMIC_RELAXED))
+        {
+            sched_yield();
+        }
+    }
+}
+
+static
+VOID
+DmfHost_SListUnlock(
+    _Inout_ PSLIST_HEADER ListHead
+    )
+{
+    __atomic_store_n(&ListHead->Lock,
+                     0,
+                     __ATOMIC_RELEASE);
+}
+
+VOID
+InitializeSListHead(
+    _Out_ PSLIST_HEADER ListHead
+    )
+{
+    RtlZeroMemory(ListHead,
+                  sizeof(SLIST_HEADER));
+}
+
+PSLIST_ENTRY
+InterlockedPushEntrySList(
+    _Inout_ PSLIST_HEADER ListHead,
+    _Inout_ PSLIST_ENTRY ListEntry
+    )
+{
+    PSLIST_ENTRY firstEntry;
+
+    DmfHost_SListLock(ListHead);
+    firstEntry = ListHead->Next;
+    ListEntry->Next = firstEntry;
+    ListHead->Next = ListEntry;
+    ListHead->Depth++;
+    DmfHost_SListUnlock(ListHead);
+
+    return firstEntry;
+}
+
+PSLIST_ENTRY
+InterlockedPopEntrySList(
+    _Inout_ PSLIST_HEADER ListHead
+    )
+{
+    PSLIST_ENTRY firstEntry;
+
+    DmfHost_SListLock(ListHead);
+    firstEntry = ListHead->Next;
+    if (firstEntry != NULL)
+    {
+        ListHead->Next = firstEntry->Next;
+        ListHead->Depth--;
+    }
+    DmfHost_SListUnlock(ListHead);
+
+    return firstEntry;
+}
+
+PSLIST_ENTRY
+InterlockedFlushSList(
+    _Inout_ PSLIST_HEADER ListHead
+    )
+{
+    PSLIST_ENTRY firstEntry;
+
+    DmfHost_SListLock(ListHead);
+    firstEntry = ListHead->Next;
+    ListHead->Next = NULL;
+    ListHead->Depth = 0;
+    DmfHost_SListUnlock(ListHead);
+
+    return firstEntry;
+}
+
+USHORT
+QueryDepthSList(
+    _In_ PSLIST_HEADER ListHead
+    )
+{
+    return __atomic_load_n(&ListHead->Depth,
+                           __ATOMIC_RELAXED);
+}
+
+// Time.
+//
+
+BOOL
+QueryPerformanceCounter(
+    _Out_ LARGE_INTEGER* PerformanceCount
+    )
+{
+    // The performance counter counts nanoseconds.
+    //
+    PerformanceCount->QuadPart = (LONGLONG)DmfHost_NanosecondsGet(CLOCK_MONOTONIC);
+    return TRUE;
+}
+
+BOOL
+QueryPerformanceFrequency(
+    _Out_ LARGE_INTEGER* Frequency
+    )
+{
+    Frequency->QuadPart = (LONGLONG)NANOSECONDS_PER_SECOND;
+    return TRUE;
+}
+
+VOID
+GetSystemTimePreciseAsFileTime(
+    _Out_ FILETIME* SystemTimeAsFileTime
+    )
+{
+    ULONGLONG systemTime;
+
+    // System time is in 100 nanosecond units since 1601-01-01.
+    //
+    systemTime = (DmfHost_NanosecondsGet(CLOCK_REALTIME) / 100) +
+                 (SYSTEM_TIME_TO_UNIX_SECONDS * (NANOSECONDS_PER_SECOND / 100));
+    SystemTimeAsFileTime->dwLowDateTime = (DWORD)systemTime;
+    SystemTimeAsFileTime->dwHighDateTime = (DWORD)(systemTime >> 32);
+}
+
+VOID
+GetLocalTime(
+    _Out_ SYSTEMTIME* SystemTime
+    )
+{
+    struct timespec timeSpec;
+    struct tm localTime;
+
+    clock_gettime(CLOCK_REALTIME,
+                  &timeSpec);
+    localtime_r(&timeSpec.tv_sec,
+                &localTime);
+
+    SystemTime->wYear = (WORD)(localTime.tm_year + 1900);
+    SystemTime->wMonth = (WORD)(localTime.tm_mon + 1);
+    SystemTime->wDayOfWeek = (WORD)localTime.tm_wday;
+    SystemTime->wDay = (WORD)localTime.tm_mday;
+    SystemTime->wHour = (WORD)localTime.tm_hour;
+    SystemTime->wMinute = (WORD)localTime.tm_min;
+    SystemTime->wSecond = (WORD)localTime.tm_sec;
+    SystemTime->wMilliseconds = (WORD)(timeSpec.tv_nsec / NANOSECONDS_PER_MILLISECOND);
+}
+
+// Operating system version.
+//
+
+HMODULE
+GetModuleHandleW(
+    _In_opt_ PCWSTR ModuleName
+    )
+{
+    UNREFERENCED_PARAMETER(ModuleName);
+
+    return NULL;
+}
+
+VOID*
+GetProcAddress(
+    _In_ HMODULE Module,
+    _In_ PCSTR ProcName
+    )
+{
+    UNREFERENCED_PARAMETER(Module);
+    UNREFERENCED_PARAMETER(ProcName);
+
+    return NULL;
+}
+
+// Random numbers.
+//
+
+errno_t
+rand_s(
+    _Out_ unsigned int* RandomValue
+    )
+{
+    static __thread ULONGLONG state;
+
+    // xorshift64* seeded per thread. This is not a cryptographic generator.
+    //
+    if (0 == state)
+    {
+        state = DmfHost_NanosecondsGet(CLOCK_MONOTONIC) ^ (ULONGLONG)DmfHost_CurrentThreadGet();
+        if (0 == state)
+        {
+            state = 1;
+        }
+    }
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    *RandomValue = (unsigned int)((state * 0x2545F4914F6CDD1DULL) >> 32);
+
+    return 0;
+}
+
+// Strings.
+//
+
+INT
+MultiByteToWideChar(
+    _In_ UINT CodePage,
+    _In_ DWORD Flags,
+    _In_ PCSTR MultiByteString,
+    _In_ INT MultiByteLength,
+    _Out_writes_opt_(WideCharLength) PWSTR WideCharString,
+    _In_ INT WideCharLength
+    )
+{
+    INT characterIndex;
+
+    UNREFERENCED_PARAMETER(CodePage);
+    UNREFERENCED_PARAMETER(Flags);
+
+    // -1 means the string is zero terminated and the terminator is converted.
+    //
+    if (MultiByteLength < 0)
+    {
+        MultiByteLength = (INT)strlen(MultiByteString) + 1;
+    }
+
+    if (0 == WideCharLength)
+    {
+        return MultiByteLength;
+    }
+    if (WideCharLength < MultiByteLength)
+    {
+        return 0;
+    }
+
+    for (characterIndex = 0; characterIndex < MultiByteLength; characterIndex++)
+    {
+        WideCharString[characterIndex] = (WCHAR)(UCHAR)MultiByteString[characterIndex];
+    }
+
+    return MultiByteLength;
+}
+
+INT
+WideCharToMultiByte(
+    _In_ UINT CodePage,
+    _In_ DWORD Flags,
+    _In_ PCWSTR WideCharString,
+    _In_ INT WideCharLength,
+    _Out_writes_opt_(MultiByteLength) PSTR MultiByteString,
+    _In_ INT MultiByteLength,
+    _In_opt_ PCSTR DefaultChar,
+    _Out_opt_ BOOL* UsedDefaultChar
+    )
+{
+    INT characterIndex;
+
+    UNREFERENCED_PARAMETER(CodePage);
+    UNREFERENCED_PARAMETER(Flags);
+
+    if (UsedDefaultChar != NULL)
+    {
+        *UsedDefaultChar = FALSE;
+    }
+
+    // -1 means the string is zero terminated and the terminator is converted.
+    //
+    if (WideCharLength < 0)
+    {
+        WideCharLength = (INT)wcslen(WideCharString) + 1;
+    }
+
+    if (0 == MultiByteLength)
+    {
+        return WideCharLength;
+    }
+    if (MultiByteLength < WideCharLength)
+    {
+        return 0;
+    }
+
+    for (characterIndex = 0; characterIndex < WideCharLength; characterIndex++)
+    {
+        if (WideCharString[characterIndex] > 0x7F)
+        {
+            MultiByteString[characterIndex] = (DefaultChar != NULL) ? *DefaultChar : '?';
+            if (UsedDefaultChar != NULL)
+            {
+                *UsedDefaultChar = TRUE;
+            }
+        }
+        else
+        {
+            MultiByteString[characterIndex] = (CHAR)WideCharString[characterIndex];
+        }
+    }
+
+    return WideCharLength;
+}
+
+errno_t
+strncpy_s(
+    _Out_writes_(DestinationSize) CHAR* Destination,
+    _In_ size_t DestinationSize,
+    _In_ const CHAR* Source,
+    _In_ size_t Count
+    )
+{
+    size_t length;
+
+    if ((NULL == Destination) ||
+        (0 == DestinationSize) ||
+        (NULL == Source))
+    {
+        return EINVAL;
+    }
+
+    length = strnlen(Source,
+                     Count);
+    if (length >= DestinationSize)
+    {
+        Destination[0] = '\0';
+        return ERANGE;
+    }
+
+    RtlCopyMemory(Destination,
+                  Source,
+                  length);
+    Destination[length] = '\0';
+
+    return 0;
+}
+
+errno_t
+wcsncpy_s(
+    _Out_writes_(DestinationSize) WCHAR* Destination,
+    _In_ size_t DestinationSize,
+    _In_ const WCHAR* Source,
+    _In_ size_t Count
+    )
+{
+    size_t length;
+
+    if ((NULL == Destination) ||
+        (0 == DestinationSize) ||
+        (NULL == Source))
+    {
+        return EINVAL;
+    }
+
+    length = wcsnlen(Source,
+                     Count);
+    if (length >= DestinationSize)
+    {
+        Destination[0] = L'\0';
+        return ERANGE;
+    }
+
+    RtlCopyMemory(Destination,
+                  Source,
+                  length * sizeof(WCHAR));
+    Destination[length] = L'\0';
+
+    return 0;
+}
+
+errno_t
+wcscpy_s(
+    _Out_writes_(DestinationSize) WCHAR* Destination,
+    _In_ size_t DestinationSize,
+    _In_ const WCHAR* Source
+    )
+{
+    return wcsncpy_s(Destination,
+                     DestinationSize,
+                     Source,
+                     (size_t)-1);
+}
+
+VOID
+DmfHost_Trace(
+    _In_ ULONG Level,
+    _In_ PCSTR Format,
+    ...
+    )
+/*++
+
+Routine Description:
+
+    Print a trace message if its level is enabled by the DMF_HOST_TRACE_LEVEL environment
+    variable. The arguments are not printed because the format contains WPP specifiers.
+
+Arguments:
+
+    Level - TRACE_LEVEL_* of the message.
+    Format - Format of the message.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG traceLevel;
+    CHAR* traceLevelString;
+
+    traceLevel = __atomic_load_n(&DmfHost_TraceLevel,
+                                 __ATOMIC_RELAXED);
+    if (MAXULONG == traceLevel)
+    {
+        traceLevelString = getenv("DMF_HOST_TRACE_LEVEL");
+        traceLevel = (traceLevelString != NULL) ? (ULONG)strtoul(traceLevelString, NULL, 0) : TRACE_LEVEL_NONE;
+        __atomic_store_n(&DmfHost_TraceLevel,
+                         traceLevel,
+                         __ATOMIC_RELAXED);
+    }
+
+    if (Level <= traceLevel)
+    {
+        fprintf(stderr,
+                "[%u] %s\n",
+                Level,
+                Format);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF objects
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+VOID*
+WdfObjectGetTypedContextWorker(
+    _In_ WDFOBJECT Handle,
+    _In_ PCWDF_OBJECT_CONTEXT_TYPE_INFO TypeInfo
+    )
+{
+    DMF_HOST_CONTEXT* context;
+
+    context = __atomic_load_n(&Handle->ContextList,
+                              __ATOMIC_ACQUIRE);
+    while (context != NULL)
+    {
+        if (TypeInfo == context->ContextTypeInfo)
+        {
+            return (UCHAR*)context + DMF_HOST_CONTEXT_OFFSET;
+        }
+        context = __atomic_load_n(&context->NextContext,
+                                  __ATOMIC_ACQUIRE);
+    }
+
+    return NULL;
+}
+
+NTSTATUS
+WdfObjectCreate(
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+    _Out_ WDFOBJECT* Object
+    )
+{
+    return DmfHost_ObjectCreate(Attributes,
+                                NULL,
+                                DmfHostObjectType_Base,
+                                NULL,
+                                Object);
+}
+
+NTSTATUS
+WdfObjectAllocateContext(
+    _In_ WDFOBJECT Handle,
+    _In_ PWDF_OBJECT_ATTRIBUTES ContextAttributes,
+    _Outptr_opt_ VOID** Context
+    )
+{
+    if (NULL == ContextAttributes->ContextTypeInfo)
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    return DmfHost_ContextAllocate(Handle,
+                                   ContextAttributes,
+                                   Context);
+}
+
+VOID
+WdfObjectDelete(
+    _In_ WDFOBJECT Object
+    )
+/*++
+
+Routine Description:
+
+    Delete an object and all its children.
+
+Arguments:
+
+    Object - The object to delete.
+
+Return Value:
+
+    None
+
+--*/
+{
+    pthread_mutex_lock(&DmfHost_ObjectTreeLock);
+    RemoveEntryList(&Object->ListEntry);
+    InitializeListHead(&Object->ListEntry);
+    pthread_mutex_unlock(&DmfHost_ObjectTreeLock);
+
+    DmfHost_ObjectDestroy(Object);
+}
+
+_Must_inspect_result_
+NTSTATUS
+DmfHost_DeviceCreate(
+    _Out_ WDFDEVICE* Device
+    )
+/*++
+
+Routine Description:
+
+    Create an object that plays the role of the Client Driver's device.
+
+Arguments:
+
+    Device - Receives the device.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    return DmfHost_ObjectCreate(WDF_NO_OBJECT_ATTRIBUTES,
+                                NULL,
+                                DmfHostObjectType_Device,
+                                NULL,
+                                Device);
+}
+
+NTSTATUS
+WdfMemoryCreate(
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+    _In_ POOL_TYPE PoolType,
+    _In_opt_ ULONG PoolTag,
+    _In_ size_t BufferSize,
+    _Out_ WDFMEMORY* Memory,
+    _Outptr_opt_ VOID** Buffer
+    )
+/*++
+
+Routine Description:
+
+    Create a memory object and allocate its buffer. Like WDF, the buffer is not zeroed.
+
+Arguments:
+
+    Attributes - Optional attributes of the memory object.
+    PoolType - Not used on the host.
+    PoolTag - Not used on the host.
+    BufferSize - Size of the buffer in bytes.
+    Memory - Receives the memory object.
+    Buffer - Optionally receives the address of the buffer.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDFMEMORY memory;
+    VOID* buffer;
+
+    UNREFERENCED_PARAMETER(PoolType);
+    UNREFERENCED_PARAMETER(PoolTag);
+
+    *Memory = NULL;
+    if (Buffer != NULL)
+    {
+        *Buffer = NULL;
+    }
+
+    if (0 == BufferSize)
+    {
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    if (0 != posix_memalign(&buffer,
+                            MEMORY_ALLOCATION_ALIGNMENT,
+                            BufferSize))
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        goto Exit;
+    }
+
+    ntStatus = DmfHost_ObjectCreate(Attributes,
+                                    NULL,
+                                    DmfHostObjectType_Memory,
+                                    NULL,
+                                    &memory);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        free(buffer);
+        goto Exit;
+    }
+
+    memory->u.Memory.Buffer = buffer;
+    memory->u.Memory.BufferSize = BufferSize;
+
+    *Memory = memory;
+    if (Buffer != NULL)
+    {
+        *Buffer = buffer;
+    }
+
+Exit:
+
+    return ntStatus;
+}
+
+NTSTATUS
+WdfMemoryCreatePreallocated(
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+    _In_ VOID* Buffer,
+    _In_ size_t BufferSize,
+    _Out_ WDFMEMORY* Memory
+    )
+/*++
+
+Routine Description:
+
+    Create a memory object for a buffer that the caller owns.
+
+Arguments:
+
+    Attributes - Optional attributes of the memory object.
+    Buffer - The buffer.
+    BufferSize - Size of the buffer in bytes.
+    Memory - Receives the memory object.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+
+    ntStatus = DmfHost_ObjectCreate(Attributes,
+                                    NULL,
+                                    DmfHostObjectType_Memory,
+                                    NULL,
+                                    Memory);
+    if (NT_SUCCESS(ntStatus))
+    {
+        (*Memory)->u.Memory.Buffer = Buffer;
+        (*Memory)->u.Memory.BufferSize = BufferSize;
+        (*Memory)->u.Memory.Preallocated = TRUE;
+    }
+
+    return ntStatus;
+}
+
+VOID*
+WdfMemoryGetBuffer(
+    _In_ WDFMEMORY Memory,
+    _Out_opt_ size_t* BufferSize
+    )
+{
+    DmfAssert(DmfHostObjectType_Memory == Memory->ObjectType);
+
+    if (BufferSize != NULL)
+    {
+        *BufferSize = Memory->u.Memory.BufferSize;
+    }
+
+    return Memory->u.Memory.Buffer;
+}
+
+// Spin locks and wait locks are both mutexes on the host.
+//
+
+NTSTATUS
+WdfSpinLockCreate(
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES SpinLockAttributes,
+    _Out_ WDFSPINLOCK* SpinLock
+    )
+{
+    return DmfHost_ObjectCreate(SpinLockAttributes,
+                                NULL,
+                                DmfHostObjectType_SpinLock,
+                                NULL,
+                                SpinLock);
+}
+
+VOID
+WdfSpinLockAcquire(
+    _In_ WDFSPINLOCK SpinLock
+    )
+{
+    pthread_mutex_lock(&SpinLock->Lock);
+}
+
+VOID
+WdfSpinLockRelease(
+    _In_ WDFSPINLOCK SpinLock
+    )
+{
+    pthread_mutex_unlock(&SpinLock->Lock);
+}
+
+NTSTATUS
+WdfWaitLockCreate(
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES LockAttributes,
+    _Out_ WDFWAITLOCK* Lock
+    )
+{
+    return DmfHost_ObjectCreate(LockAttributes,
+                                NULL,
+                                DmfHostObjectType_WaitLock,
+                                NULL,
+                                Lock);
+}
+
+NTSTATUS
+WdfWaitLockAcquire(
+    _In_ WDFWAITLOCK Lock,
+    _In_opt_ LONGLONG* Timeout
+    )
+/*++
+
+Routine Description:
+
+    Acquire a wait lock.
+
+Arguments:
+
+    Lock - The wait lock.
+    Timeout - Optional relative timeout (negative, in 100 nanosecond units). Zero means
+              the lock is only acquired if it is available.
+
+Return Value:
+
+    STATUS_SUCCESS if the lock is acquired, STATUS_TIMEOUT otherwise.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    struct timespec timeoutSpec;
+    int result;
+
+    if (NULL == Timeout)
+    {
+        result = pthread_mutex_lock(&Lock->Lock);
+    }
+    else if (0 == *Timeout)
+    {
+        result = pthread_mutex_trylock(&Lock->Lock);
+    }
+    else
+    {
+        DmfAssert(*Timeout < 0);
+        DmfHost_TimeSpecGet(DmfHost_NanosecondsGet(CLOCK_REALTIME) + (ULONGLONG)(-*Timeout) * 100,
+                            &timeoutSpec);
+        result = pthread_mutex_timedlock(&Lock->Lock,
+                                         &timeoutSpec);
+    }
+
+    ntStatus = (0 == result) ? STATUS_SUCCESS : STATUS_TIMEOUT;
+
+    return ntStatus;
+}
+
+VOID
+WdfWaitLockRelease(
+    _In_ WDFWAITLOCK Lock
+    )
+{
+    pthread_mutex_unlock(&Lock->Lock);
+}
+
+NTSTATUS
+WdfTimerCreate(
+    _In_ PWDF_TIMER_CONFIG Config,
+    _In_ PWDF_OBJECT_ATTRIBUTES Attributes,
+    _Out_ WDFTIMER* Timer
+    )
+/*++
+
+Routine Description:
+
+    Create a timer and the thread that calls its callback.
+
+Arguments:
+
+    Config - Timer configuration.
+    Attributes - Attributes of the timer. The parent object is mandatory.
+    Timer - Receives the timer.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDFTIMER timer;
+    pthread_condattr_t conditionAttributes;
+
+    *Timer = NULL;
+
+    if ((NULL == Config->EvtTimerFunc) ||
+        (NULL == Attributes) ||
+        (NULL == Attributes->ParentObject))
+    {
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    ntStatus = DmfHost_ObjectCreate(Attributes,
+                                    NULL,
+                                    DmfHostObjectType_Timer,
+                                    NULL,
+                                    &timer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    timer->u.Timer.EvtTimerFunc = Config->EvtTimerFunc;
+    timer->u.Timer.Period = Config->Period;
+
+    pthread_condattr_init(&conditionAttributes);
+    pthread_condattr_setclock(&conditionAttributes,
+                              CLOCK_MONOTONIC);
+    pthread_cond_init(&timer->u.Timer.Condition,
+                      &conditionAttributes);
+    pthread_condattr_destroy(&conditionAttributes);
+
+    if (0 != pthread_create(&timer->u.Timer.Thread,
+                            NULL,
+                            DmfHost_TimerThread,
+                            timer))
+    {
+        // There is no thread to join.
+        //
+        timer->ObjectType = DmfHostObjectType_Invalid;
+        pthread_cond_destroy(&timer->u.Timer.Condition);
+        WdfObjectDelete(timer);
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        goto Exit;
+    }
+
+    *Timer = timer;
+
+Exit:
+
+    return ntStatus;
+}
+
+BOOLEAN
+WdfTimerStart(
+    _In_ WDFTIMER Timer,
+    _In_ LONGLONG DueTime
+    )
+/*++
+
+Routine Description:
+
+    Start (or restart) a timer.
+
+Arguments:
+
+    Timer - The timer.
+    DueTime - Negative: relative time. Positive: absolute system time. In 100 nanosecond units.
+
+Return Value:
+
+    TRUE if the timer was already queued.
+
+--*/
+{
+    DMF_HOST_TIMER* hostTimer;
+    BOOLEAN timerWasQueued;
+    ULONGLONG currentTime;
+    ULONGLONG relativeTime;
+    ULONGLONG systemTime;
+
+    hostTimer = &Timer->u.Timer;
+    currentTime = DmfHost_NanosecondsGet(CLOCK_MONOTONIC);
+
+    if (DueTime < 0)
+    {
+        relativeTime = (ULONGLONG)(-DueTime) * 100;
+    }
+    else
+    {
+        systemTime = DmfHost_NanosecondsGet(CLOCK_REALTIME) + (SYSTEM_TIME_TO_UNIX_SECONDS * NANOSECONDS_PER_SECOND);
+        relativeTime = ((ULONGLONG)DueTime * 100 > systemTime) ? ((ULONGLONG)DueTime * 100) - systemTime : 0;
+    }
+
+    pthread_mutex_lock(&Timer->Lock);
+    timerWasQueued = (hostTimer->DueTime != 0);
+    // Zero means not queued.
+    //
+    hostTimer->DueTime = currentTime + relativeTime + 1;
+    pthread_cond_broadcast(&hostTimer->Condition);
+    pthread_mutex_unlock(&Timer->Lock);
+
+    return timerWasQueued;
+}
+
+BOOLEAN
+WdfTimerStop(
+    _In_ WDFTIMER Timer,
+    _In_ BOOLEAN Wait
+    )
+/*++
+
+Routine Description:
+
+    Stop a timer.
+
+Arguments:
+
+    Timer - The timer.
+    Wait - If TRUE, wait for the timer's callback to return (unless it is the caller).
+
+Return Value:
+
+    TRUE if the timer was queued.
+
+--*/
+{
+    DMF_HOST_TIMER* hostTimer;
+    BOOLEAN timerWasQueued;
+
+    hostTimer = &Timer->u.Timer;
+
+    pthread_mutex_lock(&Timer->Lock);
+    timerWasQueued = (hostTimer->DueTime != 0);
+    hostTimer->DueTime = 0;
+    pthread_cond_broadcast(&hostTimer->Condition);
+    if (Wait &&
+        (! pthread_equal(hostTimer->Thread,
+                         pthread_self())))
+    {
+        while (hostTimer->CallbackRunning)
+        {
+            pthread_cond_wait(&hostTimer->Condition,
+                              &Timer->Lock);
+        }
+    }
+    pthread_mutex_unlock(&Timer->Lock);
+
+    return timerWasQueued;
+}
+
+WDFOBJECT
+WdfTimerGetParentObject(
+    _In_ WDFTIMER Timer
+    )
+{
+    return Timer->ParentObject;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Modules
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_ModuleCreate(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* DmfModuleObjectAttributes,
+    _In_ DMF_MODULE_DESCRIPTOR* ModuleDescriptor,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create a Module, add its Child Modules and open it. The Module is a child of the parent
+    object in DmfModuleObjectAttributes (or of Device).
+
+Arguments:
+
+    Device - Client Driver's device.
+    DmfModuleAttributes - Module attributes set by the Client.
+    DmfModuleObjectAttributes - Object attributes of the Module.
+    ModuleDescriptor - Module descriptor set by the Module's Create function.
+    DmfModule - Receives the Module.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMFMODULE dmfModule;
+    DMF_HOST_MODULE* module;
+    DMF_HOST_MODULE_INIT moduleInit;
+    ULONG lockIndex;
+
+    *DmfModule = NULL;
+
+    if ((DmfModuleAttributes->ModuleConfigPointer != NULL) &&
+        (DmfModuleAttributes->SizeOfModuleSpecificConfig != ModuleDescriptor->ModuleConfigSize))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Invalid Module Config size");
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    ntStatus = DmfHost_ObjectCreate(DmfModuleObjectAttributes,
+                                    Device,
+                                    DmfHostObjectType_Module,
+                                    ModuleDescriptor->ModuleContextAttributes,
+                                    &dmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    module = &dmfModule->u.Module;
+    module->Device = Device;
+    module->ModuleDescriptor = *ModuleDescriptor;
+    module->ModuleDescriptor.ModuleContextAttributes = NULL;
+    if (ModuleDescriptor->CallbacksDmf != NULL)
+    {
+        module->CallbacksDmf = *ModuleDescriptor->CallbacksDmf;
+    }
+    module->ModuleDescriptor.CallbacksDmf = &module->CallbacksDmf;
+
+    if (ModuleDescriptor->ModuleOptions & DMF_MODULE_OPTIONS_PASSIVE)
+    {
+        module->PassiveLevel = TRUE;
+    }
+    else if (ModuleDescriptor->ModuleOptions & DMF_MODULE_OPTIONS_DISPATCH_MAXIMUM)
+    {
+        module->PassiveLevel = DmfModuleAttributes->PassiveLevel;
+    }
+
+    module->ModuleConfig = calloc(1,
+                                  (ModuleDescriptor->ModuleConfigSize > 0) ? ModuleDescriptor->ModuleConfigSize : 1);
+    if (NULL == module->ModuleConfig)
+    {
+        WdfObjectDelete(dmfModule);
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        goto Exit;
+    }
+    if (DmfModuleAttributes->ModuleConfigPointer != NULL)
+    {
+        RtlCopyMemory(module->ModuleConfig,
+                      DmfModuleAttributes->ModuleConfigPointer,
+                      ModuleDescriptor->ModuleConfigSize);
+    }
+
+    if (ModuleDescriptor->NumberOfAuxiliaryLocks > 0)
+    {
+        module->AuxiliaryLocks = (pthread_mutex_t*)calloc(ModuleDescriptor->NumberOfAuxiliaryLocks,
+                                                          sizeof(pthread_mutex_t));
+        if (NULL == module->AuxiliaryLocks)
+        {
+            WdfObjectDelete(dmfModule);
+            ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+            goto Exit;
+        }
+        for (lockIndex = 0; lockIndex < ModuleDescriptor->NumberOfAuxiliaryLocks; lockIndex++)
+        {
+            pthread_mutex_init(&module->AuxiliaryLocks[lockIndex],
+                               NULL);
+        }
+    }
+
+    // Child Modules are created and opened before their parent is opened.
+    //
+    if (module->CallbacksDmf.ChildModulesAdd != NULL)
+    {
+        moduleInit.DmfModule = dmfModule;
+        moduleInit.NtStatus = STATUS_SUCCESS;
+        module->CallbacksDmf.ChildModulesAdd(dmfModule,
+                                             DmfModuleAttributes,
+                                             (PDMFMODULE_INIT)&moduleInit);
+        if (! NT_SUCCESS(moduleInit.NtStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Child Module create fails");
+            WdfObjectDelete(dmfModule);
+            ntStatus = moduleInit.NtStatus;
+            goto Exit;
+        }
+    }
+
+    if (module->CallbacksDmf.DeviceOpen != NULL)
+    {
+        ntStatus = module->CallbacksDmf.DeviceOpen(dmfModule);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DeviceOpen fails");
+            WdfObjectDelete(dmfModule);
+            goto Exit;
+        }
+    }
+    module->IsOpened = TRUE;
+
+    *DmfModule = dmfModule;
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_DmfModuleAdd(
+    _Inout_ PDMFMODULE_INIT DmfModuleInit,
+    _In_ DMF_MODULE_ATTRIBUTES* ModuleAttributes,
+    _In_opt_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _In_opt_ DMFMODULE* ResultantDmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create a Child Module of the Module whose ChildModulesAdd callback is running.
+
+Arguments:
+
+    DmfModuleInit - Passed by DMF_ModuleCreate() to the parent's ChildModulesAdd callback.
+    ModuleAttributes - Attributes of the Child Module.
+    ObjectAttributes - Optional object attributes of the Child Module.
+    ResultantDmfModule - Optionally receives the Child Module.
+
+Return Value:
+
+    None. If the Child Module cannot be created, the parent Module is not created.
+
+--*/
+{
+    DMF_HOST_MODULE_INIT* moduleInit;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMFMODULE dmfModule;
+    NTSTATUS ntStatus;
+
+    moduleInit = (DMF_HOST_MODULE_INIT*)DmfModuleInit;
+    dmfModule = NULL;
+
+    if (! NT_SUCCESS(moduleInit->NtStatus))
+    {
+        goto Exit;
+    }
+
+    if (ObjectAttributes != WDF_NO_OBJECT_ATTRIBUTES)
+    {
+        objectAttributes = *ObjectAttributes;
+    }
+    else
+    {
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    }
+    objectAttributes.ParentObject = moduleInit->DmfModule;
+
+    ntStatus = ModuleAttributes->InstanceCreator(moduleInit->DmfModule->u.Module.Device,
+                                                 ModuleAttributes,
+                                                 &objectAttributes,
+                                                 &dmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        moduleInit->NtStatus = ntStatus;
+        dmfModule = NULL;
+    }
+
+Exit:
+
+    if (ResultantDmfModule != NULL)
+    {
+        *ResultantDmfModule = dmfModule;
+    }
+}
+
+VOID*
+DMF_ModuleConfigGet(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DmfAssert(DmfHostObjectType_Module == DmfModule->ObjectType);
+
+    return DmfModule->u.Module.ModuleConfig;
+}
+
+WDFDEVICE
+DMF_ParentDeviceGet(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DmfAssert(DmfHostObjectType_Module == DmfModule->ObjectType);
+
+    return DmfModule->u.Module.Device;
+}
+
+DMFMODULE
+DMF_ParentModuleGet(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMFMODULE parentDmfModule;
+
+    parentDmfModule = DmfModule->ParentObject;
+    if ((parentDmfModule != NULL) &&
+        (parentDmfModule->ObjectType != DmfHostObjectType_Module))
+    {
+        parentDmfModule = NULL;
+    }
+
+    return parentDmfModule;
+}
+
+_Must_inspect_result_
+BOOLEAN
+DMF_IsModulePassiveLevel(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    return DmfModule->u.Module.PassiveLevel;
+}
+
+_Must_inspect_result_
+BOOLEAN
+DMF_ModuleLockIsPassive(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    return DmfModule->u.Module.PassiveLevel;
+}
+
+_Must_inspect_result_
+BOOLEAN
+DMF_IsPoolTypePassiveLevel(
+    _In_ POOL_TYPE PoolType
+    )
+{
+    return (PagedPool == PoolType);
+}
+
+_Must_inspect_result_
+BOOLEAN
+DMF_ModuleIsLocked(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    return (__atomic_load_n(&DmfModule->u.Module.LockOwner,
+                            __ATOMIC_RELAXED) == DmfHost_CurrentThreadGet());
+}
+
+VOID
+DMF_ModuleLockPrivate(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DmfAssert(! DMF_ModuleIsLocked(DmfModule));
+
+    pthread_mutex_lock(&DmfModule->Lock);
+    __atomic_store_n(&DmfModule->u.Module.LockOwner,
+                     DmfHost_CurrentThreadGet(),
+                     __ATOMIC_RELAXED);
+}
+
+VOID
+DMF_ModuleUnlockPrivate(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    __atomic_store_n(&DmfModule->u.Module.LockOwner,
+                     0,
+                     __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&DmfModule->Lock);
+}
+
+VOID
+DMF_ModuleAuxiliaryLockPrivate(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG AuxiliaryLockIndex
+    )
+{
+    DmfAssert(AuxiliaryLockIndex < DmfModule->u.Module.ModuleDescriptor.NumberOfAuxiliaryLocks);
+
+    pthread_mutex_lock(&DmfModule->u.Module.AuxiliaryLocks[AuxiliaryLockIndex]);
+}
+
+VOID
+DMF_ModuleAuxiliaryUnlockPrivate(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG AuxiliaryLockIndex
+    )
+{
+    DmfAssert(AuxiliaryLockIndex < DmfModule->u.Module.ModuleDescriptor.NumberOfAuxiliaryLocks);
+
+    pthread_mutex_unlock(&DmfModule->u.Module.AuxiliaryLocks[AuxiliaryLockIndex]);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Framework functions used by the Portable Api, the Modules and the Test Modules
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+VOID*
+DMF_GenericMemoryAllocate(
+    _In_ ULONG64 PoolFlags,
+    _In_ size_t Size,
+    _In_ ULONG Tag
+    )
+{
+    UNREFERENCED_PARAMETER(PoolFlags);
+    UNREFERENCED_PARAMETER(Tag);
+
+    return malloc(Size);
+}
+
+VOID
+DMF_GenericMemoryFree(
+    _In_ VOID* Pointer,
+    _In_ ULONG Tag
+    )
+{
+    UNREFERENCED_PARAMETER(Tag);
+
+    free(Pointer);
+}
+
+VOID
+DMF_Utility_DelayMilliseconds(
+    _In_ ULONG Milliseconds
+    )
+{
+    Sleep(Milliseconds);
+}
+
+_Must_inspect_result_
+BOOLEAN
+DMF_Utility_IsEqualGUID(
+    _In_ GUID* Guid1,
+    _In_ GUID* Guid2
+    )
+{
+    return (0 == memcmp(Guid1,
+                        Guid2,
+                        sizeof(GUID)));
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Utility_LogEmitString(
+    _In_ DMFMODULE DmfModule,
+    _In_ DmfLogDataSeverity DmfLogDataSeverity,
+    _In_z_ WCHAR* FormatString,
+    ...
+    )
+{
+    UNREFERENCED_PARAMETER(DmfModule);
+    UNREFERENCED_PARAMETER(DmfLogDataSeverity);
+    UNREFERENCED_PARAMETER(FormatString);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Registry Module
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+DMF_MODULE_DECLARE_NO_CONFIG(Registry)
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Registry_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+{
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Registry;
+
+    DMF_MODULE_DESCRIPTOR_INIT(dmfModuleDescriptor_Registry,
+                               Registry,
+                               DMF_MODULE_OPTIONS_PASSIVE,
+                               DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    return DMF_ModuleCreate(Device,
+                            DmfModuleAttributes,
+                            ObjectAttributes,
+                            &dmfModuleDescriptor_Registry,
+                            DmfModule);
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Registry_PathAndValueReadDwordAndValidate(
+    _In_ DMFMODULE DmfModule,
+    _In_opt_z_ CONST WCHAR* RegistryPathName,
+    _In_z_ CONST WCHAR* ValueName,
+    _Out_ ULONG* Buffer,
+    _In_ ULONG Minimum,
+    _In_ ULONG Maximum
+    )
+{
+    UNREFERENCED_PARAMETER(DmfModule);
+    UNREFERENCED_PARAMETER(RegistryPathName);
+    UNREFERENCED_PARAMETER(ValueName);
+    UNREFERENCED_PARAMETER(Minimum);
+    UNREFERENCED_PARAMETER(Maximum);
+
+    *Buffer = 0;
+
+    return STATUS_NOT_SUPPORTED;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Registry_PathAndValueWriteDword(
+    _In_ DMFMODULE DmfModule,
+    _In_opt_z_ CONST WCHAR* RegistryPathName,
+    _In_z_ CONST WCHAR* ValueName,
+    _In_ ULONG ValueData
+    )
+{
+    UNREFERENCED_PARAMETER(DmfModule);
+    UNREFERENCED_PARAMETER(RegistryPathName);
+    UNREFERENCED_PARAMETER(ValueName);
+    UNREFERENCED_PARAMETER(ValueData);
+
+    return STATUS_NOT_SUPPORTED;
+}
+
+// eof: DmfHost.c
+//
@@ -0,0 +1,1056 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfHostBenchmark.c
+
+Abstract:
+
+    Measures the HashTable, RingBuffer and BufferPool Modules in the host build and verifies
+    the data they return. For each benchmark, prints the number of operations, the average
+    time per operation, the throughput and (for single threaded benchmarks) the median and
+    99th percentile latency measured in a separate pass.
+
+    Usage: DmfHostBenchmark [-quick]
+        -quick: Run few iterations (used by ctest).
+
+Environment:
+
+    Host (POSIX)
+
+--*/
+
+#include "DmfModule.h"
+#include "DmfModules.Library.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Definitions
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Performs operation number OperationIndex of a benchmark. Returns FALSE if the result is wrong.
+//
+typedef
+BOOLEAN
+EVT_DmfHostBenchmark_Operation(_In_ VOID* BenchmarkContext,
+                               _In_ ULONG OperationIndex);
+
+#define HASHTABLE_KEY_LENGTH            16
+#define HASHTABLE_VALUE_LENGTH          8
+#define HASHTABLE_NUMBER_OF_KEYS        4096
+
+#define RINGBUFFER_ITEM_COUNT           1024
+#define RINGBUFFER_ITEM_SIZE            64
+
+#define BUFFERPOOL_BUFFER_COUNT         256
+#define BUFFERPOOL_BUFFER_SIZE          256
+#define BUFFERPOOL_BATCH_SIZE           16
+#define BUFFERPOOL_THREADS_MAXIMUM      4
+
+// Number of operations whose latency is measured.
+//
+#define LATENCY_SAMPLE_COUNT            (64 * 1024)
+
+typedef struct
+{
+    DMFMODULE DmfModule;
+    // HASHTABLE_NUMBER_OF_KEYS keys followed by HASHTABLE_NUMBER_OF_KEYS keys never written.
+    //
+    UCHAR (*Keys)[HASHTABLE_KEY_LENGTH];
+} HASHTABLE_BENCHMARK_CONTEXT;
+
+typedef struct
+{
+    DMFMODULE DmfModule;
+    // Sequence number of the next item written and of the next item read.
+    //
+    ULONGLONG WriteSequence;
+    ULONGLONG ReadSequence;
+    // Number of items the consumer thread reads.
+    //
+    ULONGLONG ItemsToRead;
+    BOOLEAN Failed;
+} RINGBUFFER_BENCHMARK_CONTEXT;
+
+typedef struct
+{
+    DMFMODULE DmfModule;
+    ULONGLONG OperationsPerThread;
+    BOOLEAN Failed;
+} BUFFERPOOL_BENCHMARK_CONTEXT;
+
+// Number of iterations of each benchmark.
+//
+static ULONG Benchmark_Iterations = 2 * 1000 * 1000;
+
+// Number of benchmarks whose verification failed.
+//
+static ULONG Benchmark_Failures;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Benchmark Harness
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+static
+ULONGLONG
+Benchmark_NanosecondsGet(
+    VOID
+    )
+{
+    struct timespec timeSpec;
+
+    clock_gettime(CLOCK_MONOTONIC,
+                  &timeSpec);
+    return ((ULONGLONG)timeSpec.tv_sec * 1000000000ULL) + (ULONGLONG)timeSpec.tv_nsec;
+}
+
+static
+int
+Benchmark_LatencyCompare(
+    _In_ const void* Latency1,
+    _In_ const void* Latency2
+    )
+{
+    ULONGLONG latency1 = *(const ULONGLONG*)Latency1;
+    ULONGLONG latency2 = *(const ULONGLONG*)Latency2;
+
+    return (latency1 > latency2) - (latency1 < latency2);
+}
+
+static
+VOID
+Benchmark_ResultPrint(
+    _In_ PCSTR BenchmarkName,
+    _In_ ULONGLONG NumberOfOperations,
+    _In_ ULONGLONG ElapsedNanoseconds,
+    _In_opt_ ULONGLONG* Latencies,
+    _In_ ULONG NumberOfLatencies,
+    _In_ BOOLEAN Passed
+    )
+/*++
+
+Routine Description:
+
+    Print the results of a benchmark.
+
+Arguments:
+
+    BenchmarkName - Name of the benchmark.
+    NumberOfOperations - Number of operations measured.
+    ElapsedNanoseconds - Time taken by all the operations.
+    Latencies - Optional latencies of some operations. The array is sorted.
+    NumberOfLatencies - Number of entries in Latencies.
+    Passed - Indicates the results of the operations were correct.
+
+Return Value:
+
+    None
+
+--*/
+{
+    double nanosecondsPerOperation;
+    double millionOperationsPerSecond;
+
+    if (0 == ElapsedNanoseconds)
+    {
+        ElapsedNanoseconds = 1;
+    }
+    nanosecondsPerOperation = (double)ElapsedNanoseconds / (double)NumberOfOperations;
+    millionOperationsPerSecond = ((double)NumberOfOperations * 1000.0) / (double)ElapsedNanoseconds;
+
+    printf("%-52s %10" PRIu64 " ops %9.1f ns/op %9.2f Mops/s",
+           BenchmarkName,
+           NumberOfOperations,
+           nanosecondsPerOperation,
+           millionOperationsPerSecond);
+    if ((Latencies != NULL) &&
+        (NumberOfLatencies > 0))
+    {
+        qsort(Latencies,
+              NumberOfLatencies,
+              sizeof(ULONGLONG),
+              Benchmark_LatencyCompare);
+        printf("  p50 %5" PRIu64 " ns  p99 %6" PRIu64 " ns",
+               Latencies[NumberOfLatencies / 2],
+               Latencies[(NumberOfLatencies * 99ULL) / 100]);
+    }
+    printf("%s\n",
+           Passed ? "" : "  FAILED");
+
+    if (! Passed)
+    {
+        Benchmark_Failures++;
+    }
+}
+
+static
+VOID
+Benchmark_Run(
+    _In_ PCSTR BenchmarkName,
+    _In_ EVT_DmfHostBenchmark_Operation* Operation,
+    _In_ VOID* BenchmarkContext,
+    _In_ ULONG NumberOfOperations
+    )
+/*++
+
+Routine Description:
+
+    Run a single threaded benchmark: a throughput pass over all the operations, then a pass
+    that measures the latency of each of the first LATENCY_SAMPLE_COUNT operations.
+
+Arguments:
+
+    BenchmarkName - Name of the benchmark.
+    Operation - Performs one operation.
+    BenchmarkContext - Passed to Operation.
+    NumberOfOperations - Number of operations in the throughput pass.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONGLONG* latencies;
+    ULONG numberOfLatencies;
+    ULONGLONG startTime;
+    ULONGLONG elapsedTime;
+    ULONGLONG operationStartTime;
+    ULONG operationIndex;
+    BOOLEAN passed;
+
+    passed = TRUE;
+
+    startTime = Benchmark_NanosecondsGet();
+    for (operationIndex = 0; operationIndex < NumberOfOperations; operationIndex++)
+    {
+        if (! Operation(BenchmarkContext,
+                        operationIndex))
+        {
+            passed = FALSE;
+            break;
+        }
+    }
+    elapsedTime = Benchmark_NanosecondsGet() - startTime;
+
+    numberOfLatencies = (NumberOfOperations < LATENCY_SAMPLE_COUNT) ? NumberOfOperations : LATENCY_SAMPLE_COUNT;
+    latencies = (ULONGLONG*)malloc(numberOfLatencies * sizeof(ULONGLONG));
+    if (NULL == latencies)
+    {
+        numberOfLatencies = 0;
+    }
+    for (operationIndex = 0; passed && (operationIndex < numberOfLatencies); operationIndex++)
+    {
+        operationStartTime = Benchmark_NanosecondsGet();
+        passed = Operation(BenchmarkContext,
+                           operationIndex);
+        latencies[operationIndex] = Benchmark_NanosecondsGet() - operationStartTime;
+    }
+    numberOfLatencies = operationIndex;
+
+    Benchmark_ResultPrint(BenchmarkName,
+                          NumberOfOperations,
+                          elapsedTime,
+                          latencies,
+                          numberOfLatencies,
+                          passed);
+
+    free(latencies);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// HashTable
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+static
+BOOLEAN
+HashTable_BenchmarkWrite(
+    _In_ VOID* BenchmarkContext,
+    _In_ ULONG OperationIndex
+    )
+{
+    HASHTABLE_BENCHMARK_CONTEXT* benchmarkContext = (HASHTABLE_BENCHMARK_CONTEXT*)BenchmarkContext;
+    ULONG keyIndex;
+    ULONGLONG value;
+    NTSTATUS ntStatus;
+
+    keyIndex = OperationIndex % HASHTABLE_NUMBER_OF_KEYS;
+    value = keyIndex;
+    ntStatus = DMF_HashTable_Write(benchmarkContext->DmfModule,
+                                   benchmarkContext->Keys[keyIndex],
+                                   HASHTABLE_KEY_LENGTH,
+                                   (UCHAR*)&value,
+                                   sizeof(value));
+
+    return NT_SUCCESS(ntStatus);
+}
+
+static
+BOOLEAN
+HashTable_BenchmarkReadHit(
+    _In_ VOID* BenchmarkContext,
+    _In_ ULONG OperationIndex
+    )
+{
+    HASHTABLE_BENCHMARK_CONTEXT* benchmarkContext = (HASHTABLE_BENCHMARK_CONTEXT*)BenchmarkContext;
+    ULONG keyIndex;
+    ULONGLONG value;
+    ULONG valueLength;
+    NTSTATUS ntStatus;
+
+    // Visit the keys in a different order than they were written.
+    //
+    keyIndex = (OperationIndex * 2654435761U) % HASHTABLE_NUMBER_OF_KEYS;
+    value = MAXULONGLONG;
+    ntStatus = DMF_HashTable_Read(benchmarkContext->DmfModule,
+                                  benchmarkContext->Keys[keyIndex],
+                                  HASHTABLE_KEY_LENGTH,
+                                  (UCHAR*)&value,
+                                  sizeof(value),
+                                  &valueLength);
+
+    return (NT_SUCCESS(ntStatus) &&
+            (sizeof(value) == valueLength) &&
+            (keyIndex == value));
+}
+
+static
+BOOLEAN
+HashTable_BenchmarkReadMiss(
+    _In_ VOID* BenchmarkContext,
+    _In_ ULONG OperationIndex
+    )
+{
+    HASHTABLE_BENCHMARK_CONTEXT* benchmarkContext = (HASHTABLE_BENCHMARK_CONTEXT*)BenchmarkContext;
+    ULONG keyIndex;
+    ULONGLONG value;
+    NTSTATUS ntStatus;
+
+    keyIndex = HASHTABLE_NUMBER_OF_KEYS + (OperationIndex % HASHTABLE_NUMBER_OF_KEYS);
+    ntStatus = DMF_HashTable_Read(benchmarkContext->DmfModule,
+                                  benchmarkContext->Keys[keyIndex],
+                                  HASHTABLE_KEY_LENGTH,
+                                  (UCHAR*)&value,
+                                  sizeof(value),
+                                  NULL);
+
+    return (STATUS_NOT_FOUND == ntStatus);
+}
+
+static
+VOID
+HashTable_Benchmark(
+    _In_ WDFDEVICE Device,
+    _In_ PCSTR ConfigurationName,
+    _In_ HashTable_ModeType Mode,
+    _In_ HashTable_HashAlgorithmType HashAlgorithm
+    )
+/*++
+
+Routine Description:
+
+    Measure Write, Read of keys that are in the table and Read of keys that are not.
+
+Arguments:
+
+    Device - Parent of the Module.
+    ConfigurationName - Printed with the results.
+    Mode - HashTable organization.
+    HashAlgorithm - Built-in hashing algorithm.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_HashTable moduleConfig;
+    HASHTABLE_BENCHMARK_CONTEXT benchmarkContext;
+    CHAR benchmarkName[64];
+    ULONG keyIndex;
+    ULONG byteIndex;
+    NTSTATUS ntStatus;
+
+    RtlZeroMemory(&benchmarkContext,
+                  sizeof(benchmarkContext));
+
+    benchmarkContext.Keys = malloc(2 * HASHTABLE_NUMBER_OF_KEYS * HASHTABLE_KEY_LENGTH);
+    if (NULL == benchmarkContext.Keys)
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        goto Exit;
+    }
+    for (keyIndex = 0; keyIndex < 2 * HASHTABLE_NUMBER_OF_KEYS; keyIndex++)
+    {
+        for (byteIndex = 0; byteIndex < HASHTABLE_KEY_LENGTH; byteIndex++)
+        {
+            benchmarkContext.Keys[keyIndex][byteIndex] = (UCHAR)((keyIndex * 31 + byteIndex * 7) >> (byteIndex % 3));
+        }
+        // Make every key unique.
+        //
+        RtlCopyMemory(benchmarkContext.Keys[keyIndex],
+                      &keyIndex,
+                      sizeof(keyIndex));
+    }
+
+    DMF_CONFIG_HashTable_AND_ATTRIBUTES_INIT(&moduleConfig,
+                                             &moduleAttributes);
+    moduleConfig.MaximumKeyLength = HASHTABLE_KEY_LENGTH;
+    moduleConfig.MaximumValueLength = HASHTABLE_VALUE_LENGTH;
+    moduleConfig.MaximumTableSize = 2 * HASHTABLE_NUMBER_OF_KEYS;
+    moduleConfig.Mode = Mode;
+    moduleConfig.HashAlgorithm = HashAlgorithm;
+
+    ntStatus = DMF_HashTable_Create(Device,
+                                    &moduleAttributes,
+                                    WDF_NO_OBJECT_ATTRIBUTES,
+                                    &benchmarkContext.DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    snprintf(benchmarkName, sizeof(benchmarkName), "HashTable %s Write", ConfigurationName);
+    Benchmark_Run(benchmarkName,
+                  HashTable_BenchmarkWrite,
+                  &benchmarkContext,
+                  Benchmark_Iterations);
+    snprintf(benchmarkName, sizeof(benchmarkName), "HashTable %s Read (hit)", ConfigurationName);
+    Benchmark_Run(benchmarkName,
+                  HashTable_BenchmarkReadHit,
+                  &benchmarkContext,
+                  Benchmark_Iterations);
+    snprintf(benchmarkName, sizeof(benchmarkName), "HashTable %s Read (miss)", ConfigurationName);
+    Benchmark_Run(benchmarkName,
+                  HashTable_BenchmarkReadMiss,
+                  &benchmarkContext,
+                  Benchmark_Iterations);
+
+    WdfObjectDelete(benchmarkContext.DmfModule);
+
+Exit:
+
+    if (! NT_SUCCESS(ntStatus))
+    {
+        printf("HashTable %s: cannot create Module ntStatus=0x%08X\n",
+               ConfigurationName,
+               (ULONG)ntStatus);
+        Benchmark_Failures++;
+    }
+
+    free(benchmarkContext.Keys);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// RingBuffer
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+static
+BOOLEAN
+RingBuffer_BenchmarkWriteRead(
+    _In_ VOID* BenchmarkContext,
+    _In_ ULONG OperationIndex
+    )
+{
+    RINGBUFFER_BENCHMARK_CONTEXT* benchmarkContext = (RINGBUFFER_BENCHMARK_CONTEXT*)BenchmarkContext;
+    ULONGLONG item[RINGBUFFER_ITEM_SIZE / sizeof(ULONGLONG)];
+    NTSTATUS ntStatus;
+
+    UNREFERENCED_PARAMETER(OperationIndex);
+
+    item[0] = benchmarkContext->WriteSequence++;
+    ntStatus = DMF_RingBuffer_Write(benchmarkContext->DmfModule,
+                                    (UCHAR*)item,
+                                    sizeof(item));
+    if (! NT_SUCCESS(ntStatus))
+    {
+        return FALSE;
+    }
+
+    item[0] = MAXULONGLONG;
+    ntStatus = DMF_RingBuffer_Read(benchmarkContext->DmfModule,
+                                   (UCHAR*)item,
+                                   sizeof(item));
+
+    return (NT_SUCCESS(ntStatus) &&
+            (item[0] == benchmarkContext->ReadSequence++));
+}
+
+static
+BOOLEAN
+RingBuffer_BenchmarkOverwrite(
+    _In_ VOID* BenchmarkContext,
+    _In_ ULONG OperationIndex
+    )
+{
+    RINGBUFFER_BENCHMARK_CONTEXT* benchmarkContext = (RINGBUFFER_BENCHMARK_CONTEXT*)BenchmarkContext;
+    ULONGLONG item[RINGBUFFER_ITEM_SIZE / sizeof(ULONGLONG)];
+    NTSTATUS ntStatus;
+
+    item[0] = OperationIndex;
+    ntStatus = DMF_RingBuffer_Write(benchmarkContext->DmfModule,
+                                    (UCHAR*)item,
+                                    sizeof(item));
+
+    return NT_SUCCESS(ntStatus);
+}
+
+static
+VOID*
+RingBuffer_BenchmarkConsumer(
+    _In_ VOID* Argument
+    )
+/*++
+
+Routine Description:
+
+    Read items until all the items written by the producer have been read and check
+    that they are read in the order they were written.
+
+Arguments:
+
+    Argument - RINGBUFFER_BENCHMARK_CONTEXT.
+
+Return Value:
+
+    NULL
+
+--*/
+{
+    RINGBUFFER_BENCHMARK_CONTEXT* benchmarkContext = (RINGBUFFER_BENCHMARK_CONTEXT*)Argument;
+    ULONGLONG item[RINGBUFFER_ITEM_SIZE / sizeof(ULONGLONG)];
+    NTSTATUS ntStatus;
+
+    while (benchmarkContext->ReadSequence < benchmarkContext->ItemsToRead)
+    {
+        ntStatus = DMF_RingBuffer_Read(benchmarkContext->DmfModule,
+                                       (UCHAR*)item,
+                                       sizeof(item));
+        if (! NT_SUCCESS(ntStatus))
+        {
+            YieldProcessor();
+            continue;
+        }
+        if (item[0] != benchmarkContext->ReadSequence)
+        {
+            __atomic_store_n(&benchmarkContext->Failed,
+                             TRUE,
+                             __ATOMIC_RELAXED);
+            break;
+        }
+        benchmarkContext->ReadSequence++;
+    }
+
+    return NULL;
+}
+
+static
+VOID
+RingBuffer_BenchmarkProducerConsumer(
+    _In_ RINGBUFFER_BENCHMARK_CONTEXT* BenchmarkContext
+    )
+/*++
+
+Routine Description:
+
+    Write items from this thread while another thread reads them.
+
+Arguments:
+
+    BenchmarkContext - Context of a SingleProducerSingleConsumer Ring Buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONGLONG item[RINGBUFFER_ITEM_SIZE / sizeof(ULONGLONG)];
+    pthread_t consumerThread;
+    ULONGLONG startTime;
+    ULONGLONG elapsedTime;
+    NTSTATUS ntStatus;
+
+    BenchmarkContext->WriteSequence = 0;
+    BenchmarkContext->ReadSequence = 0;
+    BenchmarkContext->ItemsToRead = Benchmark_Iterations;
+    BenchmarkContext->Failed = FALSE;
+
+    startTime = Benchmark_NanosecondsGet();
+    if (0 != pthread_create(&consumerThread,
+                            NULL,
+                            RingBuffer_BenchmarkConsumer,
+                            BenchmarkContext))
+    {
+        BenchmarkContext->Failed = TRUE;
+        goto Exit;
+    }
+
+    RtlZeroMemory(item,
+                  sizeof(item));
+    while ((BenchmarkContext->WriteSequence < BenchmarkContext->ItemsToRead) &&
+           (! __atomic_load_n(&BenchmarkContext->Failed,
+                              __ATOMIC_RELAXED)))
+    {
+        item[0] = BenchmarkContext->WriteSequence;
+        ntStatus = DMF_RingBuffer_Write(BenchmarkContext->DmfModule,
+                                        (UCHAR*)item,
+                                        sizeof(item));
+        if (! NT_SUCCESS(ntStatus))
+        {
+            // Full. Wait for the consumer to make room.
+            //
+            YieldProcessor();
+            continue;
+        }
+        BenchmarkContext->WriteSequence++;
+    }
+
+    pthread_join(consumerThread,
+                 NULL);
+
+Exit:
+
+    elapsedTime = Benchmark_NanosecondsGet() - startTime;
+    Benchmark_ResultPrint("RingBuffer SPSC Write/Read (2 threads)",
+                          BenchmarkContext->ItemsToRead,
+                          elapsedTime,
+                          NULL,
+                          0,
+                          ! BenchmarkContext->Failed);
+}
+
+static
+VOID
+RingBuffer_Benchmark(
+    _In_ WDFDEVICE Device,
+    _In_ RingBuffer_SynchronizationType Synchronization
+    )
+/*++
+
+Routine Description:
+
+    Measure the Ring Buffer with a given synchronization.
+
+Arguments:
+
+    Device - Parent of the Module.
+    Synchronization - How access to the Ring Buffer is synchronized.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfig;
+    RINGBUFFER_BENCHMARK_CONTEXT benchmarkContext;
+    NTSTATUS ntStatus;
+
+    RtlZeroMemory(&benchmarkContext,
+                  sizeof(benchmarkContext));
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfig,
+                                              &moduleAttributes);
+    moduleConfig.ItemCount = RINGBUFFER_ITEM_COUNT;
+    moduleConfig.ItemSize = RINGBUFFER_ITEM_SIZE;
+    moduleConfig.Synchronization = Synchronization;
+    if (RingBuffer_Synchronization_MultipleProducerOverwrite == Synchronization)
+    {
+        moduleConfig.Mode = RingBuffer_Mode_DeleteOldestIfFullOnWrite;
+    }
+    else
+    {
+        moduleConfig.Mode = RingBuffer_Mode_FailIfFullOnWrite;
+    }
+
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     WDF_NO_OBJECT_ATTRIBUTES,
+                                     &benchmarkContext.DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        printf("RingBuffer: cannot create Module Synchronization=%d ntStatus=0x%08X\n",
+               (int)Synchronization,
+               (ULONG)ntStatus);
+        Benchmark_Failures++;
+        goto Exit;
+    }
+
+    switch (Synchronization)
+    {
+        case RingBuffer_Synchronization_Lock:
+        {
+            Benchmark_Run("RingBuffer Lock Write+Read",
+                          RingBuffer_BenchmarkWriteRead,
+                          &benchmarkContext,
+                          Benchmark_Iterations);
+            break;
+        }
+        case RingBuffer_Synchronization_SingleProducerSingleConsumer:
+        {
+            Benchmark_Run("RingBuffer SPSC Write+Read",
+                          RingBuffer_BenchmarkWriteRead,
+                          &benchmarkContext,
+                          Benchmark_Iterations);
+            RingBuffer_BenchmarkProducerConsumer(&benchmarkContext);
+            break;
+        }
+        case RingBuffer_Synchronization_MultipleProducerOverwrite:
+        {
+            Benchmark_Run("RingBuffer MultipleProducerOverwrite Write",
+                          RingBuffer_BenchmarkOverwrite,
+                          &benchmarkContext,
+                          Benchmark_Iterations);
+            break;
+        }
+        default:
+        {
+            DmfAssert(FALSE);
+            break;
+        }
+    }
+
+    WdfObjectDelete(benchmarkContext.DmfModule);
+
+Exit:
+
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// BufferPool
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+static
+BOOLEAN
+BufferPool_BenchmarkGetPut(
+    _In_ VOID* BenchmarkContext,
+    _In_ ULONG OperationIndex
+    )
+{
+    BUFFERPOOL_BENCHMARK_CONTEXT* benchmarkContext = (BUFFERPOOL_BENCHMARK_CONTEXT*)BenchmarkContext;
+    VOID* clientBuffer;
+    NTSTATUS ntStatus;
+
+    ntStatus = DMF_BufferPool_Get(benchmarkContext->DmfModule,
+                                  &clientBuffer,
+                                  NULL);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        return FALSE;
+    }
+
+    // Touch the buffer like a Client would.
+    //
+    *(ULONG*)clientBuffer = OperationIndex;
+    DMF_BufferPool_Put(benchmarkContext->DmfModule,
+                       clientBuffer);
+
+    return TRUE;
+}
+
+static
+BOOLEAN
+BufferPool_BenchmarkGetPutMultiple(
+    _In_ VOID* BenchmarkContext,
+    _In_ ULONG OperationIndex
+    )
+{
+    BUFFERPOOL_BENCHMARK_CONTEXT* benchmarkContext = (BUFFERPOOL_BENCHMARK_CONTEXT*)BenchmarkContext;
+    VOID* clientBuffers[BUFFERPOOL_BATCH_SIZE];
+    ULONG numberOfBuffersReturned;
+    ULONG bufferIndex;
+    NTSTATUS ntStatus;
+
+    ntStatus = DMF_BufferPool_GetMultiple(benchmarkContext->DmfModule,
+                                          BUFFERPOOL_BATCH_SIZE,
+                                          clientBuffers,
+                                          NULL,
+                                          &numberOfBuffersReturned);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        return FALSE;
+    }
+
+    for (bufferIndex = 0; bufferIndex < numberOfBuffersReturned; bufferIndex++)
+    {
+        *(ULONG*)clientBuffers[bufferIndex] = OperationIndex;
+    }
+    DMF_BufferPool_PutMultiple(benchmarkContext->DmfModule,
+                               clientBuffers,
+                               numberOfBuffersReturned);
+
+    return (BUFFERPOOL_BATCH_SIZE == numberOfBuffersReturned);
+}
+
+static
+VOID*
+BufferPool_BenchmarkThread(
+    _In_ VOID* Argument
+    )
+{
+    BUFFERPOOL_BENCHMARK_CONTEXT* benchmarkContext = (BUFFERPOOL_BENCHMARK_CONTEXT*)Argument;
+    ULONGLONG operationIndex;
+
+    for (operationIndex = 0; operationIndex < benchmarkContext->OperationsPerThread; operationIndex++)
+    {
+        if (! BufferPool_BenchmarkGetPut(benchmarkContext,
+                                         (ULONG)operationIndex))
+        {
+            __atomic_store_n(&benchmarkContext->Failed,
+                             TRUE,
+                             __ATOMIC_RELAXED);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static
+VOID
+BufferPool_BenchmarkMultipleThreads(
+    _In_ BUFFERPOOL_BENCHMARK_CONTEXT* BenchmarkContext,
+    _In_ PCSTR BenchmarkName
+    )
+/*++
+
+Routine Description:
+
+    Get and Put buffers from several threads at the same time.
+
+Arguments:
+
+    BenchmarkContext - Context of the BufferPool.
+    BenchmarkName - Name of the benchmark.
+
+Return Value:
+
+    None
+
+--*/
+{
+    pthread_t threads[BUFFERPOOL_THREADS_MAXIMUM];
+    ULONG numberOfThreads;
+    ULONG threadsCreated;
+    ULONG threadIndex;
+    ULONGLONG startTime;
+    ULONGLONG elapsedTime;
+
+    numberOfThreads = GetMaximumProcessorCount(ALL_PROCESSOR_GROUPS);
+    if (numberOfThreads > BUFFERPOOL_THREADS_MAXIMUM)
+    {
+        numberOfThreads = BUFFERPOOL_THREADS_MAXIMUM;
+    }
+    if (numberOfThreads < 2)
+    {
+        numberOfThreads = 2;
+    }
+
+    BenchmarkContext->OperationsPerThread = Benchmark_Iterations / numberOfThreads;
+    BenchmarkContext->Failed = FALSE;
+
+    startTime = Benchmark_NanosecondsGet();
+    for (threadsCreated = 0; threadsCreated < numberOfThreads; threadsCreated++)
+    {
+        if (0 != pthread_create(&threads[threadsCreated],
+                                NULL,
+                                BufferPool_BenchmarkThread,
+                                BenchmarkContext))
+        {
+            BenchmarkContext->Failed = TRUE;
+            break;
+        }
+    }
+    for (threadIndex = 0; threadIndex < threadsCreated; threadIndex++)
+    {
+        pthread_join(threads[threadIndex],
+                     NULL);
+    }
+    elapsedTime = Benchmark_NanosecondsGet() - startTime;
+
+    Benchmark_ResultPrint(BenchmarkName,
+                          BenchmarkContext->OperationsPerThread * numberOfThreads,
+                          elapsedTime,
+                          NULL,
+                          0,
+                          ! BenchmarkContext->Failed);
+}
+
+static
+VOID
+BufferPool_Benchmark(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG PerProcessorCacheSize
+    )
+/*++
+
+Routine Description:
+
+    Measure Get/Put of a Source BufferPool.
+
+Arguments:
+
+    Device - Parent of the Module.
+    PerProcessorCacheSize - Size of the per-processor caches (zero disables them).
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_BufferPool moduleConfig;
+    BUFFERPOOL_BENCHMARK_CONTEXT benchmarkContext;
+    CHAR benchmarkName[64];
+    ULONG bufferCount;
+    NTSTATUS ntStatus;
+
+    RtlZeroMemory(&benchmarkContext,
+                  sizeof(benchmarkContext));
+
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfig,
+                                              &moduleAttributes);
+    moduleConfig.BufferPoolMode = BufferPool_Mode_Source;
+    moduleConfig.Mode.SourceSettings.BufferCount = BUFFERPOOL_BUFFER_COUNT;
+    moduleConfig.Mode.SourceSettings.BufferSize = BUFFERPOOL_BUFFER_SIZE;
+    moduleConfig.Mode.SourceSettings.PerProcessorCacheSize = PerProcessorCacheSize;
+
+    ntStatus = DMF_BufferPool_Create(Device,
+                                     &moduleAttributes,
+                                     WDF_NO_OBJECT_ATTRIBUTES,
+                                     &benchmarkContext.DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        printf("BufferPool: cannot create Module PerProcessorCacheSize=%u ntStatus=0x%08X\n",
+               PerProcessorCacheSize,
+               (ULONG)ntStatus);
+        Benchmark_Failures++;
+        goto Exit;
+    }
+
+    snprintf(benchmarkName, sizeof(benchmarkName), "BufferPool Get+Put (cache %u)", PerProcessorCacheSize);
+    Benchmark_Run(benchmarkName,
+                  BufferPool_BenchmarkGetPut,
+                  &benchmarkContext,
+                  Benchmark_Iterations);
+    snprintf(benchmarkName, sizeof(benchmarkName), "BufferPool GetMultiple+PutMultiple x%u (cache %u)", BUFFERPOOL_BATCH_SIZE, PerProcessorCacheSize);
+    Benchmark_Run(benchmarkName,
+                  BufferPool_BenchmarkGetPutMultiple,
+                  &benchmarkContext,
+                  Benchmark_Iterations / BUFFERPOOL_BATCH_SIZE);
+    snprintf(benchmarkName, sizeof(benchmarkName), "BufferPool Get+Put threads (cache %u)", PerProcessorCacheSize);
+    BufferPool_BenchmarkMultipleThreads(&benchmarkContext,
+                                        benchmarkName);
+
+    // All the buffers must be back in the pool.
+    //
+    bufferCount = DMF_BufferPool_Count(benchmarkContext.DmfModule);
+    if (bufferCount != BUFFERPOOL_BUFFER_COUNT)
+    {
+        printf("BufferPool: %u buffers in the pool instead of %u\n",
+               bufferCount,
+               BUFFERPOOL_BUFFER_COUNT);
+        Benchmark_Failures++;
+    }
+
+    WdfObjectDelete(benchmarkContext.DmfModule);
+
+Exit:
+
+    ;
+}
+
+int
+main(
+    _In_ int argc,
+    _In_ char** argv
+    )
+{
+    WDFDEVICE device;
+    NTSTATUS ntStatus;
+    int argumentIndex;
+
+    for (argumentIndex = 1; argumentIndex < argc; argumentIndex++)
+    {
+        if (0 == strcmp(argv[argumentIndex],
+                        "-quick"))
+        {
+            Benchmark_Iterations = 64 * 1024;
+        }
+        else
+        {
+            fprintf(stderr,
+                    "Usage: %s [-quick]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    ntStatus = DmfHost_DeviceCreate(&device);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        fprintf(stderr,
+                "Cannot create device ntStatus=0x%08X\n",
+                (ULONG)ntStatus);
+        return 1;
+    }
+
+    HashTable_Benchmark(device,
+                        "Chained/Fnv1a",
+                        HashTable_Mode_Chained,
+                        HashTable_HashAlgorithm_Fnv1a);
+    HashTable_Benchmark(device,
+                        "Chained/WordAtATime",
+                        HashTable_Mode_Chained,
+                        HashTable_HashAlgorithm_WordAtATime);
+    HashTable_Benchmark(device,
+                        "OpenAddressing/WordAtATime",
+                        HashTable_Mode_OpenAddressing,
+                        HashTable_HashAlgorithm_WordAtATime);
+
+    RingBuffer_Benchmark(device,
+                         RingBuffer_Synchronization_Lock);
+    RingBuffer_Benchmark(device,
+                         RingBuffer_Synchronization_SingleProducerSingleConsumer);
+    RingBuffer_Benchmark(device,
+                         RingBuffer_Synchronization_MultipleProducerOverwrite);
+
+    BufferPool_Benchmark(device,
+                         0);
+    BufferPool_Benchmark(device,
+                         32);
+
+    // Deletes any Module left behind.
+    //
+    WdfObjectDelete(device);
+
+    if (Benchmark_Failures > 0)
+    {
+        printf("%u benchmark(s) FAILED\n",
+               Benchmark_Failures);
+        return 1;
+    }
+
+    return 0;
+}
+
+// eof: DmfHostBenchmark.c
+//
@@ -0,0 +1,237 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfHostTests.c
+
+Abstract:
+
+    Runs the Test Modules of the Modules in the host build. Each Test Module is created on
+    its own, runs its tests in its Open callback and in its threads for some time, then is
+    deleted (which stops its threads). Test Modules report failures with DmfAssert() so this
+    program is built with assertions enabled and aborts on the first failure.
+
+    Usage: DmfHostTests [-seconds N] [TestName...]
+        -seconds N: Run each Test Module for N seconds (default 2).
+        TestName: Only run the given Test Modules (for example HashTable).
+
+Environment:
+
+    Host (POSIX)
+
+--*/
+
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Definitions
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Creates a Test Module. All the Test Modules have no Config so their attributes are
+// initialized the same way.
+//
+typedef
+NTSTATUS
+EVT_DmfHostTests_Create(_In_ WDFDEVICE Device,
+                        _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+                        _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+                        _Out_ DMFMODULE* DmfModule);
+
+typedef struct
+{
+    PCSTR TestName;
+    EVT_DmfHostTests_Create* Create;
+} DMF_HOST_TEST;
+
+static const DMF_HOST_TEST DmfHostTests_Tests[] =
+{
+    { "BufferPool", DMF_Tests_BufferPool_Create },
+    { "BufferQueue", DMF_Tests_BufferQueue_Create },
+    { "HashTable", DMF_Tests_HashTable_Create },
+    { "PingPongBuffer", DMF_Tests_PingPongBuffer_Create },
+    { "RingBuffer", DMF_Tests_RingBuffer_Create },
+    { "Stack", DMF_Tests_Stack_Create },
+    { "String", DMF_Tests_String_Create },
+    { "ThreadedBufferQueue", DMF_Tests_ThreadedBufferQueue_Create },
+};
+
+#define DMF_HOST_TESTS_SECONDS_DEFAULT      2
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Private Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+static
+BOOLEAN
+DmfHostTests_Run(
+    _In_ WDFDEVICE Device,
+    _In_ const DMF_HOST_TEST* Test,
+    _In_ ULONG Seconds
+    )
+/*++
+
+Routine Description:
+
+    Create a Test Module, let its threads run and delete it.
+
+Arguments:
+
+    Device - Parent of the Test Module.
+    Test - The Test Module to run.
+    Seconds - How long the Test Module's threads run.
+
+Return Value:
+
+    TRUE if the Test Module was created.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMFMODULE dmfModule;
+
+    printf("%-16s ",
+           Test->TestName);
+    fflush(stdout);
+
+    DMF_MODULE_ATTRIBUTES_INIT(&moduleAttributes,
+                               0);
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    ntStatus = Test->Create(Device,
+                            &moduleAttributes,
+                            &objectAttributes,
+                            &dmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        printf("cannot create Module ntStatus=0x%08X  FAILED\n",
+               (ULONG)ntStatus);
+        return FALSE;
+    }
+
+    Sleep(Seconds * 1000);
+
+    WdfObjectDelete(dmfModule);
+
+    printf("passed\n");
+
+    return TRUE;
+}
+
+int
+main(
+    _In_ int argc,
+    _In_ char** argv
+    )
+{
+    WDFDEVICE device;
+    NTSTATUS ntStatus;
+    ULONG seconds;
+    ULONG failures;
+    int argumentIndex;
+    int firstTestArgument;
+    int testArgumentIndex;
+    ULONG testIndex;
+    BOOLEAN selected;
+
+    seconds = DMF_HOST_TESTS_SECONDS_DEFAULT;
+    for (argumentIndex = 1; argumentIndex < argc; argumentIndex++)
+    {
+        if ((0 == strcmp(argv[argumentIndex],
+                         "-seconds")) &&
+            (argumentIndex + 1 < argc))
+        {
+            argumentIndex++;
+            seconds = (ULONG)strtoul(argv[argumentIndex],
+                                     NULL,
+                                     0);
+        }
+        else
+        {
+            break;
+        }
+    }
+    firstTestArgument = argumentIndex;
+
+    for (testArgumentIndex = firstTestArgument; testArgumentIndex < argc; testArgumentIndex++)
+    {
+        selected = FALSE;
+        for (testIndex = 0; testIndex < ARRAYSIZE(DmfHostTests_Tests); testIndex++)
+        {
+            if (0 == strcmp(argv[testArgumentIndex],
+                            DmfHostTests_Tests[testIndex].TestName))
+            {
+                selected = TRUE;
+            }
+        }
+        if (! selected)
+        {
+            fprintf(stderr,
+                    "Usage: %s [-seconds N] [TestName...]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    ntStatus = DmfHost_DeviceCreate(&device);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        fprintf(stderr,
+                "Cannot create device ntStatus=0x%08X\n",
+                (ULONG)ntStatus);
+        return 1;
+    }
+
+    failures = 0;
+    for (testIndex = 0; testIndex < ARRAYSIZE(DmfHostTests_Tests); testIndex++)
+    {
+        selected = (firstTestArgument == argc);
+        for (testArgumentIndex = firstTestArgument; testArgumentIndex < argc; testArgumentIndex++)
+        {
+            if (0 == strcmp(argv[testArgumentIndex],
+                            DmfHostTests_Tests[testIndex].TestName))
+            {
+                selected = TRUE;
+            }
+        }
+        if (! selected)
+        {
+            continue;
+        }
+
+        if (! DmfHostTests_Run(device,
+                               &DmfHostTests_Tests[testIndex],
+                               seconds))
+        {
+            failures++;
+        }
+    }
+
+    // Deletes any Module left behind.
+    //
+    WdfObjectDelete(device);
+
+    if (failures > 0)
+    {
+        printf("%u test(s) FAILED\n",
+               failures);
+        return 1;
+    }
+
+    return 0;
+}
+
+// eof: DmfHostTests.c
+//
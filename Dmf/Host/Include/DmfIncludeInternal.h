@@ -0,0 +1,43 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfIncludeInternal.h
+
+Abstract:
+
+    Host replacement of Framework\DmfIncludeInternal.h. It declares what Framework\DmfPortable.c
+    uses from the rest of the Framework. The generic memory functions are implemented in DmfHost.c.
+
+Environment:
+
+    Host (POSIX)
+
+--*/
+
+#pragma once
+
+#include "DmfModule.h"
+#include "DmfModules.Library.Trace.h"
+
+#define POOL_FLAG_NON_PAGED               0x0000000000000040ULL     // Non paged pool NX
+#define POOL_FLAG_PAGED                   0x0000000000000100ULL     // Paged pool
+
+VOID*
+DMF_GenericMemoryAllocate(
+    _In_ ULONG64 PoolFlags,
+    _In_ size_t Size,
+    _In_ ULONG Tag
+    );
+
+VOID
+DMF_GenericMemoryFree(
+    _In_ VOID* Pointer,
+    _In_ ULONG Tag
+    );
+
+// eof: DmfIncludeInternal.h
+//
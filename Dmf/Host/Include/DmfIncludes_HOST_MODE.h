@@ -0,0 +1,1187 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfIncludes_HOST_MODE.h
+
+Abstract:
+
+    Includes files and definitions specifically for DMF_HOST_MODE. This mode builds Modules
+    that do not depend on a device stack as a User-mode library on a POSIX host so that they
+    can be benchmarked, tested and run under sanitizers. It provides the subset of the Windows,
+    WDF and SAL definitions those Modules use. The WDF object, memory, lock and timer functions
+    and the Win32 functions used by DMF_USER_MODE paths are implemented in DmfHost.c.
+
+Environment:
+
+    Host (POSIX)
+
+--*/
+
+#pragma once
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif // !defined(_GNU_SOURCE)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <wchar.h>
+#include <assert.h>
+#include <sched.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// SAL annotations. They are only checked by the Windows build.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#define _In_
+#define _In_opt_
+#define _In_z_
+#define _In_opt_z_
+#define _Inout_
+#define _Inout_opt_
+#define _Out_
+#define _Out_opt_
+#define _Outptr_
+#define _Outptr_opt_
+#define _Must_inspect_result_
+#define _Check_return_
+#define _Use_decl_annotations_
+#define _Printf_format_string_
+#define _Interlocked_
+#define _Curr_
+#define _IRQL_requires_same_
+#define _IRQL_restores_
+#define _IRQL_saves_
+#define _Ret_maybenull_
+#define __drv_aliasesMem
+#define _IRQL_requires_max_(...)
+#define _IRQL_always_function_max_(...)
+#define _IRQL_raises_(...)
+#define _Acquires_lock_(...)
+#define _Releases_lock_(...)
+#define _Requires_lock_held_(...)
+#define _Requires_lock_not_held_(...)
+#define _Guarded_by_(...)
+#define _Always_(...)
+#define _Analysis_assume_(...)
+#define __analysis_assume(...)
+#define _At_(...)
+#define _When_(...)
+#define _Success_(...)
+#define _Param_(...)
+#define _Post_equal_to_(...)
+#define _Post_writable_byte_size_(...)
+#define _Function_class_(...)
+#define _Field_size_(...)
+#define _String_length_(...)
+#define _In_reads_(...)
+#define _In_reads_opt_(...)
+#define _In_reads_bytes_(...)
+#define _In_reads_bytes_opt_(...)
+#define _Inout_updates_(...)
+#define _Inout_updates_bytes_(...)
+#define _Inout_updates_bytes_opt_(...)
+#define _Inout_updates_to_(...)
+#define _Inout_updates_bytes_to_(...)
+#define _Out_writes_(...)
+#define _Out_writes_opt_(...)
+#define _Out_writes_to_(...)
+#define _Out_writes_to_opt_(...)
+#define _Out_writes_bytes_(...)
+#define _Out_writes_bytes_opt_(...)
+#define _Out_writes_bytes_all_(...)
+#define _Out_writes_bytes_to_opt_(...)
+#define __fallthrough                   __attribute__((fallthrough))
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Basic types and definitions.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#define VOID                            void
+#define CONST                           const
+#define TRUE                            1
+#define FALSE                           0
+#define ANYSIZE_ARRAY                   1
+#define __forceinline                   static inline
+#define FORCEINLINE                     static inline
+#define DECLSPEC_ALIGN(Alignment)       __attribute__((aligned(Alignment)))
+#define SYSTEM_CACHE_ALIGNMENT_SIZE     64
+#define DECLSPEC_CACHEALIGN             DECLSPEC_ALIGN(SYSTEM_CACHE_ALIGNMENT_SIZE)
+#define MEMORY_ALLOCATION_ALIGNMENT     16
+#define MAX_NATURAL_ALIGNMENT           sizeof(ULONGLONG)
+#define UNREFERENCED_PARAMETER(P)       ((void)(P))
+#define PAGED_CODE()
+#define ARRAYSIZE(A)                    (sizeof(A) / sizeof((A)[0]))
+#define FIELD_OFFSET(Type, Field)       ((LONG)offsetof(Type, Field))
+#define CONTAINING_RECORD(Address, Type, Field) ((Type*)((char*)(Address) - offsetof(Type, Field)))
+#define ALIGN_UP_BY(Length, Alignment)  (((ULONG_PTR)(Length) + (Alignment) - 1) & ~((ULONG_PTR)(Alignment) - 1))
+
+#if !defined(min)
+#define min(a, b)                       (((a) < (b)) ? (a) : (b))
+#define max(a, b)                       (((a) > (b)) ? (a) : (b))
+#endif // !defined(min)
+
+#if UINTPTR_MAX == UINT64_MAX
+#define _WIN64                          1
+#endif // UINTPTR_MAX == UINT64_MAX
+
+typedef uint8_t UCHAR, UINT8, BYTE, BOOLEAN;
+typedef char CHAR, CCHAR;
+typedef int16_t SHORT;
+typedef uint16_t USHORT, UINT16, WORD;
+// Wide string literals (L"") must have the type of WCHAR so it is the host's wchar_t.
+//
+typedef wchar_t WCHAR;
+typedef int32_t LONG, INT, INT32, BOOL, NTSTATUS;
+typedef uint32_t ULONG, UINT, UINT32, DWORD;
+typedef int64_t LONGLONG, LONG64, INT64;
+typedef uint64_t ULONGLONG, ULONG64, UINT64, DWORD64;
+typedef intptr_t LONG_PTR, INT_PTR;
+typedef uintptr_t ULONG_PTR, UINT_PTR, SIZE_T, DWORD_PTR, KAFFINITY;
+typedef UCHAR* PUCHAR;
+typedef UINT8* PUINT8;
+typedef ULONG* PULONG;
+typedef LONG* PLONG;
+typedef ULONGLONG* PULONGLONG;
+typedef void* PVOID;
+typedef void* HANDLE;
+typedef char* PCHAR;
+typedef char* PSTR;
+typedef const char* PCSTR;
+typedef WCHAR* PWSTR;
+typedef const WCHAR* PCWSTR;
+typedef UCHAR KIRQL;
+
+#define BYTE_MAX                        0xFF
+#define MAXUSHORT                       0xFFFF
+#define MAXLONG                         0x7FFFFFFF
+#define MAXULONG                        0xFFFFFFFF
+#define MAXULONGLONG                    (~((ULONGLONG)0))
+// ULONG and LONG are 32 bits as they are on Windows. <limits.h> describes the host's
+// long which is 64 bits on LP64 hosts.
+//
+#undef ULONG_MAX
+#undef LONG_MAX
+#undef LONG_MIN
+#define ULONG_MAX                       0xFFFFFFFFUL
+#define LONG_MAX                        2147483647L
+#define LONG_MIN                        (-2147483647L - 1)
+#define INFINITE                        0xFFFFFFFF
+
+#define PASSIVE_LEVEL                   0
+#define APC_LEVEL                       1
+#define DISPATCH_LEVEL                  2
+
+typedef union _LARGE_INTEGER
+{
+    struct
+    {
+        ULONG LowPart;
+        LONG HighPart;
+    };
+    LONGLONG QuadPart;
+} LARGE_INTEGER, *PLARGE_INTEGER;
+
+typedef struct _LIST_ENTRY
+{
+    struct _LIST_ENTRY* Flink;
+    struct _LIST_ENTRY* Blink;
+} LIST_ENTRY, *PLIST_ENTRY;
+
+typedef struct _GUID
+{
+    ULONG Data1;
+    USHORT Data2;
+    USHORT Data3;
+    UCHAR Data4[8];
+} GUID, *LPGUID;
+
+typedef enum _POOL_TYPE
+{
+    NonPagedPool = 0,
+    PagedPool = 1,
+    NonPagedPoolNx = 512
+} POOL_TYPE;
+
+#define ALL_PROCESSOR_GROUPS            0xFFFF
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// NTSTATUS.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#define NT_SUCCESS(Status)              (((NTSTATUS)(Status)) >= 0)
+
+#define STATUS_SUCCESS                  ((NTSTATUS)0x00000000L)
+#define STATUS_WAIT_0                   ((NTSTATUS)0x00000000L)
+#define STATUS_WAIT_1                   ((NTSTATUS)0x00000001L)
+#define STATUS_ABANDONED                ((NTSTATUS)0x00000080L)
+#define STATUS_USER_APC                 ((NTSTATUS)0x000000C0L)
+#define STATUS_ALERTED                  ((NTSTATUS)0x00000101L)
+#define STATUS_TIMEOUT                  ((NTSTATUS)0x00000102L)
+#define STATUS_PENDING                  ((NTSTATUS)0x00000103L)
+#define STATUS_BUFFER_OVERFLOW          ((NTSTATUS)0x80000005L)
+#define STATUS_NO_MORE_FILES            ((NTSTATUS)0x80000006L)
+#define STATUS_DEVICE_BUSY              ((NTSTATUS)0x80000011L)
+#define STATUS_NO_MORE_ENTRIES          ((NTSTATUS)0x8000001AL)
+#define STATUS_UNSUCCESSFUL             ((NTSTATUS)0xC0000001L)
+#define STATUS_NOT_IMPLEMENTED          ((NTSTATUS)0xC0000002L)
+#define STATUS_INVALID_PARAMETER        ((NTSTATUS)0xC000000DL)
+#define STATUS_INVALID_DEVICE_REQUEST   ((NTSTATUS)0xC0000010L)
+#define STATUS_NO_MEMORY                ((NTSTATUS)0xC0000017L)
+#define STATUS_BUFFER_TOO_SMALL         ((NTSTATUS)0xC0000023L)
+#define STATUS_OBJECT_NAME_NOT_FOUND    ((NTSTATUS)0xC0000034L)
+#define STATUS_OBJECT_NAME_EXISTS       ((NTSTATUS)0x40000000L)
+#define STATUS_DATA_ERROR               ((NTSTATUS)0xC000003EL)
+#define STATUS_DELETE_PENDING           ((NTSTATUS)0xC0000056L)
+#define STATUS_INTEGER_OVERFLOW         ((NTSTATUS)0xC0000095L)
+#define STATUS_INSUFFICIENT_RESOURCES   ((NTSTATUS)0xC000009AL)
+#define STATUS_DEVICE_NOT_READY         ((NTSTATUS)0xC00000A3L)
+#define STATUS_NOT_SUPPORTED            ((NTSTATUS)0xC00000BBL)
+#define STATUS_INTERNAL_ERROR           ((NTSTATUS)0xC00000E5L)
+#define STATUS_CANCELLED                ((NTSTATUS)0xC0000120L)
+#define STATUS_INVALID_DEVICE_STATE     ((NTSTATUS)0xC0000184L)
+#define STATUS_INVALID_BUFFER_SIZE      ((NTSTATUS)0xC0000206L)
+#define STATUS_NOT_FOUND                ((NTSTATUS)0xC0000225L)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Run-time library.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#define RtlCopyMemory(Destination, Source, Length)  memcpy((Destination), (Source), (Length))
+#define RtlMoveMemory(Destination, Source, Length)  memmove((Destination), (Source), (Length))
+#define RtlZeroMemory(Destination, Length)          memset((Destination), 0, (Length))
+#define RtlFillMemory(Destination, Length, Fill)    memset((Destination), (Fill), (Length))
+#define RtlEqualMemory(Source1, Source2, Length)    (0 == memcmp((Source1), (Source2), (Length)))
+
+__forceinline
+SIZE_T
+RtlCompareMemory(
+    _In_ const VOID* Source1,
+    _In_ const VOID* Source2,
+    _In_ SIZE_T Length
+    )
+{
+    const UCHAR* source1 = (const UCHAR*)Source1;
+    const UCHAR* source2 = (const UCHAR*)Source2;
+    SIZE_T index;
+
+    for (index = 0; index < Length; index++)
+    {
+        if (source1[index] != source2[index])
+        {
+            break;
+        }
+    }
+
+    return index;
+}
+
+__forceinline
+VOID
+InitializeListHead(
+    _Out_ PLIST_ENTRY ListHead
+    )
+{
+    ListHead->Flink = ListHead;
+    ListHead->Blink = ListHead;
+}
+
+__forceinline
+BOOLEAN
+IsListEmpty(
+    _In_ const LIST_ENTRY* ListHead
+    )
+{
+    return (BOOLEAN)(ListHead->Flink == ListHead);
+}
+
+__forceinline
+BOOLEAN
+RemoveEntryList(
+    _In_ PLIST_ENTRY Entry
+    )
+{
+    PLIST_ENTRY flink = Entry->Flink;
+    PLIST_ENTRY blink = Entry->Blink;
+
+    blink->Flink = flink;
+    flink->Blink = blink;
+    return (BOOLEAN)(flink == blink);
+}
+
+__forceinline
+PLIST_ENTRY
+RemoveHeadList(
+    _Inout_ PLIST_ENTRY ListHead
+    )
+{
+    PLIST_ENTRY entry = ListHead->Flink;
+
+    RemoveEntryList(entry);
+    return entry;
+}
+
+__forceinline
+PLIST_ENTRY
+RemoveTailList(
+    _Inout_ PLIST_ENTRY ListHead
+    )
+{
+    PLIST_ENTRY entry = ListHead->Blink;
+
+    RemoveEntryList(entry);
+    return entry;
+}
+
+__forceinline
+VOID
+InsertTailList(
+    _Inout_ PLIST_ENTRY ListHead,
+    _Out_ PLIST_ENTRY Entry
+    )
+{
+    PLIST_ENTRY blink = ListHead->Blink;
+
+    Entry->Flink = ListHead;
+    Entry->Blink = blink;
+    blink->Flink = Entry;
+    ListHead->Blink = Entry;
+}
+
+__forceinline
+VOID
+InsertHeadList(
+    _Inout_ PLIST_ENTRY ListHead,
+    _Out_ PLIST_ENTRY Entry
+    )
+{
+    PLIST_ENTRY flink = ListHead->Flink;
+
+    Entry->Flink = flink;
+    Entry->Blink = ListHead;
+    flink->Blink = Entry;
+    ListHead->Flink = Entry;
+}
+
+__forceinline
+VOID
+AppendTailList(
+    _Inout_ PLIST_ENTRY ListHead,
+    _Inout_ PLIST_ENTRY ListToAppend
+    )
+{
+    PLIST_ENTRY listEnd = ListHead->Blink;
+
+    ListHead->Blink->Flink = ListToAppend;
+    ListHead->Blink = ListToAppend->Blink;
+    ListToAppend->Blink->Flink = ListHead;
+    ListToAppend->Blink = listEnd;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Interlocked operations, barriers and bit operations (GCC and Clang builtins).
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#define InterlockedIncrement(Addend)                            __atomic_add_fetch((Addend), 1, __ATOMIC_SEQ_CST)
+#define InterlockedDecrement(Addend)                            __atomic_sub_fetch((Addend), 1, __ATOMIC_SEQ_CST)
+#define InterlockedIncrement64(Addend)                          __atomic_add_fetch((Addend), 1, __ATOMIC_SEQ_CST)
+#define InterlockedDecrement64(Addend)                          __atomic_sub_fetch((Addend), 1, __ATOMIC_SEQ_CST)
+#define InterlockedExchangeAdd(Addend, Value)                   __atomic_fetch_add((Addend), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedExchangeAdd64(Addend, Value)                 __atomic_fetch_add((Addend), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedOr(Destination, Value)                       __atomic_fetch_or((Destination), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedAnd(Destination, Value)                      __atomic_fetch_and((Destination), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedExchange(Target, Value)                      __atomic_exchange_n((Target), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedExchange64(Target, Value)                    __atomic_exchange_n((Target), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedExchangePointer(Target, Value)               __atomic_exchange_n((Target), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedCompareExchange(Destination, Exchange, Comperand)        \
+    __sync_val_compare_and_swap((Destination), (Comperand), (Exchange))
+#define InterlockedCompareExchange64(Destination, Exchange, Comperand)      \
+    __sync_val_compare_and_swap((Destination), (Comperand), (Exchange))
+#define InterlockedCompareExchangePointer(Destination, Exchange, Comperand) \
+    __sync_val_compare_and_swap((Destination), (Comperand), (Exchange))
+
+#define ReadNoFence(Source)                                     __atomic_load_n((Source), __ATOMIC_RELAXED)
+#define ReadNoFence64(Source)                                   __atomic_load_n((Source), __ATOMIC_RELAXED)
+#define ReadAcquire(Source)                                     __atomic_load_n((Source), __ATOMIC_ACQUIRE)
+#define ReadAcquire64(Source)                                   __atomic_load_n((Source), __ATOMIC_ACQUIRE)
+#define ReadPointerAcquire(Source)                              __atomic_load_n((Source), __ATOMIC_ACQUIRE)
+#define WriteNoFence(Destination, Value)                        __atomic_store_n((Destination), (Value), __ATOMIC_RELAXED)
+#define WriteRelease(Destination, Value)                        __atomic_store_n((Destination), (Value), __ATOMIC_RELEASE)
+#define WriteRelease64(Destination, Value)                      __atomic_store_n((Destination), (Value), __ATOMIC_RELEASE)
+#define WritePointerRelease(Destination, Value)                 __atomic_store_n((Destination), (Value), __ATOMIC_RELEASE)
+
+#define MemoryBarrier()                                         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define KeMemoryBarrier()                                       __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define YieldProcessor()                                        sched_yield()
+
+#define PF_TEMPORAL_LEVEL_1                                     3
+#define PF_NON_TEMPORAL_LEVEL_ALL                               0
+#define PreFetchCacheLine(Level, Address)                       __builtin_prefetch((const void*)(Address), 0, (Level))
+
+#define BitScanForward(Index, Mask)                             ((Mask) ? (*(Index) = (ULONG)__builtin_ctz(Mask), 1) : 0)
+#define BitScanForward64(Index, Mask)                           ((Mask) ? (*(Index) = (ULONG)__builtin_ctzll(Mask), 1) : 0)
+#define BitScanReverse(Index, Mask)                             ((Mask) ? (*(Index) = (ULONG)(31 - __builtin_clz(Mask)), 1) : 0)
+#define BitScanReverse64(Index, Mask)                           ((Mask) ? (*(Index) = (ULONG)(63 - __builtin_clzll(Mask)), 1) : 0)
+#define RotateLeft64(Value, Shift)                              (((Value) << (Shift)) | ((Value) >> (64 - (Shift))))
+#define _rotl64(Value, Shift)                                   RotateLeft64((Value), (Shift))
+
+// IRQL does not exist on the host. Raising it is a no-op.
+//
+#define KeRaiseIrql(NewIrql, OldIrql)                           (*(OldIrql) = PASSIVE_LEVEL, (VOID)(NewIrql))
+#define KeLowerIrql(NewIrql)                                    ((VOID)(NewIrql))
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// User-mode (Win32) functions used by DMF_USER_MODE paths. Implemented in DmfHost.c.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#define WINAPI
+#define ZeroMemory(Destination, Length)                         RtlZeroMemory((Destination), (Length))
+
+typedef LONG HRESULT;
+typedef void* HMODULE;
+typedef struct _SECURITY_ATTRIBUTES* LPSECURITY_ATTRIBUTES;
+
+#define S_OK                                                    ((HRESULT)0L)
+#define INTSAFE_E_ARITHMETIC_OVERFLOW                           ((HRESULT)0x80070216L)
+
+#define ERROR_NOT_ENOUGH_MEMORY                                 8L
+#define ERROR_INVALID_PARAMETER                                 87L
+#define FACILITY_NTWIN32                                        0x7
+#define NTSTATUS_FROM_WIN32(Error)                              ((NTSTATUS)(Error) <= 0 ? ((NTSTATUS)(Error)) : ((NTSTATUS)(((Error) & 0x0000FFFF) | (FACILITY_NTWIN32 << 16) | 0xC0000000)))
+
+DWORD
+GetCurrentProcessorNumber(
+    VOID
+    );
+
+DWORD
+GetMaximumProcessorCount(
+    _In_ WORD GroupNumber
+    );
+
+VOID
+QueryInterruptTime(
+    _Out_ PULONGLONG InterruptTime
+    );
+
+DWORD
+GetLastError(
+    VOID
+    );
+
+VOID
+Sleep(
+    _In_ DWORD Milliseconds
+    );
+
+// Events and threads. Thread handles are signaled when the thread returns.
+//
+
+#define WAIT_OBJECT_0                                           ((DWORD)0x00000000L)
+#define WAIT_ABANDONED                                          ((DWORD)0x00000080L)
+#define WAIT_ABANDONED_0                                        ((DWORD)0x00000080L)
+#define WAIT_IO_COMPLETION                                      ((DWORD)0x000000C0L)
+#define WAIT_TIMEOUT                                            ((DWORD)0x00000102L)
+#define WAIT_FAILED                                             ((DWORD)0xFFFFFFFF)
+#define MAXIMUM_WAIT_OBJECTS                                    64
+#define INVALID_HANDLE_VALUE                                    ((HANDLE)(LONG_PTR)-1)
+
+typedef enum _EVENT_TYPE
+{
+    NotificationEvent,
+    SynchronizationEvent
+} EVENT_TYPE;
+
+typedef
+DWORD
+(WINAPI *LPTHREAD_START_ROUTINE)(
+    _In_ VOID* ThreadParameter
+    );
+
+HANDLE
+CreateEvent(
+    _In_opt_ LPSECURITY_ATTRIBUTES EventAttributes,
+    _In_ BOOL ManualReset,
+    _In_ BOOL InitialState,
+    _In_opt_ PCSTR Name
+    );
+
+BOOL
+SetEvent(
+    _In_ HANDLE Event
+    );
+
+BOOL
+ResetEvent(
+    _In_ HANDLE Event
+    );
+
+HANDLE
+CreateThread(
+    _In_opt_ LPSECURITY_ATTRIBUTES ThreadAttributes,
+    _In_ SIZE_T StackSize,
+    _In_ LPTHREAD_START_ROUTINE StartAddress,
+    _In_opt_ VOID* Parameter,
+    _In_ DWORD CreationFlags,
+    _Out_opt_ DWORD* ThreadId
+    );
+
+DWORD
+WaitForSingleObjectEx(
+    _In_ HANDLE Handle,
+    _In_ DWORD Milliseconds,
+    _In_ BOOL Alertable
+    );
+
+DWORD
+WaitForMultipleObjectsEx(
+    _In_ DWORD Count,
+    _In_reads_(Count) CONST HANDLE* Handles,
+    _In_ BOOL WaitAll,
+    _In_ DWORD Milliseconds,
+    _In_ BOOL Alertable
+    );
+
+BOOL
+CloseHandle(
+    _In_ HANDLE Object
+    );
+
+// Returns a pseudo handle that refers to the current thread.
+//
+HANDLE
+GetCurrentThread(
+    VOID
+    );
+
+// Only the processors 0-63 can be set. Returns the previous affinity or 0 on failure.
+//
+DWORD_PTR
+SetThreadAffinityMask(
+    _In_ HANDLE Thread,
+    _In_ DWORD_PTR ThreadAffinityMask
+    );
+
+BOOL
+WaitOnAddress(
+    _In_ volatile VOID* Address,
+    _In_ VOID* CompareAddress,
+    _In_ SIZE_T AddressSize,
+    _In_opt_ DWORD Milliseconds
+    );
+
+VOID
+WakeByAddressSingle(
+    _In_ VOID* Address
+    );
+
+VOID
+WakeByAddressAll(
+    _In_ VOID* Address
+    );
+
+// Interlocked singly linked lists. The host uses a lock in the list head instead of a
+// double width compare exchange.
+//
+
+typedef struct _SLIST_ENTRY
+{
+    struct _SLIST_ENTRY* Next;
+} SLIST_ENTRY, *PSLIST_ENTRY;
+
+typedef struct _SLIST_HEADER
+{
+    SLIST_ENTRY* Next;
+    USHORT Depth;
+    volatile LONG Lock;
+} SLIST_HEADER, *PSLIST_HEADER;
+
+VOID
+InitializeSListHead(
+    _Out_ PSLIST_HEADER ListHead
+    );
+
+PSLIST_ENTRY
+InterlockedPushEntrySList(
+    _Inout_ PSLIST_HEADER ListHead,
+    _Inout_ PSLIST_ENTRY ListEntry
+    );
+
+PSLIST_ENTRY
+InterlockedPopEntrySList(
+    _Inout_ PSLIST_HEADER ListHead
+    );
+
+PSLIST_ENTRY
+InterlockedFlushSList(
+    _Inout_ PSLIST_HEADER ListHead
+    );
+
+USHORT
+QueryDepthSList(
+    _In_ PSLIST_HEADER ListHead
+    );
+
+// Time.
+//
+
+typedef struct _FILETIME
+{
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME;
+
+typedef struct _SYSTEMTIME
+{
+    WORD wYear;
+    WORD wMonth;
+    WORD wDayOfWeek;
+    WORD wDay;
+    WORD wHour;
+    WORD wMinute;
+    WORD wSecond;
+    WORD wMilliseconds;
+} SYSTEMTIME;
+
+BOOL
+QueryPerformanceCounter(
+    _Out_ LARGE_INTEGER* PerformanceCount
+    );
+
+BOOL
+QueryPerformanceFrequency(
+    _Out_ LARGE_INTEGER* Frequency
+    );
+
+VOID
+GetSystemTimePreciseAsFileTime(
+    _Out_ FILETIME* SystemTimeAsFileTime
+    );
+
+VOID
+GetLocalTime(
+    _Out_ SYSTEMTIME* SystemTime
+    );
+
+__forceinline
+HRESULT
+Long64Mult(
+    _In_ LONGLONG Multiplicand,
+    _In_ LONGLONG Multiplier,
+    _Out_ LONGLONG* Result
+    )
+{
+    if (__builtin_mul_overflow(Multiplicand,
+                               Multiplier,
+                               Result))
+    {
+        *Result = 0;
+        return INTSAFE_E_ARITHMETIC_OVERFLOW;
+    }
+
+    return S_OK;
+}
+
+// Operating system version. There is no ntdll on the host so these return NULL.
+//
+
+typedef struct _OSVERSIONINFOEXW
+{
+    DWORD dwOSVersionInfoSize;
+    DWORD dwMajorVersion;
+    DWORD dwMinorVersion;
+    DWORD dwBuildNumber;
+    DWORD dwPlatformId;
+    WCHAR szCSDVersion[128];
+    WORD wServicePackMajor;
+    WORD wServicePackMinor;
+    WORD wSuiteMask;
+    BYTE wProductType;
+    BYTE wReserved;
+} OSVERSIONINFOEXW;
+
+HMODULE
+GetModuleHandleW(
+    _In_opt_ PCWSTR ModuleName
+    );
+
+VOID*
+GetProcAddress(
+    _In_ HMODULE Module,
+    _In_ PCSTR ProcName
+    );
+
+// Random numbers.
+//
+
+typedef int errno_t;
+
+errno_t
+rand_s(
+    _Out_ unsigned int* RandomValue
+    );
+
+// Strings.
+//
+
+#define CP_ACP                                                  0
+
+typedef struct _UNICODE_STRING
+{
+    USHORT Length;
+    USHORT MaximumLength;
+    PWSTR Buffer;
+} UNICODE_STRING, *PUNICODE_STRING;
+typedef const UNICODE_STRING* PCUNICODE_STRING;
+
+#define DECLARE_CONST_UNICODE_STRING(Name, String)                                              \
+    const WCHAR Name##_buffer[] = String;                                                       \
+    const UNICODE_STRING Name = { sizeof(String) - sizeof(WCHAR), sizeof(String), (PWSTR)Name##_buffer }
+
+typedef struct _STRING
+{
+    USHORT Length;
+    USHORT MaximumLength;
+    PCHAR Buffer;
+} ANSI_STRING, *PANSI_STRING;
+typedef const ANSI_STRING* PCANSI_STRING;
+
+// Conversions only support the characters that are the same in all code pages (ASCII).
+//
+INT
+MultiByteToWideChar(
+    _In_ UINT CodePage,
+    _In_ DWORD Flags,
+    _In_ PCSTR MultiByteString,
+    _In_ INT MultiByteLength,
+    _Out_writes_opt_(WideCharLength) PWSTR WideCharString,
+    _In_ INT WideCharLength
+    );
+
+INT
+WideCharToMultiByte(
+    _In_ UINT CodePage,
+    _In_ DWORD Flags,
+    _In_ PCWSTR WideCharString,
+    _In_ INT WideCharLength,
+    _Out_writes_opt_(MultiByteLength) PSTR MultiByteString,
+    _In_ INT MultiByteLength,
+    _In_opt_ PCSTR DefaultChar,
+    _Out_opt_ BOOL* UsedDefaultChar
+    );
+
+errno_t
+strncpy_s(
+    _Out_writes_(DestinationSize) CHAR* Destination,
+    _In_ size_t DestinationSize,
+    _In_ const CHAR* Source,
+    _In_ size_t Count
+    );
+
+errno_t
+wcsncpy_s(
+    _Out_writes_(DestinationSize) WCHAR* Destination,
+    _In_ size_t DestinationSize,
+    _In_ const WCHAR* Source,
+    _In_ size_t Count
+    );
+
+errno_t
+wcscpy_s(
+    _Out_writes_(DestinationSize) WCHAR* Destination,
+    _In_ size_t DestinationSize,
+    _In_ const WCHAR* Source
+    );
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Tracing. Format strings contain WPP specifiers so only the format string is printed.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#define TRACE_LEVEL_NONE                0
+#define TRACE_LEVEL_CRITICAL            1
+#define TRACE_LEVEL_ERROR               2
+#define TRACE_LEVEL_WARNING             3
+#define TRACE_LEVEL_INFORMATION         4
+#define TRACE_LEVEL_VERBOSE             5
+
+VOID
+DmfHost_Trace(
+    _In_ ULONG Level,
+    _In_ PCSTR Format,
+    ...
+    );
+
+#define TraceEvents(Level, Flags, ...)              DmfHost_Trace((Level), __VA_ARGS__)
+#define TraceError(Flags, ...)                      DmfHost_Trace(TRACE_LEVEL_ERROR, __VA_ARGS__)
+#define TraceInformation(Flags, ...)                DmfHost_Trace(TRACE_LEVEL_INFORMATION, __VA_ARGS__)
+#define TraceVerbose(Flags, ...)                    DmfHost_Trace(TRACE_LEVEL_VERBOSE, __VA_ARGS__)
+#define FuncEntry(Flags)
+#define FuncEntryArguments(Flags, ...)
+#define FuncExit(Flags, ...)
+#define FuncExitVoid(Flags)
+#define FuncExitNoReturn(Flags)
+
+#define DmfAssert(Expression)                       assert(Expression)
+#define DmfAssertMessage(Message, Expression)       assert((Message) && (Expression))
+#define DmfVerifierAssert(Message, Expression)      assert((Message) && (Expression))
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// WDF objects. Every object has a parent (except a device) and is deleted with its parent.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct _DMF_HOST_OBJECT* WDFOBJECT;
+typedef WDFOBJECT WDFDEVICE;
+typedef WDFOBJECT WDFMEMORY;
+typedef WDFOBJECT WDFSPINLOCK;
+typedef WDFOBJECT WDFWAITLOCK;
+typedef WDFOBJECT WDFTIMER;
+
+typedef enum _WDF_EXECUTION_LEVEL
+{
+    WdfExecutionLevelInvalid = 0,
+    WdfExecutionLevelInheritFromParent,
+    WdfExecutionLevelPassive,
+    WdfExecutionLevelDispatch
+} WDF_EXECUTION_LEVEL;
+
+typedef enum _WDF_SYNCHRONIZATION_SCOPE
+{
+    WdfSynchronizationScopeInvalid = 0,
+    WdfSynchronizationScopeInheritFromParent,
+    WdfSynchronizationScopeDevice,
+    WdfSynchronizationScopeQueue,
+    WdfSynchronizationScopeNone
+} WDF_SYNCHRONIZATION_SCOPE;
+
+typedef
+VOID
+EVT_WDF_OBJECT_CONTEXT_CLEANUP(_In_ WDFOBJECT Object);
+typedef EVT_WDF_OBJECT_CONTEXT_CLEANUP* PFN_WDF_OBJECT_CONTEXT_CLEANUP;
+
+typedef
+VOID
+EVT_WDF_OBJECT_CONTEXT_DESTROY(_In_ WDFOBJECT Object);
+typedef EVT_WDF_OBJECT_CONTEXT_DESTROY* PFN_WDF_OBJECT_CONTEXT_DESTROY;
+
+// Identifies a context type. There is one for each context type declared with
+// WDF_DECLARE_CONTEXT_TYPE(). Contexts are found by comparing the address of their type.
+//
+typedef struct _WDF_OBJECT_CONTEXT_TYPE_INFO
+{
+    PCSTR ContextName;
+    size_t ContextSize;
+} WDF_OBJECT_CONTEXT_TYPE_INFO, *PWDF_OBJECT_CONTEXT_TYPE_INFO;
+typedef const WDF_OBJECT_CONTEXT_TYPE_INFO* PCWDF_OBJECT_CONTEXT_TYPE_INFO;
+
+typedef struct _WDF_OBJECT_ATTRIBUTES
+{
+    ULONG Size;
+    PFN_WDF_OBJECT_CONTEXT_CLEANUP EvtCleanupCallback;
+    PFN_WDF_OBJECT_CONTEXT_DESTROY EvtDestroyCallback;
+    WDF_EXECUTION_LEVEL ExecutionLevel;
+    WDF_SYNCHRONIZATION_SCOPE SynchronizationScope;
+    WDFOBJECT ParentObject;
+    // Overrides the size of the context if it is larger.
+    //
+    size_t ContextSizeOverride;
+    PCWDF_OBJECT_CONTEXT_TYPE_INFO ContextTypeInfo;
+} WDF_OBJECT_ATTRIBUTES, *PWDF_OBJECT_ATTRIBUTES;
+
+#define WDF_NO_OBJECT_ATTRIBUTES        NULL
+#define WDF_NO_HANDLE                   NULL
+
+__forceinline
+VOID
+WDF_OBJECT_ATTRIBUTES_INIT(
+    _Out_ PWDF_OBJECT_ATTRIBUTES Attributes
+    )
+{
+    RtlZeroMemory(Attributes,
+                  sizeof(WDF_OBJECT_ATTRIBUTES));
+    Attributes->Size = sizeof(WDF_OBJECT_ATTRIBUTES);
+    Attributes->ExecutionLevel = WdfExecutionLevelInheritFromParent;
+    Attributes->SynchronizationScope = WdfSynchronizationScopeInheritFromParent;
+}
+
+#define WDF_GET_CONTEXT_TYPE_INFO(ContextType)                                                  \
+    (&_WDF_##ContextType##_TYPE_INFO)
+#define WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(Attributes, ContextType)                        \
+    (WDF_OBJECT_ATTRIBUTES_INIT(Attributes), (Attributes)->ContextTypeInfo = WDF_GET_CONTEXT_TYPE_INFO(ContextType))
+#define WDF_OBJECT_ATTRIBUTES_SET_CONTEXT_TYPE(Attributes, ContextType)                         \
+    ((Attributes)->ContextTypeInfo = WDF_GET_CONTEXT_TYPE_INFO(ContextType))
+
+// Returns the context of the given type or NULL if the object does not have one.
+//
+VOID*
+WdfObjectGetTypedContextWorker(
+    _In_ WDFOBJECT Handle,
+    _In_ PCWDF_OBJECT_CONTEXT_TYPE_INFO TypeInfo
+    );
+
+// The type information is weak so that a context type declared in several files has one address.
+//
+#define WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(ContextType, CastingFunction)                        \
+__attribute__((weak))                                                                           \
+const WDF_OBJECT_CONTEXT_TYPE_INFO _WDF_##ContextType##_TYPE_INFO =                             \
+{                                                                                               \
+    #ContextType,                                                                               \
+    sizeof(ContextType)                                                                         \
+};                                                                                              \
+                                                                                                \
+__forceinline                                                                                   \
+ContextType*                                                                                    \
+CastingFunction(                                                                                \
+    _In_ WDFOBJECT Handle                                                                       \
+    )                                                                                           \
+{                                                                                               \
+    return (ContextType*)WdfObjectGetTypedContextWorker(Handle,                                 \
+                                                        WDF_GET_CONTEXT_TYPE_INFO(ContextType)); \
+}
+#define WDF_DECLARE_CONTEXT_TYPE(ContextType)                                                   \
+    WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(ContextType, WdfObjectGet_##ContextType)
+#define WDF_DECLARE_CUSTOM_TYPE(CustomType)
+#define WdfObjectAddCustomType(Handle, CustomType)      STATUS_SUCCESS
+#define WdfObjectIsCustomType(Handle, CustomType)       TRUE
+
+NTSTATUS
+WdfObjectCreate(
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+    _Out_ WDFOBJECT* Object
+    );
+
+NTSTATUS
+WdfObjectAllocateContext(
+    _In_ WDFOBJECT Handle,
+    _In_ PWDF_OBJECT_ATTRIBUTES ContextAttributes,
+    _Outptr_opt_ VOID** Context
+    );
+
+VOID
+WdfObjectDelete(
+    _In_ WDFOBJECT Object
+    );
+
+// Timeouts in 100 nanosecond units. Negative values are relative.
+//
+#define WDF_TIMEOUT_TO_SEC              ((LONGLONG)1 * 10 * 1000 * 1000)
+#define WDF_TIMEOUT_TO_MS               ((LONGLONG)1 * 10 * 1000)
+#define WDF_TIMEOUT_TO_US               ((LONGLONG)1 * 10)
+#define WDF_REL_TIMEOUT_IN_SEC(Time)    ((Time) * -1 * WDF_TIMEOUT_TO_SEC)
+#define WDF_REL_TIMEOUT_IN_MS(Time)     ((Time) * -1 * WDF_TIMEOUT_TO_MS)
+#define WDF_REL_TIMEOUT_IN_US(Time)     ((Time) * -1 * WDF_TIMEOUT_TO_US)
+#define WDF_ALIGN_SIZE_UP(Length, AlignTo)  (((Length) + ((AlignTo) - 1)) & ~((AlignTo) - 1))
+
+// Memory.
+//
+
+NTSTATUS
+WdfMemoryCreate(
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+    _In_ POOL_TYPE PoolType,
+    _In_opt_ ULONG PoolTag,
+    _In_ size_t BufferSize,
+    _Out_ WDFMEMORY* Memory,
+    _Outptr_opt_ VOID** Buffer
+    );
+
+NTSTATUS
+WdfMemoryCreatePreallocated(
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+    _In_ VOID* Buffer,
+    _In_ size_t BufferSize,
+    _Out_ WDFMEMORY* Memory
+    );
+
+VOID*
+WdfMemoryGetBuffer(
+    _In_ WDFMEMORY Memory,
+    _Out_opt_ size_t* BufferSize
+    );
+
+typedef enum _WDF_MEMORY_DESCRIPTOR_TYPE
+{
+    WdfMemoryDescriptorTypeInvalid = 0,
+    WdfMemoryDescriptorTypeBuffer,
+    WdfMemoryDescriptorTypeMdl,
+    WdfMemoryDescriptorTypeHandle
+} WDF_MEMORY_DESCRIPTOR_TYPE;
+
+typedef struct _WDFMEMORY_OFFSET
+{
+    size_t BufferOffset;
+    size_t BufferLength;
+} WDFMEMORY_OFFSET, *PWDFMEMORY_OFFSET;
+
+typedef struct _WDF_MEMORY_DESCRIPTOR
+{
+    WDF_MEMORY_DESCRIPTOR_TYPE Type;
+    union
+    {
+        struct
+        {
+            PVOID Buffer;
+            ULONG Length;
+        } BufferType;
+        struct
+        {
+            WDFMEMORY Memory;
+            PWDFMEMORY_OFFSET Offsets;
+        } HandleType;
+    } u;
+} WDF_MEMORY_DESCRIPTOR, *PWDF_MEMORY_DESCRIPTOR;
+
+__forceinline
+VOID
+WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(
+    _Out_ PWDF_MEMORY_DESCRIPTOR Descriptor,
+    _In_ WDFMEMORY Memory,
+    _In_opt_ PWDFMEMORY_OFFSET Offsets
+    )
+{
+    RtlZeroMemory(Descriptor,
+                  sizeof(WDF_MEMORY_DESCRIPTOR));
+    Descriptor->Type = WdfMemoryDescriptorTypeHandle;
+    Descriptor->u.HandleType.Memory = Memory;
+    Descriptor->u.HandleType.Offsets = Offsets;
+}
+
+// Locks.
+//
+
+NTSTATUS
+WdfSpinLockCreate(
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES SpinLockAttributes,
+    _Out_ WDFSPINLOCK* SpinLock
+    );
+
+VOID
+WdfSpinLockAcquire(
+    _In_ WDFSPINLOCK SpinLock
+    );
+
+VOID
+WdfSpinLockRelease(
+    _In_ WDFSPINLOCK SpinLock
+    );
+
+NTSTATUS
+WdfWaitLockCreate(
+    _In_opt_ PWDF_OBJECT_ATTRIBUTES LockAttributes,
+    _Out_ WDFWAITLOCK* Lock
+    );
+
+NTSTATUS
+WdfWaitLockAcquire(
+    _In_ WDFWAITLOCK Lock,
+    _In_opt_ LONGLONG* Timeout
+    );
+
+VOID
+WdfWaitLockRelease(
+    _In_ WDFWAITLOCK Lock
+    );
+
+// Timers. Each timer has a thread that calls its callback.
+//
+
+typedef
+VOID
+EVT_WDF_TIMER(_In_ WDFTIMER Timer);
+typedef EVT_WDF_TIMER* PFN_WDF_TIMER;
+
+typedef struct _WDF_TIMER_CONFIG
+{
+    ULONG Size;
+    PFN_WDF_TIMER EvtTimerFunc;
+    ULONG Period;
+    BOOLEAN AutomaticSerialization;
+    ULONG TolerableDelay;
+    BOOLEAN UseHighResolutionTimer;
+} WDF_TIMER_CONFIG, *PWDF_TIMER_CONFIG;
+
+__forceinline
+VOID
+WDF_TIMER_CONFIG_INIT_PERIODIC(
+    _Out_ PWDF_TIMER_CONFIG Config,
+    _In_ PFN_WDF_TIMER EvtTimerFunc,
+    _In_ LONG Period
+    )
+{
+    RtlZeroMemory(Config,
+                  sizeof(WDF_TIMER_CONFIG));
+    Config->Size = sizeof(WDF_TIMER_CONFIG);
+    Config->EvtTimerFunc = EvtTimerFunc;
+    Config->Period = (ULONG)Period;
+    Config->AutomaticSerialization = TRUE;
+}
+
+__forceinline
+VOID
+WDF_TIMER_CONFIG_INIT(
+    _Out_ PWDF_TIMER_CONFIG Config,
+    _In_ PFN_WDF_TIMER EvtTimerFunc
+    )
+{
+    WDF_TIMER_CONFIG_INIT_PERIODIC(Config,
+                                   EvtTimerFunc,
+                                   0);
+}
+
+NTSTATUS
+WdfTimerCreate(
+    _In_ PWDF_TIMER_CONFIG Config,
+    _In_ PWDF_OBJECT_ATTRIBUTES Attributes,
+    _Out_ WDFTIMER* Timer
+    );
+
+BOOLEAN
+WdfTimerStart(
+    _In_ WDFTIMER Timer,
+    _In_ LONGLONG DueTime
+    );
+
+BOOLEAN
+WdfTimerStop(
+    _In_ WDFTIMER Timer,
+    _In_ BOOLEAN Wait
+    );
+
+WDFOBJECT
+WdfTimerGetParentObject(
+    _In_ WDFTIMER Timer
+    );
+
+// eof: DmfIncludes_HOST_MODE.h
+//
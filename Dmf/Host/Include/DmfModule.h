@@ -0,0 +1,732 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfModule.h
+
+Abstract:
+
+    Host replacement of Framework\DmfModule.h. It declares the part of the DMF Module
+    interface used by the Modules in the host build. Modules are created, opened, locked,
+    closed and destroyed by DmfHost.c the same way DMF does it for a dynamic Module.
+
+Environment:
+
+    Host (POSIX)
+
+--*/
+
+#pragma once
+
+#if !defined(DMF_HOST_MODE)
+#error This file is only used by the host build. Drivers include Framework\DmfModule.h.
+#endif // !defined(DMF_HOST_MODE)
+
+#include "DmfIncludes_HOST_MODE.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// DMF Module handles and callbacks.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef WDFOBJECT DMFMODULE;
+typedef DMFMODULE* PDMFMODULE;
+
+#define PDMFMODULE_INIT PVOID
+
+// NULL Client Driver Module Instance Name (In case Client Driver does not want to populate this field.)
+// In this case, DMF Framework will use the Module Name by default.
+//
+#define DMF_CLIENT_MODULE_INSTANCE_NAME_DEFAULT             ""
+
+typedef struct _DMF_TIME_FIELDS
+{
+    UINT16 Year;
+    UINT16 Month;
+    UINT16 Day;
+    UINT16 Hour;
+    UINT16 Minute;
+    UINT16 Second;
+    UINT16 Milliseconds;
+    UINT16 Weekday;
+} DMF_TIME_FIELDS;
+
+struct _DMF_MODULE_ATTRIBUTES;
+
+typedef
+_Must_inspect_result_
+NTSTATUS
+DMF_ModuleInstanceCreate(_In_ WDFDEVICE Device,
+                         _In_ struct _DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+                         _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+                         _Out_ DMFMODULE* DmfModule);
+
+typedef struct _DMF_MODULE_ATTRIBUTES
+{
+    // Size of this Structure.
+    //
+    ULONG SizeOfHeader;
+    // It is a pointer to the Module Specific Config.
+    //
+    VOID* ModuleConfigPointer;
+    // It is the size of the Module Specific Config which is pointed to
+    // by ModuleConfigPointer.
+    //
+    ULONG SizeOfModuleSpecificConfig;
+    // The address of the function that creates the DMF Module.
+    //
+    DMF_ModuleInstanceCreate* InstanceCreator;
+    // NULL Terminated Client Driver Module Instance Name.
+    //
+    CONST CHAR* ClientModuleInstanceName;
+    // TRUE if Client wants the Module options to be set to MODULE_OPTIONS_PASSIVE.
+    // NOTE: Module Options must be set to MODULE_OPTIONS_DISPATCH_MAXIMUM.
+    //
+    BOOLEAN PassiveLevel;
+} DMF_MODULE_ATTRIBUTES;
+
+__forceinline
+VOID
+DMF_MODULE_ATTRIBUTES_INIT(
+    _Out_ volatile DMF_MODULE_ATTRIBUTES* Attributes,
+    _In_ ULONG SizeOfModuleSpecificConfig
+    )
+{
+    RtlZeroMemory((void*)Attributes,
+                  sizeof(DMF_MODULE_ATTRIBUTES));
+    Attributes->SizeOfHeader = sizeof(DMF_MODULE_ATTRIBUTES);
+    Attributes->SizeOfModuleSpecificConfig = SizeOfModuleSpecificConfig;
+    Attributes->ClientModuleInstanceName = DMF_CLIENT_MODULE_INSTANCE_NAME_DEFAULT;
+}
+
+typedef
+_Function_class_(DMF_Open)
+_IRQL_requires_same_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Open(_In_ DMFMODULE DmfModule);
+
+typedef
+_Function_class_(DMF_Close)
+_IRQL_requires_same_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Close(_In_ DMFMODULE DmfModule);
+
+typedef
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_same_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_ChildModulesAdd(_In_ DMFMODULE DmfModule,
+                    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+                    _In_ PDMFMODULE_INIT DmfModuleInit);
+
+// These are DMF specific Module callbacks. The host build supports the ones used by
+// Modules that do not depend on a device stack.
+//
+typedef struct
+{
+    ULONG Size;
+    DMF_Open* DeviceOpen;
+    DMF_Close* DeviceClose;
+    DMF_ChildModulesAdd* ChildModulesAdd;
+} DMF_CALLBACKS_DMF;
+
+__forceinline
+VOID
+DMF_CALLBACKS_DMF_INIT(
+    _Out_ DMF_CALLBACKS_DMF* CallbacksDmf
+    )
+{
+    RtlZeroMemory(CallbacksDmf,
+                  sizeof(DMF_CALLBACKS_DMF));
+    CallbacksDmf->Size = sizeof(DMF_CALLBACKS_DMF);
+}
+
+// Module options.
+//
+#define DMF_MODULE_OPTIONS_PASSIVE              0x00000001
+#define DMF_MODULE_OPTIONS_DISPATCH             0x00000002
+// DMF_MODULE_OPTIONS_DISPATCH by default.
+// Client can override it to DMF_MODULE_OPTIONS_PASSIVE.
+//
+#define DMF_MODULE_OPTIONS_DISPATCH_MAXIMUM     0x00000004
+
+// There is no PnP on the host. Every Module is opened when it is created.
+//
+typedef enum
+{
+    DMF_MODULE_OPEN_OPTION_Invalid = 0,
+    DMF_MODULE_OPEN_OPTION_OPEN_Create,
+    DMF_MODULE_OPEN_OPTION_OPEN_PrepareHardware,
+    DMF_MODULE_OPEN_OPTION_OPEN_D0EntrySystemPowerUp,
+    DMF_MODULE_OPEN_OPTION_OPEN_D0Entry,
+    DMF_MODULE_OPEN_OPTION_NOTIFY_PrepareHardware,
+    DMF_MODULE_OPEN_OPTION_NOTIFY_D0Entry,
+    DMF_MODULE_OPEN_OPTION_NOTIFY_Create,
+    DMF_MODULE_OPEN_OPTION_LAST,
+} DmfModuleOpenOption;
+
+typedef struct
+{
+    // Size of this structure.
+    //
+    ULONG Size;
+    // Module Name.
+    //
+    PSTR ModuleName;
+    // Module Options.
+    //
+    ULONG ModuleOptions;
+    // Indicates when the Module is opened.
+    //
+    DmfModuleOpenOption OpenOption;
+    // Size of the Module Config.
+    //
+    ULONG ModuleConfigSize;
+    // DMF callbacks.
+    //
+    DMF_CALLBACKS_DMF* CallbacksDmf;
+    // Number of auxiliary locks the Module needs.
+    //
+    ULONG NumberOfAuxiliaryLocks;
+    // Module Context attributes.
+    //
+    PWDF_OBJECT_ATTRIBUTES ModuleContextAttributes;
+} DMF_MODULE_DESCRIPTOR;
+
+#define DMF_MODULE_DESCRIPTOR_INIT(Descriptor, Name, Module_Options, Open_Option)                       \
+                                                                                                        \
+RtlZeroMemory(&Descriptor,                                                                              \
+              sizeof(DMF_MODULE_DESCRIPTOR));                                                           \
+                                                                                                        \
+Descriptor.Size                            = sizeof(DMF_MODULE_DESCRIPTOR);                             \
+Descriptor.ModuleName                      = ""#Name;                                                   \
+Descriptor.ModuleOptions                   = Module_Options;                                            \
+Descriptor.OpenOption                      = Open_Option;                                               \
+Descriptor.ModuleConfigSize                = sizeof(DMF_CONFIG_##Name);                                 \
+Descriptor.NumberOfAuxiliaryLocks          = 0;                                                         \
+Descriptor.CallbacksDmf                    = NULL;                                                      \
+Descriptor.ModuleContextAttributes         = WDF_NO_OBJECT_ATTRIBUTES;                                  \
+
+#define DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(Descriptor, Name, ModuleContext, Module_Options, Open_Option)         \
+                                                                                                                      \
+WDF_OBJECT_ATTRIBUTES moduleContextAttributes;                                                                        \
+DMF_MODULE_DESCRIPTOR_INIT(Descriptor, Name, Module_Options, Open_Option)                                             \
+WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&moduleContextAttributes,                                                     \
+                                        ModuleContext);                                                               \
+Descriptor.ModuleContextAttributes         = &moduleContextAttributes;                                                \
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Module declaration macros.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// DECLARE_DMF_MODULE_EX() allows the Module author to set default values for the Module
+// Config. DECLARE_DMF_MODULE() initializes the Module Config with RtlZeroMemory().
+//
+#define DECLARE_DMF_MODULE_EX(ModuleName)                                                       \
+                                                                                                \
+_IRQL_requires_max_(PASSIVE_LEVEL)                                                              \
+_Must_inspect_result_                                                                           \
+NTSTATUS                                                                                        \
+DMF_##ModuleName##_Create(                                                                      \
+    _In_ WDFDEVICE Device,                                                                      \
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,                                            \
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,                                               \
+    _Out_ DMFMODULE* DmfModule                                                                  \
+    );                                                                                          \
+                                                                                                \
+__forceinline                                                                                   \
+VOID                                                                                            \
+DMF_##ModuleName##_ATTRIBUTES_INIT(                                                             \
+    _Out_ volatile DMF_MODULE_ATTRIBUTES* Attributes                                            \
+    )                                                                                           \
+{                                                                                               \
+    DMF_MODULE_ATTRIBUTES_INIT(Attributes,                                                      \
+                               sizeof(DMF_CONFIG_##ModuleName));                                \
+    Attributes->InstanceCreator = DMF_##ModuleName##_Create;                                    \
+}                                                                                               \
+                                                                                                \
+__forceinline                                                                                   \
+VOID                                                                                            \
+DMF_CONFIG_##ModuleName##_AND_ATTRIBUTES_INIT(                                                  \
+    _Out_ DMF_CONFIG_##ModuleName* ModuleConfig,                                                \
+    _Out_ volatile DMF_MODULE_ATTRIBUTES* ModuleAttributes                                      \
+    )                                                                                           \
+{                                                                                               \
+    RtlZeroMemory(ModuleConfig,                                                                 \
+                  sizeof(DMF_CONFIG_##ModuleName));                                             \
+    DMF_CONFIG_##ModuleName##_DEFAULT(ModuleConfig);                                            \
+    DMF_##ModuleName##_ATTRIBUTES_INIT(ModuleAttributes);                                       \
+    ModuleAttributes->ModuleConfigPointer = ModuleConfig;                                       \
+}                                                                                               \
+
+// DECLARE_DMF_MODULE() in terms of DECLARE_DMF_MODULE_EX() with empty initializer.
+//
+#define DECLARE_DMF_MODULE(ModuleName)                                                          \
+__forceinline                                                                                   \
+VOID                                                                                            \
+DMF_CONFIG_##ModuleName##_DEFAULT(                                                              \
+    _Inout_ DMF_CONFIG_##ModuleName* ModuleConfig                                               \
+    )                                                                                           \
+{                                                                                               \
+    UNREFERENCED_PARAMETER(ModuleConfig);                                                       \
+}                                                                                               \
+DECLARE_DMF_MODULE_EX(ModuleName)
+
+#define DECLARE_DMF_MODULE_NO_CONFIG(ModuleName)                                                \
+                                                                                                \
+_IRQL_requires_max_(PASSIVE_LEVEL)                                                              \
+_Must_inspect_result_                                                                           \
+NTSTATUS                                                                                        \
+DMF_##ModuleName##_Create(                                                                      \
+    _In_ WDFDEVICE Device,                                                                      \
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,                                            \
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,                                               \
+    _Out_ DMFMODULE* DmfModule                                                                  \
+    );                                                                                          \
+                                                                                                \
+__forceinline                                                                                   \
+VOID                                                                                            \
+DMF_##ModuleName##_ATTRIBUTES_INIT(                                                             \
+    _Out_ volatile DMF_MODULE_ATTRIBUTES* Attributes                                            \
+    )                                                                                           \
+{                                                                                               \
+    DMF_MODULE_ATTRIBUTES_INIT(Attributes,                                                      \
+                               0);                                                              \
+    Attributes->InstanceCreator = DMF_##ModuleName##_Create;                                    \
+}                                                                                               \
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Module support functions. Implemented in DmfHost.c.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_ModuleCreate(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* DmfModuleObjectAttributes,
+    _In_ DMF_MODULE_DESCRIPTOR* ModuleDescriptor,
+    _Out_ DMFMODULE* DmfModule
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_DmfModuleAdd(
+    _Inout_ PDMFMODULE_INIT DmfModuleInit,
+    _In_ DMF_MODULE_ATTRIBUTES* ModuleAttributes,
+    _In_opt_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _In_opt_ DMFMODULE* ResultantDmfModule
+    );
+
+VOID*
+DMF_ModuleConfigGet(
+    _In_ DMFMODULE DmfModule
+    );
+
+WDFDEVICE
+DMF_ParentDeviceGet(
+    _In_ DMFMODULE DmfModule
+    );
+
+DMFMODULE
+DMF_ParentModuleGet(
+    _In_ DMFMODULE DmfModule
+    );
+
+_Must_inspect_result_
+BOOLEAN
+DMF_IsModulePassiveLevel(
+    _In_ DMFMODULE DmfModule
+    );
+
+_Must_inspect_result_
+BOOLEAN
+DMF_ModuleLockIsPassive(
+    _In_ DMFMODULE DmfModule
+    );
+
+_Must_inspect_result_
+BOOLEAN
+DMF_IsPoolTypePassiveLevel(
+    _In_ POOL_TYPE PoolType
+    );
+
+_Must_inspect_result_
+BOOLEAN
+DMF_ModuleIsLocked(
+    _In_ DMFMODULE DmfModule
+    );
+
+VOID
+DMF_ModuleLockPrivate(
+    _In_ DMFMODULE DmfModule
+    );
+
+VOID
+DMF_ModuleUnlockPrivate(
+    _In_ DMFMODULE DmfModule
+    );
+
+VOID
+DMF_ModuleAuxiliaryLockPrivate(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG AuxiliaryLockIndex
+    );
+
+VOID
+DMF_ModuleAuxiliaryUnlockPrivate(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG AuxiliaryLockIndex
+    );
+
+// Macros called by Modules.
+//
+// NOTE: Lock/Unlock inline functions return NULL to match DMF.
+//
+
+#define DMF_MODULE_DECLARE_CONTEXT(ModuleName)                                                           \
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DMF_CONTEXT_##ModuleName,                                             \
+                                   ModuleName##ContextGet);                                              \
+                                                                                                         \
+__forceinline                                                                                            \
+DMF_CONTEXT_##ModuleName*                                                                                \
+DMF_CONTEXT_GET(                                                                                         \
+    _In_ WDFOBJECT Handle                                                                                \
+    )                                                                                                    \
+{                                                                                                        \
+    return(ModuleName##ContextGet(Handle));                                                              \
+}                                                                                                        \
+                                                                                                         \
+__forceinline                                                                                            \
+DMF_CONTEXT_##ModuleName*                                                                                \
+DMF_ModuleLock(DMFMODULE DmfModule)                                                                      \
+{                                                                                                        \
+    DMF_ModuleLockPrivate(DmfModule);                                                                    \
+    return NULL;                                                                                         \
+}                                                                                                        \
+                                                                                                         \
+__forceinline                                                                                            \
+DMF_CONTEXT_##ModuleName*                                                                                \
+DMF_ModuleUnlock(DMFMODULE DmfModule)                                                                    \
+{                                                                                                        \
+    DMF_ModuleUnlockPrivate(DmfModule);                                                                  \
+    return NULL;                                                                                         \
+}                                                                                                        \
+                                                                                                         \
+__forceinline                                                                                            \
+DMF_CONTEXT_##ModuleName*                                                                                \
+DMF_ModuleAuxiliaryLock(                                                                                 \
+    _In_ DMFMODULE DmfModule,                                                                            \
+    _In_ ULONG AuxiliaryLockIndex                                                                        \
+    )                                                                                                    \
+{                                                                                                        \
+    DMF_ModuleAuxiliaryLockPrivate(DmfModule,                                                            \
+                                   AuxiliaryLockIndex);                                                  \
+    return NULL;                                                                                         \
+}                                                                                                        \
+                                                                                                         \
+__forceinline                                                                                            \
+DMF_CONTEXT_##ModuleName*                                                                                \
+DMF_ModuleAuxiliaryUnlock(                                                                               \
+    _In_ DMFMODULE DmfModule,                                                                            \
+    _In_ ULONG AuxiliaryLockIndex                                                                        \
+    )                                                                                                    \
+{                                                                                                        \
+    DMF_ModuleAuxiliaryUnlockPrivate(DmfModule,                                                          \
+                                     AuxiliaryLockIndex);                                                \
+    return NULL;                                                                                         \
+}                                                                                                        \
+
+#define DMF_MODULE_DECLARE_CONFIG(ModuleName)                                                   \
+                                                                                                \
+__forceinline                                                                                   \
+DMF_CONFIG_##ModuleName*                                                                        \
+DMF_CONFIG_GET(                                                                                 \
+    _In_ DMFMODULE DmfModule                                                                    \
+    )                                                                                           \
+{                                                                                               \
+    return (( DMF_CONFIG_##ModuleName* )DMF_ModuleConfigGet(DmfModule));                        \
+}                                                                                               \
+
+#define DMF_MODULE_DECLARE_NO_CONTEXT(ModuleName)
+
+// When a Module has no Config, declare a dummy Config that is not used by Module or Clients,
+// but makes it possible to easily set the size of the Config to a valid value.
+//
+#define DMF_MODULE_DECLARE_NO_CONFIG(ModuleName)                                                \
+typedef struct                                                                                  \
+{                                                                                               \
+    VOID* UnusedElement;                                                                        \
+} DMF_CONFIG_##ModuleName;                                                                      \
+                                                                                                \
+
+// Method validation and Live Kernel Dump support are not part of the host build.
+//
+#define DMFMODULE_VALIDATE_IN_METHOD(DmfModule, ModuleName)                 UNREFERENCED_PARAMETER(DmfModule)
+#define DMFMODULE_VALIDATE_IN_METHOD_OPENING_OK(DmfModule, ModuleName)      UNREFERENCED_PARAMETER(DmfModule)
+#define DMFMODULE_VALIDATE_IN_METHOD_CLOSING_OK(DmfModule, ModuleName)      UNREFERENCED_PARAMETER(DmfModule)
+#define DMFMODULEVOID_TO_MODULE(DmfModuleVoid)                              ((DMFMODULE)(DmfModuleVoid))
+#define DMF_MODULE_LIVEKERNELDUMP_POINTER_STORE(...)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Portable Api. Same as Framework\DmfDefinitions.h in User-mode. Implemented in Framework\DmfPortable.c.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct _DMF_PORTABLE_EVENT
+{
+    HANDLE Handle;
+} DMF_PORTABLE_EVENT;
+
+typedef struct _DMF_PORTABLE_LOOKASIDELIST_CACHE DMF_PORTABLE_LOOKASIDELIST_CACHE;
+
+typedef struct _DMF_PORTABLE_LOOKASIDELIST
+{
+    WDF_OBJECT_ATTRIBUTES MemoryAttributes;
+    POOL_TYPE PoolType;
+    ULONG PoolTag;
+    size_t BufferSize;
+    WDFOBJECT WdflookasideList;
+    DMF_PORTABLE_LOOKASIDELIST_CACHE* Cache;
+} DMF_PORTABLE_LOOKASIDELIST;
+
+typedef struct _DMF_PORTABLE_LOOKASIDELIST_STATISTICS
+{
+    ULONG TotalAllocates;
+    ULONG AllocateHits;
+    ULONG AllocateMisses;
+    ULONG TotalFrees;
+    ULONG FreeHits;
+    ULONG FreeMisses;
+    ULONG Depth;
+    ULONG CachedBuffers;
+} DMF_PORTABLE_LOOKASIDELIST_STATISTICS;
+
+typedef struct _DMF_PORTABLE_RUNDOWN
+{
+    volatile LONG Count;
+} DMF_PORTABLE_RUNDOWN_REF;
+
+typedef struct _DMF_PORTABLE_COMPLETION
+{
+    volatile LONG Signaled;
+} DMF_PORTABLE_COMPLETION;
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Portable_EventCreate(
+    _Out_ DMF_PORTABLE_EVENT* EventPointer,
+    _In_ EVENT_TYPE EventType,
+    _In_ BOOLEAN InitialState
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_Portable_EventSet(
+    _In_ DMF_PORTABLE_EVENT* EventPointer
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_Portable_EventReset(
+    _In_ DMF_PORTABLE_EVENT* EventPointer
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Portable_EventWaitForSingleObject(
+    _In_ DMF_PORTABLE_EVENT* EventPointer,
+    _In_opt_ ULONG* TimeoutMs,
+    _In_ BOOLEAN Alertable
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Portable_EventWaitForMultiple(
+    _In_ ULONG EventCount,
+    _In_reads_(EventCount) DMF_PORTABLE_EVENT** EventPointer,
+    _In_ BOOLEAN WaitForAll,
+    _In_opt_ ULONG* TimeoutMs,
+    _In_ BOOLEAN Alertable
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Portable_EventClose(
+    _In_ DMF_PORTABLE_EVENT* EventPointer
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Portable_LookasideListCreate(
+    _In_ PWDF_OBJECT_ATTRIBUTES LookasideAttributes,
+    _In_ size_t BufferSize,
+    _In_ POOL_TYPE PoolType,
+    _In_ PWDF_OBJECT_ATTRIBUTES MemoryAttributes,
+    _In_ ULONG PoolTag,
+    _Out_ DMF_PORTABLE_LOOKASIDELIST* LookasidePointer
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Portable_LookasideListCreateMemory(
+    _In_ DMF_PORTABLE_LOOKASIDELIST* LookasidePointer,
+    _Out_ WDFMEMORY* Memory
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Portable_LookasideListDelete(
+    _Inout_ DMF_PORTABLE_LOOKASIDELIST* LookasidePointer
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+DMF_Portable_LookasideListStatisticsGet(
+    _In_ DMF_PORTABLE_LOOKASIDELIST* LookasidePointer,
+    _Out_ DMF_PORTABLE_LOOKASIDELIST_STATISTICS* Statistics
+    );
+
+VOID
+DMF_Portable_Rundown_Initialize(
+    _Inout_ DMF_PORTABLE_RUNDOWN_REF* RundownRef
+    );
+
+VOID
+DMF_Portable_Rundown_Reinitialize(
+    _Inout_ DMF_PORTABLE_RUNDOWN_REF* RundownRef
+    );
+
+_Must_inspect_result_
+BOOLEAN
+DMF_Portable_Rundown_Acquire(
+    _Inout_ DMF_PORTABLE_RUNDOWN_REF* RundownRef
+    );
+
+VOID
+DMF_Portable_Rundown_Release(
+    _Inout_ DMF_PORTABLE_RUNDOWN_REF* RundownRef
+    );
+
+VOID
+DMF_Portable_Rundown_WaitForRundownProtectionRelease(
+    _Inout_ DMF_PORTABLE_RUNDOWN_REF* RundownRef
+    );
+
+VOID
+DMF_Portable_Rundown_Completed(
+    _Inout_ DMF_PORTABLE_RUNDOWN_REF* RundownRef
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_Portable_Completion_Initialize(
+    _Out_ DMF_PORTABLE_COMPLETION* Completion
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_Portable_Completion_Signal(
+    _Inout_ DMF_PORTABLE_COMPLETION* Completion
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Portable_Completion_Wait(
+    _Inout_ DMF_PORTABLE_COMPLETION* Completion
+    );
+
+_Must_inspect_result_
+BOOLEAN
+DMF_Portable_VersionCheck(
+    _In_ ULONG MinimumOsVersion,
+    _Out_ BOOLEAN* IsOsEqualOrGreater
+    );
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Utility functions. Implemented in DmfHost.c.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef enum
+{
+    DmfLogDataSeverity_Invalid = 0,
+    DmfLogDataSeverity_Critical,
+    DmfLogDataSeverity_Error,
+    DmfLogDataSeverity_Warning,
+    DmfLogDataSeverity_Informational,
+    DmfLogDataSeverity_Verbose,
+    DmfLogDataSeverity_Maximum,
+} DmfLogDataSeverity;
+
+// Size of the buffer used to format trace messages on platforms that are not Windows.
+//
+#define DMF_PLATFORM_TRACE_BUFFER_SIZE      512
+
+VOID
+DMF_Utility_DelayMilliseconds(
+    _In_ ULONG Milliseconds
+    );
+
+_Must_inspect_result_
+BOOLEAN
+DMF_Utility_IsEqualGUID(
+    _In_ GUID* Guid1,
+    _In_ GUID* Guid2
+    );
+
+// There is no event log on the host so, as when the Client does not register a log callback,
+// nothing is emitted.
+//
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Utility_LogEmitString(
+    _In_ DMFMODULE DmfModule,
+    _In_ DmfLogDataSeverity DmfLogDataSeverity,
+    _In_z_ WCHAR* FormatString,
+    ...
+    );
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Host only functions.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Creates an object that plays the role of the Client Driver's WDFDEVICE. Modules
+// are created as its children. Deleting it deletes all the Modules.
+//
+_Must_inspect_result_
+NTSTATUS
+DmfHost_DeviceCreate(
+    _Out_ WDFDEVICE* Device
+    );
+
+// eof: DmfModule.h
+//
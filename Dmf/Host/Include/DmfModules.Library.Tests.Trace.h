@@ -0,0 +1,25 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfModules.Library.Tests.Trace.h
+
+Abstract:
+
+    Host replacement of Modules.Library.Tests\DmfModules.Library.Tests.Trace.h.
+
+Environment:
+
+    Host (POSIX)
+
+--*/
+
+#pragma once
+
+#include "DmfModules.Library.Trace.h"
+
+// eof: DmfModules.Library.Tests.Trace.h
+//
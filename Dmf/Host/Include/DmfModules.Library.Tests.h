@@ -0,0 +1,48 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfModules.Library.Tests.h
+
+Abstract:
+
+    Host replacement of Modules.Library.Tests\DmfModules.Library.Tests.h. It includes the
+    Test Modules that are part of the host build.
+
+Environment:
+
+    Host (POSIX)
+
+--*/
+
+#pragma once
+
+#include "DmfModules.Library.h"
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // defined(__cplusplus)
+
+#include "../../Modules.Library.Tests/TestsUtility.h"
+
+// Test Modules that are part of the host build.
+//
+#include "../../Modules.Library.Tests/Dmf_Tests_BufferPool.h"
+#include "../../Modules.Library.Tests/Dmf_Tests_BufferQueue.h"
+#include "../../Modules.Library.Tests/Dmf_Tests_HashTable.h"
+#include "../../Modules.Library.Tests/Dmf_Tests_PingPongBuffer.h"
+#include "../../Modules.Library.Tests/Dmf_Tests_RingBuffer.h"
+#include "../../Modules.Library.Tests/Dmf_Tests_Stack.h"
+#include "../../Modules.Library.Tests/Dmf_Tests_String.h"
+#include "../../Modules.Library.Tests/Dmf_Tests_ThreadedBufferQueue.h"
+
+#if defined(__cplusplus)
+}
+#endif // defined(__cplusplus)
+
+// eof: DmfModules.Library.Tests.h
+//
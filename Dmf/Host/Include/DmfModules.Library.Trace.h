@@ -0,0 +1,26 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfModules.Library.Trace.h
+
+Abstract:
+
+    Host replacement of Modules.Library\DmfModules.Library.Trace.h. There is no WPP on the
+    host so only the trace flags are defined.
+
+Environment:
+
+    Host (POSIX)
+
+--*/
+
+#pragma once
+
+#define DMF_TRACE                       0x00000001
+
+// eof: DmfModules.Library.Trace.h
+//
@@ -0,0 +1,75 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfModules.Library.h
+
+Abstract:
+
+    Host replacement of Modules.Library\DmfModules.Library.h. It includes the definitions
+    of the Modules that are part of the host build.
+
+Environment:
+
+    Host (POSIX)
+
+--*/
+
+#pragma once
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // defined(__cplusplus)
+
+#include "DmfModule.h"
+
+// Modules that are part of the host build.
+//
+#include "../../Modules.Library/Dmf_Thread.h"
+#include "../../Modules.Library/Dmf_Time.h"
+#include "../../Modules.Library/DMF_String.h"
+#include "../../Modules.Library/Dmf_BufferPool.h"
+#include "../../Modules.Library/Dmf_BufferQueue.h"
+#include "../../Modules.Library/Dmf_HashTable.h"
+#include "../../Modules.Library/Dmf_PingPongBuffer.h"
+#include "../../Modules.Library/Dmf_RingBuffer.h"
+#include "../../Modules.Library/Dmf_Stack.h"
+#include "../../Modules.Library/Dmf_ThreadedBufferQueue.h"
+
+// There is no registry on the host. This is the part of the Registry Module used by
+// the Modules above. Its Methods fail with STATUS_NOT_SUPPORTED.
+//
+DECLARE_DMF_MODULE_NO_CONFIG(Registry)
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Registry_PathAndValueReadDwordAndValidate(
+    _In_ DMFMODULE DmfModule,
+    _In_opt_z_ CONST WCHAR* RegistryPathName,
+    _In_z_ CONST WCHAR* ValueName,
+    _Out_ ULONG* Buffer,
+    _In_ ULONG Minimum,
+    _In_ ULONG Maximum
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Registry_PathAndValueWriteDword(
+    _In_ DMFMODULE DmfModule,
+    _In_opt_z_ CONST WCHAR* RegistryPathName,
+    _In_z_ CONST WCHAR* ValueName,
+    _In_ ULONG ValueData
+    );
+
+#if defined(__cplusplus)
+}
+#endif // defined(__cplusplus)
+
+// eof: DmfModules.Library.h
+//
@@ -56,6 +56,8 @@ extern "C"
 #include "Dmf_Tests_String.h"
 #include "Dmf_Tests_AlertableSleep.h"
 #include "Dmf_Tests_Stack.h"
+#include "Dmf_Tests_QueuedWorkItem.h"
+#include "Dmf_Tests_ThreadedBufferQueue.h"
 
 // NOTE: The definitions in this file must be surrounded by this annotation to ensure
 //       that both C and C++ Clients can easily compile and link with Modules in this Library.
@@ -44,6 +44,37 @@ Environment:
     #define BUFFER_COUNT_PREALLOCATED   BUFFER_COUNT_MAX
 #endif
 #define THREAD_COUNT                (2)
+// Source pool that uses per-processor caches.
+//
+#define BUFFER_COUNT_CACHED         (64)
+#define BUFFER_CACHE_SIZE           (8)
+#define BUFFERS_PER_CACHED_ACTION   (BUFFER_COUNT_CACHED / THREAD_COUNT)
+// Source pool that uses size classes.
+//
+#define SIZE_CLASS_COUNT            (3)
+#define SIZE_CLASS_BUFFER_COUNT     (8)
+#define SIZE_CLASS_BUFFER_SIZE(Index)   (BUFFER_SIZE << (2 * (Index)))
+#define SIZE_CLASS_BUFFER_SIZE_MAX  SIZE_CLASS_BUFFER_SIZE(SIZE_CLASS_COUNT - 1)
+#define BUFFERS_PER_SIZE_CLASS_ACTION   (SIZE_CLASS_BUFFER_COUNT / THREAD_COUNT)
+// Source pool that uses adaptive preallocation.
+//
+#define BUFFER_COUNT_ADAPTIVE       (2)
+#define BUFFER_COUNT_ADAPTIVE_MAX   (16)
+#define BUFFERS_PER_ADAPTIVE_ACTION (BUFFER_COUNT_ADAPTIVE_MAX / THREAD_COUNT)
+// Buffers moved at a time from Source to Sink.
+//
+#define BUFFERS_PER_MULTIPLE_ACTION (8)
+#if defined(DMF_USER_MODE)
+// Source pool whose extra buffers come from the User-mode lookaside list cache.
+//
+#define BUFFER_COUNT_LOOKASIDE      (4)
+#define BUFFER_COUNT_LOOKASIDE_CHURN    (16)
+#define LOOKASIDE_CHURN_ROUNDS      (64)
+// Limits of the depth of User-mode lookaside list caches.
+//
+#define LOOKASIDE_DEPTH_MINIMUM     (4)
+#define LOOKASIDE_DEPTH_MAXIMUM     (256)
+#endif
 
 #define CLIENT_CONTEXT_SIGNATURE    'GISB'
 
@@ -64,8 +95,13 @@ typedef enum _TEST_ACTION {
     TEST_ACTION_RETURN,
     TEST_ACTION_ENUMERATE,
     TEST_ACTION_COUNT,
+    TEST_ACTION_CACHED,
+    TEST_ACTION_SIZE_CLASS,
+    TEST_ACTION_ADAPTIVE,
+    TEST_ACTION_MULTIPLE,
+    TEST_ACTION_SPLICE,
     TEST_ACTION_MINIMUM     = TEST_ACTION_AQUIRE,
-    TEST_ACTION_MAXIMUM     = TEST_ACTION_COUNT
+    TEST_ACTION_MAXIMUM     = TEST_ACTION_SPLICE
 } TEST_ACTION;
 
 typedef enum _GET_ACTION {
@@ -97,6 +133,26 @@ typedef struct _DMF_CONTEXT_Tests_BufferPool
     // BufferPool sink Module to test
     //
     DMFMODULE DmfModuleBufferPoolSink;
+    // BufferPool sink Module that buffers are spliced to and from
+    //
+    DMFMODULE DmfModuleBufferPoolSinkSpliced;
+    // BufferPool source Module with per-processor caches to test
+    //
+    DMFMODULE DmfModuleBufferPoolCached;
+    // BufferPool source Module with size classes to test
+    //
+    DMFMODULE DmfModuleBufferPoolSizeClass;
+    // BufferPool source Module with adaptive preallocation to test
+    //
+    DMFMODULE DmfModuleBufferPoolAdaptive;
+    // Same with per-processor caches.
+    //
+    DMFMODULE DmfModuleBufferPoolAdaptiveCached;
+#if defined(DMF_USER_MODE)
+    // BufferPool source Module with a lookaside list to test
+    //
+    DMFMODULE DmfModuleBufferPoolLookaside;
+#endif
     // Work threads
     //
     DMFMODULE DmfModuleThread[THREAD_COUNT];
@@ -410,10 +466,20 @@ Tests_BufferPool_ThreadAction_BufferAquire(
     {
         ULONGLONG timeout;
 
-        // Generate a random timeout within 1 to 100 ms.
+        // Generate a random timeout within 1 to 100 ms. Sometimes use a longer timeout
+        // so that the second level of the Sink's timer wheel is used.
         //
-        timeout = TestsUtility_GenerateRandomNumber(1,
-                                                    100);
+        if (TestsUtility_GenerateRandomNumber(0,
+                                              9) == 0)
+        {
+            timeout = TestsUtility_GenerateRandomNumber(1000,
+                                                        3000);
+        }
+        else
+        {
+            timeout = TestsUtility_GenerateRandomNumber(1,
+                                                        100);
+        }
 
         DMF_BufferPool_PutInSinkWithTimer(moduleContext->DmfModuleBufferPoolSink, 
                                           clientBuffer,
@@ -561,6 +627,581 @@ Tests_BufferPool_ThreadAction_BufferCount(
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+static
+NTSTATUS
+Tests_BufferPool_ThreadAction_BufferCached(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_BufferPool* moduleContext;
+    UINT8* clientBuffers[BUFFERS_PER_CACHED_ACTION];
+    CLIENT_BUFFER_CONTEXT* clientBufferContext;
+    ULONG numberOfBuffers;
+    ULONG numberOfBuffersReturned;
+    ULONG bufferIndex;
+    BOOLEAN useMultiple;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = STATUS_SUCCESS;
+
+    // Each thread gets at most its share of the buffers, so every Get must succeed
+    // even when the remaining buffers are held in other processors' caches.
+    //
+    numberOfBuffers = TestsUtility_GenerateRandomNumber(1,
+                                                        BUFFERS_PER_CACHED_ACTION);
+    useMultiple = (BOOLEAN)TestsUtility_GenerateRandomNumber(0, 1);
+    if (useMultiple)
+    {
+        ntStatus = DMF_BufferPool_GetMultiple(moduleContext->DmfModuleBufferPoolCached,
+                                              numberOfBuffers,
+                                              (VOID**)clientBuffers,
+                                              NULL,
+                                              &numberOfBuffersReturned);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        DmfAssert(numberOfBuffersReturned == numberOfBuffers);
+        numberOfBuffers = numberOfBuffersReturned;
+    }
+    for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+    {
+        if (useMultiple)
+        {
+            DMF_BufferPool_ContextGet(moduleContext->DmfModuleBufferPoolCached,
+                                      clientBuffers[bufferIndex],
+                                      (VOID**)&clientBufferContext);
+        }
+        else
+        {
+            ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolCached,
+                                          (VOID**)&clientBuffers[bufferIndex],
+                                          (VOID**)&clientBufferContext);
+            DmfAssert(NT_SUCCESS(ntStatus));
+            if (!NT_SUCCESS(ntStatus))
+            {
+                numberOfBuffers = bufferIndex;
+                break;
+            }
+        }
+
+        TestsUtility_FillWithSequentialData(clientBuffers[bufferIndex],
+                                            BUFFER_SIZE);
+        clientBufferContext->Signature = CLIENT_CONTEXT_SIGNATURE;
+        clientBufferContext->CheckSum = TestsUtility_CrcCompute(clientBuffers[bufferIndex],
+                                                                BUFFER_SIZE);
+    }
+
+    DmfAssert(DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolCached) <= BUFFER_COUNT_CACHED - numberOfBuffers);
+
+    // No other thread may have written to these buffers while this thread owns them.
+    //
+    for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+    {
+        DMF_BufferPool_ContextGet(moduleContext->DmfModuleBufferPoolCached,
+                                  clientBuffers[bufferIndex],
+                                  (VOID**)&clientBufferContext);
+        Tests_BufferPool_Validate(moduleContext->DmfModuleBufferPoolCached,
+                                  clientBuffers[bufferIndex],
+                                  clientBufferContext,
+                                  NULL,
+                                  NULL);
+        if (useMultiple)
+        {
+            continue;
+        }
+        if (TestsUtility_GenerateRandomNumber(0, 1))
+        {
+            DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolCached,
+                               clientBuffers[bufferIndex]);
+        }
+        else
+        {
+            DMF_BufferPool_PutAtHead(moduleContext->DmfModuleBufferPoolCached,
+                                     clientBuffers[bufferIndex]);
+        }
+    }
+    if (useMultiple)
+    {
+        DMF_BufferPool_PutMultiple(moduleContext->DmfModuleBufferPoolCached,
+                                   (VOID**)clientBuffers,
+                                   numberOfBuffers);
+    }
+
+    DmfAssert(DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolCached) <= BUFFER_COUNT_CACHED);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+NTSTATUS
+Tests_BufferPool_ThreadAction_BufferSizeClass(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_BufferPool* moduleContext;
+    UINT8* clientBuffers[BUFFERS_PER_SIZE_CLASS_ACTION];
+    ULONG requestedSizes[BUFFERS_PER_SIZE_CLASS_ACTION];
+    CLIENT_BUFFER_CONTEXT* clientBufferContext;
+    ULONG clientBufferSize;
+    ULONG numberOfBuffers;
+    ULONG bufferIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = STATUS_SUCCESS;
+
+    // Each thread gets at most its share of the largest size class, so every Get must succeed
+    // even when the smaller size classes are empty.
+    //
+    numberOfBuffers = TestsUtility_GenerateRandomNumber(1,
+                                                        BUFFERS_PER_SIZE_CLASS_ACTION);
+    for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+    {
+        requestedSizes[bufferIndex] = TestsUtility_GenerateRandomNumber(1,
+                                                                        SIZE_CLASS_BUFFER_SIZE_MAX);
+        ntStatus = DMF_BufferPool_GetWithSize(moduleContext->DmfModuleBufferPoolSizeClass,
+                                              requestedSizes[bufferIndex],
+                                              (VOID**)&clientBuffers[bufferIndex],
+                                              (VOID**)&clientBufferContext);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        if (!NT_SUCCESS(ntStatus))
+        {
+            numberOfBuffers = bufferIndex;
+            break;
+        }
+
+        DMF_BufferPool_ParametersGet(moduleContext->DmfModuleBufferPoolSizeClass,
+                                     clientBuffers[bufferIndex],
+                                     NULL,
+                                     NULL,
+                                     &clientBufferSize,
+                                     NULL,
+                                     NULL);
+        DmfAssert(clientBufferSize >= requestedSizes[bufferIndex]);
+
+        TestsUtility_FillWithSequentialData(clientBuffers[bufferIndex],
+                                            requestedSizes[bufferIndex]);
+        clientBufferContext->Signature = CLIENT_CONTEXT_SIGNATURE;
+        clientBufferContext->CheckSum = TestsUtility_CrcCompute(clientBuffers[bufferIndex],
+                                                                requestedSizes[bufferIndex]);
+    }
+
+    // No other thread may have written to these buffers while this thread owns them.
+    //
+    for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+    {
+        DMF_BufferPool_ContextGet(moduleContext->DmfModuleBufferPoolSizeClass,
+                                  clientBuffers[bufferIndex],
+                                  (VOID**)&clientBufferContext);
+        DmfAssert(CLIENT_CONTEXT_SIGNATURE == clientBufferContext->Signature);
+        DmfAssert(TestsUtility_CrcCompute(clientBuffers[bufferIndex],
+                                          requestedSizes[bufferIndex]) == clientBufferContext->CheckSum);
+        DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolSizeClass,
+                           clientBuffers[bufferIndex]);
+    }
+
+    DmfAssert(DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolSizeClass) <= SIZE_CLASS_COUNT * SIZE_CLASS_BUFFER_COUNT);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+NTSTATUS
+Tests_BufferPool_ThreadAction_BufferAdaptive(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_BufferPool* moduleContext;
+    DMFMODULE dmfModuleBufferPool;
+    UINT8* clientBuffers[BUFFERS_PER_ADAPTIVE_ACTION];
+    CLIENT_BUFFER_CONTEXT* clientBufferContext;
+    ULONG numberOfBuffers;
+    ULONG bufferIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = STATUS_SUCCESS;
+
+    // Half the time, use the pool whose buffers may be held in per-processor caches.
+    //
+    if (TestsUtility_GenerateRandomNumber(0, 1))
+    {
+        dmfModuleBufferPool = moduleContext->DmfModuleBufferPoolAdaptiveCached;
+    }
+    else
+    {
+        dmfModuleBufferPool = moduleContext->DmfModuleBufferPoolAdaptive;
+    }
+
+    // Usually use more buffers than are preallocated so that the pool grows. Sometimes use
+    // only one so that it may shrink.
+    //
+    if (TestsUtility_GenerateRandomNumber(0, 9) > 0)
+    {
+        numberOfBuffers = BUFFERS_PER_ADAPTIVE_ACTION;
+    }
+    else
+    {
+        numberOfBuffers = 1;
+    }
+
+    for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+    {
+        ntStatus = DMF_BufferPool_Get(dmfModuleBufferPool,
+                                      (VOID**)&clientBuffers[bufferIndex],
+                                      (VOID**)&clientBufferContext);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            // Lookaside allocation can fail under low memory.
+            //
+            numberOfBuffers = bufferIndex;
+            break;
+        }
+
+        TestsUtility_FillWithSequentialData(clientBuffers[bufferIndex],
+                                            BUFFER_SIZE);
+        clientBufferContext->Signature = CLIENT_CONTEXT_SIGNATURE;
+        clientBufferContext->CheckSum = TestsUtility_CrcCompute(clientBuffers[bufferIndex],
+                                                                BUFFER_SIZE);
+    }
+
+    TestsUtility_YieldExecution();
+
+    for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+    {
+        DMF_BufferPool_ContextGet(dmfModuleBufferPool,
+                                  clientBuffers[bufferIndex],
+                                  (VOID**)&clientBufferContext);
+        Tests_BufferPool_Validate(dmfModuleBufferPool,
+                                  clientBuffers[bufferIndex],
+                                  clientBufferContext,
+                                  NULL,
+                                  NULL);
+        DMF_BufferPool_Put(dmfModuleBufferPool,
+                           clientBuffers[bufferIndex]);
+    }
+
+    // The list never keeps more buffers than the adaptive maximum.
+    //
+    DmfAssert(DMF_BufferPool_Count(dmfModuleBufferPool) <= BUFFER_COUNT_ADAPTIVE_MAX);
+
+    return STATUS_SUCCESS;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+NTSTATUS
+Tests_BufferPool_ThreadAction_BufferMultiple(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_BufferPool* moduleContext;
+    UINT8* clientBuffers[BUFFERS_PER_MULTIPLE_ACTION];
+    CLIENT_BUFFER_CONTEXT* clientBufferContexts[BUFFERS_PER_MULTIPLE_ACTION];
+    ULONG numberOfBuffers;
+    ULONG numberOfBuffersReturned;
+    ULONG bufferIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = STATUS_SUCCESS;
+
+    // Don't acquire more then BUFFER_COUNT_MAX buffers
+    //
+    if (DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolSink) >= BUFFER_COUNT_MAX)
+    {
+        goto Exit;
+    }
+
+    // Get several buffers from the source at once.
+    //
+    numberOfBuffers = TestsUtility_GenerateRandomNumber(1,
+                                                        BUFFERS_PER_MULTIPLE_ACTION);
+    ntStatus = DMF_BufferPool_GetMultiple(moduleContext->DmfModuleBufferPoolSource,
+                                          numberOfBuffers,
+                                          (VOID**)clientBuffers,
+                                          (VOID**)clientBufferContexts,
+                                          &numberOfBuffersReturned);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(0 == numberOfBuffersReturned);
+        goto Exit;
+    }
+    DmfAssert(numberOfBuffersReturned > 0);
+    DmfAssert(numberOfBuffersReturned <= numberOfBuffers);
+
+    for (bufferIndex = 0; bufferIndex < numberOfBuffersReturned; bufferIndex++)
+    {
+        DmfAssert(clientBuffers[bufferIndex] != NULL);
+        DmfAssert(clientBufferContexts[bufferIndex] != NULL);
+
+        TestsUtility_FillWithSequentialData(clientBuffers[bufferIndex],
+                                            BUFFER_SIZE);
+        clientBufferContexts[bufferIndex]->Signature = CLIENT_CONTEXT_SIGNATURE;
+        clientBufferContexts[bufferIndex]->CheckSum = TestsUtility_CrcCompute(clientBuffers[bufferIndex],
+                                                                              BUFFER_SIZE);
+    }
+
+    // Put them all into the sink at once.
+    //
+    DMF_BufferPool_PutMultiple(moduleContext->DmfModuleBufferPoolSink,
+                               (VOID**)clientBuffers,
+                               numberOfBuffersReturned);
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+NTSTATUS
+Tests_BufferPool_ThreadAction_BufferSplice(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_BufferPool* moduleContext;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Move all the buffers (including the ones with timers) to the other sink and back.
+    // Buffers whose timers expire in the meantime are returned to the source from either sink.
+    //
+    DMF_BufferPool_Splice(moduleContext->DmfModuleBufferPoolSinkSpliced,
+                          moduleContext->DmfModuleBufferPoolSink);
+
+    TestsUtility_YieldExecution();
+
+    DMF_BufferPool_Splice(moduleContext->DmfModuleBufferPoolSink,
+                          moduleContext->DmfModuleBufferPoolSinkSpliced);
+
+    return STATUS_SUCCESS;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_BufferPool_SizeClassValidate(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_BufferPool* moduleContext;
+    UINT8* clientBuffer;
+    VOID* clientBufferContext;
+    ULONG clientBufferSize;
+    ULONG sizeClassIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(SIZE_CLASS_COUNT * SIZE_CLASS_BUFFER_COUNT == DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolSizeClass));
+
+    // No size class is large enough.
+    //
+    ntStatus = DMF_BufferPool_GetWithSize(moduleContext->DmfModuleBufferPoolSizeClass,
+                                          SIZE_CLASS_BUFFER_SIZE_MAX + 1,
+                                          (VOID**)&clientBuffer,
+                                          &clientBufferContext);
+    DmfAssert(STATUS_INVALID_BUFFER_SIZE == ntStatus);
+
+    // Each request that exactly fits a size class gets a buffer of that size class.
+    //
+    for (sizeClassIndex = 0; sizeClassIndex < SIZE_CLASS_COUNT; sizeClassIndex++)
+    {
+        ntStatus = DMF_BufferPool_GetWithSize(moduleContext->DmfModuleBufferPoolSizeClass,
+                                              SIZE_CLASS_BUFFER_SIZE(sizeClassIndex),
+                                              (VOID**)&clientBuffer,
+                                              &clientBufferContext);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        if (!NT_SUCCESS(ntStatus))
+        {
+            break;
+        }
+
+        DMF_BufferPool_ParametersGet(moduleContext->DmfModuleBufferPoolSizeClass,
+                                     clientBuffer,
+                                     NULL,
+                                     NULL,
+                                     &clientBufferSize,
+                                     NULL,
+                                     NULL);
+        DmfAssert(SIZE_CLASS_BUFFER_SIZE(sizeClassIndex) == clientBufferSize);
+
+        DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolSizeClass,
+                           clientBuffer);
+    }
+
+    DmfAssert(SIZE_CLASS_COUNT * SIZE_CLASS_BUFFER_COUNT == DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolSizeClass));
+}
+#pragma code_seg()
+
+#if defined(DMF_USER_MODE)
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_BufferPool_LookasideValidate(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_BufferPool* moduleContext;
+    DMF_PORTABLE_LOOKASIDELIST_STATISTICS statisticsBefore;
+    DMF_PORTABLE_LOOKASIDELIST_STATISTICS statisticsAfter;
+    UINT8* clientBuffers[BUFFER_COUNT_LOOKASIDE_CHURN];
+    VOID* clientBufferContext;
+    ULONG numberOfBuffers;
+    ULONG bufferIndex;
+    ULONG roundIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = DMF_BufferPool_LookasideStatisticsGet(moduleContext->DmfModuleBufferPoolLookaside,
+                                                     &statisticsBefore);
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    // Pools without a lookaside list have no statistics.
+    //
+    ntStatus = DMF_BufferPool_LookasideStatisticsGet(moduleContext->DmfModuleBufferPoolCached,
+                                                     &statisticsAfter);
+    DmfAssert(STATUS_NOT_SUPPORTED == ntStatus);
+
+    // Take more buffers than the pool holds so that the extra buffers are allocated from the
+    // lookaside list, then return them so that they are deleted (and their memory cached).
+    //
+    for (roundIndex = 0; roundIndex < LOOKASIDE_CHURN_ROUNDS; roundIndex++)
+    {
+        for (numberOfBuffers = 0; numberOfBuffers < BUFFER_COUNT_LOOKASIDE_CHURN; numberOfBuffers++)
+        {
+            ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolLookaside,
+                                          (VOID**)&clientBuffers[numberOfBuffers],
+                                          &clientBufferContext);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                DmfAssert(FALSE);
+                break;
+            }
+        }
+
+        for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+        {
+            DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolLookaside,
+                               clientBuffers[bufferIndex]);
+        }
+    }
+
+    ntStatus = DMF_BufferPool_LookasideStatisticsGet(moduleContext->DmfModuleBufferPoolLookaside,
+                                                     &statisticsAfter);
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    // The cache satisfied some of the allocations and kept some of the freed buffers.
+    //
+    DmfAssert(statisticsAfter.TotalAllocates > statisticsBefore.TotalAllocates);
+    DmfAssert(statisticsAfter.AllocateHits > statisticsBefore.AllocateHits);
+    DmfAssert(statisticsAfter.FreeHits > statisticsBefore.FreeHits);
+    DmfAssert(statisticsAfter.AllocateHits + statisticsAfter.AllocateMisses == statisticsAfter.TotalAllocates);
+    DmfAssert(statisticsAfter.FreeHits + statisticsAfter.FreeMisses == statisticsAfter.TotalFrees);
+    // The depth adapted to the churn without leaving its limits.
+    //
+    DmfAssert(statisticsAfter.Depth >= LOOKASIDE_DEPTH_MINIMUM);
+    DmfAssert(statisticsAfter.Depth <= LOOKASIDE_DEPTH_MAXIMUM);
+    DmfAssert(statisticsAfter.CachedBuffers <= statisticsAfter.Depth);
+
+    DmfAssert(BUFFER_COUNT_LOOKASIDE == DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolLookaside));
+}
+#pragma code_seg()
+#endif
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_BufferPool_CachedDrain(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_BufferPool* moduleContext;
+    UINT8* clientBuffers[BUFFER_COUNT_CACHED];
+    UINT8* clientBuffer;
+    VOID* clientBufferContext;
+    ULONG numberOfBuffers;
+    ULONG bufferIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Every buffer in the pool is available regardless of which cache it is in.
+    //
+    for (numberOfBuffers = 0; numberOfBuffers < BUFFER_COUNT_CACHED; numberOfBuffers++)
+    {
+        ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolCached,
+                                      (VOID**)&clientBuffers[numberOfBuffers],
+                                      &clientBufferContext);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            DmfAssert(FALSE);
+            break;
+        }
+    }
+
+    ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolCached,
+                                  (VOID**)&clientBuffer,
+                                  &clientBufferContext);
+    DmfAssert(!NT_SUCCESS(ntStatus));
+    DmfAssert(0 == DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolCached));
+
+    for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+    {
+        DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolCached,
+                           clientBuffers[bufferIndex]);
+    }
+
+    DmfAssert(BUFFER_COUNT_CACHED == DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolCached));
+
+    // Same using the bulk Methods. They move many buffers to and from the caches at once.
+    //
+    ntStatus = DMF_BufferPool_GetMultiple(moduleContext->DmfModuleBufferPoolCached,
+                                          BUFFER_COUNT_CACHED,
+                                          (VOID**)clientBuffers,
+                                          NULL,
+                                          &numberOfBuffers);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(BUFFER_COUNT_CACHED == numberOfBuffers);
+    DmfAssert(0 == DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolCached));
+
+    DMF_BufferPool_PutMultiple(moduleContext->DmfModuleBufferPoolCached,
+                               (VOID**)clientBuffers,
+                               numberOfBuffers);
+
+    DmfAssert(BUFFER_COUNT_CACHED == DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolCached));
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _Function_class_(EVT_DMF_Thread_Function)
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -608,6 +1249,31 @@ Tests_BufferPool_WorkThread(
         DmfAssert(NT_SUCCESS(ntStatus) ||
                   DMF_Thread_IsStopPending(DmfModuleThread));
         break;
+    case TEST_ACTION_CACHED:
+        ntStatus = Tests_BufferPool_ThreadAction_BufferCached(dmfModule);
+        DmfAssert(NT_SUCCESS(ntStatus) ||
+                  DMF_Thread_IsStopPending(DmfModuleThread));
+        break;
+    case TEST_ACTION_SIZE_CLASS:
+        ntStatus = Tests_BufferPool_ThreadAction_BufferSizeClass(dmfModule);
+        DmfAssert(NT_SUCCESS(ntStatus) ||
+                  DMF_Thread_IsStopPending(DmfModuleThread));
+        break;
+    case TEST_ACTION_ADAPTIVE:
+        ntStatus = Tests_BufferPool_ThreadAction_BufferAdaptive(dmfModule);
+        DmfAssert(NT_SUCCESS(ntStatus) ||
+                  DMF_Thread_IsStopPending(DmfModuleThread));
+        break;
+    case TEST_ACTION_MULTIPLE:
+        ntStatus = Tests_BufferPool_ThreadAction_BufferMultiple(dmfModule);
+        // It can fail if device will be removed.
+        //
+        break;
+    case TEST_ACTION_SPLICE:
+        ntStatus = Tests_BufferPool_ThreadAction_BufferSplice(dmfModule);
+        DmfAssert(NT_SUCCESS(ntStatus) ||
+                  DMF_Thread_IsStopPending(DmfModuleThread));
+        break;
     default:
         ntStatus = STATUS_UNSUCCESSFUL;
         DmfAssert(FALSE);
@@ -672,6 +1338,12 @@ Return Value:
 
     ntStatus = STATUS_SUCCESS;
 
+    Tests_BufferPool_CachedDrain(DmfModule);
+    Tests_BufferPool_SizeClassValidate(DmfModule);
+#if defined(DMF_USER_MODE)
+    Tests_BufferPool_LookasideValidate(DmfModule);
+#endif
+
     for (index = 0; index < THREAD_COUNT; index++)
     {
         ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread[index]);
@@ -811,6 +1483,105 @@ Return Value:
                      WDF_NO_OBJECT_ATTRIBUTES,
                      &moduleContext->DmfModuleBufferPoolSink);
 
+    // BufferPool Sink for splicing
+    // ----------------------------
+    //
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigBufferPool,
+                                              &moduleAttributes);
+    moduleConfigBufferPool.BufferPoolMode = BufferPool_Mode_Sink;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferPoolSinkSpliced);
+
+    // BufferPool Source with per-processor caches
+    // -------------------------------------------
+    //
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigBufferPool,
+                                              &moduleAttributes);
+    moduleConfigBufferPool.BufferPoolMode = BufferPool_Mode_Source;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferContextSize = sizeof(CLIENT_BUFFER_CONTEXT);
+    moduleConfigBufferPool.Mode.SourceSettings.BufferSize = BUFFER_SIZE;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferCount = BUFFER_COUNT_CACHED;
+    moduleConfigBufferPool.Mode.SourceSettings.PerProcessorCacheSize = BUFFER_CACHE_SIZE;
+    moduleConfigBufferPool.Mode.SourceSettings.PoolType = NonPagedPoolNx;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferPoolCached);
+
+    // BufferPool Source with size classes
+    // -----------------------------------
+    //
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigBufferPool,
+                                              &moduleAttributes);
+    moduleConfigBufferPool.BufferPoolMode = BufferPool_Mode_Source;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferContextSize = sizeof(CLIENT_BUFFER_CONTEXT);
+    moduleConfigBufferPool.Mode.SourceSettings.PoolType = NonPagedPoolNx;
+    moduleConfigBufferPool.Mode.SourceSettings.NumberOfSizeClasses = SIZE_CLASS_COUNT;
+    for (ULONG sizeClassIndex = 0; sizeClassIndex < SIZE_CLASS_COUNT; sizeClassIndex++)
+    {
+        moduleConfigBufferPool.Mode.SourceSettings.SizeClasses[sizeClassIndex].BufferSize = SIZE_CLASS_BUFFER_SIZE(sizeClassIndex);
+        moduleConfigBufferPool.Mode.SourceSettings.SizeClasses[sizeClassIndex].BufferCount = SIZE_CLASS_BUFFER_COUNT;
+    }
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferPoolSizeClass);
+
+    // BufferPool Source with adaptive preallocation
+    // ---------------------------------------------
+    //
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigBufferPool,
+                                              &moduleAttributes);
+    moduleConfigBufferPool.BufferPoolMode = BufferPool_Mode_Source;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferContextSize = sizeof(CLIENT_BUFFER_CONTEXT);
+    moduleConfigBufferPool.Mode.SourceSettings.BufferSize = BUFFER_SIZE;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferCount = BUFFER_COUNT_ADAPTIVE;
+    moduleConfigBufferPool.Mode.SourceSettings.EnableLookAside = TRUE;
+    moduleConfigBufferPool.Mode.SourceSettings.AdaptiveBufferCountMaximum = BUFFER_COUNT_ADAPTIVE_MAX;
+    moduleConfigBufferPool.Mode.SourceSettings.PoolType = NonPagedPoolNx;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferPoolAdaptive);
+
+    // BufferPool Source with adaptive preallocation and per-processor caches
+    // ----------------------------------------------------------------------
+    //
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigBufferPool,
+                                              &moduleAttributes);
+    moduleConfigBufferPool.BufferPoolMode = BufferPool_Mode_Source;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferContextSize = sizeof(CLIENT_BUFFER_CONTEXT);
+    moduleConfigBufferPool.Mode.SourceSettings.BufferSize = BUFFER_SIZE;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferCount = BUFFER_COUNT_ADAPTIVE;
+    moduleConfigBufferPool.Mode.SourceSettings.EnableLookAside = TRUE;
+    moduleConfigBufferPool.Mode.SourceSettings.AdaptiveBufferCountMaximum = BUFFER_COUNT_ADAPTIVE_MAX;
+    moduleConfigBufferPool.Mode.SourceSettings.PerProcessorCacheSize = BUFFER_CACHE_SIZE;
+    moduleConfigBufferPool.Mode.SourceSettings.PoolType = NonPagedPoolNx;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferPoolAdaptiveCached);
+
+#if defined(DMF_USER_MODE)
+    // BufferPool Source with a lookaside list
+    // ---------------------------------------
+    //
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigBufferPool,
+                                              &moduleAttributes);
+    moduleConfigBufferPool.BufferPoolMode = BufferPool_Mode_Source;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferContextSize = sizeof(CLIENT_BUFFER_CONTEXT);
+    moduleConfigBufferPool.Mode.SourceSettings.BufferSize = BUFFER_SIZE;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferCount = BUFFER_COUNT_LOOKASIDE;
+    moduleConfigBufferPool.Mode.SourceSettings.EnableLookAside = TRUE;
+    moduleConfigBufferPool.Mode.SourceSettings.PoolType = NonPagedPoolNx;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferPoolLookaside);
+#endif
+
     // Thread
     // ------
     //
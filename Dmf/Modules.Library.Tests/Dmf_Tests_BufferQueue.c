@@ -48,6 +48,15 @@ Environment:
 // Number of working threads
 //
 #define THREAD_COUNT                (2)
+// Max number of buffers enqueued or dequeued at a time
+//
+#define BUFFERS_PER_MULTIPLE_ACTION (2)
+// Number of priority levels of the priority BufferQueue
+//
+#define PRIORITY_LEVELS             (3)
+// Dequeues between dequeues from a lower priority level
+//
+#define PRIORITY_AGING_INTERVAL     (4)
 
 #define CLIENT_CONTEXT_SIGNATURE    'GISB'
 
@@ -81,6 +90,12 @@ typedef struct _DMF_CONTEXT_Tests_BufferQueue
 #if !defined(DMF_USER_MODE)
     DMFMODULE DmfModuleBufferQueueTimer;
 #endif
+    // BufferQueue Module that uses BufferQueue_Backend_LockFree.
+    //
+    DMFMODULE DmfModuleBufferQueueLockFree;
+    // BufferQueue Module with several priority levels.
+    //
+    DMFMODULE DmfModuleBufferQueuePriority;
     // Work threads
     //
     DMFMODULE DmfModuleThread[THREAD_COUNT];
@@ -370,6 +385,82 @@ Exit:
 
 #endif
 
+#pragma code_seg("PAGE")
+static
+void
+Tests_BufferQueue_ThreadAction_EnqueueMultiple(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_BufferQueue* moduleContext;
+    PUINT8 clientBuffers[BUFFERS_PER_MULTIPLE_ACTION];
+    PCLIENT_BUFFER_CONTEXT clientBufferContexts[BUFFERS_PER_MULTIPLE_ACTION];
+    ULONG currentCount;
+    ULONG numberOfBuffers;
+    ULONG numberOfBuffersFetched;
+    ULONG bufferIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Don't enqueue more then BUFFER_COUNT_MAX buffers.
+    //
+    currentCount = DMF_BufferQueue_Count(moduleContext->DmfModuleBufferQueue);
+    if (currentCount >= BUFFER_COUNT_MAX)
+    {
+        goto Exit;
+    }
+
+    numberOfBuffers = TestsUtility_GenerateRandomNumber(1,
+                                                        BUFFERS_PER_MULTIPLE_ACTION);
+    if (numberOfBuffers > BUFFER_COUNT_MAX - currentCount)
+    {
+        numberOfBuffers = BUFFER_COUNT_MAX - currentCount;
+    }
+
+    // Fetch new buffers from producer list.
+    //
+    ntStatus = DMF_BufferQueue_FetchMultiple(moduleContext->DmfModuleBufferQueue,
+                                             numberOfBuffers,
+                                             (PVOID*)clientBuffers,
+                                             (PVOID*)clientBufferContexts,
+                                             &numberOfBuffersFetched);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    DmfAssert(numberOfBuffersFetched <= numberOfBuffers);
+
+    // Populate the buffers with test data.
+    //
+    for (bufferIndex = 0; bufferIndex < numberOfBuffersFetched; bufferIndex++)
+    {
+        DmfAssert(clientBuffers[bufferIndex] != NULL);
+        DmfAssert(clientBufferContexts[bufferIndex] != NULL);
+
+        TestsUtility_FillWithSequentialData(clientBuffers[bufferIndex],
+                                            BUFFER_SIZE);
+
+        clientBufferContexts[bufferIndex]->Signature = CLIENT_CONTEXT_SIGNATURE;
+        clientBufferContexts[bufferIndex]->CheckSum = TestsUtility_CrcCompute(clientBuffers[bufferIndex],
+                                                                              BUFFER_SIZE);
+    }
+
+    // Add these buffers to the queue.
+    //
+    DMF_BufferQueue_EnqueueMultiple(moduleContext->DmfModuleBufferQueue,
+                                    (PVOID*)clientBuffers,
+                                    numberOfBuffersFetched);
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 static
 void
@@ -413,6 +504,246 @@ Exit:
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+static
+void
+Tests_BufferQueue_ThreadAction_DequeueMultiple(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_BufferQueue* moduleContext;
+    PUINT8 clientBuffers[BUFFERS_PER_MULTIPLE_ACTION];
+    PCLIENT_BUFFER_CONTEXT clientBufferContexts[BUFFERS_PER_MULTIPLE_ACTION];
+    ULONG numberOfBuffers;
+    ULONG bufferIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Dequeue several buffers.
+    //
+    ntStatus = DMF_BufferQueue_DequeueMultiple(moduleContext->DmfModuleBufferQueue,
+                                               BUFFERS_PER_MULTIPLE_ACTION,
+                                               (PVOID*)clientBuffers,
+                                               (PVOID*)clientBufferContexts,
+                                               &numberOfBuffers);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(0 == numberOfBuffers);
+        goto Exit;
+    }
+
+    // Validate these buffers.
+    //
+    for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+    {
+        Tests_BufferQueue_Validate(moduleContext->DmfModuleBufferQueue,
+                                   clientBuffers[bufferIndex],
+                                   clientBufferContexts[bufferIndex]);
+    }
+
+    // Return them to the queue's producer list for reuse.
+    //
+    DMF_BufferQueue_ReuseMultiple(moduleContext->DmfModuleBufferQueue,
+                                  (PVOID*)clientBuffers,
+                                  numberOfBuffers);
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+void
+Tests_BufferQueue_ThreadAction_LockFree(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_BufferQueue* moduleContext;
+    PUINT8 clientBuffers[BUFFERS_PER_MULTIPLE_ACTION];
+    PCLIENT_BUFFER_CONTEXT clientBufferContexts[BUFFERS_PER_MULTIPLE_ACTION];
+    ULONG numberOfBuffers;
+    ULONG bufferIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Fetch new buffers from producer queue. This fails when all the buffers are in use
+    // because the lock-free backend has a fixed number of buffers.
+    //
+    ntStatus = DMF_BufferQueue_FetchMultiple(moduleContext->DmfModuleBufferQueueLockFree,
+                                             TestsUtility_GenerateRandomNumber(1,
+                                                                               BUFFERS_PER_MULTIPLE_ACTION),
+                                             (PVOID*)clientBuffers,
+                                             (PVOID*)clientBufferContexts,
+                                             &numberOfBuffers);
+    if (NT_SUCCESS(ntStatus))
+    {
+        // Populate the buffers with test data.
+        //
+        for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+        {
+            DmfAssert(clientBuffers[bufferIndex] != NULL);
+            DmfAssert(clientBufferContexts[bufferIndex] != NULL);
+            // Buffers are cleared when they are reused.
+            //
+            DmfAssert(0 == clientBufferContexts[bufferIndex]->Signature);
+
+            TestsUtility_FillWithSequentialData(clientBuffers[bufferIndex],
+                                                BUFFER_SIZE);
+
+            clientBufferContexts[bufferIndex]->Signature = CLIENT_CONTEXT_SIGNATURE;
+            clientBufferContexts[bufferIndex]->CheckSum = TestsUtility_CrcCompute(clientBuffers[bufferIndex],
+                                                                                  BUFFER_SIZE);
+        }
+
+        // Add these buffers to the tail or to the head of the queue.
+        //
+        if (TestsUtility_GenerateRandomNumber(0, 1))
+        {
+            DMF_BufferQueue_EnqueueMultiple(moduleContext->DmfModuleBufferQueueLockFree,
+                                            (PVOID*)clientBuffers,
+                                            numberOfBuffers);
+        }
+        else
+        {
+            for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+            {
+                DMF_BufferQueue_EnqueueAtHead(moduleContext->DmfModuleBufferQueueLockFree,
+                                              clientBuffers[bufferIndex]);
+            }
+        }
+    }
+
+    // Dequeue several buffers.
+    //
+    ntStatus = DMF_BufferQueue_DequeueMultiple(moduleContext->DmfModuleBufferQueueLockFree,
+                                               TestsUtility_GenerateRandomNumber(1,
+                                                                                 BUFFERS_PER_MULTIPLE_ACTION),
+                                               (PVOID*)clientBuffers,
+                                               (PVOID*)clientBufferContexts,
+                                               &numberOfBuffers);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(0 == numberOfBuffers);
+        goto Exit;
+    }
+
+    // Validate these buffers.
+    //
+    for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+    {
+        Tests_BufferQueue_Validate(moduleContext->DmfModuleBufferQueueLockFree,
+                                   clientBuffers[bufferIndex],
+                                   clientBufferContexts[bufferIndex]);
+    }
+
+    // Return them to the queue's producer queue for reuse.
+    //
+    DMF_BufferQueue_ReuseMultiple(moduleContext->DmfModuleBufferQueueLockFree,
+                                  (PVOID*)clientBuffers,
+                                  numberOfBuffers);
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+void
+Tests_BufferQueue_ThreadAction_Priority(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_BufferQueue* moduleContext;
+    PUINT8 clientBuffers[BUFFERS_PER_MULTIPLE_ACTION];
+    PCLIENT_BUFFER_CONTEXT clientBufferContexts[BUFFERS_PER_MULTIPLE_ACTION];
+    ULONG numberOfBuffers;
+    ULONG bufferIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (DMF_BufferQueue_Count(moduleContext->DmfModuleBufferQueuePriority) < BUFFER_COUNT_MAX)
+    {
+        // Fetch new buffers from producer queue.
+        //
+        ntStatus = DMF_BufferQueue_FetchMultiple(moduleContext->DmfModuleBufferQueuePriority,
+                                                 TestsUtility_GenerateRandomNumber(1,
+                                                                                   BUFFERS_PER_MULTIPLE_ACTION),
+                                                 (PVOID*)clientBuffers,
+                                                 (PVOID*)clientBufferContexts,
+                                                 &numberOfBuffers);
+        if (NT_SUCCESS(ntStatus))
+        {
+            // Populate the buffers with test data and add each of them to a random priority level.
+            //
+            for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+            {
+                DmfAssert(clientBuffers[bufferIndex] != NULL);
+                DmfAssert(clientBufferContexts[bufferIndex] != NULL);
+
+                TestsUtility_FillWithSequentialData(clientBuffers[bufferIndex],
+                                                    BUFFER_SIZE);
+
+                clientBufferContexts[bufferIndex]->Signature = CLIENT_CONTEXT_SIGNATURE;
+                clientBufferContexts[bufferIndex]->CheckSum = TestsUtility_CrcCompute(clientBuffers[bufferIndex],
+                                                                                      BUFFER_SIZE);
+
+                DMF_BufferQueue_EnqueueWithPriority(moduleContext->DmfModuleBufferQueuePriority,
+                                                    clientBuffers[bufferIndex],
+                                                    TestsUtility_GenerateRandomNumber(0,
+                                                                                      PRIORITY_LEVELS - 1));
+            }
+        }
+    }
+
+    // Dequeue several buffers. They come from the highest priority level that is not empty
+    // or, every PRIORITY_AGING_INTERVAL dequeues, from a lower priority level.
+    //
+    ntStatus = DMF_BufferQueue_DequeueMultiple(moduleContext->DmfModuleBufferQueuePriority,
+                                               TestsUtility_GenerateRandomNumber(1,
+                                                                                 BUFFERS_PER_MULTIPLE_ACTION),
+                                               (PVOID*)clientBuffers,
+                                               (PVOID*)clientBufferContexts,
+                                               &numberOfBuffers);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(0 == numberOfBuffers);
+        goto Exit;
+    }
+
+    // Validate these buffers.
+    //
+    for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+    {
+        Tests_BufferQueue_Validate(moduleContext->DmfModuleBufferQueuePriority,
+                                   clientBuffers[bufferIndex],
+                                   clientBufferContexts[bufferIndex]);
+    }
+
+    // Return them to the queue's producer queue for reuse.
+    //
+    DMF_BufferQueue_ReuseMultiple(moduleContext->DmfModuleBufferQueuePriority,
+                                  (PVOID*)clientBuffers,
+                                  numberOfBuffers);
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 static
 void
@@ -519,7 +850,11 @@ TestActionArray[] =
 #if !defined(DMF_USER_MODE)
     Tests_BufferQueue_ThreadAction_EnqueueWithTimer,
 #endif
+    Tests_BufferQueue_ThreadAction_EnqueueMultiple,
     Tests_BufferQueue_ThreadAction_Dequeue,
+    Tests_BufferQueue_ThreadAction_DequeueMultiple,
+    Tests_BufferQueue_ThreadAction_LockFree,
+    Tests_BufferQueue_ThreadAction_Priority,
     Tests_BufferQueue_ThreadAction_Enumerate,
     Tests_BufferQueue_ThreadAction_Count,
     Tests_BufferQueue_ThreadAction_Flush
@@ -751,6 +1086,39 @@ Return Value:
                      &moduleContext->DmfModuleBufferQueueTimer);
 #endif
 
+    // BufferQueue (lock-free)
+    // -----------------------
+    //
+    DMF_CONFIG_BufferQueue_AND_ATTRIBUTES_INIT(&moduleConfigBufferQueue,
+                                               &moduleAttributes);
+    moduleConfigBufferQueue.SourceSettings.BufferContextSize = sizeof(CLIENT_BUFFER_CONTEXT);
+    moduleConfigBufferQueue.SourceSettings.BufferSize = BUFFER_SIZE;
+    moduleConfigBufferQueue.SourceSettings.BufferCount = BUFFER_COUNT_MAX;
+    moduleConfigBufferQueue.SourceSettings.EnableLookAside = FALSE;
+    moduleConfigBufferQueue.SourceSettings.PoolType = NonPagedPoolNx;
+    moduleConfigBufferQueue.Backend = BufferQueue_Backend_LockFree;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferQueueLockFree);
+
+    // BufferQueue (priority)
+    // ----------------------
+    //
+    DMF_CONFIG_BufferQueue_AND_ATTRIBUTES_INIT(&moduleConfigBufferQueue,
+                                               &moduleAttributes);
+    moduleConfigBufferQueue.SourceSettings.BufferContextSize = sizeof(CLIENT_BUFFER_CONTEXT);
+    moduleConfigBufferQueue.SourceSettings.BufferSize = BUFFER_SIZE;
+    moduleConfigBufferQueue.SourceSettings.BufferCount = BUFFER_COUNT_PREALLOCATED;
+    moduleConfigBufferQueue.SourceSettings.EnableLookAside = TRUE;
+    moduleConfigBufferQueue.SourceSettings.PoolType = NonPagedPoolNx;
+    moduleConfigBufferQueue.NumberOfPriorityLevels = PRIORITY_LEVELS;
+    moduleConfigBufferQueue.PriorityAgingInterval = PRIORITY_AGING_INTERVAL;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferQueuePriority);
+
     // Thread
     // ------
     //
@@ -44,6 +44,30 @@ Environment:
 // Number of threads that access the table.
 //
 #define THREAD_COUNT                (2)
+// Number of operations timed by each benchmark pass.
+//
+#define BENCHMARK_ITERATION_COUNT   (BUFFER_COUNT_MAXIMUM * 16)
+// Number of keys in each set of keys used to compare hashing algorithms.
+//
+#define HASH_KEY_COUNT              (256)
+// Maximum size of keys used to compare hashing algorithms.
+//
+#define HASH_KEY_SIZE_MAXIMUM       (128)
+// Number of buckets used to count collisions. (Same ratio as a chained hash table.)
+//
+#define HASH_BUCKET_COUNT           (HASH_KEY_COUNT * 2)
+// Number of times each set of keys is hashed to measure throughput.
+//
+#define HASH_BENCHMARK_PASS_COUNT   (64)
+// Number of lock stripes used by the striped tables.
+//
+#define LOCK_STRIPE_COUNT           (8)
+// Size of the inline area of the compact table. Most test entries do not fit and are spilled.
+//
+#define COMPACT_INLINE_DATA_LENGTH  (16)
+// Number of keys passed to each batch Method call.
+//
+#define BATCH_ITEM_COUNT            (24)
 
 // It is a table of data that is automatically generated. This data is
 // then written to the hash table. Then, this table is used to find 
@@ -57,14 +81,44 @@ typedef struct
     ULONG BufferSize;
 } HashTable_DataRecord;
 
+// Keys that resemble the keys Clients store in hash tables.
+//
+typedef struct
+{
+    UCHAR Key[HASH_KEY_SIZE_MAXIMUM];
+    ULONG KeySize;
+} HashTable_HashKey;
+
+typedef enum _HASH_KEY_SET
+{
+    // Device interface paths.
+    //
+    HASH_KEY_SET_INTERFACE_PATH,
+    // BranchTrack style file and branch names.
+    //
+    HASH_KEY_SET_BRANCH_NAME,
+    HASH_KEY_SET_COUNT
+} HASH_KEY_SET;
+
+// Each '*' is replaced by a hexadecimal digit of the key index.
+//
+static CONST CHAR* HashKeyTemplates[HASH_KEY_SET_COUNT] =
+{
+    "\\\\?\\HID#VID_045E&PID_0B**#7&1F3A2C**&0&0000#{4d1e55b2-f16f-11cf-88cb-001111000030}",
+    "Dmf_ThreadedBufferQueue.c:ThreadedBufferQueue_WorkCallback:Branch_****"
+};
+
 typedef enum _TEST_ACTION
 {
     TEST_ACTION_READSUCCESS,
     TEST_ACTION_READFAIL,
     TEST_ACTION_ENUMERATE,
+    TEST_ACTION_BENCHMARK,
+    TEST_ACTION_REMOVE,
+    TEST_ACTION_BATCH,
     TEST_ACTION_COUNT,
     TEST_ACTION_MINIMUM     = TEST_ACTION_READSUCCESS,
-    TEST_ACTION_MAXIMUM     = TEST_ACTION_ENUMERATE
+    TEST_ACTION_MAXIMUM     = TEST_ACTION_BATCH
 } TEST_ACTION;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -83,9 +137,31 @@ typedef struct _DMF_CONTEXT_Tests_HashTable
     // HashTable Module to test using custom hash function.
     //
     DMFMODULE DmfModuleHashTableCustom; 
+    // HashTable Module to test using open addressing.
+    //
+    DMFMODULE DmfModuleHashTableOpenAddressing;
+    // HashTable Module to test using the word-at-a-time hash function.
+    //
+    DMFMODULE DmfModuleHashTableWordAtATime;
+    // HashTable Modules to test using lock stripes (enumerated one stripe at a time and as a snapshot).
+    //
+    DMFMODULE DmfModuleHashTableStriped;
+    DMFMODULE DmfModuleHashTableStripedSnapshot;
+    // HashTable Module to test using compact storage.
+    //
+    DMFMODULE DmfModuleHashTableCompact;
+    // Keys used to compare hashing algorithms.
+    //
+    HashTable_HashKey HashKeys[HASH_KEY_SET_COUNT][HASH_KEY_COUNT];
+    // Used to generate keys that are written and then removed.
+    //
+    LONG TransientKeyCount;
     // Work threads that perform actions on the HashTable Module.
     //
     DMFMODULE DmfModuleThread[THREAD_COUNT];
+    // Used to time benchmark passes.
+    //
+    DMFMODULE DmfModuleTime;
 } DMF_CONTEXT_Tests_HashTable;
 
 // This macro declares the following function:
@@ -172,6 +248,47 @@ Tests_HashTable_DataGenerate(
     }
 }
 
+static
+VOID
+Tests_HashTable_HashKeysGenerate(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_HashTable* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    for (ULONG keySetIndex = 0; keySetIndex < HASH_KEY_SET_COUNT; keySetIndex++)
+    {
+        CONST CHAR* keyTemplate = HashKeyTemplates[keySetIndex];
+        ULONG keySize = (ULONG)strlen(keyTemplate);
+
+        DmfAssert(keySize <= HASH_KEY_SIZE_MAXIMUM);
+
+        for (ULONG keyIndex = 0; keyIndex < HASH_KEY_COUNT; keyIndex++)
+        {
+            HashTable_HashKey* hashKey = &moduleContext->HashKeys[keySetIndex][keyIndex];
+            ULONG digits = keyIndex;
+
+            RtlCopyMemory(hashKey->Key,
+                          keyTemplate,
+                          keySize);
+            hashKey->KeySize = keySize;
+
+            // Fill the placeholders from the end so that the last one holds the lowest digit.
+            //
+            for (ULONG characterIndex = keySize; characterIndex > 0; characterIndex--)
+            {
+                if (hashKey->Key[characterIndex - 1] == '*')
+                {
+                    hashKey->Key[characterIndex - 1] = "0123456789ABCDEF"[digits & 0xF];
+                    digits >>= 4;
+                }
+            }
+        }
+    }
+}
+
 static
 VOID
 Tests_HashTable_Populate(
@@ -198,6 +315,31 @@ Tests_HashTable_Populate(
     }
 }
 
+static
+VOID
+Tests_HashTable_StatisticsVerify(
+    _In_ DMFMODULE DmfModuleHashTable
+    )
+{
+    HashTable_Statistics statistics;
+
+    // Every record has been written once and the table has not been read yet.
+    //
+    DMF_HashTable_StatisticsGet(DmfModuleHashTable,
+                                &statistics);
+    DmfAssert(statistics.EntryCount == BUFFER_COUNT_MAXIMUM);
+    DmfAssert(statistics.EntryCapacity >= statistics.EntryCount);
+    DmfAssert(statistics.BucketsUsed > 0);
+    DmfAssert(statistics.BucketsUsed <= statistics.EntryCount);
+    DmfAssert(statistics.LoadFactorPercent == (ULONG)(((ULONGLONG)statistics.EntryCount * 100) / statistics.BucketCount));
+    DmfAssert(statistics.MaximumChainLength >= 1);
+    DmfAssert(statistics.AverageChainLengthHundredths >= 100);
+    DmfAssert(statistics.AverageChainLengthHundredths <= statistics.MaximumChainLength * 100);
+    DmfAssert(statistics.LookupHitCount == 0);
+    DmfAssert(statistics.LookupMissCount == BUFFER_COUNT_MAXIMUM);
+    DmfAssert(statistics.TableFullCount == 0);
+}
+
 INT
 Tests_HashTable_DataRecordsSearch(
     _In_ HashTable_DataRecord* DataRecords,
@@ -319,6 +461,57 @@ Tests_HashTable_ThreadAction_ReadSuccess(
                                dataRecord->Buffer,
                                valueSize) == valueSize);
 
+    valueSize = sizeof(valueBuffer);
+    ntStatus = DMF_HashTable_Read(moduleContext->DmfModuleHashTableOpenAddressing,
+                                  dataRecord->Key,
+                                  dataRecord->KeySize,
+                                  valueBuffer,
+                                  valueSize,
+                                  &valueSize);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(valueSize == dataRecord->BufferSize);
+    DmfAssert(RtlCompareMemory(valueBuffer,
+                               dataRecord->Buffer,
+                               valueSize) == valueSize);
+
+    valueSize = sizeof(valueBuffer);
+    ntStatus = DMF_HashTable_Read(moduleContext->DmfModuleHashTableWordAtATime,
+                                  dataRecord->Key,
+                                  dataRecord->KeySize,
+                                  valueBuffer,
+                                  valueSize,
+                                  &valueSize);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(valueSize == dataRecord->BufferSize);
+    DmfAssert(RtlCompareMemory(valueBuffer,
+                               dataRecord->Buffer,
+                               valueSize) == valueSize);
+
+    valueSize = sizeof(valueBuffer);
+    ntStatus = DMF_HashTable_Read(moduleContext->DmfModuleHashTableStriped,
+                                  dataRecord->Key,
+                                  dataRecord->KeySize,
+                                  valueBuffer,
+                                  valueSize,
+                                  &valueSize);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(valueSize == dataRecord->BufferSize);
+    DmfAssert(RtlCompareMemory(valueBuffer,
+                               dataRecord->Buffer,
+                               valueSize) == valueSize);
+    valueSize = sizeof(valueBuffer);
+    ntStatus = DMF_HashTable_Read(moduleContext->DmfModuleHashTableCompact,
+                                  dataRecord->Key,
+                                  dataRecord->KeySize,
+                                  valueBuffer,
+                                  valueSize,
+                                  &valueSize);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(valueSize == dataRecord->BufferSize);
+    DmfAssert(RtlCompareMemory(valueBuffer,
+                               dataRecord->Buffer,
+                               valueSize) == valueSize);
+
     ntStatus = DMF_HashTable_Find(moduleContext->DmfModuleHashTableDefault,
                                   dataRecord->Key,
                                   dataRecord->KeySize,
@@ -338,6 +531,24 @@ Tests_HashTable_ThreadAction_ReadSuccess(
     DmfAssert(RtlCompareMemory(valueBuffer,
                                dataRecord->Buffer,
                                valueSize) == valueSize);
+
+    ntStatus = DMF_HashTable_Find(moduleContext->DmfModuleHashTableOpenAddressing,
+                                  dataRecord->Key,
+                                  dataRecord->KeySize,
+                                  HashTable_Find);
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    ntStatus = DMF_HashTable_Find(moduleContext->DmfModuleHashTableStripedSnapshot,
+                                  dataRecord->Key,
+                                  dataRecord->KeySize,
+                                  HashTable_Find);
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    ntStatus = DMF_HashTable_Find(moduleContext->DmfModuleHashTableCompact,
+                                  dataRecord->Key,
+                                  dataRecord->KeySize,
+                                  HashTable_Find);
+    DmfAssert(NT_SUCCESS(ntStatus));
 }
 #pragma code_seg()
 
@@ -396,6 +607,42 @@ TryAgain:
                                   valueSize,
                                   &valueSize);
     DmfAssert(! NT_SUCCESS(ntStatus));
+
+    valueSize = sizeof(valueBuffer);
+    ntStatus = DMF_HashTable_Read(moduleContext->DmfModuleHashTableWordAtATime,
+                                  keyNotFound,
+                                  keyNotFoundSize,
+                                  valueBuffer,
+                                  valueSize,
+                                  &valueSize);
+    DmfAssert(! NT_SUCCESS(ntStatus));
+
+    valueSize = sizeof(valueBuffer);
+    ntStatus = DMF_HashTable_Read(moduleContext->DmfModuleHashTableStriped,
+                                  keyNotFound,
+                                  keyNotFoundSize,
+                                  valueBuffer,
+                                  valueSize,
+                                  &valueSize);
+    DmfAssert(! NT_SUCCESS(ntStatus));
+
+    valueSize = sizeof(valueBuffer);
+    ntStatus = DMF_HashTable_Read(moduleContext->DmfModuleHashTableCompact,
+                                  keyNotFound,
+                                  keyNotFoundSize,
+                                  valueBuffer,
+                                  valueSize,
+                                  &valueSize);
+    DmfAssert(! NT_SUCCESS(ntStatus));
+
+    valueSize = sizeof(valueBuffer);
+    ntStatus = DMF_HashTable_Read(moduleContext->DmfModuleHashTableOpenAddressing,
+                                  keyNotFound,
+                                  keyNotFoundSize,
+                                  valueBuffer,
+                                  valueSize,
+                                  &valueSize);
+    DmfAssert(! NT_SUCCESS(ntStatus));
 }
 #pragma code_seg()
 
@@ -423,6 +670,21 @@ HashTable_Enumerate(
 
     moduleContext = DMF_CONTEXT_GET(DmfModuleParent);
 
+    if (KeyLength >= sizeof(UINT))
+    {
+        UINT keyIndex;
+
+        RtlCopyMemory(&keyIndex,
+                      Key,
+                      sizeof(UINT));
+        if (keyIndex >= BUFFER_COUNT_MAXIMUM)
+        {
+            // This is a transient key written by the remove test. It is not in the table of records.
+            //
+            return TRUE;
+        }
+    }
+
     INT foundRecordIndex = Tests_HashTable_DataRecordsSearch(moduleContext->DataRecords,
                                                              Key,
                                                              KeyLength);
@@ -475,6 +737,443 @@ Tests_HashTable_ThreadAction_Enumerate(
     DMF_HashTable_Enumerate(moduleContext->DmfModuleHashTableCustom,
                             HashTable_Enumerate,
                             DmfModule);
+
+    DMF_HashTable_Enumerate(moduleContext->DmfModuleHashTableOpenAddressing,
+                            HashTable_Enumerate,
+                            DmfModule);
+
+    DMF_HashTable_Enumerate(moduleContext->DmfModuleHashTableWordAtATime,
+                            HashTable_Enumerate,
+                            DmfModule);
+
+    DMF_HashTable_Enumerate(moduleContext->DmfModuleHashTableStriped,
+                            HashTable_Enumerate,
+                            DmfModule);
+
+    DMF_HashTable_Enumerate(moduleContext->DmfModuleHashTableStripedSnapshot,
+                            HashTable_Enumerate,
+                            DmfModule);
+
+    DMF_HashTable_Enumerate(moduleContext->DmfModuleHashTableCompact,
+                            HashTable_Enumerate,
+                            DmfModule);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+void
+Tests_HashTable_ThreadAction_Remove(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_HashTable* moduleContext;
+    NTSTATUS ntStatus;
+    UCHAR key[KEY_SIZE];
+    ULONG keySize;
+    UINT keyIndex;
+    UCHAR valueBuffer[BUFFER_SIZE];
+    ULONG valueSize;
+    HashTable_DataRecord* dataRecord;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Create a key that is not in the table of records. Its first part is always
+    // greater than the index of any record.
+    //
+    keyIndex = BUFFER_COUNT_MAXIMUM + (UINT)InterlockedIncrement(&moduleContext->TransientKeyCount);
+    keySize = TestsUtility_GenerateRandomNumber(sizeof(UINT),
+                                                KEY_SIZE);
+    TestsUtility_FillWithSequentialData(key,
+                                        keySize);
+    RtlCopyMemory(key,
+                  &keyIndex,
+                  sizeof(UINT));
+
+    // Use the value of a random record.
+    //
+    dataRecord = &moduleContext->DataRecords[TestsUtility_GenerateRandomNumber(0,
+                                                                               BUFFER_COUNT_MAXIMUM - 1)];
+
+    ntStatus = DMF_HashTable_Write(moduleContext->DmfModuleHashTableOpenAddressing,
+                                   key,
+                                   keySize,
+                                   dataRecord->Buffer,
+                                   dataRecord->BufferSize);
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    valueSize = sizeof(valueBuffer);
+    ntStatus = DMF_HashTable_Read(moduleContext->DmfModuleHashTableOpenAddressing,
+                                  key,
+                                  keySize,
+                                  valueBuffer,
+                                  valueSize,
+                                  &valueSize);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(valueSize == dataRecord->BufferSize);
+
+    ntStatus = DMF_HashTable_Remove(moduleContext->DmfModuleHashTableOpenAddressing,
+                                    key,
+                                    keySize);
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    // The key is no longer in the table.
+    //
+    valueSize = sizeof(valueBuffer);
+    ntStatus = DMF_HashTable_Read(moduleContext->DmfModuleHashTableOpenAddressing,
+                                  key,
+                                  keySize,
+                                  valueBuffer,
+                                  valueSize,
+                                  &valueSize);
+    DmfAssert(! NT_SUCCESS(ntStatus));
+
+    ntStatus = DMF_HashTable_Remove(moduleContext->DmfModuleHashTableOpenAddressing,
+                                    key,
+                                    keySize);
+    DmfAssert(ntStatus == STATUS_NOT_FOUND);
+
+    // Chained tables do not support removal.
+    //
+    ntStatus = DMF_HashTable_Remove(moduleContext->DmfModuleHashTableDefault,
+                                    key,
+                                    keySize);
+    DmfAssert(ntStatus == STATUS_NOT_SUPPORTED);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+void
+Tests_HashTable_BatchFindVerify(
+    _In_ DMFMODULE DmfModuleHashTable,
+    _In_reads_(BATCH_ITEM_COUNT) HashTable_DataRecord** DataRecords
+    )
+{
+    NTSTATUS ntStatus;
+    HashTable_BatchItem batchItems[BATCH_ITEM_COUNT];
+    UCHAR valueBuffers[BATCH_ITEM_COUNT][BUFFER_SIZE];
+    ULONG itemIndex;
+
+    PAGED_CODE();
+
+    for (itemIndex = 0; itemIndex < BATCH_ITEM_COUNT; itemIndex++)
+    {
+        batchItems[itemIndex].Key = DataRecords[itemIndex]->Key;
+        batchItems[itemIndex].KeyLength = DataRecords[itemIndex]->KeySize;
+        batchItems[itemIndex].Value = valueBuffers[itemIndex];
+        batchItems[itemIndex].ValueBufferLength = BUFFER_SIZE;
+        batchItems[itemIndex].ValueLength = 0;
+        batchItems[itemIndex].NtStatus = STATUS_UNSUCCESSFUL;
+    }
+
+    // The last buffer is too small for any value.
+    //
+    batchItems[BATCH_ITEM_COUNT - 1].ValueBufferLength = 0;
+
+    ntStatus = DMF_HashTable_FindBatch(DmfModuleHashTable,
+                                       batchItems,
+                                       BATCH_ITEM_COUNT);
+    for (itemIndex = 0; itemIndex < BATCH_ITEM_COUNT - 1; itemIndex++)
+    {
+        DmfAssert(NT_SUCCESS(batchItems[itemIndex].NtStatus));
+        DmfAssert(batchItems[itemIndex].ValueLength == DataRecords[itemIndex]->BufferSize);
+        DmfAssert(RtlCompareMemory(valueBuffers[itemIndex],
+                                   DataRecords[itemIndex]->Buffer,
+                                   batchItems[itemIndex].ValueLength) == batchItems[itemIndex].ValueLength);
+    }
+
+    // Required length is returned for the item whose buffer is too small.
+    //
+    itemIndex = BATCH_ITEM_COUNT - 1;
+    DmfAssert(batchItems[itemIndex].ValueLength == DataRecords[itemIndex]->BufferSize);
+    if (DataRecords[itemIndex]->BufferSize > 0)
+    {
+        DmfAssert(batchItems[itemIndex].NtStatus == STATUS_BUFFER_TOO_SMALL);
+        DmfAssert(ntStatus == STATUS_BUFFER_TOO_SMALL);
+    }
+    else
+    {
+        DmfAssert(NT_SUCCESS(batchItems[itemIndex].NtStatus));
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+void
+Tests_HashTable_ThreadAction_Batch(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_HashTable* moduleContext;
+    NTSTATUS ntStatus;
+    HashTable_DataRecord* dataRecords[BATCH_ITEM_COUNT];
+    HashTable_BatchItem batchItems[BATCH_ITEM_COUNT];
+    ULONG itemIndex;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    for (itemIndex = 0; itemIndex < BATCH_ITEM_COUNT; itemIndex++)
+    {
+        dataRecords[itemIndex] = &moduleContext->DataRecords[TestsUtility_GenerateRandomNumber(0,
+                                                                                               BUFFER_COUNT_MAXIMUM - 1)];
+    }
+
+    // Write the records again. Values do not change so other threads still read the same data.
+    //
+    for (itemIndex = 0; itemIndex < BATCH_ITEM_COUNT; itemIndex++)
+    {
+        batchItems[itemIndex].Key = dataRecords[itemIndex]->Key;
+        batchItems[itemIndex].KeyLength = dataRecords[itemIndex]->KeySize;
+        batchItems[itemIndex].Value = dataRecords[itemIndex]->Buffer;
+        batchItems[itemIndex].ValueBufferLength = 0;
+        batchItems[itemIndex].ValueLength = dataRecords[itemIndex]->BufferSize;
+        batchItems[itemIndex].NtStatus = STATUS_UNSUCCESSFUL;
+    }
+
+    ntStatus = DMF_HashTable_WriteBatch(moduleContext->DmfModuleHashTableStriped,
+                                        batchItems,
+                                        BATCH_ITEM_COUNT);
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    ntStatus = DMF_HashTable_WriteBatch(moduleContext->DmfModuleHashTableCompact,
+                                        batchItems,
+                                        BATCH_ITEM_COUNT);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    for (itemIndex = 0; itemIndex < BATCH_ITEM_COUNT; itemIndex++)
+    {
+        DmfAssert(NT_SUCCESS(batchItems[itemIndex].NtStatus));
+    }
+
+    Tests_HashTable_BatchFindVerify(moduleContext->DmfModuleHashTableDefault,
+                                    dataRecords);
+    Tests_HashTable_BatchFindVerify(moduleContext->DmfModuleHashTableOpenAddressing,
+                                    dataRecords);
+    Tests_HashTable_BatchFindVerify(moduleContext->DmfModuleHashTableStriped,
+                                    dataRecords);
+    Tests_HashTable_BatchFindVerify(moduleContext->DmfModuleHashTableCompact,
+                                    dataRecords);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+void
+Tests_HashTable_BenchmarkRun(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMFMODULE DmfModuleHashTable,
+    _In_z_ CONST CHAR* HashTableName
+    )
+{
+    DMF_CONTEXT_Tests_HashTable* moduleContext;
+    NTSTATUS ntStatus;
+    HashTable_DataRecord* dataRecord;
+    UCHAR valueBuffer[BUFFER_SIZE];
+    ULONG valueSize;
+    LONGLONG startTick;
+    LONGLONG writeNanoseconds;
+    LONGLONG readNanoseconds;
+    ULONG iterationIndex;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Time updates of existing keys. (The table is already fully populated.)
+    //
+    startTick = DMF_Time_TickCountGet(moduleContext->DmfModuleTime);
+    for (iterationIndex = 0; iterationIndex < BENCHMARK_ITERATION_COUNT; iterationIndex++)
+    {
+        dataRecord = &moduleContext->DataRecords[iterationIndex % BUFFER_COUNT_MAXIMUM];
+        ntStatus = DMF_HashTable_Write(DmfModuleHashTable,
+                                       dataRecord->Key,
+                                       dataRecord->KeySize,
+                                       dataRecord->Buffer,
+                                       dataRecord->BufferSize);
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+    ntStatus = DMF_Time_ElapsedTimeNanosecondsGet(moduleContext->DmfModuleTime,
+                                                  startTick,
+                                                  &writeNanoseconds);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    // Time lookups of existing keys.
+    //
+    startTick = DMF_Time_TickCountGet(moduleContext->DmfModuleTime);
+    for (iterationIndex = 0; iterationIndex < BENCHMARK_ITERATION_COUNT; iterationIndex++)
+    {
+        dataRecord = &moduleContext->DataRecords[iterationIndex % BUFFER_COUNT_MAXIMUM];
+        valueSize = sizeof(valueBuffer);
+        ntStatus = DMF_HashTable_Read(DmfModuleHashTable,
+                                      dataRecord->Key,
+                                      dataRecord->KeySize,
+                                      valueBuffer,
+                                      valueSize,
+                                      &valueSize);
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+    ntStatus = DMF_Time_ElapsedTimeNanosecondsGet(moduleContext->DmfModuleTime,
+                                                  startTick,
+                                                  &readNanoseconds);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                "Benchmark %s: operations=%u writeNs=%lld (%lld ns/op) readNs=%lld (%lld ns/op)",
+                HashTableName,
+                BENCHMARK_ITERATION_COUNT,
+                writeNanoseconds,
+                writeNanoseconds / BENCHMARK_ITERATION_COUNT,
+                readNanoseconds,
+                readNanoseconds / BENCHMARK_ITERATION_COUNT);
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+void
+Tests_HashTable_HashBenchmarkRun(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMFMODULE DmfModuleHashTable,
+    _In_z_ CONST CHAR* HashAlgorithmName,
+    _In_ ULONG KeySetIndex
+    )
+{
+    DMF_CONTEXT_Tests_HashTable* moduleContext;
+    NTSTATUS ntStatus;
+    HashTable_HashKey* hashKey;
+    UCHAR bucketUsed[HASH_BUCKET_COUNT / 8];
+    ULONG collisionCount;
+    ULONG bucketIndex;
+    ULONG_PTR hashSum;
+    LONGLONG startTick;
+    LONGLONG hashNanoseconds;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Count keys that land in a bucket that is already used by another key.
+    //
+    RtlZeroMemory(bucketUsed,
+                  sizeof(bucketUsed));
+    collisionCount = 0;
+    for (ULONG keyIndex = 0; keyIndex < HASH_KEY_COUNT; keyIndex++)
+    {
+        hashKey = &moduleContext->HashKeys[KeySetIndex][keyIndex];
+        bucketIndex = (ULONG)(DMF_HashTable_HashCalculate(DmfModuleHashTable,
+                                                          hashKey->Key,
+                                                          hashKey->KeySize) % HASH_BUCKET_COUNT);
+        if (bucketUsed[bucketIndex / 8] & (1 << (bucketIndex % 8)))
+        {
+            collisionCount++;
+        }
+        bucketUsed[bucketIndex / 8] |= (UCHAR)(1 << (bucketIndex % 8));
+    }
+
+    // Time hashing of the whole set of keys. The sum keeps the calls from being optimized away.
+    //
+    hashSum = 0;
+    startTick = DMF_Time_TickCountGet(moduleContext->DmfModuleTime);
+    for (ULONG passIndex = 0; passIndex < HASH_BENCHMARK_PASS_COUNT; passIndex++)
+    {
+        for (ULONG keyIndex = 0; keyIndex < HASH_KEY_COUNT; keyIndex++)
+        {
+            hashKey = &moduleContext->HashKeys[KeySetIndex][keyIndex];
+            hashSum += DMF_HashTable_HashCalculate(DmfModuleHashTable,
+                                                   hashKey->Key,
+                                                   hashKey->KeySize);
+        }
+    }
+    ntStatus = DMF_Time_ElapsedTimeNanosecondsGet(moduleContext->DmfModuleTime,
+                                                  startTick,
+                                                  &hashNanoseconds);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                "Hash benchmark %s keySet=%u keySize=%u: collisions=%u/%u buckets=%u hashNs=%lld (%lld ns/key) sum=0x%p",
+                HashAlgorithmName,
+                KeySetIndex,
+                moduleContext->HashKeys[KeySetIndex][0].KeySize,
+                collisionCount,
+                HASH_KEY_COUNT,
+                HASH_BUCKET_COUNT,
+                hashNanoseconds,
+                hashNanoseconds / (HASH_BENCHMARK_PASS_COUNT * HASH_KEY_COUNT),
+                (VOID*)hashSum);
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+void
+Tests_HashTable_ThreadAction_Benchmark(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_HashTable* moduleContext;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    Tests_HashTable_BenchmarkRun(DmfModule,
+                                 moduleContext->DmfModuleHashTableDefault,
+                                 "Default");
+
+    Tests_HashTable_BenchmarkRun(DmfModule,
+                                 moduleContext->DmfModuleHashTableCustom,
+                                 "Custom");
+
+    Tests_HashTable_BenchmarkRun(DmfModule,
+                                 moduleContext->DmfModuleHashTableOpenAddressing,
+                                 "OpenAddressing");
+
+    Tests_HashTable_BenchmarkRun(DmfModule,
+                                 moduleContext->DmfModuleHashTableWordAtATime,
+                                 "WordAtATime");
+
+    Tests_HashTable_BenchmarkRun(DmfModule,
+                                 moduleContext->DmfModuleHashTableStriped,
+                                 "Striped");
+
+    Tests_HashTable_BenchmarkRun(DmfModule,
+                                 moduleContext->DmfModuleHashTableCompact,
+                                 "Compact");
+
+    for (ULONG keySetIndex = 0; keySetIndex < HASH_KEY_SET_COUNT; keySetIndex++)
+    {
+        Tests_HashTable_HashBenchmarkRun(DmfModule,
+                                         moduleContext->DmfModuleHashTableDefault,
+                                         "Fnv1a",
+                                         keySetIndex);
+        Tests_HashTable_HashBenchmarkRun(DmfModule,
+                                         moduleContext->DmfModuleHashTableWordAtATime,
+                                         "WordAtATime",
+                                         keySetIndex);
+    }
 }
 #pragma code_seg()
 
@@ -513,6 +1212,15 @@ Tests_HashTable_WorkThread(
         case TEST_ACTION_ENUMERATE:
             Tests_HashTable_ThreadAction_Enumerate(dmfModule);
             break;
+        case TEST_ACTION_BENCHMARK:
+            Tests_HashTable_ThreadAction_Benchmark(dmfModule);
+            break;
+        case TEST_ACTION_REMOVE:
+            Tests_HashTable_ThreadAction_Remove(dmfModule);
+            break;
+        case TEST_ACTION_BATCH:
+            Tests_HashTable_ThreadAction_Batch(dmfModule);
+            break;
         default:
             DmfAssert(FALSE);
             break;
@@ -581,6 +1289,7 @@ Return Value:
     // Generate random data used for the test.
     //
     Tests_HashTable_DataGenerate(DmfModule);
+    Tests_HashTable_HashKeysGenerate(DmfModule);
 
     // Write known entries into the hash table. These will be read and enumerated.
     // This tests the Write API.
@@ -589,6 +1298,21 @@ Return Value:
                              moduleContext->DmfModuleHashTableDefault);
     Tests_HashTable_Populate(DmfModule,
                              moduleContext->DmfModuleHashTableCustom);
+    Tests_HashTable_Populate(DmfModule,
+                             moduleContext->DmfModuleHashTableOpenAddressing);
+    Tests_HashTable_Populate(DmfModule,
+                             moduleContext->DmfModuleHashTableWordAtATime);
+    Tests_HashTable_Populate(DmfModule,
+                             moduleContext->DmfModuleHashTableStriped);
+    Tests_HashTable_Populate(DmfModule,
+                             moduleContext->DmfModuleHashTableStripedSnapshot);
+    Tests_HashTable_Populate(DmfModule,
+                             moduleContext->DmfModuleHashTableCompact);
+
+    Tests_HashTable_StatisticsVerify(moduleContext->DmfModuleHashTableDefault);
+    Tests_HashTable_StatisticsVerify(moduleContext->DmfModuleHashTableOpenAddressing);
+    Tests_HashTable_StatisticsVerify(moduleContext->DmfModuleHashTableStriped);
+    Tests_HashTable_StatisticsVerify(moduleContext->DmfModuleHashTableCompact);
 
     // Create threads that read with expected success, read with expected failure
     // and enumerate.
@@ -728,6 +1452,87 @@ Return Value:
                      WDF_NO_OBJECT_ATTRIBUTES,
                      &moduleContext->DmfModuleHashTableCustom);
 
+    // HashTable (Open addressing)
+    // ---------------------------
+    // Start small so that the table grows while it is populated.
+    //
+    DMF_CONFIG_HashTable_AND_ATTRIBUTES_INIT(&moduleConfigHashTable,
+                                             &moduleAttributes);
+    moduleAttributes.ClientModuleInstanceName = "HashTable.OpenAddressing";
+    moduleConfigHashTable.MaximumTableSize = BUFFER_COUNT_MAXIMUM / 8;
+    moduleConfigHashTable.MaximumValueLength = BUFFER_SIZE;
+    moduleConfigHashTable.MaximumKeyLength = KEY_SIZE;
+    moduleConfigHashTable.EvtHashTableHashCalculate = NULL;
+    moduleConfigHashTable.Mode = HashTable_Mode_OpenAddressing;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleHashTableOpenAddressing);
+
+    // HashTable (Word-at-a-time hash function)
+    // ----------------------------------------
+    //
+    DMF_CONFIG_HashTable_AND_ATTRIBUTES_INIT(&moduleConfigHashTable,
+                                             &moduleAttributes);
+    moduleAttributes.ClientModuleInstanceName = "HashTable.WordAtATime";
+    moduleConfigHashTable.MaximumTableSize = BUFFER_COUNT_MAXIMUM;
+    moduleConfigHashTable.MaximumValueLength = BUFFER_SIZE;
+    moduleConfigHashTable.MaximumKeyLength = KEY_SIZE;
+    moduleConfigHashTable.EvtHashTableHashCalculate = NULL;
+    moduleConfigHashTable.HashAlgorithm = HashTable_HashAlgorithm_WordAtATime;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleHashTableWordAtATime);
+
+    // HashTable (Lock stripes, enumerated one stripe at a time)
+    // ---------------------------------------------------------
+    //
+    DMF_CONFIG_HashTable_AND_ATTRIBUTES_INIT(&moduleConfigHashTable,
+                                             &moduleAttributes);
+    moduleAttributes.ClientModuleInstanceName = "HashTable.Striped";
+    moduleConfigHashTable.MaximumTableSize = BUFFER_COUNT_MAXIMUM;
+    moduleConfigHashTable.MaximumValueLength = BUFFER_SIZE;
+    moduleConfigHashTable.MaximumKeyLength = KEY_SIZE;
+    moduleConfigHashTable.LockStripeCount = LOCK_STRIPE_COUNT;
+    moduleConfigHashTable.EnumerateSnapshot = FALSE;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleHashTableStriped);
+
+    // HashTable (Lock stripes, enumerated as a snapshot)
+    // --------------------------------------------------
+    //
+    DMF_CONFIG_HashTable_AND_ATTRIBUTES_INIT(&moduleConfigHashTable,
+                                             &moduleAttributes);
+    moduleAttributes.ClientModuleInstanceName = "HashTable.StripedSnapshot";
+    moduleConfigHashTable.MaximumTableSize = BUFFER_COUNT_MAXIMUM;
+    moduleConfigHashTable.MaximumValueLength = BUFFER_SIZE;
+    moduleConfigHashTable.MaximumKeyLength = KEY_SIZE;
+    moduleConfigHashTable.LockStripeCount = LOCK_STRIPE_COUNT;
+    moduleConfigHashTable.EnumerateSnapshot = TRUE;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleHashTableStripedSnapshot);
+
+    // HashTable (Compact storage)
+    // ---------------------------
+    //
+    DMF_CONFIG_HashTable_AND_ATTRIBUTES_INIT(&moduleConfigHashTable,
+                                             &moduleAttributes);
+    moduleAttributes.ClientModuleInstanceName = "HashTable.Compact";
+    moduleConfigHashTable.MaximumTableSize = BUFFER_COUNT_MAXIMUM;
+    moduleConfigHashTable.MaximumValueLength = BUFFER_SIZE;
+    moduleConfigHashTable.MaximumKeyLength = KEY_SIZE;
+    moduleConfigHashTable.Storage = HashTable_Storage_Compact;
+    moduleConfigHashTable.InlineDataLength = COMPACT_INLINE_DATA_LENGTH;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleHashTableCompact);
+
     // Thread
     // ------
     //
@@ -743,6 +1548,15 @@ Return Value:
                          &moduleContext->DmfModuleThread[threadIndex]);
     }
 
+    // Time
+    // ----
+    //
+    DMF_Time_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleTime);
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
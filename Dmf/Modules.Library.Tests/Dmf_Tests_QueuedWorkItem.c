@@ -0,0 +1,578 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_QueuedWorkItem.c
+
+Abstract:
+
+    Functional tests for Dmf_QueuedWorkItem Module.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+#include "DmfModules.Library.Tests.Trace.h"
+
+#if defined(DMF_INCLUDE_TMH)
+#include "Dmf_Tests_QueuedWorkItem.tmh"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Number of work buffers of the Queued Work Item under test.
+//
+#define BUFFER_COUNT                        (8)
+// Number of calls made before the Queued Work Item is flushed.
+//
+#define WORK_ITERATIONS                     (64)
+// Status of the work of a given item. It is never STATUS_SUCCESS (the default) so that
+// a wait that does not return the status set by the callback is detected.
+//
+#define ITEM_NTSTATUS(Sequence)             ((NTSTATUS)(0x20000000 | ((Sequence) & 0xFFFF)))
+
+typedef struct
+{
+    // The Queued Work Item is created dynamically so it has no Parent Module.
+    // This Module's handle is passed in every work buffer instead.
+    //
+    DMFMODULE DmfModuleTests;
+    // Sequence number of the work.
+    //
+    ULONG Sequence;
+    // Status the work callback sets for the work.
+    //
+    NTSTATUS NtStatus;
+} ITEM_Tests_QueuedWorkItem;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct _DMF_CONTEXT_Tests_QueuedWorkItem
+{
+    // Thread that executes tests.
+    //
+    DMFMODULE DmfModuleThread;
+    // Number of work buffers the work callback has been called for.
+    //
+    volatile LONG WorkDone;
+} DMF_CONTEXT_Tests_QueuedWorkItem;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(Tests_QueuedWorkItem)
+
+// This Module has no Config.
+//
+DMF_MODULE_DECLARE_NO_CONFIG(Tests_QueuedWorkItem)
+
+// Memory Pool Tag.
+//
+#define MemoryTag 'IWQT'
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_QueuedWorkItem_Callback)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_same_
+static
+ScheduledTask_Result_Type
+Tests_QueuedWorkItem_WorkCallback(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ VOID* ClientBufferContext
+    )
+{
+    DMF_CONTEXT_Tests_QueuedWorkItem* moduleContext;
+    ITEM_Tests_QueuedWorkItem* item;
+
+    UNREFERENCED_PARAMETER(ClientBufferContext);
+
+    PAGED_CODE();
+
+    item = (ITEM_Tests_QueuedWorkItem*)ClientBuffer;
+    moduleContext = DMF_CONTEXT_GET(item->DmfModuleTests);
+
+    InterlockedIncrement(&moduleContext->WorkDone);
+
+    DMF_QueuedWorkItem_StatusSet(DmfModule,
+                                 ClientBuffer,
+                                 item->NtStatus);
+
+    return ScheduledTask_WorkResult_Success;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_QueuedWorkItem_WorkDoneWait(
+    _In_ DMFMODULE DmfModule,
+    _In_ LONG WorkDone
+    )
+{
+    DMF_CONTEXT_Tests_QueuedWorkItem* moduleContext;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    while (InterlockedCompareExchange(&moduleContext->WorkDone,
+                                      0,
+                                      0) < WorkDone)
+    {
+        TestsUtility_YieldExecution();
+    }
+    DmfAssert(WorkDone == moduleContext->WorkDone);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_QueuedWorkItem_RunTestsEnqueue(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMFMODULE DmfModuleQueuedWorkItem
+    )
+{
+    DMF_CONTEXT_Tests_QueuedWorkItem* moduleContext;
+    NTSTATUS ntStatus;
+    ITEM_Tests_QueuedWorkItem item;
+    LONG workDone;
+    ULONG sequence;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    workDone = InterlockedCompareExchange(&moduleContext->WorkDone,
+                                          0,
+                                          0);
+
+    // Mix calls that wait with calls that do not so that a waiter's work is queued
+    // behind (and uses the buffers of) fire-and-forget work.
+    //
+    for (sequence = 0; sequence < WORK_ITERATIONS; sequence++)
+    {
+        item.DmfModuleTests = DmfModule;
+        item.Sequence = sequence;
+        item.NtStatus = ITEM_NTSTATUS(sequence);
+
+        if (TestsUtility_GenerateRandomNumber(0,
+                                              1))
+        {
+            ntStatus = DMF_QueuedWorkItem_EnqueueAndWait(DmfModuleQueuedWorkItem,
+                                                         &item,
+                                                         sizeof(item));
+            DmfAssert(ITEM_NTSTATUS(sequence) == ntStatus);
+        }
+        else
+        {
+            // It fails while all the buffers are in use.
+            //
+            for (;;)
+            {
+                ntStatus = DMF_QueuedWorkItem_Enqueue(DmfModuleQueuedWorkItem,
+                                                      &item,
+                                                      sizeof(item));
+                if (NT_SUCCESS(ntStatus))
+                {
+                    break;
+                }
+                TestsUtility_YieldExecution();
+            }
+        }
+    }
+
+    Tests_QueuedWorkItem_WorkDoneWait(DmfModule,
+                                      workDone + WORK_ITERATIONS);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_QueuedWorkItem_RunTestsAfterFlush(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMFMODULE DmfModuleQueuedWorkItem
+    )
+{
+    DMF_CONTEXT_Tests_QueuedWorkItem* moduleContext;
+    NTSTATUS ntStatus;
+    ITEM_Tests_QueuedWorkItem item;
+    LONG workDone;
+    ULONG sequence;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // After the flush, the work can no longer be scheduled.
+    //
+    DMF_QueuedWorkItem_Flush(DmfModuleQueuedWorkItem);
+
+    workDone = InterlockedCompareExchange(&moduleContext->WorkDone,
+                                          0,
+                                          0);
+
+    // Each call must fail instead of waiting forever. The work buffer of a failed call is left
+    // pending (and never reused), so the last call fails because no buffer is left.
+    //
+    for (sequence = 0; sequence <= BUFFER_COUNT; sequence++)
+    {
+        item.DmfModuleTests = DmfModule;
+        item.Sequence = sequence;
+        item.NtStatus = ITEM_NTSTATUS(sequence);
+
+        ntStatus = DMF_QueuedWorkItem_EnqueueAndWait(DmfModuleQueuedWorkItem,
+                                                     &item,
+                                                     sizeof(item));
+        DmfAssert(!NT_SUCCESS(ntStatus));
+    }
+
+    item.DmfModuleTests = DmfModule;
+    item.Sequence = sequence;
+    item.NtStatus = ITEM_NTSTATUS(sequence);
+    ntStatus = DMF_QueuedWorkItem_Enqueue(DmfModuleQueuedWorkItem,
+                                          &item,
+                                          sizeof(item));
+    DmfAssert(!NT_SUCCESS(ntStatus));
+
+    // No callback ran for any of them.
+    //
+    DmfAssert(workDone == InterlockedCompareExchange(&moduleContext->WorkDone,
+                                                     0,
+                                                     0));
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_QueuedWorkItem_RunTests(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    NTSTATUS ntStatus;
+    WDFDEVICE device;
+    DMFMODULE dmfModuleQueuedWorkItem;
+    DMF_CONFIG_QueuedWorkItem moduleConfigQueuedWorkItem;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+
+    PAGED_CODE();
+
+    // A new instance is needed for every pass because the tests flush it.
+    //
+    device = DMF_ParentDeviceGet(DmfModule);
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+
+    DMF_CONFIG_QueuedWorkItem_AND_ATTRIBUTES_INIT(&moduleConfigQueuedWorkItem,
+                                                  &moduleAttributes);
+    moduleConfigQueuedWorkItem.EvtQueuedWorkitemFunction = Tests_QueuedWorkItem_WorkCallback;
+    moduleConfigQueuedWorkItem.BufferQueueConfig.SourceSettings.BufferContextSize = 0;
+    moduleConfigQueuedWorkItem.BufferQueueConfig.SourceSettings.BufferCount = BUFFER_COUNT;
+    moduleConfigQueuedWorkItem.BufferQueueConfig.SourceSettings.BufferSize = sizeof(ITEM_Tests_QueuedWorkItem);
+    moduleConfigQueuedWorkItem.BufferQueueConfig.SourceSettings.EnableLookAside = FALSE;
+    moduleConfigQueuedWorkItem.BufferQueueConfig.SourceSettings.PoolType = NonPagedPoolNx;
+    ntStatus = DMF_QueuedWorkItem_Create(device,
+                                         &moduleAttributes,
+                                         &objectAttributes,
+                                         &dmfModuleQueuedWorkItem);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_QueuedWorkItem_Create fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    Tests_QueuedWorkItem_RunTestsEnqueue(DmfModule,
+                                         dmfModuleQueuedWorkItem);
+    Tests_QueuedWorkItem_RunTestsAfterFlush(DmfModule,
+                                            dmfModuleQueuedWorkItem);
+
+    WdfObjectDelete(dmfModuleQueuedWorkItem);
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_QueuedWorkItem_WorkThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+
+    ntStatus = Tests_QueuedWorkItem_RunTests(dmfModule);
+
+    // Repeat the test, until stop is signaled or the function stopped because the
+    // driver is stopping.
+    //
+    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+        (NT_SUCCESS(ntStatus)))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_QueuedWorkItem_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Tests_QueuedWorkItem.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_QueuedWorkItem* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Start the thread.
+    //
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread);
+
+    // Tell the thread it has work to do.
+    //
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThread);
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_QueuedWorkItem_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type Tests_QueuedWorkItem.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_QueuedWorkItem* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_Thread_Stop(moduleContext->DmfModuleThread);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Tests_QueuedWorkItem_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONTEXT_Tests_QueuedWorkItem* moduleContext;
+    DMF_CONFIG_Thread moduleConfigThread;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Thread
+    // ------
+    //
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_QueuedWorkItem_WorkThread;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThread);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Tests_QueuedWorkItem_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type Tests_QueuedWorkItem.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Tests_QueuedWorkItem;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_Tests_QueuedWorkItem;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_QueuedWorkItem);
+    dmfCallbacksDmf_Tests_QueuedWorkItem.ChildModulesAdd = DMF_Tests_QueuedWorkItem_ChildModulesAdd;
+    dmfCallbacksDmf_Tests_QueuedWorkItem.DeviceOpen = Tests_QueuedWorkItem_Open;
+    dmfCallbacksDmf_Tests_QueuedWorkItem.DeviceClose = Tests_QueuedWorkItem_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_QueuedWorkItem,
+                                            Tests_QueuedWorkItem,
+                                            DMF_CONTEXT_Tests_QueuedWorkItem,
+                                            DMF_MODULE_OPTIONS_PASSIVE,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_Tests_QueuedWorkItem.CallbacksDmf = &dmfCallbacksDmf_Tests_QueuedWorkItem;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_Tests_QueuedWorkItem,
+                                DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_QueuedWorkItem.c
+//
@@ -34,6 +34,77 @@ Environment:
 
 #define ITEM_COUNT_MAX           (64)
 
+// Geometry of the Ring Buffer used for benchmark passes.
+//
+#define BENCHMARK_ITEM_COUNT     (4096)
+#define BENCHMARK_ITEM_SIZE      (64)
+// Number of times the benchmark Ring Buffer is filled and drained per pass.
+//
+#define BENCHMARK_PASS_COUNT     (16)
+// Number of items written or read at once by batched benchmark passes.
+//
+#define BENCHMARK_BATCH_ITEM_COUNT          (256)
+// Number of items transferred from the work thread to the consumer thread per cross-core pass.
+//
+#define BENCHMARK_CROSS_CORE_ITEM_COUNT     (BENCHMARK_ITEM_COUNT * BENCHMARK_PASS_COUNT)
+// Size of the items in the Ring Buffers used to benchmark DMF_RingBuffer_Reorder().
+// Small items make the old item by item reorder slowest.
+//
+#define BENCHMARK_REORDER_ITEM_SIZE         (16)
+// Total sizes of the Ring Buffers used to benchmark DMF_RingBuffer_Reorder().
+//
+#define BENCHMARK_REORDER_SMALL_SIZE        (1024 * 1024)
+#define BENCHMARK_REORDER_LARGE_SIZE        (16 * 1024 * 1024)
+
+// Geometry of the Ring Buffer used to test variable size items.
+//
+#define VARIABLE_SIZE_ITEM_COUNT            (8)
+#define VARIABLE_SIZE_ITEM_SIZE_MAXIMUM     (64)
+// Number of items written to it. It is more than fit so that the oldest are deleted.
+//
+#define VARIABLE_SIZE_ITEMS_TO_WRITE        (VARIABLE_SIZE_ITEM_COUNT * 8)
+
+// Number of items in the Ring Buffer used to test reading and writing multiple items at once.
+// (Must be a power of two.)
+//
+#define MULTIPLE_ITEM_COUNT                 (8)
+
+// Number of items in the Ring Buffer used to test multiple producers. (Must be a power of two.)
+//
+#define MULTIPLE_PRODUCER_ITEM_COUNT        (16)
+// Number of items written to it. It is more than fit so that the oldest are overwritten.
+//
+#define MULTIPLE_PRODUCER_ITEMS_TO_WRITE    ((MULTIPLE_PRODUCER_ITEM_COUNT * 3) + 4)
+// Number of threads that write to the Ring Buffer at the same time while the work thread reads it.
+//
+#define MULTIPLE_PRODUCER_WRITER_COUNT      (3)
+// Number of items each of those threads writes.
+//
+#define MULTIPLE_PRODUCER_ITEMS_PER_WRITER  (4096)
+// Number of items in the Ring Buffers they write to. All items written fit in the large one
+// so none may be lost. The small one is overwritten all the time so that writers lap each other.
+// (Must be powers of two.)
+//
+#define MULTIPLE_PRODUCER_RACE_ITEM_COUNT_LARGE     (16384)
+#define MULTIPLE_PRODUCER_RACE_ITEM_COUNT_SMALL     (4)
+// Number of ULONGs in each item after the header. They are all derived from the header
+// so that the reader can tell whether the item was written by a single writer.
+//
+#define MULTIPLE_PRODUCER_PAYLOAD_COUNT     (14)
+
+// Number of items in the Ring Buffers used to test the key index.
+//
+#define KEY_INDEX_ITEM_COUNT                (12)
+// Number of different keys. Several items present at the same time have the same key.
+//
+#define KEY_INDEX_KEY_COUNT                 (5)
+// Maximum number of items written or read by each operation.
+//
+#define KEY_INDEX_ITEMS_PER_OPERATION       (3)
+// Number of random operations performed on the Ring Buffers.
+//
+#define KEY_INDEX_OPERATION_COUNT           (256)
+
 typedef struct
 {
     BOOLEAN ValueIncrement;
@@ -42,6 +113,19 @@ typedef struct
     ULONG ItemsTotal;
 } ENUM_CONTEXT_Tests_RingBuffer, *PENUM_CONTEXT_Tests_RingBuffer;
 
+typedef struct
+{
+    ULONG ItemIndexExpected;
+    ULONG ItemsFound;
+} ENUM_CONTEXT_Tests_RingBuffer_VariableSize;
+
+typedef struct
+{
+    ULONG WriterIndex;
+    ULONG Sequence;
+    ULONG Payload[MULTIPLE_PRODUCER_PAYLOAD_COUNT];
+} ITEM_Tests_RingBuffer_MultipleProducer;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -52,6 +136,31 @@ typedef struct _DMF_CONTEXT_Tests_RingBuffer
     // Thread that executes tests.
     //
     DMFMODULE DmfModuleThread;
+    // Used to time benchmark passes.
+    //
+    DMFMODULE DmfModuleTime;
+    // Thread that reads from the Ring Buffer while the work thread writes to it
+    // during cross-core benchmark passes.
+    //
+    DMFMODULE DmfModuleThreadConsumer;
+    // Ring Buffer used by the current cross-core benchmark pass.
+    //
+    DMFMODULE DmfModuleRingBufferCrossCore;
+    // Set by the consumer thread when it is done with a cross-core benchmark pass.
+    //
+    DMF_PORTABLE_EVENT ConsumerDoneEvent;
+    // Set by the work thread when it stops writing before the end of a cross-core benchmark pass.
+    //
+    volatile LONG ProducerStopped;
+    // Threads that write to the Ring Buffer at the same time while the work thread reads it.
+    //
+    DMFMODULE DmfModuleThreadProducer[MULTIPLE_PRODUCER_WRITER_COUNT];
+    // Ring Buffer they write to.
+    //
+    DMFMODULE DmfModuleRingBufferMultipleProducer;
+    // Number of those threads that are still writing.
+    //
+    volatile LONG ProducersRunning;
 } DMF_CONTEXT_Tests_RingBuffer;
 
 // This macro declares the following function:
@@ -63,6 +172,10 @@ DMF_MODULE_DECLARE_CONTEXT(Tests_RingBuffer)
 //
 DMF_MODULE_DECLARE_NO_CONFIG(Tests_RingBuffer)
 
+// Memory Pool Tag.
+//
+#define MemoryTag 'fBRT'
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // DMF Module Support Code
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -102,6 +215,43 @@ DMF_MODULE_DECLARE_NO_CONFIG(Tests_RingBuffer)
     }                                                                     \
     ntStatus = STATUS_SUCCESS;
 
+#define RESERVE_AND_COMMIT(Value)                                         \
+    ntStatus = DMF_RingBuffer_WriteReserve(dmfModuleRingBuffer,           \
+                                           &item,                         \
+                                           &itemSize);                    \
+    if (!NT_SUCCESS(ntStatus) ||                                          \
+        itemSize != sizeof(data))                                         \
+    {                                                                     \
+        DmfAssert(FALSE);                                                 \
+        goto Exit;                                                        \
+    }                                                                     \
+    data = Value;                                                         \
+    RtlCopyMemory(item,                                                   \
+                  &data,                                                  \
+                  sizeof(data));                                          \
+    DMF_RingBuffer_WriteCommit(dmfModuleRingBuffer);
+
+#define PEEK_AND_VERIFY(Value, RemoveItem)                                \
+    ntStatus = DMF_RingBuffer_ReadPeek(dmfModuleRingBuffer,               \
+                                       &item,                             \
+                                       &itemSize);                        \
+    if (!NT_SUCCESS(ntStatus))                                            \
+    {                                                                     \
+        DmfAssert(FALSE);                                                 \
+        goto Exit;                                                        \
+    }                                                                     \
+    RtlCopyMemory(&data,                                                  \
+                  item,                                                   \
+                  sizeof(data));                                          \
+    DMF_RingBuffer_ReadRelease(dmfModuleRingBuffer,                       \
+                               RemoveItem);                               \
+    if (itemSize != sizeof(data) ||                                       \
+        data != Value)                                                    \
+    {                                                                     \
+        DmfAssert(FALSE);                                                 \
+        goto Exit;                                                        \
+    }
+
 #define ENUM_AND_VERIFY(FirstItem, NumberOfItems)                         \
 {                                                                         \
     ENUM_CONTEXT_Tests_RingBuffer enumContext;                            \
@@ -185,6 +335,8 @@ Tests_RingBuffer_RunTests(
     DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
     DMFMODULE dmfModuleRingBuffer;
     ULONG data;
+    UCHAR* item;
+    ULONG itemSize;
     NTSTATUS ntStatus;
     ULONG itemCountIndex;
     DMF_CONTEXT_Tests_RingBuffer* moduleContext;
@@ -239,12 +391,34 @@ Tests_RingBuffer_RunTests(
                                TRUE);
         READ_AND_VERIFY(itemCountIndex);
 
+        // Overfill the buffer by one item in place, enumerate and read back in place.
+        // The first item is deleted to make space for the last one.
+        //
+        for (ULONG itemIndex = 0; itemIndex <= itemCountIndex; itemIndex++)
+        {
+            RESERVE_AND_COMMIT(itemIndex);
+        }
+        ENUM_AND_VERIFY(1,
+                        itemCountIndex);
+        for (ULONG itemIndex = 1; itemIndex <= itemCountIndex; itemIndex++)
+        {
+            PEEK_AND_VERIFY(itemIndex, FALSE);
+            PEEK_AND_VERIFY(itemIndex, TRUE);
+        }
+        READ_MUST_FAIL();
+
         // Fill the buffer, reorder, enumerate and read back.
         //
         for (ULONG itemIndex = 0; itemIndex < itemCountIndex && (! DMF_Thread_IsStopPending(moduleContext->DmfModuleThread)); itemIndex++)
         {
             WRITE_MUST_SUCCEED(itemIndex);
         }
+        if (DMF_Thread_IsStopPending(moduleContext->DmfModuleThread))
+        {
+            // The buffer is only partially filled if the driver is stopping.
+            //
+            goto Exit;
+        }
         DMF_RingBuffer_Reorder(dmfModuleRingBuffer,
                                TRUE);
         ENUM_AND_VERIFY(0, 
@@ -278,6 +452,13 @@ Tests_RingBuffer_RunTests(
             }
         }
 
+        if (DMF_Thread_IsStopPending(moduleContext->DmfModuleThread))
+        {
+            // Items are left unread if the driver is stopping.
+            //
+            goto Exit;
+        }
+
         // Reorder empty Ring Buffer.
         //
         READ_MUST_FAIL();
@@ -303,6 +484,13 @@ Tests_RingBuffer_RunTests(
                 READ_AND_VERIFY(itemIndex);
             }
 
+            if (DMF_Thread_IsStopPending(moduleContext->DmfModuleThread))
+            {
+                // Same as above.
+                //
+                goto Exit;
+            }
+
             // Reorder empty Ring Buffer.
             //
             READ_MUST_FAIL();
@@ -327,138 +515,1908 @@ Exit:
 #pragma code_seg()
 
 #pragma code_seg("PAGE")
-_Function_class_(EVT_DMF_Thread_Function)
 _IRQL_requires_max_(PASSIVE_LEVEL)
-static
-VOID
-Tests_RingBuffer_WorkThread(
-    _In_ DMFMODULE DmfModuleThread
+NTSTATUS
+Tests_RingBuffer_RunTestsMultipleItems(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device,
+    _In_ RingBuffer_ModeType Mode,
+    _In_ RingBuffer_SynchronizationType Synchronization
     )
 {
-    DMFMODULE dmfModule;
-    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
-    WDFDEVICE device;
-    ULONG itemCountMax;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer;
     NTSTATUS ntStatus;
+    ULONG data;
+    ULONG items[MULTIPLE_ITEM_COUNT * 2];
+    ULONG itemIndex;
+    ULONG itemsTransferred;
+
+    UNREFERENCED_PARAMETER(DmfModule);
 
     PAGED_CODE();
 
-    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
-    moduleContext = DMF_CONTEXT_GET(dmfModule);
-    device = DMF_ParentDeviceGet(dmfModule);
+    dmfModuleRingBuffer = NULL;
 
-    itemCountMax = TestsUtility_GenerateRandomNumber(4, 
-                                                     ITEM_COUNT_MAX);
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                              &moduleAttributes);
+    moduleConfigRingBuffer.ItemCount = MULTIPLE_ITEM_COUNT;
+    moduleConfigRingBuffer.ItemSize = sizeof(ULONG);
+    moduleConfigRingBuffer.Mode = Mode;
+    moduleConfigRingBuffer.Synchronization = Synchronization;
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleRingBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
 
-    ntStatus = Tests_RingBuffer_RunTests(dmfModule,
-                                         device, 
-                                         itemCountMax);
+    // Move the Read and Write pointers away from the beginning so that the items written next wrap around.
+    //
+    WRITE_MUST_SUCCEED(0);
+    WRITE_MUST_SUCCEED(1);
+    WRITE_MUST_SUCCEED(2);
+    READ_AND_VERIFY(0);
+    READ_AND_VERIFY(1);
+
+    // Fill the Ring Buffer at once. In RingBuffer_Mode_FailIfFullOnWrite only the items that fit are written.
+    // In RingBuffer_Mode_DeleteOldestIfFullOnWrite all items are written and only the newest items remain.
+    //
+    for (itemIndex = 0; itemIndex < MULTIPLE_ITEM_COUNT; itemIndex++)
+    {
+        items[itemIndex] = 3 + itemIndex;
+    }
+    ntStatus = DMF_RingBuffer_WriteMultiple(dmfModuleRingBuffer,
+                                            (UCHAR*)items,
+                                            MULTIPLE_ITEM_COUNT * sizeof(ULONG),
+                                            &itemsTransferred);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(FALSE);
+        goto Exit;
+    }
 
-    // Repeat the test, until stop is signaled or the function stopped because the
-    // driver is stopping.
+    if (RingBuffer_Mode_FailIfFullOnWrite == Mode)
+    {
+        // 2, 3...9 are present. Nothing else fits.
+        //
+        DmfAssert(itemsTransferred == MULTIPLE_ITEM_COUNT - 1);
+        ntStatus = DMF_RingBuffer_WriteMultiple(dmfModuleRingBuffer,
+                                                (UCHAR*)items,
+                                                sizeof(ULONG),
+                                                &itemsTransferred);
+        if (NT_SUCCESS(ntStatus) ||
+            (itemsTransferred != 0))
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+        ENUM_AND_VERIFY(2, MULTIPLE_ITEM_COUNT);
+    }
+    else
+    {
+        // 3, 4...10 are present.
+        //
+        DmfAssert(itemsTransferred == MULTIPLE_ITEM_COUNT);
+        ENUM_AND_VERIFY(3, MULTIPLE_ITEM_COUNT);
+        READ_AND_VERIFY(3);
+        WRITE_MUST_SUCCEED(11);
+    }
+
+    // Read some items at once.
     //
-    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
-        (NT_SUCCESS(ntStatus)))
+    ntStatus = DMF_RingBuffer_ReadMultiple(dmfModuleRingBuffer,
+                                           (UCHAR*)items,
+                                           3 * sizeof(ULONG),
+                                           &itemsTransferred);
+    if (!NT_SUCCESS(ntStatus) ||
+        (itemsTransferred != 3))
     {
-        DMF_Thread_WorkReady(DmfModuleThread);
+        DmfAssert(FALSE);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+    data = items[0];
+    for (itemIndex = 0; itemIndex < itemsTransferred; itemIndex++)
+    {
+        DmfAssert(items[itemIndex] == data + itemIndex);
     }
+    data += itemsTransferred;
 
-    TestsUtility_YieldExecution();
-}
-#pragma code_seg()
+    // Read the rest with a buffer larger than needed.
+    //
+    ntStatus = DMF_RingBuffer_ReadMultiple(dmfModuleRingBuffer,
+                                           (UCHAR*)items,
+                                           sizeof(items),
+                                           &itemsTransferred);
+    if (!NT_SUCCESS(ntStatus) ||
+        (itemsTransferred != MULTIPLE_ITEM_COUNT - 3))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+    for (itemIndex = 0; itemIndex < itemsTransferred; itemIndex++)
+    {
+        DmfAssert(items[itemIndex] == data + itemIndex);
+    }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// WDF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
+    ntStatus = DMF_RingBuffer_ReadMultiple(dmfModuleRingBuffer,
+                                           (UCHAR*)items,
+                                           sizeof(items),
+                                           &itemsTransferred);
+    if (NT_SUCCESS(ntStatus) ||
+        (itemsTransferred != 0))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+    ntStatus = STATUS_SUCCESS;
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// DMF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
+Exit:
+
+    if (dmfModuleRingBuffer != NULL)
+    {
+        WdfObjectDelete(dmfModuleRingBuffer);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
 
 #pragma code_seg("PAGE")
-_Function_class_(DMF_Open)
 _IRQL_requires_max_(PASSIVE_LEVEL)
-_Must_inspect_result_
-static
 NTSTATUS
-Tests_RingBuffer_Open(
-    _In_ DMFMODULE DmfModule
+Tests_RingBuffer_RunTestsMultipleProducer(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
     )
-/*++
-
-Routine Description:
-
-    Initialize an instance of a DMF Module of type Test_RingBuffer.
-
-Arguments:
-
-    DmfModule - This Module's handle.
-
-Return Value:
-
-    STATUS_SUCCESS
-
---*/
 {
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer;
     NTSTATUS ntStatus;
-    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    ULONG data;
+    ULONG itemIndex;
+    ULONG firstItem;
+
+    UNREFERENCED_PARAMETER(DmfModule);
 
     PAGED_CODE();
 
-    FuncEntry(DMF_TRACE);
+    dmfModuleRingBuffer = NULL;
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-    // Start the thread.
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                              &moduleAttributes);
+    moduleConfigRingBuffer.ItemCount = MULTIPLE_PRODUCER_ITEM_COUNT;
+    moduleConfigRingBuffer.ItemSize = sizeof(ULONG);
+    moduleConfigRingBuffer.Mode = RingBuffer_Mode_DeleteOldestIfFullOnWrite;
+    moduleConfigRingBuffer.Synchronization = RingBuffer_Synchronization_MultipleProducerOverwrite;
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleRingBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
+
+    // Empty.
     //
-    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread);
+    ENUM_AND_VERIFY(0, 0);
 
-    // Tell the thread it has work to do.
+    // Wrap around several times. Only the newest items remain.
     //
-    DMF_Thread_WorkReady(moduleContext->DmfModuleThread);
+    for (itemIndex = 0; itemIndex < MULTIPLE_PRODUCER_ITEMS_TO_WRITE; itemIndex++)
+    {
+        WRITE_MUST_SUCCEED(itemIndex);
+    }
+    firstItem = MULTIPLE_PRODUCER_ITEMS_TO_WRITE - MULTIPLE_PRODUCER_ITEM_COUNT;
+    ENUM_AND_VERIFY(firstItem, MULTIPLE_PRODUCER_ITEM_COUNT);
+    data = firstItem + 1;
+    FIND_AND_VERIFY(data);
 
-    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+    // Reorder (as a crash dump does) and make sure the items stay in order
+    // and that writing continues after the newest item.
+    //
+    DMF_RingBuffer_Reorder(dmfModuleRingBuffer,
+                           TRUE);
+    ENUM_AND_VERIFY(firstItem, MULTIPLE_PRODUCER_ITEM_COUNT);
+    WRITE_MUST_SUCCEED(MULTIPLE_PRODUCER_ITEMS_TO_WRITE);
+    WRITE_MUST_SUCCEED(MULTIPLE_PRODUCER_ITEMS_TO_WRITE + 1);
+    firstItem += 2;
+    ENUM_AND_VERIFY(firstItem, MULTIPLE_PRODUCER_ITEM_COUNT);
+
+    // Read all the items oldest first.
+    //
+    for (itemIndex = firstItem; itemIndex < firstItem + MULTIPLE_PRODUCER_ITEM_COUNT; itemIndex++)
+    {
+        READ_AND_VERIFY(itemIndex);
+    }
+    READ_MUST_FAIL();
+    ENUM_AND_VERIFY(0, 0);
+
+Exit:
+
+    if (dmfModuleRingBuffer != NULL)
+    {
+        WdfObjectDelete(dmfModuleRingBuffer);
+    }
 
     return ntStatus;
 }
 #pragma code_seg()
 
-#pragma code_seg("PAGE")
-_Function_class_(DMF_Close)
-_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_same_
 static
 VOID
-Tests_RingBuffer_Close(
-    _In_ DMFMODULE DmfModule
+Tests_RingBuffer_MultipleProducerItemBuild(
+    _In_ ULONG WriterIndex,
+    _In_ ULONG Sequence,
+    _Out_ ITEM_Tests_RingBuffer_MultipleProducer* Item
     )
-/*++
-
-Routine Description:
-
-    Close an instance of a DMF Module of type Test_RingBuffer.
-
-Arguments:
-
-    DmfModule - This Module's handle.
-
-Return Value:
-
-    STATUS_SUCCESS
-
---*/
 {
-    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    ULONG payloadIndex;
 
-    PAGED_CODE();
-
-    FuncEntry(DMF_TRACE);
+    Item->WriterIndex = WriterIndex;
+    Item->Sequence = Sequence;
+    for (payloadIndex = 0; payloadIndex < MULTIPLE_PRODUCER_PAYLOAD_COUNT; payloadIndex++)
+    {
+        Item->Payload[payloadIndex] = (WriterIndex << 24) ^ Sequence ^ (payloadIndex * 0x9E3779B9);
+    }
+}
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+_IRQL_requires_same_
+static
+BOOLEAN
+Tests_RingBuffer_MultipleProducerItemIsValid(
+    _In_ ITEM_Tests_RingBuffer_MultipleProducer* Item
+    )
+{
+    ITEM_Tests_RingBuffer_MultipleProducer itemExpected;
 
-    DMF_Thread_Stop(moduleContext->DmfModuleThread);
+    if (Item->WriterIndex >= MULTIPLE_PRODUCER_WRITER_COUNT ||
+        Item->Sequence >= MULTIPLE_PRODUCER_ITEMS_PER_WRITER)
+    {
+        return FALSE;
+    }
 
-    FuncExitVoid(DMF_TRACE);
+    // The whole item must be the one its header says was written. Otherwise parts
+    // of it were written by different writers.
+    //
+    Tests_RingBuffer_MultipleProducerItemBuild(Item->WriterIndex,
+                                               Item->Sequence,
+                                               &itemExpected);
+    return (sizeof(itemExpected) == RtlCompareMemory(Item,
+                                                     &itemExpected,
+                                                     sizeof(itemExpected)));
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+Tests_RingBuffer_RunTestsMultipleProducerConcurrent(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device,
+    _In_ ULONG ItemCount
+    )
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer;
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    ITEM_Tests_RingBuffer_MultipleProducer item;
+    ULONG sequenceNext[MULTIPLE_PRODUCER_WRITER_COUNT];
+    ULONG itemsRead;
+    ULONG writerIndex;
+    LONG producersRunning;
+    BOOLEAN itemsMayBeOverwritten;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleRingBuffer = NULL;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                              &moduleAttributes);
+    moduleConfigRingBuffer.ItemCount = ItemCount;
+    moduleConfigRingBuffer.ItemSize = sizeof(ITEM_Tests_RingBuffer_MultipleProducer);
+    moduleConfigRingBuffer.Mode = RingBuffer_Mode_DeleteOldestIfFullOnWrite;
+    moduleConfigRingBuffer.Synchronization = RingBuffer_Synchronization_MultipleProducerOverwrite;
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleRingBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
+
+    itemsMayBeOverwritten = (ItemCount < MULTIPLE_PRODUCER_WRITER_COUNT * MULTIPLE_PRODUCER_ITEMS_PER_WRITER);
+    RtlZeroMemory(sequenceNext,
+                  sizeof(sequenceNext));
+    itemsRead = 0;
+
+    // Start all the writers. This thread reads while they write.
+    //
+    moduleContext->DmfModuleRingBufferMultipleProducer = dmfModuleRingBuffer;
+    InterlockedExchange(&moduleContext->ProducersRunning,
+                        MULTIPLE_PRODUCER_WRITER_COUNT);
+    for (writerIndex = 0; writerIndex < MULTIPLE_PRODUCER_WRITER_COUNT; writerIndex++)
+    {
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadProducer[writerIndex]);
+    }
+
+    for (;;)
+    {
+        // Get the number of running writers before reading so that an item written just
+        // before the last writer stops is still read.
+        //
+        producersRunning = InterlockedCompareExchange(&moduleContext->ProducersRunning,
+                                                      0,
+                                                      0);
+        ntStatus = DMF_RingBuffer_Read(dmfModuleRingBuffer,
+                                       (UCHAR*)&item,
+                                       sizeof(item));
+        if (!NT_SUCCESS(ntStatus))
+        {
+            if (0 == producersRunning)
+            {
+                // All the items written have been read.
+                //
+                ntStatus = STATUS_SUCCESS;
+                break;
+            }
+            YieldProcessor();
+            continue;
+        }
+
+        // Every item read must be exactly one item that was written...
+        //
+        DmfAssert(Tests_RingBuffer_MultipleProducerItemIsValid(&item));
+        if (item.WriterIndex >= MULTIPLE_PRODUCER_WRITER_COUNT)
+        {
+            continue;
+        }
+
+        // ...and items from the same writer are read in the order they were written.
+        // When no item can be overwritten, none of them may be skipped either.
+        //
+        if (itemsMayBeOverwritten)
+        {
+            DmfAssert(item.Sequence >= sequenceNext[item.WriterIndex]);
+        }
+        else
+        {
+            DmfAssert(item.Sequence == sequenceNext[item.WriterIndex]);
+        }
+        sequenceNext[item.WriterIndex] = item.Sequence + 1;
+        itemsRead++;
+    }
+
+    // The newest items remain after the writers stop so something is always read.
+    //
+    DmfAssert(itemsRead > 0);
+    if (! itemsMayBeOverwritten)
+    {
+        DmfAssert(MULTIPLE_PRODUCER_WRITER_COUNT * MULTIPLE_PRODUCER_ITEMS_PER_WRITER == itemsRead);
+    }
+
+    moduleContext->DmfModuleRingBufferMultipleProducer = NULL;
+
+Exit:
+
+    if (dmfModuleRingBuffer != NULL)
+    {
+        WdfObjectDelete(dmfModuleRingBuffer);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+_IRQL_requires_same_
+static
+ULONG
+Tests_RingBuffer_VariableSizeItemBuild(
+    _In_ ULONG ItemIndex,
+    _Out_writes_(VARIABLE_SIZE_ITEM_SIZE_MAXIMUM) UCHAR* Item
+    )
+{
+    ULONG itemSize;
+
+    // Use a different size for consecutive items and content that identifies the item.
+    //
+    itemSize = 1 + ((ItemIndex * 7) % VARIABLE_SIZE_ITEM_SIZE_MAXIMUM);
+    for (ULONG byteIndex = 0; byteIndex < itemSize; byteIndex++)
+    {
+        Item[byteIndex] = (UCHAR)(ItemIndex + byteIndex);
+    }
+
+    return itemSize;
+}
+
+_IRQL_requires_same_
+static
+BOOLEAN
+Tests_RingBuffer_VariableSizeItemVerify(
+    _In_ ULONG ItemIndex,
+    _In_reads_(ItemSize) UCHAR* Item,
+    _In_ ULONG ItemSize
+    )
+{
+    UCHAR itemExpected[VARIABLE_SIZE_ITEM_SIZE_MAXIMUM];
+    ULONG itemSizeExpected;
+
+    itemSizeExpected = Tests_RingBuffer_VariableSizeItemBuild(ItemIndex,
+                                                              itemExpected);
+    return ((ItemSize == itemSizeExpected) &&
+            (RtlCompareMemory(Item,
+                              itemExpected,
+                              ItemSize) == ItemSize));
+}
+
+_Function_class_(EVT_DMF_RingBuffer_Enumeration)
+BOOLEAN
+Tests_RingBuffer_VariableSizeEnumeration(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_opt_ VOID* CallbackContext
+    )
+{
+    ENUM_CONTEXT_Tests_RingBuffer_VariableSize* enumContext;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    enumContext = (ENUM_CONTEXT_Tests_RingBuffer_VariableSize*)CallbackContext;
+    DmfAssert(enumContext != NULL);
+
+    // 'Dereferencing NULL pointer. 'dataSource' contains the same NULL value as 'CallbackContext' did.'
+    //
+    #pragma warning(suppress:28182)
+    DmfAssert(Tests_RingBuffer_VariableSizeItemVerify(enumContext->ItemIndexExpected,
+                                                      Buffer,
+                                                      BufferSize));
+    #pragma warning(suppress:28182)
+    enumContext->ItemIndexExpected++;
+    #pragma warning(suppress:28182)
+    enumContext->ItemsFound++;
+
+    return TRUE;
+}
+
+_Function_class_(EVT_DMF_RingBuffer_Enumeration)
+BOOLEAN
+Tests_RingBuffer_EnumerationCount(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_opt_ VOID* CallbackContext
+    )
+{
+    ENUM_CONTEXT_Tests_RingBuffer_VariableSize* enumContext;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+    UNREFERENCED_PARAMETER(Buffer);
+    UNREFERENCED_PARAMETER(BufferSize);
+
+    enumContext = (ENUM_CONTEXT_Tests_RingBuffer_VariableSize*)CallbackContext;
+    DmfAssert(enumContext != NULL);
+
+    // 'Dereferencing NULL pointer. 'dataSource' contains the same NULL value as 'CallbackContext' did.'
+    //
+    #pragma warning(suppress:28182)
+    enumContext->ItemsFound++;
+
+    return TRUE;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+Tests_RingBuffer_RunTestsVariableSize(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
+    )
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer;
+    NTSTATUS ntStatus;
+    ENUM_CONTEXT_Tests_RingBuffer_VariableSize enumContext;
+    UCHAR item[VARIABLE_SIZE_ITEM_SIZE_MAXIMUM];
+    ULONG itemSize;
+    ULONG itemIndex;
+    ULONG firstItemIndex;
+    ULONG totalSize;
+    UCHAR* allItems;
+    WDFMEMORY allItemsMemory;
+    ULONG bytesWritten;
+    ULONG offset;
+
+    PAGED_CODE();
+
+    dmfModuleRingBuffer = NULL;
+    allItemsMemory = NULL;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                              &moduleAttributes);
+    moduleConfigRingBuffer.ItemCount = VARIABLE_SIZE_ITEM_COUNT;
+    moduleConfigRingBuffer.ItemSize = VARIABLE_SIZE_ITEM_SIZE_MAXIMUM;
+    moduleConfigRingBuffer.Mode = RingBuffer_Mode_DeleteOldestIfFullOnWrite;
+    moduleConfigRingBuffer.VariableSizeItems = TRUE;
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleRingBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
+
+    // Write more items than fit. The oldest items are deleted.
+    //
+    for (itemIndex = 0; itemIndex < VARIABLE_SIZE_ITEMS_TO_WRITE; itemIndex++)
+    {
+        itemSize = Tests_RingBuffer_VariableSizeItemBuild(itemIndex,
+                                                          item);
+        ntStatus = DMF_RingBuffer_Write(dmfModuleRingBuffer,
+                                        item,
+                                        itemSize);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+    }
+
+    // The newest items are present in order. Because most items are smaller than the
+    // maximum size, more than ItemCount items are present.
+    //
+    enumContext.ItemsFound = 0;
+    enumContext.ItemIndexExpected = 0;
+    DMF_RingBuffer_Enumerate(dmfModuleRingBuffer,
+                             FALSE,
+                             Tests_RingBuffer_EnumerationCount,
+                             &enumContext);
+    DmfAssert(enumContext.ItemsFound > VARIABLE_SIZE_ITEM_COUNT);
+    firstItemIndex = VARIABLE_SIZE_ITEMS_TO_WRITE - enumContext.ItemsFound;
+
+    enumContext.ItemsFound = 0;
+    enumContext.ItemIndexExpected = firstItemIndex;
+    DMF_RingBuffer_Enumerate(dmfModuleRingBuffer,
+                             TRUE,
+                             Tests_RingBuffer_VariableSizeEnumeration,
+                             &enumContext);
+    DmfAssert(enumContext.ItemIndexExpected == VARIABLE_SIZE_ITEMS_TO_WRITE);
+
+    // Reorder and make sure the items are still present in order.
+    //
+    DMF_RingBuffer_Reorder(dmfModuleRingBuffer,
+                           TRUE);
+    enumContext.ItemsFound = 0;
+    enumContext.ItemIndexExpected = firstItemIndex;
+    DMF_RingBuffer_Enumerate(dmfModuleRingBuffer,
+                             TRUE,
+                             Tests_RingBuffer_VariableSizeEnumeration,
+                             &enumContext);
+    DmfAssert(enumContext.ItemIndexExpected == VARIABLE_SIZE_ITEMS_TO_WRITE);
+
+    // Read half of the items one at a time.
+    //
+    for (itemIndex = firstItemIndex; itemIndex < firstItemIndex + (enumContext.ItemsFound / 2); itemIndex++)
+    {
+        ntStatus = DMF_RingBuffer_ReadEx(dmfModuleRingBuffer,
+                                         item,
+                                         sizeof(item),
+                                         &itemSize);
+        if (!NT_SUCCESS(ntStatus) ||
+            !Tests_RingBuffer_VariableSizeItemVerify(itemIndex,
+                                                     item,
+                                                     itemSize))
+        {
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+    }
+
+    // Read the rest at once. Each item is preceded by its size.
+    //
+    DMF_RingBuffer_TotalSizeGet(dmfModuleRingBuffer,
+                                &totalSize);
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               totalSize,
+                               &allItemsMemory,
+                               (VOID**)&allItems);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    ntStatus = DMF_RingBuffer_ReadAll(dmfModuleRingBuffer,
+                                      allItems,
+                                      totalSize,
+                                      &bytesWritten);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(FALSE);
+        goto Exit;
+    }
+
+    offset = 0;
+    while (offset < bytesWritten)
+    {
+        RtlCopyMemory(&itemSize,
+                      &allItems[offset],
+                      sizeof(itemSize));
+        offset += sizeof(itemSize);
+        DmfAssert(Tests_RingBuffer_VariableSizeItemVerify(itemIndex,
+                                                          &allItems[offset],
+                                                          itemSize));
+        offset += itemSize;
+        itemIndex++;
+    }
+    DmfAssert(offset == bytesWritten);
+    DmfAssert(VARIABLE_SIZE_ITEMS_TO_WRITE == itemIndex);
+
+    // The Ring Buffer is now empty.
+    //
+    ntStatus = DMF_RingBuffer_ReadEx(dmfModuleRingBuffer,
+                                     item,
+                                     sizeof(item),
+                                     &itemSize);
+    if (NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    if (allItemsMemory != NULL)
+    {
+        WdfObjectDelete(allItemsMemory);
+    }
+
+    if (dmfModuleRingBuffer != NULL)
+    {
+        WdfObjectDelete(dmfModuleRingBuffer);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+_IRQL_requires_same_
+static
+ULONG
+Tests_RingBuffer_KeyIndexItemBuild(
+    _In_ ULONG ItemIndex
+    )
+{
+    // The key is the low USHORT. The high USHORT makes each item unique.
+    //
+    return (ItemIndex << 16) | (ItemIndex % KEY_INDEX_KEY_COUNT);
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+ULONG
+Tests_RingBuffer_FindCount(
+    _In_ DMFMODULE DmfModuleRingBuffer,
+    _In_reads_(ItemSize) UCHAR* Item,
+    _In_ ULONG ItemSize
+    )
+{
+    ENUM_CONTEXT_Tests_RingBuffer_VariableSize enumContext;
+
+    PAGED_CODE();
+
+    enumContext.ItemIndexExpected = 0;
+    enumContext.ItemsFound = 0;
+    DMF_RingBuffer_EnumerateToFindItem(DmfModuleRingBuffer,
+                                       Tests_RingBuffer_EnumerationCount,
+                                       &enumContext,
+                                       Item,
+                                       ItemSize);
+
+    return enumContext.ItemsFound;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+Tests_RingBuffer_RunTestsKeyIndex(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
+    )
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer;
+    DMFMODULE dmfModuleRingBufferScan;
+    NTSTATUS ntStatus;
+    NTSTATUS ntStatusScan;
+    ULONG items[KEY_INDEX_ITEMS_PER_OPERATION];
+    ULONG itemsScan[KEY_INDEX_ITEMS_PER_OPERATION];
+    ULONG itemsTransferred;
+    ULONG itemsTransferredScan;
+    ULONG itemCount;
+    ULONG itemIndex;
+    ULONG nextItemIndex;
+    ULONG operationIndex;
+    ULONG data;
+    UCHAR* item;
+    ULONG itemSize;
+    USHORT key;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+
+    PAGED_CODE();
+
+    dmfModuleRingBuffer = NULL;
+    dmfModuleRingBufferScan = NULL;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Both Ring Buffers receive the same items. Only the first one has a key index, so
+    // the second one shows what DMF_RingBuffer_EnumerateToFindItem() must find.
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                              &moduleAttributes);
+    moduleConfigRingBuffer.ItemCount = KEY_INDEX_ITEM_COUNT;
+    moduleConfigRingBuffer.ItemSize = sizeof(ULONG);
+    moduleConfigRingBuffer.Mode = RingBuffer_Mode_DeleteOldestIfFullOnWrite;
+    moduleConfigRingBuffer.KeyOffset = 0;
+    moduleConfigRingBuffer.KeySize = sizeof(USHORT);
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleRingBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
+
+    moduleConfigRingBuffer.KeySize = 0;
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleRingBufferScan);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
+
+    nextItemIndex = 0;
+    for (operationIndex = 0; operationIndex < KEY_INDEX_OPERATION_COUNT && (! DMF_Thread_IsStopPending(moduleContext->DmfModuleThread)); operationIndex++)
+    {
+        itemCount = TestsUtility_GenerateRandomNumber(1,
+                                                      KEY_INDEX_ITEMS_PER_OPERATION);
+        switch (TestsUtility_GenerateRandomNumber(0, 4))
+        {
+            case 0:
+            case 1:
+            {
+                // Write some items. Writing is more likely than reading so that the oldest
+                // items are often deleted to make space.
+                //
+                for (itemIndex = 0; itemIndex < itemCount; itemIndex++)
+                {
+                    items[itemIndex] = Tests_RingBuffer_KeyIndexItemBuild(nextItemIndex);
+                    nextItemIndex++;
+                }
+                if (1 == itemCount)
+                {
+                    ntStatus = DMF_RingBuffer_Write(dmfModuleRingBuffer,
+                                                    (UCHAR*)items,
+                                                    sizeof(ULONG));
+                    ntStatusScan = DMF_RingBuffer_Write(dmfModuleRingBufferScan,
+                                                        (UCHAR*)items,
+                                                        sizeof(ULONG));
+                }
+                else
+                {
+                    ntStatus = DMF_RingBuffer_WriteMultiple(dmfModuleRingBuffer,
+                                                            (UCHAR*)items,
+                                                            itemCount * sizeof(ULONG),
+                                                            &itemsTransferred);
+                    ntStatusScan = DMF_RingBuffer_WriteMultiple(dmfModuleRingBufferScan,
+                                                                (UCHAR*)items,
+                                                                itemCount * sizeof(ULONG),
+                                                                &itemsTransferredScan);
+                    DmfAssert(itemsTransferred == itemsTransferredScan);
+                }
+                if (!NT_SUCCESS(ntStatus) ||
+                    !NT_SUCCESS(ntStatusScan))
+                {
+                    DmfAssert(FALSE);
+                    ntStatus = STATUS_UNSUCCESSFUL;
+                    goto Exit;
+                }
+                break;
+            }
+            case 2:
+            {
+                // Read some items. The Ring Buffers may be empty.
+                //
+                if (1 == itemCount)
+                {
+                    ntStatus = DMF_RingBuffer_Read(dmfModuleRingBuffer,
+                                                   (UCHAR*)items,
+                                                   sizeof(ULONG));
+                    ntStatusScan = DMF_RingBuffer_Read(dmfModuleRingBufferScan,
+                                                       (UCHAR*)itemsScan,
+                                                       sizeof(ULONG));
+                    itemsTransferred = NT_SUCCESS(ntStatus) ? 1 : 0;
+                    itemsTransferredScan = NT_SUCCESS(ntStatusScan) ? 1 : 0;
+                }
+                else
+                {
+                    ntStatus = DMF_RingBuffer_ReadMultiple(dmfModuleRingBuffer,
+                                                           (UCHAR*)items,
+                                                           itemCount * sizeof(ULONG),
+                                                           &itemsTransferred);
+                    ntStatusScan = DMF_RingBuffer_ReadMultiple(dmfModuleRingBufferScan,
+                                                               (UCHAR*)itemsScan,
+                                                               itemCount * sizeof(ULONG),
+                                                               &itemsTransferredScan);
+                }
+                DmfAssert(NT_SUCCESS(ntStatus) == NT_SUCCESS(ntStatusScan));
+                DmfAssert(itemsTransferred == itemsTransferredScan);
+                for (itemIndex = 0; itemIndex < itemsTransferred; itemIndex++)
+                {
+                    DmfAssert(items[itemIndex] == itemsScan[itemIndex]);
+                }
+                break;
+            }
+            case 3:
+            {
+                // Items move, so the key index is rebuilt.
+                //
+                DMF_RingBuffer_Reorder(dmfModuleRingBuffer,
+                                       TRUE);
+                DMF_RingBuffer_Reorder(dmfModuleRingBufferScan,
+                                       TRUE);
+                break;
+            }
+            default:
+            {
+                // Add an item in place.
+                //
+                RESERVE_AND_COMMIT(Tests_RingBuffer_KeyIndexItemBuild(nextItemIndex));
+                data = Tests_RingBuffer_KeyIndexItemBuild(nextItemIndex);
+                nextItemIndex++;
+                ntStatus = DMF_RingBuffer_Write(dmfModuleRingBufferScan,
+                                                (UCHAR*)&data,
+                                                sizeof(data));
+                if (!NT_SUCCESS(ntStatus))
+                {
+                    DmfAssert(FALSE);
+                    goto Exit;
+                }
+                break;
+            }
+        }
+
+        // Searching for a key finds every item that has the key. The search uses the
+        // key index because the data searched for contains the whole key.
+        //
+        for (key = 0; key < KEY_INDEX_KEY_COUNT; key++)
+        {
+            DmfAssert(Tests_RingBuffer_FindCount(dmfModuleRingBuffer,
+                                                 (UCHAR*)&key,
+                                                 sizeof(key)) ==
+                      Tests_RingBuffer_FindCount(dmfModuleRingBufferScan,
+                                                 (UCHAR*)&key,
+                                                 sizeof(key)));
+        }
+
+        // Searching for a whole item finds only that item.
+        //
+        if (nextItemIndex > 0)
+        {
+            data = Tests_RingBuffer_KeyIndexItemBuild(nextItemIndex - 1);
+            DmfAssert(Tests_RingBuffer_FindCount(dmfModuleRingBuffer,
+                                                 (UCHAR*)&data,
+                                                 sizeof(data)) ==
+                      Tests_RingBuffer_FindCount(dmfModuleRingBufferScan,
+                                                 (UCHAR*)&data,
+                                                 sizeof(data)));
+        }
+
+        // Searching for less than the key compares every item.
+        //
+        data = Tests_RingBuffer_KeyIndexItemBuild(operationIndex);
+        DmfAssert(Tests_RingBuffer_FindCount(dmfModuleRingBuffer,
+                                             (UCHAR*)&data,
+                                             sizeof(UCHAR)) ==
+                  Tests_RingBuffer_FindCount(dmfModuleRingBufferScan,
+                                             (UCHAR*)&data,
+                                             sizeof(UCHAR)));
+    }
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    if (dmfModuleRingBufferScan != NULL)
+    {
+        WdfObjectDelete(dmfModuleRingBufferScan);
+    }
+
+    if (dmfModuleRingBuffer != NULL)
+    {
+        WdfObjectDelete(dmfModuleRingBuffer);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+Tests_RingBuffer_Benchmark(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
+    )
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer;
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    UCHAR item[BENCHMARK_ITEM_SIZE];
+    UCHAR* ringBufferItem;
+    ULONG ringBufferItemSize;
+    LONGLONG startTick;
+    LONGLONG writeNanoseconds;
+    LONGLONG readNanoseconds;
+    LONGLONG reserveNanoseconds;
+    LONGLONG peekNanoseconds;
+    LONGLONG writeMultipleNanoseconds;
+    LONGLONG readMultipleNanoseconds;
+    LONGLONG elapsedNanoseconds;
+    ULONG operationCount;
+    WDFMEMORY batchMemory;
+    UCHAR* batch;
+    ULONG itemsTransferred;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleRingBuffer = NULL;
+    batchMemory = NULL;
+    writeNanoseconds = 0;
+    readNanoseconds = 0;
+    reserveNanoseconds = 0;
+    peekNanoseconds = 0;
+    writeMultipleNanoseconds = 0;
+    readMultipleNanoseconds = 0;
+    operationCount = 0;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                              &moduleAttributes);
+    moduleConfigRingBuffer.ItemCount = BENCHMARK_ITEM_COUNT;
+    moduleConfigRingBuffer.ItemSize = BENCHMARK_ITEM_SIZE;
+    moduleConfigRingBuffer.Mode = RingBuffer_Mode_FailIfFullOnWrite;
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleRingBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
+
+    TestsUtility_FillWithSequentialData(item,
+                                        sizeof(item));
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               BENCHMARK_BATCH_ITEM_COUNT * BENCHMARK_ITEM_SIZE,
+                               &batchMemory,
+                               (VOID**)&batch);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    TestsUtility_FillWithSequentialData(batch,
+                                        BENCHMARK_BATCH_ITEM_COUNT * BENCHMARK_ITEM_SIZE);
+
+    for (ULONG passIndex = 0; passIndex < BENCHMARK_PASS_COUNT && (! DMF_Thread_IsStopPending(moduleContext->DmfModuleThread)); passIndex++)
+    {
+        // Fill the Ring Buffer.
+        //
+        startTick = DMF_Time_TickCountGet(moduleContext->DmfModuleTime);
+        for (ULONG itemIndex = 0; itemIndex < BENCHMARK_ITEM_COUNT; itemIndex++)
+        {
+            ntStatus = DMF_RingBuffer_Write(dmfModuleRingBuffer,
+                                            item,
+                                            sizeof(item));
+            DmfAssert(NT_SUCCESS(ntStatus));
+        }
+        ntStatus = DMF_Time_ElapsedTimeNanosecondsGet(moduleContext->DmfModuleTime,
+                                                      startTick,
+                                                      &elapsedNanoseconds);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+        writeNanoseconds += elapsedNanoseconds;
+
+        // Drain the Ring Buffer.
+        //
+        startTick = DMF_Time_TickCountGet(moduleContext->DmfModuleTime);
+        for (ULONG itemIndex = 0; itemIndex < BENCHMARK_ITEM_COUNT; itemIndex++)
+        {
+            ntStatus = DMF_RingBuffer_Read(dmfModuleRingBuffer,
+                                           item,
+                                           sizeof(item));
+            DmfAssert(NT_SUCCESS(ntStatus));
+        }
+        ntStatus = DMF_Time_ElapsedTimeNanosecondsGet(moduleContext->DmfModuleTime,
+                                                      startTick,
+                                                      &elapsedNanoseconds);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+        readNanoseconds += elapsedNanoseconds;
+
+        // Fill the Ring Buffer building each item in place.
+        //
+        startTick = DMF_Time_TickCountGet(moduleContext->DmfModuleTime);
+        for (ULONG itemIndex = 0; itemIndex < BENCHMARK_ITEM_COUNT; itemIndex++)
+        {
+            ntStatus = DMF_RingBuffer_WriteReserve(dmfModuleRingBuffer,
+                                                   &ringBufferItem,
+                                                   &ringBufferItemSize);
+            DmfAssert(NT_SUCCESS(ntStatus));
+            DmfAssert(ringBufferItemSize == sizeof(item));
+            RtlCopyMemory(ringBufferItem,
+                          &itemIndex,
+                          sizeof(itemIndex));
+            DMF_RingBuffer_WriteCommit(dmfModuleRingBuffer);
+        }
+        ntStatus = DMF_Time_ElapsedTimeNanosecondsGet(moduleContext->DmfModuleTime,
+                                                      startTick,
+                                                      &elapsedNanoseconds);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+        reserveNanoseconds += elapsedNanoseconds;
+
+        // Drain the Ring Buffer consuming each item in place.
+        //
+        startTick = DMF_Time_TickCountGet(moduleContext->DmfModuleTime);
+        for (ULONG itemIndex = 0; itemIndex < BENCHMARK_ITEM_COUNT; itemIndex++)
+        {
+            ntStatus = DMF_RingBuffer_ReadPeek(dmfModuleRingBuffer,
+                                               &ringBufferItem,
+                                               &ringBufferItemSize);
+            DmfAssert(NT_SUCCESS(ntStatus));
+            DmfAssert(*(ULONG*)ringBufferItem == itemIndex);
+            DMF_RingBuffer_ReadRelease(dmfModuleRingBuffer,
+                                       TRUE);
+        }
+        ntStatus = DMF_Time_ElapsedTimeNanosecondsGet(moduleContext->DmfModuleTime,
+                                                      startTick,
+                                                      &elapsedNanoseconds);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+        peekNanoseconds += elapsedNanoseconds;
+
+        // Fill the Ring Buffer several items at a time.
+        //
+        startTick = DMF_Time_TickCountGet(moduleContext->DmfModuleTime);
+        for (ULONG itemIndex = 0; itemIndex < BENCHMARK_ITEM_COUNT; itemIndex += BENCHMARK_BATCH_ITEM_COUNT)
+        {
+            ntStatus = DMF_RingBuffer_WriteMultiple(dmfModuleRingBuffer,
+                                                    batch,
+                                                    BENCHMARK_BATCH_ITEM_COUNT * BENCHMARK_ITEM_SIZE,
+                                                    &itemsTransferred);
+            DmfAssert(NT_SUCCESS(ntStatus));
+            DmfAssert(BENCHMARK_BATCH_ITEM_COUNT == itemsTransferred);
+        }
+        ntStatus = DMF_Time_ElapsedTimeNanosecondsGet(moduleContext->DmfModuleTime,
+                                                      startTick,
+                                                      &elapsedNanoseconds);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+        writeMultipleNanoseconds += elapsedNanoseconds;
+
+        // Drain the Ring Buffer several items at a time.
+        //
+        startTick = DMF_Time_TickCountGet(moduleContext->DmfModuleTime);
+        for (ULONG itemIndex = 0; itemIndex < BENCHMARK_ITEM_COUNT; itemIndex += BENCHMARK_BATCH_ITEM_COUNT)
+        {
+            ntStatus = DMF_RingBuffer_ReadMultiple(dmfModuleRingBuffer,
+                                                   batch,
+                                                   BENCHMARK_BATCH_ITEM_COUNT * BENCHMARK_ITEM_SIZE,
+                                                   &itemsTransferred);
+            DmfAssert(NT_SUCCESS(ntStatus));
+            DmfAssert(BENCHMARK_BATCH_ITEM_COUNT == itemsTransferred);
+        }
+        ntStatus = DMF_Time_ElapsedTimeNanosecondsGet(moduleContext->DmfModuleTime,
+                                                      startTick,
+                                                      &elapsedNanoseconds);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+        readMultipleNanoseconds += elapsedNanoseconds;
+
+        operationCount += BENCHMARK_ITEM_COUNT;
+    }
+
+    if (operationCount > 0)
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                    "Benchmark: itemSize=%u operations=%u writeNs=%lld (%lld ns/op) readNs=%lld (%lld ns/op)",
+                    BENCHMARK_ITEM_SIZE,
+                    operationCount,
+                    writeNanoseconds,
+                    writeNanoseconds / operationCount,
+                    readNanoseconds,
+                    readNanoseconds / operationCount);
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                    "Benchmark: itemSize=%u operations=%u reserveNs=%lld (%lld ns/op) peekNs=%lld (%lld ns/op)",
+                    BENCHMARK_ITEM_SIZE,
+                    operationCount,
+                    reserveNanoseconds,
+                    reserveNanoseconds / operationCount,
+                    peekNanoseconds,
+                    peekNanoseconds / operationCount);
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                    "Benchmark: itemSize=%u operations=%u batch=%u writeMultipleNs=%lld (%lld ns/op) readMultipleNs=%lld (%lld ns/op)",
+                    BENCHMARK_ITEM_SIZE,
+                    operationCount,
+                    BENCHMARK_BATCH_ITEM_COUNT,
+                    writeMultipleNanoseconds,
+                    writeMultipleNanoseconds / operationCount,
+                    readMultipleNanoseconds,
+                    readMultipleNanoseconds / operationCount);
+    }
+
+Exit:
+
+    if (batchMemory != NULL)
+    {
+        WdfObjectDelete(batchMemory);
+    }
+
+    if (dmfModuleRingBuffer != NULL)
+    {
+        WdfObjectDelete(dmfModuleRingBuffer);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+Tests_RingBuffer_ReorderPass(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device,
+    _In_ ULONG RingBufferSize
+    )
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer;
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    ENUM_CONTEXT_Tests_RingBuffer_VariableSize enumContext;
+    UCHAR item[BENCHMARK_REORDER_ITEM_SIZE];
+    UCHAR* ringBufferItem;
+    ULONG ringBufferItemSize;
+    ULONG itemCount;
+    ULONG itemsToWrite;
+    ULONG itemIndex;
+    LONGLONG startTick;
+    LONGLONG reorderNanoseconds;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleRingBuffer = NULL;
+    itemCount = RingBufferSize / BENCHMARK_REORDER_ITEM_SIZE;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                              &moduleAttributes);
+    moduleConfigRingBuffer.ItemCount = itemCount;
+    moduleConfigRingBuffer.ItemSize = BENCHMARK_REORDER_ITEM_SIZE;
+    moduleConfigRingBuffer.Mode = RingBuffer_Mode_DeleteOldestIfFullOnWrite;
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleRingBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
+
+    // Overfill the Ring Buffer so that the oldest item is about a third of the way in
+    // and the items wrap around. Each item starts with its index.
+    //
+    TestsUtility_FillWithSequentialData(item,
+                                        sizeof(item));
+    itemsToWrite = itemCount + (itemCount / 3);
+    for (itemIndex = 0; itemIndex < itemsToWrite && (! DMF_Thread_IsStopPending(moduleContext->DmfModuleThread)); itemIndex++)
+    {
+        RtlCopyMemory(item,
+                      &itemIndex,
+                      sizeof(itemIndex));
+        ntStatus = DMF_RingBuffer_Write(dmfModuleRingBuffer,
+                                        item,
+                                        sizeof(item));
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+    if (itemIndex < itemsToWrite)
+    {
+        // Driver is stopping.
+        //
+        goto Exit;
+    }
+
+    startTick = DMF_Time_TickCountGet(moduleContext->DmfModuleTime);
+    DMF_RingBuffer_Reorder(dmfModuleRingBuffer,
+                           TRUE);
+    ntStatus = DMF_Time_ElapsedTimeNanosecondsGet(moduleContext->DmfModuleTime,
+                                                  startTick,
+                                                  &reorderNanoseconds);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    // All the items are still present and the oldest one is now first.
+    //
+    enumContext.ItemIndexExpected = 0;
+    enumContext.ItemsFound = 0;
+    DMF_RingBuffer_Enumerate(dmfModuleRingBuffer,
+                             TRUE,
+                             Tests_RingBuffer_EnumerationCount,
+                             &enumContext);
+    DmfAssert(enumContext.ItemsFound == itemCount);
+    ntStatus = DMF_RingBuffer_ReadPeek(dmfModuleRingBuffer,
+                                       &ringBufferItem,
+                                       &ringBufferItemSize);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(FALSE);
+        goto Exit;
+    }
+    DmfAssert(ringBufferItemSize == sizeof(item));
+    DmfAssert(*(ULONG*)ringBufferItem == itemsToWrite - itemCount);
+    DMF_RingBuffer_ReadRelease(dmfModuleRingBuffer,
+                               FALSE);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                "Benchmark: ringBufferSize=%u itemSize=%u items=%u reorderNs=%lld",
+                RingBufferSize,
+                BENCHMARK_REORDER_ITEM_SIZE,
+                itemCount,
+                reorderNanoseconds);
+
+Exit:
+
+    if (dmfModuleRingBuffer != NULL)
+    {
+        WdfObjectDelete(dmfModuleRingBuffer);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+Tests_RingBuffer_BenchmarkReorder(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
+    )
+{
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    ntStatus = Tests_RingBuffer_ReorderPass(DmfModule,
+                                            Device,
+                                            BENCHMARK_REORDER_SMALL_SIZE);
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_ReorderPass(DmfModule,
+                                                Device,
+                                                BENCHMARK_REORDER_LARGE_SIZE);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+Tests_RingBuffer_CrossCorePass(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device,
+    _In_ RingBuffer_SynchronizationType Synchronization,
+    _Out_ LONGLONG* ElapsedNanoseconds
+    )
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer;
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    UCHAR item[BENCHMARK_ITEM_SIZE];
+    LONGLONG startTick;
+    ULONG itemIndex;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleRingBuffer = NULL;
+    *ElapsedNanoseconds = 0;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                              &moduleAttributes);
+    moduleConfigRingBuffer.ItemCount = BENCHMARK_ITEM_COUNT;
+    moduleConfigRingBuffer.ItemSize = BENCHMARK_ITEM_SIZE;
+    moduleConfigRingBuffer.Mode = RingBuffer_Mode_FailIfFullOnWrite;
+    moduleConfigRingBuffer.Synchronization = Synchronization;
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleRingBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
+
+    RtlZeroMemory(item,
+                  sizeof(item));
+
+    moduleContext->DmfModuleRingBufferCrossCore = dmfModuleRingBuffer;
+    InterlockedExchange(&moduleContext->ProducerStopped,
+                        FALSE);
+
+    // This thread is the producer. The consumer thread starts reading now.
+    //
+    startTick = DMF_Time_TickCountGet(moduleContext->DmfModuleTime);
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThreadConsumer);
+
+    itemIndex = 0;
+    while (itemIndex < BENCHMARK_CROSS_CORE_ITEM_COUNT)
+    {
+        RtlCopyMemory(item,
+                      &itemIndex,
+                      sizeof(itemIndex));
+        ntStatus = DMF_RingBuffer_Write(dmfModuleRingBuffer,
+                                        item,
+                                        sizeof(item));
+        if (NT_SUCCESS(ntStatus))
+        {
+            itemIndex++;
+            continue;
+        }
+
+        // The Ring Buffer is full. Wait for the consumer unless the driver is stopping.
+        //
+        if (DMF_Thread_IsStopPending(moduleContext->DmfModuleThread))
+        {
+            InterlockedExchange(&moduleContext->ProducerStopped,
+                                TRUE);
+            break;
+        }
+        YieldProcessor();
+    }
+
+    DMF_Portable_EventWaitForSingleObject(&moduleContext->ConsumerDoneEvent,
+                                          NULL,
+                                          FALSE);
+
+    ntStatus = DMF_Time_ElapsedTimeNanosecondsGet(moduleContext->DmfModuleTime,
+                                                  startTick,
+                                                  ElapsedNanoseconds);
+
+    moduleContext->DmfModuleRingBufferCrossCore = NULL;
+
+Exit:
+
+    if (dmfModuleRingBuffer != NULL)
+    {
+        WdfObjectDelete(dmfModuleRingBuffer);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+Tests_RingBuffer_BenchmarkCrossCore(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
+    )
+{
+    NTSTATUS ntStatus;
+    LONGLONG lockNanoseconds;
+    LONGLONG lockFreeNanoseconds;
+
+    PAGED_CODE();
+
+    // Transfer the same items from this thread to the consumer thread using the
+    // Module lock and then using the lock free single producer/single consumer indexes.
+    //
+    ntStatus = Tests_RingBuffer_CrossCorePass(DmfModule,
+                                              Device,
+                                              RingBuffer_Synchronization_Lock,
+                                              &lockNanoseconds);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    ntStatus = Tests_RingBuffer_CrossCorePass(DmfModule,
+                                              Device,
+                                              RingBuffer_Synchronization_SingleProducerSingleConsumer,
+                                              &lockFreeNanoseconds);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                "Benchmark: cross-core itemSize=%u items=%u lockNs=%lld (%lld ns/item) lockFreeNs=%lld (%lld ns/item)",
+                BENCHMARK_ITEM_SIZE,
+                BENCHMARK_CROSS_CORE_ITEM_COUNT,
+                lockNanoseconds,
+                lockNanoseconds / BENCHMARK_CROSS_CORE_ITEM_COUNT,
+                lockFreeNanoseconds,
+                lockFreeNanoseconds / BENCHMARK_CROSS_CORE_ITEM_COUNT);
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_RingBuffer_ConsumerThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    UCHAR item[BENCHMARK_ITEM_SIZE];
+    ULONG itemIndex;
+    ULONG itemValue;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    DmfAssert(moduleContext->DmfModuleRingBufferCrossCore != NULL);
+
+    itemIndex = 0;
+    while (itemIndex < BENCHMARK_CROSS_CORE_ITEM_COUNT)
+    {
+        ntStatus = DMF_RingBuffer_Read(moduleContext->DmfModuleRingBufferCrossCore,
+                                       item,
+                                       sizeof(item));
+        if (NT_SUCCESS(ntStatus))
+        {
+            // Items must arrive in the order they were written.
+            //
+            RtlCopyMemory(&itemValue,
+                          item,
+                          sizeof(itemValue));
+            DmfAssert(itemValue == itemIndex);
+            itemIndex++;
+            continue;
+        }
+
+        // The Ring Buffer is empty. Wait for the producer unless it has stopped.
+        //
+        if (moduleContext->ProducerStopped ||
+            DMF_Thread_IsStopPending(DmfModuleThread))
+        {
+            break;
+        }
+        YieldProcessor();
+    }
+
+    DMF_Portable_EventSet(&moduleContext->ConsumerDoneEvent);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_RingBuffer_ProducerThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    ITEM_Tests_RingBuffer_MultipleProducer item;
+    ULONG writerIndex;
+    ULONG sequence;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    DmfAssert(moduleContext->DmfModuleRingBufferMultipleProducer != NULL);
+
+    for (writerIndex = 0; writerIndex < MULTIPLE_PRODUCER_WRITER_COUNT; writerIndex++)
+    {
+        if (moduleContext->DmfModuleThreadProducer[writerIndex] == DmfModuleThread)
+        {
+            break;
+        }
+    }
+    DmfAssert(writerIndex < MULTIPLE_PRODUCER_WRITER_COUNT);
+
+    // Writing never fails in this mode so the work thread never waits long for this loop.
+    //
+    for (sequence = 0; sequence < MULTIPLE_PRODUCER_ITEMS_PER_WRITER; sequence++)
+    {
+        Tests_RingBuffer_MultipleProducerItemBuild(writerIndex,
+                                                   sequence,
+                                                   &item);
+        ntStatus = DMF_RingBuffer_Write(moduleContext->DmfModuleRingBufferMultipleProducer,
+                                        (UCHAR*)&item,
+                                        sizeof(item));
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+
+    InterlockedDecrement(&moduleContext->ProducersRunning);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_RingBuffer_WorkThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    WDFDEVICE device;
+    ULONG itemCountMax;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+    device = DMF_ParentDeviceGet(dmfModule);
+
+    itemCountMax = TestsUtility_GenerateRandomNumber(4, 
+                                                     ITEM_COUNT_MAX);
+
+    ntStatus = Tests_RingBuffer_RunTests(dmfModule,
+                                         device, 
+                                         itemCountMax);
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_RunTestsVariableSize(dmfModule,
+                                                         device);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_RunTestsMultipleItems(dmfModule,
+                                                          device,
+                                                          RingBuffer_Mode_FailIfFullOnWrite,
+                                                          RingBuffer_Synchronization_Lock);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_RunTestsMultipleItems(dmfModule,
+                                                          device,
+                                                          RingBuffer_Mode_FailIfFullOnWrite,
+                                                          RingBuffer_Synchronization_SingleProducerSingleConsumer);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_RunTestsMultipleItems(dmfModule,
+                                                          device,
+                                                          RingBuffer_Mode_DeleteOldestIfFullOnWrite,
+                                                          RingBuffer_Synchronization_Lock);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_RunTestsMultipleItems(dmfModule,
+                                                          device,
+                                                          RingBuffer_Mode_DeleteOldestIfFullOnWrite,
+                                                          RingBuffer_Synchronization_MultipleProducerOverwrite);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_RunTestsMultipleProducer(dmfModule,
+                                                             device);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_RunTestsMultipleProducerConcurrent(dmfModule,
+                                                                       device,
+                                                                       MULTIPLE_PRODUCER_RACE_ITEM_COUNT_LARGE);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_RunTestsMultipleProducerConcurrent(dmfModule,
+                                                                       device,
+                                                                       MULTIPLE_PRODUCER_RACE_ITEM_COUNT_SMALL);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_RunTestsKeyIndex(dmfModule,
+                                                     device);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_Benchmark(dmfModule,
+                                              device);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_BenchmarkReorder(dmfModule,
+                                                     device);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_RingBuffer_BenchmarkCrossCore(dmfModule,
+                                                       device);
+    }
+
+    // Repeat the test, until stop is signaled or the function stopped because the
+    // driver is stopping.
+    //
+    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+        (NT_SUCCESS(ntStatus)))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_RingBuffer_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_RingBuffer.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    ULONG writerIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = DMF_Portable_EventCreate(&moduleContext->ConsumerDoneEvent,
+                                        SynchronizationEvent,
+                                        FALSE);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    // Start the thread that reads during cross-core benchmark passes. It only
+    // runs when the work thread tells it to.
+    //
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadConsumer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        DMF_Portable_EventClose(&moduleContext->ConsumerDoneEvent);
+        goto Exit;
+    }
+
+    // Start the threads that write during multiple producer tests. They only
+    // run when the work thread tells them to.
+    //
+    for (writerIndex = 0; writerIndex < MULTIPLE_PRODUCER_WRITER_COUNT; writerIndex++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadProducer[writerIndex]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            while (writerIndex > 0)
+            {
+                writerIndex--;
+                DMF_Thread_Stop(moduleContext->DmfModuleThreadProducer[writerIndex]);
+            }
+            DMF_Thread_Stop(moduleContext->DmfModuleThreadConsumer);
+            DMF_Portable_EventClose(&moduleContext->ConsumerDoneEvent);
+            goto Exit;
+        }
+    }
+
+    // Start the thread.
+    //
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread);
+
+    // Tell the thread it has work to do.
+    //
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThread);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_RingBuffer_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Close an instance of a DMF Module of type Test_RingBuffer.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    ULONG writerIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Stop the work thread first. It may be waiting for the consumer or producer threads.
+    //
+    DMF_Thread_Stop(moduleContext->DmfModuleThread);
+    DMF_Thread_Stop(moduleContext->DmfModuleThreadConsumer);
+    for (writerIndex = 0; writerIndex < MULTIPLE_PRODUCER_WRITER_COUNT; writerIndex++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadProducer[writerIndex]);
+    }
+    DMF_Portable_EventClose(&moduleContext->ConsumerDoneEvent);
+
+    FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
 
@@ -492,6 +2450,7 @@ Return Value:
     DMF_MODULE_ATTRIBUTES moduleAttributes;
     DMF_CONTEXT_Tests_RingBuffer* moduleContext;
     DMF_CONFIG_Thread moduleConfigThread;
+    ULONG writerIndex;
 
     UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
 
@@ -510,6 +2469,36 @@ Return Value:
                      WDF_NO_OBJECT_ATTRIBUTES,
                      &moduleContext->DmfModuleThread);
 
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_RingBuffer_ConsumerThread;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadConsumer);
+
+    for (writerIndex = 0; writerIndex < MULTIPLE_PRODUCER_WRITER_COUNT; writerIndex++)
+    {
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_RingBuffer_ProducerThread;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadProducer[writerIndex]);
+    }
+
+    // Time
+    // ----
+    //
+    DMF_Time_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleTime);
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -0,0 +1,1740 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_ThreadedBufferQueue.c
+
+Abstract:
+
+    Functional tests for Dmf_ThreadedBufferQueue Module.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+#include "DmfModules.Library.Tests.Trace.h"
+
+#if defined(DMF_INCLUDE_TMH)
+#include "Dmf_Tests_ThreadedBufferQueue.tmh"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Number of work buffers of the Threaded Buffer Queue under test.
+//
+#define BUFFER_COUNT                        (32)
+// Number of threads that enqueue work and wait for it to be done.
+//
+#define WAITER_COUNT                        (3)
+// Number of times each of those threads enqueues work while the work thread flushes.
+//
+#define WAITER_ITERATIONS_FLUSH_RACE        (256)
+// Number of times the only buffer of a Threaded Buffer Queue is enqueued.
+//
+#define SAME_BUFFER_ITERATIONS              (64)
+// Number of fire-and-forget work buffers pending with the waiters' work buffers when they are flushed.
+//
+#define FLUSH_FIRE_AND_FORGET_COUNT         (8)
+// Number of worker threads of the Threaded Buffer Queue that has several of them.
+//
+#define WORKER_COUNT                        (4)
+// Number of keys work is enqueued with on that Threaded Buffer Queue.
+//
+#define KEY_COUNT                           (8)
+// ITEM_Tests_ThreadedBufferQueue.Key of work enqueued without a key.
+//
+#define KEY_NONE                            (KEY_COUNT)
+// Number of work buffers enqueued to that Threaded Buffer Queue in each test.
+//
+#define MULTIPLE_WORKERS_ITERATIONS         (512)
+// Number of work buffers of the Threaded Buffer Queue that does work in batches.
+//
+#define BATCH_BUFFER_COUNT                  (3 * ThreadedBufferQueue_WorkBatchSizeMaximum)
+// Number of fire-and-forget work buffers pending with the waiters' work buffers when its worker thread starts.
+// Together, they make two full batches.
+//
+#define BATCH_FIRE_AND_FORGET_COUNT         (2 * ThreadedBufferQueue_WorkBatchSizeMaximum - WAITER_COUNT)
+// Number of batches pended before they are all completed at once.
+//
+#define BATCH_PENDED_ROUNDS                 (3)
+// Number of work buffers in each of them.
+//
+#define BATCH_PENDED_PER_ROUND              (ThreadedBufferQueue_WorkBatchSizeMaximum - 2)
+// Index of the work thread in ITEM_Tests_ThreadedBufferQueue.ProducerIndex.
+//
+#define PRODUCER_INDEX_WORK_THREAD          (WAITER_COUNT)
+// Status of the work of a given item. It is never STATUS_PENDING or STATUS_CANCELLED so that
+// a wait that returns a stale or cancelled status is detected.
+//
+#define ITEM_NTSTATUS(ProducerIndex, Sequence)  ((NTSTATUS)(0x20000000 | ((ProducerIndex) << 16) | ((Sequence) & 0xFFFF)))
+
+typedef struct
+{
+    // Thread that enqueued the work (PRODUCER_INDEX_WORK_THREAD for the work thread).
+    //
+    ULONG ProducerIndex;
+    // Sequence number of the work for that thread.
+    //
+    ULONG Sequence;
+    // Status the work callback sets for the work.
+    //
+    NTSTATUS NtStatus;
+    // Key the work is enqueued with (KEY_NONE if none).
+    //
+    ULONG Key;
+    // Sequence number of the work for that key.
+    //
+    ULONG KeySequence;
+} ITEM_Tests_ThreadedBufferQueue;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct _DMF_CONTEXT_Tests_ThreadedBufferQueue
+{
+    // Thread that executes tests.
+    //
+    DMFMODULE DmfModuleThread;
+    // Threaded Buffer Queue Module to test. Its buffers are allocated from paged pool.
+    //
+    DMFMODULE DmfModuleThreadedBufferQueue;
+    // Threaded Buffer Queue Module to test that has a single buffer so that the same buffer
+    // is enqueued every time.
+    //
+    DMFMODULE DmfModuleThreadedBufferQueueSingleBuffer;
+    // Threaded Buffer Queue Module to test that has several worker threads.
+    //
+    DMFMODULE DmfModuleThreadedBufferQueueMultipleWorkers;
+    // Threaded Buffer Queue Module to test that does work in batches.
+    //
+    DMFMODULE DmfModuleThreadedBufferQueueBatch;
+    // Threads that enqueue work and wait for it to be done while the work thread runs tests.
+    //
+    DMFMODULE DmfModuleThreadWaiter[WAITER_COUNT];
+    // Threaded Buffer Queue they enqueue work to.
+    //
+    DMFMODULE DmfModuleThreadedBufferQueueWaiter;
+    // Number of times each of them enqueues work.
+    //
+    ULONG WaiterIterations;
+    // Number of them that are still enqueuing work.
+    //
+    volatile LONG WaitersRunning;
+    // Number of their waits that returned the status set by the work callback.
+    //
+    volatile LONG WaitsCompleted;
+    // Number of their waits that returned STATUS_CANCELLED because the work was flushed.
+    //
+    volatile LONG WaitsCancelled;
+    // Number of work buffers the work callback has been called for.
+    //
+    volatile LONG WorkDone;
+    // Number of worker threads doing work with each key.
+    //
+    volatile LONG KeyBusy[KEY_COUNT];
+    // Sequence number of the last work enqueued with each key.
+    //
+    ULONG KeySequenceEnqueued[KEY_COUNT];
+    // Sequence number of the last work done with each key.
+    //
+    volatile ULONG KeySequenceDone[KEY_COUNT];
+    // Number of times the batch callback has been called.
+    //
+    volatile LONG BatchCallbacks;
+    // Largest number of work buffers passed to the batch callback.
+    //
+    ULONG BatchSizeLargest;
+    // Indicates that the batch callback pends the work buffers instead of completing them.
+    //
+    volatile BOOLEAN BatchPend;
+    // Work buffers it has pended.
+    //
+    VOID* BatchPendedBuffers[BATCH_BUFFER_COUNT];
+    ULONG BatchPendedCount;
+} DMF_CONTEXT_Tests_ThreadedBufferQueue;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(Tests_ThreadedBufferQueue)
+
+// This Module has no Config.
+//
+DMF_MODULE_DECLARE_NO_CONFIG(Tests_ThreadedBufferQueue)
+
+// Memory Pool Tag.
+//
+#define MemoryTag 'QBTT'
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_ThreadedBufferQueue_Callback)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_same_
+_Must_inspect_result_
+static
+ThreadedBufferQueue_BufferDisposition
+Tests_ThreadedBufferQueue_WorkCallback(
+    _In_ DMFMODULE DmfModule,
+    _In_ UCHAR* ClientWorkBuffer,
+    _In_ ULONG ClientWorkBufferSize,
+    _In_ VOID* ClientWorkBufferContext,
+    _Out_ NTSTATUS* NtStatus
+    )
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    ITEM_Tests_ThreadedBufferQueue* item;
+
+    UNREFERENCED_PARAMETER(ClientWorkBufferContext);
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DMF_ParentModuleGet(DmfModule));
+
+    DmfAssert(sizeof(ITEM_Tests_ThreadedBufferQueue) == ClientWorkBufferSize);
+    item = (ITEM_Tests_ThreadedBufferQueue*)ClientWorkBuffer;
+    DmfAssert(item->ProducerIndex <= PRODUCER_INDEX_WORK_THREAD);
+
+    InterlockedIncrement(&moduleContext->WorkDone);
+
+    *NtStatus = item->NtStatus;
+
+    return ThreadedBufferQueue_BufferDisposition_WorkComplete;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_ThreadedBufferQueue_Callback)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_same_
+_Must_inspect_result_
+static
+ThreadedBufferQueue_BufferDisposition
+Tests_ThreadedBufferQueue_WorkCallbackMultipleWorkers(
+    _In_ DMFMODULE DmfModule,
+    _In_ UCHAR* ClientWorkBuffer,
+    _In_ ULONG ClientWorkBufferSize,
+    _In_ VOID* ClientWorkBufferContext,
+    _Out_ NTSTATUS* NtStatus
+    )
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    ITEM_Tests_ThreadedBufferQueue* item;
+    LONG keyBusy;
+
+    UNREFERENCED_PARAMETER(ClientWorkBufferContext);
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DMF_ParentModuleGet(DmfModule));
+
+    DmfAssert(sizeof(ITEM_Tests_ThreadedBufferQueue) == ClientWorkBufferSize);
+    item = (ITEM_Tests_ThreadedBufferQueue*)ClientWorkBuffer;
+    DmfAssert(item->Key <= KEY_NONE);
+
+    if (item->Key != KEY_NONE)
+    {
+        // No other worker thread does work with the same key at the same time...
+        //
+        keyBusy = InterlockedIncrement(&moduleContext->KeyBusy[item->Key]);
+        DmfAssert(1 == keyBusy);
+
+        // ...and work with the same key is done in the order it was enqueued. (Flushed
+        // work is never done so there may be gaps.)
+        //
+        DmfAssert(item->KeySequence > moduleContext->KeySequenceDone[item->Key]);
+        moduleContext->KeySequenceDone[item->Key] = item->KeySequence;
+
+        // Give the other worker threads a chance to pick up work with the same key.
+        //
+        TestsUtility_YieldExecution();
+
+        InterlockedDecrement(&moduleContext->KeyBusy[item->Key]);
+    }
+
+    InterlockedIncrement(&moduleContext->WorkDone);
+
+    *NtStatus = item->NtStatus;
+
+    return ThreadedBufferQueue_BufferDisposition_WorkComplete;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_ThreadedBufferQueue_BatchCallback)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_same_
+_Must_inspect_result_
+static
+ThreadedBufferQueue_BufferDisposition
+Tests_ThreadedBufferQueue_WorkCallbackBatch(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfClientWorkBuffers) UCHAR** ClientWorkBuffers,
+    _In_reads_(NumberOfClientWorkBuffers) VOID** ClientWorkBufferContexts,
+    _In_ ULONG NumberOfClientWorkBuffers,
+    _In_ ULONG ClientWorkBufferSize,
+    _Out_writes_(NumberOfClientWorkBuffers) NTSTATUS* NtStatuses
+    )
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    ITEM_Tests_ThreadedBufferQueue* item;
+    ThreadedBufferQueue_BufferDisposition bufferDisposition;
+    ULONG clientWorkBufferIndex;
+
+    UNREFERENCED_PARAMETER(ClientWorkBufferContexts);
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DMF_ParentModuleGet(DmfModule));
+
+    DmfAssert(sizeof(ITEM_Tests_ThreadedBufferQueue) == ClientWorkBufferSize);
+    DmfAssert(NumberOfClientWorkBuffers > 0);
+    DmfAssert(NumberOfClientWorkBuffers <= ThreadedBufferQueue_WorkBatchSizeMaximum);
+
+    // There is a single worker thread.
+    //
+    if (NumberOfClientWorkBuffers > moduleContext->BatchSizeLargest)
+    {
+        moduleContext->BatchSizeLargest = NumberOfClientWorkBuffers;
+    }
+
+    for (clientWorkBufferIndex = 0; clientWorkBufferIndex < NumberOfClientWorkBuffers; clientWorkBufferIndex++)
+    {
+        item = (ITEM_Tests_ThreadedBufferQueue*)ClientWorkBuffers[clientWorkBufferIndex];
+        DmfAssert(item->ProducerIndex <= PRODUCER_INDEX_WORK_THREAD);
+        DmfAssert(STATUS_SUCCESS == NtStatuses[clientWorkBufferIndex]);
+
+        if (moduleContext->BatchPend)
+        {
+            // The work thread completes the buffer later.
+            //
+            DmfAssert(moduleContext->BatchPendedCount < BATCH_BUFFER_COUNT);
+            moduleContext->BatchPendedBuffers[moduleContext->BatchPendedCount] = ClientWorkBuffers[clientWorkBufferIndex];
+            moduleContext->BatchPendedCount++;
+        }
+        else
+        {
+            NtStatuses[clientWorkBufferIndex] = item->NtStatus;
+        }
+    }
+
+    if (moduleContext->BatchPend)
+    {
+        bufferDisposition = ThreadedBufferQueue_BufferDisposition_WorkPending;
+    }
+    else
+    {
+        bufferDisposition = ThreadedBufferQueue_BufferDisposition_WorkComplete;
+    }
+
+    InterlockedExchangeAdd(&moduleContext->WorkDone,
+                           (LONG)NumberOfClientWorkBuffers);
+    InterlockedIncrement(&moduleContext->BatchCallbacks);
+
+    return bufferDisposition;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_ThreadedBufferQueue_BuffersAvailableVerify(
+    _In_ DMFMODULE DmfModuleThreadedBufferQueue,
+    _In_ ULONG BufferCount
+    )
+{
+    NTSTATUS ntStatus;
+    VOID* clientBuffers[BATCH_BUFFER_COUNT];
+    VOID* clientBuffer;
+    ULONG numberOfClientBuffers;
+    ULONG clientBufferIndex;
+
+    PAGED_CODE();
+
+    DmfAssert(BufferCount <= BATCH_BUFFER_COUNT);
+
+    // Every buffer must have been returned to the Producer List...
+    //
+    numberOfClientBuffers = 0;
+    while (numberOfClientBuffers < BufferCount)
+    {
+        ntStatus = DMF_ThreadedBufferQueue_Fetch(DmfModuleThreadedBufferQueue,
+                                                 &clientBuffers[numberOfClientBuffers],
+                                                 NULL);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            break;
+        }
+        numberOfClientBuffers++;
+    }
+    DmfAssert(BufferCount == numberOfClientBuffers);
+
+    // ...exactly once.
+    //
+    ntStatus = DMF_ThreadedBufferQueue_Fetch(DmfModuleThreadedBufferQueue,
+                                             &clientBuffer,
+                                             NULL);
+    DmfAssert(!NT_SUCCESS(ntStatus));
+    if (NT_SUCCESS(ntStatus))
+    {
+        DMF_ThreadedBufferQueue_Reuse(DmfModuleThreadedBufferQueue,
+                                      clientBuffer);
+    }
+
+    for (clientBufferIndex = 0; clientBufferIndex < numberOfClientBuffers; clientBufferIndex++)
+    {
+        DMF_ThreadedBufferQueue_Reuse(DmfModuleThreadedBufferQueue,
+                                      clientBuffers[clientBufferIndex]);
+    }
+}
+#pragma code_seg()
+
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_ThreadedBufferQueue_FireAndForget(
+    _In_ DMFMODULE DmfModuleThreadedBufferQueue,
+    _In_ ULONG Sequence
+    )
+{
+    NTSTATUS ntStatus;
+    VOID* clientBuffer;
+    ITEM_Tests_ThreadedBufferQueue* item;
+
+    ntStatus = DMF_ThreadedBufferQueue_Fetch(DmfModuleThreadedBufferQueue,
+                                             &clientBuffer,
+                                             NULL);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // All the buffers are in use.
+        //
+        goto Exit;
+    }
+
+    item = (ITEM_Tests_ThreadedBufferQueue*)clientBuffer;
+    item->ProducerIndex = PRODUCER_INDEX_WORK_THREAD;
+    item->Sequence = Sequence;
+    item->NtStatus = ITEM_NTSTATUS(PRODUCER_INDEX_WORK_THREAD,
+                                   Sequence);
+
+    DMF_ThreadedBufferQueue_Enqueue(DmfModuleThreadedBufferQueue,
+                                    clientBuffer);
+
+Exit:
+
+    return ntStatus;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_ThreadedBufferQueue_WaitersStart(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMFMODULE DmfModuleThreadedBufferQueue,
+    _In_ ULONG Iterations
+    )
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    ULONG waiterIndex;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    moduleContext->DmfModuleThreadedBufferQueueWaiter = DmfModuleThreadedBufferQueue;
+    moduleContext->WaiterIterations = Iterations;
+    InterlockedExchange(&moduleContext->WaitsCompleted,
+                        0);
+    InterlockedExchange(&moduleContext->WaitsCancelled,
+                        0);
+    InterlockedExchange(&moduleContext->WaitersRunning,
+                        WAITER_COUNT);
+    for (waiterIndex = 0; waiterIndex < WAITER_COUNT; waiterIndex++)
+    {
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadWaiter[waiterIndex]);
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_ThreadedBufferQueue_WaitersWait(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    while (InterlockedCompareExchange(&moduleContext->WaitersRunning,
+                                      0,
+                                      0) > 0)
+    {
+        TestsUtility_YieldExecution();
+    }
+
+    moduleContext->DmfModuleThreadedBufferQueueWaiter = NULL;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_ThreadedBufferQueue_RunTestsSameBuffer(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    DMFMODULE dmfModuleThreadedBufferQueue;
+    NTSTATUS ntStatus;
+    VOID* clientBuffer;
+    VOID* clientBufferFirst;
+    ITEM_Tests_ThreadedBufferQueue* item;
+    LONG workDone;
+    ULONG sequence;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleThreadedBufferQueue = moduleContext->DmfModuleThreadedBufferQueueSingleBuffer;
+
+    workDone = InterlockedCompareExchange(&moduleContext->WorkDone,
+                                          0,
+                                          0);
+    clientBufferFirst = NULL;
+
+    // Enqueue the only buffer in random ways so that fire-and-forget work is done with a buffer
+    // that a thread waited for just before and vice versa.
+    //
+    for (sequence = 0; sequence < SAME_BUFFER_ITERATIONS; sequence++)
+    {
+        // Fire-and-forget work may still be using the buffer.
+        //
+        for (;;)
+        {
+            ntStatus = DMF_ThreadedBufferQueue_Fetch(dmfModuleThreadedBufferQueue,
+                                                     &clientBuffer,
+                                                     NULL);
+            if (NT_SUCCESS(ntStatus))
+            {
+                break;
+            }
+            TestsUtility_YieldExecution();
+        }
+
+        if (NULL == clientBufferFirst)
+        {
+            clientBufferFirst = clientBuffer;
+        }
+        DmfAssert(clientBufferFirst == clientBuffer);
+
+        item = (ITEM_Tests_ThreadedBufferQueue*)clientBuffer;
+        item->ProducerIndex = PRODUCER_INDEX_WORK_THREAD;
+        item->Sequence = sequence;
+        item->NtStatus = ITEM_NTSTATUS(PRODUCER_INDEX_WORK_THREAD,
+                                       sequence);
+
+        switch (TestsUtility_GenerateRandomNumber(0,
+                                                  2))
+        {
+            case 0:
+            {
+                DMF_ThreadedBufferQueue_Enqueue(dmfModuleThreadedBufferQueue,
+                                                clientBuffer);
+                break;
+            }
+            case 1:
+            {
+                ntStatus = DMF_ThreadedBufferQueue_EnqueueAndWait(dmfModuleThreadedBufferQueue,
+                                                                  clientBuffer);
+                DmfAssert(ITEM_NTSTATUS(PRODUCER_INDEX_WORK_THREAD, sequence) == ntStatus);
+                break;
+            }
+            default:
+            {
+                ntStatus = DMF_ThreadedBufferQueue_EnqueueAtHeadAndWait(dmfModuleThreadedBufferQueue,
+                                                                        clientBuffer);
+                DmfAssert(ITEM_NTSTATUS(PRODUCER_INDEX_WORK_THREAD, sequence) == ntStatus);
+                break;
+            }
+        }
+    }
+
+    // The buffer of the last fire-and-forget work must come back too.
+    //
+    for (;;)
+    {
+        ntStatus = DMF_ThreadedBufferQueue_Fetch(dmfModuleThreadedBufferQueue,
+                                                 &clientBuffer,
+                                                 NULL);
+        if (NT_SUCCESS(ntStatus))
+        {
+            break;
+        }
+        TestsUtility_YieldExecution();
+    }
+    DMF_ThreadedBufferQueue_Reuse(dmfModuleThreadedBufferQueue,
+                                  clientBuffer);
+
+    DmfAssert(workDone + SAME_BUFFER_ITERATIONS == InterlockedCompareExchange(&moduleContext->WorkDone,
+                                                                              0,
+                                                                              0));
+
+    return STATUS_SUCCESS;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_ThreadedBufferQueue_RunTestsFlushWhileWaiting(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    DMFMODULE dmfModuleThreadedBufferQueue;
+    NTSTATUS ntStatus;
+    LONG workDone;
+    ULONG sequence;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleThreadedBufferQueue = moduleContext->DmfModuleThreadedBufferQueue;
+
+    // No work is done so that the waiters' work is still pending when it is flushed.
+    //
+    DMF_ThreadedBufferQueue_Stop(dmfModuleThreadedBufferQueue);
+
+    workDone = InterlockedCompareExchange(&moduleContext->WorkDone,
+                                          0,
+                                          0);
+
+    Tests_ThreadedBufferQueue_WaitersStart(DmfModule,
+                                           dmfModuleThreadedBufferQueue,
+                                           1);
+    while (DMF_ThreadedBufferQueue_Count(dmfModuleThreadedBufferQueue) < WAITER_COUNT)
+    {
+        TestsUtility_YieldExecution();
+    }
+
+    for (sequence = 0; sequence < FLUSH_FIRE_AND_FORGET_COUNT; sequence++)
+    {
+        ntStatus = Tests_ThreadedBufferQueue_FireAndForget(dmfModuleThreadedBufferQueue,
+                                                           sequence);
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+    DmfAssert(WAITER_COUNT + FLUSH_FIRE_AND_FORGET_COUNT == DMF_ThreadedBufferQueue_Count(dmfModuleThreadedBufferQueue));
+
+    // Every waiter is woken up with STATUS_CANCELLED and every buffer is returned.
+    //
+    DMF_ThreadedBufferQueue_Flush(dmfModuleThreadedBufferQueue);
+    DmfAssert(0 == DMF_ThreadedBufferQueue_Count(dmfModuleThreadedBufferQueue));
+
+    Tests_ThreadedBufferQueue_WaitersWait(DmfModule);
+    DmfAssert(WAITER_COUNT == moduleContext->WaitsCancelled);
+    DmfAssert(0 == moduleContext->WaitsCompleted);
+    DmfAssert(workDone == InterlockedCompareExchange(&moduleContext->WorkDone,
+                                                     0,
+                                                     0));
+
+    Tests_ThreadedBufferQueue_BuffersAvailableVerify(dmfModuleThreadedBufferQueue,
+                                                     BUFFER_COUNT);
+
+    ntStatus = DMF_ThreadedBufferQueue_Start(dmfModuleThreadedBufferQueue);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_ThreadedBufferQueue_RunTestsFlushRace(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    DMFMODULE dmfModuleThreadedBufferQueue;
+    NTSTATUS ntStatus;
+    ULONG sequence;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleThreadedBufferQueue = moduleContext->DmfModuleThreadedBufferQueue;
+
+    // Waiters enqueue work while this thread enqueues fire-and-forget work and flushes at random
+    // times. Each wait returns either the status of the work or STATUS_CANCELLED.
+    //
+    Tests_ThreadedBufferQueue_WaitersStart(DmfModule,
+                                           dmfModuleThreadedBufferQueue,
+                                           WAITER_ITERATIONS_FLUSH_RACE);
+    sequence = 0;
+    while (InterlockedCompareExchange(&moduleContext->WaitersRunning,
+                                      0,
+                                      0) > 0)
+    {
+        // It fails when waiters use all the buffers.
+        //
+        ntStatus = Tests_ThreadedBufferQueue_FireAndForget(dmfModuleThreadedBufferQueue,
+                                                           sequence);
+        if (0 == TestsUtility_GenerateRandomNumber(0,
+                                                   3))
+        {
+            DMF_ThreadedBufferQueue_Flush(dmfModuleThreadedBufferQueue);
+        }
+        TestsUtility_YieldExecution();
+        sequence++;
+    }
+    Tests_ThreadedBufferQueue_WaitersWait(DmfModule);
+    DmfAssert(WAITER_COUNT * WAITER_ITERATIONS_FLUSH_RACE == moduleContext->WaitsCompleted + moduleContext->WaitsCancelled);
+
+    // Let the work in progress finish and remove the fire-and-forget work not done yet.
+    // Then, every buffer must be back.
+    //
+    DMF_ThreadedBufferQueue_Stop(dmfModuleThreadedBufferQueue);
+    DMF_ThreadedBufferQueue_Flush(dmfModuleThreadedBufferQueue);
+    Tests_ThreadedBufferQueue_BuffersAvailableVerify(dmfModuleThreadedBufferQueue,
+                                                     BUFFER_COUNT);
+
+    ntStatus = DMF_ThreadedBufferQueue_Start(dmfModuleThreadedBufferQueue);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+static
+VOID
+Tests_ThreadedBufferQueue_KeyedItemPrepare(
+    _In_ DMF_CONTEXT_Tests_ThreadedBufferQueue* ModuleContext,
+    _Out_ ITEM_Tests_ThreadedBufferQueue* Item,
+    _In_ ULONG Sequence,
+    _In_ ULONG Key
+    )
+{
+    Item->ProducerIndex = PRODUCER_INDEX_WORK_THREAD;
+    Item->Sequence = Sequence;
+    Item->NtStatus = ITEM_NTSTATUS(PRODUCER_INDEX_WORK_THREAD,
+                                   Sequence);
+    Item->Key = Key;
+    if (Key != KEY_NONE)
+    {
+        ModuleContext->KeySequenceEnqueued[Key]++;
+        Item->KeySequence = ModuleContext->KeySequenceEnqueued[Key];
+    }
+    else
+    {
+        Item->KeySequence = 0;
+    }
+}
+
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_ThreadedBufferQueue_KeyedFireAndForget(
+    _In_ DMF_CONTEXT_Tests_ThreadedBufferQueue* ModuleContext,
+    _In_ ULONG Sequence
+    )
+{
+    NTSTATUS ntStatus;
+    VOID* clientBuffer;
+    ULONG key;
+
+    ntStatus = DMF_ThreadedBufferQueue_Fetch(ModuleContext->DmfModuleThreadedBufferQueueMultipleWorkers,
+                                             &clientBuffer,
+                                             NULL);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // All the buffers are in use.
+        //
+        goto Exit;
+    }
+
+    // Some work has no key. It may be done by any worker thread.
+    //
+    key = TestsUtility_GenerateRandomNumber(0,
+                                            KEY_NONE);
+    Tests_ThreadedBufferQueue_KeyedItemPrepare(ModuleContext,
+                                               (ITEM_Tests_ThreadedBufferQueue*)clientBuffer,
+                                               Sequence,
+                                               key);
+    if (key != KEY_NONE)
+    {
+        DMF_ThreadedBufferQueue_EnqueueWithKey(ModuleContext->DmfModuleThreadedBufferQueueMultipleWorkers,
+                                               clientBuffer,
+                                               key);
+    }
+    else
+    {
+        DMF_ThreadedBufferQueue_Enqueue(ModuleContext->DmfModuleThreadedBufferQueueMultipleWorkers,
+                                        clientBuffer);
+    }
+
+Exit:
+
+    return ntStatus;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_ThreadedBufferQueue_RunTestsMultipleWorkers(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    DMFMODULE dmfModuleThreadedBufferQueue;
+    NTSTATUS ntStatus;
+    VOID* clientBuffer;
+    LONG workDone;
+    LONG workEnqueued;
+    ULONG sequence;
+    ULONG key;
+    ULONG keyedWorkPending;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleThreadedBufferQueue = moduleContext->DmfModuleThreadedBufferQueueMultipleWorkers;
+
+    workDone = InterlockedCompareExchange(&moduleContext->WorkDone,
+                                          0,
+                                          0);
+    workEnqueued = 0;
+
+    for (sequence = 0; sequence < MULTIPLE_WORKERS_ITERATIONS; sequence++)
+    {
+        if (MULTIPLE_WORKERS_ITERATIONS / 2 == sequence)
+        {
+            // Stop the worker threads in the middle of a burst of work. The work
+            // they have not done yet stays pending: fill every remaining buffer and
+            // check that all the buffers are accounted for.
+            //
+            DMF_ThreadedBufferQueue_Stop(dmfModuleThreadedBufferQueue);
+            for (;;)
+            {
+                ntStatus = Tests_ThreadedBufferQueue_KeyedFireAndForget(moduleContext,
+                                                                        sequence);
+                if (!NT_SUCCESS(ntStatus))
+                {
+                    break;
+                }
+                workEnqueued++;
+            }
+            // Work with a key waits in its worker's list and is not counted.
+            //
+            keyedWorkPending = 0;
+            for (key = 0; key < KEY_COUNT; key++)
+            {
+                keyedWorkPending += moduleContext->KeySequenceEnqueued[key] - moduleContext->KeySequenceDone[key];
+            }
+            DmfAssert(BUFFER_COUNT == DMF_ThreadedBufferQueue_Count(dmfModuleThreadedBufferQueue) + keyedWorkPending);
+
+            ntStatus = DMF_ThreadedBufferQueue_Start(dmfModuleThreadedBufferQueue);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                goto Exit;
+            }
+        }
+
+        if (0 == TestsUtility_GenerateRandomNumber(0,
+                                                   7))
+        {
+            // Wait for work with a key. It is done after the work enqueued with that key before.
+            //
+            for (;;)
+            {
+                ntStatus = DMF_ThreadedBufferQueue_Fetch(dmfModuleThreadedBufferQueue,
+                                                         &clientBuffer,
+                                                         NULL);
+                if (NT_SUCCESS(ntStatus))
+                {
+                    break;
+                }
+                TestsUtility_YieldExecution();
+            }
+            key = TestsUtility_GenerateRandomNumber(0,
+                                                    KEY_COUNT - 1);
+            Tests_ThreadedBufferQueue_KeyedItemPrepare(moduleContext,
+                                                       (ITEM_Tests_ThreadedBufferQueue*)clientBuffer,
+                                                       sequence,
+                                                       key);
+            ntStatus = DMF_ThreadedBufferQueue_EnqueueWithKeyAndWait(dmfModuleThreadedBufferQueue,
+                                                                     clientBuffer,
+                                                                     key);
+            DmfAssert(ITEM_NTSTATUS(PRODUCER_INDEX_WORK_THREAD, sequence) == ntStatus);
+            DmfAssert(moduleContext->KeySequenceEnqueued[key] == moduleContext->KeySequenceDone[key]);
+        }
+        else
+        {
+            // It fails while all the buffers are in use.
+            //
+            for (;;)
+            {
+                ntStatus = Tests_ThreadedBufferQueue_KeyedFireAndForget(moduleContext,
+                                                                        sequence);
+                if (NT_SUCCESS(ntStatus))
+                {
+                    break;
+                }
+                TestsUtility_YieldExecution();
+            }
+        }
+        workEnqueued++;
+    }
+
+    // Every work buffer is done exactly once...
+    //
+    while (InterlockedCompareExchange(&moduleContext->WorkDone,
+                                      0,
+                                      0) - workDone < workEnqueued)
+    {
+        TestsUtility_YieldExecution();
+    }
+    DmfAssert(workDone + workEnqueued == moduleContext->WorkDone);
+
+    // ...including the last one of each key.
+    //
+    for (key = 0; key < KEY_COUNT; key++)
+    {
+        DmfAssert(moduleContext->KeySequenceEnqueued[key] == moduleContext->KeySequenceDone[key]);
+    }
+
+    // A worker thread may not have returned the last buffer yet.
+    //
+    DMF_ThreadedBufferQueue_Stop(dmfModuleThreadedBufferQueue);
+    DmfAssert(0 == DMF_ThreadedBufferQueue_Count(dmfModuleThreadedBufferQueue));
+    Tests_ThreadedBufferQueue_BuffersAvailableVerify(dmfModuleThreadedBufferQueue,
+                                                     BUFFER_COUNT);
+
+    ntStatus = DMF_ThreadedBufferQueue_Start(dmfModuleThreadedBufferQueue);
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_ThreadedBufferQueue_RunTestsMultipleWorkersFlush(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    DMFMODULE dmfModuleThreadedBufferQueue;
+    NTSTATUS ntStatus;
+    VOID* clientBuffer;
+    ULONG sequence;
+    ULONG key;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleThreadedBufferQueue = moduleContext->DmfModuleThreadedBufferQueueMultipleWorkers;
+
+    // Flush at random times while worker threads are doing work. The work callback
+    // checks that work with the same key is still done in order.
+    //
+    for (sequence = 0; sequence < MULTIPLE_WORKERS_ITERATIONS; sequence++)
+    {
+        // It fails when all the buffers are in use.
+        //
+        ntStatus = Tests_ThreadedBufferQueue_KeyedFireAndForget(moduleContext,
+                                                                sequence);
+        if (0 == TestsUtility_GenerateRandomNumber(0,
+                                                   15))
+        {
+            DMF_ThreadedBufferQueue_Flush(dmfModuleThreadedBufferQueue);
+        }
+    }
+
+    // Let the work in progress finish and remove the work not done yet.
+    // Then, every buffer must be back.
+    //
+    DMF_ThreadedBufferQueue_Stop(dmfModuleThreadedBufferQueue);
+    DMF_ThreadedBufferQueue_Flush(dmfModuleThreadedBufferQueue);
+    DmfAssert(0 == DMF_ThreadedBufferQueue_Count(dmfModuleThreadedBufferQueue));
+    Tests_ThreadedBufferQueue_BuffersAvailableVerify(dmfModuleThreadedBufferQueue,
+                                                     BUFFER_COUNT);
+
+    ntStatus = DMF_ThreadedBufferQueue_Start(dmfModuleThreadedBufferQueue);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    // Nothing flushed is left behind: work enqueued with each key after the flush is done.
+    //
+    for (key = 0; key < KEY_COUNT; key++)
+    {
+        ntStatus = DMF_ThreadedBufferQueue_Fetch(dmfModuleThreadedBufferQueue,
+                                                 &clientBuffer,
+                                                 NULL);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+        Tests_ThreadedBufferQueue_KeyedItemPrepare(moduleContext,
+                                                   (ITEM_Tests_ThreadedBufferQueue*)clientBuffer,
+                                                   sequence,
+                                                   key);
+        ntStatus = DMF_ThreadedBufferQueue_EnqueueWithKeyAndWait(dmfModuleThreadedBufferQueue,
+                                                                 clientBuffer,
+                                                                 key);
+        DmfAssert(ITEM_NTSTATUS(PRODUCER_INDEX_WORK_THREAD, sequence) == ntStatus);
+        DmfAssert(moduleContext->KeySequenceEnqueued[key] == moduleContext->KeySequenceDone[key]);
+        sequence++;
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_ThreadedBufferQueue_RunTestsBatch(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    DMFMODULE dmfModuleThreadedBufferQueue;
+    NTSTATUS ntStatus;
+    LONG workDone;
+    ULONG sequence;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleThreadedBufferQueue = moduleContext->DmfModuleThreadedBufferQueueBatch;
+
+    // Queue more work than fits in a batch before the worker thread looks at it.
+    //
+    DMF_ThreadedBufferQueue_Stop(dmfModuleThreadedBufferQueue);
+
+    workDone = InterlockedCompareExchange(&moduleContext->WorkDone,
+                                          0,
+                                          0);
+    moduleContext->BatchSizeLargest = 0;
+
+    Tests_ThreadedBufferQueue_WaitersStart(DmfModule,
+                                           dmfModuleThreadedBufferQueue,
+                                           1);
+    while (DMF_ThreadedBufferQueue_Count(dmfModuleThreadedBufferQueue) < WAITER_COUNT)
+    {
+        TestsUtility_YieldExecution();
+    }
+    for (sequence = 0; sequence < BATCH_FIRE_AND_FORGET_COUNT; sequence++)
+    {
+        ntStatus = Tests_ThreadedBufferQueue_FireAndForget(dmfModuleThreadedBufferQueue,
+                                                           sequence);
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+    DmfAssert(WAITER_COUNT + BATCH_FIRE_AND_FORGET_COUNT == DMF_ThreadedBufferQueue_Count(dmfModuleThreadedBufferQueue));
+
+    ntStatus = DMF_ThreadedBufferQueue_Start(dmfModuleThreadedBufferQueue);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    // Each waiter gets the status the batch callback set for its own buffer.
+    //
+    Tests_ThreadedBufferQueue_WaitersWait(DmfModule);
+    DmfAssert(WAITER_COUNT == moduleContext->WaitsCompleted);
+    DmfAssert(0 == moduleContext->WaitsCancelled);
+
+    while (InterlockedCompareExchange(&moduleContext->WorkDone,
+                                      0,
+                                      0) - workDone < WAITER_COUNT + BATCH_FIRE_AND_FORGET_COUNT)
+    {
+        TestsUtility_YieldExecution();
+    }
+    DmfAssert(workDone + WAITER_COUNT + BATCH_FIRE_AND_FORGET_COUNT == moduleContext->WorkDone);
+
+    // The work was split in full batches.
+    //
+    DmfAssert(ThreadedBufferQueue_WorkBatchSizeMaximum == moduleContext->BatchSizeLargest);
+
+    // The worker thread may not have returned the last batch yet.
+    //
+    DMF_ThreadedBufferQueue_Stop(dmfModuleThreadedBufferQueue);
+    Tests_ThreadedBufferQueue_BuffersAvailableVerify(dmfModuleThreadedBufferQueue,
+                                                     BATCH_BUFFER_COUNT);
+
+    ntStatus = DMF_ThreadedBufferQueue_Start(dmfModuleThreadedBufferQueue);
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_ThreadedBufferQueue_RunTestsBatchPended(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    DMFMODULE dmfModuleThreadedBufferQueue;
+    NTSTATUS ntStatus;
+    NTSTATUS ntStatuses[BATCH_BUFFER_COUNT];
+    VOID* clientBuffers[BATCH_BUFFER_COUNT];
+    ITEM_Tests_ThreadedBufferQueue* item;
+    LONG batchCallbacks;
+    ULONG round;
+    ULONG sequence;
+    ULONG clientBufferIndex;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleThreadedBufferQueue = moduleContext->DmfModuleThreadedBufferQueueBatch;
+
+    DMF_ThreadedBufferQueue_Stop(dmfModuleThreadedBufferQueue);
+
+    moduleContext->BatchPend = TRUE;
+    moduleContext->BatchPendedCount = 0;
+
+    // Each round, the batch callback pends a whole batch. Pended batches add up to more than
+    // ThreadedBufferQueue_WorkBatchSizeMaximum buffers.
+    //
+    sequence = 0;
+    for (round = 0; round < BATCH_PENDED_ROUNDS; round++)
+    {
+        if (0 == round)
+        {
+            Tests_ThreadedBufferQueue_WaitersStart(DmfModule,
+                                                   dmfModuleThreadedBufferQueue,
+                                                   1);
+            while (DMF_ThreadedBufferQueue_Count(dmfModuleThreadedBufferQueue) < WAITER_COUNT)
+            {
+                TestsUtility_YieldExecution();
+            }
+        }
+        while (DMF_ThreadedBufferQueue_Count(dmfModuleThreadedBufferQueue) < BATCH_PENDED_PER_ROUND)
+        {
+            ntStatus = Tests_ThreadedBufferQueue_FireAndForget(dmfModuleThreadedBufferQueue,
+                                                               sequence);
+            DmfAssert(NT_SUCCESS(ntStatus));
+            sequence++;
+        }
+
+        batchCallbacks = InterlockedCompareExchange(&moduleContext->BatchCallbacks,
+                                                    0,
+                                                    0);
+        ntStatus = DMF_ThreadedBufferQueue_Start(dmfModuleThreadedBufferQueue);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            moduleContext->BatchPend = FALSE;
+            goto Exit;
+        }
+        while (InterlockedCompareExchange(&moduleContext->BatchCallbacks,
+                                          0,
+                                          0) == batchCallbacks)
+        {
+            TestsUtility_YieldExecution();
+        }
+        DMF_ThreadedBufferQueue_Stop(dmfModuleThreadedBufferQueue);
+
+        // The worker thread does not look at the Consumer List again until more work is enqueued.
+        //
+        DmfAssert(batchCallbacks + 1 == moduleContext->BatchCallbacks);
+        DmfAssert((round + 1) * BATCH_PENDED_PER_ROUND == moduleContext->BatchPendedCount);
+        DmfAssert(0 == DMF_ThreadedBufferQueue_Count(dmfModuleThreadedBufferQueue));
+    }
+
+    moduleContext->BatchPend = FALSE;
+
+    ntStatus = DMF_ThreadedBufferQueue_Start(dmfModuleThreadedBufferQueue);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    // Complete all the pended buffers in a single call, in reverse order so that the waiters'
+    // buffers are past the first ThreadedBufferQueue_WorkBatchSizeMaximum buffers.
+    //
+    for (clientBufferIndex = 0; clientBufferIndex < moduleContext->BatchPendedCount; clientBufferIndex++)
+    {
+        clientBuffers[clientBufferIndex] = moduleContext->BatchPendedBuffers[moduleContext->BatchPendedCount - clientBufferIndex - 1];
+        item = (ITEM_Tests_ThreadedBufferQueue*)clientBuffers[clientBufferIndex];
+        ntStatuses[clientBufferIndex] = item->NtStatus;
+    }
+    DMF_ThreadedBufferQueue_WorkCompletedMultiple(dmfModuleThreadedBufferQueue,
+                                                  clientBuffers,
+                                                  ntStatuses,
+                                                  moduleContext->BatchPendedCount);
+
+    // Each waiter gets the status of its own buffer.
+    //
+    Tests_ThreadedBufferQueue_WaitersWait(DmfModule);
+    DmfAssert(WAITER_COUNT == moduleContext->WaitsCompleted);
+    DmfAssert(0 == moduleContext->WaitsCancelled);
+
+    Tests_ThreadedBufferQueue_BuffersAvailableVerify(dmfModuleThreadedBufferQueue,
+                                                     BATCH_BUFFER_COUNT);
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_ThreadedBufferQueue_WaiterThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    DMFMODULE dmfModuleThreadedBufferQueue;
+    NTSTATUS ntStatus;
+    VOID* clientBuffer;
+    ITEM_Tests_ThreadedBufferQueue* item;
+    ULONG waiterIndex;
+    ULONG sequence;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    dmfModuleThreadedBufferQueue = moduleContext->DmfModuleThreadedBufferQueueWaiter;
+    DmfAssert(dmfModuleThreadedBufferQueue != NULL);
+
+    for (waiterIndex = 0; waiterIndex < WAITER_COUNT; waiterIndex++)
+    {
+        if (moduleContext->DmfModuleThreadWaiter[waiterIndex] == DmfModuleThread)
+        {
+            break;
+        }
+    }
+    DmfAssert(waiterIndex < WAITER_COUNT);
+
+    for (sequence = 0; sequence < moduleContext->WaiterIterations; sequence++)
+    {
+        // Other threads may be using all the buffers for a short time.
+        //
+        for (;;)
+        {
+            ntStatus = DMF_ThreadedBufferQueue_Fetch(dmfModuleThreadedBufferQueue,
+                                                     &clientBuffer,
+                                                     NULL);
+            if (NT_SUCCESS(ntStatus))
+            {
+                break;
+            }
+            TestsUtility_YieldExecution();
+        }
+
+        item = (ITEM_Tests_ThreadedBufferQueue*)clientBuffer;
+        item->ProducerIndex = waiterIndex;
+        item->Sequence = sequence;
+        item->NtStatus = ITEM_NTSTATUS(waiterIndex,
+                                       sequence);
+
+        if (sequence % 2)
+        {
+            ntStatus = DMF_ThreadedBufferQueue_EnqueueAtHeadAndWait(dmfModuleThreadedBufferQueue,
+                                                                    clientBuffer);
+        }
+        else
+        {
+            ntStatus = DMF_ThreadedBufferQueue_EnqueueAndWait(dmfModuleThreadedBufferQueue,
+                                                              clientBuffer);
+        }
+
+        // The buffer has been returned to the Producer List. Only the status may be used.
+        //
+        if (STATUS_CANCELLED == ntStatus)
+        {
+            InterlockedIncrement(&moduleContext->WaitsCancelled);
+        }
+        else
+        {
+            DmfAssert(ITEM_NTSTATUS(waiterIndex, sequence) == ntStatus);
+            InterlockedIncrement(&moduleContext->WaitsCompleted);
+        }
+    }
+
+    InterlockedDecrement(&moduleContext->WaitersRunning);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_ThreadedBufferQueue_WorkThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+
+    ntStatus = Tests_ThreadedBufferQueue_RunTestsSameBuffer(dmfModule);
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_ThreadedBufferQueue_RunTestsFlushWhileWaiting(dmfModule);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_ThreadedBufferQueue_RunTestsFlushRace(dmfModule);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_ThreadedBufferQueue_RunTestsMultipleWorkers(dmfModule);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_ThreadedBufferQueue_RunTestsMultipleWorkersFlush(dmfModule);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_ThreadedBufferQueue_RunTestsBatch(dmfModule);
+    }
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = Tests_ThreadedBufferQueue_RunTestsBatchPended(dmfModule);
+    }
+
+    // Repeat the test, until stop is signaled or the function stopped because the
+    // driver is stopping.
+    //
+    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+        (NT_SUCCESS(ntStatus)))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_ThreadedBufferQueue_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Tests_ThreadedBufferQueue.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    ULONG waiterIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = DMF_ThreadedBufferQueue_Start(moduleContext->DmfModuleThreadedBufferQueue);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ThreadedBufferQueue_Start fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    ntStatus = DMF_ThreadedBufferQueue_Start(moduleContext->DmfModuleThreadedBufferQueueSingleBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ThreadedBufferQueue_Start fails: ntStatus=%!STATUS!", ntStatus);
+        DMF_ThreadedBufferQueue_Stop(moduleContext->DmfModuleThreadedBufferQueue);
+        goto Exit;
+    }
+
+    ntStatus = DMF_ThreadedBufferQueue_Start(moduleContext->DmfModuleThreadedBufferQueueMultipleWorkers);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ThreadedBufferQueue_Start fails: ntStatus=%!STATUS!", ntStatus);
+        DMF_ThreadedBufferQueue_Stop(moduleContext->DmfModuleThreadedBufferQueueSingleBuffer);
+        DMF_ThreadedBufferQueue_Stop(moduleContext->DmfModuleThreadedBufferQueue);
+        goto Exit;
+    }
+
+    ntStatus = DMF_ThreadedBufferQueue_Start(moduleContext->DmfModuleThreadedBufferQueueBatch);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ThreadedBufferQueue_Start fails: ntStatus=%!STATUS!", ntStatus);
+        DMF_ThreadedBufferQueue_Stop(moduleContext->DmfModuleThreadedBufferQueueMultipleWorkers);
+        DMF_ThreadedBufferQueue_Stop(moduleContext->DmfModuleThreadedBufferQueueSingleBuffer);
+        DMF_ThreadedBufferQueue_Stop(moduleContext->DmfModuleThreadedBufferQueue);
+        goto Exit;
+    }
+
+    // Start the threads that enqueue work and wait. They only run when the work thread
+    // tells them to.
+    //
+    for (waiterIndex = 0; waiterIndex < WAITER_COUNT; waiterIndex++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadWaiter[waiterIndex]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+            while (waiterIndex > 0)
+            {
+                waiterIndex--;
+                DMF_Thread_Stop(moduleContext->DmfModuleThreadWaiter[waiterIndex]);
+            }
+            DMF_ThreadedBufferQueue_Stop(moduleContext->DmfModuleThreadedBufferQueueBatch);
+            DMF_ThreadedBufferQueue_Stop(moduleContext->DmfModuleThreadedBufferQueueMultipleWorkers);
+            DMF_ThreadedBufferQueue_Stop(moduleContext->DmfModuleThreadedBufferQueueSingleBuffer);
+            DMF_ThreadedBufferQueue_Stop(moduleContext->DmfModuleThreadedBufferQueue);
+            goto Exit;
+        }
+    }
+
+    // Start the thread.
+    //
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread);
+
+    // Tell the thread it has work to do.
+    //
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThread);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_ThreadedBufferQueue_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type Tests_ThreadedBufferQueue.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    ULONG waiterIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Stop the work thread first. It may be waiting for the waiters.
+    // (The Threaded Buffer Queues stop their own threads when they close.)
+    //
+    DMF_Thread_Stop(moduleContext->DmfModuleThread);
+    for (waiterIndex = 0; waiterIndex < WAITER_COUNT; waiterIndex++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadWaiter[waiterIndex]);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Tests_ThreadedBufferQueue_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONTEXT_Tests_ThreadedBufferQueue* moduleContext;
+    DMF_CONFIG_ThreadedBufferQueue moduleConfigThreadedBufferQueue;
+    DMF_CONFIG_Thread moduleConfigThread;
+    ULONG waiterIndex;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // ThreadedBufferQueue
+    // -------------------
+    //
+    DMF_CONFIG_ThreadedBufferQueue_AND_ATTRIBUTES_INIT(&moduleConfigThreadedBufferQueue,
+                                                       &moduleAttributes);
+    moduleConfigThreadedBufferQueue.EvtThreadedBufferQueueWork = Tests_ThreadedBufferQueue_WorkCallback;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.BufferContextSize = 0;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.BufferCount = BUFFER_COUNT;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.BufferSize = sizeof(ITEM_Tests_ThreadedBufferQueue);
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.EnableLookAside = FALSE;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.PoolType = PagedPool;
+    moduleAttributes.PassiveLevel = TRUE;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadedBufferQueue);
+
+    // ThreadedBufferQueue (single buffer)
+    // -----------------------------------
+    //
+    DMF_CONFIG_ThreadedBufferQueue_AND_ATTRIBUTES_INIT(&moduleConfigThreadedBufferQueue,
+                                                       &moduleAttributes);
+    moduleConfigThreadedBufferQueue.EvtThreadedBufferQueueWork = Tests_ThreadedBufferQueue_WorkCallback;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.BufferContextSize = 0;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.BufferCount = 1;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.BufferSize = sizeof(ITEM_Tests_ThreadedBufferQueue);
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.EnableLookAside = FALSE;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.PoolType = PagedPool;
+    moduleAttributes.PassiveLevel = TRUE;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadedBufferQueueSingleBuffer);
+
+    // ThreadedBufferQueue (multiple worker threads)
+    // ---------------------------------------------
+    //
+    DMF_CONFIG_ThreadedBufferQueue_AND_ATTRIBUTES_INIT(&moduleConfigThreadedBufferQueue,
+                                                       &moduleAttributes);
+    moduleConfigThreadedBufferQueue.EvtThreadedBufferQueueWork = Tests_ThreadedBufferQueue_WorkCallbackMultipleWorkers;
+    moduleConfigThreadedBufferQueue.NumberOfWorkerThreads = WORKER_COUNT;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.BufferContextSize = 0;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.BufferCount = BUFFER_COUNT;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.BufferSize = sizeof(ITEM_Tests_ThreadedBufferQueue);
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.EnableLookAside = FALSE;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.PoolType = PagedPool;
+    moduleAttributes.PassiveLevel = TRUE;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadedBufferQueueMultipleWorkers);
+
+    // ThreadedBufferQueue (batch)
+    // ---------------------------
+    //
+    DMF_CONFIG_ThreadedBufferQueue_AND_ATTRIBUTES_INIT(&moduleConfigThreadedBufferQueue,
+                                                       &moduleAttributes);
+    moduleConfigThreadedBufferQueue.EvtThreadedBufferQueueWorkBatch = Tests_ThreadedBufferQueue_WorkCallbackBatch;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.BufferContextSize = 0;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.BufferCount = BATCH_BUFFER_COUNT;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.BufferSize = sizeof(ITEM_Tests_ThreadedBufferQueue);
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.EnableLookAside = FALSE;
+    moduleConfigThreadedBufferQueue.BufferQueueConfig.SourceSettings.PoolType = PagedPool;
+    moduleAttributes.PassiveLevel = TRUE;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadedBufferQueueBatch);
+
+    // Thread
+    // ------
+    //
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_ThreadedBufferQueue_WorkThread;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThread);
+
+    for (waiterIndex = 0; waiterIndex < WAITER_COUNT; waiterIndex++)
+    {
+        // Thread (waiter)
+        // ---------------
+        //
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_ThreadedBufferQueue_WaiterThread;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadWaiter[waiterIndex]);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Tests_ThreadedBufferQueue_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type Tests_ThreadedBufferQueue.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Tests_ThreadedBufferQueue;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_Tests_ThreadedBufferQueue;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_ThreadedBufferQueue);
+    dmfCallbacksDmf_Tests_ThreadedBufferQueue.ChildModulesAdd = DMF_Tests_ThreadedBufferQueue_ChildModulesAdd;
+    dmfCallbacksDmf_Tests_ThreadedBufferQueue.DeviceOpen = Tests_ThreadedBufferQueue_Open;
+    dmfCallbacksDmf_Tests_ThreadedBufferQueue.DeviceClose = Tests_ThreadedBufferQueue_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_ThreadedBufferQueue,
+                                            Tests_ThreadedBufferQueue,
+                                            DMF_CONTEXT_Tests_ThreadedBufferQueue,
+                                            DMF_MODULE_OPTIONS_PASSIVE,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_Tests_ThreadedBufferQueue.CallbacksDmf = &dmfCallbacksDmf_Tests_ThreadedBufferQueue;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_Tests_ThreadedBufferQueue,
+                                DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_ThreadedBufferQueue.c
+//
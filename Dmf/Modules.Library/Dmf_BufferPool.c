@@ -67,7 +67,8 @@ typedef struct _DMF_CONTEXT_BufferPool
     // the initial number of buffers.
     //
     ULONG NumberOfAdditionalBuffersAllocated;
-    // For debug purposes.
+    // Number of buffers kept in the list. It is the number of buffers specified by Client
+    // unless adaptive preallocation changes it.
     //
     ULONG NumberOfBuffersSpecifiedByClient;
     // For debug purposes.
@@ -89,6 +90,84 @@ typedef struct _DMF_CONTEXT_BufferPool
     // Offset of the second sentinel for a given buffer entry.
     //
     size_t ContextSentinelOffset;
+    // Per-processor caches of buffers (Source mode only). Buffers in these caches are
+    // not in BufferList and count as used in BuffersUsed.
+    // NULL when PerProcessorCacheSize is zero.
+    //
+    WDFMEMORY CacheMemory;
+    UCHAR* Caches;
+    // Number of caches (one per processor).
+    //
+    ULONG NumberOfCaches;
+    // Maximum number of buffers in each cache.
+    //
+    ULONG CacheSize;
+    // Distance in bytes between caches so that each cache uses its own cache lines.
+    //
+    size_t CacheStride;
+    // Timer wheel that expires all the buffers put with a timer (Sink mode only).
+    // A single timer runs while there are buffers in the wheel and, each time it runs,
+    // expires all the buffers that are due.
+    //
+    WDFTIMER TimerWheelTimer;
+    WDFMEMORY TimerWheelMemory;
+    // BufferPool_TimerWheelSlots slots for the first level, BufferPool_TimerWheelSlots slots
+    // for the second level and one overflow slot.
+    //
+    LIST_ENTRY* TimerWheelSlots;
+    // All ticks before this tick have been processed.
+    //
+    ULONGLONG TimerWheelNextTick;
+    // Number of buffers in the timer wheel.
+    //
+    ULONG NumberOfBuffersInTimerWheel;
+    // Tick at which the timer runs next.
+    //
+    ULONGLONG TimerWheelDueTick;
+    // Indicates the timer has been started and has not yet run its last tick.
+    //
+    BOOLEAN TimerWheelTimerStarted;
+    // Prevents the timer from starting while the Module closes.
+    //
+    BOOLEAN TimerWheelClosing;
+    // Number of size classes (Source mode only). When not zero, each size class is a
+    // Child Module that holds the buffers of that class and this Module holds no buffers.
+    //
+    ULONG NumberOfSizeClasses;
+    // Child Modules of each size class sorted by increasing buffer size.
+    //
+    DMFMODULE DmfModuleBufferPoolSizeClass[BufferPool_SizeClassesMaximum];
+    // Adaptive preallocation (Source mode with EnableLookAside only). A timer periodically
+    // adjusts NumberOfBuffersSpecifiedByClient between the number of buffers the Client specified
+    // and AdaptiveBufferCountMaximum.
+    //
+    WDFTIMER AdaptiveTimer;
+    ULONG AdaptiveBufferCountMaximum;
+    // Buffers allocated from the lookaside list because the list was empty during the current interval.
+    //
+    ULONG AdaptiveOverflowAllocations;
+    // Maximum number of buffers used by Client during the current interval. Unlike BuffersUsed,
+    // it does not include the buffers held in the per-processor caches.
+    //
+    LONG AdaptiveIntervalMaximumBuffersUsed;
+    // Number of consecutive intervals during which fewer buffers than are kept in the list were used
+    // and the maximum value of BuffersUsed during those intervals.
+    //
+    ULONG AdaptiveIdleIntervals;
+    LONG AdaptiveIdleMaximumBuffersUsed;
+    // Prevents the timer from restarting while the Module closes.
+    //
+    BOOLEAN AdaptiveClosing;
+    // Set when a buffer is taken from or returned to the list during the current interval.
+    //
+    BOOLEAN AdaptiveActivity;
+    // The timer is not restarted after an interval without activity (unless the list is about
+    // to shrink). It is started again the next time a buffer is taken from the list.
+    //
+    BOOLEAN AdaptiveTimerStarted;
+    // Optional Registry Module used to save the number of buffers kept in the list.
+    //
+    DMFMODULE DmfModuleRegistry;
 } DMF_CONTEXT_BufferPool;
 
 // This macro declares the following function:
@@ -133,11 +212,11 @@ typedef struct
     // Client buffer memory.
     //
     WDFMEMORY ClientBufferMemory;
-    // Timer for buffer in cases where client wants to automatically do processing on
-    // entries in list.
-    // NOTE: This timer is optionally created so it must be checked prior to use.
+    // Location of this buffer in the timer wheel of the Sink Module that holds it in
+    // cases where client wants to automatically do processing on entries in list.
+    // NOTE: Flink is NULL when the buffer is not in a timer wheel.
     //
-    WDFTIMER Timer;
+    LIST_ENTRY TimerListEntry;
     // For resetting timer again.
     //
     ULONGLONG TimerExpirationMilliseconds;
@@ -169,6 +248,51 @@ typedef struct
     ULONG Signature;
 } BUFFERPOOL_ENTRY;
 
+// Per-processor cache of buffers. Get/Put from the current processor's cache do not
+// acquire the Module lock.
+//
+typedef struct
+{
+    // BufferPool_CacheAvailable, BufferPool_CacheBusy or BufferPool_CacheClosed.
+    //
+    volatile LONG State;
+    // Number of buffers in Entries.
+    //
+    ULONG NumberOfEntries;
+    // Cached buffers (CacheSize entries). Used in LIFO order so that recently used
+    // buffers are reused while still in the processor's data cache.
+    //
+    BUFFERPOOL_ENTRY* Entries[1];
+} BUFFERPOOL_CACHE;
+
+#define BufferPool_CacheAvailable                   0
+#define BufferPool_CacheBusy                        1
+#define BufferPool_CacheClosed                      2
+#define BufferPool_CacheLineSize                    64
+#define BufferPool_PerProcessorCacheSizeMaximum     256
+
+// Timer wheel. Each first level slot holds the buffers that expire during one tick. Each
+// second level slot holds the buffers that expire during BufferPool_TimerWheelSlots ticks.
+// The overflow slot holds the buffers that expire later than that.
+//
+#define BufferPool_TimerWheelTickMilliseconds       16
+#define BufferPool_TimerWheelTick100ns              (BufferPool_TimerWheelTickMilliseconds * WDF_TIMEOUT_TO_MS)
+#define BufferPool_TimerWheelSlotBits               6
+#define BufferPool_TimerWheelSlots                  (1 << BufferPool_TimerWheelSlotBits)
+#define BufferPool_TimerWheelSlotMask               (BufferPool_TimerWheelSlots - 1)
+#define BufferPool_TimerWheelLevel1                 BufferPool_TimerWheelSlots
+#define BufferPool_TimerWheelOverflow               (2 * BufferPool_TimerWheelSlots)
+#define BufferPool_TimerWheelNumberOfSlots          (BufferPool_TimerWheelOverflow + 1)
+
+// Adaptive preallocation.
+// The number of buffers kept in the list grows after an interval with at least
+// BufferPool_AdaptiveGrowThreshold allocations from the lookaside list and shrinks after
+// BufferPool_AdaptiveIdleIntervals consecutive intervals that do not use all of them.
+//
+#define BufferPool_AdaptiveIntervalMilliseconds     1000
+#define BufferPool_AdaptiveGrowThreshold            4
+#define BufferPool_AdaptiveIdleIntervals            60
+
 // Function that inserts a buffer in the BufferList.
 //
 typedef
@@ -177,6 +301,39 @@ VOID
 EVT_DMF_BufferPool_InsertionCallback(_In_ DMF_CONTEXT_BufferPool* ModuleContext,
                                      _Inout_ BUFFERPOOL_ENTRY* BufferPoolEntry);
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_TimerWheelRemove(
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _Inout_ BUFFERPOOL_ENTRY* BufferPoolEntry
+    )
+/*++
+
+Routine Description:
+
+    Remove a given buffer from the timer wheel if it is in the timer wheel.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    BufferPoolEntry - The given buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (BufferPoolEntry->TimerListEntry.Flink != NULL)
+    {
+        DmfAssert(ModuleContext->NumberOfBuffersInTimerWheel > 0);
+        RemoveEntryList(&BufferPoolEntry->TimerListEntry);
+        BufferPoolEntry->TimerListEntry.Flink = NULL;
+        BufferPoolEntry->TimerListEntry.Blink = NULL;
+        ModuleContext->NumberOfBuffersInTimerWheel--;
+    }
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 BufferPool_TimerFieldsClear(
@@ -187,14 +344,14 @@ BufferPool_TimerFieldsClear(
 
 Routine Description:
 
-    Clears fields associated with timer handling for the given buffer. These fields are 
-    used to determine if the timer is enabled so that the timer can be stopped when the 
-    buffer is removed from the list. It is essential that the timer be enabled only when 
-    the buffer is in the list.
+    Clears fields associated with timer handling for the given buffer and removes the
+    buffer from the timer wheel. These fields are used to determine if the timer is enabled
+    so that the buffer can be removed from the timer wheel when the buffer is removed from
+    the list. It is essential that the timer be enabled only when the buffer is in the list.
 
 Arguments:
 
-    DmfModule - This Module's handle (for validation purposes).
+    DmfModule - This Module's handle.
     BufferPoolEntry - The given buffer.
 
 Return Value:
@@ -203,16 +360,57 @@ Return Value:
 
 --*/
 {
-    UNREFERENCED_PARAMETER(DmfModule);
-
     DmfAssert(DMF_ModuleIsLocked(DmfModule));
 
+    BufferPool_TimerWheelRemove(DMF_CONTEXT_GET(DmfModule),
+                                BufferPoolEntry);
+
     BufferPoolEntry->TimerExpirationMilliseconds = 0;
     BufferPoolEntry->TimerExpirationAbsoluteTime100ns = 0;
     BufferPoolEntry->TimerExpirationCallback = NULL;
     BufferPoolEntry->TimerExpirationCallbackContext = NULL;
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_AdaptiveActivityNotify(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Tells adaptive preallocation that a buffer is taken from the list. Starts the adaptive
+    timer if it stopped because the list was not used.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    None
+
+--*/
+{
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    ModuleContext->AdaptiveActivity = TRUE;
+
+    if ((ModuleContext->AdaptiveTimer != NULL) &&
+        (! ModuleContext->AdaptiveTimerStarted) &&
+        (! ModuleContext->AdaptiveClosing))
+    {
+        ModuleContext->AdaptiveTimerStarted = TRUE;
+        WdfTimerStart(ModuleContext->AdaptiveTimer,
+                      WDF_REL_TIMEOUT_IN_MS(BufferPool_AdaptiveIntervalMilliseconds));
+    }
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 BufferPool_BuffersInListDecrement(
@@ -251,6 +449,16 @@ Return Value:
         {
             ModuleContext->MaximumBuffersUsed = ModuleContext->BuffersUsed;
         }
+        // With per-processor caches, the callers that take buffers from the list call
+        // BufferPool_AdaptiveUsageSample() once they are done.
+        //
+        if ((NULL == ModuleContext->Caches) &&
+            (ModuleContext->BuffersUsed > ModuleContext->AdaptiveIntervalMaximumBuffersUsed))
+        {
+            ModuleContext->AdaptiveIntervalMaximumBuffersUsed = ModuleContext->BuffersUsed;
+        }
+        BufferPool_AdaptiveActivityNotify(DmfModule,
+                                          ModuleContext);
     }
 }
 
@@ -309,8 +517,7 @@ BufferPool_RemoveHeadList(
 Routine Description:
 
     Remove the first buffer from the list (at the head of the list) in FIFO order.
-    If a timer is active for the buffer, this call cancels the timer. If it is unsuccessful
-    to cancel the timer, it skips that buffer.
+    If a timer is active for the buffer, this call cancels the timer.
 
 Arguments:
 
@@ -340,34 +547,14 @@ Return Value:
                                             BUFFERPOOL_ENTRY,
                                             ListEntry);
 
-        // If a timer is set, then try to stop the timer. If the timer cannot be stopped,
-        // then do not remove this buffer because its timer callback will be called
-        // very soon. This avoids a race condition between removal, enumeration and timer callbacks.
+        // If a timer is set, remove the buffer from the timer wheel. The timer wheel only
+        // expires buffers while the Module lock is held, so the timer callback will not be
+        // called for this buffer.
         //
         if (bufferPoolEntry->TimerExpirationCallback != NULL)
         {
-            // The timer is running. Try to stop it.
-            //
-            if (! WdfTimerStop(bufferPoolEntry->Timer,
-                               FALSE))
-            {
-                // Timer callback will be called soon, so skip this buffer.
-                // (Try to remove the next buffer.)
-                //
-                listEntry = listEntry->Flink;
-                bufferPoolEntry = NULL;
-                continue;
-            }
-            else
-            {
-                // The timer has been stopped. The timer callback will not be called.
-                // Clears fields associated with timer handling.
-                // This buffer will be removed now.
-                //
-                BufferPool_TimerFieldsClear(DmfModule,
-                                            bufferPoolEntry);
-            }
-            
+            BufferPool_TimerFieldsClear(DmfModule,
+                                        bufferPoolEntry);
         }
 
         DmfAssert(ModuleContext->NumberOfBuffersInList > 0);
@@ -502,6 +689,42 @@ Return Value:
                    &BufferPoolEntry->ListEntry);
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_ListAppend(
+    _Inout_ LIST_ENTRY* DestinationList,
+    _Inout_ LIST_ENTRY* SourceList
+    )
+/*++
+
+Routine Description:
+
+    Moves all the entries of a given list to the end of another list in constant time.
+    The given list is empty afterward.
+
+Arguments:
+
+    DestinationList - The list that receives the entries.
+    SourceList - The list whose entries are moved.
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (! IsListEmpty(SourceList))
+    {
+        // Link the chain (including its list head) to the end of the destination list
+        // and then unlink the list head so that only the entries remain.
+        //
+        AppendTailList(DestinationList,
+                       SourceList);
+        RemoveEntryList(SourceList);
+        InitializeListHead(SourceList);
+    }
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 BufferPool_InsertList(
@@ -588,9 +811,11 @@ Return Value:
     DmfAssert(ClientBuffer != NULL);
 
     // Given the Client Buffer, get the associated meta data.
-    // NOTE: The meta data is located sizeof(BUFFERPOOL_ENTRY) bytes before the Client buffer.
+    // NOTE: The meta data is located sizeof(BUFFERPOOL_ENTRY) bytes (rounded up to the memory
+    //       allocation alignment) before the Client buffer.
     //
-    bufferPoolEntry = ((BUFFERPOOL_ENTRY*)ClientBuffer) - 1;
+    bufferPoolEntry = (BUFFERPOOL_ENTRY*)((UCHAR*)ClientBuffer - WDF_ALIGN_SIZE_UP(sizeof(BUFFERPOOL_ENTRY),
+                                                                                   MEMORY_ALLOCATION_ALIGNMENT));
 
     DmfVerifierAssert("DMF_BufferPool signature mismatch", 
                       bufferPoolEntry->Signature == BufferPool_Signature);
@@ -643,6 +868,8 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    moduleContext->AdaptiveActivity = TRUE;
+
     if (moduleContext->EnableLookAside)
     {
         if (moduleContext->NumberOfAdditionalBuffersAllocated > 0)
@@ -655,6 +882,9 @@ Return Value:
             // There is one less additional buffer now.
             //
             moduleContext->NumberOfAdditionalBuffersAllocated--;
+            // The buffer is no longer in use even though it is not added to the list.
+            //
+            moduleContext->BuffersUsed--;
             TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "NumberOfAdditionalBuffersAllocated=%d", moduleContext->NumberOfAdditionalBuffersAllocated);
             // Do not add the entry back into the list.
             //
@@ -677,489 +907,2055 @@ Exit:
     FuncExitVoid(DMF_TRACE);
 }
 
-typedef struct
-{
-    BUFFERPOOL_ENTRY* BufferPoolEntry;
-    DMFMODULE DmfModuleInsertedList;
-} BUFFERPOOL_TIMER_CONTEXT;
-
-EVT_WDF_TIMER BufferPool_BufferPoolEntryTimerHandler;
-WDF_DECLARE_CONTEXT_TYPE(BUFFERPOOL_TIMER_CONTEXT);
-
-VOID
-BufferPool_BufferPoolTimerContextSet(
-    _In_ BUFFERPOOL_ENTRY* BufferPoolEntry,
-    _In_opt_ DMFMODULE DmfModule
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BUFFERPOOL_CACHE*
+BufferPool_CacheAcquire(
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _In_ ULONG CacheIndex
     )
 /*++
 
 Routine Description:
 
-    Store the given DMF Module handle in BufferPoolEntry Timer's context.
+    Try to take exclusive ownership of a given per-processor cache. This call never waits.
+    If the cache is in use by another thread (that was preempted or migrated to another
+    processor) or the cache is closed, the caller uses BufferList instead.
 
 Arguments:
 
-    BufferPoolEntry - BufferPool entry which contains the Timer object.
-    BufferPoolEntry - The given DMF Module handle.
+    ModuleContext - This Module's context.
+    CacheIndex - Index of the cache to acquire.
 
 Return Value:
 
-    None
+    The acquired cache or NULL if the cache could not be acquired.
 
 --*/
 {
-    BUFFERPOOL_TIMER_CONTEXT* bufferPoolTimerContext;
+    BUFFERPOOL_CACHE* cache;
 
-    DmfAssert(BufferPoolEntry != NULL);
-    DmfAssert(BufferPoolEntry->Timer != NULL);
+    DmfAssert(ModuleContext->Caches != NULL);
+    DmfAssert(CacheIndex < ModuleContext->NumberOfCaches);
 
-    bufferPoolTimerContext = WdfObjectGet_BUFFERPOOL_TIMER_CONTEXT(BufferPoolEntry->Timer);
-    DmfAssert(bufferPoolTimerContext->BufferPoolEntry == BufferPoolEntry);
+    cache = (BUFFERPOOL_CACHE*)(ModuleContext->Caches + (CacheIndex * ModuleContext->CacheStride));
+    if (InterlockedCompareExchange(&cache->State,
+                                   BufferPool_CacheBusy,
+                                   BufferPool_CacheAvailable) != BufferPool_CacheAvailable)
+    {
+        cache = NULL;
+    }
 
-    bufferPoolTimerContext->DmfModuleInsertedList = DmfModule;
+    return cache;
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
-BufferPool_BufferPoolEntryTimerHandler(
-    _In_ WDFTIMER WdfTimer
+BufferPool_CacheRelease(
+    _In_ BUFFERPOOL_CACHE* Cache
     )
 /*++
 
 Routine Description:
 
-    Timer callback. The BufferPool entry corresponding to the timer will be removed 
-    from the list, and will be passed to the Client's timer expiration callback.
-    Upon timer expiration callback, Client owns the buffer. 
+    Release ownership of a cache acquired by BufferPool_CacheAcquire().
 
-Parameters:
+Arguments:
 
-    WdfTimer - The timer object that contains the PBUFFER_LIST_ENTRY.
+    Cache - The given cache.
 
-Return:
+Return Value:
 
     None
 
 --*/
 {
-    BUFFERPOOL_TIMER_CONTEXT* bufferPoolTimerContext;
-    BUFFERPOOL_ENTRY* bufferPoolEntryTimer;
-    BUFFERPOOL_ENTRY* bufferPoolEntryInList;
-    DMFMODULE dmfModule;
-    DMF_CONTEXT_BufferPool* moduleContext;
-    EVT_DMF_BufferPool_TimerCallback* timerExpirationCallback;
-    VOID* timerExpirationCallbackContext;
-    LIST_ENTRY* listEntry;
+    DmfAssert(BufferPool_CacheBusy == Cache->State);
 
-    FuncEntry(DMF_TRACE);
+    InterlockedExchange(&Cache->State,
+                        BufferPool_CacheAvailable);
+}
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "BufferPool Entry timer expires");
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONG
+BufferPool_CacheIndexGet(
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+    )
+/*++
 
-    // Get the BUFFERPOOL_TIMER_CONTEXT from the WDF Object.
-    //
-    bufferPoolTimerContext = WdfObjectGet_BUFFERPOOL_TIMER_CONTEXT(WdfTimer);
-    DmfAssert(bufferPoolTimerContext != NULL);
-    bufferPoolEntryTimer = bufferPoolTimerContext->BufferPoolEntry;
-    dmfModule = bufferPoolTimerContext->DmfModuleInsertedList;
-    DmfAssert(dmfModule != NULL);
+Routine Description:
 
-    moduleContext = DMF_CONTEXT_GET(dmfModule);
+    Get the index of the cache that belongs to the current processor.
+    NOTE: The thread may run on another processor by the time the cache is used. That is
+          not a problem because each cache is acquired before it is used.
 
-    DMF_ModuleLock(dmfModule);
+Arguments:
 
-    timerExpirationCallback = NULL;
-    timerExpirationCallbackContext = NULL;
-    // If timer callback executed, buffer associated with the timer should be present in the list.
-    // But it might not be the first one. Search for it.
-    //
-    listEntry = moduleContext->BufferList.Flink;
-    while (listEntry != &moduleContext->BufferList)
-    {
-        // Prepare to call the enumeration function.
-        //
-        bufferPoolEntryInList = CONTAINING_RECORD(listEntry,
-                                                  BUFFERPOOL_ENTRY,
-                                                  ListEntry);
+    ModuleContext - This Module's context.
 
-        // Prepare to read the next entry in list at top of loop.
-        //
-        listEntry = listEntry->Flink;
+Return Value:
 
-        // Only remove the buffer if it's in the list AND the Client Driver's
-        // callback is not NULL. It is a legitimate case that the callback is NULL if the
-        // buffer had been removed from the list and added back without a timer.
-        //
-        if ((bufferPoolEntryInList == bufferPoolEntryTimer) &&
-            (bufferPoolEntryTimer->TimerExpirationCallback) != NULL)
-        {
-            // Found it. Remove it from list 
-            //
-            DmfAssert(bufferPoolEntryTimer->Timer != NULL);
+    Index of the current processor's cache.
 
-            // Remove item from list.
-            // (If the Client wants to use this buffer, Client has saved off the buffer in Client's Context).
-            // NOTE: Client Driver now owns buffer!
-            //
-            BufferPool_RemoveEntryList(dmfModule,
-                                       moduleContext,
-                                       bufferPoolEntryTimer);
+--*/
+{
+    ULONG processorIndex;
 
-            // These fields are both cleared in the next call. Save off so they can be passed to
-            // Client, otherwise they are NULL.
-            //
-            timerExpirationCallback = bufferPoolEntryTimer->TimerExpirationCallback;
-            timerExpirationCallbackContext = bufferPoolEntryTimer->TimerExpirationCallbackContext;
-            BufferPool_TimerFieldsClear(dmfModule,
-                                        bufferPoolEntryTimer);
-            
-            // The only matching buffer has been found.
-            //
-            break;
-        }
+#if defined(DMF_USER_MODE)
+    processorIndex = GetCurrentProcessorNumber();
+#else
+    processorIndex = KeGetCurrentProcessorNumberEx(NULL);
+#endif
 
-        // Keep searching.
-        //
-    }
+    return (processorIndex % ModuleContext->NumberOfCaches);
+}
 
-    DMF_ModuleUnlock(dmfModule);
+// BufferPool_AdaptiveBuffersUsedGet() calls this function so it needs to be declared here.
+//
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONG
+BufferPool_CacheCount(
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+    );
 
-    // Due to race conditions with cancel routines, it is possible the buffer was removed from the list
-    // during timer expiration.
-    //
-    if (timerExpirationCallback != NULL)
-    {
-        // Call the client driver's timer callback function.
-        //
-        timerExpirationCallback(dmfModule,
-                                bufferPoolEntryTimer->ClientBuffer,
-                                bufferPoolEntryTimer->ClientBufferContext,
-                                timerExpirationCallbackContext);
-    }
-    else
+_IRQL_requires_max_(DISPATCH_LEVEL)
+LONG
+BufferPool_AdaptiveBuffersUsedGet(
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Return the number of buffers used by Client for adaptive preallocation. Buffers held in
+    the per-processor caches are not in BufferList but they are not used by Client either.
+    Counting them would make each cache refill look like Client needs more buffers.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    Number of buffers used by Client.
+
+--*/
+{
+    LONG buffersUsed;
+
+    buffersUsed = ModuleContext->BuffersUsed;
+    if (ModuleContext->Caches != NULL)
     {
-        // Buffer was removed from the list while timer was expiring.
-        //
+        buffersUsed -= (LONG)BufferPool_CacheCount(ModuleContext);
     }
 
-    FuncExitVoid(DMF_TRACE);
+    return buffersUsed;
 }
 
-#if defined(DMF_USER_MODE)
-_IRQL_requires_max_(PASSIVE_LEVEL)
-#else
 _IRQL_requires_max_(DISPATCH_LEVEL)
-#endif // defined(DMF_USER_MODE)
-_Must_inspect_result_
-NTSTATUS
-BufferPool_BufferPoolEntryCreateAndAddToList(
-    _In_ DMFMODULE DmfModule
+VOID
+BufferPool_AdaptiveUsageSample(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
     )
 /*++
 
 Routine Description:
 
-    Creates a new Client Buffer BUFFERPOOL_ENTRY and adds the Client Buffer to the
-    list of buffers.
+    Track the maximum number of buffers used by Client during the current adaptive interval
+    after buffers have been taken from BufferList while there are per-processor caches.
+    NOTE: Each cache is read so this is done once per refill instead of once per buffer.
 
 Arguments:
 
     DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
 
 Return Value:
 
-    NTSTATUS
+    None
 
 --*/
 {
-    NTSTATUS ntStatus;
-    DMF_CONTEXT_BufferPool* moduleContext;
-    DMF_CONFIG_BufferPool* moduleConfig;
-    WDF_OBJECT_ATTRIBUTES objectAttributes;
-    WDFMEMORY memory;
-    BUFFERPOOL_ENTRY* bufferPoolEntry;
-    WDF_TIMER_CONFIG timerConfig;
-    WDF_OBJECT_ATTRIBUTES timerAttributes;
-    BUFFERPOOL_TIMER_CONTEXT* bufferPoolTimerContext;
+    LONG buffersUsed;
 
-    FuncEntry(DMF_TRACE);
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    if (ModuleContext->AdaptiveTimer != NULL)
+    {
+        buffersUsed = BufferPool_AdaptiveBuffersUsedGet(ModuleContext);
+        if (buffersUsed > ModuleContext->AdaptiveIntervalMaximumBuffersUsed)
+        {
+            ModuleContext->AdaptiveIntervalMaximumBuffersUsed = buffersUsed;
+        }
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BUFFERPOOL_ENTRY*
+BufferPool_CacheGet(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Remove a buffer from the current processor's cache. If that cache is empty, it is refilled
+    with up to half its size from BufferList. If there are no buffers in BufferList, a buffer
+    is taken from any other processor's cache so that all the buffers in the pool remain available.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    The removed BUFFERPOOL_ENTRY or NULL if no buffer is available from the caches.
+
+--*/
+{
+    BUFFERPOOL_CACHE* cache;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    ULONG cacheIndex;
+    ULONG refillIndex;
+    ULONG currentCacheIndex;
+
+    bufferPoolEntry = NULL;
+
+    currentCacheIndex = BufferPool_CacheIndexGet(ModuleContext);
+    cache = BufferPool_CacheAcquire(ModuleContext,
+                                    currentCacheIndex);
+    if (cache != NULL)
+    {
+        if (0 == cache->NumberOfEntries)
+        {
+            // Refill half the cache so that the following Put calls also find space in it.
+            //
+            DMF_ModuleLock(DmfModule);
+            for (refillIndex = 0; refillIndex < (ModuleContext->CacheSize + 1) / 2; refillIndex++)
+            {
+                bufferPoolEntry = BufferPool_RemoveHeadList(DmfModule,
+                                                            ModuleContext);
+                if (NULL == bufferPoolEntry)
+                {
+                    break;
+                }
+                bufferPoolEntry->CurrentlyInsertedDmfModule = DmfModule;
+                cache->Entries[cache->NumberOfEntries] = bufferPoolEntry;
+                cache->NumberOfEntries++;
+            }
+            BufferPool_AdaptiveUsageSample(DmfModule,
+                                           ModuleContext);
+            DMF_ModuleUnlock(DmfModule);
+            bufferPoolEntry = NULL;
+        }
+
+        if (cache->NumberOfEntries > 0)
+        {
+            cache->NumberOfEntries--;
+            bufferPoolEntry = cache->Entries[cache->NumberOfEntries];
+        }
+        BufferPool_CacheRelease(cache);
+    }
+
+    // BufferList is empty. Buffers may still be held in other processors' caches.
+    //
+    for (cacheIndex = 0; (NULL == bufferPoolEntry) && (cacheIndex < ModuleContext->NumberOfCaches); cacheIndex++)
+    {
+        if (cacheIndex == currentCacheIndex)
+        {
+            continue;
+        }
+        cache = BufferPool_CacheAcquire(ModuleContext,
+                                        cacheIndex);
+        if (NULL == cache)
+        {
+            continue;
+        }
+        if (cache->NumberOfEntries > 0)
+        {
+            cache->NumberOfEntries--;
+            bufferPoolEntry = cache->Entries[cache->NumberOfEntries];
+        }
+        BufferPool_CacheRelease(cache);
+    }
+
+    if (bufferPoolEntry != NULL)
+    {
+        DmfAssert(bufferPoolEntry->CurrentlyInsertedList == NULL);
+        DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
+        bufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
+    }
+
+    return bufferPoolEntry;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_CacheFlushLocked(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _Inout_ BUFFERPOOL_CACHE* Cache,
+    _In_ EVT_DMF_BufferPool_InsertionCallback* BufferPool_InsertionCallback
+    )
+/*++
+
+Routine Description:
+
+    Move the oldest half of a full cache to BufferList.
+    NOTE: The caller must own the cache and hold the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    Cache - The given cache.
+    BufferPool_InsertionCallback - Function pointer that inserts buffers moved to BufferList.
+
+Return Value:
+
+    None
+
+--*/
+{
+    BUFFERPOOL_ENTRY* bufferPoolEntryToMove;
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    DmfAssert(Cache->NumberOfEntries == ModuleContext->CacheSize);
+
+    while (Cache->NumberOfEntries > ModuleContext->CacheSize / 2)
+    {
+        Cache->NumberOfEntries--;
+        bufferPoolEntryToMove = Cache->Entries[ModuleContext->CacheSize - 1 - Cache->NumberOfEntries];
+        bufferPoolEntryToMove->CurrentlyInsertedDmfModule = NULL;
+        BufferPool_BufferPoolEntryPut(DmfModule,
+                                      bufferPoolEntryToMove,
+                                      BufferPool_InsertionCallback);
+    }
+    RtlMoveMemory(&Cache->Entries[0],
+                  &Cache->Entries[ModuleContext->CacheSize - Cache->NumberOfEntries],
+                  Cache->NumberOfEntries * sizeof(BUFFERPOOL_ENTRY*));
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+BufferPool_CachePut(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _In_ BUFFERPOOL_ENTRY* BufferPoolEntry,
+    _In_ EVT_DMF_BufferPool_InsertionCallback* BufferPool_InsertionCallback
+    )
+/*++
+
+Routine Description:
+
+    Add a buffer to the current processor's cache. If that cache is full, half of it is
+    moved to BufferList first.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    BufferPoolEntry - The given buffer.
+    BufferPool_InsertionCallback - Function pointer that inserts buffers moved to BufferList.
+
+Return Value:
+
+    TRUE if the buffer was added to the cache.
+    FALSE if the cache is not available. Caller must add the buffer to BufferList.
+
+--*/
+{
+    BUFFERPOOL_CACHE* cache;
+    BOOLEAN returnValue;
+
+    // Verify that this buffer is not in any other list or cache.
+    //
+    DmfAssert(BufferPoolEntry->ListEntry.Blink == NULL);
+    DmfAssert(BufferPoolEntry->ListEntry.Flink == NULL);
+    DmfAssert(BufferPoolEntry->CurrentlyInsertedList == NULL);
+    DmfAssert(BufferPoolEntry->CurrentlyInsertedDmfModule == NULL);
+
+    cache = BufferPool_CacheAcquire(ModuleContext,
+                                    BufferPool_CacheIndexGet(ModuleContext));
+    if (NULL == cache)
+    {
+        returnValue = FALSE;
+        goto Exit;
+    }
+
+    if (cache->NumberOfEntries == ModuleContext->CacheSize)
+    {
+        DMF_ModuleLock(DmfModule);
+        BufferPool_CacheFlushLocked(DmfModule,
+                                    ModuleContext,
+                                    cache,
+                                    BufferPool_InsertionCallback);
+        DMF_ModuleUnlock(DmfModule);
+    }
+
+    BufferPoolEntry->CurrentlyInsertedDmfModule = DmfModule;
+    cache->Entries[cache->NumberOfEntries] = BufferPoolEntry;
+    cache->NumberOfEntries++;
+
+    BufferPool_CacheRelease(cache);
+    returnValue = TRUE;
+
+Exit:
+
+    return returnValue;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONG
+BufferPool_CacheGetMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _In_ ULONG NumberOfBuffers,
+    _Out_writes_to_(NumberOfBuffers, return) VOID** ClientBuffers
+    )
+/*++
+
+Routine Description:
+
+    Remove up to NumberOfBuffers buffers from the current processor's cache. The buffers that
+    are missing are removed from BufferList and, if the cache is empty, it is refilled with up
+    to half its size while the Module lock is acquired only once. If there are still not enough
+    buffers, buffers are taken from any other processor's cache.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    NumberOfBuffers - The maximum number of buffers to remove.
+    ClientBuffers - Array that receives the Client Buffers of the removed buffers.
+
+Return Value:
+
+    The number of buffers written to ClientBuffers.
+
+--*/
+{
+    BUFFERPOOL_CACHE* cache;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    ULONG cacheIndex;
+    ULONG refillIndex;
+    ULONG currentCacheIndex;
+    ULONG numberOfBuffersReturned;
+
+    numberOfBuffersReturned = 0;
+
+    currentCacheIndex = BufferPool_CacheIndexGet(ModuleContext);
+    cache = BufferPool_CacheAcquire(ModuleContext,
+                                    currentCacheIndex);
+    if (cache != NULL)
+    {
+        while ((numberOfBuffersReturned < NumberOfBuffers) &&
+               (cache->NumberOfEntries > 0))
+        {
+            cache->NumberOfEntries--;
+            bufferPoolEntry = cache->Entries[cache->NumberOfEntries];
+            DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
+            bufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
+            ClientBuffers[numberOfBuffersReturned] = bufferPoolEntry->ClientBuffer;
+            numberOfBuffersReturned++;
+        }
+    }
+
+    if ((numberOfBuffersReturned < NumberOfBuffers) ||
+        ((cache != NULL) && (0 == cache->NumberOfEntries)))
+    {
+        DMF_ModuleLock(DmfModule);
+        while (numberOfBuffersReturned < NumberOfBuffers)
+        {
+            bufferPoolEntry = BufferPool_RemoveHeadList(DmfModule,
+                                                        ModuleContext);
+            if (NULL == bufferPoolEntry)
+            {
+                break;
+            }
+            ClientBuffers[numberOfBuffersReturned] = bufferPoolEntry->ClientBuffer;
+            numberOfBuffersReturned++;
+        }
+        // Refill half the cache so that the following Put calls also find space in it.
+        //
+        if ((cache != NULL) &&
+            (0 == cache->NumberOfEntries))
+        {
+            for (refillIndex = 0; refillIndex < (ModuleContext->CacheSize + 1) / 2; refillIndex++)
+            {
+                bufferPoolEntry = BufferPool_RemoveHeadList(DmfModule,
+                                                            ModuleContext);
+                if (NULL == bufferPoolEntry)
+                {
+                    break;
+                }
+                bufferPoolEntry->CurrentlyInsertedDmfModule = DmfModule;
+                cache->Entries[cache->NumberOfEntries] = bufferPoolEntry;
+                cache->NumberOfEntries++;
+            }
+        }
+        BufferPool_AdaptiveUsageSample(DmfModule,
+                                       ModuleContext);
+        DMF_ModuleUnlock(DmfModule);
+    }
+
+    if (cache != NULL)
+    {
+        BufferPool_CacheRelease(cache);
+    }
+
+    // BufferList is empty. Buffers may still be held in other processors' caches.
+    //
+    for (cacheIndex = 0; (numberOfBuffersReturned < NumberOfBuffers) && (cacheIndex < ModuleContext->NumberOfCaches); cacheIndex++)
+    {
+        if (cacheIndex == currentCacheIndex)
+        {
+            continue;
+        }
+        cache = BufferPool_CacheAcquire(ModuleContext,
+                                        cacheIndex);
+        if (NULL == cache)
+        {
+            continue;
+        }
+        while ((numberOfBuffersReturned < NumberOfBuffers) &&
+               (cache->NumberOfEntries > 0))
+        {
+            cache->NumberOfEntries--;
+            bufferPoolEntry = cache->Entries[cache->NumberOfEntries];
+            DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
+            bufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
+            ClientBuffers[numberOfBuffersReturned] = bufferPoolEntry->ClientBuffer;
+            numberOfBuffersReturned++;
+        }
+        BufferPool_CacheRelease(cache);
+    }
+
+    return numberOfBuffersReturned;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+BufferPool_CachePutMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _In_reads_(NumberOfBuffers) VOID** ClientBuffers,
+    _In_ ULONG NumberOfBuffers,
+    _In_ EVT_DMF_BufferPool_InsertionCallback* BufferPool_InsertionCallback
+    )
+/*++
+
+Routine Description:
+
+    Add buffers to the current processor's cache. If the cache becomes full, half of it is
+    moved to BufferList and the buffers that still do not fit are added to BufferList while
+    the Module lock is acquired only once.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    ClientBuffers - The buffers to add. They have been prepared by the caller.
+    NumberOfBuffers - The number of buffers in ClientBuffers.
+    BufferPool_InsertionCallback - Function pointer that inserts buffers in BufferList.
+
+Return Value:
+
+    TRUE if all the buffers were added to the cache or BufferList.
+    FALSE if the cache is not available. Caller must add all the buffers to BufferList.
+
+--*/
+{
+    BUFFERPOOL_CACHE* cache;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    ULONG bufferIndex;
+    BOOLEAN returnValue;
+
+    cache = BufferPool_CacheAcquire(ModuleContext,
+                                    BufferPool_CacheIndexGet(ModuleContext));
+    if (NULL == cache)
+    {
+        returnValue = FALSE;
+        goto Exit;
+    }
+
+    bufferIndex = 0;
+    while ((bufferIndex < NumberOfBuffers) &&
+           (cache->NumberOfEntries < ModuleContext->CacheSize))
+    {
+        bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(ClientBuffers[bufferIndex]);
+        DmfAssert(bufferPoolEntry->CurrentlyInsertedList == NULL);
+        DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == NULL);
+        bufferPoolEntry->CurrentlyInsertedDmfModule = DmfModule;
+        cache->Entries[cache->NumberOfEntries] = bufferPoolEntry;
+        cache->NumberOfEntries++;
+        bufferIndex++;
+    }
+
+    if (bufferIndex < NumberOfBuffers)
+    {
+        DMF_ModuleLock(DmfModule);
+        BufferPool_CacheFlushLocked(DmfModule,
+                                    ModuleContext,
+                                    cache,
+                                    BufferPool_InsertionCallback);
+        while (bufferIndex < NumberOfBuffers)
+        {
+            bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(ClientBuffers[bufferIndex]);
+            DmfAssert(bufferPoolEntry->CurrentlyInsertedList == NULL);
+            DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == NULL);
+            if (cache->NumberOfEntries < ModuleContext->CacheSize)
+            {
+                bufferPoolEntry->CurrentlyInsertedDmfModule = DmfModule;
+                cache->Entries[cache->NumberOfEntries] = bufferPoolEntry;
+                cache->NumberOfEntries++;
+            }
+            else
+            {
+                BufferPool_BufferPoolEntryPut(DmfModule,
+                                              bufferPoolEntry,
+                                              BufferPool_InsertionCallback);
+            }
+            bufferIndex++;
+        }
+        DMF_ModuleUnlock(DmfModule);
+    }
+
+    BufferPool_CacheRelease(cache);
+    returnValue = TRUE;
+
+Exit:
+
+    return returnValue;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONG
+BufferPool_CacheCount(
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Return the number of buffers in all the per-processor caches. Caches are not acquired,
+    so the result is a snapshot in the same way as the number of buffers in BufferList.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    Number of buffers in all the caches.
+
+--*/
+{
+    BUFFERPOOL_CACHE* cache;
+    ULONG cacheIndex;
+    ULONG numberOfEntries;
+
+    numberOfEntries = 0;
+    for (cacheIndex = 0; cacheIndex < ModuleContext->NumberOfCaches; cacheIndex++)
+    {
+        cache = (BUFFERPOOL_CACHE*)(ModuleContext->Caches + (cacheIndex * ModuleContext->CacheStride));
+        numberOfEntries += *((volatile ULONG*)&cache->NumberOfEntries);
+    }
+
+    return numberOfEntries;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_CachesClose(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Move all the buffers in the per-processor caches to BufferList and close the caches
+    so that any later Get/Put uses BufferList.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    None
+
+--*/
+{
+    BUFFERPOOL_CACHE* cache;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    ULONG cacheIndex;
+
+    for (cacheIndex = 0; cacheIndex < ModuleContext->NumberOfCaches; cacheIndex++)
+    {
+        cache = (BUFFERPOOL_CACHE*)(ModuleContext->Caches + (cacheIndex * ModuleContext->CacheStride));
+        // Wait for any thread that is using this cache. It owns the cache only for a short time.
+        //
+        while (InterlockedCompareExchange(&cache->State,
+                                          BufferPool_CacheClosed,
+                                          BufferPool_CacheAvailable) == BufferPool_CacheBusy)
+        {
+            YieldProcessor();
+        }
+
+        DMF_ModuleLock(DmfModule);
+        while (cache->NumberOfEntries > 0)
+        {
+            cache->NumberOfEntries--;
+            bufferPoolEntry = cache->Entries[cache->NumberOfEntries];
+            DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
+            bufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
+            BufferPool_BufferPoolEntryPut(DmfModule,
+                                          bufferPoolEntry,
+                                          BufferPool_InsertTailList);
+        }
+        DMF_ModuleUnlock(DmfModule);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONGLONG
+BufferPool_InterruptTimeGet(
+    VOID
+    )
+/*++
+
+Routine Description:
+
+    Get the current interrupt time in 100-ns units.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    The current interrupt time.
+
+--*/
+{
+    ULONGLONG currentInterruptTime;
+
+#if defined(DMF_USER_MODE)
+    QueryInterruptTime(&currentInterruptTime);
+#else
+    currentInterruptTime = KeQueryInterruptTime();
+#endif
+
+    return currentInterruptTime;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_TimerWheelInsert(
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _Inout_ BUFFERPOOL_ENTRY* BufferPoolEntry
+    )
+/*++
+
+Routine Description:
+
+    Insert a given buffer in the timer wheel slot that corresponds to its expiration time.
+    The buffer is placed in the first level if it expires in the current block of ticks,
+    in the second level if it expires in the current group of blocks or in the overflow slot.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    BufferPoolEntry - The given buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONGLONG expirationTick;
+    ULONGLONG nextTick;
+    ULONG slotIndex;
+
+    // Round up so that the buffer never expires early.
+    //
+    expirationTick = (BufferPoolEntry->TimerExpirationAbsoluteTime100ns + BufferPool_TimerWheelTick100ns - 1) /
+                     BufferPool_TimerWheelTick100ns;
+    nextTick = ModuleContext->TimerWheelNextTick;
+    if (expirationTick < nextTick)
+    {
+        expirationTick = nextTick;
+    }
+
+    if ((expirationTick >> BufferPool_TimerWheelSlotBits) == (nextTick >> BufferPool_TimerWheelSlotBits))
+    {
+        slotIndex = (ULONG)(expirationTick & BufferPool_TimerWheelSlotMask);
+    }
+    else if ((expirationTick >> (2 * BufferPool_TimerWheelSlotBits)) == (nextTick >> (2 * BufferPool_TimerWheelSlotBits)))
+    {
+        slotIndex = BufferPool_TimerWheelLevel1 + (ULONG)((expirationTick >> BufferPool_TimerWheelSlotBits) & BufferPool_TimerWheelSlotMask);
+    }
+    else
+    {
+        slotIndex = BufferPool_TimerWheelOverflow;
+    }
+
+    InsertTailList(&ModuleContext->TimerWheelSlots[slotIndex],
+                   &BufferPoolEntry->TimerListEntry);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_TimerWheelTimerStart(
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _In_ ULONGLONG CurrentInterruptTime
+    )
+/*++
+
+Routine Description:
+
+    Start the timer so that it runs at the next tick that has buffers in the first level
+    or, if there are none, at the start of the next block of ticks so that buffers move
+    from the second level to the first level.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    CurrentInterruptTime - The current interrupt time.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONGLONG dueTick;
+    ULONGLONG dueTime100ns;
+    ULONGLONG relativeTime100ns;
+
+    dueTick = ModuleContext->TimerWheelNextTick;
+    while (((dueTick & BufferPool_TimerWheelSlotMask) != 0) &&
+           IsListEmpty(&ModuleContext->TimerWheelSlots[dueTick & BufferPool_TimerWheelSlotMask]))
+    {
+        dueTick++;
+    }
+
+    dueTime100ns = dueTick * BufferPool_TimerWheelTick100ns;
+    if (dueTime100ns > CurrentInterruptTime + WDF_TIMEOUT_TO_MS)
+    {
+        relativeTime100ns = dueTime100ns - CurrentInterruptTime;
+    }
+    else
+    {
+        relativeTime100ns = WDF_TIMEOUT_TO_MS;
+    }
+
+    ModuleContext->TimerWheelDueTick = dueTick;
+    ModuleContext->TimerWheelTimerStarted = TRUE;
+    WdfTimerStart(ModuleContext->TimerWheelTimer,
+                  -((LONGLONG)relativeTime100ns));
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_TimerWheelAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _Inout_ BUFFERPOOL_ENTRY* BufferPoolEntry
+    )
+/*++
+
+Routine Description:
+
+    Add a given buffer to the timer wheel so that it expires TimerExpirationMilliseconds
+    from now. Starts the timer if it is not running or if it runs later than needed for
+    this buffer.
+
+Arguments:
+
+    DmfModule - This Module's handle (for validation purposes).
+    ModuleContext - This Module's context.
+    BufferPoolEntry - The given buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONGLONG currentInterruptTime;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    DmfAssert(ModuleContext->TimerWheelSlots != NULL);
+    DmfAssert(BufferPoolEntry->TimerListEntry.Flink == NULL);
+    DmfAssert(BufferPoolEntry->TimerExpirationCallback != NULL);
+
+    currentInterruptTime = BufferPool_InterruptTimeGet();
+    // Although use of WDF_ABSE_TIMEOUT_IN_MS works, it is not technically correct since the numbers are not 
+    // actually the same. Simply multiplying by the conversion from 100-ns to milliseconds is more accurate and clear.
+    //
+    BufferPoolEntry->TimerExpirationAbsoluteTime100ns = currentInterruptTime + (BufferPoolEntry->TimerExpirationMilliseconds * WDF_TIMEOUT_TO_MS);
+
+    if (0 == ModuleContext->NumberOfBuffersInTimerWheel)
+    {
+        // There is nothing to do for the ticks that passed since the timer wheel became empty.
+        //
+        ModuleContext->TimerWheelNextTick = (currentInterruptTime / BufferPool_TimerWheelTick100ns) + 1;
+    }
+
+    BufferPool_TimerWheelInsert(ModuleContext,
+                                BufferPoolEntry);
+    ModuleContext->NumberOfBuffersInTimerWheel++;
+
+    if (ModuleContext->TimerWheelClosing)
+    {
+        // The buffer is removed from the timer wheel when the list is flushed.
+        //
+        goto Exit;
+    }
+
+    if ((! ModuleContext->TimerWheelTimerStarted) ||
+        (BufferPoolEntry->TimerExpirationAbsoluteTime100ns < ModuleContext->TimerWheelDueTick * BufferPool_TimerWheelTick100ns))
+    {
+        BufferPool_TimerWheelTimerStart(ModuleContext,
+                                        currentInterruptTime);
+    }
+
+Exit:
+    ;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_TimerWheelSlotProcess(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _In_ ULONG SlotIndex,
+    _In_ ULONGLONG Tick,
+    _Inout_ LIST_ENTRY* ExpiredList
+    )
+/*++
+
+Routine Description:
+
+    Remove all the buffers from a given timer wheel slot. Buffers that expire at or before
+    the given tick are removed from the list and added to ExpiredList. The other buffers are
+    inserted in the timer wheel again (which moves them to a lower level).
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    SlotIndex - Index of the given slot.
+    Tick - The tick being processed.
+    ExpiredList - Expired buffers are added to this list using their TimerListEntry.
+
+Return Value:
+
+    None
+
+--*/
+{
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    LIST_ENTRY* slot;
+    LIST_ENTRY slotEntries;
+    LIST_ENTRY* listEntry;
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    // Take all the buffers out of the slot first because they can be inserted in the same slot again.
+    //
+    slot = &ModuleContext->TimerWheelSlots[SlotIndex];
+    InitializeListHead(&slotEntries);
+    while (! IsListEmpty(slot))
+    {
+        listEntry = RemoveHeadList(slot);
+        InsertTailList(&slotEntries,
+                       listEntry);
+    }
+
+    while (! IsListEmpty(&slotEntries))
+    {
+        listEntry = RemoveHeadList(&slotEntries);
+        bufferPoolEntry = CONTAINING_RECORD(listEntry,
+                                            BUFFERPOOL_ENTRY,
+                                            TimerListEntry);
+        DmfAssert(bufferPoolEntry->TimerExpirationCallback != NULL);
+
+        if (bufferPoolEntry->TimerExpirationAbsoluteTime100ns <= Tick * BufferPool_TimerWheelTick100ns)
+        {
+            // Remove item from list.
+            // NOTE: Client Driver owns the buffer after its timer callback is called.
+            //
+            DmfAssert(ModuleContext->NumberOfBuffersInTimerWheel > 0);
+            ModuleContext->NumberOfBuffersInTimerWheel--;
+            BufferPool_RemoveEntryList(DmfModule,
+                                       ModuleContext,
+                                       bufferPoolEntry);
+            InsertTailList(ExpiredList,
+                           listEntry);
+        }
+        else
+        {
+            BufferPool_TimerWheelInsert(ModuleContext,
+                                        bufferPoolEntry);
+        }
+    }
+}
+
+EVT_WDF_TIMER BufferPool_TimerWheelTimerHandler;
+
+VOID
+BufferPool_TimerWheelTimerHandler(
+    _In_ WDFTIMER WdfTimer
+    )
+/*++
+
+Routine Description:
+
+    Timer callback. Processes all the ticks of the timer wheel up to the current time.
+    All the buffers that expire are removed from the list and passed to the Client's
+    timer expiration callback. Upon timer expiration callback, Client owns the buffer.
+
+Parameters:
+
+    WdfTimer - The timer object whose parent is this Module.
+
+Return:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    EVT_DMF_BufferPool_TimerCallback* timerExpirationCallback;
+    VOID* timerExpirationCallbackContext;
+    LIST_ENTRY expiredList;
+    LIST_ENTRY* listEntry;
+    ULONGLONG currentInterruptTime;
+    ULONGLONG currentTick;
+    ULONGLONG tick;
+    ULONG slotIndex;
+
+    FuncEntry(DMF_TRACE);
+
+    dmfModule = (DMFMODULE)WdfTimerGetParentObject(WdfTimer);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    InitializeListHead(&expiredList);
+
+    DMF_ModuleLock(dmfModule);
+
+    currentInterruptTime = BufferPool_InterruptTimeGet();
+    currentTick = currentInterruptTime / BufferPool_TimerWheelTick100ns;
+
+    if (currentTick >= moduleContext->TimerWheelNextTick + BufferPool_TimerWheelSlots)
+    {
+        // Many ticks have passed (for example, the system was suspended). Instead of processing
+        // each tick, process all the slots once.
+        //
+        moduleContext->TimerWheelNextTick = currentTick + 1;
+        for (slotIndex = 0; slotIndex < BufferPool_TimerWheelNumberOfSlots; slotIndex++)
+        {
+            BufferPool_TimerWheelSlotProcess(dmfModule,
+                                             moduleContext,
+                                             slotIndex,
+                                             currentTick,
+                                             &expiredList);
+        }
+    }
+    else
+    {
+        while (moduleContext->TimerWheelNextTick <= currentTick)
+        {
+            tick = moduleContext->TimerWheelNextTick;
+            if (0 == (tick & BufferPool_TimerWheelSlotMask))
+            {
+                // A new block of ticks starts. Move its buffers from the higher levels to the first level.
+                //
+                if (0 == ((tick >> BufferPool_TimerWheelSlotBits) & BufferPool_TimerWheelSlotMask))
+                {
+                    BufferPool_TimerWheelSlotProcess(dmfModule,
+                                                     moduleContext,
+                                                     BufferPool_TimerWheelOverflow,
+                                                     tick,
+                                                     &expiredList);
+                }
+                BufferPool_TimerWheelSlotProcess(dmfModule,
+                                                 moduleContext,
+                                                 BufferPool_TimerWheelLevel1 + (ULONG)((tick >> BufferPool_TimerWheelSlotBits) & BufferPool_TimerWheelSlotMask),
+                                                 tick,
+                                                 &expiredList);
+            }
+            BufferPool_TimerWheelSlotProcess(dmfModule,
+                                             moduleContext,
+                                             (ULONG)(tick & BufferPool_TimerWheelSlotMask),
+                                             tick,
+                                             &expiredList);
+            moduleContext->TimerWheelNextTick++;
+        }
+    }
+
+    if ((moduleContext->NumberOfBuffersInTimerWheel > 0) &&
+        (! moduleContext->TimerWheelClosing))
+    {
+        BufferPool_TimerWheelTimerStart(moduleContext,
+                                        currentInterruptTime);
+    }
+    else
+    {
+        moduleContext->TimerWheelTimerStarted = FALSE;
+    }
+
+    DMF_ModuleUnlock(dmfModule);
+
+    // Call the Client's callbacks without holding the lock. The expired buffers are no
+    // longer in the list nor in the timer wheel so only this thread accesses them.
+    //
+    while (! IsListEmpty(&expiredList))
+    {
+        listEntry = RemoveHeadList(&expiredList);
+        bufferPoolEntry = CONTAINING_RECORD(listEntry,
+                                            BUFFERPOOL_ENTRY,
+                                            TimerListEntry);
+        bufferPoolEntry->TimerListEntry.Flink = NULL;
+        bufferPoolEntry->TimerListEntry.Blink = NULL;
+
+        // Save off the callback and its context so they can be passed to Client after the
+        // timer fields are cleared.
+        //
+        timerExpirationCallback = bufferPoolEntry->TimerExpirationCallback;
+        timerExpirationCallbackContext = bufferPoolEntry->TimerExpirationCallbackContext;
+        bufferPoolEntry->TimerExpirationMilliseconds = 0;
+        bufferPoolEntry->TimerExpirationAbsoluteTime100ns = 0;
+        bufferPoolEntry->TimerExpirationCallback = NULL;
+        bufferPoolEntry->TimerExpirationCallbackContext = NULL;
+
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "BufferPool Entry timer expires");
+
+        // Call the client driver's timer callback function.
+        //
+        timerExpirationCallback(dmfModule,
+                                bufferPoolEntry->ClientBuffer,
+                                bufferPoolEntry->ClientBufferContext,
+                                timerExpirationCallbackContext);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+#if defined(DMF_USER_MODE)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+#else
+_IRQL_requires_max_(DISPATCH_LEVEL)
+#endif // defined(DMF_USER_MODE)
+_Must_inspect_result_
+NTSTATUS
+BufferPool_BufferPoolEntryCreateAndAddToList(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Creates a new Client Buffer BUFFERPOOL_ENTRY and adds the Client Buffer to the
+    list of buffers.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    DMF_CONFIG_BufferPool* moduleConfig;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY memory;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+
+    FuncEntry(DMF_TRACE);
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Allocate space for the list entry that holds the meta data for the buffer.
+    //
+    ntStatus = DMF_Portable_LookasideListCreateMemory(&moduleContext->LookasideList,
+                                                      &memory);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreateFromLookaside ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    // Add WDF custom type for buffer memory.
+    //
+    ntStatus = WdfObjectAddCustomType(memory,
+                                      DMF_BufferPool_Buffer);
+    if (!NT_SUCCESS(ntStatus)) {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfObjectAddCustomType fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    // Populate the buffer meta-data.
+    //
+    bufferPoolEntry = (BUFFERPOOL_ENTRY*)WdfMemoryGetBuffer(memory,
+                                                            NULL);
+
+    bufferPoolEntry->Signature = BufferPool_Signature;
+    bufferPoolEntry->CreatedByDmfModule = DmfModule;
+    bufferPoolEntry->CurrentlyInsertedList = NULL;
+    bufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
+    bufferPoolEntry->BufferPoolEntryMemory = memory;
+    bufferPoolEntry->SizeOfBufferPoolEntry = sizeof(BUFFERPOOL_ENTRY);
+    bufferPoolEntry->SizeOfClientBuffer = moduleConfig->Mode.SourceSettings.BufferSize;
+    bufferPoolEntry->BufferContextSize = moduleConfig->Mode.SourceSettings.BufferContextSize;
+    // The client buffer is located immediately after the buffer list entry.
+    //
+    bufferPoolEntry->ClientBuffer = (UCHAR*)((UCHAR*)bufferPoolEntry + moduleContext->ClientBufferOffset);
+    // For validation purposes to check for buffer overrun.
+    //
+    bufferPoolEntry->SentinelData = (BufferPool_SentinelType*)(UCHAR*)((UCHAR*)bufferPoolEntry + moduleContext->DataSentinelOffset);
+    *(bufferPoolEntry->SentinelData) = BufferPool_SentinelData;
+    // The client buffer context is located immediately after the buffer sentinel data.
+    //
+    bufferPoolEntry->ClientBufferContext = (UCHAR*)((UCHAR*)bufferPoolEntry + moduleContext->ClientBufferContextOffset);
+    // For validation purposes to check for buffer context overrun.
+    //
+    bufferPoolEntry->SentinelContext = (BufferPool_SentinelType*)((UCHAR*)bufferPoolEntry + moduleContext->ContextSentinelOffset);
+    *(bufferPoolEntry->SentinelContext) = BufferPool_SentinelContext;
+    // Timer related. The buffer is added to a timer wheel only when it is put in a Sink with a timer.
+    //
+    bufferPoolEntry->TimerListEntry.Blink = NULL;
+    bufferPoolEntry->TimerListEntry.Flink = NULL;
+    BufferPool_TimerFieldsClear(DmfModule,
+                                bufferPoolEntry);
+    // List related.
+    //
+    bufferPoolEntry->ListEntry.Blink = NULL;
+    bufferPoolEntry->ListEntry.Flink = NULL;
+
+    // Initialize the client buffer context to all zeros.
+    //
+    RtlZeroMemory(bufferPoolEntry->ClientBufferContext,
+                  bufferPoolEntry->BufferContextSize);
+
+    // Create the Client Memory Handle.
+    // Some functions use Memory Descriptors and Offsets. Others use Memory Handles.
+    // -----------------------------------------------------------------------------
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = bufferPoolEntry->BufferPoolEntryMemory;
+
+    // Prevent SAL "parameter must not be zero" error.
+    //
+    #pragma warning(suppress:28160)
+    ntStatus = WdfMemoryCreatePreallocated(&objectAttributes,
+                                           bufferPoolEntry->ClientBuffer,
+                                           bufferPoolEntry->SizeOfClientBuffer,
+                                           &bufferPoolEntry->ClientBufferMemory);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreatePreallocated ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(&bufferPoolEntry->MemoryDescriptor,
+                                      bufferPoolEntry->ClientBufferMemory,
+                                      NULL);
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Create Buffer: BufferPoolMemory=0x%p SizeOfClientBuffer=%d ClientBufferMemory=0x%p", bufferPoolEntry->BufferPoolEntryMemory, bufferPoolEntry->SizeOfClientBuffer, bufferPoolEntry->ClientBufferMemory);
+
+    // Add the buffer to the list. (This function validates that the buffer has
+    // not already been added to another list in DEBUG mode.)
+    // NOTE: This entry goes directly into the list. Do not call BufferPool_BufferPoolEntryPut because
+    //       that function will filter buffers put into the list and delete the entries when EnableLookAside is TRUE.
+    //
+    BufferPool_InsertList(DmfModule,
+                          moduleContext,
+                          bufferPoolEntry,
+                          BufferPool_InsertTailList);
+
+Exit:
+
+    DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) &&
+              (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient)) ||
+              (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+WDFMEMORY
+BufferPool_BufferPoolEntryGetLocked(
+    _In_ DMFMODULE DmfModule,
+    _Out_ BUFFERPOOL_ENTRY** BufferPoolEntry
+    )
+/*++
+
+Routine Description:
+
+    Remove the next entry (head of list) if it is present. If it is not present,
+    and if the client instantiated the Module with EnableLookAside = TRUE, then a
+    new entry is created from the associated lookaside list add added to the list.
+    It is removed and returned to the client.
+    NOTE: The caller must hold the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    BufferPoolEntry - The associated BUFFERPOOL_ENTRY.
+
+Return Value:
+
+    NULL means there is no buffer to remove from the list; otherwise, it is the
+    WDF Memory of the entry removed from the list.
+
+--*/
+{
+    DMF_CONTEXT_BufferPool* moduleContext;
+    WDFMEMORY returnValue;
+    BUFFERPOOL_ENTRY* bufferPoolEntryLocal;
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(BufferPoolEntry != NULL);
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) && 
+              (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient)) ||
+              (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+
+    bufferPoolEntryLocal = BufferPool_FirstBufferPeek(DmfModule,
+                                                      moduleContext);
+    if (NULL == bufferPoolEntryLocal)
+    {
+        DmfAssert(moduleContext->NumberOfBuffersInList == 0);
+        // If the Client instantiated the Module with EnableLookAside = TRUE,
+        // then create a new buffer and add it to the list.
+        //
+        if (moduleContext->EnableLookAside)
+        {
+            NTSTATUS ntStatus;
+
+            ntStatus = BufferPool_BufferPoolEntryCreateAndAddToList(DmfModule);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                goto Exit;
+            }
+
+            // Track the number of additional buffers beside those initially allocated.
+            //
+            moduleContext->NumberOfAdditionalBuffersAllocated++;
+            moduleContext->AdaptiveOverflowAllocations++;
+            // The new buffer was not returned by Client so it is not one less buffer in use.
+            //
+            moduleContext->BuffersUsed++;
+
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Add Additional Buffer NumberOfAdditionalBuffersAllocated=%d", moduleContext->NumberOfAdditionalBuffersAllocated);
+
+            DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) && 
+                      (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient)) ||
+                      (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+
+            // We just created and added a new buffer. Now get it from the list.
+            //
+            bufferPoolEntryLocal = BufferPool_RemoveHeadList(DmfModule,
+                                                             moduleContext);
+        }
+        else
+        {
+            // Return no buffer because there is no buffer in the list.
+            //
+            DmfAssert(NULL == bufferPoolEntryLocal);
+        }
+    }
+    else
+    {
+        bufferPoolEntryLocal = BufferPool_RemoveHeadList(DmfModule,
+                                                         moduleContext);
+    }
+
+Exit:
+
+    *BufferPoolEntry = bufferPoolEntryLocal;
+    if (bufferPoolEntryLocal != NULL)
+    {
+        if (moduleContext->Caches != NULL)
+        {
+            BufferPool_AdaptiveUsageSample(DmfModule,
+                                           moduleContext);
+        }
+        returnValue = bufferPoolEntryLocal->BufferPoolEntryMemory;
+    }
+    else
+    {
+        returnValue = NULL;
+    }
+
+    DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) && 
+              (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient)) ||
+              (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Remove Entry: MemoryHandle=0x%p", returnValue);
+
+    FuncExit(DMF_TRACE, "returnValue=0x%p", returnValue);
+
+    return returnValue;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+WDFMEMORY
+BufferPool_BufferPoolEntryGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ BUFFERPOOL_ENTRY** BufferPoolEntry
+    )
+/*++
+
+Routine Description:
+
+    Remove the next entry (head of list) while holding the Module lock.
+    See BufferPool_BufferPoolEntryGetLocked().
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    BufferPoolEntry - The associated BUFFERPOOL_ENTRY.
+
+Return Value:
+
+    NULL means there is no buffer to remove from the list; otherwise, it is the
+    WDF Memory of the entry removed from the list.
+
+--*/
+{
+    WDFMEMORY returnValue;
+
+    DMF_ModuleLock(DmfModule);
+
+    returnValue = BufferPool_BufferPoolEntryGetLocked(DmfModule,
+                                                      BufferPoolEntry);
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return returnValue;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_BufferPoolEntryValidate(
+    _In_ BUFFERPOOL_ENTRY* BufferPoolEntry,
+    _In_ WDFMEMORY BufferPoolEntryMemory
+    )
+/*++
+
+Routine Description:
+
+    Validate a buffer that has just been removed from the list before it is returned to Client.
+
+Arguments:
+
+    BufferPoolEntry - The buffer removed from the list.
+    BufferPoolEntryMemory - The WDF Memory of the buffer removed from the list.
+
+Return Value:
+
+    None
+
+--*/
+{
+    UNREFERENCED_PARAMETER(BufferPoolEntryMemory);
+
+    DmfAssert(BufferPoolEntry != NULL);
+    DmfVerifierAssert("DMF_BufferPool signature mismatch", 
+                      BufferPoolEntry->Signature == BufferPool_Signature);
+    DmfVerifierAssert("DMF_BufferPool data sentinel mismatch", 
+                      *(BufferPoolEntry->SentinelData) == BufferPool_SentinelData);
+    DmfVerifierAssert("DMF_BufferPool context sentinel mismatch", 
+                      *(BufferPoolEntry->SentinelContext) == BufferPool_SentinelContext);
+    DmfAssert(BufferPoolEntry->BufferPoolEntryMemory == BufferPoolEntryMemory);
+    DmfAssert(BufferPoolEntry->ClientBuffer != NULL);
+    DmfAssert(sizeof(BUFFERPOOL_ENTRY) == BufferPoolEntry->SizeOfBufferPoolEntry);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+VOID*
+BufferPool_BufferGet(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG RequestedSize
+    )
+/*++
+
+Routine Description:
+
+    Remove the next entry (head of list) if it is present. If it is not present,
+    and if the Client instantiated the Module with EnableLookAside = TRUE, then a new entry
+    is created from the associated lookaside list add added to the list. It is
+    removed and returned to the client.
+    If per-processor caches are enabled, the entry is taken from the caches first.
+    If the Module has size classes, the entry is taken from the smallest size class that
+    fits RequestedSize and has a buffer available.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    RequestedSize - Minimum size of the buffer. Only used when the Module has size classes.
+
+Return Value:
+
+    The address of the Client Buffer retrieved from the list; otherwise NULL to indicate
+    that the list is empty.
+
+--*/
+{
+    DMF_CONTEXT_BufferPool* moduleContext;
+    DMF_CONFIG_BufferPool* moduleConfig;
+    WDFMEMORY bufferPoolEntryMemory;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    VOID* returnValue;
+    ULONG sizeClassIndex;
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    returnValue = NULL;
+    bufferPoolEntry = NULL;
+    bufferPoolEntryMemory = NULL;
+
+    if (moduleContext->NumberOfSizeClasses > 0)
+    {
+        // Use the smallest size class that fits. If it has no buffers, use the next larger one.
+        //
+        moduleConfig = DMF_CONFIG_GET(DmfModule);
+        for (sizeClassIndex = 0; sizeClassIndex < moduleContext->NumberOfSizeClasses; sizeClassIndex++)
+        {
+            if (moduleConfig->Mode.SourceSettings.SizeClasses[sizeClassIndex].BufferSize < RequestedSize)
+            {
+                continue;
+            }
+
+            returnValue = BufferPool_BufferGet(moduleContext->DmfModuleBufferPoolSizeClass[sizeClassIndex],
+                                               0);
+            if (returnValue != NULL)
+            {
+                break;
+            }
+        }
+        goto Exit;
+    }
+
+    if (moduleContext->Caches != NULL)
+    {
+        bufferPoolEntry = BufferPool_CacheGet(DmfModule,
+                                              moduleContext);
+        if (bufferPoolEntry != NULL)
+        {
+            bufferPoolEntryMemory = bufferPoolEntry->BufferPoolEntryMemory;
+        }
+    }
+
+    if (NULL == bufferPoolEntry)
+    {
+        bufferPoolEntryMemory = BufferPool_BufferPoolEntryGet(DmfModule,
+                                                              &bufferPoolEntry);
+    }
+    if (NULL == bufferPoolEntryMemory)
+    {
+        goto Exit;
+    }
+
+    BufferPool_BufferPoolEntryValidate(bufferPoolEntry,
+                                       bufferPoolEntryMemory);
+
+    returnValue = bufferPoolEntry->ClientBuffer;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "returnValue=0x%p", returnValue);
+
+    return returnValue;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+BufferPool_CachesCreate(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Allocate one empty cache of buffers per processor.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    DMF_CONFIG_BufferPool* moduleConfig;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    BUFFERPOOL_CACHE* cache;
+    ULONG cacheIndex;
+    VOID* cacheMemory;
+
+    FuncEntry(DMF_TRACE);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // The memory is kept when the Module closes because Put may still be called while
+    // the Module is closing. In that case, the closed caches are not used.
+    //
+    if (NULL == moduleContext->CacheMemory)
+    {
+#if defined(DMF_USER_MODE)
+        moduleContext->NumberOfCaches = GetMaximumProcessorCount(ALL_PROCESSOR_GROUPS);
+#else
+        moduleContext->NumberOfCaches = KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS);
+#endif
+        DmfAssert(moduleContext->NumberOfCaches > 0);
+        moduleContext->CacheSize = moduleConfig->Mode.SourceSettings.PerProcessorCacheSize;
+        moduleContext->CacheStride = WDF_ALIGN_SIZE_UP(FIELD_OFFSET(BUFFERPOOL_CACHE, Entries) +
+                                                       (moduleContext->CacheSize * sizeof(BUFFERPOOL_ENTRY*)),
+                                                       BufferPool_CacheLineSize);
+
+        // Caches are used while the Module lock is held so they must be in nonpaged pool.
+        // Allocate an extra cache line so that the first cache can be aligned.
+        //
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        ntStatus = WdfMemoryCreate(&objectAttributes,
+                                   NonPagedPoolNx,
+                                   MemoryTag,
+                                   (moduleContext->NumberOfCaches * moduleContext->CacheStride) + BufferPool_CacheLineSize,
+                                   &moduleContext->CacheMemory,
+                                   &cacheMemory);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+            moduleContext->CacheMemory = NULL;
+            goto Exit;
+        }
+
+        moduleContext->Caches = (UCHAR*)WDF_ALIGN_SIZE_UP((ULONG_PTR)cacheMemory,
+                                                          BufferPool_CacheLineSize);
+    }
+
+    for (cacheIndex = 0; cacheIndex < moduleContext->NumberOfCaches; cacheIndex++)
+    {
+        cache = (BUFFERPOOL_CACHE*)(moduleContext->Caches + (cacheIndex * moduleContext->CacheStride));
+        cache->NumberOfEntries = 0;
+        InterlockedExchange(&cache->State,
+                            BufferPool_CacheAvailable);
+    }
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Create Caches: NumberOfCaches=%d CacheSize=%d",
+                moduleContext->NumberOfCaches,
+                moduleContext->CacheSize);
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+BufferPool_TimerWheelCreate(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Allocate the timer wheel and the timer that expires the buffers put in the list
+    with a timer.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
 
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    NTSTATUS
 
-    moduleConfig = DMF_CONFIG_GET(DmfModule);
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDF_TIMER_CONFIG timerConfig;
+    ULONG slotIndex;
+    VOID* timerWheelMemory;
+
+    FuncEntry(DMF_TRACE);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    // Allocate space for the list entry that holds the meta data for the buffer.
+    // The timer and the slots are kept when the Module closes.
     //
-    ntStatus = DMF_Portable_LookasideListCreateMemory(&moduleContext->LookasideList,
-                                                      &memory);
-    if (! NT_SUCCESS(ntStatus))
+    if (NULL == moduleContext->TimerWheelMemory)
     {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreateFromLookaside ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
-    }
+        // The slots are used while the Module lock is held so they must be in nonpaged pool.
+        //
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        ntStatus = WdfMemoryCreate(&objectAttributes,
+                                   NonPagedPoolNx,
+                                   MemoryTag,
+                                   BufferPool_TimerWheelNumberOfSlots * sizeof(LIST_ENTRY),
+                                   &moduleContext->TimerWheelMemory,
+                                   &timerWheelMemory);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+            moduleContext->TimerWheelMemory = NULL;
+            goto Exit;
+        }
 
-    // Add WDF custom type for buffer memory.
-    //
-    ntStatus = WdfObjectAddCustomType(memory,
-                                      DMF_BufferPool_Buffer);
-    if (!NT_SUCCESS(ntStatus)) {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfObjectAddCustomType fails: ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
+        moduleContext->TimerWheelSlots = (LIST_ENTRY*)timerWheelMemory;
+        for (slotIndex = 0; slotIndex < BufferPool_TimerWheelNumberOfSlots; slotIndex++)
+        {
+            InitializeListHead(&moduleContext->TimerWheelSlots[slotIndex]);
+        }
     }
 
-    // Populate the buffer meta-data.
-    //
-    bufferPoolEntry = (BUFFERPOOL_ENTRY*)WdfMemoryGetBuffer(memory,
-                                                            NULL);
-
-    bufferPoolEntry->Signature = BufferPool_Signature;
-    bufferPoolEntry->CreatedByDmfModule = DmfModule;
-    bufferPoolEntry->CurrentlyInsertedList = NULL;
-    bufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
-    bufferPoolEntry->BufferPoolEntryMemory = memory;
-    bufferPoolEntry->SizeOfBufferPoolEntry = sizeof(BUFFERPOOL_ENTRY);
-    bufferPoolEntry->SizeOfClientBuffer = moduleConfig->Mode.SourceSettings.BufferSize;
-    bufferPoolEntry->BufferContextSize = moduleConfig->Mode.SourceSettings.BufferContextSize;
-    // The client buffer is located immediately after the buffer list entry.
-    //
-    bufferPoolEntry->ClientBuffer = (UCHAR*)((UCHAR*)bufferPoolEntry + moduleContext->ClientBufferOffset);
-    // For validation purposes to check for buffer overrun.
-    //
-    bufferPoolEntry->SentinelData = (BufferPool_SentinelType*)(UCHAR*)((UCHAR*)bufferPoolEntry + moduleContext->DataSentinelOffset);
-    *(bufferPoolEntry->SentinelData) = BufferPool_SentinelData;
-    // The client buffer context is located immediately after the buffer sentinel data.
-    //
-    bufferPoolEntry->ClientBufferContext = (UCHAR*)((UCHAR*)bufferPoolEntry + moduleContext->ClientBufferContextOffset);
-    // For validation purposes to check for buffer context overrun.
-    //
-    bufferPoolEntry->SentinelContext = (BufferPool_SentinelType*)((UCHAR*)bufferPoolEntry + moduleContext->ContextSentinelOffset);
-    *(bufferPoolEntry->SentinelContext) = BufferPool_SentinelContext;
-    // Timer related.
-    //
-    if (moduleConfig->Mode.SourceSettings.CreateWithTimer)
+    if (NULL == moduleContext->TimerWheelTimer)
     {
+        // Client's timer expiration callbacks are called at PASSIVE_LEVEL.
+        //
         WDF_TIMER_CONFIG_INIT(&timerConfig,
-                              BufferPool_BufferPoolEntryTimerHandler);
+                              BufferPool_TimerWheelTimerHandler);
+        timerConfig.AutomaticSerialization = FALSE;
 
-        WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
-        WDF_OBJECT_ATTRIBUTES_SET_CONTEXT_TYPE(&timerAttributes,
-                                               BUFFERPOOL_TIMER_CONTEXT);
-        // NOTE: Make the memory associated with buffer list entry, the parent of the timer.
-        // The parent will remain relevant even if the list entry is moved from one collection to another.
-        //
-        timerAttributes.ExecutionLevel = WdfExecutionLevelPassive;
-        timerAttributes.ParentObject = bufferPoolEntry->BufferPoolEntryMemory;
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        objectAttributes.ExecutionLevel = WdfExecutionLevelPassive;
 
-        // Create the timer the first time this API is used. This prevents many unnecessary timers
-        // from being created when timers are not used.
-        //
         ntStatus = WdfTimerCreate(&timerConfig,
-                                  &timerAttributes,
-                                  &bufferPoolEntry->Timer);
-        if (!NT_SUCCESS(ntStatus))
+                                  &objectAttributes,
+                                  &moduleContext->TimerWheelTimer);
+        if (! NT_SUCCESS(ntStatus))
         {
             TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfTimerCreate fails: ntStatus=%!STATUS!", ntStatus);
+            moduleContext->TimerWheelTimer = NULL;
             goto Exit;
         }
-
-        // Save this BUFFERPOOL_ENTRY pointer in the Timer's context.
-        //
-        bufferPoolTimerContext = WdfObjectGet_BUFFERPOOL_TIMER_CONTEXT(bufferPoolEntry->Timer);
-        bufferPoolTimerContext->BufferPoolEntry = bufferPoolEntry;
-        bufferPoolTimerContext->DmfModuleInsertedList = DmfModule;
-    }
-    else
-    {
-        bufferPoolEntry->Timer = NULL;
-    }
-    BufferPool_TimerFieldsClear(DmfModule,
-                                bufferPoolEntry);
-    // List related.
-    //
-    bufferPoolEntry->ListEntry.Blink = NULL;
-    bufferPoolEntry->ListEntry.Flink = NULL;
-
-    // Initialize the client buffer context to all zeros.
-    //
-    RtlZeroMemory(bufferPoolEntry->ClientBufferContext,
-                  bufferPoolEntry->BufferContextSize);
-
-    // Create the Client Memory Handle.
-    // Some functions use Memory Descriptors and Offsets. Others use Memory Handles.
-    // -----------------------------------------------------------------------------
-    //
-    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
-    objectAttributes.ParentObject = bufferPoolEntry->BufferPoolEntryMemory;
-
-    // Prevent SAL "parameter must not be zero" error.
-    //
-    #pragma warning(suppress:28160)
-    ntStatus = WdfMemoryCreatePreallocated(&objectAttributes,
-                                           bufferPoolEntry->ClientBuffer,
-                                           bufferPoolEntry->SizeOfClientBuffer,
-                                           &bufferPoolEntry->ClientBufferMemory);
-    if (! NT_SUCCESS(ntStatus))
-    {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreatePreallocated ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
     }
 
-    WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(&bufferPoolEntry->MemoryDescriptor,
-                                      bufferPoolEntry->ClientBufferMemory,
-                                      NULL);
-
-    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Create Buffer: BufferPoolMemory=0x%p SizeOfClientBuffer=%d ClientBufferMemory=0x%p", bufferPoolEntry->BufferPoolEntryMemory, bufferPoolEntry->SizeOfClientBuffer, bufferPoolEntry->ClientBufferMemory);
+    DmfAssert(0 == moduleContext->NumberOfBuffersInTimerWheel);
+    moduleContext->TimerWheelTimerStarted = FALSE;
+    moduleContext->TimerWheelClosing = FALSE;
 
-    // Add the buffer to the list. (This function validates that the buffer has
-    // not already been added to another list in DEBUG mode.)
-    // NOTE: This entry goes directly into the list. Do not call BufferPool_BufferPoolEntryPut because
-    //       that function will filter buffers put into the list and delete the entries when EnableLookAside is TRUE.
-    //
-    BufferPool_InsertList(DmfModule,
-                          moduleContext,
-                          bufferPoolEntry,
-                          BufferPool_InsertTailList);
+    ntStatus = STATUS_SUCCESS;
 
 Exit:
 
-    DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) &&
-              (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient)) ||
-              (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
-
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
     return ntStatus;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-_Must_inspect_result_
-WDFMEMORY
-BufferPool_BufferPoolEntryGet(
+VOID
+BufferPool_AdaptiveBufferCountSet(
     _In_ DMFMODULE DmfModule,
-    _Out_ BUFFERPOOL_ENTRY** BufferPoolEntry
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _In_ ULONG BufferCount
     )
 /*++
 
 Routine Description:
 
-    Remove the next entry (head of list) if it is present. If it is not present,
-    and if the client instantiated the Module with EnableLookAside = TRUE, then a
-    new entry is created from the associated lookaside list add added to the list.
-    It is removed and returned to the client.
+    Change the number of buffers kept in the list. When it grows, buffers allocated from the
+    lookaside list that are in use are kept when they are returned and the rest are allocated now.
+    When it shrinks, buffers in the list are deleted now and buffers in use are deleted when
+    they are returned.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    BufferPoolEntry - The associated BUFFERPOOL_ENTRY.
+    ModuleContext - This Module's context.
+    BufferCount - The new number of buffers kept in the list.
 
 Return Value:
 
-    NULL means there is no buffer to remove from the list; otherwise, it is the
-    WDF Memory of the entry removed from the list.
+    None
 
 --*/
 {
-    DMF_CONTEXT_BufferPool* moduleContext;
-    WDFMEMORY returnValue;
-    BUFFERPOOL_ENTRY* bufferPoolEntryLocal;
+    NTSTATUS ntStatus;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    ULONG convertedBuffers;
 
     FuncEntry(DMF_TRACE);
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-
-    DmfAssert(BufferPoolEntry != NULL);
-
-    DMF_ModuleLock(DmfModule);
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    DmfAssert(ModuleContext->EnableLookAside);
 
-    DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) && 
-              (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient)) ||
-              (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "NumberOfBuffersSpecifiedByClient=%d BufferCount=%d",
+                ModuleContext->NumberOfBuffersSpecifiedByClient,
+                BufferCount);
 
-    bufferPoolEntryLocal = BufferPool_FirstBufferPeek(DmfModule,
-                                                      moduleContext);
-    if (NULL == bufferPoolEntryLocal)
+    if (BufferCount > ModuleContext->NumberOfBuffersSpecifiedByClient)
     {
-        DmfAssert(moduleContext->NumberOfBuffersInList == 0);
-        // If the Client instantiated the Module with EnableLookAside = TRUE,
-        // then create a new buffer and add it to the list.
+        // Additional buffers that are in use stay in the list when they are returned.
         //
-        if (moduleContext->EnableLookAside)
+        convertedBuffers = BufferCount - ModuleContext->NumberOfBuffersSpecifiedByClient;
+        if (convertedBuffers > ModuleContext->NumberOfAdditionalBuffersAllocated)
         {
-            NTSTATUS ntStatus;
+            convertedBuffers = ModuleContext->NumberOfAdditionalBuffersAllocated;
+        }
+        ModuleContext->NumberOfAdditionalBuffersAllocated -= convertedBuffers;
+        ModuleContext->NumberOfBuffersSpecifiedByClient += convertedBuffers;
 
+        // Allocate the rest.
+        //
+        while (ModuleContext->NumberOfBuffersSpecifiedByClient < BufferCount)
+        {
+            ModuleContext->NumberOfBuffersSpecifiedByClient++;
             ntStatus = BufferPool_BufferPoolEntryCreateAndAddToList(DmfModule);
             if (! NT_SUCCESS(ntStatus))
             {
-                goto Exit;
+                ModuleContext->NumberOfBuffersSpecifiedByClient--;
+                break;
+            }
+            // Adding a new buffer to the list does not return a buffer in use.
+            //
+            ModuleContext->BuffersUsed++;
+        }
+    }
+    else
+    {
+        while (ModuleContext->NumberOfBuffersSpecifiedByClient > BufferCount)
+        {
+            bufferPoolEntry = BufferPool_RemoveHeadList(DmfModule,
+                                                        ModuleContext);
+            if (NULL == bufferPoolEntry)
+            {
+                // The rest are in use. Delete them when they are returned.
+                //
+                ModuleContext->NumberOfAdditionalBuffersAllocated += ModuleContext->NumberOfBuffersSpecifiedByClient - BufferCount;
+                ModuleContext->NumberOfBuffersSpecifiedByClient = BufferCount;
+                break;
             }
 
-            // Track the number of additional buffers beside those initially allocated.
+            // Deleting a buffer from the list does not take a buffer in use.
             //
-            moduleContext->NumberOfAdditionalBuffersAllocated++;
+            ModuleContext->BuffersUsed--;
+            ModuleContext->NumberOfBuffersSpecifiedByClient--;
+            WdfObjectDelete(bufferPoolEntry->BufferPoolEntryMemory);
+        }
+    }
 
-            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Add Additional Buffer NumberOfAdditionalBuffersAllocated=%d", moduleContext->NumberOfAdditionalBuffersAllocated);
+    FuncExitVoid(DMF_TRACE);
+}
 
-            DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) && 
-                      (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient)) ||
-                      (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+EVT_WDF_TIMER BufferPool_AdaptiveTimerHandler;
 
-            // We just created and added a new buffer. Now get it from the list.
-            //
-            bufferPoolEntryLocal = BufferPool_RemoveHeadList(DmfModule,
-                                                             moduleContext);
+_Use_decl_annotations_
+VOID
+BufferPool_AdaptiveTimerHandler(
+    _In_ WDFTIMER WdfTimer
+    )
+/*++
+
+Routine Description:
+
+    Timer callback. Runs once per interval and decides how many buffers to keep in the list
+    based on how the buffers were used during the interval. If the number changes, it is
+    saved in the registry (if Client specified a registry value).
+
+Parameters:
+
+    WdfTimer - The timer object whose parent is this Module.
+
+Return:
+
+    None
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    DMF_CONFIG_BufferPool* moduleConfig;
+    ULONG bufferCount;
+    ULONG newBufferCount;
+    LONG intervalMaximumBuffersUsed;
+    BOOLEAN bufferCountChanged;
+
+    FuncEntry(DMF_TRACE);
+
+    dmfModule = (DMFMODULE)WdfTimerGetParentObject(WdfTimer);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+    moduleConfig = DMF_CONFIG_GET(dmfModule);
+
+    bufferCountChanged = FALSE;
+
+    DMF_ModuleLock(dmfModule);
+
+    if (moduleContext->AdaptiveClosing)
+    {
+        DMF_ModuleUnlock(dmfModule);
+        goto Exit;
+    }
+
+    bufferCount = moduleContext->NumberOfBuffersSpecifiedByClient;
+    intervalMaximumBuffersUsed = moduleContext->AdaptiveIntervalMaximumBuffersUsed;
+    if (intervalMaximumBuffersUsed < 0)
+    {
+        intervalMaximumBuffersUsed = 0;
+    }
+
+    if ((moduleContext->AdaptiveOverflowAllocations >= BufferPool_AdaptiveGrowThreshold) &&
+        ((ULONG)intervalMaximumBuffersUsed > bufferCount) &&
+        (bufferCount < moduleContext->AdaptiveBufferCountMaximum))
+    {
+        // Buffers are frequently allocated from the lookaside list. Keep as many buffers
+        // as were used during this interval.
+        //
+        newBufferCount = (ULONG)intervalMaximumBuffersUsed;
+        if (newBufferCount > moduleContext->AdaptiveBufferCountMaximum)
+        {
+            newBufferCount = moduleContext->AdaptiveBufferCountMaximum;
         }
-        else
+        BufferPool_AdaptiveBufferCountSet(dmfModule,
+                                          moduleContext,
+                                          newBufferCount);
+        moduleContext->AdaptiveIdleIntervals = 0;
+    }
+    else if (((ULONG)intervalMaximumBuffersUsed < bufferCount) &&
+             (bufferCount > moduleConfig->Mode.SourceSettings.BufferCount))
+    {
+        // Some buffers in the list were not used. Only release them after they have not been
+        // used for many intervals so that the list does not shrink during short pauses.
+        //
+        if ((0 == moduleContext->AdaptiveIdleIntervals) ||
+            (intervalMaximumBuffersUsed > moduleContext->AdaptiveIdleMaximumBuffersUsed))
         {
-            // Return no buffer because there is no buffer in the list.
-            //
-            DmfAssert(NULL == bufferPoolEntryLocal);
+            moduleContext->AdaptiveIdleMaximumBuffersUsed = intervalMaximumBuffersUsed;
+        }
+        moduleContext->AdaptiveIdleIntervals++;
+        if (moduleContext->AdaptiveIdleIntervals >= BufferPool_AdaptiveIdleIntervals)
+        {
+            newBufferCount = (ULONG)moduleContext->AdaptiveIdleMaximumBuffersUsed;
+            if (newBufferCount < moduleConfig->Mode.SourceSettings.BufferCount)
+            {
+                newBufferCount = moduleConfig->Mode.SourceSettings.BufferCount;
+            }
+            BufferPool_AdaptiveBufferCountSet(dmfModule,
+                                              moduleContext,
+                                              newBufferCount);
+            moduleContext->AdaptiveIdleIntervals = 0;
         }
     }
     else
     {
-        bufferPoolEntryLocal = BufferPool_RemoveHeadList(DmfModule,
-                                                         moduleContext);
+        moduleContext->AdaptiveIdleIntervals = 0;
     }
 
-Exit:
+    // Start the next interval.
+    //
+    moduleContext->AdaptiveOverflowAllocations = 0;
+    moduleContext->AdaptiveIntervalMaximumBuffersUsed = BufferPool_AdaptiveBuffersUsedGet(moduleContext);
 
-    *BufferPoolEntry = bufferPoolEntryLocal;
-    if (bufferPoolEntryLocal != NULL)
+    if (moduleContext->NumberOfBuffersSpecifiedByClient != bufferCount)
     {
-        returnValue = bufferPoolEntryLocal->BufferPoolEntryMemory;
+        bufferCountChanged = TRUE;
+        bufferCount = moduleContext->NumberOfBuffersSpecifiedByClient;
+    }
+
+    // Do not run while the list is not used. Keep running while unused buffers are counted
+    // down to be released.
+    //
+    if (moduleContext->AdaptiveActivity ||
+        (moduleContext->AdaptiveIdleIntervals > 0))
+    {
+        moduleContext->AdaptiveActivity = FALSE;
+        WdfTimerStart(WdfTimer,
+                      WDF_REL_TIMEOUT_IN_MS(BufferPool_AdaptiveIntervalMilliseconds));
     }
     else
     {
-        returnValue = NULL;
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Adaptive timer stops: list not used");
+        moduleContext->AdaptiveTimerStarted = FALSE;
     }
 
-    DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) && 
-              (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient)) ||
-              (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
-
-    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Remove Entry: MemoryHandle=0x%p", returnValue);
+    DMF_ModuleUnlock(dmfModule);
 
-    DMF_ModuleUnlock(DmfModule);
+    // Save the new number so that the next time the Module opens it preallocates that many buffers.
+    //
+    if (bufferCountChanged &&
+        (moduleContext->DmfModuleRegistry != NULL))
+    {
+        ntStatus = DMF_Registry_PathAndValueWriteDword(moduleContext->DmfModuleRegistry,
+                                                       moduleConfig->Mode.SourceSettings.AdaptiveRegistryPathName,
+                                                       moduleConfig->Mode.SourceSettings.AdaptiveRegistryValueName,
+                                                       bufferCount);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Registry_PathAndValueWriteDword fails: ntStatus=%!STATUS!", ntStatus);
+        }
+    }
 
-    FuncExit(DMF_TRACE, "returnValue=0x%p", returnValue);
+Exit:
 
-    return returnValue;
+    FuncExitVoid(DMF_TRACE);
 }
 
-_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_max_(PASSIVE_LEVEL)
 _Must_inspect_result_
-VOID*
-BufferPool_BufferGet(
+NTSTATUS
+BufferPool_AdaptiveCreate(
     _In_ DMFMODULE DmfModule
     )
 /*++
 
 Routine Description:
 
-    Remove the next entry (head of list) if it is present. If it is not present,
-    and if the Client instantiated the Module with EnableLookAside = TRUE, then a new entry
-    is created from the associated lookaside list add added to the list. It is
-    removed and returned to the client.
+    Prepare adaptive preallocation: read the number of buffers to preallocate that was saved
+    in the registry (if any) and create the timer that adjusts it.
 
 Arguments:
 
@@ -1167,44 +2963,84 @@ Arguments:
 
 Return Value:
 
-    The address of the Client Buffer retrieved from the list; otherwise NULL to indicate
-    that the list is empty.
+    NTSTATUS
 
 --*/
 {
-    WDFMEMORY bufferPoolEntryMemory;
-    BUFFERPOOL_ENTRY* bufferPoolEntry;
-    VOID* returnValue;
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    DMF_CONFIG_BufferPool* moduleConfig;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDF_TIMER_CONFIG timerConfig;
+    ULONG bufferCount;
 
     FuncEntry(DMF_TRACE);
 
-    returnValue = NULL;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
 
-    bufferPoolEntryMemory = BufferPool_BufferPoolEntryGet(DmfModule,
-                                                          &bufferPoolEntry);
-    if (NULL == bufferPoolEntryMemory)
+    moduleContext->AdaptiveBufferCountMaximum = moduleConfig->Mode.SourceSettings.AdaptiveBufferCountMaximum;
+
+    if (moduleContext->DmfModuleRegistry != NULL)
     {
-        goto Exit;
+        ntStatus = DMF_Registry_PathAndValueReadDwordAndValidate(moduleContext->DmfModuleRegistry,
+                                                                 moduleConfig->Mode.SourceSettings.AdaptiveRegistryPathName,
+                                                                 moduleConfig->Mode.SourceSettings.AdaptiveRegistryValueName,
+                                                                 &bufferCount,
+                                                                 moduleConfig->Mode.SourceSettings.BufferCount,
+                                                                 moduleContext->AdaptiveBufferCountMaximum);
+        if (NT_SUCCESS(ntStatus))
+        {
+            moduleContext->NumberOfBuffersSpecifiedByClient = bufferCount;
+        }
+        else
+        {
+            // The value is not present the first time or is not valid. Use the Client's setting.
+            //
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "DMF_Registry_PathAndValueReadDwordAndValidate ntStatus=%!STATUS!", ntStatus);
+        }
     }
 
-    DmfAssert(bufferPoolEntry != NULL);
-    DmfVerifierAssert("DMF_BufferPool signature mismatch", 
-                      bufferPoolEntry->Signature == BufferPool_Signature);
-    DmfVerifierAssert("DMF_BufferPool data sentinel mismatch", 
-                      *(bufferPoolEntry->SentinelData) == BufferPool_SentinelData);
-    DmfVerifierAssert("DMF_BufferPool context sentinel mismatch", 
-                      *(bufferPoolEntry->SentinelContext) == BufferPool_SentinelContext);
-    DmfAssert(bufferPoolEntry->BufferPoolEntryMemory == bufferPoolEntryMemory);
-    DmfAssert(bufferPoolEntry->ClientBuffer != NULL);
-    DmfAssert(sizeof(BUFFERPOOL_ENTRY) == bufferPoolEntry->SizeOfBufferPoolEntry);
+    // The timer is kept when the Module closes.
+    //
+    if (NULL == moduleContext->AdaptiveTimer)
+    {
+        // The registry is written from the timer callback so it must run at PASSIVE_LEVEL.
+        //
+        WDF_TIMER_CONFIG_INIT(&timerConfig,
+                              BufferPool_AdaptiveTimerHandler);
+        timerConfig.AutomaticSerialization = FALSE;
 
-    returnValue = bufferPoolEntry->ClientBuffer;
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        objectAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+        ntStatus = WdfTimerCreate(&timerConfig,
+                                  &objectAttributes,
+                                  &moduleContext->AdaptiveTimer);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfTimerCreate fails: ntStatus=%!STATUS!", ntStatus);
+            moduleContext->AdaptiveTimer = NULL;
+            goto Exit;
+        }
+    }
+
+    moduleContext->AdaptiveOverflowAllocations = 0;
+    moduleContext->AdaptiveIntervalMaximumBuffersUsed = 0;
+    moduleContext->AdaptiveIdleIntervals = 0;
+    moduleContext->AdaptiveIdleMaximumBuffersUsed = 0;
+    moduleContext->AdaptiveClosing = FALSE;
+    moduleContext->AdaptiveActivity = FALSE;
+    moduleContext->AdaptiveTimerStarted = FALSE;
+
+    ntStatus = STATUS_SUCCESS;
 
 Exit:
 
-    FuncExit(DMF_TRACE, "returnValue=0x%p", returnValue);
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
-    return returnValue;
+    return ntStatus;
 }
 
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -1241,6 +3077,7 @@ Return Value:
     size_t bufferSizeAligned;
     size_t bufferContextSizeAligned;
     size_t sentinelSizeAligned;
+    ULONG sizeClassIndex;
 
     FuncEntry(DMF_TRACE);
 
@@ -1248,6 +3085,46 @@ Return Value:
     moduleContext = DMF_CONTEXT_GET(DmfModule);
     device = DMF_ParentDeviceGet(DmfModule);
 
+    // In size-class mode, the buffers are held by the Child Modules (which are already open).
+    // This Module only needs an empty list so that it is destroyed like any other.
+    //
+    if (moduleConfig->Mode.SourceSettings.NumberOfSizeClasses > 0)
+    {
+        moduleContext->BufferPoolMode = moduleConfig->BufferPoolMode;
+        InitializeListHead(&moduleContext->BufferList);
+        moduleContext->NumberOfBuffersInList = 0;
+
+        if ((moduleConfig->BufferPoolMode != BufferPool_Mode_Source) ||
+            (moduleConfig->Mode.SourceSettings.NumberOfSizeClasses > BufferPool_SizeClassesMaximum))
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_INVALID_PARAMETER;
+            goto Exit;
+        }
+
+        // Size classes must be sorted by increasing size so that the first class that fits is the smallest.
+        //
+        for (sizeClassIndex = 0; sizeClassIndex < moduleConfig->Mode.SourceSettings.NumberOfSizeClasses; sizeClassIndex++)
+        {
+            if ((0 == moduleConfig->Mode.SourceSettings.SizeClasses[sizeClassIndex].BufferSize) ||
+                ((sizeClassIndex > 0) &&
+                 (moduleConfig->Mode.SourceSettings.SizeClasses[sizeClassIndex].BufferSize <=
+                  moduleConfig->Mode.SourceSettings.SizeClasses[sizeClassIndex - 1].BufferSize)))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Invalid size class: sizeClassIndex=%d BufferSize=%d",
+                            sizeClassIndex,
+                            moduleConfig->Mode.SourceSettings.SizeClasses[sizeClassIndex].BufferSize);
+                DmfAssert(FALSE);
+                ntStatus = STATUS_INVALID_PARAMETER;
+                goto Exit;
+            }
+        }
+
+        DmfAssert(moduleContext->NumberOfSizeClasses == moduleConfig->Mode.SourceSettings.NumberOfSizeClasses);
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
     // Populate Module Context.
     //
     moduleContext->EnableLookAside = moduleConfig->Mode.SourceSettings.EnableLookAside;
@@ -1257,8 +3134,6 @@ Return Value:
               (moduleConfig->BufferPoolMode == BufferPool_Mode_Sink && 
               (! moduleConfig->Mode.SourceSettings.EnableLookAside && moduleConfig->Mode.SourceSettings.BufferCount == 0))
               );
-    DmfAssert((moduleConfig->Mode.SourceSettings.CreateWithTimer && moduleConfig->Mode.SourceSettings.BufferCount > 0) ||
-              (! moduleConfig->Mode.SourceSettings.CreateWithTimer));
     moduleContext->BufferPoolMode = moduleConfig->BufferPoolMode;
     // NOTE: Allow Source Mode to have zero buffers for cases where no buffers are needed. (For example, an 
     //       input/output stream where input is not used sometimes.)
@@ -1267,19 +3142,30 @@ Return Value:
               (moduleConfig->BufferPoolMode == BufferPool_Mode_Sink && moduleConfig->Mode.SourceSettings.BufferCount == 0));
     moduleContext->NumberOfBuffersSpecifiedByClient = moduleConfig->Mode.SourceSettings.BufferCount;
 
-#if defined(DMF_USER_MODE)
-    // It is not possible to use "PutWithTimer" Method when lookaside list is enabled in User-mode
-    // because buffers are deleted in the timer callback which causes the child WDFTIMER to also
-    // be deleted. That, in turn, can cause a deadlock and verifier issue.
+    // Per-processor caches are only used in Source Mode. Sink Mode keeps the order of the buffers
+    // and enumerates them.
     //
-    if ((moduleConfig->Mode.SourceSettings.CreateWithTimer) &&
-        (moduleConfig->Mode.SourceSettings.EnableLookAside))
+    if ((moduleConfig->Mode.SourceSettings.PerProcessorCacheSize > 0) &&
+        ((moduleConfig->BufferPoolMode != BufferPool_Mode_Source) ||
+         (moduleConfig->Mode.SourceSettings.PerProcessorCacheSize > BufferPool_PerProcessorCacheSizeMaximum)))
     {
         DmfAssert(FALSE);
-        ntStatus = STATUS_NOT_SUPPORTED;
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    // Adaptive preallocation changes the number of buffers kept in the list. Buffers beyond that
+    // number can only come from the lookaside list.
+    //
+    if ((moduleConfig->Mode.SourceSettings.AdaptiveBufferCountMaximum > 0) &&
+        ((moduleConfig->BufferPoolMode != BufferPool_Mode_Source) ||
+         (! moduleConfig->Mode.SourceSettings.EnableLookAside) ||
+         (moduleConfig->Mode.SourceSettings.AdaptiveBufferCountMaximum < moduleConfig->Mode.SourceSettings.BufferCount)))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
         goto Exit;
     }
-#endif
 
     // Create the list that holds all the buffers.
     //
@@ -1360,8 +3246,17 @@ Return Value:
             goto Exit;
         }
 
+        if (moduleConfig->Mode.SourceSettings.AdaptiveBufferCountMaximum > 0)
+        {
+            ntStatus = BufferPool_AdaptiveCreate(DmfModule);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                goto Exit;
+            }
+        }
+
         DMF_ModuleLock(DmfModule);
-        for (bufferIndex = 0; bufferIndex < moduleConfig->Mode.SourceSettings.BufferCount; bufferIndex++)
+        for (bufferIndex = 0; bufferIndex < moduleContext->NumberOfBuffersSpecifiedByClient; bufferIndex++)
         {
             // This function cannot be in paged code because this call increases IRQL.
             //
@@ -1383,12 +3278,33 @@ Return Value:
             TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "BufferPool_BufferPoolEntryCreateAndAddToList ntStatus=%!STATUS!", ntStatus);
             goto Exit;
         }
+
+        if (moduleConfig->Mode.SourceSettings.PerProcessorCacheSize > 0)
+        {
+            ntStatus = BufferPool_CachesCreate(DmfModule);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                goto Exit;
+            }
+        }
+
+        if (moduleContext->AdaptiveTimer != NULL)
+        {
+            DMF_ModuleLock(DmfModule);
+            if (! moduleContext->AdaptiveTimerStarted)
+            {
+                moduleContext->AdaptiveTimerStarted = TRUE;
+                WdfTimerStart(moduleContext->AdaptiveTimer,
+                              WDF_REL_TIMEOUT_IN_MS(BufferPool_AdaptiveIntervalMilliseconds));
+            }
+            DMF_ModuleUnlock(DmfModule);
+        }
     }
     else
     {
-        // The list does not allocate any initial buffers.
+        // The list does not allocate any initial buffers. Buffers may be put in the list with a timer.
         //
-        ntStatus = STATUS_SUCCESS;
+        ntStatus = BufferPool_TimerWheelCreate(DmfModule);
     }
 
 Exit:
@@ -1407,8 +3323,7 @@ BufferPool_ListFlushAndDestroy(
 
 Routine Description:
 
-    Remove all entries from the list making sure that any associated timers
-    are stopped.
+    Remove all entries from the list and the timer wheel.
 
 Parameters:
 
@@ -1423,7 +3338,6 @@ Return:
     BUFFERPOOL_ENTRY* bufferPoolEntryInList;
     DMF_CONTEXT_BufferPool* moduleContext;
     WDFMEMORY bufferPoolEntryMemory;
-    WDFTIMER timer;
     LIST_ENTRY* listEntry;
 
     FuncEntry(DMF_TRACE);
@@ -1449,10 +3363,13 @@ Return:
                                                   ListEntry);
         bufferPoolEntryMemory = bufferPoolEntryInList->BufferPoolEntryMemory;
 
-        // Store timer in local variable so that we can wait for it after buffer
-        // is deleted outside of lock.
+        // Remove from the timer wheel. The timer has been stopped.
         //
-        timer = bufferPoolEntryInList->Timer;
+        if (bufferPoolEntryInList->TimerExpirationCallback != NULL)
+        {
+            BufferPool_TimerFieldsClear(DmfModule,
+                                        bufferPoolEntryInList);
+        }
 
         // Remove from list but do not delete.
         //
@@ -1465,20 +3382,6 @@ Return:
         // List entry is now accessible only by this thread
         // Other threads accessing the collection will not find this list entry and hence will not access it.
 
-        if (timer != NULL)
-        {
-            // Stop and wait for timer callback to execute.
-            // NOTE: Callback will first look in list and see that corresponding
-            //       buffer is removed so it will do nothing.
-            //
-            WdfTimerStop(timer,
-                         TRUE);
-
-            // Delete memory for entry.
-            //
-            WdfObjectDelete(timer);
-            timer = NULL;
-        }
         WdfObjectDelete(bufferPoolEntryMemory);
         bufferPoolEntryMemory = NULL;
 
@@ -1530,22 +3433,107 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    BufferPool_ListFlushAndDestroy(DmfModule);
+    // Move the buffers held in the per-processor caches back to the list so that they are destroyed.
+    //
+    if (moduleContext->Caches != NULL)
+    {
+        BufferPool_CachesClose(DmfModule,
+                               moduleContext);
+    }
 
-    // Delete the look aside list.
+    // Stop adjusting the number of buffers kept in the list.
     //
-#if !defined(DMF_USER_MODE)
-    if (moduleContext->LookasideList.WdflookasideList != NULL)
+    if (moduleContext->AdaptiveTimer != NULL)
     {
-        WdfObjectDelete(moduleContext->LookasideList.WdflookasideList);
-        moduleContext->LookasideList.WdflookasideList = NULL;
+        DMF_ModuleLock(DmfModule);
+        moduleContext->AdaptiveClosing = TRUE;
+        DMF_ModuleUnlock(DmfModule);
+
+        WdfTimerStop(moduleContext->AdaptiveTimer,
+                     TRUE);
+        moduleContext->AdaptiveTimerStarted = FALSE;
+    }
+
+    // Stop the timer and wait for its callback to finish so that it does not access the list.
+    //
+    if (moduleContext->TimerWheelTimer != NULL)
+    {
+        DMF_ModuleLock(DmfModule);
+        moduleContext->TimerWheelClosing = TRUE;
+        DMF_ModuleUnlock(DmfModule);
+
+        WdfTimerStop(moduleContext->TimerWheelTimer,
+                     TRUE);
+        moduleContext->TimerWheelTimerStarted = FALSE;
     }
-#endif // !defined(DMF_USER_MODE)
+
+    BufferPool_ListFlushAndDestroy(DmfModule);
+
+    // Delete the look aside list.
+    //
+    DMF_Portable_LookasideListDelete(&moduleContext->LookasideList);
 
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_BufferPoolEntryPrepare(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _Inout_ BUFFERPOOL_ENTRY* BufferPoolEntry
+    )
+/*++
+
+Routine Description:
+
+    Prepare a buffer that Client returns so that it can be inserted in the list.
+    This function does not need the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    BufferPoolEntry - The given buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    DmfAssert(((ModuleContext->BufferPoolMode == BufferPool_Mode_Source) && 
+              (BufferPoolEntry->CreatedByDmfModule == DmfModule)) ||
+              (ModuleContext->BufferPoolMode == BufferPool_Mode_Sink));
+
+    // In Source mode, clear out the buffer before inserting into buffer list.
+    // This ensures stale data is removed from the buffer and does not appear when the buffer is re-used.
+    //
+    if (ModuleContext->BufferPoolMode == BufferPool_Mode_Source)
+    {
+        // Clear the Client Buffer.
+        //
+        RtlZeroMemory(BufferPoolEntry->ClientBuffer,
+                      BufferPoolEntry->SizeOfClientBuffer);
+
+        // Clear the Client Buffer Context.
+        //
+        if (BufferPoolEntry->BufferContextSize > 0)
+        {
+            DmfAssert(BufferPoolEntry->ClientBufferContext != NULL);
+            RtlZeroMemory(BufferPoolEntry->ClientBufferContext,
+                          BufferPoolEntry->BufferContextSize);
+        }
+        DmfAssert(NULL == BufferPoolEntry->TimerExpirationCallback);
+        DmfAssert(0 == BufferPoolEntry->TimerExpirationAbsoluteTime100ns);
+        DmfAssert(0 == BufferPoolEntry->TimerExpirationMilliseconds);
+        DmfAssert(NULL == BufferPoolEntry->TimerExpirationCallbackContext);
+    }
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 BufferPool_Put(
@@ -1583,32 +3571,32 @@ Return Value:
     //
     bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(ClientBuffer);
 
-    DmfAssert(((moduleContext->BufferPoolMode == BufferPool_Mode_Source) && 
-              (bufferPoolEntry->CreatedByDmfModule == DmfModule)) ||
-              (moduleContext->BufferPoolMode == BufferPool_Mode_Sink));
-
-    // In Source mode, clear out the buffer before inserting into buffer list.
-    // This ensures stale data is removed from the buffer and does not appear when the buffer is re-used.
+    // In size-class mode, the buffer goes back to the size class it was taken from.
     //
-    if (moduleContext->BufferPoolMode == BufferPool_Mode_Source)
+    if (moduleContext->NumberOfSizeClasses > 0)
     {
-        // Clear the Client Buffer.
-        //
-        RtlZeroMemory(ClientBuffer,
-                      bufferPoolEntry->SizeOfClientBuffer);
+        DmfAssert(DMF_ParentModuleGet(bufferPoolEntry->CreatedByDmfModule) == DmfModule);
+        DmfModule = bufferPoolEntry->CreatedByDmfModule;
+        moduleContext = DMF_CONTEXT_GET(DmfModule);
+    }
 
-        // Clear the Client Buffer Context.
-        //
-        if (bufferPoolEntry->BufferContextSize > 0)
+    BufferPool_BufferPoolEntryPrepare(DmfModule,
+                                      moduleContext,
+                                      bufferPoolEntry);
+
+    // Use the current processor's cache unless additional buffers allocated from the lookaside list
+    // need to be deleted as they are returned.
+    //
+    if ((moduleContext->Caches != NULL) &&
+        (0 == moduleContext->NumberOfAdditionalBuffersAllocated))
+    {
+        if (BufferPool_CachePut(DmfModule,
+                                moduleContext,
+                                bufferPoolEntry,
+                                BufferPool_InsertionCallback))
         {
-            DmfAssert(bufferPoolEntry->ClientBufferContext != NULL);
-            RtlZeroMemory(bufferPoolEntry->ClientBufferContext,
-                          bufferPoolEntry->BufferContextSize);
+            goto Exit;
         }
-        DmfAssert(NULL == bufferPoolEntry->TimerExpirationCallback);
-        DmfAssert(0 == bufferPoolEntry->TimerExpirationAbsoluteTime100ns);
-        DmfAssert(0 == bufferPoolEntry->TimerExpirationMilliseconds);
-        DmfAssert(NULL == bufferPoolEntry->TimerExpirationCallbackContext);
     }
 
     DMF_ModuleLock(DmfModule);
@@ -1617,20 +3605,120 @@ Return Value:
                                   bufferPoolEntry,
                                   BufferPool_InsertionCallback);
 
-    DMF_ModuleUnlock(DmfModule);
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_BufferPool_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+    In size-class mode, each size class is a BufferPool Child Module.
+    If adaptive preallocation saves its state in the registry, a Registry Child Module is added.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONFIG_BufferPool moduleConfigSizeClass;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_BufferPool* moduleConfig;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    ULONG sizeClassIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (moduleConfig->BufferPoolMode != BufferPool_Mode_Source)
+    {
+        goto Exit;
+    }
+
+    // Invalid settings are rejected when the Module opens.
+    //
+    moduleContext->NumberOfSizeClasses = moduleConfig->Mode.SourceSettings.NumberOfSizeClasses;
+    if (moduleContext->NumberOfSizeClasses > BufferPool_SizeClassesMaximum)
+    {
+        moduleContext->NumberOfSizeClasses = BufferPool_SizeClassesMaximum;
+    }
+
+    for (sizeClassIndex = 0; sizeClassIndex < moduleContext->NumberOfSizeClasses; sizeClassIndex++)
+    {
+        // BufferPoolSizeClass
+        // -------------------
+        //
+        DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigSizeClass,
+                                                  &moduleAttributes);
+        moduleConfigSizeClass.BufferPoolMode = BufferPool_Mode_Source;
+        moduleConfigSizeClass.Mode.SourceSettings = moduleConfig->Mode.SourceSettings;
+        moduleConfigSizeClass.Mode.SourceSettings.BufferCount = moduleConfig->Mode.SourceSettings.SizeClasses[sizeClassIndex].BufferCount;
+        moduleConfigSizeClass.Mode.SourceSettings.BufferSize = moduleConfig->Mode.SourceSettings.SizeClasses[sizeClassIndex].BufferSize;
+        moduleConfigSizeClass.Mode.SourceSettings.NumberOfSizeClasses = 0;
+        // Size classes cannot share a registry value.
+        //
+        moduleConfigSizeClass.Mode.SourceSettings.AdaptiveRegistryValueName = NULL;
+        moduleAttributes.ClientModuleInstanceName = "BufferPoolSizeClass";
+        moduleAttributes.PassiveLevel = DmfParentModuleAttributes->PassiveLevel;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleBufferPoolSizeClass[sizeClassIndex]);
+    }
+
+    if ((0 == moduleContext->NumberOfSizeClasses) &&
+        (moduleConfig->Mode.SourceSettings.AdaptiveBufferCountMaximum > 0) &&
+        (moduleConfig->Mode.SourceSettings.AdaptiveRegistryValueName != NULL))
+    {
+        // Registry
+        // --------
+        //
+        DMF_Registry_ATTRIBUTES_INIT(&moduleAttributes);
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleRegistry);
+    }
+
+Exit:
 
     FuncExitVoid(DMF_TRACE);
 }
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// WDF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// DMF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
+#pragma code_seg()
 
 #pragma code_seg("PAGE")
 _Function_class_(DMF_Open)
@@ -1752,6 +3840,7 @@ Return Value:
     FuncEntry(DMF_TRACE);
 
     DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_BufferPool);
+    dmfCallbacksDmf_BufferPool.ChildModulesAdd = DMF_BufferPool_ChildModulesAdd;
     dmfCallbacksDmf_BufferPool.DeviceOpen = DMF_BufferPool_Open;
     dmfCallbacksDmf_BufferPool.DeviceClose = DMF_BufferPool_Close;
 
@@ -1867,6 +3956,7 @@ Return Value:
 {
     DMF_CONTEXT_BufferPool* moduleContext;
     ULONG numberOfBuffersInList;
+    ULONG sizeClassIndex;
 
     FuncEntry(DMF_TRACE);
 
@@ -1875,12 +3965,33 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    // In size-class mode, the buffers are in the Child Modules.
+    //
+    if (moduleContext->NumberOfSizeClasses > 0)
+    {
+        numberOfBuffersInList = 0;
+        for (sizeClassIndex = 0; sizeClassIndex < moduleContext->NumberOfSizeClasses; sizeClassIndex++)
+        {
+            numberOfBuffersInList += DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolSizeClass[sizeClassIndex]);
+        }
+        goto Exit;
+    }
+
     DMF_ModuleLock(DmfModule);
 
     numberOfBuffersInList = moduleContext->NumberOfBuffersInList;
 
     DMF_ModuleUnlock(DmfModule);
 
+    // Buffers in the per-processor caches are also available.
+    //
+    if (moduleContext->Caches != NULL)
+    {
+        numberOfBuffersInList += BufferPool_CacheCount(moduleContext);
+    }
+
+Exit:
+
     FuncExit(DMF_TRACE, "numberOfBuffersInList=%d", numberOfBuffersInList);
 
     return numberOfBuffersInList;
@@ -1920,9 +4031,6 @@ Return Value:
     BOOLEAN doneEnumerating;
     BufferPool_EnumerationDispositionType enumerationDisposition;
     LIST_ENTRY* listEntry;
-    BOOLEAN timerWasInQueue;
-    ULONGLONG currentInterruptTime;
-    LONG64 differenceInTime100ns;
 
     FuncEntry(DMF_TRACE);
 
@@ -1935,7 +4043,6 @@ Return Value:
 
     DMF_ModuleLock(DmfModule);
 
-    differenceInTime100ns = 0;
     doneEnumerating = FALSE;
     if (ClientBuffer != NULL)
     {
@@ -1966,32 +4073,9 @@ Return Value:
         //
         listEntry = listEntry->Flink;
 
-        if (bufferPoolEntry->TimerExpirationCallback != NULL)
-        {
-            // Temporarily try to stop the timer to prevent future race conditions. 
-            //
-            if (! WdfTimerStop(bufferPoolEntry->Timer,
-                               FALSE))
-            {
-                // Timer callback will be called soon, so skip this buffer.
-                //
-                continue;
-            }
-#if defined(DMF_USER_MODE)
-            QueryInterruptTime(&currentInterruptTime);
-#else
-            currentInterruptTime = KeQueryInterruptTime();
-#endif
-            if (currentInterruptTime >= bufferPoolEntry->TimerExpirationAbsoluteTime100ns)
-            {
-                differenceInTime100ns = 0;
-            }
-            else
-            {
-                differenceInTime100ns = currentInterruptTime - bufferPoolEntry->TimerExpirationAbsoluteTime100ns;
-            }
-        }
-
+        // NOTE: The timer wheel does not expire buffers while the Module lock is held
+        //       so the buffer's timer cannot expire during enumeration.
+        //
         DmfAssert(bufferPoolEntry->CurrentlyInsertedList != NULL);
         DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
 
@@ -2018,12 +4102,6 @@ Return Value:
             {
                 // Continue enumeration with next item.
                 //
-                if (bufferPoolEntry->TimerExpirationCallback != NULL)
-                {
-                    timerWasInQueue = WdfTimerStart(bufferPoolEntry->Timer,
-                                                    differenceInTime100ns);
-                    DmfAssert(! timerWasInQueue);
-                }
                 break;
             }
             case BufferPool_EnumerationDisposition_RemoveAndStopEnumeration:
@@ -2033,7 +4111,7 @@ Return Value:
                 doneEnumerating = TRUE;
                 DmfAssert(ClientBuffer != NULL);
 
-                // The timer has been stopped. Clear the associated fields.
+                // Stop the timer. Clear the associated fields.
                 //
                 BufferPool_TimerFieldsClear(DmfModule,
                                             bufferPoolEntry);
@@ -2068,7 +4146,7 @@ Return Value:
             }
             case BufferPool_EnumerationDisposition_StopTimerAndContinueEnumeration:
             {
-                // The timer was stopped. Clear the associated fields.
+                // Stop the timer. Clear the associated fields.
                 //
                 BufferPool_TimerFieldsClear(DmfModule,
                                             bufferPoolEntry);
@@ -2087,9 +4165,11 @@ Return Value:
                 //
                 if (bufferPoolEntry->TimerExpirationCallback)
                 {
-                    timerWasInQueue = WdfTimerStart(bufferPoolEntry->Timer,
-                                                    WDF_REL_TIMEOUT_IN_MS(bufferPoolEntry->TimerExpirationMilliseconds));
-                    DmfAssert(! timerWasInQueue);
+                    BufferPool_TimerWheelRemove(moduleContext,
+                                                bufferPoolEntry);
+                    BufferPool_TimerWheelAdd(DmfModule,
+                                             moduleContext,
+                                             bufferPoolEntry);
                 }
                 break;
             }
@@ -2146,7 +4226,8 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferPool);
 
-    clientBuffer = BufferPool_BufferGet(DmfModule);
+    clientBuffer = BufferPool_BufferGet(DmfModule,
+                                        0);
     if (NULL == clientBuffer)
     {
         ntStatus = STATUS_UNSUCCESSFUL;
@@ -2186,43 +4267,350 @@ Exit:
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
-DMF_BufferPool_GetWithMemory(
+DMF_BufferPool_GetMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfBuffers,
+    _Out_writes_to_(NumberOfBuffers, *NumberOfBuffersReturned) VOID** ClientBuffers,
+    _Out_writes_opt_(NumberOfBuffers) VOID** ClientBufferContexts,
+    _Out_ ULONG* NumberOfBuffersReturned
+    )
+/*++
+
+Routine Description:
+
+    Removes up to NumberOfBuffers buffers from the head of the list while acquiring the
+    Module lock only once. Then, returns the Client Buffers and their associated Client
+    Buffer Contexts in the order they were in the list.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    NumberOfBuffers - The maximum number of buffers to remove.
+    ClientBuffers - Array that receives the Client Buffers.
+    ClientBufferContexts - Optional array that receives the Client contexts associated
+                           with the buffers.
+    NumberOfBuffersReturned - The number of buffers written to ClientBuffers.
+
+Return Value:
+
+    STATUS_SUCCESS if at least one buffer is removed from the list.
+    STATUS_UNSUCCESSFUL if the list is empty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    WDFMEMORY bufferPoolEntryMemory;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    VOID* clientBuffer;
+    ULONG bufferIndex;
+    ULONG numberOfBuffersReturned;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferPool);
+
+    DmfAssert(ClientBuffers != NULL);
+    DmfAssert(NumberOfBuffersReturned != NULL);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    numberOfBuffersReturned = 0;
+
+    if (moduleContext->NumberOfSizeClasses > 0)
+    {
+        // Buffers may come from other Modules so they are retrieved one at a time.
+        //
+        while (numberOfBuffersReturned < NumberOfBuffers)
+        {
+            clientBuffer = BufferPool_BufferGet(DmfModule,
+                                                0);
+            if (NULL == clientBuffer)
+            {
+                break;
+            }
+            ClientBuffers[numberOfBuffersReturned] = clientBuffer;
+            numberOfBuffersReturned++;
+        }
+    }
+    else
+    {
+        if (moduleContext->Caches != NULL)
+        {
+            numberOfBuffersReturned = BufferPool_CacheGetMultiple(DmfModule,
+                                                                  moduleContext,
+                                                                  NumberOfBuffers,
+                                                                  ClientBuffers);
+        }
+
+        // When there are caches, this only happens when the list and the caches are empty.
+        // If EnableLookAside is TRUE, new buffers are allocated.
+        //
+        if (numberOfBuffersReturned < NumberOfBuffers)
+        {
+            DMF_ModuleLock(DmfModule);
+
+            while (numberOfBuffersReturned < NumberOfBuffers)
+            {
+                bufferPoolEntryMemory = BufferPool_BufferPoolEntryGetLocked(DmfModule,
+                                                                            &bufferPoolEntry);
+                if (NULL == bufferPoolEntryMemory)
+                {
+                    break;
+                }
+                ClientBuffers[numberOfBuffersReturned] = bufferPoolEntry->ClientBuffer;
+                numberOfBuffersReturned++;
+            }
+
+            DMF_ModuleUnlock(DmfModule);
+        }
+    }
+
+    // Validate the buffers and retrieve their contexts without holding the lock.
+    //
+    for (bufferIndex = 0; bufferIndex < numberOfBuffersReturned; bufferIndex++)
+    {
+        bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(ClientBuffers[bufferIndex]);
+        BufferPool_BufferPoolEntryValidate(bufferPoolEntry,
+                                           bufferPoolEntry->BufferPoolEntryMemory);
+
+        DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)(bufferPoolEntry->SentinelData) +
+                  WDF_ALIGN_SIZE_UP(BufferPool_SentinelSize, MEMORY_ALLOCATION_ALIGNMENT));
+        if (ClientBufferContexts != NULL)
+        {
+            if (bufferPoolEntry->BufferContextSize > 0)
+            {
+                ClientBufferContexts[bufferIndex] = bufferPoolEntry->ClientBufferContext;
+            }
+            else
+            {
+                ClientBufferContexts[bufferIndex] = NULL;
+            }
+        }
+    }
+
+    *NumberOfBuffersReturned = numberOfBuffersReturned;
+
+    if (0 == numberOfBuffersReturned)
+    {
+        ntStatus = STATUS_UNSUCCESSFUL;
+    }
+    else
+    {
+        ntStatus = STATUS_SUCCESS;
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS! numberOfBuffersReturned=%d", ntStatus, numberOfBuffersReturned);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferPool_GetWithMemory(
+    _In_ DMFMODULE DmfModule,
+    _Out_ VOID** ClientBuffer,
+    _Out_ VOID** ClientBufferContext,
+    _Out_ WDFMEMORY* ClientBufferMemory
+    )
+/*++
+
+Routine Description:
+
+    Removes the next buffer in the list (head of the list) if there is a buffer.
+    Then, returns the Client Buffer and its associated Client Buffer Context.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The Client Buffer.
+    ClientBufferContext - Client context associated with the buffer.
+    ClientBufferMemory - WDFMEMORY associated with Client Buffer.
+
+Return Value:
+
+    STATUS_SUCCESS if a buffer is removed from the list.
+    STATUS_UNSUCCESSFUL if the list is empty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    VOID* clientBuffer;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferPool);
+
+    clientBuffer = BufferPool_BufferGet(DmfModule,
+                                        0);
+    if (NULL == clientBuffer)
+    {
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(clientBuffer);
+
+    DmfAssert(bufferPoolEntry->ClientBuffer != NULL);
+    *ClientBuffer = bufferPoolEntry->ClientBuffer;
+
+    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)(bufferPoolEntry->SentinelData) +
+              WDF_ALIGN_SIZE_UP(BufferPool_SentinelSize, MEMORY_ALLOCATION_ALIGNMENT));
+    DmfAssert(ClientBufferContext != NULL);
+    *ClientBufferContext = bufferPoolEntry->ClientBufferContext;
+
+    DmfAssert(ClientBufferMemory != NULL);
+    *ClientBufferMemory = bufferPoolEntry->ClientBufferMemory;
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferPool_GetWithMemoryDescriptor(
+    _In_ DMFMODULE DmfModule,
+    _Out_ VOID** ClientBuffer,
+    _Out_ PWDF_MEMORY_DESCRIPTOR MemoryDescriptor,
+    _Out_ VOID** ClientBufferContext
+    )
+/*++
+
+Routine Description:
+
+    Removes the next buffer in the list (head of the list) if there is a buffer.
+    Then, returns the Client Buffer and its associated Memory Descriptor and ClientBufferContext.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The Client Buffer.
+    MemoryDescriptor - WDF Memory Descriptor associated with removed buffer.
+    ClientBufferContext - Client context associated with the buffer.
+
+Return Value:
+
+    STATUS_SUCCESS if a buffer is removed from the list.
+    STATUS_INSUFFICIENT_RESOURCES if the list is empty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    VOID* clientBuffer;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferPool);
+
+    clientBuffer = BufferPool_BufferGet(DmfModule,
+                                        0);
+    if (NULL == clientBuffer)
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        goto Exit;
+    }
+
+    bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(clientBuffer);
+
+    DmfAssert(bufferPoolEntry->ClientBuffer != NULL);
+    *ClientBuffer = bufferPoolEntry->ClientBuffer;
+
+    DmfAssert(MemoryDescriptor != NULL);
+    *MemoryDescriptor = bufferPoolEntry->MemoryDescriptor;
+
+    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)(bufferPoolEntry->SentinelData) +
+              WDF_ALIGN_SIZE_UP(BufferPool_SentinelSize, MEMORY_ALLOCATION_ALIGNMENT));
+    DmfAssert(ClientBufferContext != NULL);
+    *ClientBufferContext = bufferPoolEntry->ClientBufferContext;
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferPool_GetWithSize(
     _In_ DMFMODULE DmfModule,
+    _In_ ULONG RequestedSize,
     _Out_ VOID** ClientBuffer,
-    _Out_ VOID** ClientBufferContext,
-    _Out_ WDFMEMORY* ClientBufferMemory
+    _Out_opt_ VOID** ClientBufferContext
     )
 /*++
 
 Routine Description:
 
-    Removes the next buffer in the list (head of the list) if there is a buffer.
-    Then, returns the Client Buffer and its associated Client Buffer Context.
+    Removes a buffer of at least RequestedSize bytes from the list if there is one.
+    In size-class mode, the buffer is taken from the smallest size class that fits and has
+    a buffer available. Then, returns the Client Buffer and its associated Client Buffer Context.
 
 Arguments:
 
     DmfModule - This Module's handle.
+    RequestedSize - Minimum size of the Client Buffer.
     ClientBuffer - The Client Buffer.
     ClientBufferContext - Client context associated with the buffer.
-    ClientBufferMemory - WDFMEMORY associated with Client Buffer.
 
 Return Value:
 
     STATUS_SUCCESS if a buffer is removed from the list.
-    STATUS_UNSUCCESSFUL if the list is empty.
+    STATUS_INVALID_BUFFER_SIZE if no buffer of this Module can hold RequestedSize bytes.
+    STATUS_UNSUCCESSFUL if there is no buffer available that fits.
 
 --*/
 {
     NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    DMF_CONFIG_BufferPool* moduleConfig;
     VOID* clientBuffer;
     BUFFERPOOL_ENTRY* bufferPoolEntry;
+    ULONG largestBufferSize;
 
     FuncEntry(DMF_TRACE);
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferPool);
 
-    clientBuffer = BufferPool_BufferGet(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    DmfAssert(moduleContext->BufferPoolMode == BufferPool_Mode_Source);
+
+    if (moduleContext->NumberOfSizeClasses > 0)
+    {
+        largestBufferSize = moduleConfig->Mode.SourceSettings.SizeClasses[moduleContext->NumberOfSizeClasses - 1].BufferSize;
+    }
+    else
+    {
+        largestBufferSize = moduleConfig->Mode.SourceSettings.BufferSize;
+    }
+
+    if (RequestedSize > largestBufferSize)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "RequestedSize=%d largestBufferSize=%d", RequestedSize, largestBufferSize);
+        ntStatus = STATUS_INVALID_BUFFER_SIZE;
+        goto Exit;
+    }
+
+    clientBuffer = BufferPool_BufferGet(DmfModule,
+                                        RequestedSize);
     if (NULL == clientBuffer)
     {
         ntStatus = STATUS_UNSUCCESSFUL;
@@ -2231,16 +4619,21 @@ Return Value:
 
     bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(clientBuffer);
 
+    DmfAssert(bufferPoolEntry->SizeOfClientBuffer >= RequestedSize);
     DmfAssert(bufferPoolEntry->ClientBuffer != NULL);
     *ClientBuffer = bufferPoolEntry->ClientBuffer;
 
-    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)(bufferPoolEntry->SentinelData) +
-              WDF_ALIGN_SIZE_UP(BufferPool_SentinelSize, MEMORY_ALLOCATION_ALIGNMENT));
-    DmfAssert(ClientBufferContext != NULL);
-    *ClientBufferContext = bufferPoolEntry->ClientBufferContext;
-
-    DmfAssert(ClientBufferMemory != NULL);
-    *ClientBufferMemory = bufferPoolEntry->ClientBufferMemory;
+    if (ClientBufferContext != NULL)
+    {
+        if (bufferPoolEntry->BufferContextSize > 0)
+        {
+            *ClientBufferContext = bufferPoolEntry->ClientBufferContext;
+        }
+        else
+        {
+            *ClientBufferContext = NULL;
+        }
+    }
 
     ntStatus = STATUS_SUCCESS;
 
@@ -2254,63 +4647,51 @@ Exit:
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
-DMF_BufferPool_GetWithMemoryDescriptor(
+DMF_BufferPool_LookasideStatisticsGet(
     _In_ DMFMODULE DmfModule,
-    _Out_ VOID** ClientBuffer,
-    _Out_ PWDF_MEMORY_DESCRIPTOR MemoryDescriptor,
-    _Out_ VOID** ClientBufferContext
+    _Out_ DMF_PORTABLE_LOOKASIDELIST_STATISTICS* Statistics
     )
 /*++
 
 Routine Description:
 
-    Removes the next buffer in the list (head of the list) if there is a buffer.
-    Then, returns the Client Buffer and its associated Memory Descriptor and ClientBufferContext.
+    Returns the statistics of the lookaside list that buffers are allocated from when
+    the list of buffers is empty.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    ClientBuffer - The Client Buffer.
-    MemoryDescriptor - WDF Memory Descriptor associated with removed buffer.
-    ClientBufferContext - Client context associated with the buffer.
+    Statistics - Receives the statistics.
 
 Return Value:
 
-    STATUS_SUCCESS if a buffer is removed from the list.
-    STATUS_INSUFFICIENT_RESOURCES if the list is empty.
+    STATUS_SUCCESS
+    STATUS_NOT_SUPPORTED if the Module does not use a lookaside list (or in Kernel-mode, where
+    the lookaside list is managed by the operating system).
 
 --*/
 {
+    DMF_CONTEXT_BufferPool* moduleContext;
     NTSTATUS ntStatus;
-    VOID* clientBuffer;
-    BUFFERPOOL_ENTRY* bufferPoolEntry;
 
     FuncEntry(DMF_TRACE);
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferPool);
 
-    clientBuffer = BufferPool_BufferGet(DmfModule);
-    if (NULL == clientBuffer)
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if ((! moduleContext->EnableLookAside) ||
+        (moduleContext->NumberOfSizeClasses > 0))
     {
-        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        RtlZeroMemory(Statistics,
+                      sizeof(DMF_PORTABLE_LOOKASIDELIST_STATISTICS));
+        ntStatus = STATUS_NOT_SUPPORTED;
         goto Exit;
     }
 
-    bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(clientBuffer);
-
-    DmfAssert(bufferPoolEntry->ClientBuffer != NULL);
-    *ClientBuffer = bufferPoolEntry->ClientBuffer;
-
-    DmfAssert(MemoryDescriptor != NULL);
-    *MemoryDescriptor = bufferPoolEntry->MemoryDescriptor;
-
-    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)(bufferPoolEntry->SentinelData) +
-              WDF_ALIGN_SIZE_UP(BufferPool_SentinelSize, MEMORY_ALLOCATION_ALIGNMENT));
-    DmfAssert(ClientBufferContext != NULL);
-    *ClientBufferContext = bufferPoolEntry->ClientBufferContext;
-
-    ntStatus = STATUS_SUCCESS;
+    ntStatus = DMF_Portable_LookasideListStatisticsGet(&moduleContext->LookasideList,
+                                                       Statistics);
 
 Exit:
 
@@ -2363,8 +4744,10 @@ Return Value:
     bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(ClientBuffer);
 
     // For consistency, the Module from which the pool was created must be passed in.
+    // In size-class mode, that Module is a Child Module of the Module passed in.
     //
-    DmfAssert(bufferPoolEntry->CreatedByDmfModule == DmfModule);
+    DmfAssert((bufferPoolEntry->CreatedByDmfModule == DmfModule) ||
+              (DMF_ParentModuleGet(bufferPoolEntry->CreatedByDmfModule) == DmfModule));
 
     if (MemoryDescriptor != NULL)
     {
@@ -2487,6 +4870,8 @@ Routine Description:
     Adds a Client Buffer to the list and starts a timer. If the buffer is still in the list 
     when the timer expires, buffer will be removed from the list, and the TimerExpirationCallback
     will be called. Client owns the buffer in TimerExpirationCallback.
+    NOTE: All the buffers in the list share a timer wheel. Buffers expire no earlier than
+          TimerExpirationMilliseconds and up to one timer wheel tick later.
 
 Arguments:
 
@@ -2499,15 +4884,12 @@ Arguments:
 
 Return Value:
 
-    TRUE if timer is in system timer queue.
-    FALSE otherwise.
+    None
 
 --*/
 {
-    BOOLEAN timerWasInQueue;
     DMF_CONTEXT_BufferPool* moduleContext;
     BUFFERPOOL_ENTRY* bufferPoolEntry;
-    ULONGLONG currentInterruptTime;
 
     FuncEntry(DMF_TRACE);
 
@@ -2520,29 +4902,10 @@ Return Value:
 
     DmfAssert(moduleContext->BufferPoolMode == BufferPool_Mode_Sink);
 
-#if defined(DMF_USER_MODE)
-    // It is not possible to use this Method when buffers come from the "look-aside
-    // list" in User-mode because the buffers are just allocated and deallocated
-    // as needed. The problem is that in the timer callback the buffers are actually
-    // deleted and a child of the buffer is the corresponding WDFTIMER which is also
-    // deleted because it is a child object. The problem is that deleting the WDFTIMER
-    // from inside the timer callback can cause a deadlock and does cause a WDF
-    // verifier violation.
-    //
-    DMF_CONFIG_BufferPool* moduleConfig;
-    moduleConfig = DMF_CONFIG_GET(DmfModule);
-    DmfAssert(!moduleConfig->Mode.SourceSettings.EnableLookAside);
-#endif
-
     // Given the Client Buffer, get the associated meta data.
     // NOTE: Client Driver (caller) owns the buffer at this time.
     //
     bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(ClientBuffer);
-    DmfAssert(bufferPoolEntry->Timer != NULL);
-
-    // NOTE: The timer is guaranteed to be not running,
-    //       since it was stop or expired when Client got the buffer.
-    //
 
     DMF_ModuleLock(DmfModule);
 
@@ -2552,37 +4915,277 @@ Return Value:
     DmfAssert(! moduleContext->BufferPoolEnumerating);
     bufferPoolEntry->TimerExpirationCallback = TimerExpirationCallback;
     bufferPoolEntry->TimerExpirationMilliseconds = TimerExpirationMilliseconds;
-#if defined(DMF_USER_MODE)
-    QueryInterruptTime(&currentInterruptTime);
-#else
-    currentInterruptTime = KeQueryInterruptTime();
-#endif
-    // Although use of WDF_ABSE_TIMEOUT_IN_MS works, it is not technically correct since the numbers are not 
-    // actually the same. Simply multiplying by the conversion from 100-ns to milliseconds is more accurate and clear.
-    //
-    bufferPoolEntry->TimerExpirationAbsoluteTime100ns = currentInterruptTime + (TimerExpirationMilliseconds * WDF_TIMEOUT_TO_MS);
     bufferPoolEntry->TimerExpirationCallbackContext = TimerExpirationCallbackContext;
 
-    // Save the DmfModule in the Timer's context so that the timer handler knows
-    // where to remove the buffer from.
-    //
-    BufferPool_BufferPoolTimerContextSet(bufferPoolEntry,
-                                         DmfModule);
-
     BufferPool_BufferPoolEntryPut(DmfModule,
                                   bufferPoolEntry,
                                   BufferPool_InsertTailList);
 
-    // Start the timer. Timer is guaranteed to not have been in the timer queue nor running its callback function.
-    // This is because Client has no direct access to the timer. The timer was stopped when the buffer was 
-    // previously retrieved.
+    // Add the buffer to the timer wheel. This starts the timer if necessary.
+    //
+    BufferPool_TimerWheelAdd(DmfModule,
+                             moduleContext,
+                             bufferPoolEntry);
+
+    DMF_ModuleUnlock(DmfModule);
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferPool_PutMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfBuffers) VOID** ClientBuffers,
+    _In_ ULONG NumberOfBuffers
+    )
+/*++
+
+Routine Description:
+
+    Adds Client Buffers to the end of the list, in the order they are in the given array,
+    while acquiring the Module lock only once.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffers - The buffers to add to the list.
+                    NOTE: These must be properly formed buffers that were created by this Module
+                          (or, in Sink mode, by any instance of Dmf_BufferPool).
+    NumberOfBuffers - The number of buffers in ClientBuffers.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferPool* moduleContext;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    ULONG bufferIndex;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD_CLOSING_OK(DmfModule,
+                                            BufferPool);
+
+    DmfAssert((ClientBuffers != NULL) || (0 == NumberOfBuffers));
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (moduleContext->NumberOfSizeClasses > 0)
+    {
+        // Buffers may go to other Modules so they are returned one at a time.
+        //
+        for (bufferIndex = 0; bufferIndex < NumberOfBuffers; bufferIndex++)
+        {
+            BufferPool_Put(DmfModule,
+                           ClientBuffers[bufferIndex],
+                           BufferPool_InsertTailList);
+        }
+        goto Exit;
+    }
+
+    // Clear the buffers (in Source mode) without holding the lock.
+    //
+    for (bufferIndex = 0; bufferIndex < NumberOfBuffers; bufferIndex++)
+    {
+        bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(ClientBuffers[bufferIndex]);
+        BufferPool_BufferPoolEntryPrepare(DmfModule,
+                                          moduleContext,
+                                          bufferPoolEntry);
+    }
+
+    // Use the current processor's cache unless additional buffers allocated from the lookaside list
+    // need to be deleted as they are returned.
+    //
+    if ((moduleContext->Caches != NULL) &&
+        (0 == moduleContext->NumberOfAdditionalBuffersAllocated))
+    {
+        if (BufferPool_CachePutMultiple(DmfModule,
+                                        moduleContext,
+                                        ClientBuffers,
+                                        NumberOfBuffers,
+                                        BufferPool_InsertTailList))
+        {
+            goto Exit;
+        }
+    }
+
+    DMF_ModuleLock(DmfModule);
+
+    for (bufferIndex = 0; bufferIndex < NumberOfBuffers; bufferIndex++)
+    {
+        bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(ClientBuffers[bufferIndex]);
+        BufferPool_BufferPoolEntryPut(DmfModule,
+                                      bufferPoolEntry,
+                                      BufferPool_InsertTailList);
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferPool_Splice(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMFMODULE DmfModuleSource
+    )
+/*++
+
+Routine Description:
+
+    Moves all the buffers from another Sink mode instance of this Module to the end of this
+    Module's list. The buffers keep their order. The whole chain of buffers is moved in
+    constant time while each Module's lock is held only once (the two locks are never held
+    at the same time). Buffers that have a timer keep their expiration time; they are moved
+    to this Module's timer wheel and their timer callback is called with this Module's handle.
+
+Arguments:
+
+    DmfModule - This Module's handle. The buffers are moved to this Module.
+    DmfModuleSource - The Module from which all the buffers are moved.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferPool* moduleContext;
+    DMF_CONTEXT_BufferPool* moduleContextSource;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    LIST_ENTRY bufferList;
+    LIST_ENTRY timerList;
+    LIST_ENTRY* listEntry;
+    ULONG numberOfBuffers;
+    ULONG numberOfBuffersWithTimer;
+    ULONG slotIndex;
+    ULONGLONG currentInterruptTime;
+    ULONGLONG earliestExpirationTime100ns;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferPool);
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModuleSource,
+                                 BufferPool);
+
+    DmfAssert(DmfModule != DmfModuleSource);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleContextSource = DMF_CONTEXT_GET(DmfModuleSource);
+
+    // Buffers in a Source mode list belong to that list.
+    //
+    DmfAssert(moduleContext->BufferPoolMode == BufferPool_Mode_Sink);
+    DmfAssert(moduleContextSource->BufferPoolMode == BufferPool_Mode_Sink);
+
+    InitializeListHead(&bufferList);
+    InitializeListHead(&timerList);
+
+    // Detach all the buffers (and their timers) from the source Module.
+    //
+    DMF_ModuleLock(DmfModuleSource);
+
+    DmfAssert(! moduleContextSource->BufferPoolEnumerating);
+
+    numberOfBuffers = moduleContextSource->NumberOfBuffersInList;
+    BufferPool_ListAppend(&bufferList,
+                          &moduleContextSource->BufferList);
+    moduleContextSource->NumberOfBuffersInList = 0;
+
+    numberOfBuffersWithTimer = moduleContextSource->NumberOfBuffersInTimerWheel;
+    if (numberOfBuffersWithTimer > 0)
+    {
+        // The source timer is left running. It stops when it finds that the timer wheel is empty.
+        //
+        for (slotIndex = 0; slotIndex < BufferPool_TimerWheelNumberOfSlots; slotIndex++)
+        {
+            BufferPool_ListAppend(&timerList,
+                                  &moduleContextSource->TimerWheelSlots[slotIndex]);
+        }
+        moduleContextSource->NumberOfBuffersInTimerWheel = 0;
+    }
+
+    DMF_ModuleUnlock(DmfModuleSource);
+
+    if (0 == numberOfBuffers)
+    {
+        DmfAssert(IsListEmpty(&timerList));
+        goto Exit;
+    }
+
+#if defined(DEBUG)
+    // Buffers remember the list they are in for validation purposes.
+    //
+    for (listEntry = bufferList.Flink; listEntry != &bufferList; listEntry = listEntry->Flink)
+    {
+        bufferPoolEntry = CONTAINING_RECORD(listEntry,
+                                            BUFFERPOOL_ENTRY,
+                                            ListEntry);
+        DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModuleSource);
+        bufferPoolEntry->CurrentlyInsertedList = &moduleContext->BufferList;
+        bufferPoolEntry->CurrentlyInsertedDmfModule = DmfModule;
+    }
+#endif // defined(DEBUG)
+
+    // Attach the buffers to this Module.
     //
-    timerWasInQueue = WdfTimerStart(bufferPoolEntry->Timer,
-                                    WDF_REL_TIMEOUT_IN_MS(TimerExpirationMilliseconds));
-    DmfAssert(! timerWasInQueue);
+    DMF_ModuleLock(DmfModule);
+
+    DmfAssert(! moduleContext->BufferPoolEnumerating);
+
+    BufferPool_ListAppend(&moduleContext->BufferList,
+                          &bufferList);
+    moduleContext->NumberOfBuffersInList += numberOfBuffers;
+
+    if (numberOfBuffersWithTimer > 0)
+    {
+        currentInterruptTime = BufferPool_InterruptTimeGet();
+        if (0 == moduleContext->NumberOfBuffersInTimerWheel)
+        {
+            // There is nothing to do for the ticks that passed since the timer wheel became empty.
+            //
+            moduleContext->TimerWheelNextTick = (currentInterruptTime / BufferPool_TimerWheelTick100ns) + 1;
+        }
+
+        earliestExpirationTime100ns = MAXULONGLONG;
+        while (! IsListEmpty(&timerList))
+        {
+            listEntry = RemoveHeadList(&timerList);
+            bufferPoolEntry = CONTAINING_RECORD(listEntry,
+                                                BUFFERPOOL_ENTRY,
+                                                TimerListEntry);
+            DmfAssert(bufferPoolEntry->TimerExpirationCallback != NULL);
+            BufferPool_TimerWheelInsert(moduleContext,
+                                        bufferPoolEntry);
+            moduleContext->NumberOfBuffersInTimerWheel++;
+            if (bufferPoolEntry->TimerExpirationAbsoluteTime100ns < earliestExpirationTime100ns)
+            {
+                earliestExpirationTime100ns = bufferPoolEntry->TimerExpirationAbsoluteTime100ns;
+            }
+        }
+
+        if ((! moduleContext->TimerWheelClosing) &&
+            ((! moduleContext->TimerWheelTimerStarted) ||
+             (earliestExpirationTime100ns < moduleContext->TimerWheelDueTick * BufferPool_TimerWheelTick100ns)))
+        {
+            BufferPool_TimerWheelTimerStart(moduleContext,
+                                            currentInterruptTime);
+        }
+    }
 
     DMF_ModuleUnlock(DmfModule);
 
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Spliced numberOfBuffers=%d numberOfBuffersWithTimer=%d", numberOfBuffers, numberOfBuffersWithTimer);
+
+Exit:
+
     FuncExitVoid(DMF_TRACE);
 }
 
@@ -90,6 +90,22 @@ EVT_DMF_BufferPool_TimerCallback(_In_ DMFMODULE DmfModule,
                                  _In_ VOID* ClientBufferContext,
                                  _In_opt_ VOID* ClientDriverCallbackContext);
 
+// Maximum number of size classes a single instance of this Module can manage.
+//
+#define BufferPool_SizeClassesMaximum   8
+
+// Settings for each size class of BufferPool_Mode_Source.
+//
+typedef struct
+{
+    // Number of buffers of this size class to preallocate.
+    //
+    ULONG BufferCount;
+    // The size of each buffer of this size class.
+    //
+    ULONG BufferSize;
+} BufferPool_SizeClassSettings;
+
 // Settings for BufferPool_Mode_Source.
 //
 typedef struct
@@ -106,15 +122,36 @@ typedef struct
     // Indicates if a look aside list should be used.
     //
     ULONG EnableLookAside;
-    // Indicates if a timer is created with the buffer.
-    // Use this flag if the buffers from this list will be added to 
-    // another list using *WithTimer API.
+    // No longer used. Buffers put in a Sink with the *WithTimer API use the
+    // Sink's timer wheel so they do not need a timer of their own.
     //
     ULONG CreateWithTimer;
     // Pool Type.
     // Note: Pool type can be passive if PassiveLevel in Module Attributes is set to TRUE.
     //
     POOL_TYPE PoolType;
+    // Maximum number of buffers each processor caches so that most Get/Put calls do not
+    // acquire the Module lock. Zero disables the per-processor caches.
+    //
+    ULONG PerProcessorCacheSize;
+    // Number of size classes in SizeClasses. Zero means the Module has a single size of buffer
+    // given by BufferCount and BufferSize. Otherwise, BufferCount and BufferSize are not used
+    // and the Module keeps a separate list of buffers for each size class.
+    //
+    ULONG NumberOfSizeClasses;
+    // Size classes sorted by increasing BufferSize (for example, 256, 1024 and 4096 bytes).
+    //
+    BufferPool_SizeClassSettings SizeClasses[BufferPool_SizeClassesMaximum];
+    // Maximum number of buffers that adaptive preallocation may keep in the list.
+    // Zero disables adaptive preallocation. Requires EnableLookAside.
+    //
+    ULONG AdaptiveBufferCountMaximum;
+    // Optional. Registry path and value where adaptive preallocation saves the number of
+    // buffers to preallocate the next time the Module opens. NULL path means the device's
+    // registry key. NULL value name means the number is not saved.
+    //
+    WCHAR* AdaptiveRegistryPathName;
+    WCHAR* AdaptiveRegistryValueName;
 } BufferPool_SourceSettings;
 
 // Client uses this structure to configure the Module specific parameters.
@@ -193,6 +230,17 @@ DMF_BufferPool_Get(
     _Out_opt_ VOID** ClientBufferContext
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferPool_GetMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfBuffers,
+    _Out_writes_to_(NumberOfBuffers, *NumberOfBuffersReturned) VOID** ClientBuffers,
+    _Out_writes_opt_(NumberOfBuffers) VOID** ClientBufferContexts,
+    _Out_ ULONG* NumberOfBuffersReturned
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -213,6 +261,24 @@ DMF_BufferPool_GetWithMemoryDescriptor(
     _Out_ VOID** ClientBufferContext
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferPool_GetWithSize(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG RequestedSize,
+    _Out_ VOID** ClientBuffer,
+    _Out_opt_ VOID** ClientBufferContext
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferPool_LookasideStatisticsGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ DMF_PORTABLE_LOOKASIDELIST_STATISTICS* Statistics
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 DMF_BufferPool_ParametersGet(
@@ -239,6 +305,14 @@ DMF_BufferPool_PutAtHead(
     _In_ VOID* ClientBuffer
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferPool_PutMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfBuffers) VOID** ClientBuffers,
+    _In_ ULONG NumberOfBuffers
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 DMF_BufferPool_PutInSinkWithTimer(
@@ -249,5 +323,12 @@ DMF_BufferPool_PutInSinkWithTimer(
     _In_opt_ VOID* TimerExpirationCallbackContext
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferPool_Splice(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMFMODULE DmfModuleSource
+    );
+
 // eof: Dmf_BufferPool.h
 //
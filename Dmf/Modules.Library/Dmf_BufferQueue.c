@@ -34,6 +34,51 @@ Environment:
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+// A cell of a lock-free queue. Sequence tells whose turn it is to use the cell:
+// it is equal to the position of the enqueue that may write the cell next, or to
+// that position + 1 after the cell has been written and until it has been read.
+//
+typedef struct
+{
+    volatile LONG Sequence;
+    VOID* ClientBuffer;
+} BUFFERQUEUE_CELL;
+
+// Free running position shared by all the producers (or all the consumers) of a lock-free queue.
+// It fills a cache line so that producers and consumers do not invalidate each other's cache line.
+//
+typedef struct
+{
+    volatile LONG Value;
+    UCHAR Padding[SYSTEM_CACHE_ALIGNMENT_SIZE - sizeof(LONG)];
+} BUFFERQUEUE_POSITION;
+
+// Bounded multiple producer multiple consumer queue of Client Buffers.
+// The number of cells is a power of 2 that is at least the number of buffers
+// the queue can ever hold.
+//
+typedef struct
+{
+    BUFFERQUEUE_POSITION EnqueuePosition;
+    BUFFERQUEUE_POSITION DequeuePosition;
+    BUFFERQUEUE_CELL* Cells;
+    ULONG CellIndexMask;
+    WDFMEMORY MemoryCells;
+} BUFFERQUEUE_LOCKFREE_QUEUE;
+
+// Passed to the enumeration callback of each priority level by DMF_BufferQueue_Enumerate.
+//
+typedef struct
+{
+    // The Client's enumeration callback and its context.
+    //
+    EVT_DMF_BufferPool_Enumeration* EntryEnumerationCallback;
+    VOID* ClientDriverCallbackContext;
+    // Set when the Client's callback stops the enumeration.
+    //
+    BOOLEAN EnumerationStopped;
+} BUFFERQUEUE_PRIORITY_ENUMERATION_CONTEXT;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -47,6 +92,33 @@ typedef struct _DMF_CONTEXT_BufferQueue
     // DMFMODULE to Consumer BufferPool.
     //
     DMFMODULE DmfModuleBufferPoolConsumer;
+    // The following are used only with BufferQueue_Backend_LockFree.
+    // Buffers the producer can fetch. Every buffer created by the Producer BufferPool
+    // is moved to this queue when the Module opens.
+    //
+    BUFFERQUEUE_LOCKFREE_QUEUE FreeQueue;
+    // Buffers the consumer can dequeue.
+    //
+    BUFFERQUEUE_LOCKFREE_QUEUE ReadyQueue;
+    // Number of buffers added with DMF_BufferQueue_EnqueueAtHead. These buffers are held in the
+    // Consumer BufferPool, which is only locked while this number is not zero.
+    //
+    volatile LONG NumberOfBuffersAtHead;
+    // The following are used only when NumberOfPriorityLevels is greater than 1.
+    // Consumer BufferPools of priority levels 1 and above. Level 0 uses DmfModuleBufferPoolConsumer.
+    //
+    DMFMODULE DmfModuleBufferPoolConsumerPriority[BufferQueue_PriorityLevelsMaximum];
+    // Bit N is set when priority level N may have buffers. A bit is only cleared when a dequeue finds
+    // that level empty because timers and enumeration can remove buffers without this Module knowing.
+    // This and the following fields are protected by this Module's lock.
+    //
+    ULONG PriorityLevelsBitmap;
+    // Number of dequeues since aging last selected a lower priority level.
+    //
+    ULONG PriorityAgingDequeueCount;
+    // Priority level that aging selected last time. Aging selects a level below it next time.
+    //
+    ULONG PriorityAgingCursor;
 } DMF_CONTEXT_BufferQueue;
 
 // This macro declares the following function:
@@ -63,6 +135,11 @@ DMF_MODULE_DECLARE_CONFIG(BufferQueue)
 //
 #define MemoryTag 'oMQB'
 
+// Number of buffers moved at a time from the consumer list to the producer list by
+// DMF_BufferQueue_Flush.
+//
+#define BufferQueue_FlushBatchSize  32
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // DMF Module Support Code
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -181,105 +258,102 @@ Return Value:
     FuncExitVoid(DMF_TRACE);
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// WDF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// DMF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
 #pragma code_seg("PAGE")
-_Function_class_(DMF_ChildModulesAdd)
 _IRQL_requires_max_(PASSIVE_LEVEL)
-VOID
-DMF_BufferQueue_ChildModulesAdd(
+_Must_inspect_result_
+static
+NTSTATUS
+BufferQueue_LockFreeQueueCreate(
     _In_ DMFMODULE DmfModule,
-    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
-    _In_ PDMFMODULE_INIT DmfModuleInit
+    _Out_ BUFFERQUEUE_LOCKFREE_QUEUE* Queue,
+    _In_ ULONG NumberOfBuffers
     )
 /*++
 
 Routine Description:
 
-    Configure and add the required Child Modules to the given Parent Module.
+    Create an empty lock-free queue that can hold a given number of buffers.
 
 Arguments:
 
-    DmfModule - The given Parent Module.
-    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
-    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+    DmfModule - This Module's handle.
+    Queue - The lock-free queue to create.
+    NumberOfBuffers - The maximum number of buffers the queue holds.
 
 Return Value:
 
-    None
+    NTSTATUS
 
 --*/
 {
-    DMF_CONFIG_BufferPool moduleConfigProducer;
-    DMF_CONFIG_BufferPool moduleConfigConsumer;
-    DMF_MODULE_ATTRIBUTES moduleAttributes;
-    DMF_CONFIG_BufferQueue* moduleConfig;
-    DMF_CONTEXT_BufferQueue* moduleContext;
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    ULONG numberOfCells;
+    ULONG cellIndex;
 
     PAGED_CODE();
 
-    FuncEntry(DMF_TRACE);
+    RtlZeroMemory(Queue,
+                  sizeof(BUFFERQUEUE_LOCKFREE_QUEUE));
 
-    moduleConfig = DMF_CONFIG_GET(DmfModule);
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    // The number of cells is a power of 2 so that a position is converted to a cell index with a mask.
+    //
+    numberOfCells = 1;
+    while (numberOfCells < NumberOfBuffers)
+    {
+        numberOfCells <<= 1;
+    }
 
-    // BufferPoolProducer
-    // ------------------
+    // The cells are accessed at DISPATCH_LEVEL so they are always in non-paged pool.
     //
-    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigProducer,
-                                              &moduleAttributes);
-    moduleConfigProducer.BufferPoolMode = BufferPool_Mode_Source;
-    moduleConfigProducer.Mode.SourceSettings = moduleConfig->SourceSettings;
-    moduleConfigProducer.Mode.SourceSettings.BufferContextSize = moduleConfigProducer.Mode.SourceSettings.BufferContextSize + sizeof(BufferQueue_BufferContextInternal);
-    moduleAttributes.ClientModuleInstanceName = "BufferPoolProducer";
-    moduleAttributes.PassiveLevel = DmfParentModuleAttributes->PassiveLevel;
-    DMF_DmfModuleAdd(DmfModuleInit,
-                     &moduleAttributes,
-                     WDF_NO_OBJECT_ATTRIBUTES,
-                     &moduleContext->DmfModuleBufferPoolProducer);
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               (size_t)numberOfCells * sizeof(BUFFERQUEUE_CELL),
+                               &Queue->MemoryCells,
+                               (VOID**)&Queue->Cells);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        Queue->MemoryCells = NULL;
+        Queue->Cells = NULL;
+        goto Exit;
+    }
 
-    // BufferPoolConsumer
-    // ------------------
+    // Each cell can be written by the first enqueue that reaches it.
     //
-    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigConsumer,
-                                              &moduleAttributes);
-    moduleConfigConsumer.BufferPoolMode = BufferPool_Mode_Sink;
-    moduleAttributes.ClientModuleInstanceName = "BufferPoolConsumer";
-    moduleAttributes.PassiveLevel = DmfParentModuleAttributes->PassiveLevel;
-    DMF_DmfModuleAdd(DmfModuleInit,
-                     &moduleAttributes,
-                     WDF_NO_OBJECT_ATTRIBUTES,
-                     &moduleContext->DmfModuleBufferPoolConsumer);
+    for (cellIndex = 0; cellIndex < numberOfCells; cellIndex++)
+    {
+        Queue->Cells[cellIndex].Sequence = (LONG)cellIndex;
+        Queue->Cells[cellIndex].ClientBuffer = NULL;
+    }
 
-    FuncExitVoid(DMF_TRACE);
+    Queue->CellIndexMask = numberOfCells - 1;
+
+Exit:
+
+    return ntStatus;
 }
 #pragma code_seg()
 
 #pragma code_seg("PAGE")
-_Function_class_(DMF_Close)
 _IRQL_requires_max_(PASSIVE_LEVEL)
 static
 VOID
-DMF_BufferQueue_Close(
-    _In_ DMFMODULE DmfModule
+BufferQueue_LockFreeQueueDestroy(
+    _Inout_ BUFFERQUEUE_LOCKFREE_QUEUE* Queue
     )
 /*++
 
 Routine Description:
 
-    Uninitialize an instance of a DMF Module of type BufferQueue.
+    Destroy a lock-free queue created by BufferQueue_LockFreeQueueCreate().
 
 Arguments:
 
-    DmfModule - This Module's handle.
+    Queue - The lock-free queue to destroy.
 
 Return Value:
 
@@ -287,204 +361,1389 @@ Return Value:
 
 --*/
 {
-    DMF_CONTEXT_BufferQueue* moduleContext;
-
     PAGED_CODE();
 
-    FuncEntry(DMF_TRACE);
-
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-
-    // This causes the Client's clean up callback to be called in case the Client
-    // referenced or allocated objects associated with the buffers.
-    //
-    DMF_BufferQueue_Flush(DmfModule);
-
-    FuncExitNoReturn(DMF_TRACE);
+    if (Queue->MemoryCells != NULL)
+    {
+        WdfObjectDelete(Queue->MemoryCells);
+        Queue->MemoryCells = NULL;
+        Queue->Cells = NULL;
+    }
 }
 #pragma code_seg()
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// Public Calls by Client
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
-#pragma code_seg("PAGE")
-_IRQL_requires_max_(PASSIVE_LEVEL)
-_Must_inspect_result_
-NTSTATUS
-DMF_BufferQueue_Create(
-    _In_ WDFDEVICE Device,
-    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
-    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
-    _Out_ DMFMODULE* DmfModule
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferQueue_LockFreeQueueAdd(
+    _Inout_ BUFFERQUEUE_LOCKFREE_QUEUE* Queue,
+    _In_ VOID* ClientBuffer
     )
 /*++
 
 Routine Description:
 
-    Create an instance of a DMF Module of type BufferQueue.
+    Adds a Client Buffer to the tail of a lock-free queue.
+    NOTE: The queue is never full because it has a cell for every buffer. However, the cell at the
+          tail may still belong to the thread that removed the previous buffer in that cell. In that
+          case, this call waits for that thread, which owns the cell for a few instructions only.
 
 Arguments:
 
-    Device - Client Driver's WDFDEVICE object.
-    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
-    ObjectAttributes - WDF object attributes for DMFMODULE.
-    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+    Queue - The given lock-free queue.
+    ClientBuffer - The buffer to add to the queue.
 
 Return Value:
 
-    NTSTATUS
+    None
 
 --*/
 {
-    NTSTATUS ntStatus;
-    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_BufferQueue;
-    DMF_CALLBACKS_DMF dmfCallbacksDmf_BufferQueue;
+    BUFFERQUEUE_CELL* cell;
+    ULONG position;
+    ULONG positionObserved;
+    LONG difference;
+#if defined(DMF_KERNEL_MODE)
+    KIRQL oldIrql;
+
+    // A thread that owns a cell cannot be preempted so that other threads
+    // never wait for a cell that belongs to a thread that is not running.
+    //
+    KeRaiseIrql(DISPATCH_LEVEL,
+                &oldIrql);
+#endif
 
-    PAGED_CODE();
+    position = (ULONG)ReadNoFence(&Queue->EnqueuePosition.Value);
+    for (;;)
+    {
+        cell = &Queue->Cells[position & Queue->CellIndexMask];
+        difference = (LONG)((ULONG)ReadAcquire(&cell->Sequence) - position);
+        if (0 == difference)
+        {
+            // The cell is free. Claim it by moving the position past it.
+            //
+            positionObserved = (ULONG)InterlockedCompareExchange(&Queue->EnqueuePosition.Value,
+                                                                 (LONG)(position + 1),
+                                                                 (LONG)position);
+            if (positionObserved == position)
+            {
+                break;
+            }
+            position = positionObserved;
+        }
+        else
+        {
+            if (difference < 0)
+            {
+                // The buffer that was in the cell one lap ago is still being read.
+                //
+                YieldProcessor();
+            }
+            // Otherwise, another thread claimed the cell.
+            //
+            position = (ULONG)ReadNoFence(&Queue->EnqueuePosition.Value);
+        }
+    }
 
-    FuncEntry(DMF_TRACE);
+    cell->ClientBuffer = ClientBuffer;
 
-    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_BufferQueue);
-    dmfCallbacksDmf_BufferQueue.ChildModulesAdd = DMF_BufferQueue_ChildModulesAdd;
-    dmfCallbacksDmf_BufferQueue.DeviceClose = DMF_BufferQueue_Close;
+    // Release semantics guarantee the buffer is visible before the cell is given to the consumers.
+    //
+    WriteRelease(&cell->Sequence,
+                 (LONG)(position + 1));
 
-    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_BufferQueue,
-                                            BufferQueue,
-                                            DMF_CONTEXT_BufferQueue,
-                                            DMF_MODULE_OPTIONS_DISPATCH_MAXIMUM,
-                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+#if defined(DMF_KERNEL_MODE)
+    KeLowerIrql(oldIrql);
+#endif
+}
 
-    dmfModuleDescriptor_BufferQueue.CallbacksDmf = &dmfCallbacksDmf_BufferQueue;
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+BufferQueue_LockFreeQueueCount(
+    _In_ BUFFERQUEUE_LOCKFREE_QUEUE* Queue
+    )
+/*++
 
-    ntStatus = DMF_ModuleCreate(Device,
-                                DmfModuleAttributes,
-                                ObjectAttributes,
-                                &dmfModuleDescriptor_BufferQueue,
-                                DmfModule);
-    if (! NT_SUCCESS(ntStatus))
+Routine Description:
+
+    Return the number of buffers in a lock-free queue. The number is only a snapshot since
+    other threads may add or remove buffers at the same time.
+
+Arguments:
+
+    Queue - The given lock-free queue.
+
+Return Value:
+
+    Number of buffers in the queue.
+
+--*/
+{
+    ULONG dequeuePosition;
+    ULONG enqueuePosition;
+    ULONG numberOfBuffers;
+
+    dequeuePosition = (ULONG)ReadAcquire(&Queue->DequeuePosition.Value);
+    enqueuePosition = (ULONG)ReadAcquire(&Queue->EnqueuePosition.Value);
+    numberOfBuffers = enqueuePosition - dequeuePosition;
+
+    // Both positions are not read at the same time so the difference can be briefly out of range.
+    //
+    if ((LONG)numberOfBuffers < 0)
     {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+        numberOfBuffers = 0;
+    }
+    else if (numberOfBuffers > Queue->CellIndexMask + 1)
+    {
+        numberOfBuffers = Queue->CellIndexMask + 1;
     }
 
-    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
-
-    return(ntStatus);
+    return numberOfBuffers;
 }
-#pragma code_seg()
-
-// Module Methods
-//
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-VOID
-DMF_BufferQueue_ContextGet(
-    _In_ DMFMODULE DmfModule,
-    _In_ VOID* ClientBuffer,
-    _Out_ VOID** ClientBufferContext
+static
+BOOLEAN
+BufferQueue_LockFreeQueueRemove(
+    _Inout_ BUFFERQUEUE_LOCKFREE_QUEUE* Queue,
+    _Out_ VOID** ClientBuffer
     )
 /*++
 
 Routine Description:
 
-    Get the context associated with the given Client buffer.
+    Removes the Client Buffer at the head of a lock-free queue if there is one.
 
 Arguments:
 
-    DmfModule - This Module's handle.
-    ClientBuffer - The given Client buffer.
-    ClientBufferContext - Client context associated with the buffer.
+    Queue - The given lock-free queue.
+    ClientBuffer - The removed buffer or NULL if the queue is empty.
 
 Return Value:
 
-    None
+    TRUE if a buffer is removed from the queue.
+    FALSE if the queue is empty.
 
 --*/
 {
-    DMF_CONTEXT_BufferQueue* moduleContext;
+    BUFFERQUEUE_CELL* cell;
+    ULONG position;
+    ULONG positionObserved;
+    LONG difference;
+    BOOLEAN bufferRemoved;
+#if defined(DMF_KERNEL_MODE)
+    KIRQL oldIrql;
+
+    // See BufferQueue_LockFreeQueueAdd().
+    //
+    KeRaiseIrql(DISPATCH_LEVEL,
+                &oldIrql);
+#endif
 
-    FuncEntry(DMF_TRACE);
+    *ClientBuffer = NULL;
+    bufferRemoved = FALSE;
 
-    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
-                                 BufferQueue);
+    position = (ULONG)ReadNoFence(&Queue->DequeuePosition.Value);
+    for (;;)
+    {
+        cell = &Queue->Cells[position & Queue->CellIndexMask];
+        difference = (LONG)((ULONG)ReadAcquire(&cell->Sequence) - (position + 1));
+        if (0 == difference)
+        {
+            // The cell holds a buffer. Claim it by moving the position past it.
+            //
+            positionObserved = (ULONG)InterlockedCompareExchange(&Queue->DequeuePosition.Value,
+                                                                 (LONG)(position + 1),
+                                                                 (LONG)position);
+            if (positionObserved == position)
+            {
+                bufferRemoved = TRUE;
+                break;
+            }
+            position = positionObserved;
+        }
+        else if (difference < 0)
+        {
+            // The cell has not been written yet so the queue is empty.
+            //
+            break;
+        }
+        else
+        {
+            // Another thread claimed the cell.
+            //
+            position = (ULONG)ReadNoFence(&Queue->DequeuePosition.Value);
+        }
+    }
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    if (bufferRemoved)
+    {
+        *ClientBuffer = cell->ClientBuffer;
 
-    DMF_BufferPool_ContextGet(moduleContext->DmfModuleBufferPoolProducer,
-                              ClientBuffer,
-                              ClientBufferContext);
+        // Release semantics guarantee the buffer has been read before the cell is given to the producers.
+        // The next enqueue that writes this cell is one lap later.
+        //
+        WriteRelease(&cell->Sequence,
+                     (LONG)(position + Queue->CellIndexMask + 1));
+    }
 
-    FuncExitVoid(DMF_TRACE);
+#if defined(DMF_KERNEL_MODE)
+    KeLowerIrql(oldIrql);
+#endif
+
+    return bufferRemoved;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-ULONG
-DMF_BufferQueue_Count(
-    _In_ DMFMODULE DmfModule
+static
+BOOLEAN
+BufferQueue_LockFreeDequeue(
+    _In_ DMF_CONTEXT_BufferQueue* ModuleContext,
+    _Out_ VOID** ClientBuffer
     )
 /*++
 
 Routine Description:
 
-    Return the number of entries currently in the list.
+    Removes the next buffer from the consumer lists when the Module uses BufferQueue_Backend_LockFree.
+    Buffers added with DMF_BufferQueue_EnqueueAtHead are removed before the buffers in ReadyQueue.
 
 Arguments:
 
-    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    ClientBuffer - The removed buffer or NULL if there are no buffers.
 
 Return Value:
 
-    None
+    TRUE if a buffer is removed.
+    FALSE if there are no buffers.
 
 --*/
 {
-    DMF_CONTEXT_BufferQueue* moduleContext;
-    ULONG numberOfEntriesInList;
+    NTSTATUS ntStatus;
+    BOOLEAN bufferRemoved;
 
-    FuncEntry(DMF_TRACE);
+    bufferRemoved = FALSE;
 
-    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
-                                 BufferQueue);
+    if (ReadNoFence(&ModuleContext->NumberOfBuffersAtHead) > 0)
+    {
+        ntStatus = DMF_BufferPool_Get(ModuleContext->DmfModuleBufferPoolConsumer,
+                                      ClientBuffer,
+                                      NULL);
+        if (NT_SUCCESS(ntStatus))
+        {
+            InterlockedDecrement(&ModuleContext->NumberOfBuffersAtHead);
+            bufferRemoved = TRUE;
+        }
+    }
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    if (! bufferRemoved)
+    {
+        bufferRemoved = BufferQueue_LockFreeQueueRemove(&ModuleContext->ReadyQueue,
+                                                        ClientBuffer);
+    }
+
+    return bufferRemoved;
+}
 
-    numberOfEntriesInList = DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolConsumer);
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferQueue_LockFreeReuse(
+    _In_ DMF_CONTEXT_BufferQueue* ModuleContext,
+    _In_ VOID* ClientBuffer
+    )
+/*++
+
+Routine Description:
+
+    Adds a Client Buffer to FreeQueue when the Module uses BufferQueue_Backend_LockFree.
+    Like the Producer BufferPool, the buffer and its context are cleared so that stale data
+    does not appear when the buffer is fetched again.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    ClientBuffer - The buffer to add to FreeQueue.
+
+Return Value:
+
+    None
+
+--*/
+{
+    VOID* clientBufferContext;
+    ULONG clientBufferSize;
+    ULONG clientBufferContextSize;
+
+    DMF_BufferPool_ParametersGet(ModuleContext->DmfModuleBufferPoolProducer,
+                                 ClientBuffer,
+                                 NULL,
+                                 NULL,
+                                 &clientBufferSize,
+                                 &clientBufferContext,
+                                 &clientBufferContextSize);
+
+    RtlZeroMemory(ClientBuffer,
+                  clientBufferSize);
+    if (clientBufferContextSize > 0)
+    {
+        RtlZeroMemory(clientBufferContext,
+                      clientBufferContextSize);
+    }
+
+    BufferQueue_LockFreeQueueAdd(&ModuleContext->FreeQueue,
+                                 ClientBuffer);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+DMFMODULE
+BufferQueue_PriorityConsumerGet(
+    _In_ DMF_CONTEXT_BufferQueue* ModuleContext,
+    _In_ ULONG Priority
+    )
+/*++
+
+Routine Description:
+
+    Get the Consumer BufferPool that holds the buffers of a given priority level.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Priority - The given priority level.
+
+Return Value:
+
+    The Consumer BufferPool of that priority level.
+
+--*/
+{
+    DMFMODULE dmfModuleBufferPool;
+
+    DmfAssert(Priority < BufferQueue_PriorityLevelsMaximum);
+
+    if (0 == Priority)
+    {
+        dmfModuleBufferPool = ModuleContext->DmfModuleBufferPoolConsumer;
+    }
+    else
+    {
+        dmfModuleBufferPool = ModuleContext->DmfModuleBufferPoolConsumerPriority[Priority];
+    }
+
+    DmfAssert(dmfModuleBufferPool != NULL);
+
+    return dmfModuleBufferPool;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+BufferQueue_PriorityLevelSelect(
+    _In_ DMF_CONFIG_BufferQueue* ModuleConfig,
+    _Inout_ DMF_CONTEXT_BufferQueue* ModuleContext,
+    _Out_ ULONG* Priority
+    )
+/*++
+
+Routine Description:
+
+    Select the priority level of the next buffer to dequeue. This is the highest priority level
+    that is not empty, except for every PriorityAgingInterval-th dequeue which selects the
+    next lower priority level that is not empty in turn.
+    NOTE: Module lock is held during this call.
+
+Arguments:
+
+    ModuleConfig - This Module's Config.
+    ModuleContext - This Module's context.
+    Priority - The selected priority level.
+
+Return Value:
+
+    TRUE if a priority level may have buffers.
+    FALSE if all the priority levels are empty.
+
+--*/
+{
+    ULONG priorityHighest;
+    ULONG lowerLevelsBitmap;
+    ULONG candidateLevelsBitmap;
+
+    if (! BitScanReverse(&priorityHighest,
+                         ModuleContext->PriorityLevelsBitmap))
+    {
+        *Priority = 0;
+        return FALSE;
+    }
+
+    *Priority = priorityHighest;
+
+    if (ModuleConfig->PriorityAgingInterval > 0)
+    {
+        ModuleContext->PriorityAgingDequeueCount++;
+        if (ModuleContext->PriorityAgingDequeueCount >= ModuleConfig->PriorityAgingInterval)
+        {
+            ModuleContext->PriorityAgingDequeueCount = 0;
+
+            lowerLevelsBitmap = ModuleContext->PriorityLevelsBitmap & ((1UL << priorityHighest) - 1);
+            if (lowerLevelsBitmap != 0)
+            {
+                // Take the lower levels in turn: start below the level that aging selected last time
+                // and start again from the top after the lowest level.
+                //
+                candidateLevelsBitmap = lowerLevelsBitmap & ((1UL << ModuleContext->PriorityAgingCursor) - 1);
+                if (0 == candidateLevelsBitmap)
+                {
+                    candidateLevelsBitmap = lowerLevelsBitmap;
+                }
+                BitScanReverse(Priority,
+                               candidateLevelsBitmap);
+                ModuleContext->PriorityAgingCursor = *Priority;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+BufferQueue_PriorityDequeue(
+    _In_ DMFMODULE DmfModule,
+    _Out_ VOID** ClientBuffer,
+    _Out_opt_ PWDF_MEMORY_DESCRIPTOR MemoryDescriptor,
+    _Out_opt_ VOID** ClientBufferContext
+    )
+/*++
+
+Routine Description:
+
+    Removes the next buffer from the consumer list when the Module has priority levels.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The Client Buffer.
+    MemoryDescriptor - Optional WDF Memory Descriptor associated with removed buffer.
+                       ClientBufferContext is required when it is used.
+    ClientBufferContext - Client context associated with the buffer.
+
+Return Value:
+
+    STATUS_SUCCESS if a buffer is removed from the list.
+    STATUS_UNSUCCESSFUL if the list is empty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    DMFMODULE dmfModuleBufferPool;
+    ULONG priority;
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ntStatus = STATUS_UNSUCCESSFUL;
+    *ClientBuffer = NULL;
+
+    DMF_ModuleLock(DmfModule);
+
+    while (BufferQueue_PriorityLevelSelect(moduleConfig,
+                                           moduleContext,
+                                           &priority))
+    {
+        dmfModuleBufferPool = BufferQueue_PriorityConsumerGet(moduleContext,
+                                                              priority);
+        if (MemoryDescriptor != NULL)
+        {
+            DmfAssert(ClientBufferContext != NULL);
+            ntStatus = DMF_BufferPool_GetWithMemoryDescriptor(dmfModuleBufferPool,
+                                                              ClientBuffer,
+                                                              MemoryDescriptor,
+                                                              ClientBufferContext);
+        }
+        else
+        {
+            ntStatus = DMF_BufferPool_Get(dmfModuleBufferPool,
+                                          ClientBuffer,
+                                          ClientBufferContext);
+        }
+        if (NT_SUCCESS(ntStatus))
+        {
+            break;
+        }
+
+        // The level is empty. Its last buffers may have been removed by a timer or by enumeration.
+        //
+        moduleContext->PriorityLevelsBitmap &= ~(1UL << priority);
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferQueue_PriorityEnqueue(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG Priority,
+    _In_ BOOLEAN AtHead
+    )
+/*++
+
+Routine Description:
+
+    Adds a Client Buffer to a given priority level of the consumer list when the Module has
+    priority levels.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The buffer to add to the list.
+    Priority - The given priority level.
+    AtHead - Adds the buffer at the head of the priority level instead of its tail.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    DMFMODULE dmfModuleBufferPool;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    dmfModuleBufferPool = BufferQueue_PriorityConsumerGet(moduleContext,
+                                                          Priority);
+
+    DMF_ModuleLock(DmfModule);
+
+    if (AtHead)
+    {
+        DMF_BufferPool_PutAtHead(dmfModuleBufferPool,
+                                 ClientBuffer);
+    }
+    else
+    {
+        DMF_BufferPool_Put(dmfModuleBufferPool,
+                           ClientBuffer);
+    }
+
+    moduleContext->PriorityLevelsBitmap |= (1UL << Priority);
+
+    DMF_ModuleUnlock(DmfModule);
+}
+
+_Function_class_(EVT_DMF_BufferPool_Enumeration)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+BufferPool_EnumerationDispositionType
+BufferQueue_PriorityEnumerationCallback(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ VOID* ClientBufferContext,
+    _In_opt_ VOID* ClientDriverCallbackContext
+    )
+/*++
+
+Routine Description:
+
+    Calls the Client's enumeration callback for a buffer of a priority level and remembers
+    if the Client stopped the enumeration so that lower priority levels are not enumerated.
+
+Arguments:
+
+    DmfModule - The Consumer BufferPool of the priority level.
+    ClientBuffer - The enumerated buffer.
+    ClientBufferContext - Context associated with the buffer.
+    ClientDriverCallbackContext - BUFFERQUEUE_PRIORITY_ENUMERATION_CONTEXT.
+
+Return Value:
+
+    The disposition returned by the Client's enumeration callback.
+
+--*/
+{
+    BUFFERQUEUE_PRIORITY_ENUMERATION_CONTEXT* enumerationContext;
+    BufferPool_EnumerationDispositionType enumerationDisposition;
+
+    enumerationContext = (BUFFERQUEUE_PRIORITY_ENUMERATION_CONTEXT*)ClientDriverCallbackContext;
+    DmfAssert(enumerationContext != NULL);
+
+    enumerationDisposition = enumerationContext->EntryEnumerationCallback(DmfModule,
+                                                                          ClientBuffer,
+                                                                          ClientBufferContext,
+                                                                          enumerationContext->ClientDriverCallbackContext);
+    switch (enumerationDisposition)
+    {
+        case BufferPool_EnumerationDisposition_ContinueEnumeration:
+        case BufferPool_EnumerationDisposition_StopTimerAndContinueEnumeration:
+        case BufferPool_EnumerationDisposition_ResetTimerAndContinueEnumeration:
+        {
+            break;
+        }
+        default:
+        {
+            enumerationContext->EnumerationStopped = TRUE;
+            break;
+        }
+    }
+
+    return enumerationDisposition;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_BufferQueue_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONFIG_BufferPool moduleConfigProducer;
+    DMF_CONFIG_BufferPool moduleConfigConsumer;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // BufferPoolProducer
+    // ------------------
+    //
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigProducer,
+                                              &moduleAttributes);
+    moduleConfigProducer.BufferPoolMode = BufferPool_Mode_Source;
+    moduleConfigProducer.Mode.SourceSettings = moduleConfig->SourceSettings;
+    moduleConfigProducer.Mode.SourceSettings.BufferContextSize = moduleConfigProducer.Mode.SourceSettings.BufferContextSize + sizeof(BufferQueue_BufferContextInternal);
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        // The Producer BufferPool only holds the buffers while this Module is not open
+        // so it does not need per-processor caches.
+        //
+        moduleConfigProducer.Mode.SourceSettings.PerProcessorCacheSize = 0;
+    }
+    moduleAttributes.ClientModuleInstanceName = "BufferPoolProducer";
+    moduleAttributes.PassiveLevel = DmfParentModuleAttributes->PassiveLevel;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferPoolProducer);
+
+    // BufferPoolConsumer
+    // ------------------
+    //
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigConsumer,
+                                              &moduleAttributes);
+    moduleConfigConsumer.BufferPoolMode = BufferPool_Mode_Sink;
+    moduleAttributes.ClientModuleInstanceName = "BufferPoolConsumer";
+    moduleAttributes.PassiveLevel = DmfParentModuleAttributes->PassiveLevel;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferPoolConsumer);
+
+    // BufferPoolConsumerPriority
+    // --------------------------
+    // Each priority level above level 0 has its own Consumer BufferPool.
+    // Open fails if there are too many priority levels.
+    //
+    for (ULONG priority = 1; priority < moduleConfig->NumberOfPriorityLevels; priority++)
+    {
+        if (priority >= BufferQueue_PriorityLevelsMaximum)
+        {
+            break;
+        }
+        DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigConsumer,
+                                                  &moduleAttributes);
+        moduleConfigConsumer.BufferPoolMode = BufferPool_Mode_Sink;
+        moduleAttributes.ClientModuleInstanceName = "BufferPoolConsumerPriority";
+        moduleAttributes.PassiveLevel = DmfParentModuleAttributes->PassiveLevel;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleBufferPoolConsumerPriority[priority]);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_BufferQueue_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type BufferQueue.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    VOID* buffers[BufferQueue_FlushBatchSize];
+    ULONG numberOfBuffers;
+    ULONG bufferIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ntStatus = STATUS_SUCCESS;
+
+    if (moduleConfig->NumberOfPriorityLevels > 1)
+    {
+        if ((moduleConfig->NumberOfPriorityLevels > BufferQueue_PriorityLevelsMaximum) ||
+            (moduleConfig->Backend != BufferQueue_Backend_BufferPool))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Invalid NumberOfPriorityLevels=%d", moduleConfig->NumberOfPriorityLevels);
+            DmfAssert(FALSE);
+            ntStatus = STATUS_INVALID_PARAMETER;
+            goto Exit;
+        }
+
+        moduleContext->PriorityLevelsBitmap = 0;
+        moduleContext->PriorityAgingDequeueCount = 0;
+        moduleContext->PriorityAgingCursor = moduleConfig->NumberOfPriorityLevels;
+    }
+
+    if (moduleConfig->Backend != BufferQueue_Backend_LockFree)
+    {
+        DmfAssert(BufferQueue_Backend_BufferPool == moduleConfig->Backend);
+        goto Exit;
+    }
+
+    // The lock-free queues have a fixed number of cells so the Producer BufferPool
+    // must have a fixed number of buffers.
+    //
+    if (moduleConfig->SourceSettings.EnableLookAside ||
+        (moduleConfig->SourceSettings.NumberOfSizeClasses > 0) ||
+        (moduleConfig->SourceSettings.AdaptiveBufferCountMaximum > 0))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "BufferQueue_Backend_LockFree requires a fixed number of buffers");
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    moduleContext->NumberOfBuffersAtHead = 0;
+
+    ntStatus = BufferQueue_LockFreeQueueCreate(DmfModule,
+                                               &moduleContext->FreeQueue,
+                                               moduleConfig->SourceSettings.BufferCount);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    ntStatus = BufferQueue_LockFreeQueueCreate(DmfModule,
+                                               &moduleContext->ReadyQueue,
+                                               moduleConfig->SourceSettings.BufferCount);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        BufferQueue_LockFreeQueueDestroy(&moduleContext->FreeQueue);
+        goto Exit;
+    }
+
+    // Move all the buffers the Producer BufferPool created to FreeQueue.
+    //
+    while (NT_SUCCESS(DMF_BufferPool_GetMultiple(moduleContext->DmfModuleBufferPoolProducer,
+                                                 ARRAYSIZE(buffers),
+                                                 buffers,
+                                                 NULL,
+                                                 &numberOfBuffers)))
+    {
+        for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+        {
+            BufferQueue_LockFreeQueueAdd(&moduleContext->FreeQueue,
+                                         buffers[bufferIndex]);
+        }
+    }
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+DMF_BufferQueue_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type BufferQueue.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    VOID* clientBuffer;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // This causes the Client's clean up callback to be called in case the Client
+    // referenced or allocated objects associated with the buffers.
+    //
+    DMF_BufferQueue_Flush(DmfModule);
+
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        // Give the buffers back to the Producer BufferPool so that it can delete them.
+        //
+        while (BufferQueue_LockFreeQueueRemove(&moduleContext->FreeQueue,
+                                               &clientBuffer))
+        {
+            DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolProducer,
+                               clientBuffer);
+        }
+
+        BufferQueue_LockFreeQueueDestroy(&moduleContext->ReadyQueue);
+        BufferQueue_LockFreeQueueDestroy(&moduleContext->FreeQueue);
+    }
+
+    FuncExitNoReturn(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type BufferQueue.
+
+Arguments:
+
+    Device - Client Driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_BufferQueue;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_BufferQueue;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_BufferQueue);
+    dmfCallbacksDmf_BufferQueue.ChildModulesAdd = DMF_BufferQueue_ChildModulesAdd;
+    dmfCallbacksDmf_BufferQueue.DeviceOpen = DMF_BufferQueue_Open;
+    dmfCallbacksDmf_BufferQueue.DeviceClose = DMF_BufferQueue_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_BufferQueue,
+                                            BufferQueue,
+                                            DMF_CONTEXT_BufferQueue,
+                                            DMF_MODULE_OPTIONS_DISPATCH_MAXIMUM,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_BufferQueue.CallbacksDmf = &dmfCallbacksDmf_BufferQueue;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_BufferQueue,
+                                DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferQueue_ContextGet(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _Out_ VOID** ClientBufferContext
+    )
+/*++
+
+Routine Description:
+
+    Get the context associated with the given Client buffer.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The given Client buffer.
+    ClientBufferContext - Client context associated with the buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferQueue* moduleContext;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferQueue);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_BufferPool_ContextGet(moduleContext->DmfModuleBufferPoolProducer,
+                              ClientBuffer,
+                              ClientBufferContext);
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONG
+DMF_BufferQueue_Count(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Return the number of entries currently in the list.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    ULONG numberOfEntriesInList;
+    LONG numberOfBuffersAtHead;
+    ULONG priority;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferQueue);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        numberOfEntriesInList = BufferQueue_LockFreeQueueCount(&moduleContext->ReadyQueue);
+        numberOfBuffersAtHead = ReadNoFence(&moduleContext->NumberOfBuffersAtHead);
+        if (numberOfBuffersAtHead > 0)
+        {
+            numberOfEntriesInList += (ULONG)numberOfBuffersAtHead;
+        }
+    }
+    else
+    {
+        numberOfEntriesInList = DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolConsumer);
+        for (priority = 1; priority < moduleConfig->NumberOfPriorityLevels; priority++)
+        {
+            numberOfEntriesInList += DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolConsumerPriority[priority]);
+        }
+    }
+
+    FuncExit(DMF_TRACE, "numberOfEntriesInList=%d", numberOfEntriesInList);
+
+    return numberOfEntriesInList;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_Dequeue(
+    _In_ DMFMODULE DmfModule,
+    _Out_ VOID** ClientBuffer,
+    _Out_opt_ VOID** ClientBufferContext
+    )
+/*++
+
+Routine Description:
+
+    Removes the next buffer in the consumer list (head of the list) if there is a buffer.
+    Then, returns the Client Buffer and its associated Client Buffer Context.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The Client Buffer.
+    ClientBufferContext - Client context associated with the buffer.
+
+Return Value:
+
+    STATUS_SUCCESS if a buffer is removed from the list.
+    STATUS_UNSUCCESSFUL if the list is empty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferQueue);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        if (BufferQueue_LockFreeDequeue(moduleContext,
+                                        ClientBuffer))
+        {
+            if (ClientBufferContext != NULL)
+            {
+                DMF_BufferPool_ContextGet(moduleContext->DmfModuleBufferPoolProducer,
+                                          *ClientBuffer,
+                                          ClientBufferContext);
+            }
+            ntStatus = STATUS_SUCCESS;
+        }
+        else
+        {
+            ntStatus = STATUS_UNSUCCESSFUL;
+        }
+    }
+    else if (moduleConfig->NumberOfPriorityLevels > 1)
+    {
+        ntStatus = BufferQueue_PriorityDequeue(DmfModule,
+                                               ClientBuffer,
+                                               NULL,
+                                               ClientBufferContext);
+    }
+    else
+    {
+        ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolConsumer,
+                                      ClientBuffer,
+                                      ClientBufferContext);
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_DequeueMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfBuffers,
+    _Out_writes_to_(NumberOfBuffers, *NumberOfBuffersReturned) VOID** ClientBuffers,
+    _Out_writes_opt_(NumberOfBuffers) VOID** ClientBufferContexts,
+    _Out_ ULONG* NumberOfBuffersReturned
+    )
+/*++
+
+Routine Description:
+
+    Removes up to NumberOfBuffers buffers from the head of the consumer list using a single
+    lock acquisition. Then, returns the Client Buffers and their associated Client Buffer Contexts.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    NumberOfBuffers - The maximum number of buffers to remove.
+    ClientBuffers - Array that receives the Client Buffers.
+    ClientBufferContexts - Optional array that receives the Client contexts associated with the buffers.
+    NumberOfBuffersReturned - The number of buffers written to ClientBuffers.
+
+Return Value:
+
+    STATUS_SUCCESS if at least one buffer is removed from the list.
+    STATUS_UNSUCCESSFUL if the list is empty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    ULONG bufferIndex;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD_CLOSING_OK(DmfModule,
+                                            BufferQueue);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        for (bufferIndex = 0; bufferIndex < NumberOfBuffers; bufferIndex++)
+        {
+            if (! BufferQueue_LockFreeDequeue(moduleContext,
+                                              &ClientBuffers[bufferIndex]))
+            {
+                break;
+            }
+            if (ClientBufferContexts != NULL)
+            {
+                DMF_BufferPool_ContextGet(moduleContext->DmfModuleBufferPoolProducer,
+                                          ClientBuffers[bufferIndex],
+                                          &ClientBufferContexts[bufferIndex]);
+            }
+        }
+
+        *NumberOfBuffersReturned = bufferIndex;
+        ntStatus = (bufferIndex > 0) ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+    }
+    else if (moduleConfig->NumberOfPriorityLevels > 1)
+    {
+        // Each buffer is selected separately so that priorities and aging apply to each of them.
+        //
+        for (bufferIndex = 0; bufferIndex < NumberOfBuffers; bufferIndex++)
+        {
+            if (! NT_SUCCESS(BufferQueue_PriorityDequeue(DmfModule,
+                                                         &ClientBuffers[bufferIndex],
+                                                         NULL,
+                                                         (ClientBufferContexts != NULL) ? &ClientBufferContexts[bufferIndex] : NULL)))
+            {
+                break;
+            }
+        }
+
+        *NumberOfBuffersReturned = bufferIndex;
+        ntStatus = (bufferIndex > 0) ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+    }
+    else
+    {
+        ntStatus = DMF_BufferPool_GetMultiple(moduleContext->DmfModuleBufferPoolConsumer,
+                                              NumberOfBuffers,
+                                              ClientBuffers,
+                                              ClientBufferContexts,
+                                              NumberOfBuffersReturned);
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_DequeueWithMemoryDescriptor(
+    _In_ DMFMODULE DmfModule,
+    _Out_ VOID** ClientBuffer,
+    _Out_ PWDF_MEMORY_DESCRIPTOR MemoryDescriptor,
+    _Out_ VOID** ClientBufferContext
+    )
+/*++
+
+Routine Description:
+
+    Removes the next buffer in the list (head of the list) if there is a buffer.
+    Then, returns the Client Buffer and its associated Memory Descriptor and ClientBufferContext.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The Client Buffer.
+    MemoryDescriptor - WDF Memory Descriptor associated with removed buffer.
+    ClientBufferContext - Client context associated with the buffer.
+
+Return Value:
+
+    STATUS_SUCCESS if a buffer is removed from the list.
+    STATUS_UNSUCCESSFUL if the list is empty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferQueue);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        if (BufferQueue_LockFreeDequeue(moduleContext,
+                                        ClientBuffer))
+        {
+            DMF_BufferPool_ParametersGet(moduleContext->DmfModuleBufferPoolProducer,
+                                         *ClientBuffer,
+                                         MemoryDescriptor,
+                                         NULL,
+                                         NULL,
+                                         ClientBufferContext,
+                                         NULL);
+            ntStatus = STATUS_SUCCESS;
+        }
+        else
+        {
+            *ClientBufferContext = NULL;
+            ntStatus = STATUS_UNSUCCESSFUL;
+        }
+    }
+    else if (moduleConfig->NumberOfPriorityLevels > 1)
+    {
+        ntStatus = BufferQueue_PriorityDequeue(DmfModule,
+                                               ClientBuffer,
+                                               MemoryDescriptor,
+                                               ClientBufferContext);
+    }
+    else
+    {
+        ntStatus = DMF_BufferPool_GetWithMemoryDescriptor(moduleContext->DmfModuleBufferPoolConsumer,
+                                                          ClientBuffer,
+                                                          MemoryDescriptor,
+                                                          ClientBufferContext);
+    }
 
-    FuncExit(DMF_TRACE, "numberOfEntriesInList=%d", numberOfEntriesInList);
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
-    return numberOfEntriesInList;
+    return ntStatus;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-_Must_inspect_result_
-NTSTATUS
-DMF_BufferQueue_Dequeue(
+VOID
+DMF_BufferQueue_Enqueue(
     _In_ DMFMODULE DmfModule,
-    _Out_ VOID** ClientBuffer,
-    _Out_opt_ VOID** ClientBufferContext
+    _In_ VOID* ClientBuffer
     )
 /*++
 
 Routine Description:
 
-    Removes the next buffer in the consumer list (head of the list) if there is a buffer.
-    Then, returns the Client Buffer and its associated Client Buffer Context.
+    Adds a Client Buffer to the end of the consumer list. This list is consumed in FIFO order.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    ClientBuffer - The Client Buffer.
-    ClientBufferContext - Client context associated with the buffer.
+    ClientBuffer - The buffer to add to the list.
+                   NOTE: This must be a properly formed buffer that was created by this Module.
 
 Return Value:
 
-    STATUS_SUCCESS if a buffer is removed from the list.
-    STATUS_UNSUCCESSFUL if the list is empty.
+    None
 
 --*/
 {
-    NTSTATUS ntStatus;
+    DMF_CONFIG_BufferQueue* moduleConfig;
     DMF_CONTEXT_BufferQueue* moduleContext;
 
     FuncEntry(DMF_TRACE);
@@ -492,48 +1751,55 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferQueue);
 
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolConsumer,
-                                  ClientBuffer,
-                                  ClientBufferContext);
-
-    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        BufferQueue_LockFreeQueueAdd(&moduleContext->ReadyQueue,
+                                     ClientBuffer);
+    }
+    else if (moduleConfig->NumberOfPriorityLevels > 1)
+    {
+        BufferQueue_PriorityEnqueue(DmfModule,
+                                    ClientBuffer,
+                                    0,
+                                    FALSE);
+    }
+    else
+    {
+        DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolConsumer,
+                           ClientBuffer);
+    }
 
-    return ntStatus;
+    FuncExitVoid(DMF_TRACE);
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-_Must_inspect_result_
-NTSTATUS
-DMF_BufferQueue_DequeueWithMemoryDescriptor(
+VOID
+DMF_BufferQueue_EnqueueAtHead(
     _In_ DMFMODULE DmfModule,
-    _Out_ VOID** ClientBuffer,
-    _Out_ PWDF_MEMORY_DESCRIPTOR MemoryDescriptor,
-    _Out_ VOID** ClientBufferContext
+    _In_ VOID* ClientBuffer
     )
 /*++
 
 Routine Description:
 
-    Removes the next buffer in the list (head of the list) if there is a buffer.
-    Then, returns the Client Buffer and its associated Memory Descriptor and ClientBufferContext.
+    Adds a Client Buffer to the head of the consumer list. This list is consumed in LIFO order.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    ClientBuffer - The Client Buffer.
-    MemoryDescriptor - WDF Memory Descriptor associated with removed buffer.
-    ClientBufferContext - Client context associated with the buffer.
+    ClientBuffer - The buffer to add to the list.
+                   NOTE: This must be a properly formed buffer that was created by this Module.
 
 Return Value:
 
-    STATUS_SUCCESS if a buffer is removed from the list.
-    STATUS_UNSUCCESSFUL if the list is empty.
+    None
 
 --*/
 {
-    NTSTATUS ntStatus;
+    DMF_CONFIG_BufferQueue* moduleConfig;
     DMF_CONTEXT_BufferQueue* moduleContext;
 
     FuncEntry(DMF_TRACE);
@@ -541,35 +1807,57 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferQueue);
 
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    ntStatus = DMF_BufferPool_GetWithMemoryDescriptor(moduleContext->DmfModuleBufferPoolConsumer,
-                                                      ClientBuffer,
-                                                      MemoryDescriptor,
-                                                      ClientBufferContext);
+    if (moduleConfig->NumberOfPriorityLevels > 1)
+    {
+        // The buffer is dequeued next so it goes to the head of the highest priority level.
+        //
+        BufferQueue_PriorityEnqueue(DmfModule,
+                                    ClientBuffer,
+                                    moduleConfig->NumberOfPriorityLevels - 1,
+                                    TRUE);
+        goto Exit;
+    }
 
-    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+    DMF_BufferPool_PutAtHead(moduleContext->DmfModuleBufferPoolConsumer,
+                             ClientBuffer);
 
-    return ntStatus;
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        // The lock-free queue only adds buffers at its tail. The Consumer BufferPool holds the buffers
+        // added at the head and it is checked first while this number is not zero.
+        // The buffer is in the list before it is counted so that it is never missed.
+        //
+        InterlockedIncrement(&moduleContext->NumberOfBuffersAtHead);
+    }
+
+Exit:
+
+    FuncExitVoid(DMF_TRACE);
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
-DMF_BufferQueue_Enqueue(
+DMF_BufferQueue_EnqueueMultiple(
     _In_ DMFMODULE DmfModule,
-    _In_ VOID* ClientBuffer
+    _In_reads_(NumberOfBuffers) VOID** ClientBuffers,
+    _In_ ULONG NumberOfBuffers
     )
 /*++
 
 Routine Description:
 
-    Adds a Client Buffer to the end of the consumer list. This list is consumed in FIFO order.
+    Adds Client Buffers to the end of the consumer list, in the order they are in the given
+    array, using a single lock acquisition. This list is consumed in FIFO order.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    ClientBuffer - The buffer to add to the list.
-                   NOTE: This must be a properly formed buffer that was created by this Module.
+    ClientBuffers - The buffers to add to the list.
+                    NOTE: These must be properly formed buffers that were created by this Module.
+    NumberOfBuffers - The number of buffers in ClientBuffers.
 
 Return Value:
 
@@ -577,38 +1865,68 @@ Return Value:
 
 --*/
 {
+    DMF_CONFIG_BufferQueue* moduleConfig;
     DMF_CONTEXT_BufferQueue* moduleContext;
+    ULONG bufferIndex;
 
     FuncEntry(DMF_TRACE);
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferQueue);
 
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolConsumer,
-                       ClientBuffer);
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        for (bufferIndex = 0; bufferIndex < NumberOfBuffers; bufferIndex++)
+        {
+            BufferQueue_LockFreeQueueAdd(&moduleContext->ReadyQueue,
+                                         ClientBuffers[bufferIndex]);
+        }
+    }
+    else if (moduleConfig->NumberOfPriorityLevels > 1)
+    {
+        DMF_ModuleLock(DmfModule);
+
+        DMF_BufferPool_PutMultiple(moduleContext->DmfModuleBufferPoolConsumer,
+                                   ClientBuffers,
+                                   NumberOfBuffers);
+        moduleContext->PriorityLevelsBitmap |= 1;
+
+        DMF_ModuleUnlock(DmfModule);
+    }
+    else
+    {
+        DMF_BufferPool_PutMultiple(moduleContext->DmfModuleBufferPoolConsumer,
+                                   ClientBuffers,
+                                   NumberOfBuffers);
+    }
 
     FuncExitVoid(DMF_TRACE);
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
-DMF_BufferQueue_EnqueueAtHead(
+DMF_BufferQueue_EnqueueWithPriority(
     _In_ DMFMODULE DmfModule,
-    _In_ VOID* ClientBuffer
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG Priority
     )
 /*++
 
 Routine Description:
 
-    Adds a Client Buffer to the head of the consumer list. This list is consumed in LIFO order.
+    Adds a Client Buffer to the end of a given priority level of the consumer list. Each level is
+    consumed in FIFO order and higher priority levels are consumed first.
 
 Arguments:
 
     DmfModule - This Module's handle.
     ClientBuffer - The buffer to add to the list.
                    NOTE: This must be a properly formed buffer that was created by this Module.
+    Priority - The given priority level. 0 is the lowest priority level. It is the level
+               DMF_BufferQueue_Enqueue uses.
 
 Return Value:
 
@@ -616,17 +1934,37 @@ Return Value:
 
 --*/
 {
-    DMF_CONTEXT_BufferQueue* moduleContext;
+    DMF_CONFIG_BufferQueue* moduleConfig;
 
     FuncEntry(DMF_TRACE);
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferQueue);
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
 
-    DMF_BufferPool_PutAtHead(moduleContext->DmfModuleBufferPoolConsumer,
-                             ClientBuffer);
+    if (moduleConfig->NumberOfPriorityLevels <= 1)
+    {
+        // There is a single level.
+        //
+        DMF_BufferQueue_Enqueue(DmfModule,
+                                ClientBuffer);
+        goto Exit;
+    }
+
+    if (Priority >= moduleConfig->NumberOfPriorityLevels)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Invalid Priority=%d", Priority);
+        DmfAssert(FALSE);
+        Priority = moduleConfig->NumberOfPriorityLevels - 1;
+    }
+
+    BufferQueue_PriorityEnqueue(DmfModule,
+                                ClientBuffer,
+                                Priority,
+                                FALSE);
+
+Exit:
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -686,6 +2024,14 @@ Return Value:
         goto Exit;
     }
 
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        TraceError(DMF_TRACE, "EnqueueWithTimer is not supported with BufferQueue_Backend_LockFree");
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
     BufferQueue_BufferContextInternalGet(DmfModule,
                                          ClientBuffer,
                                          &bufferContextInternal);
@@ -693,12 +2039,25 @@ Return Value:
 
     bufferContextInternal->ClientTimerExpirationCallback = TimerExpirationCallback;
 
+    // With priority levels, the buffer goes to level 0.
+    //
+    if (moduleConfig->NumberOfPriorityLevels > 1)
+    {
+        DMF_ModuleLock(DmfModule);
+    }
+
     DMF_BufferPool_PutInSinkWithTimer(moduleContext->DmfModuleBufferPoolConsumer,
                                       ClientBuffer,
                                       TimerExpirationMilliseconds,
                                       BufferQueue_TimerCallback,
                                       TimerExpirationCallbackContext);
 
+    if (moduleConfig->NumberOfPriorityLevels > 1)
+    {
+        moduleContext->PriorityLevelsBitmap |= 1;
+        DMF_ModuleUnlock(DmfModule);
+    }
+
     FuncExitVoid(DMF_TRACE);
 
 Exit:
@@ -735,21 +2094,70 @@ Return Value:
 
 --*/
 {
+    DMF_CONFIG_BufferQueue* moduleConfig;
     DMF_CONTEXT_BufferQueue* moduleContext;
+    BUFFERQUEUE_PRIORITY_ENUMERATION_CONTEXT enumerationContext;
+    ULONG priority;
 
     FuncEntry(DMF_TRACE);
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferQueue);
 
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        // Buffers in a lock-free queue cannot be enumerated.
+        //
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Enumerate is not supported with BufferQueue_Backend_LockFree");
+        DmfAssert(FALSE);
+        if (ClientBuffer != NULL)
+        {
+            *ClientBuffer = NULL;
+        }
+        if (ClientBufferContext != NULL)
+        {
+            *ClientBufferContext = NULL;
+        }
+        goto Exit;
+    }
+
+    if (moduleConfig->NumberOfPriorityLevels > 1)
+    {
+        // Enumerate from the highest priority level to the lowest one until the Client's callback
+        // stops the enumeration.
+        //
+        enumerationContext.EntryEnumerationCallback = EntryEnumerationCallback;
+        enumerationContext.ClientDriverCallbackContext = ClientDriverCallbackContext;
+        enumerationContext.EnumerationStopped = FALSE;
+        priority = moduleConfig->NumberOfPriorityLevels;
+        while (priority > 0)
+        {
+            priority--;
+            DMF_BufferPool_Enumerate(BufferQueue_PriorityConsumerGet(moduleContext,
+                                                                     priority),
+                                     BufferQueue_PriorityEnumerationCallback,
+                                     &enumerationContext,
+                                     ClientBuffer,
+                                     ClientBufferContext);
+            if (enumerationContext.EnumerationStopped)
+            {
+                break;
+            }
+        }
+        goto Exit;
+    }
+
     DMF_BufferPool_Enumerate(moduleContext->DmfModuleBufferPoolConsumer,
                              EntryEnumerationCallback,
                              ClientDriverCallbackContext,
                              ClientBuffer,
                              ClientBufferContext);
 
+Exit:
+
     FuncExitVoid(DMF_TRACE);
 }
 
@@ -782,6 +2190,7 @@ Return Value:
 --*/
 {
     NTSTATUS ntStatus;
+    DMF_CONFIG_BufferQueue* moduleConfig;
     DMF_CONTEXT_BufferQueue* moduleContext;
 
     FuncEntry(DMF_TRACE);
@@ -789,11 +2198,112 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferQueue);
 
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolProducer,
-                                  ClientBuffer,
-                                  ClientBufferContext);
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        if (BufferQueue_LockFreeQueueRemove(&moduleContext->FreeQueue,
+                                            ClientBuffer))
+        {
+            if (ClientBufferContext != NULL)
+            {
+                DMF_BufferPool_ContextGet(moduleContext->DmfModuleBufferPoolProducer,
+                                          *ClientBuffer,
+                                          ClientBufferContext);
+            }
+            ntStatus = STATUS_SUCCESS;
+        }
+        else
+        {
+            ntStatus = STATUS_UNSUCCESSFUL;
+        }
+    }
+    else
+    {
+        ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolProducer,
+                                      ClientBuffer,
+                                      ClientBufferContext);
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_FetchMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfBuffers,
+    _Out_writes_to_(NumberOfBuffers, *NumberOfBuffersReturned) VOID** ClientBuffers,
+    _Out_writes_opt_(NumberOfBuffers) VOID** ClientBufferContexts,
+    _Out_ ULONG* NumberOfBuffersReturned
+    )
+/*++
+
+Routine Description:
+
+    Removes up to NumberOfBuffers buffers from the head of the producer list using a single
+    lock acquisition. Then, returns the Client Buffers and their associated Client Buffer Contexts.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    NumberOfBuffers - The maximum number of buffers to remove.
+    ClientBuffers - Array that receives the Client Buffers.
+    ClientBufferContexts - Optional array that receives the Client contexts associated with the buffers.
+    NumberOfBuffersReturned - The number of buffers written to ClientBuffers.
+
+Return Value:
+
+    STATUS_SUCCESS if at least one buffer is removed from the list.
+    STATUS_UNSUCCESSFUL if the list is empty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    ULONG bufferIndex;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferQueue);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        for (bufferIndex = 0; bufferIndex < NumberOfBuffers; bufferIndex++)
+        {
+            if (! BufferQueue_LockFreeQueueRemove(&moduleContext->FreeQueue,
+                                                  &ClientBuffers[bufferIndex]))
+            {
+                break;
+            }
+            if (ClientBufferContexts != NULL)
+            {
+                DMF_BufferPool_ContextGet(moduleContext->DmfModuleBufferPoolProducer,
+                                          ClientBuffers[bufferIndex],
+                                          &ClientBufferContexts[bufferIndex]);
+            }
+        }
+
+        *NumberOfBuffersReturned = bufferIndex;
+        ntStatus = (bufferIndex > 0) ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+    }
+    else
+    {
+        ntStatus = DMF_BufferPool_GetMultiple(moduleContext->DmfModuleBufferPoolProducer,
+                                              NumberOfBuffers,
+                                              ClientBuffers,
+                                              ClientBufferContexts,
+                                              NumberOfBuffersReturned);
+    }
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
@@ -821,9 +2331,8 @@ Return Value:
 
 --*/
 {
-    DMF_CONTEXT_BufferQueue* moduleContext;
-    VOID* buffer;
-    VOID* bufferContext;
+    VOID* buffers[BufferQueue_FlushBatchSize];
+    ULONG numberOfBuffers;
     NTSTATUS ntStatus;
 
     FuncEntry(DMF_TRACE);
@@ -831,18 +2340,21 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD_CLOSING_OK(DmfModule,
                                             BufferQueue);
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-
+    // Move the buffers in batches so that each list is locked once per batch.
+    //
     ntStatus = STATUS_SUCCESS;
     while (NT_SUCCESS(ntStatus))
     {
-        ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolConsumer,
-                                      &buffer,
-                                      &bufferContext);
+        ntStatus = DMF_BufferQueue_DequeueMultiple(DmfModule,
+                                                   ARRAYSIZE(buffers),
+                                                   buffers,
+                                                   NULL,
+                                                   &numberOfBuffers);
         if (NT_SUCCESS(ntStatus))
         {
-            DMF_BufferQueue_Reuse(DmfModule,
-                                  buffer);
+            DMF_BufferQueue_ReuseMultiple(DmfModule,
+                                          buffers,
+                                          numberOfBuffers);
         }
     }
 
@@ -900,8 +2412,91 @@ Return Value:
                                                    clientBufferContext);
     }
 
-    DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolProducer,
-                       ClientBuffer);
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        BufferQueue_LockFreeReuse(moduleContext,
+                                  ClientBuffer);
+    }
+    else
+    {
+        DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolProducer,
+                           ClientBuffer);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferQueue_ReuseMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfBuffers) VOID** ClientBuffers,
+    _In_ ULONG NumberOfBuffers
+    )
+/*++
+
+Routine Description:
+
+    Adds Client Buffers to the producer list using a single lock acquisition.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffers - The buffers to add to the list.
+                    NOTE: These must be properly formed buffers that were created by this Module.
+    NumberOfBuffers - The number of buffers in ClientBuffers.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    ULONG bufferIndex;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD_CLOSING_OK(DmfModule,
+                                            BufferQueue);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // If Config EvtBufferQueueReuseCleanup callback present, call
+    // with each buffer before handing back to Producer BufferPool.
+    //
+    if (moduleConfig->EvtBufferQueueReuseCleanup)
+    {
+        for (bufferIndex = 0; bufferIndex < NumberOfBuffers; bufferIndex++)
+        {
+            VOID* clientBufferContext = NULL;
+
+            DMF_BufferPool_ContextGet(moduleContext->DmfModuleBufferPoolConsumer,
+                                      ClientBuffers[bufferIndex],
+                                      &clientBufferContext);
+
+            (moduleConfig->EvtBufferQueueReuseCleanup)(DmfModule,
+                                                       ClientBuffers[bufferIndex],
+                                                       clientBufferContext);
+        }
+    }
+
+    if (BufferQueue_Backend_LockFree == moduleConfig->Backend)
+    {
+        for (bufferIndex = 0; bufferIndex < NumberOfBuffers; bufferIndex++)
+        {
+            BufferQueue_LockFreeReuse(moduleContext,
+                                      ClientBuffers[bufferIndex]);
+        }
+    }
+    else
+    {
+        DMF_BufferPool_PutMultiple(moduleContext->DmfModuleBufferPoolProducer,
+                                   ClientBuffers,
+                                   NumberOfBuffers);
+    }
 
     FuncExitVoid(DMF_TRACE);
 }
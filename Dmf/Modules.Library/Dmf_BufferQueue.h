@@ -32,6 +32,25 @@ EVT_DMF_BufferQueue_ReuseCleanup(_In_ DMFMODULE DmfModule,
                                  _In_ VOID* ClientBuffer,
                                  _In_ VOID* ClientBufferContext);
 
+// Maximum number of priority levels of the consumer list.
+//
+#define BufferQueue_PriorityLevelsMaximum   8
+
+// Data structure that holds the producer and consumer lists.
+//
+typedef enum
+{
+    // Both lists are BufferPool Modules. Every Method is supported.
+    //
+    BufferQueue_Backend_BufferPool = 0,
+    // Both lists are bounded lock-free queues so that Fetch, Enqueue, Dequeue and Reuse
+    // do not acquire a lock. SourceSettings must not use a look aside list, size classes or
+    // adaptive preallocation. DMF_BufferQueue_Enumerate and DMF_BufferQueue_EnqueueWithTimer
+    // are not supported.
+    //
+    BufferQueue_Backend_LockFree,
+} BufferQueue_BackendType;
+
 // Client uses this structure to configure the Module specific parameters.
 //
 typedef struct
@@ -44,6 +63,20 @@ typedef struct
     // Optional callback for Client to finalize buffer before reuse.
     //
     EVT_DMF_BufferQueue_ReuseCleanup* EvtBufferQueueReuseCleanup;
+    // Data structure that holds the producer and consumer lists.
+    //
+    BufferQueue_BackendType Backend;
+    // Number of priority levels of the consumer list (at most BufferQueue_PriorityLevelsMaximum).
+    // Zero or one means there is a single level. Otherwise, Dequeue returns the oldest buffer of
+    // the highest priority level that is not empty. Level 0 is the lowest priority and it is the level
+    // used by DMF_BufferQueue_Enqueue. Not supported with BufferQueue_Backend_LockFree.
+    //
+    ULONG NumberOfPriorityLevels;
+    // Optional. Every PriorityAgingInterval dequeues, the buffer is dequeued from a lower priority
+    // level that is not empty instead, taking the lower levels in turn, so that buffers with a low
+    // priority are never starved. Zero disables aging.
+    //
+    ULONG PriorityAgingInterval;
 } DMF_CONFIG_BufferQueue;
 
 // Callback to set default (non-zero) values in DMF_CONFIG_BufferQueue
@@ -107,6 +140,17 @@ DMF_BufferQueue_Dequeue(
     _Out_opt_ VOID** ClientBufferContext
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_DequeueMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfBuffers,
+    _Out_writes_to_(NumberOfBuffers, *NumberOfBuffersReturned) VOID** ClientBuffers,
+    _Out_writes_opt_(NumberOfBuffers) VOID** ClientBufferContexts,
+    _Out_ ULONG* NumberOfBuffersReturned
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -131,6 +175,22 @@ DMF_BufferQueue_EnqueueAtHead(
     _In_ VOID* ClientBuffer
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferQueue_EnqueueMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfBuffers) VOID** ClientBuffers,
+    _In_ ULONG NumberOfBuffers
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferQueue_EnqueueWithPriority(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG Priority
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 NTSTATUS
 DMF_BufferQueue_EnqueueWithTimer(
@@ -160,6 +220,17 @@ DMF_BufferQueue_Fetch(
     _Out_opt_ VOID** ClientBufferContext
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_FetchMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfBuffers,
+    _Out_writes_to_(NumberOfBuffers, *NumberOfBuffersReturned) VOID** ClientBuffers,
+    _Out_writes_opt_(NumberOfBuffers) VOID** ClientBufferContexts,
+    _Out_ ULONG* NumberOfBuffersReturned
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 DMF_BufferQueue_Flush(
@@ -173,5 +244,13 @@ DMF_BufferQueue_Reuse(
     _In_ VOID* ClientBuffer
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferQueue_ReuseMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfBuffers) VOID** ClientBuffers,
+    _In_ ULONG NumberOfBuffers
+    );
+
 // eof: Dmf_BufferQueue.h
 //
@@ -49,11 +49,115 @@ typedef struct
     //
     ULONG NextEntryIndex;
 
+    // HashTable_Storage_Compact only. Number of bytes reserved for value data. If the key and this
+    // many bytes do not fit in RawData, they are stored in a spill block whose address is stored in RawData.
+    //
+    ULONG ValueCapacity;
+
     // A buffer to store key and value data. Key data comes first, value data immediately follows it.
     //
     UCHAR RawData[ANYSIZE_ARRAY];
 } DATA_ENTRY;
 
+// Type of slot in an open addressing slot table.
+//
+typedef struct
+{
+    // Hash of the key (lower 32 bits). Used to find the home slot of the entry
+    // and to avoid comparing keys that cannot match.
+    //
+    ULONG Hash;
+
+    // Distance of this slot from the entry's home slot plus one.
+    // Zero means the slot is empty.
+    //
+    ULONG ProbeDistance;
+
+    // Index of the data entry that holds the key and value.
+    //
+    ULONG EntryIndex;
+} HASH_TABLE_SLOT;
+
+// An open addressing slot table.
+//
+typedef struct
+{
+    // Array of slots. The number of slots is always a power of two.
+    //
+    HASH_TABLE_SLOT* Slots;
+    WDFMEMORY SlotsMemory;
+
+    // Number of elements in Slots.
+    //
+    ULONG SlotCount;
+
+    // Number of occupied elements in Slots.
+    //
+    ULONG SlotsUsed;
+} HASH_TABLE_SLOTS;
+
+// Lookup counters reported by DMF_HashTable_StatisticsGet(). Each lock stripe has its own
+// counters that are only updated while the stripe is held.
+//
+typedef struct
+{
+    // Number of lookups that found the Key.
+    //
+    ULONGLONG LookupHitCount;
+
+    // Number of lookups that did not find the Key (including Keys that were then added).
+    //
+    ULONGLONG LookupMissCount;
+
+    // Number of Keys that could not be added because the table was full.
+    //
+    ULONGLONG TableFullCount;
+
+    // Keeps the counters of different stripes in different cache lines.
+    //
+    UCHAR Padding[SYSTEM_CACHE_ALIGNMENT_SIZE - (3 * sizeof(ULONGLONG))];
+} HASH_TABLE_COUNTERS;
+
+// Additional storage for data entries in open addressing mode.
+// Each chunk is as large as all the storage before it so that the storage
+// doubles each time it grows without moving any existing entry.
+//
+typedef struct
+{
+    VOID* DataTable;
+    WDFMEMORY DataTableMemory;
+} HASH_TABLE_ENTRY_CHUNK;
+
+// Maximum number of additional data entry chunks.
+//
+#define HASH_TABLE_ENTRY_CHUNKS_MAXIMUM     24
+
+// Memory from which spill blocks are carved in HashTable_Storage_Compact.
+// The block's data immediately follows this header.
+//
+typedef struct _HASH_TABLE_SPILL_PAGE
+{
+    // Next page allocated before this one.
+    //
+    struct _HASH_TABLE_SPILL_PAGE* NextPage;
+
+    // The memory object that contains this page.
+    //
+    WDFMEMORY PageMemory;
+
+    // Number of bytes available for spill blocks.
+    //
+    ULONG DataSize;
+
+    // Number of bytes already carved into spill blocks.
+    //
+    ULONG DataUsed;
+} HASH_TABLE_SPILL_PAGE;
+
+// Number of spill block size classes. Class N holds blocks of HASH_TABLE_SPILL_BLOCK_SIZE_MINIMUM << N bytes.
+//
+#define HASH_TABLE_SPILL_SIZE_CLASSES       27
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -101,6 +205,90 @@ typedef struct _DMF_CONTEXT_HashTable
     // A function used for hash calculation.
     //
     EVT_DMF_HashTable_HashCalculate* EvtHashTableHashCalculate;
+
+    // Table organization.
+    //
+    HashTable_ModeType Mode;
+
+    // HashTable_Mode_OpenAddressing only.
+    // -----------------------------------
+    //
+
+    // Slot table where new entries are inserted.
+    //
+    HASH_TABLE_SLOTS SlotTableCurrent;
+
+    // While the table is resized, the slot table whose entries are still being moved
+    // to SlotTableCurrent. Each operation that modifies the table moves a few slots so
+    // that no caller ever pays for rehashing the whole table.
+    //
+    HASH_TABLE_SLOTS SlotTablePrevious;
+
+    // Next slot in SlotTablePrevious to move.
+    //
+    ULONG MigrationSlotIndex;
+
+    // Data entries beyond DataTableSize are stored in these chunks.
+    //
+    HASH_TABLE_ENTRY_CHUNK EntryChunks[HASH_TABLE_ENTRY_CHUNKS_MAXIMUM];
+    ULONG EntryChunkCount;
+
+    // Total number of data entries in DataTable and EntryChunks.
+    //
+    ULONG DataEntryCapacity;
+
+    // List of removed data entries available for reuse (linked by NextEntryIndex).
+    //
+    ULONG FreeEntryIndex;
+
+    // HashTable_Mode_Chained only.
+    // ----------------------------
+    //
+
+    // Number of lock stripes. Zero when the Module lock protects the whole table.
+    //
+    ULONG LockStripeCount;
+
+    // Bucket N of HashMap (and every entry chained to it) is protected by LockStripes[N % LockStripeCount].
+    // Lock order: Methods that hold several stripes at once (snapshot enumeration, DMF_HashTable_StatisticsGet
+    // and the batch Methods) acquire them in ascending index order. SpillLock is acquired after the stripes
+    // and no stripe is acquired while it is held.
+    //
+    WDFSPINLOCK* LockStripes;
+    WDFMEMORY LockStripesMemory;
+
+    // Hold all stripe locks while enumerating.
+    //
+    BOOLEAN EnumerateSnapshot;
+
+    // Lookup counters. One per lock stripe (or a single one when there are no stripes).
+    //
+    HASH_TABLE_COUNTERS* Counters;
+    WDFMEMORY CountersMemory;
+
+    // HashTable_Storage_Compact only.
+    // -------------------------------
+    //
+
+    // How Key and Value data is stored.
+    //
+    HashTable_StorageType Storage;
+
+    // Number of bytes of Key and Value data stored in each entry.
+    //
+    ULONG InlineDataLength;
+
+    // Free spill blocks of each size class (linked through their first bytes).
+    //
+    UCHAR* SpillFreeLists[HASH_TABLE_SPILL_SIZE_CLASSES];
+
+    // Pages from which spill blocks are carved. New blocks are carved from the first page.
+    //
+    HASH_TABLE_SPILL_PAGE* SpillPages;
+
+    // Protects the spill blocks when lock stripes are used.
+    //
+    WDFSPINLOCK SpillLock;
 } DMF_CONTEXT_HashTable;
 
 // This macro declares the following function:
@@ -130,6 +318,50 @@ DMF_MODULE_DECLARE_CONFIG(HashTable)
 //
 #define HASH_MAP_SIZE_MULTIPLIER  2
 
+// In open addressing mode, the slot table is resized when more than this fraction of the slots are used.
+//
+#define HASH_TABLE_LOAD_FACTOR_NUMERATOR        7
+#define HASH_TABLE_LOAD_FACTOR_DENOMINATOR      8
+
+// In open addressing mode, number of slots moved to the resized slot table by each operation
+// that modifies the table.
+//
+#define HASH_TABLE_MIGRATION_SLOTS_PER_OPERATION    16
+
+// Maximum number of lock stripes in chained mode.
+//
+#define HASH_TABLE_LOCK_STRIPES_MAXIMUM             256
+
+// Number of batch items whose hashes are calculated before the table is locked. Larger batches
+// are processed in several steps so that the lock is not held for an unbounded time.
+//
+#define HASH_TABLE_BATCH_CHUNK_SIZE                 64
+
+// Number of ULONGs in the bitmap of the lock stripes a batch accesses.
+//
+#define HASH_TABLE_BATCH_STRIPE_MASK_SIZE           (HASH_TABLE_LOCK_STRIPES_MAXIMUM / 32)
+
+// Default number of bytes of Key and Value data stored in each entry in compact storage.
+//
+#define HASH_TABLE_INLINE_DATA_LENGTH_DEFAULT       32
+
+// Size of the smallest spill block. Every block size is a multiple of it so blocks carved
+// one after another stay aligned.
+//
+#define HASH_TABLE_SPILL_BLOCK_SIZE_MINIMUM         16
+
+// Size of each page from which spill blocks are carved. (Larger blocks get their own page.)
+//
+#define HASH_TABLE_SPILL_PAGE_SIZE                  (16 * 1024)
+
+// Constants used by the word-at-a-time hash (xxHash64).
+//
+#define HASH_TABLE_WORD_PRIME1      0x9E3779B185EBCA87ULL
+#define HASH_TABLE_WORD_PRIME2      0xC2B2AE3D27D4EB4FULL
+#define HASH_TABLE_WORD_PRIME3      0x165667B19E3779F9ULL
+#define HASH_TABLE_WORD_PRIME4      0x85EBCA77C2B2AE63ULL
+#define HASH_TABLE_WORD_PRIME5      0x27D4EB2F165667C5ULL
+
 static
 inline
 DATA_ENTRY*
@@ -154,14 +386,95 @@ Return Value:
 
 --*/
 {
-    return (DATA_ENTRY*)((UCHAR*)ModuleContext->DataTable + (size_t)ModuleContext->DataEntrySize * (size_t)EntryIndex);
+    ULONG chunkIndex;
+    ULONG chunkFirstEntryIndex;
+
+    if (EntryIndex < ModuleContext->DataTableSize)
+    {
+        return (DATA_ENTRY*)((UCHAR*)ModuleContext->DataTable + (size_t)ModuleContext->DataEntrySize * (size_t)EntryIndex);
+    }
+
+    // Open addressing mode: Chunk N starts at DataTableSize * 2^N and holds as many entries.
+    //
+    DmfAssert(ModuleContext->Mode == HashTable_Mode_OpenAddressing);
+    chunkIndex = 0;
+    chunkFirstEntryIndex = ModuleContext->DataTableSize;
+    while (EntryIndex - chunkFirstEntryIndex >= chunkFirstEntryIndex)
+    {
+        chunkFirstEntryIndex <<= 1;
+        chunkIndex++;
+    }
+    DmfAssert(chunkIndex < ModuleContext->EntryChunkCount);
+
+    return (DATA_ENTRY*)((UCHAR*)ModuleContext->EntryChunks[chunkIndex].DataTable + (size_t)ModuleContext->DataEntrySize * (size_t)(EntryIndex - chunkFirstEntryIndex));
+}
+
+static
+inline
+HASH_TABLE_COUNTERS*
+HashTable_CountersGet(
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG_PTR Hash
+    )
+/*++
+
+Routine Description:
+
+    Returns the lookup counters protected by the same lock as the entries with the given hash.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Hash - Hash of the Key.
+
+Return Value:
+
+    The counters to update.
+
+--*/
+{
+    if (0 == ModuleContext->LockStripeCount)
+    {
+        return &ModuleContext->Counters[0];
+    }
+
+    return &ModuleContext->Counters[(Hash % ModuleContext->HashMapSize) % ModuleContext->LockStripeCount];
+}
+
+static
+inline
+BOOLEAN
+HashTable_DataEntryIsSpilled(
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ DATA_ENTRY* DataEntry
+    )
+/*++
+
+Routine Description:
+
+    Determines if the Key and Value data of specified DataEntry is stored in a spill block.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    DataEntry - Pointer to a DataTable entry.
+
+Return Value:
+
+    TRUE if RawData holds the address of a spill block.
+
+--*/
+{
+    return ((ModuleContext->Storage == HashTable_Storage_Compact) &&
+            (DataEntry->KeyLength + DataEntry->ValueCapacity > ModuleContext->InlineDataLength));
 }
 
 static
 inline
 UCHAR*
 HashTable_KeyBufferGet(
-    DATA_ENTRY* DataEntry
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ DATA_ENTRY* DataEntry
     )
 /*++
 
@@ -171,6 +484,7 @@ Routine Description:
 
 Arguments:
 
+    ModuleContext - This Module's context.
     DataEntry - Pointer to a DataTable entry.
 
 Return Value:
@@ -179,6 +493,12 @@ Return Value:
 
 --*/
 {
+    if (HashTable_DataEntryIsSpilled(ModuleContext,
+                                     DataEntry))
+    {
+        return *((UCHAR**)DataEntry->RawData);
+    }
+
     return (&DataEntry->RawData[0]);
 }
 
@@ -186,6 +506,7 @@ static
 inline
 UCHAR*
 HashTable_ValueBufferGet(
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
     _In_ DATA_ENTRY* DataEntry
     )
 /*++
@@ -196,6 +517,7 @@ Routine Description:
 
 Arguments:
 
+    ModuleContext - This Module's context.
     DataEntry - Pointer to a DataTable entry.
 
 Return Value:
@@ -204,7 +526,8 @@ Return Value:
 
 --*/
 {
-    return (&DataEntry->RawData[DataEntry->KeyLength]);
+    return (HashTable_KeyBufferGet(ModuleContext,
+                                   DataEntry) + DataEntry->KeyLength);
 }
 
 _Function_class_(EVT_DMF_HashTable_HashCalculate)
@@ -257,152 +580,290 @@ Return Value:
     return (result);
 }
 
-#pragma code_seg("PAGE")
-_IRQL_requires_max_(PASSIVE_LEVEL)
 static
-VOID
-HashTable_ContextCleanup(
-    _Inout_ DMF_CONTEXT_HashTable* ModuleContext
+inline
+ULONGLONG
+HashTable_WordRotateLeft(
+    _In_ ULONGLONG Value,
+    _In_ ULONG Bits
     )
 /*++
 
 Routine Description:
 
-    Cleans up the Module Context.
+    Rotates a 64-bit value left. The compiler generates a single rotate instruction for this pattern.
 
 Arguments:
 
-    ModuleContext - This Module's Context.
+    Value - The value to rotate.
+    Bits - Number of bits to rotate by (1-63).
 
 Return Value:
 
-    None
+    The rotated value.
 
 --*/
 {
-    PAGED_CODE();
+    return (Value << Bits) | (Value >> (64 - Bits));
+}
 
-    FuncEntry(DMF_TRACE);
+static
+inline
+ULONGLONG
+HashTable_WordRead(
+    _In_reads_(sizeof(ULONGLONG)) UCHAR* Buffer
+    )
+/*++
 
-    DmfAssert(NULL != ModuleContext);
+Routine Description:
 
-    if (NULL != ModuleContext->HashMap)
-    {
-        WdfObjectDelete(ModuleContext->HashMapMemory);
-        ModuleContext->HashMap = NULL;
-    }
+    Reads a 64-bit word from a buffer that may not be aligned.
 
-    if (NULL != ModuleContext->DataTable)
-    {
-        WdfObjectDelete(ModuleContext->DataTableMemory);
-        ModuleContext->DataTable = NULL;
-    }
+Arguments:
 
-    FuncExitVoid(DMF_TRACE);
+    Buffer - Address of the word to read.
+
+Return Value:
+
+    The word read from Buffer.
+
+--*/
+{
+    ULONGLONG word;
+
+    RtlCopyMemory(&word,
+                  Buffer,
+                  sizeof(word));
+
+    return word;
 }
-#pragma code_seg()
 
-#pragma code_seg("PAGE")
-_IRQL_requires_max_(PASSIVE_LEVEL)
-_Must_inspect_result_
 static
-NTSTATUS
-HashTable_ContextInitialize(
-    _In_ DMFMODULE DmfModule
+inline
+ULONGLONG
+HashTable_WordRound(
+    _In_ ULONGLONG Accumulator,
+    _In_ ULONGLONG Word
     )
 /*++
 
 Routine Description:
 
-    Initializes the Module Context.
+    Mixes a 64-bit word into one lane of the word-at-a-time hash.
 
 Arguments:
 
-    DmfModule - This Module's handle.
+    Accumulator - Current value of the lane.
+    Word - The word to mix in.
 
 Return Value:
 
-    NT_STATUS code indicating success or failure.
+    New value of the lane.
 
 --*/
 {
-    NTSTATUS ntStatus;
-    WDF_OBJECT_ATTRIBUTES objectAttributes;
-    size_t sizeToAllocate;
-    DMF_CONTEXT_HashTable* moduleContext;
-    DMF_CONFIG_HashTable* moduleConfig;
+    Accumulator += Word * HASH_TABLE_WORD_PRIME2;
+    Accumulator = HashTable_WordRotateLeft(Accumulator,
+                                           31);
+    Accumulator *= HASH_TABLE_WORD_PRIME1;
 
-    PAGED_CODE();
+    return Accumulator;
+}
 
-    FuncEntry(DMF_TRACE);
+static
+inline
+ULONGLONG
+HashTable_WordLaneMerge(
+    _In_ ULONGLONG Hash,
+    _In_ ULONGLONG Lane
+    )
+/*++
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-    moduleConfig = DMF_CONFIG_GET(DmfModule);
+Routine Description:
 
-    DmfAssert(NULL == moduleContext->HashMap);
-    DmfAssert(NULL == moduleContext->DataTable);
+    Merges one lane of the word-at-a-time hash into the final hash.
 
-    moduleContext->MaximumKeyLength = moduleConfig->MaximumKeyLength;
-    moduleContext->MaximumValueLength = moduleConfig->MaximumValueLength;
+Arguments:
 
-    // Calculate the size of DATA_ENTRY structure and make sure it's properly aligned.
-    //
-    moduleContext->DataEntrySize = FIELD_OFFSET(DATA_ENTRY,
-                                                RawData[moduleConfig->MaximumKeyLength + moduleConfig->MaximumValueLength]);
-    moduleContext->DataEntrySize = (moduleContext->DataEntrySize + MAX_NATURAL_ALIGNMENT - 1) & ~(MAX_NATURAL_ALIGNMENT - 1);
+    Hash - Current value of the final hash.
+    Lane - Value of the lane.
 
-    moduleContext->HashMapSize = moduleConfig->MaximumTableSize * HASH_MAP_SIZE_MULTIPLIER;
-    moduleContext->DataTableSize = moduleConfig->MaximumTableSize;
+Return Value:
 
-    moduleContext->DataEntriesAllocated = 0;
+    New value of the final hash.
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE,
-                "Create hash table: MaximumKeyLength=%u, MaximumValueLength=%u, DataEntrySize=%u, MaximumTableSize=%u",
-                moduleContext->MaximumKeyLength,
-                moduleContext->MaximumValueLength,
-                moduleContext->DataEntrySize,
-                moduleConfig->MaximumTableSize);
+--*/
+{
+    Hash ^= HashTable_WordRound(0,
+                                Lane);
+    Hash = Hash * HASH_TABLE_WORD_PRIME1 + HASH_TABLE_WORD_PRIME4;
 
-    // Use the default hash function, if a custom function is not specified.
-    //
-    if (moduleConfig->EvtHashTableHashCalculate != NULL)
+    return Hash;
+}
+
+_Function_class_(EVT_DMF_HashTable_HashCalculate)
+static
+ULONG_PTR
+HashTable_HashCalculateWordAtATime(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength
+    )
+/*++
+
+Routine Description:
+
+    Calculates the xxHash64 hash (seed zero) for specified buffer. Keys of 32 bytes or more are
+    processed 32 bytes per step using four independent lanes so that the multiplications overlap.
+    The remainder is processed 8 bytes per step. Only the last few bytes are processed one at a time.
+
+Arguments:
+
+    DmfModule - DMF Module.
+    Key - Address of the buffer containing Key data to calculate the hash.
+    KeyLength - Length of Key data in bytes.
+
+Return Value:
+
+    Hash of the data specified in Key buffer.
+
+--*/
+{
+    ULONGLONG hash;
+    UCHAR* current;
+    UCHAR* end;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    current = Key;
+    end = Key + KeyLength;
+
+    if (KeyLength >= 32)
     {
-        // Custom function.
-        //
-        moduleContext->EvtHashTableHashCalculate = moduleConfig->EvtHashTableHashCalculate;
+        UCHAR* lastBlock;
+        ULONGLONG lane1;
+        ULONGLONG lane2;
+        ULONGLONG lane3;
+        ULONGLONG lane4;
+
+        lastBlock = end - 32;
+        lane1 = HASH_TABLE_WORD_PRIME1 + HASH_TABLE_WORD_PRIME2;
+        lane2 = HASH_TABLE_WORD_PRIME2;
+        lane3 = 0;
+        lane4 = 0 - HASH_TABLE_WORD_PRIME1;
+
+        do
+        {
+            lane1 = HashTable_WordRound(lane1,
+                                        HashTable_WordRead(current));
+            lane2 = HashTable_WordRound(lane2,
+                                        HashTable_WordRead(current + 8));
+            lane3 = HashTable_WordRound(lane3,
+                                        HashTable_WordRead(current + 16));
+            lane4 = HashTable_WordRound(lane4,
+                                        HashTable_WordRead(current + 24));
+            current += 32;
+        } while (current <= lastBlock);
+
+        hash = HashTable_WordRotateLeft(lane1, 1) +
+               HashTable_WordRotateLeft(lane2, 7) +
+               HashTable_WordRotateLeft(lane3, 12) +
+               HashTable_WordRotateLeft(lane4, 18);
+        hash = HashTable_WordLaneMerge(hash,
+                                       lane1);
+        hash = HashTable_WordLaneMerge(hash,
+                                       lane2);
+        hash = HashTable_WordLaneMerge(hash,
+                                       lane3);
+        hash = HashTable_WordLaneMerge(hash,
+                                       lane4);
     }
     else
     {
-        // Default function.
-        //
-        moduleContext->EvtHashTableHashCalculate = HashTable_HashCalculate;
+        hash = HASH_TABLE_WORD_PRIME5;
     }
 
-    sizeToAllocate = moduleContext->HashMapSize * sizeof(ULONG);
+    hash += KeyLength;
 
-    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
-    objectAttributes.ParentObject = DmfModule;
-    // 'Error annotation: __formal(3,BufferSize) cannot be zero.'.
-    //
-    #pragma warning(suppress:28160)
-    ntStatus = WdfMemoryCreate(&objectAttributes,
-                               NonPagedPoolNx,
-                               MemoryTag,
-                               sizeToAllocate,
-                               &moduleContext->HashMapMemory,
-                               (VOID**)&moduleContext->HashMap);
-    if (! NT_SUCCESS(ntStatus))
+    while (current + 8 <= end)
     {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
+        hash ^= HashTable_WordRound(0,
+                                    HashTable_WordRead(current));
+        hash = HashTable_WordRotateLeft(hash,
+                                        27) * HASH_TABLE_WORD_PRIME1 + HASH_TABLE_WORD_PRIME4;
+        current += 8;
     }
 
-    RtlFillMemory(moduleContext->HashMap,
-                  sizeToAllocate,
-                  INVALID_INDEX);
+    if (current + 4 <= end)
+    {
+        ULONG halfWord;
+
+        RtlCopyMemory(&halfWord,
+                      current,
+                      sizeof(halfWord));
+        hash ^= (ULONGLONG)halfWord * HASH_TABLE_WORD_PRIME1;
+        hash = HashTable_WordRotateLeft(hash,
+                                        23) * HASH_TABLE_WORD_PRIME2 + HASH_TABLE_WORD_PRIME3;
+        current += 4;
+    }
 
-    sizeToAllocate = (size_t)moduleContext->DataTableSize * (size_t)moduleContext->DataEntrySize;
-    DmfAssert(sizeToAllocate != 0);
+    while (current < end)
+    {
+        hash ^= (ULONGLONG)(*current) * HASH_TABLE_WORD_PRIME5;
+        hash = HashTable_WordRotateLeft(hash,
+                                        11) * HASH_TABLE_WORD_PRIME1;
+        current++;
+    }
+
+    // Final avalanche so that every bit of the key affects the low bits used to index the table.
+    //
+    hash ^= hash >> 33;
+    hash *= HASH_TABLE_WORD_PRIME2;
+    hash ^= hash >> 29;
+    hash *= HASH_TABLE_WORD_PRIME3;
+    hash ^= hash >> 32;
+
+    return (ULONG_PTR)hash;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_SlotTableAllocate(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG SlotCount,
+    _Out_ HASH_TABLE_SLOTS* SlotTable
+    )
+/*++
+
+Routine Description:
+
+    Allocates an empty open addressing slot table.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    SlotCount - Number of slots. Must be a power of two.
+    SlotTable - The slot table to initialize.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    size_t sizeToAllocate;
+
+    DmfAssert(SlotCount != 0);
+    DmfAssert(0 == (SlotCount & (SlotCount - 1)));
+
+    RtlZeroMemory(SlotTable,
+                  sizeof(HASH_TABLE_SLOTS));
+
+    sizeToAllocate = (size_t)SlotCount * sizeof(HASH_TABLE_SLOT);
 
     WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
     objectAttributes.ParentObject = DmfModule;
@@ -413,311 +874,2402 @@ Return Value:
                                NonPagedPoolNx,
                                MemoryTag,
                                sizeToAllocate,
-                               &moduleContext->DataTableMemory,
-                               (VOID**)&moduleContext->DataTable);
+                               &SlotTable->SlotsMemory,
+                               (VOID**)&SlotTable->Slots);
     if (! NT_SUCCESS(ntStatus))
     {
         TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        SlotTable->Slots = NULL;
         goto Exit;
     }
 
-    RtlZeroMemory(moduleContext->DataTable,
+    // ProbeDistance of zero means the slot is empty.
+    //
+    RtlZeroMemory(SlotTable->Slots,
                   sizeToAllocate);
 
-    ntStatus = STATUS_SUCCESS;
+    SlotTable->SlotCount = SlotCount;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_SlotTableFree(
+    _Inout_ HASH_TABLE_SLOTS* SlotTable
+    )
+/*++
+
+Routine Description:
+
+    Frees an open addressing slot table (if it is allocated).
+
+Arguments:
+
+    SlotTable - The slot table to free.
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (SlotTable->Slots != NULL)
+    {
+        WdfObjectDelete(SlotTable->SlotsMemory);
+    }
+
+    RtlZeroMemory(SlotTable,
+                  sizeof(HASH_TABLE_SLOTS));
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+HashTable_ContextCleanup(
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Cleans up the Module Context.
+
+Arguments:
+
+    ModuleContext - This Module's Context.
+
+Return Value:
+
+    None
+
+--*/
+{
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DmfAssert(NULL != ModuleContext);
+
+    if (NULL != ModuleContext->HashMap)
+    {
+        WdfObjectDelete(ModuleContext->HashMapMemory);
+        ModuleContext->HashMap = NULL;
+    }
+
+    if (NULL != ModuleContext->DataTable)
+    {
+        WdfObjectDelete(ModuleContext->DataTableMemory);
+        ModuleContext->DataTable = NULL;
+    }
+
+    HashTable_SlotTableFree(&ModuleContext->SlotTableCurrent);
+    HashTable_SlotTableFree(&ModuleContext->SlotTablePrevious);
+
+    while (ModuleContext->EntryChunkCount > 0)
+    {
+        ModuleContext->EntryChunkCount--;
+        WdfObjectDelete(ModuleContext->EntryChunks[ModuleContext->EntryChunkCount].DataTableMemory);
+        ModuleContext->EntryChunks[ModuleContext->EntryChunkCount].DataTable = NULL;
+    }
+
+    if (NULL != ModuleContext->LockStripes)
+    {
+        ULONG stripeIndex;
+
+        for (stripeIndex = 0; stripeIndex < ModuleContext->LockStripeCount; stripeIndex++)
+        {
+            if (ModuleContext->LockStripes[stripeIndex] != NULL)
+            {
+                WdfObjectDelete(ModuleContext->LockStripes[stripeIndex]);
+            }
+        }
+        WdfObjectDelete(ModuleContext->LockStripesMemory);
+        ModuleContext->LockStripes = NULL;
+    }
+    ModuleContext->LockStripeCount = 0;
+
+    if (NULL != ModuleContext->Counters)
+    {
+        WdfObjectDelete(ModuleContext->CountersMemory);
+        ModuleContext->Counters = NULL;
+    }
+
+    while (ModuleContext->SpillPages != NULL)
+    {
+        HASH_TABLE_SPILL_PAGE* spillPage;
+
+        spillPage = ModuleContext->SpillPages;
+        ModuleContext->SpillPages = spillPage->NextPage;
+        WdfObjectDelete(spillPage->PageMemory);
+    }
+    RtlZeroMemory(ModuleContext->SpillFreeLists,
+                  sizeof(ModuleContext->SpillFreeLists));
+
+    if (ModuleContext->SpillLock != NULL)
+    {
+        WdfObjectDelete(ModuleContext->SpillLock);
+        ModuleContext->SpillLock = NULL;
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_ContextInitialize(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initializes the Module Context.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    size_t sizeToAllocate;
+    DMF_CONTEXT_HashTable* moduleContext;
+    DMF_CONFIG_HashTable* moduleConfig;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    DmfAssert(NULL == moduleContext->HashMap);
+    DmfAssert(NULL == moduleContext->DataTable);
+
+    DmfAssert(moduleConfig->Mode < HashTable_Mode_Maximum);
+
+    if ((moduleConfig->LockStripeCount != 0) &&
+        (moduleConfig->Mode != HashTable_Mode_Chained))
+    {
+        // Open addressing tables move entries between slots as they are written and removed
+        // so they cannot be partitioned.
+        //
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "LockStripeCount is only supported in HashTable_Mode_Chained");
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    moduleContext->MaximumKeyLength = moduleConfig->MaximumKeyLength;
+    moduleContext->MaximumValueLength = moduleConfig->MaximumValueLength;
+
+    DmfAssert(moduleConfig->Storage < HashTable_Storage_Maximum);
+    moduleContext->Storage = moduleConfig->Storage;
+    if (moduleContext->Storage == HashTable_Storage_Compact)
+    {
+        moduleContext->InlineDataLength = moduleConfig->InlineDataLength;
+        if (0 == moduleContext->InlineDataLength)
+        {
+            moduleContext->InlineDataLength = HASH_TABLE_INLINE_DATA_LENGTH_DEFAULT;
+        }
+        // RawData holds the address of the spill block when the data does not fit.
+        //
+        moduleContext->InlineDataLength = max(moduleContext->InlineDataLength,
+                                              (ULONG)sizeof(UCHAR*));
+    }
+    else
+    {
+        moduleContext->InlineDataLength = moduleConfig->MaximumKeyLength + moduleConfig->MaximumValueLength;
+    }
+
+    // Calculate the size of DATA_ENTRY structure and make sure it's properly aligned.
+    //
+    moduleContext->DataEntrySize = FIELD_OFFSET(DATA_ENTRY,
+                                                RawData[moduleContext->InlineDataLength]);
+    moduleContext->DataEntrySize = (moduleContext->DataEntrySize + MAX_NATURAL_ALIGNMENT - 1) & ~(MAX_NATURAL_ALIGNMENT - 1);
+
+    moduleContext->HashMapSize = moduleConfig->MaximumTableSize * HASH_MAP_SIZE_MULTIPLIER;
+    moduleContext->DataTableSize = moduleConfig->MaximumTableSize;
+
+    moduleContext->DataEntriesAllocated = 0;
+    moduleContext->DataEntryCapacity = moduleContext->DataTableSize;
+    moduleContext->FreeEntryIndex = INVALID_INDEX;
+    moduleContext->Mode = moduleConfig->Mode;
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE,
+                "Create hash table: MaximumKeyLength=%u, MaximumValueLength=%u, DataEntrySize=%u, MaximumTableSize=%u",
+                moduleContext->MaximumKeyLength,
+                moduleContext->MaximumValueLength,
+                moduleContext->DataEntrySize,
+                moduleConfig->MaximumTableSize);
+
+    // Use the default hash function, if a custom function is not specified.
+    //
+    if (moduleConfig->EvtHashTableHashCalculate != NULL)
+    {
+        // Custom function.
+        //
+        moduleContext->EvtHashTableHashCalculate = moduleConfig->EvtHashTableHashCalculate;
+    }
+    else if (moduleConfig->HashAlgorithm == HashTable_HashAlgorithm_WordAtATime)
+    {
+        // Built-in function that processes several bytes per step.
+        //
+        moduleContext->EvtHashTableHashCalculate = HashTable_HashCalculateWordAtATime;
+    }
+    else
+    {
+        // Default function.
+        //
+        DmfAssert(moduleConfig->HashAlgorithm == HashTable_HashAlgorithm_Fnv1a);
+        moduleContext->EvtHashTableHashCalculate = HashTable_HashCalculate;
+    }
+
+    if (moduleContext->Mode == HashTable_Mode_OpenAddressing)
+    {
+        ULONG slotCount;
+
+        // Slot tables are indexed by masking the hash so their size is a power of two.
+        //
+        slotCount = 1;
+        while (slotCount < moduleContext->HashMapSize)
+        {
+            slotCount <<= 1;
+        }
+
+        ntStatus = HashTable_SlotTableAllocate(DmfModule,
+                                               slotCount,
+                                               &moduleContext->SlotTableCurrent);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+    else
+    {
+        sizeToAllocate = moduleContext->HashMapSize * sizeof(ULONG);
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        // 'Error annotation: __formal(3,BufferSize) cannot be zero.'.
+        //
+        #pragma warning(suppress:28160)
+        ntStatus = WdfMemoryCreate(&objectAttributes,
+                                   NonPagedPoolNx,
+                                   MemoryTag,
+                                   sizeToAllocate,
+                                   &moduleContext->HashMapMemory,
+                                   (VOID**)&moduleContext->HashMap);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+
+        RtlFillMemory(moduleContext->HashMap,
+                      sizeToAllocate,
+                      INVALID_INDEX);
+
+        if (moduleConfig->LockStripeCount != 0)
+        {
+            ULONG stripeCount;
+            ULONG stripeIndex;
+
+            // More stripes than buckets would never be used.
+            //
+            stripeCount = min(moduleConfig->LockStripeCount,
+                              HASH_TABLE_LOCK_STRIPES_MAXIMUM);
+            stripeCount = min(stripeCount,
+                              moduleContext->HashMapSize);
+
+            sizeToAllocate = stripeCount * sizeof(WDFSPINLOCK);
+
+            WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+            objectAttributes.ParentObject = DmfModule;
+            ntStatus = WdfMemoryCreate(&objectAttributes,
+                                       NonPagedPoolNx,
+                                       MemoryTag,
+                                       sizeToAllocate,
+                                       &moduleContext->LockStripesMemory,
+                                       (VOID**)&moduleContext->LockStripes);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+                goto Exit;
+            }
+
+            RtlZeroMemory(moduleContext->LockStripes,
+                          sizeToAllocate);
+            moduleContext->LockStripeCount = stripeCount;
+
+            for (stripeIndex = 0; stripeIndex < stripeCount; stripeIndex++)
+            {
+                WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+                objectAttributes.ParentObject = DmfModule;
+                ntStatus = WdfSpinLockCreate(&objectAttributes,
+                                             &moduleContext->LockStripes[stripeIndex]);
+                if (! NT_SUCCESS(ntStatus))
+                {
+                    TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfSpinLockCreate fails: ntStatus=%!STATUS!", ntStatus);
+                    goto Exit;
+                }
+            }
+
+            moduleContext->EnumerateSnapshot = moduleConfig->EnumerateSnapshot;
+
+            if (moduleContext->Storage == HashTable_Storage_Compact)
+            {
+                // Methods holding different stripes allocate spill blocks at the same time.
+                //
+                WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+                objectAttributes.ParentObject = DmfModule;
+                ntStatus = WdfSpinLockCreate(&objectAttributes,
+                                             &moduleContext->SpillLock);
+                if (! NT_SUCCESS(ntStatus))
+                {
+                    TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfSpinLockCreate fails: ntStatus=%!STATUS!", ntStatus);
+                    goto Exit;
+                }
+            }
+        }
+    }
+
+    sizeToAllocate = max(moduleContext->LockStripeCount, 1) * sizeof(HASH_TABLE_COUNTERS);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeToAllocate,
+                               &moduleContext->CountersMemory,
+                               (VOID**)&moduleContext->Counters);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    RtlZeroMemory(moduleContext->Counters,
+                  sizeToAllocate);
+
+    sizeToAllocate = (size_t)moduleContext->DataTableSize * (size_t)moduleContext->DataEntrySize;
+    DmfAssert(sizeToAllocate != 0);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    // 'Error annotation: __formal(3,BufferSize) cannot be zero.'.
+    //
+    #pragma warning(suppress:28160)
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeToAllocate,
+                               &moduleContext->DataTableMemory,
+                               (VOID**)&moduleContext->DataTable);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    RtlZeroMemory(moduleContext->DataTable,
+                  sizeToAllocate);
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    if (! NT_SUCCESS(ntStatus))
+    {
+        HashTable_ContextCleanup(moduleContext);
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_EntryChunkAllocate(
+    _In_ DMFMODULE DmfModule,
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Doubles the storage for data entries in open addressing mode by allocating a new chunk
+    as large as all the existing storage. Existing entries are not moved.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    STATUS_SUCCESS if the storage was doubled.
+    STATUS_BUFFER_TOO_SMALL if the table is full and cannot grow any more.
+    Otherwise, the status of the failed allocation.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    HASH_TABLE_ENTRY_CHUNK* entryChunk;
+    size_t sizeToAllocate;
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    DmfAssert(ModuleContext->Mode == HashTable_Mode_OpenAddressing);
+
+    // INVALID_INDEX must never be a valid entry index.
+    //
+    if ((ModuleContext->EntryChunkCount >= HASH_TABLE_ENTRY_CHUNKS_MAXIMUM) ||
+        (ModuleContext->DataEntryCapacity > (INVALID_INDEX / 2)))
+    {
+        ntStatus = STATUS_BUFFER_TOO_SMALL;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Table cannot grow: DataEntryCapacity=%u", ModuleContext->DataEntryCapacity);
+        goto Exit;
+    }
+
+    sizeToAllocate = (size_t)ModuleContext->DataEntryCapacity * (size_t)ModuleContext->DataEntrySize;
+    entryChunk = &ModuleContext->EntryChunks[ModuleContext->EntryChunkCount];
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    // 'Error annotation: __formal(3,BufferSize) cannot be zero.'.
+    //
+    #pragma warning(suppress:28160)
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeToAllocate,
+                               &entryChunk->DataTableMemory,
+                               (VOID**)&entryChunk->DataTable);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        entryChunk->DataTable = NULL;
+        goto Exit;
+    }
+
+    RtlZeroMemory(entryChunk->DataTable,
+                  sizeToAllocate);
+
+    ModuleContext->EntryChunkCount++;
+    ModuleContext->DataEntryCapacity *= 2;
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "DataEntryCapacity=%u", ModuleContext->DataEntryCapacity);
+
+Exit:
+
+    return ntStatus;
+}
+
+static
+ULONG
+HashTable_SpillSizeClassGet(
+    _In_ ULONG Size
+    )
+/*++
+
+Routine Description:
+
+    Returns the smallest spill block size class that holds the given number of bytes.
+
+Arguments:
+
+    Size - Number of bytes the block must hold.
+
+Return Value:
+
+    Index of the size class.
+
+--*/
+{
+    ULONG sizeClass;
+
+    sizeClass = 0;
+    while ((sizeClass < HASH_TABLE_SPILL_SIZE_CLASSES - 1) &&
+           (((ULONG)HASH_TABLE_SPILL_BLOCK_SIZE_MINIMUM << sizeClass) < Size))
+    {
+        sizeClass++;
+    }
+
+    return sizeClass;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_SpillBlockPush(
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ UCHAR* Block,
+    _In_ ULONG SizeClass
+    )
+/*++
+
+Routine Description:
+
+    Adds a spill block to the free list of its size class. The caller synchronizes access to the free lists.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Block - The spill block.
+    SizeClass - Size class of the spill block.
+
+Return Value:
+
+    None
+
+--*/
+{
+    *((UCHAR**)Block) = ModuleContext->SpillFreeLists[SizeClass];
+    ModuleContext->SpillFreeLists[SizeClass] = Block;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_SpillBlockAllocate(
+    _In_ DMFMODULE DmfModule,
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG Size,
+    _Out_ UCHAR** Block
+    )
+/*++
+
+Routine Description:
+
+    Allocates a spill block that can hold the given number of bytes. Blocks are taken from the free list
+    of their size class or carved from the current spill page. A new page is allocated only when
+    the current page is exhausted.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    Size - Number of bytes the block must hold.
+    Block - Address of the allocated block is written here.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    ULONG sizeClass;
+    ULONG blockSize;
+    ULONG pageHeaderSize;
+    HASH_TABLE_SPILL_PAGE* spillPage;
+
+    *Block = NULL;
+
+    sizeClass = HashTable_SpillSizeClassGet(Size);
+    blockSize = (ULONG)HASH_TABLE_SPILL_BLOCK_SIZE_MINIMUM << sizeClass;
+    pageHeaderSize = (sizeof(HASH_TABLE_SPILL_PAGE) + MAX_NATURAL_ALIGNMENT - 1) & ~(MAX_NATURAL_ALIGNMENT - 1);
+
+    if (ModuleContext->SpillLock != NULL)
+    {
+        WdfSpinLockAcquire(ModuleContext->SpillLock);
+    }
+
+    if (ModuleContext->SpillFreeLists[sizeClass] != NULL)
+    {
+        *Block = ModuleContext->SpillFreeLists[sizeClass];
+        ModuleContext->SpillFreeLists[sizeClass] = *((UCHAR**)*Block);
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    spillPage = ModuleContext->SpillPages;
+    if ((NULL == spillPage) ||
+        (spillPage->DataSize - spillPage->DataUsed < blockSize))
+    {
+        WDF_OBJECT_ATTRIBUTES objectAttributes;
+        WDFMEMORY pageMemory;
+        ULONG dataSize;
+
+        if (spillPage != NULL)
+        {
+            ULONG remainingSize;
+            ULONG remainingClass;
+
+            // Do not waste the end of the current page. Split it into the largest blocks that fit.
+            //
+            remainingSize = spillPage->DataSize - spillPage->DataUsed;
+            while (remainingSize >= HASH_TABLE_SPILL_BLOCK_SIZE_MINIMUM)
+            {
+                remainingClass = HashTable_SpillSizeClassGet(remainingSize);
+                if (((ULONG)HASH_TABLE_SPILL_BLOCK_SIZE_MINIMUM << remainingClass) > remainingSize)
+                {
+                    remainingClass--;
+                }
+                HashTable_SpillBlockPush(ModuleContext,
+                                         (UCHAR*)spillPage + pageHeaderSize + spillPage->DataUsed,
+                                         remainingClass);
+                spillPage->DataUsed += (ULONG)HASH_TABLE_SPILL_BLOCK_SIZE_MINIMUM << remainingClass;
+                remainingSize = spillPage->DataSize - spillPage->DataUsed;
+            }
+        }
+
+        dataSize = max(blockSize,
+                       HASH_TABLE_SPILL_PAGE_SIZE);
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        ntStatus = WdfMemoryCreate(&objectAttributes,
+                                   NonPagedPoolNx,
+                                   MemoryTag,
+                                   (size_t)pageHeaderSize + dataSize,
+                                   &pageMemory,
+                                   (VOID**)&spillPage);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+
+        spillPage->NextPage = ModuleContext->SpillPages;
+        spillPage->PageMemory = pageMemory;
+        spillPage->DataSize = dataSize;
+        spillPage->DataUsed = 0;
+        ModuleContext->SpillPages = spillPage;
+    }
+
+    *Block = (UCHAR*)spillPage + pageHeaderSize + spillPage->DataUsed;
+    spillPage->DataUsed += blockSize;
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    if (ModuleContext->SpillLock != NULL)
+    {
+        WdfSpinLockRelease(ModuleContext->SpillLock);
+    }
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_SpillBlockFree(
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ UCHAR* Block,
+    _In_ ULONG Size
+    )
+/*++
+
+Routine Description:
+
+    Returns a spill block to the free list of its size class.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Block - The spill block.
+    Size - Number of bytes that was requested when the block was allocated.
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (ModuleContext->SpillLock != NULL)
+    {
+        WdfSpinLockAcquire(ModuleContext->SpillLock);
+    }
+
+    HashTable_SpillBlockPush(ModuleContext,
+                             Block,
+                             HashTable_SpillSizeClassGet(Size));
+
+    if (ModuleContext->SpillLock != NULL)
+    {
+        WdfSpinLockRelease(ModuleContext->SpillLock);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_DataEntryCapacityEnsure(
+    _In_ DMFMODULE DmfModule,
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext,
+    _Inout_ DATA_ENTRY* DataEntry,
+    _In_ ULONG ValueCapacity
+    )
+/*++
+
+Routine Description:
+
+    Makes sure a data entry can hold a value of the given length. In compact storage, moves the
+    Key and Value data to a larger spill block if needed. Entries never shrink.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    DataEntry - The data entry.
+    ValueCapacity - Number of bytes of value data the entry must be able to hold.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    ULONG oldSize;
+    ULONG newSize;
+    UCHAR* oldBuffer;
+    UCHAR* newBlock;
+
+    if ((ModuleContext->Storage != HashTable_Storage_Compact) ||
+        (ValueCapacity <= DataEntry->ValueCapacity))
+    {
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    oldSize = DataEntry->KeyLength + DataEntry->ValueCapacity;
+    newSize = DataEntry->KeyLength + ValueCapacity;
+
+    if ((newSize <= ModuleContext->InlineDataLength) ||
+        ((oldSize > ModuleContext->InlineDataLength) &&
+         (HashTable_SpillSizeClassGet(oldSize) == HashTable_SpillSizeClassGet(newSize))))
+    {
+        // The data still fits where it is.
+        //
+        DataEntry->ValueCapacity = ValueCapacity;
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    ntStatus = HashTable_SpillBlockAllocate(DmfModule,
+                                            ModuleContext,
+                                            newSize,
+                                            &newBlock);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    oldBuffer = HashTable_KeyBufferGet(ModuleContext,
+                                       DataEntry);
+    RtlCopyMemory(newBlock,
+                  oldBuffer,
+                  (size_t)DataEntry->KeyLength + DataEntry->ValueLength);
+
+    if (HashTable_DataEntryIsSpilled(ModuleContext,
+                                     DataEntry))
+    {
+        HashTable_SpillBlockFree(ModuleContext,
+                                 oldBuffer,
+                                 oldSize);
+    }
+
+    *((UCHAR**)DataEntry->RawData) = newBlock;
+    DataEntry->ValueCapacity = ValueCapacity;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_DataEntryAllocate(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ ULONG ValueCapacity,
+    _Out_ ULONG* NewEntryIndex
+    )
+/*++
+
+Routine Description:
+
+    Allocates data entry for specified key and returns its index.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    ValueCapacity - Number of bytes of value data the entry must be able to hold. (Used by compact storage.)
+    NewEntryIndex - A pointer to store the index of the allocated data entry.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DATA_ENTRY* entry;
+    ULONG entryIndex;
+    UCHAR* keyBuffer;
+    UCHAR* spillBlock;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    DmfAssert((ModuleContext->LockStripeCount != 0) || DMF_ModuleIsLocked(DmfModule));
+
+    DmfAssert(NewEntryIndex != NULL);
+
+    spillBlock = NULL;
+    if ((ModuleContext->Storage == HashTable_Storage_Compact) &&
+        (KeyLength + ValueCapacity > ModuleContext->InlineDataLength))
+    {
+        // Allocate the spill block first. Entries cannot be returned in chained mode.
+        //
+        ntStatus = HashTable_SpillBlockAllocate(DmfModule,
+                                                ModuleContext,
+                                                KeyLength + ValueCapacity,
+                                                &spillBlock);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+
+    if (ModuleContext->FreeEntryIndex != INVALID_INDEX)
+    {
+        // Reuse an entry that has been removed.
+        //
+        DmfAssert(ModuleContext->Mode == HashTable_Mode_OpenAddressing);
+        entryIndex = ModuleContext->FreeEntryIndex;
+        entry = HashTable_IndexToDataEntry(ModuleContext,
+                                           entryIndex);
+        ModuleContext->FreeEntryIndex = entry->NextEntryIndex;
+    }
+    else if (ModuleContext->LockStripeCount != 0)
+    {
+        LONG entriesAllocated;
+
+        // Callers holding other stripe locks allocate entries at the same time.
+        //
+        do
+        {
+            entriesAllocated = *((volatile LONG*)&ModuleContext->DataEntriesAllocated);
+            if ((ULONG)entriesAllocated >= ModuleContext->DataEntryCapacity)
+            {
+                ntStatus = STATUS_BUFFER_TOO_SMALL;
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "No more free slots available");
+                DmfAssert(FALSE);
+                goto Exit;
+            }
+        } while (InterlockedCompareExchange((volatile LONG*)&ModuleContext->DataEntriesAllocated,
+                                            entriesAllocated + 1,
+                                            entriesAllocated) != entriesAllocated);
+
+        entryIndex = (ULONG)entriesAllocated;
+        entry = HashTable_IndexToDataEntry(ModuleContext,
+                                           entryIndex);
+    }
+    else
+    {
+        if (ModuleContext->DataEntriesAllocated >= ModuleContext->DataEntryCapacity)
+        {
+            if (ModuleContext->Mode != HashTable_Mode_OpenAddressing)
+            {
+                ntStatus = STATUS_BUFFER_TOO_SMALL;
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "No more free slots available");
+                DmfAssert(FALSE);
+                goto Exit;
+            }
+
+            ntStatus = HashTable_EntryChunkAllocate(DmfModule,
+                                                    ModuleContext);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                goto Exit;
+            }
+        }
+
+        entryIndex = ModuleContext->DataEntriesAllocated;
+        ++(ModuleContext->DataEntriesAllocated);
+
+        entry = HashTable_IndexToDataEntry(ModuleContext,
+                                           entryIndex);
+    }
+
+    entry->KeyLength = KeyLength;
+    entry->ValueLength = 0;
+    entry->NextEntryIndex = INVALID_INDEX;
+    entry->ValueCapacity = 0;
+    if (ModuleContext->Storage == HashTable_Storage_Compact)
+    {
+        entry->ValueCapacity = ValueCapacity;
+        if (spillBlock != NULL)
+        {
+            *((UCHAR**)entry->RawData) = spillBlock;
+            spillBlock = NULL;
+        }
+    }
+
+    keyBuffer = HashTable_KeyBufferGet(ModuleContext,
+                                       entry);
+
+    RtlCopyMemory(keyBuffer,
+                  Key,
+                  KeyLength);
+
+    *NewEntryIndex = entryIndex;
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    if (spillBlock != NULL)
+    {
+        HashTable_SpillBlockFree(ModuleContext,
+                                 spillBlock,
+                                 KeyLength + ValueCapacity);
+    }
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_DataEntryFree(
+    _In_ DMFMODULE DmfModule,
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG EntryIndex
+    )
+/*++
+
+Routine Description:
+
+    Adds a removed data entry to the list of entries available for reuse.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    EntryIndex - Index of the removed entry.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DATA_ENTRY* entry;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    entry = HashTable_IndexToDataEntry(ModuleContext,
+                                       EntryIndex);
+    if (HashTable_DataEntryIsSpilled(ModuleContext,
+                                     entry))
+    {
+        HashTable_SpillBlockFree(ModuleContext,
+                                 HashTable_KeyBufferGet(ModuleContext,
+                                                        entry),
+                                 entry->KeyLength + entry->ValueCapacity);
+    }
+    entry->KeyLength = 0;
+    entry->ValueLength = 0;
+    entry->ValueCapacity = 0;
+    entry->NextEntryIndex = ModuleContext->FreeEntryIndex;
+    ModuleContext->FreeEntryIndex = EntryIndex;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+HashTable_SlotTableFind(
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ HASH_TABLE_SLOTS* SlotTable,
+    _In_ ULONG Hash,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_ ULONG* SlotIndex
+    )
+/*++
+
+Routine Description:
+
+    Finds the slot that refers to the entry with the specified key in an open addressing slot table.
+    Probing stops as soon as a slot is found whose entry is closer to its home slot than the key
+    would be. (With Robin Hood insertion the key cannot be stored beyond that slot.)
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    SlotTable - The slot table to search.
+    Hash - Hash of the key.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    SlotIndex - Index of the slot that refers to the key, if found.
+
+Return Value:
+
+    TRUE if the key is found.
+
+--*/
+{
+    HASH_TABLE_SLOT* slot;
+    DATA_ENTRY* entry;
+    ULONG slotMask;
+    ULONG slotIndex;
+    ULONG probeDistance;
+
+    *SlotIndex = 0;
+
+    if (NULL == SlotTable->Slots)
+    {
+        return FALSE;
+    }
+
+    slotMask = SlotTable->SlotCount - 1;
+    slotIndex = Hash & slotMask;
+    probeDistance = 1;
+
+    // At least one slot is always empty so this loop always terminates.
+    //
+    for (;;)
+    {
+        slot = &SlotTable->Slots[slotIndex];
+        if (slot->ProbeDistance < probeDistance)
+        {
+            return FALSE;
+        }
+
+        if (slot->Hash == Hash)
+        {
+            entry = HashTable_IndexToDataEntry(ModuleContext,
+                                               slot->EntryIndex);
+            if ((entry->KeyLength == KeyLength) &&
+                (RtlCompareMemory(HashTable_KeyBufferGet(ModuleContext, entry),
+                                  Key,
+                                  KeyLength) == KeyLength))
+            {
+                *SlotIndex = slotIndex;
+                return TRUE;
+            }
+        }
+
+        slotIndex = (slotIndex + 1) & slotMask;
+        probeDistance++;
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_SlotTableInsert(
+    _Inout_ HASH_TABLE_SLOTS* SlotTable,
+    _In_ ULONG Hash,
+    _In_ ULONG EntryIndex
+    )
+/*++
+
+Routine Description:
+
+    Inserts a reference to an entry into an open addressing slot table using Robin Hood
+    insertion: While probing, an entry that is closer to its home slot than the entry being
+    inserted gives up its slot and is inserted further along instead. This keeps probe
+    lengths short and uniform.
+    NOTE: The key must not already be in the slot table and the slot table must have at least
+          two empty slots.
+
+Arguments:
+
+    SlotTable - The slot table.
+    Hash - Hash of the entry's key.
+    EntryIndex - Index of the entry.
+
+Return Value:
+
+    None
+
+--*/
+{
+    HASH_TABLE_SLOT slotToInsert;
+    HASH_TABLE_SLOT slotSwap;
+    HASH_TABLE_SLOT* slot;
+    ULONG slotMask;
+    ULONG slotIndex;
+
+    DmfAssert(SlotTable->Slots != NULL);
+    DmfAssert(SlotTable->SlotsUsed + 1 < SlotTable->SlotCount);
+
+    slotToInsert.Hash = Hash;
+    slotToInsert.ProbeDistance = 1;
+    slotToInsert.EntryIndex = EntryIndex;
+
+    slotMask = SlotTable->SlotCount - 1;
+    slotIndex = Hash & slotMask;
+
+    for (;;)
+    {
+        slot = &SlotTable->Slots[slotIndex];
+        if (0 == slot->ProbeDistance)
+        {
+            *slot = slotToInsert;
+            break;
+        }
+
+        if (slot->ProbeDistance < slotToInsert.ProbeDistance)
+        {
+            slotSwap = *slot;
+            *slot = slotToInsert;
+            slotToInsert = slotSwap;
+        }
+
+        slotIndex = (slotIndex + 1) & slotMask;
+        slotToInsert.ProbeDistance++;
+    }
+
+    SlotTable->SlotsUsed++;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_SlotTableRemove(
+    _Inout_ HASH_TABLE_SLOTS* SlotTable,
+    _In_ ULONG SlotIndex
+    )
+/*++
+
+Routine Description:
+
+    Removes a slot from an open addressing slot table. The entries that follow the slot are
+    shifted back by one slot until an empty slot or an entry in its home slot is reached.
+    This keeps the table as if the removed entry had never been inserted so no tombstones
+    are needed.
+
+Arguments:
+
+    SlotTable - The slot table.
+    SlotIndex - Index of the slot to remove.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG slotMask;
+    ULONG slotIndex;
+    ULONG nextSlotIndex;
+
+    DmfAssert(SlotTable->Slots != NULL);
+    DmfAssert(SlotTable->Slots[SlotIndex].ProbeDistance != 0);
+    DmfAssert(SlotTable->SlotsUsed > 0);
+
+    slotMask = SlotTable->SlotCount - 1;
+    slotIndex = SlotIndex;
+
+    for (;;)
+    {
+        nextSlotIndex = (slotIndex + 1) & slotMask;
+        if (SlotTable->Slots[nextSlotIndex].ProbeDistance <= 1)
+        {
+            SlotTable->Slots[slotIndex].ProbeDistance = 0;
+            break;
+        }
+
+        SlotTable->Slots[slotIndex] = SlotTable->Slots[nextSlotIndex];
+        SlotTable->Slots[slotIndex].ProbeDistance--;
+        slotIndex = nextSlotIndex;
+    }
+
+    SlotTable->SlotsUsed--;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_MigrationStep(
+    _In_ DMFMODULE DmfModule,
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    If the table is being resized, moves up to HASH_TABLE_MIGRATION_SLOTS_PER_OPERATION slots
+    from the previous slot table to the current slot table. When all slots have been moved,
+    the previous slot table is freed.
+    Slots are removed from the previous slot table in order. Removal shifts following entries
+    back, so the same slot is examined again until it is empty. Because all slots before it
+    are empty, the previous slot table remains valid for lookups throughout.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    None
+
+--*/
+{
+    HASH_TABLE_SLOTS* slotTablePrevious;
+    HASH_TABLE_SLOT* slot;
+    ULONG slotsToMigrate;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    slotTablePrevious = &ModuleContext->SlotTablePrevious;
+    if (NULL == slotTablePrevious->Slots)
+    {
+        return;
+    }
+
+    slotsToMigrate = HASH_TABLE_MIGRATION_SLOTS_PER_OPERATION;
+    while ((slotsToMigrate > 0) &&
+           (ModuleContext->MigrationSlotIndex < slotTablePrevious->SlotCount))
+    {
+        slot = &slotTablePrevious->Slots[ModuleContext->MigrationSlotIndex];
+        if (0 == slot->ProbeDistance)
+        {
+            ModuleContext->MigrationSlotIndex++;
+        }
+        else
+        {
+            HashTable_SlotTableInsert(&ModuleContext->SlotTableCurrent,
+                                      slot->Hash,
+                                      slot->EntryIndex);
+            HashTable_SlotTableRemove(slotTablePrevious,
+                                      ModuleContext->MigrationSlotIndex);
+        }
+        slotsToMigrate--;
+    }
+
+    if (ModuleContext->MigrationSlotIndex >= slotTablePrevious->SlotCount)
+    {
+        DmfAssert(0 == slotTablePrevious->SlotsUsed);
+        HashTable_SlotTableFree(slotTablePrevious);
+        ModuleContext->MigrationSlotIndex = 0;
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Resize complete: SlotCount=%u", ModuleContext->SlotTableCurrent.SlotCount);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_SlotTableReserve(
+    _In_ DMFMODULE DmfModule,
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Makes sure a new entry can be inserted in the current slot table. If the load factor
+    would be exceeded, a slot table twice as large is allocated and the existing slots are
+    moved to it incrementally by HashTable_MigrationStep().
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    STATUS_SUCCESS if a new entry can be inserted.
+    STATUS_BUFFER_TOO_SMALL if the table is full and cannot be resized.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    HASH_TABLE_SLOTS* slotTableCurrent;
+    HASH_TABLE_SLOTS slotTableResized;
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    slotTableCurrent = &ModuleContext->SlotTableCurrent;
+
+    if ((NULL == ModuleContext->SlotTablePrevious.Slots) &&
+        ((ULONGLONG)(slotTableCurrent->SlotsUsed + 1) * HASH_TABLE_LOAD_FACTOR_DENOMINATOR >
+         (ULONGLONG)slotTableCurrent->SlotCount * HASH_TABLE_LOAD_FACTOR_NUMERATOR) &&
+        (slotTableCurrent->SlotCount <= (INVALID_INDEX / 2)))
+    {
+        ntStatus = HashTable_SlotTableAllocate(DmfModule,
+                                               slotTableCurrent->SlotCount * 2,
+                                               &slotTableResized);
+        if (NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Resize start: SlotCount=%u", slotTableResized.SlotCount);
+            ModuleContext->SlotTablePrevious = *slotTableCurrent;
+            ModuleContext->SlotTableCurrent = slotTableResized;
+            ModuleContext->MigrationSlotIndex = 0;
+            HashTable_MigrationStep(DmfModule,
+                                    ModuleContext);
+        }
+        else
+        {
+            // Keep using the current slot table. Resize is attempted again on the next insertion.
+            //
+            TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "Resize fails: ntStatus=%!STATUS!", ntStatus);
+        }
+    }
+
+    // Always leave one slot empty so that probing terminates.
+    //
+    if (slotTableCurrent->SlotsUsed + 2 > slotTableCurrent->SlotCount)
+    {
+        ntStatus = STATUS_BUFFER_TOO_SMALL;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "No more free slots available");
+        goto Exit;
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+HashTable_SlotFind(
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG Hash,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_ HASH_TABLE_SLOTS** SlotTable,
+    _Out_ ULONG* SlotIndex
+    )
+/*++
+
+Routine Description:
+
+    Finds the slot that refers to the entry with the specified key in open addressing mode.
+    While the table is resized, the key may be in either slot table.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Hash - Hash of the key.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    SlotTable - The slot table where the key is found.
+    SlotIndex - Index of the slot that refers to the key.
+
+Return Value:
+
+    TRUE if the key is found.
+
+--*/
+{
+    if (HashTable_SlotTableFind(ModuleContext,
+                                &ModuleContext->SlotTableCurrent,
+                                Hash,
+                                Key,
+                                KeyLength,
+                                SlotIndex))
+    {
+        *SlotTable = &ModuleContext->SlotTableCurrent;
+        return TRUE;
+    }
+
+    if (HashTable_SlotTableFind(ModuleContext,
+                                &ModuleContext->SlotTablePrevious,
+                                Hash,
+                                Key,
+                                KeyLength,
+                                SlotIndex))
+    {
+        *SlotTable = &ModuleContext->SlotTablePrevious;
+        return TRUE;
+    }
+
+    *SlotTable = NULL;
+    return FALSE;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_OpenAddressingFindOrAllocate(
+    _In_ DMFMODULE DmfModule,
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG Hash,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ ULONG ValueCapacity,
+    _Out_ DATA_ENTRY** DataEntry,
+    _Out_ BOOLEAN* EntryFound
+    )
+/*++
+
+Routine Description:
+
+    Finds the entry with specified key in open addressing mode. If the entry with this key
+    does not exist - it will be created.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    Hash - Hash of the key.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    ValueCapacity - Number of bytes of value data a new entry must be able to hold.
+    DataEntry - A pointer to store the resulting data entry.
+    EntryFound - Receives TRUE if the entry already existed.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    HASH_TABLE_SLOTS* slotTable;
+    ULONG slotIndex;
+    ULONG entryIndex;
+
+    *EntryFound = FALSE;
+
+    HashTable_MigrationStep(DmfModule,
+                            ModuleContext);
+
+    if (HashTable_SlotFind(ModuleContext,
+                           Hash,
+                           Key,
+                           KeyLength,
+                           &slotTable,
+                           &slotIndex))
+    {
+        *DataEntry = HashTable_IndexToDataEntry(ModuleContext,
+                                                slotTable->Slots[slotIndex].EntryIndex);
+        *EntryFound = TRUE;
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    ntStatus = HashTable_SlotTableReserve(DmfModule,
+                                          ModuleContext);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    ntStatus = HashTable_DataEntryAllocate(DmfModule,
+                                           ModuleContext,
+                                           Key,
+                                           KeyLength,
+                                           ValueCapacity,
+                                           &entryIndex);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    HashTable_SlotTableInsert(&ModuleContext->SlotTableCurrent,
+                              Hash,
+                              entryIndex);
+
+    *DataEntry = HashTable_IndexToDataEntry(ModuleContext,
+                                            entryIndex);
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_DataEntryFindOrAllocate(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG_PTR Hash,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ ULONG ValueCapacity,
+    _Out_ DATA_ENTRY** DataEntry
+    )
+/*++
+
+Routine Description:
+
+    Finds the entry with specified key. If the entry with this key does not exist - it will be created.
+
+Arguments:
+
+    DmfModule - DMF Module.
+    Hash - Hash of the Key. (Calculated before the table is locked.)
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    ValueCapacity - Number of bytes of value data the entry must be able to hold.
+    DataEntry - A pointer to store the resulting data entry.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    ULONG_PTR hash;
+    ULONG entryIndex;
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_HashTable* moduleContext;
+    HASH_TABLE_COUNTERS* counters;
+    BOOLEAN entryFound;
+
+    DmfAssert(DataEntry != NULL);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert((moduleContext->LockStripeCount != 0) || DMF_ModuleIsLocked(DmfModule));
+
+    hash = Hash;
+    entryFound = FALSE;
+
+    if (moduleContext->Mode == HashTable_Mode_OpenAddressing)
+    {
+        ntStatus = HashTable_OpenAddressingFindOrAllocate(DmfModule,
+                                                          moduleContext,
+                                                          (ULONG)hash,
+                                                          Key,
+                                                          KeyLength,
+                                                          ValueCapacity,
+                                                          DataEntry,
+                                                          &entryFound);
+        goto Exit;
+    }
+
+    // Adjust the hash value to the size of the hash table, so that we can use the hash as an index in this table.
+    //
+    hash = hash % moduleContext->HashMapSize;
+
+    entryIndex = moduleContext->HashMap[hash];
+
+    if (INVALID_INDEX == entryIndex)
+    {
+        ntStatus = HashTable_DataEntryAllocate(DmfModule,
+                                               moduleContext,
+                                               Key,
+                                               KeyLength,
+                                               ValueCapacity,
+                                               &entryIndex);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+
+        moduleContext->HashMap[hash] = entryIndex;
+        *DataEntry = HashTable_IndexToDataEntry(moduleContext,
+                                                entryIndex);
+    }
+    else
+    {
+        DATA_ENTRY* currentEntry;
+
+        // Search the table for the given key.
+        //
+        do
+        {
+            currentEntry = HashTable_IndexToDataEntry(moduleContext,
+                                                      entryIndex);
+            if ((currentEntry->KeyLength == KeyLength) &&
+                (RtlCompareMemory(HashTable_KeyBufferGet(moduleContext, currentEntry),
+                                  Key,
+                                  KeyLength) == KeyLength))
+            {
+                // We have found the element with the key we are looking for.
+                //
+                *DataEntry = currentEntry;
+                entryFound = TRUE;
+                break;
+            }
+
+            entryIndex = currentEntry->NextEntryIndex;
+
+        } while (entryIndex != INVALID_INDEX);
+
+        if (INVALID_INDEX == entryIndex)
+        {
+            ntStatus = HashTable_DataEntryAllocate(DmfModule,
+                                                   moduleContext,
+                                                   Key,
+                                                   KeyLength,
+                                                   ValueCapacity,
+                                                   &entryIndex);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                goto Exit;
+            }
+
+            currentEntry->NextEntryIndex = entryIndex;
+            *DataEntry = HashTable_IndexToDataEntry(moduleContext,
+                                                    entryIndex);
+        }
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    counters = HashTable_CountersGet(moduleContext,
+                                     Hash);
+    if (entryFound)
+    {
+        counters->LookupHitCount++;
+    }
+    else
+    {
+        counters->LookupMissCount++;
+        // Only a full table is counted. Failures to allocate memory are not.
+        //
+        if (STATUS_BUFFER_TOO_SMALL == ntStatus)
+        {
+            counters->TableFullCount++;
+        }
+    }
+
+    if (NT_SUCCESS(ntStatus))
+    {
+        // An existing entry may not be able to hold a value of the requested length.
+        //
+        ntStatus = HashTable_DataEntryCapacityEnsure(DmfModule,
+                                                     moduleContext,
+                                                     *DataEntry,
+                                                     ValueCapacity);
+    }
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_DataEntryFind(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG_PTR Hash,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_ DATA_ENTRY** DataEntry
+    )
+/*++
+
+Routine Description:
+
+    Finds the entry with specified key.
+
+Arguments:
+
+    DmfModule - DMF Module.
+    Hash - Hash of the Key. (Calculated before the table is locked.)
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    DataEntry - A pointer to store the resulting data entry.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    ULONG_PTR hash;
+    DATA_ENTRY* currentEntry;
+    ULONG entryIndex;
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_HashTable* moduleContext;
+    HASH_TABLE_COUNTERS* counters;
+
+    DmfAssert(DataEntry != NULL);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert((moduleContext->LockStripeCount != 0) || DMF_ModuleIsLocked(DmfModule));
+
+    hash = Hash;
+
+    if (moduleContext->Mode == HashTable_Mode_OpenAddressing)
+    {
+        HASH_TABLE_SLOTS* slotTable;
+        ULONG slotIndex;
+
+        if (! HashTable_SlotFind(moduleContext,
+                                 (ULONG)hash,
+                                 Key,
+                                 KeyLength,
+                                 &slotTable,
+                                 &slotIndex))
+        {
+            ntStatus = STATUS_NOT_FOUND;
+            goto Exit;
+        }
+
+        *DataEntry = HashTable_IndexToDataEntry(moduleContext,
+                                                slotTable->Slots[slotIndex].EntryIndex);
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    // Adjust the hash value to the size of the hash table, so that we can use the hash as an index in this table.
+    //
+    hash = hash % moduleContext->HashMapSize;
+
+    entryIndex = moduleContext->HashMap[hash];
+    if (INVALID_INDEX == entryIndex)
+    {
+        ntStatus = STATUS_NOT_FOUND;
+        goto Exit;
+    }
+
+    // Search the table for the given key.
+    //
+    do
+    {
+        currentEntry = HashTable_IndexToDataEntry(moduleContext,
+                                                  entryIndex);
+
+        if ((currentEntry->KeyLength == KeyLength) &&
+            (RtlCompareMemory(HashTable_KeyBufferGet(moduleContext, currentEntry),
+                              Key,
+                              KeyLength) == KeyLength))
+        {
+            // We have found the element with the key we are looking for.
+            //
+            break;
+        }
+
+        entryIndex = currentEntry->NextEntryIndex;
+    } while (entryIndex != INVALID_INDEX);
+
+    if (INVALID_INDEX == entryIndex)
+    {
+        ntStatus = STATUS_NOT_FOUND;
+        goto Exit;
+    }
+
+    *DataEntry = currentEntry;
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    counters = HashTable_CountersGet(moduleContext,
+                                     Hash);
+    if (NT_SUCCESS(ntStatus))
+    {
+        counters->LookupHitCount++;
+    }
+    else
+    {
+        counters->LookupMissCount++;
+    }
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+HashTable_SlotTableEnumerate(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ HASH_TABLE_SLOTS* SlotTable,
+    _In_ EVT_DMF_HashTable_Enumerate* CallbackEnumerate,
+    _In_ VOID* CallbackContext
+    )
+/*++
+
+Routine Description:
+
+    Calls a callback function for each entry referred to by an open addressing slot table.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    SlotTable - The slot table to enumerate.
+    CallbackEnumerate - The callback to be called during enumeration. Enumeration stops when the callback returns FALSE.
+    CallbackContext - Context pointer to pass into callback function.
+
+Return Value:
+
+    FALSE if the callback stopped the enumeration.
+
+--*/
+{
+    ULONG slotIndex;
+    DATA_ENTRY* dataEntry;
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    for (slotIndex = 0; slotIndex < SlotTable->SlotCount; ++slotIndex)
+    {
+        if (0 == SlotTable->Slots[slotIndex].ProbeDistance)
+        {
+            continue;
+        }
+
+        dataEntry = HashTable_IndexToDataEntry(ModuleContext,
+                                               SlotTable->Slots[slotIndex].EntryIndex);
+        if (! CallbackEnumerate(DmfModule,
+                                HashTable_KeyBufferGet(ModuleContext, dataEntry),
+                                dataEntry->KeyLength,
+                                HashTable_ValueBufferGet(ModuleContext, dataEntry),
+                                dataEntry->ValueLength,
+                                CallbackContext))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_Lock(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG_PTR Hash
+    )
+/*++
+
+Routine Description:
+
+    Acquires the lock that protects the entries with the given hash.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    Hash - Hash of the Key that will be accessed.
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (ModuleContext->LockStripeCount != 0)
+    {
+        WdfSpinLockAcquire(ModuleContext->LockStripes[(Hash % ModuleContext->HashMapSize) % ModuleContext->LockStripeCount]);
+    }
+    else
+    {
+        DMF_ModuleLock(DmfModule);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_Unlock(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG_PTR Hash
+    )
+/*++
+
+Routine Description:
+
+    Releases the lock acquired by HashTable_Lock().
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    Hash - Hash passed to HashTable_Lock().
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (ModuleContext->LockStripeCount != 0)
+    {
+        WdfSpinLockRelease(ModuleContext->LockStripes[(Hash % ModuleContext->HashMapSize) % ModuleContext->LockStripeCount]);
+    }
+    else
+    {
+        DMF_ModuleUnlock(DmfModule);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+HashTable_StripeEnumerate(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG StripeIndex,
+    _In_ EVT_DMF_HashTable_Enumerate* CallbackEnumerate,
+    _In_ VOID* CallbackContext
+    )
+/*++
+
+Routine Description:
+
+    Calls a callback function for each entry chained to the buckets of one lock stripe.
+    The caller holds the lock of the stripe.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    StripeIndex - The stripe to enumerate.
+    CallbackEnumerate - The callback to be called during enumeration. Enumeration stops when the callback returns FALSE.
+    CallbackContext - Context pointer to pass into callback function.
+
+Return Value:
+
+    FALSE if the callback stopped the enumeration.
+
+--*/
+{
+    ULONG bucketIndex;
+    ULONG entryIndex;
+    DATA_ENTRY* dataEntry;
+
+    for (bucketIndex = StripeIndex; bucketIndex < ModuleContext->HashMapSize; bucketIndex += ModuleContext->LockStripeCount)
+    {
+        entryIndex = ModuleContext->HashMap[bucketIndex];
+        while (entryIndex != INVALID_INDEX)
+        {
+            dataEntry = HashTable_IndexToDataEntry(ModuleContext,
+                                                   entryIndex);
+            if (! CallbackEnumerate(DmfModule,
+                                    HashTable_KeyBufferGet(ModuleContext, dataEntry),
+                                    dataEntry->KeyLength,
+                                    HashTable_ValueBufferGet(ModuleContext, dataEntry),
+                                    dataEntry->ValueLength,
+                                    CallbackContext))
+            {
+                return FALSE;
+            }
+            entryIndex = dataEntry->NextEntryIndex;
+        }
+    }
+
+    return TRUE;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_BatchLock(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_reads_(HashCount) ULONG_PTR* Hashes,
+    _In_ ULONG HashCount,
+    _Out_writes_(HASH_TABLE_BATCH_STRIPE_MASK_SIZE) ULONG* StripeMask
+    )
+/*++
+
+Routine Description:
+
+    Acquires the locks that protect the entries with the given hashes. Each lock is acquired once
+    no matter how many of the hashes it protects.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    Hashes - Hashes of the Keys that will be accessed.
+    HashCount - Number of entries in Hashes.
+    StripeMask - Receives the bitmap of the lock stripes that are acquired.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG hashIndex;
+    ULONG stripeIndex;
+
+    RtlZeroMemory(StripeMask,
+                  HASH_TABLE_BATCH_STRIPE_MASK_SIZE * sizeof(ULONG));
+
+    if (0 == ModuleContext->LockStripeCount)
+    {
+        DMF_ModuleLock(DmfModule);
+        return;
+    }
+
+    for (hashIndex = 0; hashIndex < HashCount; hashIndex++)
+    {
+        stripeIndex = (ULONG)((Hashes[hashIndex] % ModuleContext->HashMapSize) % ModuleContext->LockStripeCount);
+        StripeMask[stripeIndex / 32] |= (1UL << (stripeIndex % 32));
+    }
+
+    // Acquire the stripes in ascending order like snapshot enumeration does so that batches
+    // cannot deadlock with each other or with enumeration.
+    //
+    for (stripeIndex = 0; stripeIndex < ModuleContext->LockStripeCount; stripeIndex++)
+    {
+        if (StripeMask[stripeIndex / 32] & (1UL << (stripeIndex % 32)))
+        {
+            WdfSpinLockAcquire(ModuleContext->LockStripes[stripeIndex]);
+        }
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_BatchUnlock(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_reads_(HASH_TABLE_BATCH_STRIPE_MASK_SIZE) ULONG* StripeMask
+    )
+/*++
+
+Routine Description:
+
+    Releases the locks acquired by HashTable_BatchLock().
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    StripeMask - Bitmap of the lock stripes returned by HashTable_BatchLock().
+
+Return Value:
+
+    None
 
-Exit:
+--*/
+{
+    ULONG stripeIndex;
 
-    if (! NT_SUCCESS(ntStatus))
+    if (0 == ModuleContext->LockStripeCount)
     {
-        HashTable_ContextCleanup(moduleContext);
+        DMF_ModuleUnlock(DmfModule);
+        return;
     }
 
-    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
-
-    return ntStatus;
+    for (stripeIndex = ModuleContext->LockStripeCount; stripeIndex > 0; stripeIndex--)
+    {
+        if (StripeMask[(stripeIndex - 1) / 32] & (1UL << ((stripeIndex - 1) % 32)))
+        {
+            WdfSpinLockRelease(ModuleContext->LockStripes[stripeIndex - 1]);
+        }
+    }
 }
-#pragma code_seg()
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-_Must_inspect_result_
 static
-NTSTATUS
-HashTable_DataEntryAllocate(
-    _In_ DMFMODULE DmfModule,
+VOID
+HashTable_BatchPrefetch(
     _In_ DMF_CONTEXT_HashTable* ModuleContext,
-    _In_reads_(KeyLength) UCHAR* Key,
-    _In_ ULONG KeyLength,
-    _Out_ ULONG* NewEntryIndex
+    _In_reads_(HashCount) ULONG_PTR* Hashes,
+    _In_ ULONG HashCount
     )
 /*++
 
 Routine Description:
 
-    Allocates data entry for specified key and returns its index.
+    Requests the cache lines that the lookups of a batch of Keys access first, so that the cache
+    misses of all the Keys overlap instead of being taken one after another.
+    The caller holds the locks that protect the entries with the given hashes.
 
 Arguments:
 
     ModuleContext - This Module's context.
-    Key - Address of the buffer containing Key data.
-    KeyLength - Length of Key data in bytes.
-    NewEntryIndex - A pointer to store the index of the allocated data entry.
+    Hashes - Hashes of the Keys that will be accessed.
+    HashCount - Number of entries in Hashes.
 
 Return Value:
 
-    NT_STATUS code indicating success or failure.
+    None
 
 --*/
 {
-    NTSTATUS ntStatus;
-    DATA_ENTRY* entry;
+    ULONG hashIndex;
     ULONG entryIndex;
-    UCHAR* keyBuffer;
+    HASH_TABLE_SLOTS* slotTable;
+    HASH_TABLE_SLOT* slot;
 
-    UNREFERENCED_PARAMETER(DmfModule);
-
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
-
-    DmfAssert(NewEntryIndex != NULL);
+    slotTable = &ModuleContext->SlotTableCurrent;
 
-    if (ModuleContext->DataEntriesAllocated >= ModuleContext->DataTableSize)
+    // Bucket (or home slot) of every Key.
+    //
+    for (hashIndex = 0; hashIndex < HashCount; hashIndex++)
     {
-        ntStatus = STATUS_BUFFER_TOO_SMALL;
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "No more free slots available");
-        DmfAssert(FALSE);
-        goto Exit;
+        if (ModuleContext->Mode == HashTable_Mode_OpenAddressing)
+        {
+            if (slotTable->Slots != NULL)
+            {
+                PreFetchCacheLine(PF_TEMPORAL_LEVEL_1,
+                                  &slotTable->Slots[(ULONG)Hashes[hashIndex] & (slotTable->SlotCount - 1)]);
+            }
+        }
+        else
+        {
+            PreFetchCacheLine(PF_TEMPORAL_LEVEL_1,
+                              &ModuleContext->HashMap[Hashes[hashIndex] % ModuleContext->HashMapSize]);
+        }
     }
 
-    entryIndex = ModuleContext->DataEntriesAllocated;
-    ++(ModuleContext->DataEntriesAllocated);
-
-    entry = HashTable_IndexToDataEntry(ModuleContext,
-                                       entryIndex);
-
-    entry->KeyLength = KeyLength;
-    entry->ValueLength = 0;
-    entry->NextEntryIndex = INVALID_INDEX;
-
-    keyBuffer = HashTable_KeyBufferGet(entry);
-
-    RtlCopyMemory(keyBuffer,
-                  Key,
-                  KeyLength);
-
-    *NewEntryIndex = entryIndex;
-
-    ntStatus = STATUS_SUCCESS;
-
-Exit:
+    // First entry each bucket refers to. By now most of the lines requested above have arrived.
+    //
+    for (hashIndex = 0; hashIndex < HashCount; hashIndex++)
+    {
+        if (ModuleContext->Mode == HashTable_Mode_OpenAddressing)
+        {
+            if (NULL == slotTable->Slots)
+            {
+                continue;
+            }
+            slot = &slotTable->Slots[(ULONG)Hashes[hashIndex] & (slotTable->SlotCount - 1)];
+            if (0 == slot->ProbeDistance)
+            {
+                continue;
+            }
+            entryIndex = slot->EntryIndex;
+        }
+        else
+        {
+            entryIndex = ModuleContext->HashMap[Hashes[hashIndex] % ModuleContext->HashMapSize];
+            if (INVALID_INDEX == entryIndex)
+            {
+                continue;
+            }
+        }
 
-    return ntStatus;
+        PreFetchCacheLine(PF_TEMPORAL_LEVEL_1,
+                          HashTable_IndexToDataEntry(ModuleContext,
+                                                     entryIndex));
+    }
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 static
 NTSTATUS
-HashTable_DataEntryFindOrAllocate(
+HashTable_BatchProcess(
     _In_ DMFMODULE DmfModule,
-    _In_reads_(KeyLength) UCHAR* Key,
-    _In_ ULONG KeyLength,
-    _Out_ DATA_ENTRY** DataEntry
+    _Inout_updates_(ItemCount) HashTable_BatchItem* Items,
+    _In_ ULONG ItemCount,
+    _In_ BOOLEAN Write
     )
 /*++
 
 Routine Description:
 
-    Finds the entry with specified key. If the entry with this key does not exist - it will be created.
+    Reads or writes the Values of a batch of Keys. The hashes of up to HASH_TABLE_BATCH_CHUNK_SIZE
+    Keys are calculated, the locks that protect them are acquired once, the cache lines they
+    access are prefetched and then each Key is looked up.
 
 Arguments:
 
-    DmfModule - DMF Module.
-    Key - Address of the buffer containing Key data.
-    KeyLength - Length of Key data in bytes.
-    DataEntry - A pointer to store the resulting data entry.
+    DmfModule - This Module's handle.
+    Items - The Keys to process. The result for each Key is written to its NtStatus.
+    ItemCount - Number of entries in Items.
+    Write - TRUE to write the Values. FALSE to read them.
 
 Return Value:
 
-    NT_STATUS code indicating success or failure.
+    STATUS_SUCCESS if the operation succeeded for every Key. Otherwise, the result of the first
+    Key for which it failed.
 
 --*/
 {
-    ULONG_PTR hash;
-    ULONG entryIndex;
-    NTSTATUS ntStatus;
     DMF_CONTEXT_HashTable* moduleContext;
-
-    DmfAssert(DataEntry != NULL);
-
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    NTSTATUS ntStatus;
+    DATA_ENTRY* dataEntry;
+    HashTable_BatchItem* item;
+    ULONG_PTR hashes[HASH_TABLE_BATCH_CHUNK_SIZE];
+    ULONG stripeMask[HASH_TABLE_BATCH_STRIPE_MASK_SIZE];
+    ULONG chunkStart;
+    ULONG chunkSize;
+    ULONG itemIndex;
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
-                                                    Key,
-                                                    KeyLength);
-
-    // Adjust the hash value to the size of the hash table, so that we can use the hash as an index in this table.
-    //
-    hash = hash % moduleContext->HashMapSize;
+    DmfAssert((Items != NULL) || (0 == ItemCount));
 
-    entryIndex = moduleContext->HashMap[hash];
+    ntStatus = STATUS_SUCCESS;
 
-    if (INVALID_INDEX == entryIndex)
+    for (chunkStart = 0; chunkStart < ItemCount; chunkStart += chunkSize)
     {
-        ntStatus = HashTable_DataEntryAllocate(DmfModule,
-                                               moduleContext,
-                                               Key,
-                                               KeyLength,
-                                               &entryIndex);
-        if (! NT_SUCCESS(ntStatus))
+        chunkSize = min(ItemCount - chunkStart,
+                        HASH_TABLE_BATCH_CHUNK_SIZE);
+
+        for (itemIndex = 0; itemIndex < chunkSize; itemIndex++)
         {
-            goto Exit;
+            item = &Items[chunkStart + itemIndex];
+            hashes[itemIndex] = moduleContext->EvtHashTableHashCalculate(DmfModule,
+                                                                         item->Key,
+                                                                         item->KeyLength);
         }
 
-        moduleContext->HashMap[hash] = entryIndex;
-        *DataEntry = HashTable_IndexToDataEntry(moduleContext,
-                                                entryIndex);
-    }
-    else
-    {
-        DATA_ENTRY* currentEntry;
+        HashTable_BatchLock(DmfModule,
+                            moduleContext,
+                            hashes,
+                            chunkSize,
+                            stripeMask);
 
-        // Search the table for the given key.
-        //
-        do
-        {
-            currentEntry = HashTable_IndexToDataEntry(moduleContext,
-                                                      entryIndex);
-            if ((currentEntry->KeyLength == KeyLength) &&
-                (RtlCompareMemory(HashTable_KeyBufferGet(currentEntry),
-                                  Key,
-                                  KeyLength) == KeyLength))
-            {
-                // We have found the element with the key we are looking for.
-                //
-                *DataEntry = currentEntry;
-                break;
-            }
+        HashTable_BatchPrefetch(moduleContext,
+                                hashes,
+                                chunkSize);
 
-            entryIndex = currentEntry->NextEntryIndex;
+        for (itemIndex = 0; itemIndex < chunkSize; itemIndex++)
+        {
+            item = &Items[chunkStart + itemIndex];
 
-        } while (entryIndex != INVALID_INDEX);
+            DmfAssert(item->KeyLength <= moduleContext->MaximumKeyLength);
 
-        if (INVALID_INDEX == entryIndex)
-        {
-            ntStatus = HashTable_DataEntryAllocate(DmfModule,
-                                                   moduleContext,
-                                                   Key,
-                                                   KeyLength,
-                                                   &entryIndex);
-            if (! NT_SUCCESS(ntStatus))
+            if (Write)
             {
-                goto Exit;
+                if (item->ValueLength > moduleContext->MaximumValueLength)
+                {
+                    item->NtStatus = STATUS_BUFFER_OVERFLOW;
+                }
+                else
+                {
+                    item->NtStatus = HashTable_DataEntryFindOrAllocate(DmfModule,
+                                                                       hashes[itemIndex],
+                                                                       item->Key,
+                                                                       item->KeyLength,
+                                                                       item->ValueLength,
+                                                                       &dataEntry);
+                    if (NT_SUCCESS(item->NtStatus))
+                    {
+                        dataEntry->ValueLength = item->ValueLength;
+                        RtlCopyMemory(HashTable_ValueBufferGet(moduleContext, dataEntry),
+                                      item->Value,
+                                      item->ValueLength);
+                    }
+                }
+            }
+            else
+            {
+                item->ValueLength = 0;
+                item->NtStatus = HashTable_DataEntryFind(DmfModule,
+                                                         hashes[itemIndex],
+                                                         item->Key,
+                                                         item->KeyLength,
+                                                         &dataEntry);
+                if (NT_SUCCESS(item->NtStatus))
+                {
+                    item->ValueLength = dataEntry->ValueLength;
+                    if (item->ValueBufferLength < dataEntry->ValueLength)
+                    {
+                        item->NtStatus = STATUS_BUFFER_TOO_SMALL;
+                    }
+                    else
+                    {
+                        RtlCopyMemory(item->Value,
+                                      HashTable_ValueBufferGet(moduleContext, dataEntry),
+                                      dataEntry->ValueLength);
+                    }
+                }
             }
 
-            currentEntry->NextEntryIndex = entryIndex;
-            *DataEntry = HashTable_IndexToDataEntry(moduleContext,
-                                                    entryIndex);
+            if (NT_SUCCESS(ntStatus) &&
+                (! NT_SUCCESS(item->NtStatus)))
+            {
+                ntStatus = item->NtStatus;
+            }
         }
-    }
-
-    ntStatus = STATUS_SUCCESS;
 
-Exit:
+        HashTable_BatchUnlock(DmfModule,
+                              moduleContext,
+                              stripeMask);
+    }
 
     return ntStatus;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-_Must_inspect_result_
 static
-NTSTATUS
-HashTable_DataEntryFind(
-    _In_ DMFMODULE DmfModule,
-    _In_reads_(KeyLength) UCHAR* Key,
-    _In_ ULONG KeyLength,
-    _Out_ DATA_ENTRY** DataEntry
+VOID
+HashTable_SlotTableStatisticsAdd(
+    _In_ HASH_TABLE_SLOTS* SlotTable,
+    _Inout_ HashTable_Statistics* Statistics,
+    _Inout_ ULONGLONG* ChainLengthTotal
     )
 /*++
 
 Routine Description:
 
-    Finds the entry with specified key.
+    Adds the occupancy and probe lengths of an open addressing slot table to the statistics.
 
 Arguments:
 
-    DmfModule - DMF Module.
-    Key - Address of the buffer containing Key data.
-    KeyLength - Length of Key data in bytes.
-    DataEntry - A pointer to store the resulting data entry.
+    SlotTable - The slot table to measure.
+    Statistics - The statistics to update.
+    ChainLengthTotal - Sum of the number of slots examined to find each entry.
 
 Return Value:
 
-    NT_STATUS code indicating success or failure.
+    None
 
 --*/
 {
-    ULONG_PTR hash;
-    DATA_ENTRY* currentEntry;
-    ULONG entryIndex;
-    NTSTATUS ntStatus;
-    DMF_CONTEXT_HashTable* moduleContext;
-
-    DmfAssert(DataEntry != NULL);
-
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
-
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-
-    hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
-                                                    Key,
-                                                    KeyLength);
-
-    // Adjust the hash value to the size of the hash table, so that we can use the hash as an index in this table.
-    //
-    hash = hash % moduleContext->HashMapSize;
-
-    entryIndex = moduleContext->HashMap[hash];
-    if (INVALID_INDEX == entryIndex)
-    {
-        ntStatus = STATUS_NOT_FOUND;
-        goto Exit;
-    }
+    ULONG slotIndex;
+    ULONG probeDistance;
 
-    // Search the table for the given key.
-    //
-    do
+    for (slotIndex = 0; slotIndex < SlotTable->SlotCount; ++slotIndex)
     {
-        currentEntry = HashTable_IndexToDataEntry(moduleContext,
-                                                  entryIndex);
-
-        if ((currentEntry->KeyLength == KeyLength) &&
-            (RtlCompareMemory(HashTable_KeyBufferGet(currentEntry),
-                              Key,
-                              KeyLength) == KeyLength))
+        // ProbeDistance is the number of slots examined to find the entry.
+        //
+        probeDistance = SlotTable->Slots[slotIndex].ProbeDistance;
+        if (0 == probeDistance)
         {
-            // We have found the element with the key we are looking for.
-            //
-            break;
+            continue;
         }
 
-        entryIndex = currentEntry->NextEntryIndex;
-    } while (entryIndex != INVALID_INDEX);
-
-    if (INVALID_INDEX == entryIndex)
-    {
-        ntStatus = STATUS_NOT_FOUND;
-        goto Exit;
+        Statistics->EntryCount++;
+        if (1 == probeDistance)
+        {
+            Statistics->BucketsUsed++;
+        }
+        Statistics->MaximumChainLength = max(Statistics->MaximumChainLength,
+                                             probeDistance);
+        *ChainLengthTotal += probeDistance;
     }
-
-    *DataEntry = currentEntry;
-
-    ntStatus = STATUS_SUCCESS;
-
-Exit:
-
-    return ntStatus;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -918,6 +3470,7 @@ Return Value:
 {
     DMF_CONTEXT_HashTable* moduleContext;
     ULONG entryIndex;
+    ULONG stripeIndex;
 
     FuncEntry(DMF_TRACE);
 
@@ -926,18 +3479,71 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    // Synchronize with calls to add items to table.
-    //
-    DMF_ModuleLock(DmfModule);
+    if (moduleContext->LockStripeCount != 0)
+    {
+        if (! moduleContext->EnumerateSnapshot)
+        {
+            // Lock one stripe at a time so that the other stripes remain available.
+            //
+            for (stripeIndex = 0; stripeIndex < moduleContext->LockStripeCount; stripeIndex++)
+            {
+                BOOLEAN continueEnumeration;
+
+                WdfSpinLockAcquire(moduleContext->LockStripes[stripeIndex]);
+                continueEnumeration = HashTable_StripeEnumerate(DmfModule,
+                                                                moduleContext,
+                                                                stripeIndex,
+                                                                CallbackEnumerate,
+                                                                CallbackContext);
+                WdfSpinLockRelease(moduleContext->LockStripes[stripeIndex]);
+                if (! continueEnumeration)
+                {
+                    break;
+                }
+            }
+            goto ExitNoLock;
+        }
+
+        // Acquire the stripes in ascending order. Batch Methods also hold several stripes, and
+        // they acquire them in the same order, so this cannot deadlock with them.
+        //
+        for (stripeIndex = 0; stripeIndex < moduleContext->LockStripeCount; stripeIndex++)
+        {
+            WdfSpinLockAcquire(moduleContext->LockStripes[stripeIndex]);
+        }
+    }
+    else
+    {
+        // Synchronize with calls to add items to table.
+        //
+        DMF_ModuleLock(DmfModule);
+    }
+
+    if (moduleContext->Mode == HashTable_Mode_OpenAddressing)
+    {
+        if (HashTable_SlotTableEnumerate(DmfModule,
+                                         moduleContext,
+                                         &moduleContext->SlotTablePrevious,
+                                         CallbackEnumerate,
+                                         CallbackContext))
+        {
+            HashTable_SlotTableEnumerate(DmfModule,
+                                         moduleContext,
+                                         &moduleContext->SlotTableCurrent,
+                                         CallbackEnumerate,
+                                         CallbackContext);
+        }
+        goto Exit;
+    }
 
     for (entryIndex = 0; entryIndex < moduleContext->DataEntriesAllocated; ++entryIndex)
     {
         DATA_ENTRY* dataEntry = HashTable_IndexToDataEntry(moduleContext, entryIndex);
 
         if (! CallbackEnumerate(DmfModule,
-                                HashTable_KeyBufferGet(dataEntry),
+                                HashTable_KeyBufferGet(moduleContext, dataEntry),
                                 dataEntry->KeyLength,
-                                HashTable_ValueBufferGet(dataEntry),
+                                HashTable_ValueBufferGet(moduleContext, dataEntry),
                                 dataEntry->ValueLength,
                                 CallbackContext))
         {
@@ -945,7 +3551,21 @@ Return Value:
         }
     }
 
-    DMF_ModuleUnlock(DmfModule);
+Exit:
+
+    if (moduleContext->LockStripeCount != 0)
+    {
+        for (stripeIndex = moduleContext->LockStripeCount; stripeIndex > 0; stripeIndex--)
+        {
+            WdfSpinLockRelease(moduleContext->LockStripes[stripeIndex - 1]);
+        }
+    }
+    else
+    {
+        DMF_ModuleUnlock(DmfModule);
+    }
+
+ExitNoLock:
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -982,21 +3602,32 @@ Return Value:
     DMF_CONTEXT_HashTable* moduleContext;
     NTSTATUS ntStatus;
     DATA_ENTRY* dataEntry;
+    ULONG_PTR hash;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  HashTable);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
+                                                    Key,
+                                                    KeyLength);
+
     // Synchronize with Methods to read, write and enumerate entries in table.
     //
-    DMF_ModuleLock(DmfModule);
+    HashTable_Lock(DmfModule,
+                   moduleContext,
+                   hash);
 
     DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
 
+    // The callback may write a value of any length up to MaximumValueLength.
+    //
     ntStatus = HashTable_DataEntryFindOrAllocate(DmfModule,
+                                                 hash,
                                                  Key,
                                                  KeyLength,
+                                                 moduleContext->MaximumValueLength,
                                                  &dataEntry);
     if (! NT_SUCCESS(ntStatus))
     {
@@ -1007,18 +3638,59 @@ Return Value:
     CallbackFind(DmfModule,
                  Key,
                  KeyLength,
-                 HashTable_ValueBufferGet(dataEntry),
+                 HashTable_ValueBufferGet(moduleContext, dataEntry),
                  &dataEntry->ValueLength);
 
     ntStatus = STATUS_SUCCESS;
 
 Exit:
 
-    DMF_ModuleUnlock(DmfModule);
+    HashTable_Unlock(DmfModule,
+                     moduleContext,
+                     hash);
 
     return ntStatus;
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_HashTable_FindBatch(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(ItemCount) HashTable_BatchItem* Items,
+    _In_ ULONG ItemCount
+    )
+/*++
+
+Routine Description:
+
+    Reads the Values associated with a batch of Keys. The table is locked once for up to 64 Keys
+    and the cache lines of all the Keys are prefetched before any Key is looked up.
+    Unlike DMF_HashTable_Find(), Keys that are not in the table are not added.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Items - The Keys to read. For each Key, the Value is copied to Value and its length is written
+            to ValueLength. NtStatus receives STATUS_SUCCESS, STATUS_NOT_FOUND or
+            STATUS_BUFFER_TOO_SMALL (ValueLength is then the required buffer length).
+    ItemCount - Number of entries in Items.
+
+Return Value:
+
+    STATUS_SUCCESS if every Key was found. Otherwise, the result of the first Key that was not read.
+
+--*/
+{
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 HashTable);
+
+    return HashTable_BatchProcess(DmfModule,
+                                  Items,
+                                  ItemCount,
+                                  FALSE);
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -1054,21 +3726,32 @@ Return Value:
     DMF_CONTEXT_HashTable* moduleContext;
     NTSTATUS ntStatus;
     DATA_ENTRY* dataEntry;
+    ULONG_PTR hash;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  HashTable);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
+                                                    Key,
+                                                    KeyLength);
+
     // Synchronize with Methods to read, write and enumerate entries in table.
     //
-    DMF_ModuleLock(DmfModule);
+    HashTable_Lock(DmfModule,
+                   moduleContext,
+                   hash);
 
     DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
 
+    // The callback may write a value of any length up to MaximumValueLength.
+    //
     ntStatus = HashTable_DataEntryFindOrAllocate(DmfModule,
+                                                 hash,
                                                  Key,
                                                  KeyLength,
+                                                 moduleContext->MaximumValueLength,
                                                  &dataEntry);
     if (! NT_SUCCESS(ntStatus))
     {
@@ -1080,18 +3763,58 @@ Return Value:
                    CallbackContext,
                    Key,
                    KeyLength,
-                   HashTable_ValueBufferGet(dataEntry),
+                   HashTable_ValueBufferGet(moduleContext, dataEntry),
                    &dataEntry->ValueLength);
 
     ntStatus = STATUS_SUCCESS;
 
 Exit:
 
-    DMF_ModuleUnlock(DmfModule);
+    HashTable_Unlock(DmfModule,
+                     moduleContext,
+                     hash);
 
     return ntStatus;
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONG_PTR
+DMF_HashTable_HashCalculate(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength
+    )
+/*++
+
+Routine Description:
+
+    Calculates the hash of a Key using the hashing algorithm this Module is configured to use.
+    The table is not accessed.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+
+Return Value:
+
+    Hash of the Key.
+
+--*/
+{
+    DMF_CONTEXT_HashTable* moduleContext;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 HashTable);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    return moduleContext->EvtHashTableHashCalculate(DmfModule,
+                                                    Key,
+                                                    KeyLength);
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -1129,15 +3852,23 @@ Return Value:
     DMF_CONTEXT_HashTable* moduleContext;
     NTSTATUS ntStatus;
     DATA_ENTRY* dataEntry;
+    ULONG_PTR hash;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  HashTable);
 
-    DMF_ModuleLock(DmfModule);
-
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
+                                                    Key,
+                                                    KeyLength);
+
+    HashTable_Lock(DmfModule,
+                   moduleContext,
+                   hash);
+
     ntStatus = HashTable_DataEntryFind(DmfModule,
+                                       hash,
                                        Key,
                                        KeyLength,
                                        &dataEntry);
@@ -1158,18 +3889,238 @@ Return Value:
     }
 
     RtlCopyMemory(ValueBuffer,
-                  HashTable_ValueBufferGet(dataEntry),
+                  HashTable_ValueBufferGet(moduleContext, dataEntry),
                   dataEntry->ValueLength);
 
     ntStatus = STATUS_SUCCESS;
 
+Exit:
+
+    HashTable_Unlock(DmfModule,
+                     moduleContext,
+                     hash);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_HashTable_Remove(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength
+    )
+/*++
+
+Routine Description:
+
+    Removes the entry with the specified Key from the hash table.
+    NOTE: Only tables in HashTable_Mode_OpenAddressing support this Method.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes
+
+Return Value:
+
+    STATUS_SUCCESS - The key was found and removed.
+    STATUS_NOT_FOUND - The specified key was not found in the hash table.
+    STATUS_NOT_SUPPORTED - The table is not in HashTable_Mode_OpenAddressing.
+
+--*/
+{
+    DMF_CONTEXT_HashTable* moduleContext;
+    NTSTATUS ntStatus;
+    ULONG_PTR hash;
+    HASH_TABLE_SLOTS* slotTable;
+    ULONG slotIndex;
+    ULONG entryIndex;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 HashTable);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (moduleContext->Mode != HashTable_Mode_OpenAddressing)
+    {
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto ExitNoLock;
+    }
+
+    hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
+                                                    Key,
+                                                    KeyLength);
+
+    DMF_ModuleLock(DmfModule);
+
+    HashTable_MigrationStep(DmfModule,
+                            moduleContext);
+
+    if (! HashTable_SlotFind(moduleContext,
+                             (ULONG)hash,
+                             Key,
+                             KeyLength,
+                             &slotTable,
+                             &slotIndex))
+    {
+        ntStatus = STATUS_NOT_FOUND;
+        goto Exit;
+    }
+
+    entryIndex = slotTable->Slots[slotIndex].EntryIndex;
+    HashTable_SlotTableRemove(slotTable,
+                              slotIndex);
+    HashTable_DataEntryFree(DmfModule,
+                            moduleContext,
+                            entryIndex);
+
+    ntStatus = STATUS_SUCCESS;
+
 Exit:
 
     DMF_ModuleUnlock(DmfModule);
 
+ExitNoLock:
+
     return ntStatus;
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_HashTable_StatisticsGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ HashTable_Statistics* Statistics
+    )
+/*++
+
+Routine Description:
+
+    Reports how full the hash table is, how long its collision chains (or probe sequences) are
+    and how many lookups found their Key. The whole table is examined while it is locked so
+    this Method should not be called on a hot path.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Statistics - Receives the statistics.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_HashTable* moduleContext;
+    ULONGLONG chainLengthTotal;
+    ULONG counterCount;
+    ULONG counterIndex;
+    ULONG bucketIndex;
+    ULONG entryIndex;
+    ULONG chainLength;
+    ULONG stripeIndex;
+    DATA_ENTRY* dataEntry;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 HashTable);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    RtlZeroMemory(Statistics,
+                  sizeof(HashTable_Statistics));
+    chainLengthTotal = 0;
+
+    if (moduleContext->LockStripeCount != 0)
+    {
+        // Acquire the stripes in ascending order. Batch Methods also hold several stripes, and
+        // they acquire them in the same order, so this cannot deadlock with them.
+        //
+        for (stripeIndex = 0; stripeIndex < moduleContext->LockStripeCount; stripeIndex++)
+        {
+            WdfSpinLockAcquire(moduleContext->LockStripes[stripeIndex]);
+        }
+    }
+    else
+    {
+        DMF_ModuleLock(DmfModule);
+    }
+
+    if (moduleContext->Mode == HashTable_Mode_OpenAddressing)
+    {
+        // While the table is resized, entries are in both slot tables.
+        //
+        HashTable_SlotTableStatisticsAdd(&moduleContext->SlotTablePrevious,
+                                         Statistics,
+                                         &chainLengthTotal);
+        HashTable_SlotTableStatisticsAdd(&moduleContext->SlotTableCurrent,
+                                         Statistics,
+                                         &chainLengthTotal);
+        Statistics->EntryCapacity = moduleContext->DataEntryCapacity;
+        Statistics->BucketCount = moduleContext->SlotTableCurrent.SlotCount;
+    }
+    else
+    {
+        for (bucketIndex = 0; bucketIndex < moduleContext->HashMapSize; bucketIndex++)
+        {
+            entryIndex = moduleContext->HashMap[bucketIndex];
+            if (INVALID_INDEX == entryIndex)
+            {
+                continue;
+            }
+
+            // Finding the Nth entry of a chain examines N entries.
+            //
+            chainLength = 0;
+            while (entryIndex != INVALID_INDEX)
+            {
+                chainLength++;
+                chainLengthTotal += chainLength;
+                dataEntry = HashTable_IndexToDataEntry(moduleContext,
+                                                       entryIndex);
+                entryIndex = dataEntry->NextEntryIndex;
+            }
+
+            Statistics->BucketsUsed++;
+            Statistics->EntryCount += chainLength;
+            Statistics->MaximumChainLength = max(Statistics->MaximumChainLength,
+                                                 chainLength);
+        }
+        Statistics->EntryCapacity = moduleContext->DataTableSize;
+        Statistics->BucketCount = moduleContext->HashMapSize;
+    }
+
+    counterCount = max(moduleContext->LockStripeCount, 1);
+    for (counterIndex = 0; counterIndex < counterCount; counterIndex++)
+    {
+        Statistics->LookupHitCount += moduleContext->Counters[counterIndex].LookupHitCount;
+        Statistics->LookupMissCount += moduleContext->Counters[counterIndex].LookupMissCount;
+        Statistics->TableFullCount += moduleContext->Counters[counterIndex].TableFullCount;
+    }
+
+    if (moduleContext->LockStripeCount != 0)
+    {
+        for (stripeIndex = moduleContext->LockStripeCount; stripeIndex > 0; stripeIndex--)
+        {
+            WdfSpinLockRelease(moduleContext->LockStripes[stripeIndex - 1]);
+        }
+    }
+    else
+    {
+        DMF_ModuleUnlock(DmfModule);
+    }
+
+    if (Statistics->BucketCount != 0)
+    {
+        Statistics->LoadFactorPercent = (ULONG)(((ULONGLONG)Statistics->EntryCount * 100) / Statistics->BucketCount);
+    }
+    if (Statistics->EntryCount != 0)
+    {
+        Statistics->AverageChainLengthHundredths = (ULONG)((chainLengthTotal * 100) / Statistics->EntryCount);
+    }
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -1204,14 +4155,21 @@ Return Value:
     DMF_CONTEXT_HashTable* moduleContext;
     NTSTATUS ntStatus;
     DATA_ENTRY* dataEntry;
+    ULONG_PTR hash;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  HashTable);
 
-    DMF_ModuleLock(DmfModule);
-
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
+                                                    Key,
+                                                    KeyLength);
+
+    HashTable_Lock(DmfModule,
+                   moduleContext,
+                   hash);
+
     DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
 
     if (ValueLength > moduleContext->MaximumValueLength)
@@ -1222,8 +4180,10 @@ Return Value:
     }
 
     ntStatus = HashTable_DataEntryFindOrAllocate(DmfModule,
+                                                 hash,
                                                  Key,
                                                  KeyLength,
+                                                 ValueLength,
                                                  &dataEntry);
     if (! NT_SUCCESS(ntStatus))
     {
@@ -1231,16 +4191,57 @@ Return Value:
     }
 
     dataEntry->ValueLength = ValueLength;
-    RtlCopyMemory(HashTable_ValueBufferGet(dataEntry), Value, ValueLength);
+    RtlCopyMemory(HashTable_ValueBufferGet(moduleContext, dataEntry), Value, ValueLength);
 
     ntStatus = STATUS_SUCCESS;
 
 Exit:
 
-    DMF_ModuleUnlock(DmfModule);
+    HashTable_Unlock(DmfModule,
+                     moduleContext,
+                     hash);
 
     return ntStatus;
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_HashTable_WriteBatch(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(ItemCount) HashTable_BatchItem* Items,
+    _In_ ULONG ItemCount
+    )
+/*++
+
+Routine Description:
+
+    Writes a batch of Key-Value pairs to the hash table. The table is locked once for up to 64 Keys
+    and the cache lines of all the Keys are prefetched before any Key is looked up.
+    If an element with a specified key already exists - its value will be updated.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Items - The Key-Value pairs to write. NtStatus of each item receives the result for that Key.
+            ValueBufferLength is not used.
+    ItemCount - Number of entries in Items.
+
+Return Value:
+
+    STATUS_SUCCESS if every Key-Value pair was written. Otherwise, the result of the first pair
+    that was not written.
+
+--*/
+{
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 HashTable);
+
+    return HashTable_BatchProcess(DmfModule,
+                                  Items,
+                                  ItemCount,
+                                  TRUE);
+}
+
 // eof: Dmf_HashTable.c
 //
@@ -72,6 +72,113 @@ EVT_DMF_HashTable_Enumerate(_In_ DMFMODULE DmfModule,
                             _In_ ULONG ValueLength,
                             _In_ VOID* CallbackContext);
 
+// Built-in hashing algorithms. Used when EvtHashTableHashCalculate is NULL.
+//
+typedef enum
+{
+    // FNV-1a. Processes one byte per step. This is the default algorithm.
+    //
+    HashTable_HashAlgorithm_Fnv1a = 0,
+    // Processes 32 bytes per step using four independent 64-bit lanes, then
+    // 8 bytes per step. Faster than FNV-1a for keys longer than a few bytes.
+    //
+    HashTable_HashAlgorithm_WordAtATime,
+    HashTable_HashAlgorithm_Maximum
+} HashTable_HashAlgorithmType;
+
+// Table organization.
+//
+typedef enum
+{
+    // Fixed size table. Collisions are chained. Entries cannot be removed.
+    // This is the default mode.
+    //
+    HashTable_Mode_Chained = 0,
+    // Open addressing (Robin Hood) table. The table grows as needed and entries can be removed.
+    //
+    HashTable_Mode_OpenAddressing,
+    HashTable_Mode_Maximum
+} HashTable_ModeType;
+
+// How Key and Value data is stored.
+//
+typedef enum
+{
+    // Every entry reserves MaximumKeyLength + MaximumValueLength bytes. This is the default.
+    //
+    HashTable_Storage_Fixed = 0,
+    // Every entry reserves InlineDataLength bytes. Key-Value pairs that do not fit are stored
+    // in separately allocated blocks sized to the actual Key and Value lengths.
+    //
+    HashTable_Storage_Compact,
+    HashTable_Storage_Maximum
+} HashTable_StorageType;
+
+// Describes one Key of a batch passed to DMF_HashTable_FindBatch() or DMF_HashTable_WriteBatch().
+//
+typedef struct
+{
+    // Address of the buffer containing Key data.
+    //
+    UCHAR* Key;
+    // Length of Key data in bytes.
+    //
+    ULONG KeyLength;
+    // DMF_HashTable_FindBatch: Buffer that receives the Value.
+    // DMF_HashTable_WriteBatch: Value to write.
+    //
+    UCHAR* Value;
+    // DMF_HashTable_FindBatch only. Size of the buffer pointed to by Value in bytes.
+    //
+    ULONG ValueBufferLength;
+    // DMF_HashTable_FindBatch: Receives the length of the Value (or the required buffer length).
+    // DMF_HashTable_WriteBatch: Length of Value data in bytes.
+    //
+    ULONG ValueLength;
+    // Receives the result for this Key.
+    //
+    NTSTATUS NtStatus;
+} HashTable_BatchItem;
+
+// Statistics reported by DMF_HashTable_StatisticsGet().
+//
+typedef struct
+{
+    // Number of Key-Value pairs in the table.
+    //
+    ULONG EntryCount;
+    // Number of Key-Value pairs the table can hold. In HashTable_Mode_OpenAddressing, the
+    // number that can be held before more memory is allocated.
+    //
+    ULONG EntryCapacity;
+    // Number of buckets (HashTable_Mode_Chained) or slots (HashTable_Mode_OpenAddressing).
+    //
+    ULONG BucketCount;
+    // Number of buckets that hold at least one entry (or slots holding an entry in its home slot).
+    //
+    ULONG BucketsUsed;
+    // EntryCount * 100 / BucketCount.
+    //
+    ULONG LoadFactorPercent;
+    // Largest number of entries examined to find a Key that is in the table: the length of the
+    // longest chain (HashTable_Mode_Chained) or the longest probe sequence (HashTable_Mode_OpenAddressing).
+    //
+    ULONG MaximumChainLength;
+    // Average number of entries examined to find a Key that is in the table, in hundredths.
+    // 100 means every Key is found in the first entry examined.
+    //
+    ULONG AverageChainLengthHundredths;
+    // Number of lookups that found the Key.
+    //
+    ULONGLONG LookupHitCount;
+    // Number of lookups that did not find the Key (including Keys that were then added).
+    //
+    ULONGLONG LookupMissCount;
+    // Number of Keys that could not be added because the table was full.
+    //
+    ULONGLONG TableFullCount;
+} HashTable_Statistics;
+
 // Client uses this structure to configure the Module specific parameters.
 //
 typedef struct
@@ -91,6 +198,37 @@ typedef struct
     // A callback to customize hashing algorithm.
     //
     EVT_DMF_HashTable_HashCalculate* EvtHashTableHashCalculate;
+
+    // Built-in hashing algorithm used when EvtHashTableHashCalculate is NULL.
+    //
+    HashTable_HashAlgorithmType HashAlgorithm;
+
+    // Table organization. In HashTable_Mode_OpenAddressing, MaximumTableSize is the
+    // initial number of entries and the table grows beyond it as needed.
+    //
+    HashTable_ModeType Mode;
+
+    // HashTable_Mode_Chained only. Number of locks that protect the table. Zero (default) means
+    // the Module lock protects the whole table. Otherwise, the buckets are partitioned into this
+    // many stripes, each protected by its own lock, so that operations on keys in different
+    // stripes run concurrently.
+    //
+    ULONG LockStripeCount;
+
+    // Used only when LockStripeCount is not zero. If TRUE, DMF_HashTable_Enumerate holds all the
+    // stripe locks for the whole enumeration so that the callback sees a consistent snapshot of
+    // the table. Otherwise, one stripe is locked at a time.
+    //
+    BOOLEAN EnumerateSnapshot;
+
+    // How Key and Value data is stored.
+    //
+    HashTable_StorageType Storage;
+
+    // HashTable_Storage_Compact only. Number of bytes of Key and Value data stored in each entry.
+    // Zero selects a default of 32 bytes.
+    //
+    ULONG InlineDataLength;
 } DMF_CONFIG_HashTable;
 
 // This macro declares the following functions:
@@ -121,6 +259,15 @@ DMF_HashTable_Find(
     _In_ EVT_DMF_HashTable_Find* CallbackFind
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_HashTable_FindBatch(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(ItemCount) HashTable_BatchItem* Items,
+    _In_ ULONG ItemCount
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -132,6 +279,14 @@ DMF_HashTable_FindEx(
     _In_ VOID* CallbackContext
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONG_PTR
+DMF_HashTable_HashCalculate(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -144,6 +299,22 @@ DMF_HashTable_Read(
     _Out_opt_ ULONG* ValueLength
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_HashTable_Remove(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_HashTable_StatisticsGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ HashTable_Statistics* Statistics
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -155,5 +326,14 @@ DMF_HashTable_Write(
     _In_ ULONG ValueLength
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_HashTable_WriteBatch(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(ItemCount) HashTable_BatchItem* Items,
+    _In_ ULONG ItemCount
+    );
+
 // eof: Dmf_HashTable.h
 //
@@ -35,10 +35,36 @@ Environment:
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+typedef enum
+{
+    // Caller does not wait for the work to be done.
+    //
+    QueuedWorkItem_WaitState_NotWaited = 0,
+    // Caller waits for the work to be done.
+    //
+    QueuedWorkItem_WaitState_Waiting,
+    // The work is done and the buffer has been handed back to the caller that waits.
+    //
+    QueuedWorkItem_WaitState_Completed,
+    // Caller no longer waits because the work could not be scheduled.
+    //
+    QueuedWorkItem_WaitState_Abandoned
+} QueuedWorkItem_WaitStateType;
+
 typedef struct
 {
-    DMF_PORTABLE_EVENT* Event;
-    NTSTATUS* NtStatus;
+    // One of QueuedWorkItem_WaitStateType. It is changed using interlocked operations
+    // because both the caller and the workitem may change it at the same time.
+    //
+    volatile LONG WaitState;
+    // Status of the work read by the caller that waits.
+    //
+    NTSTATUS NtStatus;
+    // Signaled when the work is done if the caller waits. It is on the stack of the caller
+    // so that nothing is allocated for each call. (It is not embedded in the buffer because
+    // the buffers may be allocated from paged pool and it must be in nonpaged memory.)
+    //
+    DMF_PORTABLE_COMPLETION* Completion;
 } QUEUEDWORKITEM_WAIT_BLOCK;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -85,7 +111,7 @@ QueuedWorkItem_WaitBlockFromClientBufferWithMetadata(
 Routine Description:
 
     Given a Client buffer with meta data, retrieve the corresponding wait block
-    which contains the event and address of NTSTATUS buffer.
+    which contains the completion and NTSTATUS of the work.
 
 Arguments:
 
@@ -142,7 +168,7 @@ QueuedWorkItem_WaitBlockFromClientBuffer(
 Routine Description:
 
     Given a Client buffer, retrieve the corresponding wait block which contains
-    the event and address of NTSTATUS buffer.
+    the completion and NTSTATUS of the work.
 
 Arguments:
 
@@ -230,15 +256,22 @@ Return Value:
                                                                                  clientBufferContext);
 
     QUEUEDWORKITEM_WAIT_BLOCK* queuedWorkItemWaitBlock = QueuedWorkItem_WaitBlockFromClientBufferWithMetadata(clientBufferWithMetadata);
-    if (queuedWorkItemWaitBlock->Event)
+    if (QueuedWorkItem_WaitState_Waiting == InterlockedCompareExchange(&queuedWorkItemWaitBlock->WaitState,
+                                                                       QueuedWorkItem_WaitState_Completed,
+                                                                       QueuedWorkItem_WaitState_Waiting))
     {
-        DMF_Portable_EventSet(queuedWorkItemWaitBlock->Event);
+        // Wake up the caller. From then on, the caller owns the buffer and adds it back
+        // to empty buffer list after reading the NTSTATUS.
+        //
+        DMF_Portable_Completion_Signal(queuedWorkItemWaitBlock->Completion);
+    }
+    else
+    {
+        // Add the used client buffer back to empty buffer list.
+        //
+        DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueue,
+                              clientBufferWithMetadata);
     }
-
-    // Add the used client buffer back to empty buffer list.
-    //
-    DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueue,
-                          clientBufferWithMetadata);
 
 Exit:
 
@@ -479,7 +512,7 @@ Return Value:
     //
     clientBuffer = QueuedWorkItem_ClientBufferFromClientBufferWithMetadata(clientBufferWithMetadata);
 
-    // This call is asynchronous. Clear the event.
+    // This call is asynchronous. Clear the wait block.
     //
     QUEUEDWORKITEM_WAIT_BLOCK* queuedWorkItemWaitBlock = QueuedWorkItem_WaitBlockFromClientBufferWithMetadata(clientBufferWithMetadata);
     RtlZeroMemory(queuedWorkItemWaitBlock,
@@ -563,9 +596,9 @@ Return Value:
     UCHAR* clientBufferWithMetadata;
     UCHAR* clientBuffer;
     VOID* clientBufferContext;
-    DMF_PORTABLE_EVENT event;
-    NTSTATUS ntStatusCall;
-    BOOLEAN eventCreated;
+    QUEUEDWORKITEM_WAIT_BLOCK* queuedWorkItemWaitBlock;
+    DMF_PORTABLE_COMPLETION completion;
+    LONG waitState;
 
     PAGED_CODE();
 
@@ -578,8 +611,6 @@ Return Value:
 
     moduleConfig = DMF_CONFIG_GET(DmfModule);
 
-    eventCreated = FALSE;
-
     // Get an empty buffer to place parameters for this call.
     //
     ntStatus = DMF_BufferQueue_Fetch(moduleContext->DmfModuleBufferQueue,
@@ -604,25 +635,15 @@ Return Value:
                   ContextBuffer,
                   ContextBufferSize);
 
-    QUEUEDWORKITEM_WAIT_BLOCK* queuedWorkItemWaitBlock = QueuedWorkItem_WaitBlockFromClientBufferWithMetadata(clientBufferWithMetadata);
-
-    ntStatus = DMF_Portable_EventCreate(&event,
-                                        NotificationEvent,
-                                        FALSE);
-    if (! NT_SUCCESS(ntStatus))
-    {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Portable_EventCreate fails: ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
-    }
-
-    eventCreated = TRUE;
+    queuedWorkItemWaitBlock = QueuedWorkItem_WaitBlockFromClientBufferWithMetadata(clientBufferWithMetadata);
 
     // Default to STATUS_SUCCESS. Let the callback override using
     // DMF_QueuedWorkItem_StatusSet() if desired.
     //
-    ntStatusCall = STATUS_SUCCESS;
-    queuedWorkItemWaitBlock->Event = &event;
-    queuedWorkItemWaitBlock->NtStatus = &ntStatusCall;
+    queuedWorkItemWaitBlock->NtStatus = STATUS_SUCCESS;
+    queuedWorkItemWaitBlock->WaitState = QueuedWorkItem_WaitState_Waiting;
+    DMF_Portable_Completion_Initialize(&completion);
+    queuedWorkItemWaitBlock->Completion = &completion;
 
     // Add to pending work list.
     //
@@ -636,25 +657,36 @@ Return Value:
     if (! NT_SUCCESS(ntStatus))
     {
         TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ScheduledTask_ExecuteNowDeferred fails: ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
+        // Stop waiting. If the workitem executes the work later, it adds the buffer back
+        // to empty buffer list because this thread no longer owns it.
+        //
+        waitState = InterlockedCompareExchange(&queuedWorkItemWaitBlock->WaitState,
+                                               QueuedWorkItem_WaitState_Abandoned,
+                                               QueuedWorkItem_WaitState_Waiting);
+        if (QueuedWorkItem_WaitState_Waiting == waitState)
+        {
+            goto Exit;
+        }
+
+        // The work has already been done by a previously scheduled workitem.
+        //
+        DmfAssert(QueuedWorkItem_WaitState_Completed == waitState);
     }
 
-     // Wait for the work to execute.
-     //
-    DMF_Portable_EventWaitForSingleObject(&event,
-                                          NULL,
-                                          FALSE);
+    // Wait for the work to execute.
+    //
+    DMF_Portable_Completion_Wait(&completion);
 
     // Return the NTSTATUS set by the callback.
     //
-    ntStatus = ntStatusCall;
+    ntStatus = queuedWorkItemWaitBlock->NtStatus;
 
-Exit:
+    // The buffer has been handed back to this thread. Add it back to empty buffer list.
+    //
+    DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueue,
+                          clientBufferWithMetadata);
 
-    if (eventCreated == TRUE)
-    {
-        DMF_Portable_EventClose(&event);
-    }
+Exit:
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
@@ -738,10 +770,9 @@ Return Value:
 
     queuedWorkItemWaitBlock = QueuedWorkItem_WaitBlockFromClientBuffer(ClientBuffer);
 
-    if (queuedWorkItemWaitBlock->NtStatus != NULL)
-    {
-        *(queuedWorkItemWaitBlock->NtStatus) = NtStatus;
-    }
+    // NOTE: It is only read if the caller waits.
+    //
+    queuedWorkItemWaitBlock->NtStatus = NtStatus;
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -35,6 +35,95 @@ Environment:
 
 typedef DECLSPEC_ALIGN(32) PLONG PLONG_A32;
 
+// Free running index owned by either the producer or the consumer of a
+// RingBuffer_Synchronization_SingleProducerSingleConsumer Ring Buffer.
+// Each one fills a cache line so that the producer and the consumer do not
+// invalidate each other's cache line every time they move their own index.
+//
+typedef struct
+{
+    // Index of the next item the owner writes (producer) or reads (consumer).
+    // Only the owner writes it.
+    //
+    volatile LONG Index;
+    // The other side's Index as last observed by the owner. The other side's cache line
+    // is only read when this value indicates the Ring Buffer is full (producer) or
+    // empty (consumer).
+    //
+    ULONG OtherIndexCached;
+    UCHAR Padding[SYSTEM_CACHE_ALIGNMENT_SIZE - sizeof(LONG) - sizeof(ULONG)];
+} RING_BUFFER_INDEX;
+
+// Free running sequence number of the next item written to a
+// RingBuffer_Synchronization_MultipleProducerOverwrite Ring Buffer. Every writer increments it,
+// so it fills a cache line so that writers do not invalidate the cache line of other fields.
+//
+typedef struct
+{
+    volatile LONG64 Next;
+    UCHAR Padding[SYSTEM_CACHE_ALIGNMENT_SIZE - sizeof(LONG64)];
+} RING_BUFFER_SEQUENCE;
+
+// Each item of a RingBuffer_Synchronization_MultipleProducerOverwrite Ring Buffer has a stamp
+// that contains the sequence number of the item in that slot and the state of that item.
+// A stamp of zero means nothing has been written to the slot. Stamps only increase, so a
+// writer can tell if a newer item has claimed the slot and a reader can tell if an item
+// is still being written (stamp is less than the item's complete stamp) or was torn or
+// overwritten (stamp is greater than the item's complete stamp).
+//
+#define RING_BUFFER_STAMP_WRITING       (1)
+#define RING_BUFFER_STAMP_COMPLETE      (2)
+#define RING_BUFFER_STAMP_TORN          (3)
+#define RING_BUFFER_STAMP_STATE_MASK    (3)
+#define RING_BUFFER_STAMP(Sequence, State)      ((LONG64)(((ULONGLONG)(Sequence) << 2) | (State)))
+
+// Header that precedes each item when items have variable size.
+//
+typedef struct
+{
+    // Size in bytes of the item's data that follows this header.
+    //
+    ULONG Size;
+    // Indicates that the data that follows this header is padding rather than an item.
+    // Padding fills the end of the Ring Buffer when the next item does not fit there.
+    //
+    ULONG IsPadding;
+} RING_BUFFER_RECORD_HEADER;
+
+// Alignment of each header (and the item's data after it) when items have variable size.
+//
+#define RING_BUFFER_RECORD_ALIGNMENT    sizeof(ULONGLONG)
+
+// Size of the buffer on the stack used to move bytes when items are rotated in place.
+//
+#define RING_BUFFER_ROTATE_BUFFER_SIZE  (256)
+
+// Indicates there is no item in a key index bucket or chain.
+//
+#define RING_BUFFER_KEY_INDEX_NONE      ((ULONG)-1)
+
+// A bucket of the key index. Items with the same key hash are chained from oldest (First)
+// to newest (Last). Items are always removed oldest first, so an item that is removed is
+// always First in its bucket.
+//
+typedef struct
+{
+    ULONG First;
+    ULONG Last;
+} RING_BUFFER_KEY_BUCKET;
+
+// Key index information for each item slot.
+//
+typedef struct
+{
+    // Next newer item in the same bucket.
+    //
+    ULONG Next;
+    // Bucket that contains the item or RING_BUFFER_KEY_INDEX_NONE if the slot is not indexed.
+    //
+    ULONG Bucket;
+} RING_BUFFER_KEY_ENTRY;
+
 typedef struct
 {
     // Memory handle or memory that store the item data.
@@ -67,6 +156,68 @@ typedef struct
     // Items present in Ring Buffer.
     //
     ULONG ItemsPresentCount;
+    // Item handed to the Client by DMF_RingBuffer_WriteReserve() that has not been committed yet.
+    //
+    UCHAR* ReservedItem;
+    // Item (or header of the variable size item) handed to the Client by DMF_RingBuffer_ReadPeek()
+    // that has not been released yet.
+    //
+    UCHAR* PeekedItem;
+    // Indicates how access to the Ring Buffer is synchronized.
+    //
+    RingBuffer_SynchronizationType Synchronization;
+    // Indicates each item is stored as a RING_BUFFER_RECORD_HEADER followed by only as many
+    // bytes as were written. ItemSize is then the maximum size of an item.
+    //
+    BOOLEAN VariableSizeItems;
+    // Number of bytes used by items and padding. (VariableSizeItems only.)
+    //
+    ULONG UsedBytes;
+    // (ItemsCount - 1). Converts a free running index to an item index.
+    // (RingBuffer_Synchronization_SingleProducerSingleConsumer and
+    //  RingBuffer_Synchronization_MultipleProducerOverwrite only.)
+    //
+    ULONG IndexMask;
+    // Offset and size in bytes of the key of each item. KeySize is zero if there is no key index.
+    // (RingBuffer_Synchronization_Lock with fixed size items only.)
+    //
+    ULONG KeyOffset;
+    ULONG KeySize;
+    // (Number of buckets - 1). Converts a key hash to a bucket.
+    //
+    ULONG KeyBucketMask;
+    // Memory that stores the key index buckets followed by the key index entry of each item.
+    //
+    WDFMEMORY MemoryKeyIndex;
+    RING_BUFFER_KEY_BUCKET* KeyBuckets;
+    RING_BUFFER_KEY_ENTRY* KeyEntries;
+    // Keeps the indexes below off the cache line of the fields above.
+    //
+    UCHAR Padding[SYSTEM_CACHE_ALIGNMENT_SIZE];
+    // Replace ReadPointer/WritePointer/ItemsPresentCount.
+    // (RingBuffer_Synchronization_SingleProducerSingleConsumer only.)
+    //
+    RING_BUFFER_INDEX Consumer;
+    RING_BUFFER_INDEX Producer;
+    // Sequence number of the next item written.
+    // (RingBuffer_Synchronization_MultipleProducerOverwrite only.)
+    //
+    RING_BUFFER_SEQUENCE WriteSequence;
+    // Sequence number of the oldest item not yet read by DMF_RingBuffer_ReadAll().
+    // Only used while the Module is locked. (RingBuffer_Synchronization_MultipleProducerOverwrite only.)
+    //
+    ULONGLONG ReadSequence;
+    // Stamp of each item. See RING_BUFFER_STAMP.
+    // (RingBuffer_Synchronization_MultipleProducerOverwrite only.)
+    //
+    WDFMEMORY MemoryStamps;
+    volatile LONG64* Stamps;
+    // Number of writers writing to each item. A writer that was lapped by a newer writer
+    // may still be writing after the newer item is complete, so readers use this to make
+    // sure no writer wrote to an item while it was copied. Stored after Stamps.
+    // (RingBuffer_Synchronization_MultipleProducerOverwrite only.)
+    //
+    volatile LONG* StampWriters;
 } RING_BUFFER;
 
 typedef struct
@@ -116,22 +267,63 @@ DMF_MODULE_DECLARE_CONFIG(RingBuffer)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+RingBuffer_KeyBucketGet(
+    _In_ RING_BUFFER* RingBuffer,
+    _In_reads_(RingBuffer->KeySize) UCHAR* Key
+    )
+/*++
+
+Routine Description:
+
+    Calculates the FNV-1a hash of a key and returns the key index bucket it belongs to.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Key - The key. It is KeySize bytes long.
+
+Return Value:
+
+    Index of the bucket.
+
+--*/
+{
+    ULONG hash;
+    ULONG keyIndex;
+
+    hash = 2166136261U;
+    for (keyIndex = 0; keyIndex < RingBuffer->KeySize; keyIndex++)
+    {
+        hash ^= (ULONG)Key[keyIndex];
+        hash *= 16777619U;
+    }
+
+    return hash & RingBuffer->KeyBucketMask;
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 static
 VOID
-RingBuffer_ReadPointerIncrement(
-    _Inout_ RING_BUFFER* RingBuffer
+RingBuffer_KeyIndexInsert(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_ ULONG ItemIndex,
+    _In_ ULONG ItemCount
     )
 /*++
 
 Routine Description:
 
-    Increment the Read Pointer, properly wrapping around when necessary. Incrementing the Read Pointer happens
-    from two different locations.
+    Adds consecutive items that have just been written to the key index. The items must be
+    newer than all items already in the key index.
 
 Arguments:
 
     RingBuffer - The Ring Buffer management data.
+    ItemIndex - Index of the first item to add.
+    ItemCount - Number of items to add.
 
 Return Value:
 
@@ -139,52 +331,73 @@ Return Value:
 
 --*/
 {
-    DmfAssert(RingBuffer != NULL);
-    DmfAssert(RingBuffer->ItemSize > 0);
+    RING_BUFFER_KEY_BUCKET* bucket;
+    ULONG bucketIndex;
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE,
-                "ReadPointer=%d", (LONG)((RingBuffer->ReadPointer - RingBuffer->Items) / RingBuffer->ItemSize));
+    if (0 == RingBuffer->KeySize)
+    {
+        goto Exit;
+    }
 
-    RingBuffer->ReadPointer += RingBuffer->ItemSize;
-    DmfAssert(RingBuffer->ReadPointer <= RingBuffer->BufferEnd);
-    DmfAssert(RingBuffer->ReadPointer >= RingBuffer->Items);
-    if (RingBuffer->ReadPointer == RingBuffer->BufferEnd)
+    DmfAssert(ItemIndex < RingBuffer->ItemsCount);
+    DmfAssert(ItemCount <= RingBuffer->ItemsCount);
+
+    while (ItemCount > 0)
     {
-        RingBuffer->ReadPointer = RingBuffer->Items;
-        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Wrap Read RingBuffer->ReadPointer");
+        DmfAssert(RING_BUFFER_KEY_INDEX_NONE == RingBuffer->KeyEntries[ItemIndex].Bucket);
+
+        bucketIndex = RingBuffer_KeyBucketGet(RingBuffer,
+                                              RingBuffer->Items + ((size_t)ItemIndex * (size_t)RingBuffer->ItemSize) + RingBuffer->KeyOffset);
+        bucket = &RingBuffer->KeyBuckets[bucketIndex];
+
+        // Append the item so that each bucket stays ordered from oldest to newest.
+        //
+        RingBuffer->KeyEntries[ItemIndex].Next = RING_BUFFER_KEY_INDEX_NONE;
+        RingBuffer->KeyEntries[ItemIndex].Bucket = bucketIndex;
+        if (RING_BUFFER_KEY_INDEX_NONE == bucket->Last)
+        {
+            bucket->First = ItemIndex;
+        }
+        else
+        {
+            RingBuffer->KeyEntries[bucket->Last].Next = ItemIndex;
+        }
+        bucket->Last = ItemIndex;
+
+        ItemIndex++;
+        if (ItemIndex == RingBuffer->ItemsCount)
+        {
+            ItemIndex = 0;
+        }
+        ItemCount--;
     }
 
-    // An item has been read. There is now one less item.
-    //
-    RingBuffer->ItemsPresentCount--;
-    DmfAssert(RingBuffer->ItemsPresentCount < RingBuffer->ItemsCount);
-}
+Exit:
 
-// Callback that allows client to copy into the Ring Buffer item in a way that
-// the client wants (not just full buffer overwrite).
-//
-typedef void (*RingBuffer_ItemProcessCallbackType)(_Inout_ VOID* Context,
-                                                   _Inout_updates_(BufferSize) UCHAR* Buffer,
-                                                   _In_ ULONG BufferSize);
+    return;
+}
 
-void
-RingBuffer_ItemProcessCallbackRead(
-    _Inout_ VOID* Context,
-    _Inout_updates_(ItemSize) UCHAR* Item,
-    _In_ ULONG ItemSize
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_KeyIndexRemove(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_ ULONG ItemIndex,
+    _In_ ULONG ItemCount
     )
 /*++
 
 Routine Description:
 
-    Read a certain number of bytes from the Ring Buffer entry. This callback is basically
-    the same as RtlCopyMemory (default callback).
+    Removes consecutive items that are the oldest items in the Ring Buffer from the key index.
+    The bucket of each item is remembered, so this works even if the Client has changed
+    the item's key since it was written.
 
 Arguments:
 
-    Context - Caller context (target buffer).
-    Item - Address of beginning of buffer to read from.
-    ItemSize - Number of bytes to read from the buffer.
+    RingBuffer - The Ring Buffer management data.
+    ItemIndex - Index of the first item to remove.
+    ItemCount - Number of items to remove.
 
 Return Value:
 
@@ -192,32 +405,63 @@ Return Value:
 
 --*/
 {
-    UCHAR* targetBuffer;
+    RING_BUFFER_KEY_BUCKET* bucket;
+    RING_BUFFER_KEY_ENTRY* entry;
 
-    targetBuffer = (UCHAR*)Context;
-    RtlCopyMemory(targetBuffer,
-                  Item,
-                  ItemSize);
+    if (0 == RingBuffer->KeySize)
+    {
+        goto Exit;
+    }
+
+    DmfAssert(ItemIndex < RingBuffer->ItemsCount);
+    DmfAssert(ItemCount <= RingBuffer->ItemsCount);
+
+    while (ItemCount > 0)
+    {
+        entry = &RingBuffer->KeyEntries[ItemIndex];
+        DmfAssert(entry->Bucket != RING_BUFFER_KEY_INDEX_NONE);
+        bucket = &RingBuffer->KeyBuckets[entry->Bucket];
+
+        // The oldest item is always first in its bucket.
+        //
+        DmfAssert(bucket->First == ItemIndex);
+        bucket->First = entry->Next;
+        if (RING_BUFFER_KEY_INDEX_NONE == bucket->First)
+        {
+            bucket->Last = RING_BUFFER_KEY_INDEX_NONE;
+        }
+        entry->Next = RING_BUFFER_KEY_INDEX_NONE;
+        entry->Bucket = RING_BUFFER_KEY_INDEX_NONE;
+
+        ItemIndex++;
+        if (ItemIndex == RingBuffer->ItemsCount)
+        {
+            ItemIndex = 0;
+        }
+        ItemCount--;
+    }
+
+Exit:
+
+    return;
 }
 
-void
-RingBuffer_ItemProcessCallbackWrite(
-    _Inout_ VOID* Context,
-    _Inout_updates_(ItemSize) UCHAR* Item,
-    _In_ ULONG ItemSize
-)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_KeyIndexRebuild(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
 /*++
 
 Routine Description:
 
-    Write a certain number of bytes to the Ring Buffer entry.This callback is basically
-    the same as RtlCopyMemory (default callback).
+    Empties the key index and then adds all the items present in the Ring Buffer to it.
+    This is necessary after items have been moved.
 
 Arguments:
 
-    Context - Caller context (source buffer).
-    Item - Address of beginning of buffer to write to.
-    ItemSize - Number of bytes to write to the buffer.
+    RingBuffer - The Ring Buffer management data.
 
 Return Value:
 
@@ -225,55 +469,52 @@ Return Value:
 
 --*/
 {
-    UCHAR* sourceBuffer;
+    ULONG index;
 
-    sourceBuffer = (UCHAR*)Context;
-    RtlCopyMemory(Item,
-                  sourceBuffer,
-                  ItemSize);
-}
+    if (0 == RingBuffer->KeySize)
+    {
+        goto Exit;
+    }
 
-// Context that contains a map of the data in a Ring Buffer entry.
-//
-typedef struct
-{
-    // Pointer to each segment of the buffer.
-    //
-    UCHAR** Segments;
-    // Offset for each segment.
-    //
-    ULONG* SegmentOffsets;
-    // Size of each segment.
-    //
-    ULONG* SegmentSizes;
-    // Number of segments.
-    //
-    ULONG NumberOfSegments;
-    // Data copy function.
-    //
-    RingBuffer_ItemProcessCallbackType DataCopy;
-} RingBuffer_CustomItemProcessContext;
+    for (index = 0; index <= RingBuffer->KeyBucketMask; index++)
+    {
+        RingBuffer->KeyBuckets[index].First = RING_BUFFER_KEY_INDEX_NONE;
+        RingBuffer->KeyBuckets[index].Last = RING_BUFFER_KEY_INDEX_NONE;
+    }
+    for (index = 0; index < RingBuffer->ItemsCount; index++)
+    {
+        RingBuffer->KeyEntries[index].Next = RING_BUFFER_KEY_INDEX_NONE;
+        RingBuffer->KeyEntries[index].Bucket = RING_BUFFER_KEY_INDEX_NONE;
+    }
 
-void
-RingBuffer_ItemProcessCallbackSegments(
-    _Inout_ VOID* Context,
-    _Inout_updates_(ItemSize) UCHAR* Item,
-    _In_ ULONG ItemSize
+    if (RingBuffer->ItemsPresentCount > 0)
+    {
+        RingBuffer_KeyIndexInsert(RingBuffer,
+                                  (ULONG)((RingBuffer->ReadPointer - RingBuffer->Items) / RingBuffer->ItemSize),
+                                  RingBuffer->ItemsPresentCount);
+    }
+
+Exit:
+
+    return;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_ReadPointerIncrement(
+    _Inout_ RING_BUFFER* RingBuffer
     )
 /*++
 
 Routine Description:
 
-    Read/Write from/to a Ring Buffer entry using a map that maps the contents
-    of a Ring Buffer entry. This callback receives a table of offsets and lengths
-    to direct how memory is read from the buffer. This allows the Ring Buffer to
-    have entries that contain sub buffers with headers/payloads.
+    Increment the Read Pointer, properly wrapping around when necessary. Incrementing the Read Pointer happens
+    from two different locations.
 
 Arguments:
 
-    Context - Caller context (target buffer).
-    Item - Address of beginning of buffer to read from.
-    ItemSize - Number of bytes to read from the buffer.
+    RingBuffer - The Ring Buffer management data.
 
 Return Value:
 
@@ -281,152 +522,2009 @@ Return Value:
 
 --*/
 {
-    RingBuffer_CustomItemProcessContext* writeContext;
-    ULONG bufferIndex;
+    DmfAssert(RingBuffer != NULL);
+    DmfAssert(RingBuffer->ItemSize > 0);
 
-    UNREFERENCED_PARAMETER(ItemSize);
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE,
+                "ReadPointer=%d", (LONG)((RingBuffer->ReadPointer - RingBuffer->Items) / RingBuffer->ItemSize));
 
-    writeContext = (RingBuffer_CustomItemProcessContext*)Context;
-    DmfAssert(writeContext->DataCopy != NULL);
+    RingBuffer_KeyIndexRemove(RingBuffer,
+                              (ULONG)((RingBuffer->ReadPointer - RingBuffer->Items) / RingBuffer->ItemSize),
+                              1);
 
-    for (bufferIndex = 0; bufferIndex < writeContext->NumberOfSegments; bufferIndex++)
+    RingBuffer->ReadPointer += RingBuffer->ItemSize;
+    DmfAssert(RingBuffer->ReadPointer <= RingBuffer->BufferEnd);
+    DmfAssert(RingBuffer->ReadPointer >= RingBuffer->Items);
+    if (RingBuffer->ReadPointer == RingBuffer->BufferEnd)
     {
-        // Client data buffer.
-        //
-        UCHAR* clientSegmentBuffer = writeContext->Segments[bufferIndex];
-        // Offset in the Ring Buffer entry that where data transfer happens.
-        //
-        ULONG segmentOffset = writeContext->SegmentOffsets[bufferIndex];
-        DmfAssert(segmentOffset < ItemSize);
-        // Address in Ring Buffer entry where the transfer happens.
-        //
-        UCHAR* ringBufferSegmentBuffer = &Item[segmentOffset];
-        // Size of the data transfer.
-        //
-        ULONG segmentSize = writeContext->SegmentSizes[bufferIndex];
+        RingBuffer->ReadPointer = RingBuffer->Items;
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Wrap Read RingBuffer->ReadPointer");
+    }
+
+    // An item has been read. There is now one less item.
+    //
+    RingBuffer->ItemsPresentCount--;
+    DmfAssert(RingBuffer->ItemsPresentCount < RingBuffer->ItemsCount);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_WritePointerIncrement(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Increment the Write Pointer, properly wrapping around when necessary, after an item has been
+    written at the Write Pointer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DmfAssert(RingBuffer != NULL);
+    DmfAssert(RingBuffer->ItemSize > 0);
+
+    RingBuffer_KeyIndexInsert(RingBuffer,
+                              (ULONG)((RingBuffer->WritePointer - RingBuffer->Items) / RingBuffer->ItemSize),
+                              1);
+
+    // Move the Write Pointer to the next proper location.
+    //
+    RingBuffer->WritePointer += RingBuffer->ItemSize;
+    DmfAssert(RingBuffer->WritePointer <= RingBuffer->BufferEnd);
+    DmfAssert(RingBuffer->WritePointer >= RingBuffer->Items);
+    if (RingBuffer->WritePointer == RingBuffer->BufferEnd)
+    {
+        RingBuffer->WritePointer = RingBuffer->Items;
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Wrap Read RingBuffer->WritePointer");
+    }
+
+    // An item has just been written (added), so increment the number of items in the buffer.
+    //
+    RingBuffer->ItemsPresentCount++;
+    DmfAssert(RingBuffer->ItemsPresentCount <= RingBuffer->ItemsCount);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+RingBuffer_WriteSpaceMake(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Makes sure the item at the Write Pointer can be written. If the Ring Buffer is full, either
+    fails or deletes the oldest item depending on the mode of the Ring Buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    STATUS_SUCCESS if the item at the Write Pointer can be written.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is full.
+
+--*/
+{
+    NTSTATUS ntStatus;
+
+    DmfAssert(RingBuffer->ItemsPresentCount <= RingBuffer->ItemsCount);
+
+    ntStatus = STATUS_SUCCESS;
+
+    if (RingBuffer->ItemsPresentCount == RingBuffer->ItemsCount)
+    {
+        DmfAssert(RingBuffer->ReadPointer == RingBuffer->WritePointer);
+        // It means the buffer is full.
+        //
+        if (RingBuffer->Mode == RingBuffer_Mode_FailIfFullOnWrite)
+        {
+            // Ring Buffer is Full. This is an error condition.
+            //
+            ntStatus = STATUS_UNSUCCESSFUL;
+        }
+        else if (RingBuffer->Mode == RingBuffer_Mode_DeleteOldestIfFullOnWrite)
+        {
+            // Ring Buffer is full, but it is infinite. So, just throw away the oldest pending Read
+            // to make space for this Write.
+            //
+            RingBuffer_ReadPointerIncrement(RingBuffer);
+        }
+        else
+        {
+            DmfAssert(FALSE);
+        }
+    }
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+RingBuffer_IsLockFree(
+    _In_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Indicates if the Ring Buffer is accessed without acquiring the Module lock.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    TRUE if the Ring Buffer is accessed without acquiring the Module lock.
+
+--*/
+{
+    return (RingBuffer_Synchronization_SingleProducerSingleConsumer == RingBuffer->Synchronization);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_Lock(
+    _In_ DMFMODULE DmfModule,
+    _In_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Acquires the Module lock unless the Ring Buffer is accessed without it.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (! RingBuffer_IsLockFree(RingBuffer))
+    {
+        DMF_ModuleLock(DmfModule);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_Unlock(
+    _In_ DMFMODULE DmfModule,
+    _In_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Releases the lock acquired by RingBuffer_Lock().
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (! RingBuffer_IsLockFree(RingBuffer))
+    {
+        DMF_ModuleUnlock(DmfModule);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+UCHAR*
+RingBuffer_ProducerItemGet(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Returns the address of the next item the producer writes in a
+    RingBuffer_Synchronization_SingleProducerSingleConsumer Ring Buffer.
+    Only the producer calls this function.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    Address of the item to write or NULL if the Ring Buffer is full.
+
+--*/
+{
+    ULONG writeIndex;
+
+    DmfAssert(RingBuffer_IsLockFree(RingBuffer));
+
+    // Only the producer writes its own index so it does not need to be read with a barrier.
+    //
+    writeIndex = (ULONG)RingBuffer->Producer.Index;
+    if ((writeIndex - RingBuffer->Producer.OtherIndexCached) == RingBuffer->ItemsCount)
+    {
+        // The Ring Buffer was full the last time the consumer's index was read. Read it again.
+        // Acquire semantics guarantee the consumer is done with the item before it is overwritten.
+        //
+        RingBuffer->Producer.OtherIndexCached = (ULONG)ReadAcquire(&RingBuffer->Consumer.Index);
+        if ((writeIndex - RingBuffer->Producer.OtherIndexCached) == RingBuffer->ItemsCount)
+        {
+            return NULL;
+        }
+    }
+
+    DmfAssert((writeIndex - RingBuffer->Producer.OtherIndexCached) < RingBuffer->ItemsCount);
+
+    return RingBuffer->Items + ((size_t)(writeIndex & RingBuffer->IndexMask) * (size_t)RingBuffer->ItemSize);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_ProducerItemPublish(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Makes the item returned by RingBuffer_ProducerItemGet() visible to the consumer.
+    Only the producer calls this function.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    // Release semantics guarantee the item's contents are visible before the new index.
+    //
+    WriteRelease(&RingBuffer->Producer.Index,
+                 (LONG)((ULONG)RingBuffer->Producer.Index + 1));
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+UCHAR*
+RingBuffer_ConsumerItemGet(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Returns the address of the oldest item in a RingBuffer_Synchronization_SingleProducerSingleConsumer
+    Ring Buffer. Only the consumer calls this function.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    Address of the oldest item or NULL if the Ring Buffer is empty.
+
+--*/
+{
+    ULONG readIndex;
+
+    DmfAssert(RingBuffer_IsLockFree(RingBuffer));
+
+    // Only the consumer writes its own index so it does not need to be read with a barrier.
+    //
+    readIndex = (ULONG)RingBuffer->Consumer.Index;
+    if (readIndex == RingBuffer->Consumer.OtherIndexCached)
+    {
+        // The Ring Buffer was empty the last time the producer's index was read. Read it again.
+        // Acquire semantics guarantee the item's contents are read after the producer wrote them.
+        //
+        RingBuffer->Consumer.OtherIndexCached = (ULONG)ReadAcquire(&RingBuffer->Producer.Index);
+        if (readIndex == RingBuffer->Consumer.OtherIndexCached)
+        {
+            return NULL;
+        }
+    }
+
+    DmfAssert((RingBuffer->Consumer.OtherIndexCached - readIndex) <= RingBuffer->ItemsCount);
+
+    return RingBuffer->Items + ((size_t)(readIndex & RingBuffer->IndexMask) * (size_t)RingBuffer->ItemSize);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_ConsumerItemRelease(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Removes the item returned by RingBuffer_ConsumerItemGet() so that the producer can reuse it.
+    Only the consumer calls this function.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    // Release semantics guarantee the item has been read before the producer can overwrite it.
+    //
+    WriteRelease(&RingBuffer->Consumer.Index,
+                 (LONG)((ULONG)RingBuffer->Consumer.Index + 1));
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+RingBuffer_IsMultipleProducer(
+    _In_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Indicates if any number of writers write to the Ring Buffer without acquiring the Module lock.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    TRUE if the Ring Buffer is a RingBuffer_Synchronization_MultipleProducerOverwrite Ring Buffer.
+
+--*/
+{
+    return (RingBuffer_Synchronization_MultipleProducerOverwrite == RingBuffer->Synchronization);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+UCHAR*
+RingBuffer_SequenceItemGet(
+    _In_ RING_BUFFER* RingBuffer,
+    _In_ ULONGLONG Sequence
+    )
+/*++
+
+Routine Description:
+
+    Returns the address of the slot that stores the item with the given sequence number
+    in a RingBuffer_Synchronization_MultipleProducerOverwrite Ring Buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Sequence - Sequence number of the item.
+
+Return Value:
+
+    Address of the slot.
+
+--*/
+{
+    return RingBuffer->Items + ((size_t)(Sequence & RingBuffer->IndexMask) * (size_t)RingBuffer->ItemSize);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+RingBuffer_SequenceIsComplete(
+    _In_ RING_BUFFER* RingBuffer,
+    _In_ ULONGLONG Sequence
+    )
+/*++
+
+Routine Description:
+
+    Indicates if the item with the given sequence number has been completely written and is
+    still present in a RingBuffer_Synchronization_MultipleProducerOverwrite Ring Buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Sequence - Sequence number of the item.
+
+Return Value:
+
+    TRUE if the item can be read. FALSE if it is being written, was torn or has been overwritten.
+
+--*/
+{
+    // Acquire semantics guarantee the item's contents are read after the stamp.
+    //
+    return (RING_BUFFER_STAMP(Sequence, RING_BUFFER_STAMP_COMPLETE) == 
+            ReadAcquire64(&RingBuffer->Stamps[Sequence & RingBuffer->IndexMask]));
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONGLONG
+RingBuffer_SequenceOldestGet(
+    _In_ RING_BUFFER* RingBuffer,
+    _Out_ ULONGLONG* SequenceNext
+    )
+/*++
+
+Routine Description:
+
+    Returns the range of sequence numbers of items that may be present in a
+    RingBuffer_Synchronization_MultipleProducerOverwrite Ring Buffer. The Module is locked.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    SequenceNext - Receives the sequence number of the next item that will be written.
+
+Return Value:
+
+    Sequence number of the oldest item that may be present.
+
+--*/
+{
+    ULONGLONG sequenceOldest;
+
+    *SequenceNext = (ULONGLONG)ReadAcquire64(&RingBuffer->WriteSequence.Next);
+
+    // Only the last ItemsCount items can still be present.
+    //
+    sequenceOldest = 0;
+    if (*SequenceNext > RingBuffer->ItemsCount)
+    {
+        sequenceOldest = *SequenceNext - RingBuffer->ItemsCount;
+    }
+    if (sequenceOldest < RingBuffer->ReadSequence)
+    {
+        sequenceOldest = RingBuffer->ReadSequence;
+    }
+
+    return sequenceOldest;
+}
+
+// Callback that allows client to copy into the Ring Buffer item in a way that
+// the client wants (not just full buffer overwrite).
+//
+typedef void (*RingBuffer_ItemProcessCallbackType)(_Inout_ VOID* Context,
+                                                   _Inout_updates_(BufferSize) UCHAR* Buffer,
+                                                   _In_ ULONG BufferSize);
+
+void
+RingBuffer_ItemProcessCallbackRead(
+    _Inout_ VOID* Context,
+    _Inout_updates_(ItemSize) UCHAR* Item,
+    _In_ ULONG ItemSize
+    )
+/*++
+
+Routine Description:
+
+    Read a certain number of bytes from the Ring Buffer entry. This callback is basically
+    the same as RtlCopyMemory (default callback).
+
+Arguments:
+
+    Context - Caller context (target buffer).
+    Item - Address of beginning of buffer to read from.
+    ItemSize - Number of bytes to read from the buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    UCHAR* targetBuffer;
+
+    targetBuffer = (UCHAR*)Context;
+    RtlCopyMemory(targetBuffer,
+                  Item,
+                  ItemSize);
+}
+
+void
+RingBuffer_ItemProcessCallbackWrite(
+    _Inout_ VOID* Context,
+    _Inout_updates_(ItemSize) UCHAR* Item,
+    _In_ ULONG ItemSize
+)
+/*++
+
+Routine Description:
+
+    Write a certain number of bytes to the Ring Buffer entry.This callback is basically
+    the same as RtlCopyMemory (default callback).
+
+Arguments:
+
+    Context - Caller context (source buffer).
+    Item - Address of beginning of buffer to write to.
+    ItemSize - Number of bytes to write to the buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    UCHAR* sourceBuffer;
+
+    sourceBuffer = (UCHAR*)Context;
+    RtlCopyMemory(Item,
+                  sourceBuffer,
+                  ItemSize);
+}
+
+// Context that contains a map of the data in a Ring Buffer entry.
+//
+typedef struct
+{
+    // Pointer to each segment of the buffer.
+    //
+    UCHAR** Segments;
+    // Offset for each segment.
+    //
+    ULONG* SegmentOffsets;
+    // Size of each segment.
+    //
+    ULONG* SegmentSizes;
+    // Number of segments.
+    //
+    ULONG NumberOfSegments;
+    // Data copy function.
+    //
+    RingBuffer_ItemProcessCallbackType DataCopy;
+} RingBuffer_CustomItemProcessContext;
+
+void
+RingBuffer_ItemProcessCallbackSegments(
+    _Inout_ VOID* Context,
+    _Inout_updates_(ItemSize) UCHAR* Item,
+    _In_ ULONG ItemSize
+    )
+/*++
+
+Routine Description:
+
+    Read/Write from/to a Ring Buffer entry using a map that maps the contents
+    of a Ring Buffer entry. This callback receives a table of offsets and lengths
+    to direct how memory is read from the buffer. This allows the Ring Buffer to
+    have entries that contain sub buffers with headers/payloads.
+
+Arguments:
+
+    Context - Caller context (target buffer).
+    Item - Address of beginning of buffer to read from.
+    ItemSize - Number of bytes to read from the buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    RingBuffer_CustomItemProcessContext* writeContext;
+    ULONG bufferIndex;
+
+    UNREFERENCED_PARAMETER(ItemSize);
+
+    writeContext = (RingBuffer_CustomItemProcessContext*)Context;
+    DmfAssert(writeContext->DataCopy != NULL);
+
+    for (bufferIndex = 0; bufferIndex < writeContext->NumberOfSegments; bufferIndex++)
+    {
+        // Client data buffer.
+        //
+        UCHAR* clientSegmentBuffer = writeContext->Segments[bufferIndex];
+        // Offset in the Ring Buffer entry that where data transfer happens.
+        //
+        ULONG segmentOffset = writeContext->SegmentOffsets[bufferIndex];
+        DmfAssert(segmentOffset < ItemSize);
+        // Address in Ring Buffer entry where the transfer happens.
+        //
+        UCHAR* ringBufferSegmentBuffer = &Item[segmentOffset];
+        // Size of the data transfer.
+        //
+        ULONG segmentSize = writeContext->SegmentSizes[bufferIndex];
+
+        DmfAssert(segmentSize > 0);
+        DmfAssert(segmentOffset + segmentSize <= ItemSize);
+        __analysis_assume(segmentOffset + segmentSize <= ItemSize);
+
+        // Transfer the data to/from the Ring Buffer.
+        //
+        (*writeContext->DataCopy)(clientSegmentBuffer,
+                                  ringBufferSegmentBuffer,
+                                  segmentSize);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_BytesSwap(
+    _Inout_updates_(Size) UCHAR* First,
+    _Inout_updates_(Size) UCHAR* Second,
+    _In_ size_t Size,
+    _Inout_updates_(TemporarySize) UCHAR* Temporary,
+    _In_ size_t TemporarySize
+    )
+/*++
+
+Routine Description:
+
+    Swaps the bytes of two ranges of the same size that do not overlap. The bytes are
+    moved through a temporary buffer as few large blocks.
+
+Arguments:
+
+    First - Address of the first range.
+    Second - Address of the second range.
+    Size - Size in bytes of each range.
+    Temporary - Buffer the bytes are moved through.
+    TemporarySize - Size in bytes of Temporary.
+
+Return Value:
+
+    None
+
+--*/
+{
+    size_t blockSize;
+
+    DmfAssert((First + Size <= Second) || (Second + Size <= First));
+
+    while (Size > 0)
+    {
+        blockSize = (Size < TemporarySize) ? Size : TemporarySize;
+        RtlCopyMemory(Temporary,
+                      First,
+                      blockSize);
+        RtlCopyMemory(First,
+                      Second,
+                      blockSize);
+        RtlCopyMemory(Second,
+                      Temporary,
+                      blockSize);
+        First += blockSize;
+        Second += blockSize;
+        Size -= blockSize;
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_BytesRotate(
+    _Inout_updates_(End - Start) UCHAR* Start,
+    _In_ UCHAR* Middle,
+    _In_ UCHAR* End
+    )
+/*++
+
+Routine Description:
+
+    Rotates the bytes in a given range so that the byte at Middle becomes the first byte.
+    It takes time proportional to the size of the range and only uses a small buffer on the stack.
+    The smaller of the two parts is repeatedly swapped into its final place as blocks
+    (block swap rotation). Once it fits in the buffer, the rest is done with a single move.
+
+Arguments:
+
+    Start - Address of the first byte in the range.
+    Middle - Address of the byte that becomes the first byte.
+    End - Address of the byte after the last byte in the range.
+
+Return Value:
+
+    None
+
+--*/
+{
+    UCHAR temporary[RING_BUFFER_ROTATE_BUFFER_SIZE];
+    size_t leftSize;
+    size_t rightSize;
+
+    DmfAssert((Start <= Middle) && (Middle <= End));
+
+    leftSize = Middle - Start;
+    rightSize = End - Middle;
+    while ((leftSize > 0) && (rightSize > 0))
+    {
+        if (leftSize <= sizeof(temporary))
+        {
+            // Set aside the left part, move the right part down and put the left part after it.
+            //
+            RtlCopyMemory(temporary,
+                          Start,
+                          leftSize);
+            RtlMoveMemory(Start,
+                          Middle,
+                          rightSize);
+            RtlCopyMemory(Start + rightSize,
+                          temporary,
+                          leftSize);
+            break;
+        }
+
+        if (rightSize <= sizeof(temporary))
+        {
+            // Set aside the right part, move the left part up and put the right part before it.
+            //
+            RtlCopyMemory(temporary,
+                          Middle,
+                          rightSize);
+            RtlMoveMemory(Start + rightSize,
+                          Start,
+                          leftSize);
+            RtlCopyMemory(Start,
+                          temporary,
+                          rightSize);
+            break;
+        }
+
+        if (leftSize <= rightSize)
+        {
+            // The beginning of the right part goes where the left part is. After the swap
+            // the left part is at the beginning of what remains to be rotated.
+            //
+            RingBuffer_BytesSwap(Start,
+                                 Middle,
+                                 leftSize,
+                                 temporary,
+                                 sizeof(temporary));
+            Start += leftSize;
+            Middle += leftSize;
+            rightSize -= leftSize;
+        }
+        else
+        {
+            // The end of the left part goes where the right part is. After the swap
+            // the right part is at the end of what remains to be rotated.
+            //
+            RingBuffer_BytesSwap(Middle - rightSize,
+                                 Middle,
+                                 rightSize,
+                                 temporary,
+                                 sizeof(temporary));
+            End = Middle;
+            Middle -= rightSize;
+            leftSize -= rightSize;
+        }
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+RingBuffer_RecordSize(
+    _In_ ULONG DataSize
+    )
+/*++
+
+Routine Description:
+
+    Returns the number of bytes a variable size item uses in the Ring Buffer.
+
+Arguments:
+
+    DataSize - Size in bytes of the item's data.
+
+Return Value:
+
+    Size of the item's header and data rounded up to RING_BUFFER_RECORD_ALIGNMENT.
+
+--*/
+{
+    return (ULONG)ALIGN_UP_BY((ULONG_PTR)sizeof(RING_BUFFER_RECORD_HEADER) + DataSize,
+                              RING_BUFFER_RECORD_ALIGNMENT);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+UCHAR*
+RingBuffer_RecordNext(
+    _In_ RING_BUFFER* RingBuffer,
+    _In_ UCHAR* Record
+    )
+/*++
+
+Routine Description:
+
+    Returns the address of the record (item or padding) that follows the given record,
+    properly wrapping around when necessary.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Record - The given record.
+
+Return Value:
+
+    Address of the next record.
+
+--*/
+{
+    RING_BUFFER_RECORD_HEADER* header;
+    UCHAR* nextRecord;
+
+    header = (RING_BUFFER_RECORD_HEADER*)Record;
+    nextRecord = Record + RingBuffer_RecordSize(header->Size);
+    DmfAssert(nextRecord <= RingBuffer->BufferEnd);
+    if (nextRecord == RingBuffer->BufferEnd)
+    {
+        nextRecord = RingBuffer->Items;
+    }
+
+    return nextRecord;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+UCHAR*
+RingBuffer_RecordPaddingSkip(
+    _In_ RING_BUFFER* RingBuffer,
+    _In_ UCHAR* Record
+    )
+/*++
+
+Routine Description:
+
+    Returns the address of the first item at or after the given record, skipping padding.
+    There must be at least one item at or after the given record.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Record - The given record.
+
+Return Value:
+
+    Address of the item's header.
+
+--*/
+{
+    while (((RING_BUFFER_RECORD_HEADER*)Record)->IsPadding)
+    {
+        Record = RingBuffer_RecordNext(RingBuffer,
+                                       Record);
+    }
+
+    return Record;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_RecordRemove(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Removes the oldest variable size item as well as any padding that follows it so that the
+    Read Pointer always points to an item when the Ring Buffer is not empty.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    RING_BUFFER_RECORD_HEADER* header;
+
+    DmfAssert(RingBuffer->ItemsPresentCount > 0);
+
+    do
+    {
+        header = (RING_BUFFER_RECORD_HEADER*)RingBuffer->ReadPointer;
+        DmfAssert(RingBuffer_RecordSize(header->Size) <= RingBuffer->UsedBytes);
+        RingBuffer->UsedBytes -= RingBuffer_RecordSize(header->Size);
+        RingBuffer->ReadPointer = RingBuffer_RecordNext(RingBuffer,
+                                                        RingBuffer->ReadPointer);
+    } while ((RingBuffer->UsedBytes > 0) &&
+             ((RING_BUFFER_RECORD_HEADER*)RingBuffer->ReadPointer)->IsPadding);
+
+    // An item has been read. There is now one less item.
+    //
+    RingBuffer->ItemsPresentCount--;
+    DmfAssert((RingBuffer->ItemsPresentCount > 0) == (RingBuffer->UsedBytes > 0));
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+RingBuffer_RecordWriteSpaceMake(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_ ULONG DataSize
+    )
+/*++
+
+Routine Description:
+
+    Makes sure a variable size item of the given size can be written contiguously at the Write
+    Pointer. If the item does not fit before the end of the Ring Buffer, the rest of the Ring
+    Buffer is padded and the item is written at the beginning. If there is not enough space,
+    either fails or deletes the oldest items depending on the mode of the Ring Buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    DataSize - Size in bytes of the item's data.
+
+Return Value:
+
+    STATUS_SUCCESS if the item can be written at the Write Pointer.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is full.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    ULONG recordSize;
+    ULONG bytesToEnd;
+    ULONG bytesNeeded;
+
+    recordSize = RingBuffer_RecordSize(DataSize);
+    DmfAssert(recordSize <= RingBuffer->TotalSize);
+
+    for (;;)
+    {
+        if (0 == RingBuffer->UsedBytes)
+        {
+            // Start from the beginning so that no space is lost to padding.
+            //
+            RingBuffer->ReadPointer = RingBuffer->Items;
+            RingBuffer->WritePointer = RingBuffer->Items;
+        }
+
+        bytesToEnd = (ULONG)(RingBuffer->BufferEnd - RingBuffer->WritePointer);
+        if (recordSize <= bytesToEnd)
+        {
+            bytesNeeded = recordSize;
+        }
+        else
+        {
+            bytesNeeded = bytesToEnd + recordSize;
+        }
+
+        if (bytesNeeded <= RingBuffer->TotalSize - RingBuffer->UsedBytes)
+        {
+            break;
+        }
+
+        if (RingBuffer->Mode == RingBuffer_Mode_FailIfFullOnWrite)
+        {
+            // Ring Buffer is Full. This is an error condition.
+            //
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+
+        // Throw away the oldest item to make space for this Write.
+        //
+        DmfAssert(RingBuffer->Mode == RingBuffer_Mode_DeleteOldestIfFullOnWrite);
+        RingBuffer_RecordRemove(RingBuffer);
+    }
+
+    if (bytesNeeded > recordSize)
+    {
+        RING_BUFFER_RECORD_HEADER* header;
+
+        // Pad the rest of the Ring Buffer. Headers are aligned so there is always space for one.
+        //
+        DmfAssert(bytesToEnd >= sizeof(RING_BUFFER_RECORD_HEADER));
+        header = (RING_BUFFER_RECORD_HEADER*)RingBuffer->WritePointer;
+        header->Size = bytesToEnd - sizeof(RING_BUFFER_RECORD_HEADER);
+        header->IsPadding = TRUE;
+        RingBuffer->UsedBytes += bytesToEnd;
+        RingBuffer->WritePointer = RingBuffer->Items;
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+RingBuffer_RecordWrite(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_reads_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_ RingBuffer_ItemProcessCallbackType ItemProcessCallback
+    )
+/*++
+
+Routine Description:
+
+    Write a variable size item to the Ring Buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address of data to write to the Write Pointer.
+    BufferSize - Amount of data in bytes to write to the Write Pointer.
+    ItemProcessCallback - Callback function that writes into the ring buffer entry.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    RING_BUFFER_RECORD_HEADER* header;
+
+    DmfAssert(RingBuffer->VariableSizeItems);
+
+    if ((0 == BufferSize) ||
+        (BufferSize > RingBuffer->ItemSize))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    ntStatus = RingBuffer_RecordWriteSpaceMake(RingBuffer,
+                                               BufferSize);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    header = (RING_BUFFER_RECORD_HEADER*)RingBuffer->WritePointer;
+    header->Size = BufferSize;
+    header->IsPadding = FALSE;
+
+    // Write to the Ring Buffer entry in a caller specific manner.
+    //
+    (*ItemProcessCallback)(Buffer,
+                           (UCHAR*)(header + 1),
+                           BufferSize);
+
+    RingBuffer->UsedBytes += RingBuffer_RecordSize(BufferSize);
+    RingBuffer->WritePointer = RingBuffer_RecordNext(RingBuffer,
+                                                     RingBuffer->WritePointer);
+
+    // An item has just been written (added), so increment the number of items in the buffer.
+    //
+    RingBuffer->ItemsPresentCount++;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+RingBuffer_RecordRead(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _Out_writes_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _Out_ ULONG* BytesRead
+    )
+/*++
+
+Routine Description:
+
+    Read the oldest variable size item from the Ring Buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address of buffer where the item's data is copied.
+    BufferSize - Size in bytes of Buffer.
+    BytesRead - Receives the size in bytes of the item's data.
+
+Return Value:
+
+    STATUS_SUCCESS if the item was read.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is empty.
+    STATUS_BUFFER_TOO_SMALL if the item does not fit in Buffer. The item is not removed.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    RING_BUFFER_RECORD_HEADER* header;
+
+    DmfAssert(RingBuffer->VariableSizeItems);
+
+    *BytesRead = 0;
+
+    if (0 == RingBuffer->ItemsPresentCount)
+    {
+        // There are no items in the buffer to read.
+        //
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    header = (RING_BUFFER_RECORD_HEADER*)RingBuffer->ReadPointer;
+    DmfAssert(! header->IsPadding);
+    if (header->Size > BufferSize)
+    {
+        ntStatus = STATUS_BUFFER_TOO_SMALL;
+        goto Exit;
+    }
+
+    RtlCopyMemory(Buffer,
+                  header + 1,
+                  header->Size);
+    *BytesRead = header->Size;
+
+    RingBuffer_RecordRemove(RingBuffer);
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_RecordReadAll(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _Out_writes_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _Out_ ULONG* BytesWritten
+    )
+/*++
+
+Routine Description:
+
+    Read all the variable size items from the Ring Buffer that fit in the given buffer.
+    Each item's data is preceded by a ULONG that contains the size of the item's data.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address of buffer where the items are copied.
+    BufferSize - Size in bytes of Buffer.
+    BytesWritten - Receives the number of bytes written to Buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    RING_BUFFER_RECORD_HEADER* header;
+    ULONG bytesWritten;
+
+    DmfAssert(RingBuffer->VariableSizeItems);
+
+    bytesWritten = 0;
+    while (RingBuffer->ItemsPresentCount > 0)
+    {
+        header = (RING_BUFFER_RECORD_HEADER*)RingBuffer->ReadPointer;
+        DmfAssert(! header->IsPadding);
+        if ((BufferSize - bytesWritten) < (sizeof(ULONG) + header->Size))
+        {
+            break;
+        }
+
+        RtlCopyMemory(&Buffer[bytesWritten],
+                      &header->Size,
+                      sizeof(ULONG));
+        bytesWritten += sizeof(ULONG);
+        RtlCopyMemory(&Buffer[bytesWritten],
+                      header + 1,
+                      header->Size);
+        bytesWritten += header->Size;
+
+        RingBuffer_RecordRemove(RingBuffer);
+    }
+
+    *BytesWritten = bytesWritten;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_MultipleProducerWrite(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_reads_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_ RingBuffer_ItemProcessCallbackType ItemProcessCallback
+    )
+/*++
+
+Routine Description:
+
+    Write an item to a RingBuffer_Synchronization_MultipleProducerOverwrite Ring Buffer.
+    Any number of callers may call this function concurrently. The Module is not locked.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address of data to write.
+    BufferSize - Amount of data in bytes to write.
+    ItemProcessCallback - Callback function that writes into the ring buffer entry.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONGLONG sequence;
+    volatile LONG64* stamp;
+    volatile LONG* stampWriters;
+    LONG64 stampCurrent;
+    LONG64 stampWriting;
+
+    UNREFERENCED_PARAMETER(BufferSize);
+
+    DmfAssert(RingBuffer_IsMultipleProducer(RingBuffer));
+    DmfAssert(BufferSize == RingBuffer->ItemSize);
+
+    // Claim the next slot. This is the only shared write in the common path.
+    //
+    sequence = (ULONGLONG)InterlockedIncrement64(&RingBuffer->WriteSequence.Next) - 1;
+    stamp = &RingBuffer->Stamps[sequence & RingBuffer->IndexMask];
+    stampWriters = &RingBuffer->StampWriters[sequence & RingBuffer->IndexMask];
+    stampWriting = RING_BUFFER_STAMP(sequence,
+                                     RING_BUFFER_STAMP_WRITING);
+
+    // Tell readers that the slot may be written to until this writer is done with it.
+    //
+    InterlockedIncrement(stampWriters);
+
+    // Mark the slot as being written so that readers skip it. The slot may still be in use
+    // by a writer of an older item if writers have wrapped around the whole Ring Buffer
+    // while it was writing. In that case, this writer takes the slot over.
+    //
+    do
+    {
+        stampCurrent = ReadNoFence64(stamp);
+        if (stampCurrent >= stampWriting)
+        {
+            // A newer item has already claimed the slot. This item would have been
+            // deleted by it anyway.
+            //
+            goto Exit;
+        }
+    } while (InterlockedCompareExchange64(stamp,
+                                          stampWriting,
+                                          stampCurrent) != stampCurrent);
+
+    // Write to the Ring Buffer entry in a caller specific manner.
+    //
+    (*ItemProcessCallback)(Buffer,
+                           RingBuffer_SequenceItemGet(RingBuffer,
+                                                      sequence),
+                           RingBuffer->ItemSize);
+
+    // Publish the item. The interlocked operation guarantees the item's contents are visible first.
+    //
+    if (InterlockedCompareExchange64(stamp,
+                                     RING_BUFFER_STAMP(sequence, RING_BUFFER_STAMP_COMPLETE),
+                                     stampWriting) != stampWriting)
+    {
+        // A newer item claimed the slot while this item was written, so the slot may contain
+        // parts of both items. Mark it torn so that readers skip it.
+        //
+        do
+        {
+            stampCurrent = ReadNoFence64(stamp);
+            if ((stampCurrent & RING_BUFFER_STAMP_STATE_MASK) == RING_BUFFER_STAMP_TORN)
+            {
+                break;
+            }
+        } while (InterlockedCompareExchange64(stamp,
+                                              (stampCurrent | RING_BUFFER_STAMP_TORN),
+                                              stampCurrent) != stampCurrent);
+    }
+
+Exit:
+
+    // The stamp is final before this writer stops writing, so a reader that sees no
+    // writers also sees the torn state if the slot was torn.
+    //
+    InterlockedDecrement(stampWriters);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+RingBuffer_MultipleProducerRead(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _Out_writes_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_ RingBuffer_ItemProcessCallbackType ItemProcessCallback
+    )
+/*++
+
+Routine Description:
+
+    Read the oldest item from a RingBuffer_Synchronization_MultipleProducerOverwrite Ring Buffer.
+    Items that were torn or overwritten are skipped. Reading stops at the oldest item that is
+    still being written so that it is read once it is complete. The Module is locked, but writers
+    may still write concurrently.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address of data to copy data read from the oldest item.
+    BufferSize - Amount of data in bytes to read from the oldest item.
+    ItemProcessCallback - Callback function that reads from the ring buffer entry.
+
+Return Value:
+
+    STATUS_SUCCESS if an item was read.
+    STATUS_UNSUCCESSFUL if there are no items in the Ring Buffer to read or the oldest item
+                        is still being written.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    ULONGLONG sequence;
+    ULONGLONG sequenceNext;
+    ULONG slot;
+    LONG64 stamp;
+    LONG64 stampComplete;
+
+    UNREFERENCED_PARAMETER(BufferSize);
+
+    DmfAssert(RingBuffer_IsMultipleProducer(RingBuffer));
+    DmfAssert(BufferSize == RingBuffer->ItemSize);
+
+    ntStatus = STATUS_UNSUCCESSFUL;
+
+    sequence = RingBuffer_SequenceOldestGet(RingBuffer,
+                                            &sequenceNext);
+    while (sequence < sequenceNext)
+    {
+        slot = (ULONG)(sequence & RingBuffer->IndexMask);
+        stampComplete = RING_BUFFER_STAMP(sequence,
+                                          RING_BUFFER_STAMP_COMPLETE);
+        // Acquire semantics guarantee the item's contents are read after the stamp.
+        //
+        stamp = ReadAcquire64(&RingBuffer->Stamps[slot]);
+        if (stamp < stampComplete)
+        {
+            // The item has been claimed but is still being written. Stop here so that it
+            // is read by a later call instead of being lost.
+            //
+            break;
+        }
+
+        if (stamp == stampComplete)
+        {
+            (*ItemProcessCallback)(Buffer,
+                                   RingBuffer_SequenceItemGet(RingBuffer,
+                                                              sequence),
+                                   RingBuffer->ItemSize);
+
+            // Make sure no writer wrote to the slot while it was copied. The stamp alone is
+            // not enough because a writer that was lapped by this item may still be writing.
+            //
+            MemoryBarrier();
+            if (ReadNoFence64(&RingBuffer->Stamps[slot]) == stamp)
+            {
+                if (0 == ReadNoFence(&RingBuffer->StampWriters[slot]))
+                {
+                    ntStatus = STATUS_SUCCESS;
+                    sequence++;
+                    break;
+                }
+
+                // A writer may still be writing to the slot. It marks the item torn if
+                // it overwrote it, so read the item again later.
+                //
+                break;
+            }
+        }
+
+        // The item was torn or overwritten by a newer item.
+        //
+        sequence++;
+    }
+
+    RingBuffer->ReadSequence = sequence;
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+RingBuffer_Write(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_reads_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_ RingBuffer_ItemProcessCallbackType ItemProcessCallback
+    )
+/*++
+
+Routine Description:
+
+    Write data to the Ring Buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address of data to write to the Write Pointer.
+    BufferSize - Amount of data in bytes to write to the Write Pointer.
+    ItemProcessCallback - Callback function that writes into the ring buffer entry.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+
+    ntStatus = STATUS_SUCCESS;
+
+    DmfAssert(RingBuffer != NULL);
+    DmfAssert(Buffer != NULL);
+    DmfAssert(RingBuffer->ItemSize > 0);
+    DmfAssert(NULL == RingBuffer->ReservedItem);
+
+    if (RingBuffer->VariableSizeItems)
+    {
+        ntStatus = RingBuffer_RecordWrite(RingBuffer,
+                                          Buffer,
+                                          BufferSize,
+                                          ItemProcessCallback);
+        goto Exit;
+    }
+
+    if (RingBuffer_IsMultipleProducer(RingBuffer))
+    {
+        // The oldest item is always overwritten, so this never fails.
+        //
+        RingBuffer_MultipleProducerWrite(RingBuffer,
+                                         Buffer,
+                                         BufferSize,
+                                         ItemProcessCallback);
+        goto Exit;
+    }
+
+    if (RingBuffer_IsLockFree(RingBuffer))
+    {
+        UCHAR* item;
+
+        DmfAssert(BufferSize == RingBuffer->ItemSize);
+
+        item = RingBuffer_ProducerItemGet(RingBuffer);
+        if (NULL == item)
+        {
+            // Ring Buffer is Full. This is an error condition.
+            //
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+
+        (*ItemProcessCallback)(Buffer,
+                               item,
+                               RingBuffer->ItemSize);
+
+        RingBuffer_ProducerItemPublish(RingBuffer);
+        goto Exit;
+    }
+
+    ntStatus = RingBuffer_WriteSpaceMake(RingBuffer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE,
+                "WritePointer=%d BufferSize=%d",
+                (LONG)((RingBuffer->WritePointer - RingBuffer->Items) / RingBuffer->ItemSize),
+                BufferSize);
+
+    // Although everything has been validated by this point, both trusted and untrusted callers,
+    // make a run time check to make sure BufferSize is equal to the size of each entry.
+    // NOTE: This should *never* happen because trusted callers only call this function.
+    //
+    if (BufferSize != RingBuffer->ItemSize)
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    // Although everything has been validated by this point, both trusted and untrusted callers,
+    // make a run time check to make sure the write does not exceed the size of the Ring Buffer.
+    // NOTE: This should *never* happen because trusted callers only call this function.
+    //
+    if ((RingBuffer->WritePointer + BufferSize) > RingBuffer->BufferEnd)
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    // Write to the Ring Buffer entry in a caller specific manner.
+    //
+    (*ItemProcessCallback)(Buffer,
+                           RingBuffer->WritePointer,
+                           RingBuffer->ItemSize);
+
+    RingBuffer_WritePointerIncrement(RingBuffer);
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+RingBuffer_Read(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _Out_writes_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_ RingBuffer_ItemProcessCallbackType ItemProcessCallback
+    )
+/*++
+
+Routine Description:
+
+    Read data from the Ring Buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address of data to copy data read from the Read Pointer.
+    BufferSize - Amount of data in bytes to read from the Read Pointer.
+    ItemProcessCallback - Callback function that reads from the ring buffer entry.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+
+    UNREFERENCED_PARAMETER(BufferSize);
+
+    DmfAssert(RingBuffer != NULL);
+    DmfAssert(RingBuffer->ItemSize > 0);
+    DmfAssert(Buffer != NULL);
+    DmfAssert(RingBuffer->VariableSizeItems ||
+              (RingBuffer->ItemsPresentCount <= RingBuffer->ItemsCount));
+    DmfAssert(NULL == RingBuffer->PeekedItem);
+
+    ntStatus = STATUS_SUCCESS;
+
+    if (RingBuffer->VariableSizeItems)
+    {
+        ULONG bytesRead;
+
+        // Only whole items are copied, so ItemProcessCallback is not used.
+        //
+        DmfAssert(RingBuffer_ItemProcessCallbackRead == ItemProcessCallback);
+        ntStatus = RingBuffer_RecordRead(RingBuffer,
+                                         Buffer,
+                                         BufferSize,
+                                         &bytesRead);
+        goto Exit;
+    }
+
+    if (RingBuffer_IsMultipleProducer(RingBuffer))
+    {
+        ntStatus = RingBuffer_MultipleProducerRead(RingBuffer,
+                                                   Buffer,
+                                                   BufferSize,
+                                                   ItemProcessCallback);
+        goto Exit;
+    }
+
+    if (RingBuffer_IsLockFree(RingBuffer))
+    {
+        UCHAR* item;
+
+        item = RingBuffer_ConsumerItemGet(RingBuffer);
+        if (NULL == item)
+        {
+            // There are no items in the buffer to read.
+            //
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+
+        DmfAssert(BufferSize == RingBuffer->ItemSize);
+
+        #pragma warning(suppress: 6001)
+        (ItemProcessCallback)(Buffer,
+                              item,
+                              RingBuffer->ItemSize);
+
+        RingBuffer_ConsumerItemRelease(RingBuffer);
+        goto Exit;
+    }
+
+    if (0 == RingBuffer->ItemsPresentCount)
+    {
+        // There are no items in the buffer to read.
+        //
+        DmfAssert(RingBuffer->ReadPointer == RingBuffer->WritePointer);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE,
+                "ReadPointer=%d", (LONG)((RingBuffer->ReadPointer - RingBuffer->Items) / RingBuffer->ItemSize));
+
+    DmfAssert(BufferSize == RingBuffer->ItemSize);
+
+    // Read from the Ring Buffer entry in a caller specific manner.
+    // Suppress 6001: "*Buffer not initialized." It is because Buffer is either pointer or table to callback.
+    //
+    #pragma warning(suppress: 6001)
+    (ItemProcessCallback)(Buffer,
+                          RingBuffer->ReadPointer,
+                          RingBuffer->ItemSize);
+
+    // Now, increment the read pointer.
+    //
+    RingBuffer_ReadPointerIncrement(RingBuffer);
+    DmfAssert(RingBuffer->ItemsPresentCount < RingBuffer->ItemsCount);
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_ItemsCopyIn(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_ ULONG ItemIndex,
+    _In_reads_bytes_((size_t)ItemCount * RingBuffer->ItemSize) UCHAR* SourceBuffer,
+    _In_ ULONG ItemCount
+    )
+/*++
+
+Routine Description:
+
+    Copies consecutive items into the Ring Buffer starting at a given item. The items wrap
+    to the beginning of the Ring Buffer if necessary, so at most two copies are made.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    ItemIndex - Index of the item where the first item is copied.
+    SourceBuffer - The items to copy.
+    ItemCount - Number of items to copy.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG itemsBeforeEnd;
+
+    DmfAssert(ItemIndex < RingBuffer->ItemsCount);
+    DmfAssert(ItemCount <= RingBuffer->ItemsCount);
+
+    itemsBeforeEnd = RingBuffer->ItemsCount - ItemIndex;
+    if (itemsBeforeEnd > ItemCount)
+    {
+        itemsBeforeEnd = ItemCount;
+    }
+
+    RtlCopyMemory(RingBuffer->Items + ((size_t)ItemIndex * (size_t)RingBuffer->ItemSize),
+                  SourceBuffer,
+                  (size_t)itemsBeforeEnd * (size_t)RingBuffer->ItemSize);
+    if (ItemCount > itemsBeforeEnd)
+    {
+        RtlCopyMemory(RingBuffer->Items,
+                      SourceBuffer + ((size_t)itemsBeforeEnd * (size_t)RingBuffer->ItemSize),
+                      (size_t)(ItemCount - itemsBeforeEnd) * (size_t)RingBuffer->ItemSize);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_ItemsCopyOut(
+    _In_ RING_BUFFER* RingBuffer,
+    _In_ ULONG ItemIndex,
+    _Out_writes_bytes_((size_t)ItemCount * RingBuffer->ItemSize) UCHAR* TargetBuffer,
+    _In_ ULONG ItemCount
+    )
+/*++
+
+Routine Description:
+
+    Copies consecutive items out of the Ring Buffer starting at a given item. The items wrap
+    to the beginning of the Ring Buffer if necessary, so at most two copies are made.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    ItemIndex - Index of the first item to copy.
+    TargetBuffer - Where the items are copied.
+    ItemCount - Number of items to copy.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG itemsBeforeEnd;
+
+    DmfAssert(ItemIndex < RingBuffer->ItemsCount);
+    DmfAssert(ItemCount <= RingBuffer->ItemsCount);
+
+    itemsBeforeEnd = RingBuffer->ItemsCount - ItemIndex;
+    if (itemsBeforeEnd > ItemCount)
+    {
+        itemsBeforeEnd = ItemCount;
+    }
+
+    RtlCopyMemory(TargetBuffer,
+                  RingBuffer->Items + ((size_t)ItemIndex * (size_t)RingBuffer->ItemSize),
+                  (size_t)itemsBeforeEnd * (size_t)RingBuffer->ItemSize);
+    if (ItemCount > itemsBeforeEnd)
+    {
+        RtlCopyMemory(TargetBuffer + ((size_t)itemsBeforeEnd * (size_t)RingBuffer->ItemSize),
+                      RingBuffer->Items,
+                      (size_t)(ItemCount - itemsBeforeEnd) * (size_t)RingBuffer->ItemSize);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+RingBuffer_ItemIndexAdvance(
+    _In_ RING_BUFFER* RingBuffer,
+    _In_ ULONG ItemIndex,
+    _In_ ULONG ItemCount
+    )
+/*++
 
-        DmfAssert(segmentSize > 0);
-        DmfAssert(segmentOffset + segmentSize <= ItemSize);
-        __analysis_assume(segmentOffset + segmentSize <= ItemSize);
+Routine Description:
 
-        // Transfer the data to/from the Ring Buffer.
-        //
-        (*writeContext->DataCopy)(clientSegmentBuffer,
-                                  ringBufferSegmentBuffer,
-                                  segmentSize);
+    Returns the index of the item that is a given number of items after a given item,
+    properly wrapping around when necessary.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    ItemIndex - Index of the starting item.
+    ItemCount - Number of items to advance.
+
+Return Value:
+
+    Index of the resulting item.
+
+--*/
+{
+    DmfAssert(ItemIndex < RingBuffer->ItemsCount);
+    DmfAssert(ItemCount <= RingBuffer->ItemsCount);
+
+    ItemIndex += ItemCount;
+    if (ItemIndex >= RingBuffer->ItemsCount)
+    {
+        ItemIndex -= RingBuffer->ItemsCount;
     }
+
+    return ItemIndex;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 static
 NTSTATUS
-RingBuffer_Write(
+RingBuffer_WriteMultiple(
     _Inout_ RING_BUFFER* RingBuffer,
-    _In_reads_(BufferSize) UCHAR* Buffer,
-    _In_ ULONG BufferSize,
-    _In_ RingBuffer_ItemProcessCallbackType ItemProcessCallback
+    _In_reads_bytes_((size_t)ItemCount * RingBuffer->ItemSize) UCHAR* Buffer,
+    _In_ ULONG ItemCount,
+    _Out_ ULONG* ItemsWritten
     )
 /*++
 
 Routine Description:
 
-    Write data to the Ring Buffer.
+    Write several consecutive items to the Ring Buffer using at most two copies.
 
 Arguments:
 
     RingBuffer - The Ring Buffer management data.
-    Buffer - Address of data to write to the Write Pointer.
-    BufferSize - Amount of data in bytes to write to the Write Pointer.
-    ItemProcessCallback - Callback function that writes into the ring buffer entry.
+    Buffer - The items to write.
+    ItemCount - Number of items in Buffer.
+    ItemsWritten - Receives the number of items written. In RingBuffer_Mode_FailIfFullOnWrite
+                   it is less than ItemCount if the Ring Buffer does not have space for all the items.
 
 Return Value:
 
-    NTSTATUS
+    STATUS_SUCCESS if at least one item was written.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is full.
 
 --*/
 {
     NTSTATUS ntStatus;
-
-    ntStatus = STATUS_SUCCESS;
+    ULONG itemsToWrite;
+    ULONG itemsToDelete;
+    ULONG writeIndex;
+    ULONG readIndex;
 
     DmfAssert(RingBuffer != NULL);
     DmfAssert(Buffer != NULL);
-    DmfAssert(RingBuffer->ItemSize > 0);
-    DmfAssert(RingBuffer->ItemsPresentCount <= RingBuffer->ItemsCount);
+    DmfAssert(ItemCount > 0);
+    DmfAssert(! RingBuffer->VariableSizeItems);
+    DmfAssert(NULL == RingBuffer->ReservedItem);
 
-    if (RingBuffer->ItemsPresentCount == RingBuffer->ItemsCount)
+    ntStatus = STATUS_SUCCESS;
+    *ItemsWritten = 0;
+
+    if (RingBuffer_IsMultipleProducer(RingBuffer))
     {
-        DmfAssert(RingBuffer->ReadPointer == RingBuffer->WritePointer);
-        // It means the buffer is full.
+        // Each item is claimed separately so that other writers are never blocked.
         //
-        if (RingBuffer->Mode == RingBuffer_Mode_FailIfFullOnWrite)
+        for (ULONG itemIndex = 0; itemIndex < ItemCount; itemIndex++)
         {
-            // Ring Buffer is Full. This is an error condition.
-            //
-            ntStatus = STATUS_UNSUCCESSFUL;
-            goto Exit;
+            RingBuffer_MultipleProducerWrite(RingBuffer,
+                                             Buffer + ((size_t)itemIndex * (size_t)RingBuffer->ItemSize),
+                                             RingBuffer->ItemSize,
+                                             RingBuffer_ItemProcessCallbackWrite);
         }
-        else if (RingBuffer->Mode == RingBuffer_Mode_DeleteOldestIfFullOnWrite)
+        *ItemsWritten = ItemCount;
+        goto Exit;
+    }
+
+    if (RingBuffer_IsLockFree(RingBuffer))
+    {
+        ULONG itemsFree;
+
+        // Only the producer writes its own index so it does not need to be read with a barrier.
+        //
+        writeIndex = (ULONG)RingBuffer->Producer.Index;
+        itemsFree = RingBuffer->ItemsCount - (writeIndex - RingBuffer->Producer.OtherIndexCached);
+        if (itemsFree < ItemCount)
         {
-            // Ring Buffer is full, but it is infinite. So, just throw away the oldest pending Read
-            // to make space for this Write.
+            // Acquire semantics guarantee the consumer is done with the items before they are overwritten.
             //
-            RingBuffer_ReadPointerIncrement(RingBuffer);
+            RingBuffer->Producer.OtherIndexCached = (ULONG)ReadAcquire(&RingBuffer->Consumer.Index);
+            itemsFree = RingBuffer->ItemsCount - (writeIndex - RingBuffer->Producer.OtherIndexCached);
         }
-        else
+
+        itemsToWrite = (ItemCount < itemsFree) ? ItemCount : itemsFree;
+        if (0 == itemsToWrite)
         {
-            DmfAssert(FALSE);
+            // Ring Buffer is Full. This is an error condition.
+            //
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
         }
-    }
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE,
-                "WritePointer=%d BufferSize=%d",
-                (LONG)((RingBuffer->WritePointer - RingBuffer->Items) / RingBuffer->ItemSize),
-                BufferSize);
+        RingBuffer_ItemsCopyIn(RingBuffer,
+                               writeIndex & RingBuffer->IndexMask,
+                               Buffer,
+                               itemsToWrite);
 
-    // Although everything has been validated by this point, both trusted and untrusted callers,
-    // make a run time check to make sure BufferSize is equal to the size of each entry.
-    // NOTE: This should *never* happen because trusted callers only call this function.
-    //
-    if (BufferSize != RingBuffer->ItemSize)
-    {
-        DmfAssert(FALSE);
-        ntStatus = STATUS_UNSUCCESSFUL;
+        // Release semantics guarantee the items' contents are visible before the new index.
+        //
+        WriteRelease(&RingBuffer->Producer.Index,
+                     (LONG)(writeIndex + itemsToWrite));
+        *ItemsWritten = itemsToWrite;
         goto Exit;
     }
 
-    // Although everything has been validated by this point, both trusted and untrusted callers,
-    // make a run time check to make sure the write does not exceed the size of the Ring Buffer.
-    // NOTE: This should *never* happen because trusted callers only call this function.
-    //
-    if ((RingBuffer->WritePointer + BufferSize) > RingBuffer->BufferEnd)
+    DmfAssert(RingBuffer->ItemsPresentCount <= RingBuffer->ItemsCount);
+
+    itemsToWrite = ItemCount;
+    if (RingBuffer->Mode == RingBuffer_Mode_DeleteOldestIfFullOnWrite)
     {
-        DmfAssert(FALSE);
-        ntStatus = STATUS_UNSUCCESSFUL;
-        goto Exit;
-    }
+        if (itemsToWrite > RingBuffer->ItemsCount)
+        {
+            // Only the newest items would remain, so do not copy the others.
+            //
+            Buffer += (size_t)(itemsToWrite - RingBuffer->ItemsCount) * (size_t)RingBuffer->ItemSize;
+            itemsToWrite = RingBuffer->ItemsCount;
+        }
 
-    // Write to the Ring Buffer entry in a caller specific manner.
-    //
-    (*ItemProcessCallback)(Buffer,
-                           RingBuffer->WritePointer,
-                           RingBuffer->ItemSize);
+        // Delete as many of the oldest items as needed to make space.
+        //
+        if (RingBuffer->ItemsPresentCount + itemsToWrite > RingBuffer->ItemsCount)
+        {
+            itemsToDelete = RingBuffer->ItemsPresentCount + itemsToWrite - RingBuffer->ItemsCount;
+            readIndex = (ULONG)((RingBuffer->ReadPointer - RingBuffer->Items) / RingBuffer->ItemSize);
+            RingBuffer_KeyIndexRemove(RingBuffer,
+                                      readIndex,
+                                      itemsToDelete);
+            readIndex = RingBuffer_ItemIndexAdvance(RingBuffer,
+                                                    readIndex,
+                                                    itemsToDelete);
+            RingBuffer->ReadPointer = RingBuffer->Items + ((size_t)readIndex * (size_t)RingBuffer->ItemSize);
+            RingBuffer->ItemsPresentCount -= itemsToDelete;
+        }
 
-    // Move the Write Pointer to the next proper location.
-    //
-    RingBuffer->WritePointer += RingBuffer->ItemSize;
-    DmfAssert(RingBuffer->WritePointer <= RingBuffer->BufferEnd);
-    DmfAssert(RingBuffer->WritePointer >= RingBuffer->Items);
-    if (RingBuffer->WritePointer == RingBuffer->BufferEnd)
+        *ItemsWritten = ItemCount;
+    }
+    else
     {
-        RingBuffer->WritePointer = RingBuffer->Items;
-        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Wrap Read RingBuffer->WritePointer");
+        if (itemsToWrite > RingBuffer->ItemsCount - RingBuffer->ItemsPresentCount)
+        {
+            itemsToWrite = RingBuffer->ItemsCount - RingBuffer->ItemsPresentCount;
+        }
+        if (0 == itemsToWrite)
+        {
+            // Ring Buffer is Full. This is an error condition.
+            //
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+
+        *ItemsWritten = itemsToWrite;
     }
 
-    // An item has just been written (added), so increment the number of items in the buffer.
-    //
-    RingBuffer->ItemsPresentCount++;
+    writeIndex = (ULONG)((RingBuffer->WritePointer - RingBuffer->Items) / RingBuffer->ItemSize);
+    RingBuffer_ItemsCopyIn(RingBuffer,
+                           writeIndex,
+                           Buffer,
+                           itemsToWrite);
+    RingBuffer_KeyIndexInsert(RingBuffer,
+                              writeIndex,
+                              itemsToWrite);
+    writeIndex = RingBuffer_ItemIndexAdvance(RingBuffer,
+                                             writeIndex,
+                                             itemsToWrite);
+    RingBuffer->WritePointer = RingBuffer->Items + ((size_t)writeIndex * (size_t)RingBuffer->ItemSize);
+    RingBuffer->ItemsPresentCount += itemsToWrite;
     DmfAssert(RingBuffer->ItemsPresentCount <= RingBuffer->ItemsCount);
 
 Exit:
@@ -438,68 +2536,130 @@ _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 static
 NTSTATUS
-RingBuffer_Read(
+RingBuffer_ReadMultiple(
     _Inout_ RING_BUFFER* RingBuffer,
-    _Out_writes_(BufferSize) UCHAR* Buffer,
-    _In_ ULONG BufferSize,
-    _In_ RingBuffer_ItemProcessCallbackType ItemProcessCallback
+    _Out_writes_bytes_((size_t)ItemCount * RingBuffer->ItemSize) UCHAR* Buffer,
+    _In_ ULONG ItemCount,
+    _Out_ ULONG* ItemsRead
     )
 /*++
 
 Routine Description:
 
-    Read data from the Ring Buffer.
+    Read several consecutive items, oldest first, from the Ring Buffer using at most two copies.
 
 Arguments:
 
     RingBuffer - The Ring Buffer management data.
-    Buffer - Address of data to copy data read from the Read Pointer.
-    BufferSize - Amount of data in bytes to read from the Read Pointer.
-    ItemProcessCallback - Callback function that reads from the ring buffer entry.
+    Buffer - Where the items are copied.
+    ItemCount - Maximum number of items to read.
+    ItemsRead - Receives the number of items read.
 
 Return Value:
 
-    NTSTATUS
+    STATUS_SUCCESS if at least one item was read.
+    STATUS_UNSUCCESSFUL if there are no items in the Ring Buffer to read.
 
 --*/
 {
     NTSTATUS ntStatus;
-
-    UNREFERENCED_PARAMETER(BufferSize);
+    ULONG itemsToRead;
+    ULONG readIndex;
 
     DmfAssert(RingBuffer != NULL);
-    DmfAssert(RingBuffer->ItemSize > 0);
     DmfAssert(Buffer != NULL);
-    DmfAssert(RingBuffer->ItemsPresentCount <= RingBuffer->ItemsCount);
+    DmfAssert(ItemCount > 0);
+    DmfAssert(! RingBuffer->VariableSizeItems);
+    DmfAssert(NULL == RingBuffer->PeekedItem);
 
     ntStatus = STATUS_SUCCESS;
+    *ItemsRead = 0;
 
-    if (0 == RingBuffer->ItemsPresentCount)
+    if (RingBuffer_IsMultipleProducer(RingBuffer))
     {
-        // There are no items in the buffer to read.
+        // Each item must be checked separately because writers may be writing any of them.
         //
-        DmfAssert(RingBuffer->ReadPointer == RingBuffer->WritePointer);
-        ntStatus = STATUS_UNSUCCESSFUL;
+        while (*ItemsRead < ItemCount)
+        {
+            ntStatus = RingBuffer_MultipleProducerRead(RingBuffer,
+                                                       Buffer + ((size_t)*ItemsRead * (size_t)RingBuffer->ItemSize),
+                                                       RingBuffer->ItemSize,
+                                                       RingBuffer_ItemProcessCallbackRead);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                break;
+            }
+            (*ItemsRead)++;
+        }
+        ntStatus = (*ItemsRead > 0) ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
         goto Exit;
     }
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE,
-                "ReadPointer=%d", (LONG)((RingBuffer->ReadPointer - RingBuffer->Items) / RingBuffer->ItemSize));
+    if (RingBuffer_IsLockFree(RingBuffer))
+    {
+        ULONG itemsPresent;
 
-    DmfAssert(BufferSize == RingBuffer->ItemSize);
+        // Only the consumer writes its own index so it does not need to be read with a barrier.
+        //
+        readIndex = (ULONG)RingBuffer->Consumer.Index;
+        itemsPresent = RingBuffer->Consumer.OtherIndexCached - readIndex;
+        if (itemsPresent < ItemCount)
+        {
+            // Acquire semantics guarantee the items' contents are read after the producer wrote them.
+            //
+            RingBuffer->Consumer.OtherIndexCached = (ULONG)ReadAcquire(&RingBuffer->Producer.Index);
+            itemsPresent = RingBuffer->Consumer.OtherIndexCached - readIndex;
+        }
+        DmfAssert(itemsPresent <= RingBuffer->ItemsCount);
 
-    // Read from the Ring Buffer entry in a caller specific manner.
-    // Suppress 6001: "*Buffer not initialized." It is because Buffer is either pointer or table to callback.
-    //
-    #pragma warning(suppress: 6001)
-    (ItemProcessCallback)(Buffer,
-                          RingBuffer->ReadPointer,
-                          RingBuffer->ItemSize);
+        itemsToRead = (ItemCount < itemsPresent) ? ItemCount : itemsPresent;
+        if (0 == itemsToRead)
+        {
+            // There are no items in the buffer to read.
+            //
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
 
-    // Now, increment the read pointer.
-    //
-    RingBuffer_ReadPointerIncrement(RingBuffer);
-    DmfAssert(RingBuffer->ItemsPresentCount < RingBuffer->ItemsCount);
+        RingBuffer_ItemsCopyOut(RingBuffer,
+                                readIndex & RingBuffer->IndexMask,
+                                Buffer,
+                                itemsToRead);
+
+        // Release semantics guarantee the items have been read before the producer can overwrite them.
+        //
+        WriteRelease(&RingBuffer->Consumer.Index,
+                     (LONG)(readIndex + itemsToRead));
+        *ItemsRead = itemsToRead;
+        goto Exit;
+    }
+
+    DmfAssert(RingBuffer->ItemsPresentCount <= RingBuffer->ItemsCount);
+
+    itemsToRead = (ItemCount < RingBuffer->ItemsPresentCount) ? ItemCount : RingBuffer->ItemsPresentCount;
+    if (0 == itemsToRead)
+    {
+        // There are no items in the buffer to read.
+        //
+        DmfAssert(RingBuffer->ReadPointer == RingBuffer->WritePointer);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    readIndex = (ULONG)((RingBuffer->ReadPointer - RingBuffer->Items) / RingBuffer->ItemSize);
+    RingBuffer_ItemsCopyOut(RingBuffer,
+                            readIndex,
+                            Buffer,
+                            itemsToRead);
+    RingBuffer_KeyIndexRemove(RingBuffer,
+                              readIndex,
+                              itemsToRead);
+    readIndex = RingBuffer_ItemIndexAdvance(RingBuffer,
+                                            readIndex,
+                                            itemsToRead);
+    RingBuffer->ReadPointer = RingBuffer->Items + ((size_t)readIndex * (size_t)RingBuffer->ItemSize);
+    RingBuffer->ItemsPresentCount -= itemsToRead;
+    *ItemsRead = itemsToRead;
 
 Exit:
 
@@ -516,7 +2676,11 @@ RingBuffer_Create(
     _Inout_ RING_BUFFER* RingBuffer,
     _In_ ULONG ItemCount,
     _In_ ULONG ItemSize,
-    _In_ RingBuffer_ModeType Mode
+    _In_ RingBuffer_ModeType Mode,
+    _In_ RingBuffer_SynchronizationType Synchronization,
+    _In_ BOOLEAN VariableSizeItems,
+    _In_ ULONG KeyOffset,
+    _In_ ULONG KeySize
     )
 /*++
 
@@ -531,6 +2695,10 @@ Arguments:
     ItemCount - Number of entries in the Ring Buffer.
     ItemSize - Size in bytes of each entry in the Ring Buffer.
     Mode - Indicates the mode of Ring Buffer.
+    Synchronization - Indicates how access to the Ring Buffer is synchronized.
+    VariableSizeItems - Indicates each item only uses as much space as the data written to it.
+    KeyOffset - Offset in bytes of the key of each item.
+    KeySize - Size in bytes of the key of each item. Zero if there is no key index.
 
 Return Value:
 
@@ -540,6 +2708,8 @@ Return Value:
 {
     NTSTATUS ntStatus;
     WDF_OBJECT_ATTRIBUTES objectAttributes;
+    ULONG slotSize;
+    ULONG bucketCount;
 
     PAGED_CODE();
 
@@ -560,12 +2730,91 @@ Return Value:
         goto Exit;
     }
 
+    if (RingBuffer_Synchronization_SingleProducerSingleConsumer == Synchronization)
+    {
+        // The producer cannot delete the oldest item because only the consumer moves the
+        // Read Index. The free running indexes are masked, so the count must be a power of two.
+        //
+        if ((Mode != RingBuffer_Mode_FailIfFullOnWrite) ||
+            ((ItemCount & (ItemCount - 1)) != 0))
+        {
+            ntStatus = STATUS_INVALID_PARAMETER;
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+    }
+    else if (RingBuffer_Synchronization_MultipleProducerOverwrite == Synchronization)
+    {
+        // Writers cannot wait for space, so the oldest item must always be overwritten.
+        // Sequence numbers are masked, so the count must be a power of two.
+        //
+        if ((Mode != RingBuffer_Mode_DeleteOldestIfFullOnWrite) ||
+            ((ItemCount & (ItemCount - 1)) != 0))
+        {
+            ntStatus = STATUS_INVALID_PARAMETER;
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+    }
+    else if (Synchronization != RingBuffer_Synchronization_Lock)
+    {
+        ntStatus = STATUS_INVALID_PARAMETER;
+        DmfAssert(FALSE);
+        goto Exit;
+    }
+
+    if (VariableSizeItems)
+    {
+        // Variable size items are only supported with the Module lock. ItemSize becomes the
+        // maximum size of an item and enough space is allocated for ItemCount such items.
+        //
+        if ((Synchronization != RingBuffer_Synchronization_Lock) ||
+            (ItemSize > (ULONG_MAX / 2)) ||
+            (RingBuffer_RecordSize(ItemSize) > (ULONG_MAX - 1) / ((ULONGLONG)ItemCount + 1)))
+        {
+            ntStatus = STATUS_INVALID_PARAMETER;
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+    }
+
+    if (KeySize > 0)
+    {
+        // The key index is updated as items are written and removed, so it requires the Module
+        // lock. The key must be inside the item. Buckets are selected by masking the key hash,
+        // so there is a power of two number of them.
+        //
+        if ((Synchronization != RingBuffer_Synchronization_Lock) ||
+            VariableSizeItems ||
+            (KeyOffset > ItemSize) ||
+            (KeySize > ItemSize - KeyOffset) ||
+            (ItemCount > (ULONG_MAX / 2) + 1))
+        {
+            ntStatus = STATUS_INVALID_PARAMETER;
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+    }
+
+    RingBuffer->VariableSizeItems = VariableSizeItems;
+    if (VariableSizeItems)
+    {
+        // Each maximum size item also needs space for its header.
+        //
+        RingBuffer->UsedBytes = 0;
+        slotSize = RingBuffer_RecordSize(ItemSize);
+    }
+    else
+    {
+        slotSize = ItemSize;
+    }
+
     // Create space for the Ring Buffer entries.
     // The +1 is for extra swap space used only by this object.
     //
     WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
     objectAttributes.ParentObject = DmfModule;
-    size_t sizeToAllocate = (((size_t)ItemCount + 1) * (size_t)ItemSize);
+    size_t sizeToAllocate = (((size_t)ItemCount + 1) * (size_t)slotSize);
     ntStatus = WdfMemoryCreate(&objectAttributes,
                                NonPagedPoolNx,
                                MemoryTag,
@@ -585,16 +2834,85 @@ Return Value:
     RtlZeroMemory(RingBuffer->Items,
                   sizeToAllocate);
 
+    if (RingBuffer_Synchronization_MultipleProducerOverwrite == Synchronization)
+    {
+        // A stamp of zero indicates that nothing has been written to the slot.
+        //
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        // The number of writers of each item follows the stamps.
+        //
+        ntStatus = WdfMemoryCreate(&objectAttributes,
+                                   NonPagedPoolNx,
+                                   MemoryTag,
+                                   (size_t)ItemCount * (sizeof(LONG64) + sizeof(LONG)),
+                                   &RingBuffer->MemoryStamps,
+                                   (VOID**)&RingBuffer->Stamps);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+
+        RtlZeroMemory((VOID*)RingBuffer->Stamps,
+                      (size_t)ItemCount * (sizeof(LONG64) + sizeof(LONG)));
+        RingBuffer->StampWriters = (volatile LONG*)(RingBuffer->Stamps + ItemCount);
+    }
+
+    RingBuffer->KeyOffset = KeyOffset;
+    RingBuffer->KeySize = 0;
+    if (KeySize > 0)
+    {
+        // There are at least as many buckets as items so that chains are short.
+        //
+        bucketCount = 1;
+        while (bucketCount < ItemCount)
+        {
+            bucketCount <<= 1;
+        }
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        ntStatus = WdfMemoryCreate(&objectAttributes,
+                                   NonPagedPoolNx,
+                                   MemoryTag,
+                                   ((size_t)bucketCount * sizeof(RING_BUFFER_KEY_BUCKET)) +
+                                   ((size_t)ItemCount * sizeof(RING_BUFFER_KEY_ENTRY)),
+                                   &RingBuffer->MemoryKeyIndex,
+                                   (VOID**)&RingBuffer->KeyBuckets);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+
+        RingBuffer->KeyEntries = (RING_BUFFER_KEY_ENTRY*)(RingBuffer->KeyBuckets + bucketCount);
+        RingBuffer->KeyBucketMask = bucketCount - 1;
+        RingBuffer->KeySize = KeySize;
+    }
+
     // Initialize the Ring Buffer management entries.
     //
     RingBuffer->ReadPointer = RingBuffer->Items;
     RingBuffer->WritePointer = RingBuffer->Items;
     RingBuffer->ItemSize = ItemSize;
-    RingBuffer->BufferEnd = RingBuffer->Items + ((size_t)RingBuffer->ItemSize * (size_t)ItemCount);
-    RingBuffer->TotalSize = RingBuffer->ItemSize * ItemCount;
+    RingBuffer->BufferEnd = RingBuffer->Items + ((size_t)slotSize * (size_t)ItemCount);
+    RingBuffer->TotalSize = slotSize * ItemCount;
     RingBuffer->Mode = Mode;
     RingBuffer->ItemsCount = ItemCount;
     RingBuffer->ItemsPresentCount = 0;
+    RingBuffer->ReservedItem = NULL;
+    RingBuffer->PeekedItem = NULL;
+    RingBuffer->Synchronization = Synchronization;
+    RingBuffer->IndexMask = ItemCount - 1;
+    RingBuffer->Consumer.Index = 0;
+    RingBuffer->Consumer.OtherIndexCached = 0;
+    RingBuffer->Producer.Index = 0;
+    RingBuffer->Producer.OtherIndexCached = 0;
+    RingBuffer->WriteSequence.Next = 0;
+    RingBuffer->ReadSequence = 0;
+
+    // The Ring Buffer is empty, so this just empties the key index.
+    //
+    RingBuffer_KeyIndexRebuild(RingBuffer);
 
 Exit:
 
@@ -638,6 +2956,25 @@ Return Value:
         RingBuffer->Items = NULL;
     }
 
+    if (RingBuffer->MemoryStamps != NULL)
+    {
+        DmfAssert(RingBuffer->Stamps != NULL);
+        WdfObjectDelete(RingBuffer->MemoryStamps);
+        RingBuffer->MemoryStamps = NULL;
+        RingBuffer->Stamps = NULL;
+        RingBuffer->StampWriters = NULL;
+    }
+
+    if (RingBuffer->MemoryKeyIndex != NULL)
+    {
+        DmfAssert(RingBuffer->KeyBuckets != NULL);
+        WdfObjectDelete(RingBuffer->MemoryKeyIndex);
+        RingBuffer->MemoryKeyIndex = NULL;
+        RingBuffer->KeyBuckets = NULL;
+        RingBuffer->KeyEntries = NULL;
+        RingBuffer->KeySize = 0;
+    }
+
     return STATUS_SUCCESS;
 }
 #pragma code_seg()
@@ -673,11 +3010,11 @@ Return Value:
 
     bufferToFind = (BUFFER_TO_FIND*)BufferToFind;
 
-    DmfAssert(bufferToFind->ItemSize <= BufferSize);
-
     // Check if this Buffer matches the bufferToFind.
+    // (Variable size items can be smaller than the data being searched for.)
     //
-    if (RtlCompareMemory(Buffer,
+    if ((bufferToFind->ItemSize <= BufferSize) &&
+        RtlCompareMemory(Buffer,
                          bufferToFind->Item,
                          bufferToFind->ItemSize) == bufferToFind->ItemSize)
     {
@@ -743,7 +3080,11 @@ Return Value:
                                  &moduleContext->RingBuffer,
                                  moduleConfig->ItemCount,
                                  moduleConfig->ItemSize,
-                                 moduleConfig->Mode);
+                                 moduleConfig->Mode,
+                                 moduleConfig->Synchronization,
+                                 moduleConfig->VariableSizeItems,
+                                 moduleConfig->KeyOffset,
+                                 moduleConfig->KeySize);
 
     return ntStatus;
 }
@@ -885,28 +3226,87 @@ Return Value:
     RING_BUFFER* ringBuffer;
     UCHAR* readPointer;
     UCHAR* writePointer;
+    BOOLEAN continueEnumeration;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  RingBuffer);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &(moduleContext->RingBuffer);
 
     // When this Method is executed from a Crash Dump Handler, it must not lock since
     // the lock may already be held.
     //
     if (Lock)
     {
-        DMF_ModuleLock(DmfModule);
+        RingBuffer_Lock(DmfModule,
+                        ringBuffer);
+    }
+
+    if (RingBuffer_IsLockFree(ringBuffer))
+    {
+        ULONG readIndex;
+        ULONG writeIndex;
+
+        // Enumerate the items present when enumeration starts. Items written after this point
+        // are not enumerated. Only the consumer removes items, so this is only safe from the
+        // consumer or when the consumer is not running.
+        //
+        readIndex = (ULONG)ReadAcquire(&ringBuffer->Consumer.Index);
+        writeIndex = (ULONG)ReadAcquire(&ringBuffer->Producer.Index);
+        DmfAssert((writeIndex - readIndex) <= ringBuffer->ItemsCount);
+
+        continueEnumeration = TRUE;
+        while (continueEnumeration &&
+               (readIndex != writeIndex))
+        {
+            readPointer = ringBuffer->Items + ((size_t)(readIndex & ringBuffer->IndexMask) * (size_t)ringBuffer->ItemSize);
+            continueEnumeration = RingBufferItemCallback(DmfModule,
+                                                         readPointer,
+                                                         ringBuffer->ItemSize,
+                                                         RingBufferItemCallbackContext);
+            readIndex++;
+        }
+        goto Exit;
     }
 
-    ringBuffer = &(moduleContext->RingBuffer);
+    if (RingBuffer_IsMultipleProducer(ringBuffer))
+    {
+        ULONGLONG sequence;
+        ULONGLONG sequenceNext;
+
+        // Enumerate the items present when enumeration starts from oldest to newest. Items
+        // that are being written or were torn are skipped. Writers may still write while the
+        // Client's callback runs, so the Client should enumerate when writers are not running
+        // (for example, from a crash dump callback) or use DMF_RingBuffer_ReadAll() instead.
+        //
+        sequence = RingBuffer_SequenceOldestGet(ringBuffer,
+                                                &sequenceNext);
+        continueEnumeration = TRUE;
+        while (continueEnumeration &&
+               (sequence < sequenceNext))
+        {
+            if (RingBuffer_SequenceIsComplete(ringBuffer,
+                                              sequence))
+            {
+                continueEnumeration = RingBufferItemCallback(DmfModule,
+                                                             RingBuffer_SequenceItemGet(ringBuffer,
+                                                                                        sequence),
+                                                             ringBuffer->ItemSize,
+                                                             RingBufferItemCallbackContext);
+            }
+            sequence++;
+        }
+        goto Exit;
+    }
 
     readPointer = ringBuffer->ReadPointer;
     writePointer = ringBuffer->WritePointer;
 
     // Check if ring buffer is empty.
     //
-    DmfAssert(ringBuffer->ItemsPresentCount <= ringBuffer->ItemsCount);
+    DmfAssert(ringBuffer->VariableSizeItems ||
+              (ringBuffer->ItemsPresentCount <= ringBuffer->ItemsCount));
     if (0 == ringBuffer->ItemsPresentCount)
     {
         DmfAssert(readPointer == writePointer);
@@ -915,7 +3315,31 @@ Return Value:
 
     DmfAssert(ringBuffer->ItemSize > 0);
 
-    BOOLEAN continueEnumeration;
+    if (ringBuffer->VariableSizeItems)
+    {
+        RING_BUFFER_RECORD_HEADER* header;
+        ULONG itemsLeft;
+
+        itemsLeft = ringBuffer->ItemsPresentCount;
+        do
+        {
+            // Enumerate each entry and call the client supplied callback.
+            //
+            readPointer = RingBuffer_RecordPaddingSkip(ringBuffer,
+                                                       readPointer);
+            header = (RING_BUFFER_RECORD_HEADER*)readPointer;
+            continueEnumeration = RingBufferItemCallback(DmfModule,
+                                                         (UCHAR*)(header + 1),
+                                                         header->Size,
+                                                         RingBufferItemCallbackContext);
+            readPointer = RingBuffer_RecordNext(ringBuffer,
+                                                readPointer);
+            itemsLeft--;
+        }
+        while (continueEnumeration &&
+               (itemsLeft > 0));
+        goto Exit;
+    }
 
     do
     {
@@ -941,7 +3365,8 @@ Exit:
 
     if (Lock)
     {
-        DMF_ModuleUnlock(DmfModule);
+        RingBuffer_Unlock(DmfModule,
+                          ringBuffer);
     }
 }
 
@@ -959,6 +3384,8 @@ DMF_RingBuffer_EnumerateToFindItem(
 Routine Description:
 
     Calls Client provided function for ring buffer entries that match the client provided buffer.
+    If the Ring Buffer has a key index and the client provided buffer contains the key, only the
+    entries that have the same key hash are compared. Otherwise, all the entries are compared.
 
 Arguments:
 
@@ -976,23 +3403,57 @@ Return Value:
 {
     BUFFER_TO_FIND bufferToFind;
     DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+    ULONG itemIndex;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  RingBuffer);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
 
     bufferToFind.Item = Item;
     bufferToFind.ItemSize = ItemSize;
     bufferToFind.CallbackIfFound = RingBufferItemCallback;
     bufferToFind.CallbackContextIfFound = RingBufferItemCallbackContext;
 
-    DmfAssert(bufferToFind.ItemSize <= moduleContext->RingBuffer.ItemSize);
+    DmfAssert(bufferToFind.ItemSize <= ringBuffer->ItemSize);
+
+    if ((0 == ringBuffer->KeySize) ||
+        (ItemSize < ringBuffer->KeyOffset + ringBuffer->KeySize))
+    {
+        // Every entry must be compared.
+        //
+        DMF_RingBuffer_Enumerate(DmfModule,
+                                 TRUE,
+                                 RingBuffer_ItemMatch,
+                                 &bufferToFind);
+        goto Exit;
+    }
+
+    // Only entries with the same key can match. The bucket lists them from oldest to newest,
+    // which is the same order they are enumerated in.
+    //
+    RingBuffer_Lock(DmfModule,
+                    ringBuffer);
 
-    DMF_RingBuffer_Enumerate(DmfModule,
-                             TRUE,
-                             RingBuffer_ItemMatch,
+    itemIndex = ringBuffer->KeyBuckets[RingBuffer_KeyBucketGet(ringBuffer,
+                                                               Item + ringBuffer->KeyOffset)].First;
+    while (itemIndex != RING_BUFFER_KEY_INDEX_NONE)
+    {
+        RingBuffer_ItemMatch(DmfModule,
+                             ringBuffer->Items + ((size_t)itemIndex * (size_t)ringBuffer->ItemSize),
+                             ringBuffer->ItemSize,
                              &bufferToFind);
+        itemIndex = ringBuffer->KeyEntries[itemIndex].Next;
+    }
+
+    RingBuffer_Unlock(DmfModule,
+                      ringBuffer);
+
+Exit:
+
+    return;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
@@ -1029,15 +3490,18 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DMF_ModuleLock(DmfModule);
+    RingBuffer_Lock(DmfModule,
+                    &moduleContext->RingBuffer);
 
-    DmfAssert(TargetBufferSize == moduleContext->RingBuffer.ItemSize);
+    DmfAssert(moduleContext->RingBuffer.VariableSizeItems ||
+              (TargetBufferSize == moduleContext->RingBuffer.ItemSize));
     ntStatus = RingBuffer_Read(&moduleContext->RingBuffer,
                                TargetBuffer,
                                TargetBufferSize,
                                RingBuffer_ItemProcessCallbackRead);
 
-    DMF_ModuleUnlock(DmfModule);
+    RingBuffer_Unlock(DmfModule,
+                      &moduleContext->RingBuffer);
 
     return ntStatus;
 }
@@ -1056,6 +3520,7 @@ DMF_RingBuffer_ReadAll(
 Routine Description:
 
     Capture data from the Ring Buffer. (Reads the full Ring Buffer.)
+    Variable size items are each preceded by a ULONG that contains the size of the item.
 
 Arguments:
 
@@ -1088,7 +3553,17 @@ Return Value:
 
     ntStatus = STATUS_UNSUCCESSFUL;
 
-    DMF_ModuleLock(DmfModule);
+    RingBuffer_Lock(DmfModule,
+                    &moduleContext->RingBuffer);
+
+    if (moduleContext->RingBuffer.VariableSizeItems)
+    {
+        RingBuffer_RecordReadAll(&moduleContext->RingBuffer,
+                                 TargetBuffer,
+                                 TargetBufferSize,
+                                 BytesWritten);
+        goto Exit;
+    }
 
     entriesRead = 0;
     sizeOfEachItem = moduleContext->RingBuffer.ItemSize;
@@ -1106,18 +3581,351 @@ Return Value:
                                    RingBuffer_ItemProcessCallbackRead);
         if (! NT_SUCCESS(ntStatus))
         {
-            break;
+            break;
+        }
+        TargetBuffer += sizeOfEachItem;
+        entriesRead++;
+    } while (NT_SUCCESS(ntStatus));
+
+    DmfAssert(BytesWritten != NULL);
+    *BytesWritten = entriesRead * sizeOfEachItem;
+
+Exit:
+
+    RingBuffer_Unlock(DmfModule,
+                      &moduleContext->RingBuffer);
+
+    return STATUS_SUCCESS;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadEx(
+    _In_ DMFMODULE DmfModule,
+    _Out_writes_(TargetBufferSize) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize,
+    _Out_ ULONG* BytesRead
+    )
+/*++
+
+Routine Description:
+
+    Read data from the Ring Buffer. (Reads the whole entry and returns its size.)
+    This Method is useful when the Ring Buffer contains variable size items.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    TargetBuffer - Address of data to copy data read from the Read Pointer.
+    TargetBufferSize - Size in bytes of TargetBuffer.
+    BytesRead - Receives the size in bytes of the entry that was read.
+
+Return Value:
+
+    STATUS_SUCCESS if the entry was read.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is empty.
+    STATUS_BUFFER_TOO_SMALL if the entry does not fit in TargetBuffer. The entry is not removed.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
+
+    *BytesRead = 0;
+
+    RingBuffer_Lock(DmfModule,
+                    ringBuffer);
+
+    if (ringBuffer->VariableSizeItems)
+    {
+        ntStatus = RingBuffer_RecordRead(ringBuffer,
+                                         TargetBuffer,
+                                         TargetBufferSize,
+                                         BytesRead);
+    }
+    else if (TargetBufferSize < ringBuffer->ItemSize)
+    {
+        ntStatus = STATUS_BUFFER_TOO_SMALL;
+    }
+    else
+    {
+        ntStatus = RingBuffer_Read(ringBuffer,
+                                   TargetBuffer,
+                                   ringBuffer->ItemSize,
+                                   RingBuffer_ItemProcessCallbackRead);
+        if (NT_SUCCESS(ntStatus))
+        {
+            *BytesRead = ringBuffer->ItemSize;
+        }
+    }
+
+    RingBuffer_Unlock(DmfModule,
+                      ringBuffer);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadMultiple(
+    _In_ DMFMODULE DmfModule,
+    _Out_writes_(TargetBufferSize) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize,
+    _Out_ ULONG* ItemsRead
+    )
+/*++
+
+Routine Description:
+
+    Read as many items as are present and fit in a given buffer from the Ring Buffer, oldest first.
+    The Module is locked only once and the items are copied using at most two copies.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    TargetBuffer - Address of buffer where the items are copied one after another.
+    TargetBufferSize - Size in bytes of TargetBuffer.
+    ItemsRead - Receives the number of items read.
+
+Return Value:
+
+    STATUS_SUCCESS if at least one item was read.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is empty.
+    STATUS_BUFFER_TOO_SMALL if TargetBuffer cannot hold a single item.
+    STATUS_NOT_SUPPORTED if the Ring Buffer contains variable size items.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+    ULONG itemCount;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
+
+    *ItemsRead = 0;
+
+    if (ringBuffer->VariableSizeItems)
+    {
+        // Items are not copied one after another if their size is not known.
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    itemCount = TargetBufferSize / ringBuffer->ItemSize;
+    if (0 == itemCount)
+    {
+        ntStatus = STATUS_BUFFER_TOO_SMALL;
+        goto Exit;
+    }
+
+    RingBuffer_Lock(DmfModule,
+                    ringBuffer);
+
+    ntStatus = RingBuffer_ReadMultiple(ringBuffer,
+                                       TargetBuffer,
+                                       itemCount,
+                                       ItemsRead);
+
+    RingBuffer_Unlock(DmfModule,
+                      ringBuffer);
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_When_(NT_SUCCESS(return), _IRQL_raises_(DISPATCH_LEVEL))
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadPeek(
+    _In_ _When_(NT_SUCCESS(return), _Acquires_lock_(_Curr_) _IRQL_saves_) DMFMODULE DmfModule,
+    _Out_ UCHAR** Item,
+    _Out_ ULONG* ItemSize
+    )
+/*++
+
+Routine Description:
+
+    Returns the address of the oldest item in the Ring Buffer so that the Client can read it in place
+    instead of copying it. The Module is locked until the Client calls DMF_RingBuffer_ReadRelease()
+    (except for RingBuffer_Synchronization_SingleProducerSingleConsumer which does not lock).
+    NOTE: The Client must call DMF_RingBuffer_ReadRelease() as soon as possible and must not call any
+          other Method of this Module in between. The item is only valid until then.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Item - Receives the address of the oldest item.
+    ItemSize - Receives the size of the item in bytes.
+
+Return Value:
+
+    STATUS_SUCCESS - The Client must call DMF_RingBuffer_ReadRelease().
+    STATUS_UNSUCCESSFUL - The Ring Buffer is empty. The Module is not locked.
+    STATUS_NOT_SUPPORTED - The Ring Buffer is a RingBuffer_Synchronization_MultipleProducerOverwrite
+                           Ring Buffer. The Module is not locked.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
+
+    *Item = NULL;
+    *ItemSize = 0;
+
+    if (RingBuffer_IsMultipleProducer(ringBuffer))
+    {
+        // Writers do not acquire the Module lock so they may overwrite the item in place.
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    if (RingBuffer_IsLockFree(ringBuffer))
+    {
+        // The producer never writes an item the consumer has not released, so no lock is needed.
+        //
+        DmfAssert(NULL == ringBuffer->PeekedItem);
+        ringBuffer->PeekedItem = RingBuffer_ConsumerItemGet(ringBuffer);
+        if (NULL == ringBuffer->PeekedItem)
+        {
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+        *Item = ringBuffer->PeekedItem;
+        *ItemSize = ringBuffer->ItemSize;
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    DMF_ModuleLock(DmfModule);
+
+    DmfAssert(NULL == ringBuffer->PeekedItem);
+    DmfAssert(ringBuffer->VariableSizeItems ||
+              (ringBuffer->ItemsPresentCount <= ringBuffer->ItemsCount));
+
+    if (0 == ringBuffer->ItemsPresentCount)
+    {
+        // There are no items in the buffer to read.
+        //
+        DmfAssert(ringBuffer->ReadPointer == ringBuffer->WritePointer);
+        DMF_ModuleUnlock(DmfModule);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    ringBuffer->PeekedItem = ringBuffer->ReadPointer;
+    if (ringBuffer->VariableSizeItems)
+    {
+        RING_BUFFER_RECORD_HEADER* header;
+
+        header = (RING_BUFFER_RECORD_HEADER*)ringBuffer->PeekedItem;
+        *Item = (UCHAR*)(header + 1);
+        *ItemSize = header->Size;
+    }
+    else
+    {
+        *Item = ringBuffer->PeekedItem;
+        *ItemSize = ringBuffer->ItemSize;
+    }
+
+    // The Module remains locked until DMF_RingBuffer_ReadRelease() is called.
+    //
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBuffer_ReadRelease(
+    _In_ _Requires_lock_held_(_Curr_) _Releases_lock_(_Curr_) _IRQL_restores_ DMFMODULE DmfModule,
+    _In_ BOOLEAN RemoveItem
+    )
+/*++
+
+Routine Description:
+
+    Finishes reading the item returned by DMF_RingBuffer_ReadPeek() and unlocks the Module.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    RemoveItem - TRUE to remove the item from the Ring Buffer (as DMF_RingBuffer_Read() does).
+                 FALSE to leave it as the oldest item.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
+
+    DmfAssert(ringBuffer->PeekedItem != NULL);
+
+    if (RingBuffer_IsLockFree(ringBuffer))
+    {
+        ringBuffer->PeekedItem = NULL;
+        if (RemoveItem)
+        {
+            RingBuffer_ConsumerItemRelease(ringBuffer);
         }
-        TargetBuffer += sizeOfEachItem;
-        entriesRead++;
-    } while (NT_SUCCESS(ntStatus));
+        return;
+    }
 
-    DmfAssert(BytesWritten != NULL);
-    *BytesWritten = entriesRead * sizeOfEachItem;
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    DmfAssert(ringBuffer->PeekedItem == ringBuffer->ReadPointer);
 
-    DMF_ModuleUnlock(DmfModule);
+    ringBuffer->PeekedItem = NULL;
 
-    return STATUS_SUCCESS;
+    if (RemoveItem)
+    {
+        if (ringBuffer->VariableSizeItems)
+        {
+            RingBuffer_RecordRemove(ringBuffer);
+        }
+        else
+        {
+            RingBuffer_ReadPointerIncrement(ringBuffer);
+        }
+    }
+
+    DMF_ModuleUnlock(DmfModule);
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
@@ -1135,6 +3943,10 @@ Routine Description:
     NOTE: This function is called in unlocked state since it is designed to be used by 
           crash dump processing. If you need to use this for other purpose, be sure
           to acquire this Module's lock!.
+          For RingBuffer_Synchronization_SingleProducerSingleConsumer neither the producer
+          nor the consumer may run while this Method executes.
+          For RingBuffer_Synchronization_MultipleProducerOverwrite writers may not run while this
+          Method executes. Items that were being written or were torn are removed.
 
 Arguments:
 
@@ -1149,11 +3961,7 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_RingBuffer* moduleContext;
-    UCHAR* addressToOverwrite;
-    UCHAR* addressOfDataToMove;
     UCHAR* endOfRingBuffer;
-    UCHAR* addressForSwap;
-    ULONG swapsNeeded;
     RING_BUFFER* ringBuffer;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
@@ -1170,19 +3978,79 @@ Return Value:
     moduleContext = DMF_CONTEXT_GET(DmfModule);
     ringBuffer = &moduleContext->RingBuffer;
 
-    // The beginning of the Ring Buffer's memory. This is the address of the first
-    // byte that will be output during a crash dump.
-    //
-    addressToOverwrite = ringBuffer->Items;
-    // The location of Read Pointer.
-    //
-    addressOfDataToMove = ringBuffer->ReadPointer;
+    if (RingBuffer_IsLockFree(ringBuffer))
+    {
+        // Translate the free running indexes so that the items can be reordered the same way.
+        //
+        ringBuffer->ItemsPresentCount = (ULONG)ringBuffer->Producer.Index - (ULONG)ringBuffer->Consumer.Index;
+        ringBuffer->ReadPointer = ringBuffer->Items + 
+                                  ((size_t)((ULONG)ringBuffer->Consumer.Index & ringBuffer->IndexMask) * (size_t)ringBuffer->ItemSize);
+        ringBuffer->WritePointer = ringBuffer->Items + 
+                                   ((size_t)((ULONG)ringBuffer->Producer.Index & ringBuffer->IndexMask) * (size_t)ringBuffer->ItemSize);
+    }
+
     // The end of the Ring Buffer data area.
     //
     endOfRingBuffer = ringBuffer->BufferEnd;
-    addressForSwap = endOfRingBuffer;
 
-    DmfAssert(ringBuffer->ItemsPresentCount <= ringBuffer->ItemsCount);
+    if (RingBuffer_IsMultipleProducer(ringBuffer))
+    {
+        ULONGLONG sequence;
+        ULONGLONG sequenceNext;
+        ULONGLONG sequenceBase;
+        ULONG itemIndex;
+
+        // Rotate the items so that the oldest item that may be present is at the beginning.
+        //
+        sequence = RingBuffer_SequenceOldestGet(ringBuffer,
+                                                &sequenceNext);
+        RingBuffer_BytesRotate(ringBuffer->Items,
+                               RingBuffer_SequenceItemGet(ringBuffer,
+                                                          sequence),
+                               endOfRingBuffer);
+
+        // Move the items that are complete down over the items that were being written or
+        // were torn. The stamps have not moved, so they are still found by sequence number.
+        //
+        ringBuffer->ItemsPresentCount = 0;
+        for (itemIndex = 0; (sequence + itemIndex) < sequenceNext; itemIndex++)
+        {
+            if (RingBuffer_SequenceIsComplete(ringBuffer,
+                                              sequence + itemIndex))
+            {
+                if (ringBuffer->ItemsPresentCount != itemIndex)
+                {
+                    RtlCopyMemory(ringBuffer->Items + ((size_t)ringBuffer->ItemsPresentCount * (size_t)ringBuffer->ItemSize),
+                                  ringBuffer->Items + ((size_t)itemIndex * (size_t)ringBuffer->ItemSize),
+                                  ringBuffer->ItemSize);
+                }
+                ringBuffer->ItemsPresentCount++;
+            }
+        }
+
+        // Give the items new sequence numbers that match their new slots. Sequence numbers
+        // never decrease, so start from the next multiple of ItemsCount.
+        //
+        sequenceBase = (sequenceNext + ringBuffer->IndexMask) & ~((ULONGLONG)ringBuffer->IndexMask);
+        for (itemIndex = 0; itemIndex < ringBuffer->ItemsCount; itemIndex++)
+        {
+            if (itemIndex < ringBuffer->ItemsPresentCount)
+            {
+                ringBuffer->Stamps[itemIndex] = RING_BUFFER_STAMP(sequenceBase + itemIndex,
+                                                                  RING_BUFFER_STAMP_COMPLETE);
+            }
+            else
+            {
+                ringBuffer->Stamps[itemIndex] = 0;
+            }
+        }
+        ringBuffer->ReadSequence = sequenceBase;
+        ringBuffer->WriteSequence.Next = (LONG64)(sequenceBase + ringBuffer->ItemsPresentCount);
+        goto Exit;
+    }
+
+    DmfAssert(ringBuffer->VariableSizeItems ||
+              (ringBuffer->ItemsPresentCount <= ringBuffer->ItemsCount));
     if (ringBuffer->ItemsPresentCount == 0)
     {
         // The buffer is empty. Nothing to reorder.
@@ -1191,40 +4059,43 @@ Return Value:
         goto Exit;
     }
 
-    // Copy all the items from the read pointer until the write pointer or until
-    // the end of the ring buffer.
-    //
-    // TODO: Swapping always happens leftward. An optimization would be to choose the
-    //       direction with fewest swaps. (m items swapped leftward n times require only
-    //       (m - n) swaps rightward.) Also, by adding conditions it is possible to 
-    //       reduce the number of shifts of empty spaces (by using Write - Items and 
-    //       adding checks for conditions).
-    //
-    swapsNeeded = (ULONG)((ringBuffer->ReadPointer - ringBuffer->Items) / ringBuffer->ItemSize);
-    while (swapsNeeded > 0)
+    if (ringBuffer->VariableSizeItems)
     {
-        // Copy entry to be overwritten to temporary swap location.
+        // Items do not have the same size, so rotate the bytes so that the oldest item is at the
+        // beginning. Padding that was at the end of the Ring Buffer stays between the same items.
         //
-        RtlCopyMemory(addressForSwap,
-                      addressToOverwrite,
-                      ringBuffer->ItemSize);
+        RingBuffer_BytesRotate(ringBuffer->Items,
+                               ringBuffer->ReadPointer,
+                               endOfRingBuffer);
+        ringBuffer->ReadPointer = ringBuffer->Items;
+        ringBuffer->WritePointer = ringBuffer->Items + ringBuffer->UsedBytes;
+        if (ringBuffer->WritePointer == endOfRingBuffer)
+        {
+            ringBuffer->WritePointer = ringBuffer->Items;
+        }
+        goto Exit;
+    }
 
-        // There is now space to shift, so shift.
+    // Move the oldest item to the beginning of the Ring Buffer's memory. This is the address of
+    // the first byte that will be output during a crash dump.
+    //
+    if (ringBuffer->ReadPointer < ringBuffer->WritePointer)
+    {
+        // The items do not wrap around, so they just move down. Stale data after them
+        // is erased below.
         //
-        UCHAR* addressOfDataToShift = addressToOverwrite + ringBuffer->ItemSize;
-        size_t bytesToMove = endOfRingBuffer - addressOfDataToShift;
-        RtlMoveMemory(addressToOverwrite,
-                      addressOfDataToShift,
-                      bytesToMove);
-
-        // Copy from temporary swap location to complete swap.
+        RtlMoveMemory(ringBuffer->Items,
+                      ringBuffer->ReadPointer,
+                      (size_t)ringBuffer->ItemsPresentCount * (size_t)ringBuffer->ItemSize);
+    }
+    else
+    {
+        // Rotate the whole Ring Buffer. Empty items between the Write Pointer and the
+        // Read Pointer end up after the newest item.
         //
-        UCHAR* destinationAddress = endOfRingBuffer - ringBuffer->ItemSize;
-        RtlCopyMemory(destinationAddress,
-                      addressForSwap,
-                      ringBuffer->ItemSize);
-
-        swapsNeeded--;
+        RingBuffer_BytesRotate(ringBuffer->Items,
+                               ringBuffer->ReadPointer,
+                               endOfRingBuffer);
     }
 
     // Update the Read and Write pointers.
@@ -1243,10 +4114,30 @@ Exit:
 
     // Erase all items that are not present. (Erase stale data.)
     //
-    ULONG numberOfItemsToClear =  ringBuffer->ItemsCount - ringBuffer->ItemsPresentCount;
-    UCHAR* eraseStartAddress = endOfRingBuffer - ((size_t)numberOfItemsToClear * (size_t)ringBuffer->ItemSize);
-    RtlZeroMemory(eraseStartAddress,
-                  ((size_t)numberOfItemsToClear * (size_t)ringBuffer->ItemSize));
+    if (ringBuffer->VariableSizeItems)
+    {
+        RtlZeroMemory(ringBuffer->Items + ringBuffer->UsedBytes,
+                      ringBuffer->TotalSize - ringBuffer->UsedBytes);
+    }
+    else
+    {
+        ULONG numberOfItemsToClear =  ringBuffer->ItemsCount - ringBuffer->ItemsPresentCount;
+        UCHAR* eraseStartAddress = endOfRingBuffer - ((size_t)numberOfItemsToClear * (size_t)ringBuffer->ItemSize);
+        RtlZeroMemory(eraseStartAddress,
+                      ((size_t)numberOfItemsToClear * (size_t)ringBuffer->ItemSize));
+    }
+
+    // Items have moved, so their slots in the key index are no longer correct.
+    //
+    RingBuffer_KeyIndexRebuild(ringBuffer);
+
+    if (RingBuffer_IsLockFree(ringBuffer))
+    {
+        ringBuffer->Consumer.Index = (LONG)((ringBuffer->ReadPointer - ringBuffer->Items) / ringBuffer->ItemSize);
+        ringBuffer->Consumer.OtherIndexCached = (ULONG)ringBuffer->Consumer.Index;
+        ringBuffer->Producer.Index = (LONG)((ULONG)ringBuffer->Consumer.Index + ringBuffer->ItemsPresentCount);
+        ringBuffer->Producer.OtherIndexCached = (ULONG)ringBuffer->Consumer.Index;
+    }
 
     if (Lock)
     {
@@ -1299,7 +4190,17 @@ Return Value:
     customItemProcessContext.NumberOfSegments = NumberOfSegments;
     customItemProcessContext.DataCopy = RingBuffer_ItemProcessCallbackRead;
 
-    DMF_ModuleLock(DmfModule);
+    if (moduleContext->RingBuffer.VariableSizeItems)
+    {
+        // Segments describe fixed size items.
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    RingBuffer_Lock(DmfModule,
+                    &moduleContext->RingBuffer);
 
     // 'Potential overflow using expression 'TargetBuffer''
     //
@@ -1309,7 +4210,10 @@ Return Value:
                                moduleContext->RingBuffer.ItemSize,
                                RingBuffer_ItemProcessCallbackSegments);
 
-    DMF_ModuleUnlock(DmfModule);
+    RingBuffer_Unlock(DmfModule,
+                      &moduleContext->RingBuffer);
+
+Exit:
 
     return ntStatus;
 }
@@ -1359,14 +4263,27 @@ Return Value:
     customItemProcessContext.NumberOfSegments = NumberOfSegments;
     customItemProcessContext.DataCopy = RingBuffer_ItemProcessCallbackWrite;
 
-    DMF_ModuleLock(DmfModule);
+    if (moduleContext->RingBuffer.VariableSizeItems)
+    {
+        // Segments describe fixed size items.
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    RingBuffer_Lock(DmfModule,
+                    &moduleContext->RingBuffer);
 
     ntStatus = RingBuffer_Write(&moduleContext->RingBuffer,
                                 (UCHAR*)&customItemProcessContext,
                                 moduleContext->RingBuffer.ItemSize,
                                 RingBuffer_ItemProcessCallbackSegments);
 
-    DMF_ModuleUnlock(DmfModule);
+    RingBuffer_Unlock(DmfModule,
+                      &moduleContext->RingBuffer);
+
+Exit:
 
     return ntStatus;
 }
@@ -1441,15 +4358,283 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DMF_ModuleLock(DmfModule);
-
     DmfAssert(SourceBufferSize <= moduleContext->RingBuffer.ItemSize);
+
+    if (RingBuffer_IsMultipleProducer(&moduleContext->RingBuffer))
+    {
+        // Writers never acquire the Module lock. It only serializes readers.
+        //
+        ntStatus = RingBuffer_Write(&moduleContext->RingBuffer,
+                                    SourceBuffer,
+                                    SourceBufferSize,
+                                    RingBuffer_ItemProcessCallbackWrite);
+        goto Exit;
+    }
+
+    RingBuffer_Lock(DmfModule,
+                    &moduleContext->RingBuffer);
+
     ntStatus = RingBuffer_Write(&moduleContext->RingBuffer,
                                 SourceBuffer,
                                 SourceBufferSize,
                                 RingBuffer_ItemProcessCallbackWrite);
 
+    RingBuffer_Unlock(DmfModule,
+                      &moduleContext->RingBuffer);
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBuffer_WriteCommit(
+    _In_ _Requires_lock_held_(_Curr_) _Releases_lock_(_Curr_) _IRQL_restores_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Adds the item returned by DMF_RingBuffer_WriteReserve() to the Ring Buffer and unlocks the Module.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
+
+    DmfAssert(ringBuffer->ReservedItem != NULL);
+
+    if (RingBuffer_IsLockFree(ringBuffer))
+    {
+        ringBuffer->ReservedItem = NULL;
+        RingBuffer_ProducerItemPublish(ringBuffer);
+        return;
+    }
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    DmfAssert(ringBuffer->ReservedItem == ringBuffer->WritePointer);
+
+    ringBuffer->ReservedItem = NULL;
+    RingBuffer_WritePointerIncrement(ringBuffer);
+
     DMF_ModuleUnlock(DmfModule);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_WriteMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(SourceBufferSize) UCHAR* SourceBuffer,
+    _In_ ULONG SourceBufferSize,
+    _Out_ ULONG* ItemsWritten
+    )
+/*++
+
+Routine Description:
+
+    Write several items to the Ring Buffer. The Module is locked only once and the items
+    are copied using at most two copies.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    SourceBuffer - Address of the items to write, one after another.
+    SourceBufferSize - Size in bytes of SourceBuffer. It must be a multiple of the size of each item.
+    ItemsWritten - Receives the number of items written. In RingBuffer_Mode_FailIfFullOnWrite
+                   it is less than the number of items in SourceBuffer if the Ring Buffer does not
+                   have space for all of them.
+
+Return Value:
+
+    STATUS_SUCCESS if at least one item was written.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is full (RingBuffer_Mode_FailIfFullOnWrite only).
+    STATUS_INVALID_PARAMETER if SourceBufferSize is not a multiple of the size of each item.
+    STATUS_NOT_SUPPORTED if the Ring Buffer contains variable size items.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+    ULONG itemCount;
+    BOOLEAN lock;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
+
+    *ItemsWritten = 0;
+
+    if (ringBuffer->VariableSizeItems)
+    {
+        // Items are not copied one after another if their size is not known.
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    itemCount = SourceBufferSize / ringBuffer->ItemSize;
+    if ((0 == itemCount) ||
+        ((itemCount * ringBuffer->ItemSize) != SourceBufferSize))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    // Writers of a RingBuffer_Synchronization_MultipleProducerOverwrite Ring Buffer never
+    // acquire the Module lock.
+    //
+    lock = (! RingBuffer_IsMultipleProducer(ringBuffer));
+    if (lock)
+    {
+        RingBuffer_Lock(DmfModule,
+                        ringBuffer);
+    }
+
+    ntStatus = RingBuffer_WriteMultiple(ringBuffer,
+                                        SourceBuffer,
+                                        itemCount,
+                                        ItemsWritten);
+
+    if (lock)
+    {
+        RingBuffer_Unlock(DmfModule,
+                          ringBuffer);
+    }
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_When_(NT_SUCCESS(return), _IRQL_raises_(DISPATCH_LEVEL))
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_WriteReserve(
+    _In_ _When_(NT_SUCCESS(return), _Acquires_lock_(_Curr_) _IRQL_saves_) DMFMODULE DmfModule,
+    _Out_ UCHAR** Item,
+    _Out_ ULONG* ItemSize
+    )
+/*++
+
+Routine Description:
+
+    Returns the address of the next item to write in the Ring Buffer so that the Client can build
+    the item in place instead of copying it from another buffer. The Module is locked until the
+    Client calls DMF_RingBuffer_WriteCommit() (except for RingBuffer_Synchronization_SingleProducerSingleConsumer
+    which does not lock).
+    NOTE: The Client must call DMF_RingBuffer_WriteCommit() as soon as possible and must not call
+          any other Method of this Module in between.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Item - Receives the address of the item to write.
+    ItemSize - Receives the size of the item in bytes.
+
+Return Value:
+
+    STATUS_SUCCESS - The Client must call DMF_RingBuffer_WriteCommit().
+    STATUS_UNSUCCESSFUL - The Ring Buffer is full (RingBuffer_Mode_FailIfFullOnWrite only). The Module is not locked.
+    STATUS_NOT_SUPPORTED - The Ring Buffer contains variable size items or is a
+                           RingBuffer_Synchronization_MultipleProducerOverwrite Ring Buffer.
+                           The Module is not locked.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
+
+    *Item = NULL;
+    *ItemSize = 0;
+
+    if (ringBuffer->VariableSizeItems)
+    {
+        // The size of the item is not known until it has been written.
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    if (RingBuffer_IsMultipleProducer(ringBuffer))
+    {
+        // Writers only publish items using DMF_RingBuffer_Write().
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    if (RingBuffer_IsLockFree(ringBuffer))
+    {
+        // The consumer never reads an item the producer has not committed, so no lock is needed.
+        //
+        DmfAssert(NULL == ringBuffer->ReservedItem);
+        ringBuffer->ReservedItem = RingBuffer_ProducerItemGet(ringBuffer);
+        if (NULL == ringBuffer->ReservedItem)
+        {
+            // Ring Buffer is Full. This is an error condition.
+            //
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+        *Item = ringBuffer->ReservedItem;
+        *ItemSize = ringBuffer->ItemSize;
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    DMF_ModuleLock(DmfModule);
+
+    DmfAssert(NULL == ringBuffer->ReservedItem);
+
+    // In RingBuffer_Mode_DeleteOldestIfFullOnWrite the oldest item is deleted now because its
+    // space is handed to the Client.
+    //
+    ntStatus = RingBuffer_WriteSpaceMake(ringBuffer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        DMF_ModuleUnlock(DmfModule);
+        goto Exit;
+    }
+
+    ringBuffer->ReservedItem = ringBuffer->WritePointer;
+    *Item = ringBuffer->ReservedItem;
+    *ItemSize = ringBuffer->ItemSize;
+
+    // The Module remains locked until DMF_RingBuffer_WriteCommit() is called.
+    //
+
+Exit:
 
     return ntStatus;
 }
@@ -35,19 +35,58 @@ typedef enum
     RingBuffer_Mode_Maximum,
 } RingBuffer_ModeType;
 
+// These definitions indicate how access to the Ring Buffer is synchronized.
+//
+typedef enum
+{
+    // Every Method acquires the Module lock. Any number of callers may read and write concurrently.
+    //
+    RingBuffer_Synchronization_Lock = 0,
+    // There is exactly one writer and exactly one reader. They may run concurrently with each
+    // other, but never with themselves. Read and Write do not acquire the Module lock.
+    // ItemCount must be a power of two and Mode must be RingBuffer_Mode_FailIfFullOnWrite.
+    //
+    RingBuffer_Synchronization_SingleProducerSingleConsumer,
+    // Any number of writers write concurrently without acquiring the Module lock. The oldest item
+    // is always overwritten. Readers acquire the Module lock, stop at items that are being written
+    // and skip items that were torn.
+    // Intended for Ring Buffers that are mostly read when a crash dump is written.
+    // DMF_RingBuffer_ReadPeek() and DMF_RingBuffer_WriteReserve() are not supported.
+    // ItemCount must be a power of two and Mode must be RingBuffer_Mode_DeleteOldestIfFullOnWrite.
+    //
+    RingBuffer_Synchronization_MultipleProducerOverwrite,
+    RingBuffer_Synchronization_Maximum,
+} RingBuffer_SynchronizationType;
+
 // Client uses this structure to configure the Module specific parameters.
 //
 typedef struct
 {
     // Maximum number of entries to store.
+    // If VariableSizeItems is TRUE, the number of maximum size entries the Ring Buffer can store.
     //
     ULONG ItemCount;
     // The size of each entry.
+    // If VariableSizeItems is TRUE, the maximum size of each entry.
     //
     ULONG ItemSize;
     // Indicates the mode of the Ring Buffer. 
     //
     RingBuffer_ModeType Mode;
+    // Indicates how access to the Ring Buffer is synchronized.
+    //
+    RingBuffer_SynchronizationType Synchronization;
+    // Indicates that each entry only uses as much space as the data written to it
+    // (plus a small header). Only RingBuffer_Synchronization_Lock is supported.
+    //
+    BOOLEAN VariableSizeItems;
+    // Offset and size in bytes of a key inside each entry. If KeySize is not zero, an index of
+    // the keys is maintained so that DMF_RingBuffer_EnumerateToFindItem() only compares entries
+    // that have the same key. Only RingBuffer_Synchronization_Lock with fixed size entries
+    // is supported.
+    //
+    ULONG KeyOffset;
+    ULONG KeySize;
 } DMF_CONFIG_RingBuffer;
 
 // This macro declares the following functions:
@@ -111,6 +150,46 @@ DMF_RingBuffer_ReadAll(
     _Out_ ULONG* BytesWritten
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadEx(
+    _In_ DMFMODULE DmfModule,
+    _Out_writes_(TargetBufferSize) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize,
+    _Out_ ULONG* BytesRead
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadMultiple(
+    _In_ DMFMODULE DmfModule,
+    _Out_writes_(TargetBufferSize) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize,
+    _Out_ ULONG* ItemsRead
+    );
+
+// If DMF_RingBuffer_ReadPeek() succeeds, the caller holds the Module lock, and runs at IRQL
+// DISPATCH_LEVEL, until it calls DMF_RingBuffer_ReadRelease().
+//
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_When_(NT_SUCCESS(return), _IRQL_raises_(DISPATCH_LEVEL))
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadPeek(
+    _In_ _When_(NT_SUCCESS(return), _Acquires_lock_(_Curr_) _IRQL_saves_) DMFMODULE DmfModule,
+    _Out_ UCHAR** Item,
+    _Out_ ULONG* ItemSize
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBuffer_ReadRelease(
+    _In_ _Requires_lock_held_(_Curr_) _Releases_lock_(_Curr_) _IRQL_restores_ DMFMODULE DmfModule,
+    _In_ BOOLEAN RemoveItem
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 DMF_RingBuffer_Reorder(
@@ -156,5 +235,34 @@ DMF_RingBuffer_Write(
     _In_ ULONG SourceBufferSize
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBuffer_WriteCommit(
+    _In_ _Requires_lock_held_(_Curr_) _Releases_lock_(_Curr_) _IRQL_restores_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_WriteMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(SourceBufferSize) UCHAR* SourceBuffer,
+    _In_ ULONG SourceBufferSize,
+    _Out_ ULONG* ItemsWritten
+    );
+
+// If DMF_RingBuffer_WriteReserve() succeeds, the caller holds the Module lock, and runs at IRQL
+// DISPATCH_LEVEL, until it calls DMF_RingBuffer_WriteCommit().
+//
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_When_(NT_SUCCESS(return), _IRQL_raises_(DISPATCH_LEVEL))
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_WriteReserve(
+    _In_ _When_(NT_SUCCESS(return), _Acquires_lock_(_Curr_) _IRQL_saves_) DMFMODULE DmfModule,
+    _Out_ UCHAR** Item,
+    _Out_ ULONG* ItemSize
+    );
+
 // eof: Dmf_RingBuffer.h
 //
@@ -35,14 +35,47 @@ Environment:
 
 typedef struct
 {
-    // Optional Status.
+    // Status of the work.
     //
-    NTSTATUS* NtStatus;
-    // Optional event if caller wants to wait.
+    NTSTATUS NtStatus;
+    // Signaled when the work is done.
     //
-    DMF_PORTABLE_EVENT* Event;
+    DMF_PORTABLE_COMPLETION Completion;
+} ThreadedBufferQueue_WaitBlock;
+
+typedef struct
+{
+    // Set when the thread that enqueued the work waits for it to be done. In that case,
+    // the buffer is handed back to that thread (instead of returned to the Producer List)
+    // when the work is done.
+    // The wait block is on the stack of the waiting thread (not in the buffer) because the
+    // buffers may be allocated from paged pool and the completion must be in nonpaged memory.
+    //
+    ThreadedBufferQueue_WaitBlock* WaitBlock;
 } ThreadedBufferQueue_WorkBufferInternal;
 
+typedef struct
+{
+    // Thread that reads BufferQueue to get work and return buffers.
+    //
+    DMFMODULE DmfModuleThread;
+    // Work buffers enqueued with a key that maps to this worker. Only this worker
+    // dequeues them so that work with the same key is done in order.
+    // Only created when there are several workers.
+    //
+    DMFMODULE DmfModuleBufferPoolKeyed;
+    // Indicates the worker is doing work so that another worker is preferably woken up.
+    //
+    volatile LONG IsBusy;
+    // Affinity of the thread before this Module set WorkerThreadAffinity.
+    //
+#if defined(DMF_USER_MODE)
+    DWORD_PTR PreviousAffinity;
+#else
+    KAFFINITY PreviousAffinity;
+#endif
+} ThreadedBufferQueue_Worker;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -53,9 +86,13 @@ typedef struct _DMF_CONTEXT_ThreadedBufferQueue
     // BufferQueue that holds empty buffers and pending work.
     //
     DMFMODULE DmfModuleBufferQueue;
-    // Thread that reads BufferQueue to get work and return buffers.
+    // Threads that read BufferQueue to get work and return buffers.
     //
-    DMFMODULE DmfModuleThread;
+    ThreadedBufferQueue_Worker Workers[ThreadedBufferQueue_WorkerThreadsMaximum];
+    ULONG NumberOfWorkers;
+    // Worker that is woken up by the next call to ThreadedBufferQueue_WorkReady.
+    //
+    volatile LONG WorkerWakeCursor;
 } DMF_CONTEXT_ThreadedBufferQueue;
 
 // This macro declares the following function:
@@ -72,6 +109,10 @@ DMF_MODULE_DECLARE_CONFIG(ThreadedBufferQueue)
 //
 #define MemoryTag 'MQBT'
 
+// Number of pending work buffers removed at a time by DMF_ThreadedBufferQueue_Flush.
+//
+#define ThreadedBufferQueue_FlushBatchSize  32
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // DMF Module Support Code
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -129,6 +170,97 @@ Return Value:
     return ThreadedBufferQueueBufferInternal + 1;
 }
 
+_Must_inspect_result_
+BOOLEAN
+ThreadedBufferQueue_WorkCompletedNotify(
+    _In_ ThreadedBufferQueue_WorkBufferInternal* ThreadedBufferQueueBufferInternal,
+    _In_ NTSTATUS NtStatus
+    )
+/*++
+
+Routine Description:
+
+    Tell the thread that enqueued a work buffer (if it waits) that the work is done.
+
+Arguments:
+
+    ThreadedBufferQueueBufferInternal - Internal buffer that contains the work that was pended.
+    NtStatus - Status indicating result of work.
+
+Return Value:
+
+    TRUE if the buffer has been handed back to the thread that waits. Caller must not access the buffer.
+    FALSE if caller must return the buffer to the Producer List.
+
+--*/
+{
+    BOOLEAN bufferHandedBack;
+    ThreadedBufferQueue_WaitBlock* waitBlock;
+
+    waitBlock = ThreadedBufferQueueBufferInternal->WaitBlock;
+    if (waitBlock != NULL)
+    {
+        // Write back to calling thread before waking it up. From then on, the calling thread
+        // owns the buffer and returns it to the Producer List.
+        //
+        waitBlock->NtStatus = NtStatus;
+        DMF_Portable_Completion_Signal(&waitBlock->Completion);
+        bufferHandedBack = TRUE;
+    }
+    else
+    {
+        bufferHandedBack = FALSE;
+    }
+
+    return bufferHandedBack;
+}
+
+ULONG
+ThreadedBufferQueue_WorkCompletedNotifyMultiple(
+    _Inout_updates_(NumberOfWorkBuffers) ThreadedBufferQueue_WorkBufferInternal** ThreadedBufferQueueBuffersInternal,
+    _In_reads_opt_(NumberOfWorkBuffers) NTSTATUS* NtStatuses,
+    _In_ NTSTATUS NtStatus,
+    _In_ ULONG NumberOfWorkBuffers
+    )
+/*++
+
+Routine Description:
+
+    Tell the threads that enqueued several work buffers (if they wait) that the work is done.
+    Buffers handed back to waiting threads are removed from the given array so that the
+    remaining buffers can be returned to the Producer List.
+
+Arguments:
+
+    ThreadedBufferQueueBuffersInternal - Internal buffers that contain the work that was done.
+    NtStatuses - Optional status indicating result of work for each buffer.
+    NtStatus - Status indicating result of work for all buffers if NtStatuses is NULL.
+    NumberOfWorkBuffers - Number of buffers in ThreadedBufferQueueBuffersInternal.
+
+Return Value:
+
+    Number of buffers left at the start of ThreadedBufferQueueBuffersInternal that caller must
+    return to the Producer List.
+
+--*/
+{
+    ULONG workBufferIndex;
+    ULONG numberOfWorkBuffersToReuse;
+
+    numberOfWorkBuffersToReuse = 0;
+    for (workBufferIndex = 0; workBufferIndex < NumberOfWorkBuffers; workBufferIndex++)
+    {
+        if (! ThreadedBufferQueue_WorkCompletedNotify(ThreadedBufferQueueBuffersInternal[workBufferIndex],
+                                                      (NtStatuses != NULL) ? NtStatuses[workBufferIndex] : NtStatus))
+        {
+            ThreadedBufferQueueBuffersInternal[numberOfWorkBuffersToReuse] = ThreadedBufferQueueBuffersInternal[workBufferIndex];
+            numberOfWorkBuffersToReuse++;
+        }
+    }
+
+    return numberOfWorkBuffersToReuse;
+}
+
 VOID
 ThreadedBufferQueue_WorkCompleted(
     _In_ DMFMODULE DmfModule,
@@ -159,27 +291,146 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    // Write back to calling thread before setting calling thread event.
-    //
-    if (ThreadedBufferQueueBufferInternal->NtStatus != NULL)
+    if (! ThreadedBufferQueue_WorkCompletedNotify(ThreadedBufferQueueBufferInternal,
+                                                  NtStatus))
     {
-        *ThreadedBufferQueueBufferInternal->NtStatus = NtStatus;
+        // Return the buffer back to pool of available buffers.
+        //
+        DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueue,
+                              ThreadedBufferQueueBufferInternal);
     }
 
-    // Wake up calling thread.
+    FuncExitVoid(DMF_TRACE);
+}
+
+VOID
+ThreadedBufferQueue_WorkCompletedMultiple(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(NumberOfWorkBuffers) ThreadedBufferQueue_WorkBufferInternal** ThreadedBufferQueueBuffersInternal,
+    _In_reads_(NumberOfWorkBuffers) NTSTATUS* NtStatuses,
+    _In_ ULONG NumberOfWorkBuffers
+    )
+/*++
+
+Routine Description:
+
+    Complete work for several work buffers and return them to the Producer List using a
+    single acquisition of its lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ThreadedBufferQueueBuffersInternal - Internal buffers that contain the work that was done.
+                                         NOTE: The contents of this array are modified.
+    NtStatuses - Status indicating result of work for each buffer.
+    NumberOfWorkBuffers - Number of buffers in ThreadedBufferQueueBuffersInternal.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+    ULONG numberOfWorkBuffersToReuse;
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    numberOfWorkBuffersToReuse = ThreadedBufferQueue_WorkCompletedNotifyMultiple(ThreadedBufferQueueBuffersInternal,
+                                                                                 NtStatuses,
+                                                                                 STATUS_SUCCESS,
+                                                                                 NumberOfWorkBuffers);
+
+    // Return the buffers back to pool of available buffers.
     //
-    if (ThreadedBufferQueueBufferInternal->Event != NULL)
+    if (numberOfWorkBuffersToReuse > 0)
     {
-        DMF_Portable_EventSet(ThreadedBufferQueueBufferInternal->Event);
+        DMF_BufferQueue_ReuseMultiple(moduleContext->DmfModuleBufferQueue,
+                                      (VOID**)ThreadedBufferQueueBuffersInternal,
+                                      numberOfWorkBuffersToReuse);
     }
 
+    FuncExitVoid(DMF_TRACE);
+}
+
+VOID
+ThreadedBufferQueue_WaitPrepare(
+    _In_ ThreadedBufferQueue_WorkBufferInternal* ThreadedBufferQueueBufferInternal,
+    _Out_ ThreadedBufferQueue_WaitBlock* WaitBlock
+    )
+/*++
+
+Routine Description:
+
+    Prepare a work buffer so that the thread that enqueues it can wait for the work to be done.
+    The wait block is on the stack of that thread so that nothing is allocated.
+
+Arguments:
+
+    ThreadedBufferQueueBufferInternal - Internal buffer that contains the work to do.
+    WaitBlock - Wait block on the stack of the thread that waits.
+
+Return Value:
+
+    None
+
+--*/
+{
+    WaitBlock->NtStatus = STATUS_PENDING;
+    DMF_Portable_Completion_Initialize(&WaitBlock->Completion);
+    ThreadedBufferQueueBufferInternal->WaitBlock = WaitBlock;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+ThreadedBufferQueue_WaitForCompletion(
+    _In_ DMFMODULE DmfModule,
+    _In_ ThreadedBufferQueue_WorkBufferInternal* ThreadedBufferQueueBufferInternal,
+    _Inout_ ThreadedBufferQueue_WaitBlock* WaitBlock
+    )
+/*++
+
+Routine Description:
+
+    Wait for the work in a work buffer prepared using ThreadedBufferQueue_WaitPrepare() to be done.
+    Then, return the work buffer (which has been handed back to this thread) to the Producer List.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ThreadedBufferQueueBufferInternal - Internal buffer that contains the work that was enqueued.
+    WaitBlock - Wait block passed to ThreadedBufferQueue_WaitPrepare().
+
+Return Value:
+
+    NTSTATUS of the work.
+
+--*/
+{
+    DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Infinite wait for the work to execute.
+    //
+    DMF_Portable_Completion_Wait(&WaitBlock->Completion);
+
+    ntStatus = WaitBlock->NtStatus;
+
     // Return the buffer back to pool of available buffers.
     //
     DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueue,
                           ThreadedBufferQueueBufferInternal);
 
-    FuncExitVoid(DMF_TRACE);
+    return ntStatus;
 }
+#pragma code_seg()
 
 _Function_class_(EVT_DMF_BufferQueue_ReuseCleanup)
 VOID
@@ -240,6 +491,263 @@ Return Value:
     FuncExitVoid(DMF_TRACE);
 }
 
+ThreadedBufferQueue_Worker*
+ThreadedBufferQueue_WorkerGet(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMFMODULE DmfModuleThread
+    )
+/*++
+
+Routine Description:
+
+    Given a worker's Thread Module, get the corresponding worker.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    DmfModuleThread - The given worker's Thread Module.
+
+Return Value:
+
+    The corresponding worker.
+
+--*/
+{
+    DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+    ThreadedBufferQueue_Worker* worker;
+    ULONG workerIndex;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    worker = NULL;
+    for (workerIndex = 0; workerIndex < moduleContext->NumberOfWorkers; workerIndex++)
+    {
+        if (moduleContext->Workers[workerIndex].DmfModuleThread == DmfModuleThread)
+        {
+            worker = &moduleContext->Workers[workerIndex];
+            break;
+        }
+    }
+
+    DmfAssert(worker != NULL);
+
+    return worker;
+}
+
+VOID
+ThreadedBufferQueue_WorkPropagate(
+    _In_ DMFMODULE DmfModule,
+    _In_ ThreadedBufferQueue_Worker* Worker
+    )
+/*++
+
+Routine Description:
+
+    Called by a worker that has just dequeued work from the shared Consumer List. If there is more
+    work in that list, the next worker is woken up so that idle workers help with that work.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Worker - The worker that has just dequeued work.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+    ULONG workerIndex;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if ((moduleContext->NumberOfWorkers > 1) &&
+        (DMF_BufferQueue_Count(moduleContext->DmfModuleBufferQueue) > 0))
+    {
+        workerIndex = (ULONG)(Worker - moduleContext->Workers);
+        workerIndex = (workerIndex + 1) % moduleContext->NumberOfWorkers;
+        DMF_Thread_WorkReady(moduleContext->Workers[workerIndex].DmfModuleThread);
+    }
+}
+
+_Must_inspect_result_
+NTSTATUS
+ThreadedBufferQueue_WorkDequeue(
+    _In_ DMFMODULE DmfModule,
+    _In_ ThreadedBufferQueue_Worker* Worker,
+    _In_ ULONG NumberOfWorkBuffersRequested,
+    _Out_writes_to_(NumberOfWorkBuffersRequested, *NumberOfWorkBuffers) ThreadedBufferQueue_WorkBufferInternal** WorkBuffers,
+    _Out_writes_(NumberOfWorkBuffersRequested) VOID** ClientWorkBufferContexts,
+    _Out_ ULONG* NumberOfWorkBuffers
+    )
+/*++
+
+Routine Description:
+
+    Dequeues the next work buffers of a given worker. Work enqueued with a key that maps to the
+    worker is dequeued first. Otherwise, work is dequeued from the shared Consumer List.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Worker - The given worker.
+    NumberOfWorkBuffersRequested - Maximum number of work buffers to dequeue.
+    WorkBuffers - The dequeued work buffers.
+    ClientWorkBufferContexts - Client contexts associated with the dequeued work buffers.
+    NumberOfWorkBuffers - Number of dequeued work buffers.
+
+Return Value:
+
+    STATUS_SUCCESS if at least one work buffer is dequeued.
+    Otherwise, there is no work for the worker.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (Worker->DmfModuleBufferPoolKeyed != NULL)
+    {
+        ntStatus = DMF_BufferPool_GetMultiple(Worker->DmfModuleBufferPoolKeyed,
+                                              NumberOfWorkBuffersRequested,
+                                              (VOID**)WorkBuffers,
+                                              ClientWorkBufferContexts,
+                                              NumberOfWorkBuffers);
+        if (NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+
+    ntStatus = DMF_BufferQueue_DequeueMultiple(moduleContext->DmfModuleBufferQueue,
+                                               NumberOfWorkBuffersRequested,
+                                               (VOID**)WorkBuffers,
+                                               ClientWorkBufferContexts,
+                                               NumberOfWorkBuffers);
+    if (NT_SUCCESS(ntStatus))
+    {
+        ThreadedBufferQueue_WorkPropagate(DmfModule,
+                                          Worker);
+    }
+
+Exit:
+
+    return ntStatus;
+}
+
+#pragma code_seg("PAGE")
+VOID
+ThreadedBufferQueue_WorkBatchDo(
+    _In_ DMFMODULE DmfModule,
+    _In_ ThreadedBufferQueue_Worker* Worker
+    )
+/*++
+
+Routine Description:
+
+    Dequeues up to WorkBatchSize work buffers at a time from the Consumer List and sends them to
+    the Client in a single call. Then, returns the work buffers to the Producer List in a single call.
+    This is repeated until there is no more work or the Client pends the work buffers.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Worker - The worker that does the work.
+
+Return Value:
+
+    None
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONFIG_ThreadedBufferQueue* moduleConfig;
+    ThreadedBufferQueue_WorkBufferInternal* workBuffers[ThreadedBufferQueue_WorkBatchSizeMaximum];
+    UCHAR* clientWorkBuffers[ThreadedBufferQueue_WorkBatchSizeMaximum];
+    VOID* clientWorkBufferContexts[ThreadedBufferQueue_WorkBatchSizeMaximum];
+    NTSTATUS ntStatuses[ThreadedBufferQueue_WorkBatchSizeMaximum];
+    ULONG workBatchSize;
+    ULONG numberOfWorkBuffers;
+    ULONG workBufferIndex;
+    ThreadedBufferQueue_BufferDisposition bufferDisposition;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    workBatchSize = moduleConfig->WorkBatchSize;
+    if ((0 == workBatchSize) ||
+        (workBatchSize > ThreadedBufferQueue_WorkBatchSizeMaximum))
+    {
+        workBatchSize = ThreadedBufferQueue_WorkBatchSizeMaximum;
+    }
+
+    for (;;)
+    {
+        // Get the buffers that contain the work the Client wants to do.
+        //
+        ntStatus = ThreadedBufferQueue_WorkDequeue(DmfModule,
+                                                   Worker,
+                                                   workBatchSize,
+                                                   workBuffers,
+                                                   clientWorkBufferContexts,
+                                                   &numberOfWorkBuffers);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            // NOTE: Failure is expected and normal. It means there is no more work to do.
+            //       This is how the loop exits.
+            //
+            break;
+        }
+
+        // The Client just gets the Client's buffers, not the meta data used by this Module.
+        //
+        for (workBufferIndex = 0; workBufferIndex < numberOfWorkBuffers; workBufferIndex++)
+        {
+            clientWorkBuffers[workBufferIndex] = (UCHAR*)ThreadedBufferQueueBuffer_InternalToClient(workBuffers[workBufferIndex]);
+            ntStatuses[workBufferIndex] = STATUS_SUCCESS;
+        }
+
+        // Allow the Client to do the work based on work buffers contents.
+        //
+        bufferDisposition = moduleConfig->EvtThreadedBufferQueueWorkBatch(DmfModule,
+                                                                          clientWorkBuffers,
+                                                                          clientWorkBufferContexts,
+                                                                          numberOfWorkBuffers,
+                                                                          moduleConfig->BufferQueueConfig.SourceSettings.BufferSize,
+                                                                          ntStatuses);
+        if (ThreadedBufferQueue_BufferDisposition_WorkComplete == bufferDisposition)
+        {
+            // Client no longer owns the buffers.
+            //
+            ThreadedBufferQueue_WorkCompletedMultiple(DmfModule,
+                                                      workBuffers,
+                                                      ntStatuses,
+                                                      numberOfWorkBuffers);
+        }
+        else if (ThreadedBufferQueue_BufferDisposition_WorkPending == bufferDisposition)
+        {
+            // Client owns the buffers and must return them using DMF_ThreadedBufferQueue_WorkCompletedMultiple()
+            // or DMF_ThreadedBufferQueue_WorkCompleted(). Do not retrieve the next buffers.
+            // (If Client wants to retrieve next buffers, Client should set this Module's work ready event.)
+            //
+            break;
+        }
+        else
+        {
+            DmfAssert(FALSE);
+        }
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _Function_class_(EVT_DMF_Thread_Function)
 VOID
@@ -250,9 +758,9 @@ ThreadedBufferQueueThreadCallback(
 
 Routine Description:
 
-    The underlying Thread calls this function when work is available. It dequeues the work buffer
-    from the Consumer List and sends the work buffer to the Client. Then, it returns the work
-    buffer to the Producer List.
+    The underlying Thread of a worker calls this function when work is available. It dequeues the
+    work buffer from the Consumer List and sends the work buffer to the Client. Then, it returns
+    the work buffer to the Producer List.
 
 Arguments:
 
@@ -266,27 +774,43 @@ Return Value:
 {
     NTSTATUS ntStatus;
     ThreadedBufferQueue_WorkBufferInternal* workBuffer;
-    DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
     DMF_CONFIG_ThreadedBufferQueue* moduleConfig;
     VOID* clientWorkBuffer;
     VOID* clientWorkBufferContext;
     DMFMODULE dmfModuleThreadedBufferQueue;
+    ThreadedBufferQueue_Worker* worker;
+    ULONG numberOfWorkBuffers;
 
     PAGED_CODE();
 
     FuncEntry(DMF_TRACE);
 
     dmfModuleThreadedBufferQueue = DMF_ParentModuleGet(DmfModule);
-    moduleContext = DMF_CONTEXT_GET(dmfModuleThreadedBufferQueue);
     moduleConfig = DMF_CONFIG_GET(dmfModuleThreadedBufferQueue);
 
+    worker = ThreadedBufferQueue_WorkerGet(dmfModuleThreadedBufferQueue,
+                                           DmfModule);
+
+    InterlockedExchange(&worker->IsBusy,
+                        TRUE);
+
+    if (moduleConfig->EvtThreadedBufferQueueWorkBatch != NULL)
+    {
+        ThreadedBufferQueue_WorkBatchDo(dmfModuleThreadedBufferQueue,
+                                        worker);
+        goto Exit;
+    }
+
 Start:
 
     // Get a buffer that contains the work the Client wants to do.
     //
-    ntStatus = DMF_BufferQueue_Dequeue(moduleContext->DmfModuleBufferQueue,
-                                       (VOID**)&workBuffer,
-                                       &clientWorkBufferContext);
+    ntStatus = ThreadedBufferQueue_WorkDequeue(dmfModuleThreadedBufferQueue,
+                                               worker,
+                                               1,
+                                               &workBuffer,
+                                               &clientWorkBufferContext,
+                                               &numberOfWorkBuffers);
     if (! NT_SUCCESS(ntStatus))
     {
         // NOTE: Failure is expected and normal. It means there is no more work to do.
@@ -332,7 +856,127 @@ Start:
     goto Start;
 
 Exit:
-    ;
+
+    InterlockedExchange(&worker->IsBusy,
+                        FALSE);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+VOID
+ThreadedBufferQueueThreadPreCallback(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Called by the underlying Thread of a worker before it starts looping. It sets the processor
+    affinity of the worker's thread. Then, it calls the Client's callback, if any.
+
+Arguments:
+
+    DmfModule - The Child Module from which this callback is called.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+    DMF_CONFIG_ThreadedBufferQueue* moduleConfig;
+    DMFMODULE dmfModuleThreadedBufferQueue;
+    ThreadedBufferQueue_Worker* worker;
+    ULONG workerIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    dmfModuleThreadedBufferQueue = DMF_ParentModuleGet(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(dmfModuleThreadedBufferQueue);
+    moduleConfig = DMF_CONFIG_GET(dmfModuleThreadedBufferQueue);
+
+    worker = ThreadedBufferQueue_WorkerGet(dmfModuleThreadedBufferQueue,
+                                           DmfModule);
+    workerIndex = (ULONG)(worker - moduleContext->Workers);
+    DmfAssert(moduleConfig->WorkerThreadAffinity[workerIndex] != 0);
+
+#if defined(DMF_USER_MODE)
+    worker->PreviousAffinity = SetThreadAffinityMask(GetCurrentThread(),
+                                                     (DWORD_PTR)moduleConfig->WorkerThreadAffinity[workerIndex]);
+    if (0 == worker->PreviousAffinity)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "SetThreadAffinityMask fails: workerIndex=%d GetLastError=%d", workerIndex, GetLastError());
+    }
+#else
+    worker->PreviousAffinity = KeSetSystemAffinityThreadEx((KAFFINITY)moduleConfig->WorkerThreadAffinity[workerIndex]);
+#endif
+
+    if (moduleConfig->EvtThreadedBufferQueuePre != NULL)
+    {
+        moduleConfig->EvtThreadedBufferQueuePre(DmfModule);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+VOID
+ThreadedBufferQueueThreadPostCallback(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Called by the underlying Thread of a worker after it stops looping. It calls the Client's
+    callback, if any. Then, it restores the processor affinity of the worker's thread.
+
+Arguments:
+
+    DmfModule - The Child Module from which this callback is called.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONFIG_ThreadedBufferQueue* moduleConfig;
+    DMFMODULE dmfModuleThreadedBufferQueue;
+    ThreadedBufferQueue_Worker* worker;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    dmfModuleThreadedBufferQueue = DMF_ParentModuleGet(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(dmfModuleThreadedBufferQueue);
+
+    worker = ThreadedBufferQueue_WorkerGet(dmfModuleThreadedBufferQueue,
+                                           DmfModule);
+
+    if (moduleConfig->EvtThreadedBufferQueuePost != NULL)
+    {
+        moduleConfig->EvtThreadedBufferQueuePost(DmfModule);
+    }
+
+#if defined(DMF_USER_MODE)
+    if (worker->PreviousAffinity != 0)
+    {
+        SetThreadAffinityMask(GetCurrentThread(),
+                              worker->PreviousAffinity);
+    }
+#else
+    KeRevertToUserAffinityThreadEx(worker->PreviousAffinity);
+#endif
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -346,7 +990,9 @@ ThreadedBufferQueue_WorkReady(
 
 Routine Description:
 
-    Sets the work ready event.
+    Sets the work ready event of the next worker that is not busy (or of the next worker if they
+    are all busy). Each worker does work until the Consumer List is empty and wakes up the next
+    worker if there is more work, so waking up one worker is enough.
 
 Arguments:
 
@@ -359,16 +1005,95 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+    ULONG firstWorkerIndex;
+    ULONG workerOffset;
+    ULONG workerIndex;
 
     FuncEntry(DMF_TRACE);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DMF_Thread_WorkReady(moduleContext->DmfModuleThread);
+    workerIndex = 0;
+    if (moduleContext->NumberOfWorkers > 1)
+    {
+        firstWorkerIndex = (ULONG)InterlockedIncrement(&moduleContext->WorkerWakeCursor) % moduleContext->NumberOfWorkers;
+        workerIndex = firstWorkerIndex;
+        for (workerOffset = 0; workerOffset < moduleContext->NumberOfWorkers; workerOffset++)
+        {
+            workerIndex = (firstWorkerIndex + workerOffset) % moduleContext->NumberOfWorkers;
+            if (! ReadNoFence(&moduleContext->Workers[workerIndex].IsBusy))
+            {
+                break;
+            }
+        }
+        if (workerOffset == moduleContext->NumberOfWorkers)
+        {
+            workerIndex = firstWorkerIndex;
+        }
+    }
+
+    DMF_Thread_WorkReady(moduleContext->Workers[workerIndex].DmfModuleThread);
 
     FuncExitVoid(DMF_TRACE);
 }
 
+VOID
+ThreadedBufferQueue_KeyedEnqueue(
+    _In_ DMFMODULE DmfModule,
+    _In_ ThreadedBufferQueue_WorkBufferInternal* ThreadedBufferQueueBufferInternal,
+    _In_ ULONG_PTR Key
+    )
+/*++
+
+Routine Description:
+
+    Adds a work buffer to the list of the worker that the given key maps to and sets that
+    worker's work ready event. Work buffers with the same key are always done by the same
+    worker, in the order they are enqueued.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ThreadedBufferQueueBufferInternal - The internal buffer to add.
+    Key - The given key.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+    ULONG workerIndex;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (1 == moduleContext->NumberOfWorkers)
+    {
+        // The only worker does all the work in order.
+        //
+        DMF_BufferQueue_Enqueue(moduleContext->DmfModuleBufferQueue,
+                                ThreadedBufferQueueBufferInternal);
+        ThreadedBufferQueue_WorkReady(DmfModule);
+        goto Exit;
+    }
+
+    // Multiplicative hash so that keys that are aligned pointers or consecutive
+    // numbers are spread across the workers.
+    //
+    workerIndex = (ULONG)((((ULONGLONG)Key) * 0x9E3779B97F4A7C15ULL) >> 32) % moduleContext->NumberOfWorkers;
+
+    DmfAssert(moduleContext->Workers[workerIndex].DmfModuleBufferPoolKeyed != NULL);
+    DMF_BufferPool_Put(moduleContext->Workers[workerIndex].DmfModuleBufferPoolKeyed,
+                       ThreadedBufferQueueBufferInternal);
+
+    DMF_Thread_WorkReady(moduleContext->Workers[workerIndex].DmfModuleThread);
+
+Exit:
+
+    return;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // WDF Module Callbacks
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -411,6 +1136,8 @@ Return Value:
     DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
     DMF_CONFIG_Thread moduleConfigThread;
     DMF_CONFIG_BufferQueue moduleBufferQueueConfigList;
+    DMF_CONFIG_BufferPool moduleConfigBufferPool;
+    ULONG workerIndex;
 
     PAGED_CODE();
 
@@ -419,6 +1146,22 @@ Return Value:
     moduleConfig = DMF_CONFIG_GET(DmfModule);
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    // Exactly one of the work callbacks must be set.
+    //
+    DmfAssert((moduleConfig->EvtThreadedBufferQueueWork != NULL) != (moduleConfig->EvtThreadedBufferQueueWorkBatch != NULL));
+    DmfAssert(moduleConfig->WorkBatchSize <= ThreadedBufferQueue_WorkBatchSizeMaximum);
+    DmfAssert(moduleConfig->NumberOfWorkerThreads <= ThreadedBufferQueue_WorkerThreadsMaximum);
+
+    moduleContext->NumberOfWorkers = moduleConfig->NumberOfWorkerThreads;
+    if (0 == moduleContext->NumberOfWorkers)
+    {
+        moduleContext->NumberOfWorkers = 1;
+    }
+    else if (moduleContext->NumberOfWorkers > ThreadedBufferQueue_WorkerThreadsMaximum)
+    {
+        moduleContext->NumberOfWorkers = ThreadedBufferQueue_WorkerThreadsMaximum;
+    }
+
     // DmfModuleBufferQueue
     // --------------------
     //
@@ -434,19 +1177,46 @@ Return Value:
                      WDF_NO_OBJECT_ATTRIBUTES,
                      &moduleContext->DmfModuleBufferQueue);
 
-    // DmfModuleThread
-    // ---------------
-    //
-    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
-                                          &moduleAttributes);
-    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
-    moduleConfigThread.ThreadControl.DmfControl.EvtThreadPre = moduleConfig->EvtThreadedBufferQueuePre;
-    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = ThreadedBufferQueueThreadCallback;
-    moduleConfigThread.ThreadControl.DmfControl.EvtThreadPost = moduleConfig->EvtThreadedBufferQueuePost;
-    DMF_DmfModuleAdd(DmfModuleInit,
-                     &moduleAttributes,
-                     WDF_NO_OBJECT_ATTRIBUTES,
-                     &moduleContext->DmfModuleThread);
+    for (workerIndex = 0; workerIndex < moduleContext->NumberOfWorkers; workerIndex++)
+    {
+        // DmfModuleThread
+        // ---------------
+        //
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        if (moduleConfig->WorkerThreadAffinity[workerIndex] != 0)
+        {
+            moduleConfigThread.ThreadControl.DmfControl.EvtThreadPre = ThreadedBufferQueueThreadPreCallback;
+            moduleConfigThread.ThreadControl.DmfControl.EvtThreadPost = ThreadedBufferQueueThreadPostCallback;
+        }
+        else
+        {
+            moduleConfigThread.ThreadControl.DmfControl.EvtThreadPre = moduleConfig->EvtThreadedBufferQueuePre;
+            moduleConfigThread.ThreadControl.DmfControl.EvtThreadPost = moduleConfig->EvtThreadedBufferQueuePost;
+        }
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = ThreadedBufferQueueThreadCallback;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->Workers[workerIndex].DmfModuleThread);
+
+        if (moduleContext->NumberOfWorkers > 1)
+        {
+            // DmfModuleBufferPoolKeyed
+            // ------------------------
+            //
+            DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigBufferPool,
+                                                      &moduleAttributes);
+            moduleConfigBufferPool.BufferPoolMode = BufferPool_Mode_Sink;
+            moduleAttributes.ClientModuleInstanceName = "BufferPoolKeyed";
+            moduleAttributes.PassiveLevel = DmfParentModuleAttributes->PassiveLevel;
+            DMF_DmfModuleAdd(DmfModuleInit,
+                             &moduleAttributes,
+                             WDF_NO_OBJECT_ATTRIBUTES,
+                             &moduleContext->Workers[workerIndex].DmfModuleBufferPoolKeyed);
+        }
+    }
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -477,6 +1247,7 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+    ULONG workerIndex;
 
     PAGED_CODE();
 
@@ -484,9 +1255,12 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    // In case, Client has not explicitly stopped the thread, do that now.
+    // In case, Client has not explicitly stopped the threads, do that now.
     //
-    DMF_Thread_Stop(moduleContext->DmfModuleThread);
+    for (workerIndex = 0; workerIndex < moduleContext->NumberOfWorkers; workerIndex++)
+    {
+        DMF_Thread_Stop(moduleContext->Workers[workerIndex].DmfModuleThread);
+    }
 
     // This causes the Client's clean up callback to be called in case the Client
     // referenced or allocated objects associated with the buffers.
@@ -580,7 +1354,7 @@ DMF_ThreadedBufferQueue_Count(
 
 Routine Description:
 
-    Return the number of entries currently in the list.
+    Return the number of entries currently in the Consumer list.
 
 Arguments:
 
@@ -588,7 +1362,7 @@ Arguments:
 
 Return Value:
 
-    None
+    Number of entries currently in the Consumer list.
 
 --*/
 {
@@ -602,6 +1376,9 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    // Work enqueued with a key waits in the list of the worker its key maps to. It is not
+    // in the Consumer list so it is not counted.
+    //
     numberOfEntriesInList = DMF_BufferQueue_Count(moduleContext->DmfModuleBufferQueue);
 
     FuncExit(DMF_TRACE, "numberOfEntriesInList=%d", numberOfEntriesInList);
@@ -646,8 +1423,7 @@ Return Value:
 
     workBuffer = ThreadedBufferQueueBuffer_ClientToInternal(ClientBuffer);
 
-    workBuffer->Event = NULL;
-    workBuffer->NtStatus = NULL;
+    workBuffer->WaitBlock = NULL;
 
     DMF_BufferQueue_Enqueue(moduleContext->DmfModuleBufferQueue,
                             workBuffer);
@@ -694,8 +1470,7 @@ Return Value:
 
     workBuffer = ThreadedBufferQueueBuffer_ClientToInternal(ClientBuffer);
 
-    workBuffer->Event = NULL;
-    workBuffer->NtStatus = NULL;
+    workBuffer->WaitBlock = NULL;
 
     DMF_BufferQueue_EnqueueAtHead(moduleContext->DmfModuleBufferQueue,
                                   workBuffer);
@@ -735,8 +1510,8 @@ Return Value:
 {
     DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
     ThreadedBufferQueue_WorkBufferInternal* workBuffer;
+    ThreadedBufferQueue_WaitBlock waitBlock;
     NTSTATUS ntStatus;
-    DMF_PORTABLE_EVENT event;
 
     PAGED_CODE();
 
@@ -747,29 +1522,19 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DMF_Portable_EventCreate(&event,
-                             NotificationEvent,
-                             FALSE);
-
     workBuffer = ThreadedBufferQueueBuffer_ClientToInternal(ClientBuffer);
 
-    workBuffer->Event = &event;
-    workBuffer->NtStatus = &ntStatus;
+    ThreadedBufferQueue_WaitPrepare(workBuffer,
+                                    &waitBlock);
 
     DMF_BufferQueue_Enqueue(moduleContext->DmfModuleBufferQueue,
                             workBuffer);
 
     ThreadedBufferQueue_WorkReady(DmfModule);
 
-    // Infinite wait for the work to execute.
-    //
-    DMF_Portable_EventWaitForSingleObject(&event,
-                                          NULL,
-                                          FALSE);
-
-    // NOTE: Needed to prevent leak in User-mode. NOP in Kernel-mode.
-    //
-    DMF_Portable_EventClose(&event);
+    ntStatus = ThreadedBufferQueue_WaitForCompletion(DmfModule,
+                                                     workBuffer,
+                                                     &waitBlock);
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
@@ -807,8 +1572,8 @@ Return Value:
 {
     DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
     ThreadedBufferQueue_WorkBufferInternal* workBuffer;
+    ThreadedBufferQueue_WaitBlock waitBlock;
     NTSTATUS ntStatus;
-    DMF_PORTABLE_EVENT event;
 
     PAGED_CODE();
 
@@ -819,29 +1584,239 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DMF_Portable_EventCreate(&event,
-                             NotificationEvent,
-                             FALSE);
-
     workBuffer = ThreadedBufferQueueBuffer_ClientToInternal(ClientBuffer);
 
-    workBuffer->Event = &event;
-    workBuffer->NtStatus = &ntStatus;
+    ThreadedBufferQueue_WaitPrepare(workBuffer,
+                                    &waitBlock);
 
     DMF_BufferQueue_EnqueueAtHead(moduleContext->DmfModuleBufferQueue,
                                   workBuffer);
 
     ThreadedBufferQueue_WorkReady(DmfModule);
 
-    // Infinite wait for the work to execute.
-    //
-    DMF_Portable_EventWaitForSingleObject(&event,
-                                          NULL,
-                                          FALSE);
+    ntStatus = ThreadedBufferQueue_WaitForCompletion(DmfModule,
+                                                     workBuffer,
+                                                     &waitBlock);
 
-    // NOTE: Needed to prevent leak in User-mode. NOP in Kernel-mode.
-    //
-    DMF_Portable_EventClose(&event);
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_ThreadedBufferQueue_EnqueueWithKey(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG_PTR Key
+    )
+/*++
+
+Routine Description:
+
+    Adds a Client Buffer to the end of the list of the worker that the given key maps to and
+    sets that worker's work ready event. Work with the same key is done in FIFO order.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The buffer to add to the list.
+                   NOTE: This must be a properly formed buffer that was created by this Module.
+    Key - Client defined key of the work (for example, the address of the object the work applies to).
+
+Return Value:
+
+    None
+
+--*/
+{
+    ThreadedBufferQueue_WorkBufferInternal* workBuffer;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 ThreadedBufferQueue);
+
+    workBuffer = ThreadedBufferQueueBuffer_ClientToInternal(ClientBuffer);
+
+    workBuffer->WaitBlock = NULL;
+
+    ThreadedBufferQueue_KeyedEnqueue(DmfModule,
+                                     workBuffer,
+                                     Key);
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_ThreadedBufferQueue_EnqueueWithKeyAndWait(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG_PTR Key
+    )
+/*++
+
+Routine Description:
+
+    Adds a Client Buffer to the end of the list of the worker that the given key maps to and
+    sets that worker's work ready event. Then, waits for the work to be completed and returns
+    the NTSTATUS of that deferred work.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The buffer to add to the list.
+                   NOTE: This must be a properly formed buffer that was created by this Module.
+    Key - Client defined key of the work (for example, the address of the object the work applies to).
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    ThreadedBufferQueue_WorkBufferInternal* workBuffer;
+    ThreadedBufferQueue_WaitBlock waitBlock;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 ThreadedBufferQueue);
+
+    workBuffer = ThreadedBufferQueueBuffer_ClientToInternal(ClientBuffer);
+
+    ThreadedBufferQueue_WaitPrepare(workBuffer,
+                                    &waitBlock);
+
+    ThreadedBufferQueue_KeyedEnqueue(DmfModule,
+                                     workBuffer,
+                                     Key);
+
+    ntStatus = ThreadedBufferQueue_WaitForCompletion(DmfModule,
+                                                     workBuffer,
+                                                     &waitBlock);
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_ThreadedBufferQueue_EnqueueWithPriority(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG Priority
+    )
+/*++
+
+Routine Description:
+
+    Adds a Client Buffer to the end of the list of the given priority level and sets the
+    work ready event. The work callback receives buffers of higher priority levels first.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The buffer to add to the list.
+                   NOTE: This must be a properly formed buffer that was created by this Module.
+    Priority - The priority level of the buffer (less than BufferQueueConfig.NumberOfPriorityLevels).
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+    ThreadedBufferQueue_WorkBufferInternal* workBuffer;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 ThreadedBufferQueue);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    workBuffer = ThreadedBufferQueueBuffer_ClientToInternal(ClientBuffer);
+
+    workBuffer->WaitBlock = NULL;
+
+    DMF_BufferQueue_EnqueueWithPriority(moduleContext->DmfModuleBufferQueue,
+                                        workBuffer,
+                                        Priority);
+
+    ThreadedBufferQueue_WorkReady(DmfModule);
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_ThreadedBufferQueue_EnqueueWithPriorityAndWait(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG Priority
+    )
+/*++
+
+Routine Description:
+
+    Adds a Client Buffer to the end of the list of the given priority level and sets the
+    work ready event. Then, waits for the work to be completed and returns the NTSTATUS
+    of that deferred work.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The buffer to add to the list.
+                   NOTE: This must be a properly formed buffer that was created by this Module.
+    Priority - The priority level of the buffer (less than BufferQueueConfig.NumberOfPriorityLevels).
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+    ThreadedBufferQueue_WorkBufferInternal* workBuffer;
+    ThreadedBufferQueue_WaitBlock waitBlock;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 ThreadedBufferQueue);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    workBuffer = ThreadedBufferQueueBuffer_ClientToInternal(ClientBuffer);
+
+    ThreadedBufferQueue_WaitPrepare(workBuffer,
+                                    &waitBlock);
+
+    DMF_BufferQueue_EnqueueWithPriority(moduleContext->DmfModuleBufferQueue,
+                                        workBuffer,
+                                        Priority);
+
+    ThreadedBufferQueue_WorkReady(DmfModule);
+
+    ntStatus = ThreadedBufferQueue_WaitForCompletion(DmfModule,
+                                                     workBuffer,
+                                                     &waitBlock);
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
@@ -930,8 +1905,9 @@ Return Value:
 {
     DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
     NTSTATUS ntStatus;
-    VOID* bufferContext;
-    ThreadedBufferQueue_WorkBufferInternal* workBuffer;
+    VOID* workBuffers[ThreadedBufferQueue_FlushBatchSize];
+    ULONG numberOfWorkBuffers;
+    ULONG workerIndex;
 
     FuncEntry(DMF_TRACE);
 
@@ -940,22 +1916,67 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    // Get pending work buffers from Consumer List, set optional status and events, and return 
+    // Get pending work buffers that were enqueued with a key in batches, set optional status
+    // and events, and return buffers to the Producer List.
+    //
+    for (workerIndex = 0; workerIndex < moduleContext->NumberOfWorkers; workerIndex++)
+    {
+        if (NULL == moduleContext->Workers[workerIndex].DmfModuleBufferPoolKeyed)
+        {
+            continue;
+        }
+
+        ntStatus = STATUS_SUCCESS;
+        while (NT_SUCCESS(ntStatus))
+        {
+            ntStatus = DMF_BufferPool_GetMultiple(moduleContext->Workers[workerIndex].DmfModuleBufferPoolKeyed,
+                                                  ARRAYSIZE(workBuffers),
+                                                  workBuffers,
+                                                  NULL,
+                                                  &numberOfWorkBuffers);
+            if (NT_SUCCESS(ntStatus))
+            {
+                // Tell callers no work was done and return the buffers to free queue.
+                //
+                numberOfWorkBuffers = ThreadedBufferQueue_WorkCompletedNotifyMultiple((ThreadedBufferQueue_WorkBufferInternal**)workBuffers,
+                                                                                      NULL,
+                                                                                      STATUS_CANCELLED,
+                                                                                      numberOfWorkBuffers);
+                if (numberOfWorkBuffers > 0)
+                {
+                    DMF_BufferQueue_ReuseMultiple(moduleContext->DmfModuleBufferQueue,
+                                                  workBuffers,
+                                                  numberOfWorkBuffers);
+                }
+            }
+        }
+    }
+
+    // Get pending work buffers from Consumer List in batches, set optional status and events, and return 
     // buffers to the Producer List.
     //
     ntStatus = STATUS_SUCCESS;
     while (NT_SUCCESS(ntStatus))
     {
-        ntStatus = DMF_BufferQueue_Dequeue(moduleContext->DmfModuleBufferQueue,
-                                           (VOID**)&workBuffer,
-                                           &bufferContext);
+        ntStatus = DMF_BufferQueue_DequeueMultiple(moduleContext->DmfModuleBufferQueue,
+                                                   ARRAYSIZE(workBuffers),
+                                                   workBuffers,
+                                                   NULL,
+                                                   &numberOfWorkBuffers);
         if (NT_SUCCESS(ntStatus))
         {
-            // Return to free queue and tell caller no work was done.
+            // Tell callers no work was done and return the buffers to free queue.
             //
-            ThreadedBufferQueue_WorkCompleted(DmfModule,
-                                              workBuffer,
-                                              STATUS_CANCELLED);
+            numberOfWorkBuffers = ThreadedBufferQueue_WorkCompletedNotifyMultiple((ThreadedBufferQueue_WorkBufferInternal**)workBuffers,
+                                                                                  NULL,
+                                                                                  STATUS_CANCELLED,
+                                                                                  numberOfWorkBuffers);
+            if (numberOfWorkBuffers > 0)
+            {
+                DMF_BufferQueue_ReuseMultiple(moduleContext->DmfModuleBufferQueue,
+                                              workBuffers,
+                                              numberOfWorkBuffers);
+            }
         }
     }
 
@@ -998,8 +2019,7 @@ Return Value:
 
     workBuffer = ThreadedBufferQueueBuffer_ClientToInternal(ClientBuffer);
 
-    workBuffer->Event = NULL;
-    workBuffer->NtStatus = NULL;
+    workBuffer->WaitBlock = NULL;
 
     DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueue,
                           workBuffer);
@@ -1018,7 +2038,7 @@ DMF_ThreadedBufferQueue_Start(
 
 Routine Description:
 
-    Starts the given Module's thread.
+    Starts the given Module's threads.
 
 Arguments:
 
@@ -1032,6 +2052,7 @@ Return Value:
 {
     DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
     NTSTATUS ntStatus;
+    ULONG workerIndex;
 
     PAGED_CODE();
 
@@ -1042,11 +2063,22 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread);
-    if (!NT_SUCCESS(ntStatus))
+    ntStatus = STATUS_SUCCESS;
+    for (workerIndex = 0; workerIndex < moduleContext->NumberOfWorkers; workerIndex++)
     {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Failed to start the thread. ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
+        ntStatus = DMF_Thread_Start(moduleContext->Workers[workerIndex].DmfModuleThread);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Failed to start the thread. workerIndex=%d ntStatus=%!STATUS!", workerIndex, ntStatus);
+            // Stop the threads that have been started.
+            //
+            while (workerIndex > 0)
+            {
+                workerIndex--;
+                DMF_Thread_Stop(moduleContext->Workers[workerIndex].DmfModuleThread);
+            }
+            goto Exit;
+        }
     }
 
 Exit:
@@ -1067,7 +2099,7 @@ DMF_ThreadedBufferQueue_Stop(
 
 Routine Description:
 
-    Stops the given Module's thread.
+    Stops the given Module's threads. Returns after all the threads have stopped.
 
 Arguments:
 
@@ -1080,6 +2112,7 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+    ULONG workerIndex;
 
     PAGED_CODE();
 
@@ -1090,7 +2123,12 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DMF_Thread_Stop(moduleContext->DmfModuleThread);
+    // Each call waits for the worker to finish the work it is doing.
+    //
+    for (workerIndex = 0; workerIndex < moduleContext->NumberOfWorkers; workerIndex++)
+    {
+        DMF_Thread_Stop(moduleContext->Workers[workerIndex].DmfModuleThread);
+    }
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -1137,5 +2175,68 @@ Return Value:
     FuncExitVoid(DMF_TRACE);
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_ThreadedBufferQueue_WorkCompletedMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfClientBuffers) VOID** ClientBuffers,
+    _In_reads_(NumberOfClientBuffers) NTSTATUS* NtStatuses,
+    _In_ ULONG NumberOfClientBuffers
+    )
+/*++
+
+Routine Description:
+
+    Allows the Client to complete work for several previously pended work buffers. The buffers
+    are returned to the Producer List in batches using a single acquisition of its lock per batch.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffers - Buffers that contain the work that was pended.
+    NtStatuses - Status indicating result of work for each buffer.
+    NumberOfClientBuffers - Number of buffers in ClientBuffers.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ThreadedBufferQueue_WorkBufferInternal* workBuffers[ThreadedBufferQueue_WorkBatchSizeMaximum];
+    ULONG numberOfWorkBuffers;
+    ULONG clientBufferIndex;
+    ULONG workBufferIndex;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 ThreadedBufferQueue);
+
+    clientBufferIndex = 0;
+    while (clientBufferIndex < NumberOfClientBuffers)
+    {
+        numberOfWorkBuffers = NumberOfClientBuffers - clientBufferIndex;
+        if (numberOfWorkBuffers > ARRAYSIZE(workBuffers))
+        {
+            numberOfWorkBuffers = ARRAYSIZE(workBuffers);
+        }
+
+        for (workBufferIndex = 0; workBufferIndex < numberOfWorkBuffers; workBufferIndex++)
+        {
+            workBuffers[workBufferIndex] = ThreadedBufferQueueBuffer_ClientToInternal(ClientBuffers[clientBufferIndex + workBufferIndex]);
+        }
+
+        ThreadedBufferQueue_WorkCompletedMultiple(DmfModule,
+                                                  workBuffers,
+                                                  &NtStatuses[clientBufferIndex],
+                                                  numberOfWorkBuffers);
+
+        clientBufferIndex += numberOfWorkBuffers;
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+
 // eof: Dmf_ThreadedBufferQueue.c
 //
@@ -48,6 +48,30 @@ EVT_DMF_ThreadedBufferQueue_Callback(_In_ DMFMODULE DmfModule,
                                      _In_ VOID* ClientWorkBufferContext,
                                      _Out_ NTSTATUS* NtStatus);
 
+// Maximum number of work buffers passed to EvtThreadedBufferQueueWorkBatch at a time.
+//
+#define ThreadedBufferQueue_WorkBatchSizeMaximum    32
+
+// Maximum number of worker threads.
+//
+#define ThreadedBufferQueue_WorkerThreadsMaximum    16
+
+// Client Driver callback function that does the work of several work buffers at a time.
+// The returned disposition applies to all the buffers.
+//
+typedef
+_Function_class_(EVT_DMF_ThreadedBufferQueue_BatchCallback)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_same_
+_Must_inspect_result_
+ThreadedBufferQueue_BufferDisposition
+EVT_DMF_ThreadedBufferQueue_BatchCallback(_In_ DMFMODULE DmfModule,
+                                          _In_reads_(NumberOfClientWorkBuffers) UCHAR** ClientWorkBuffers,
+                                          _In_reads_(NumberOfClientWorkBuffers) VOID** ClientWorkBufferContexts,
+                                          _In_ ULONG NumberOfClientWorkBuffers,
+                                          _In_ ULONG ClientWorkBufferSize,
+                                          _Out_writes_(NumberOfClientWorkBuffers) NTSTATUS* NtStatuses);
+
 // Callback called by DMF_ThreadedBufferQueue_Reuse so Client
 // can finalize buffers before being sent back to Producer.
 //
@@ -70,9 +94,18 @@ typedef struct
     // Optional callback that does work before looping.
     //
     EVT_DMF_Thread_Function* EvtThreadedBufferQueuePre;
-    // Mandatory callback that does work when work is ready.
+    // Callback that does work when work is ready.
+    // Either this callback or EvtThreadedBufferQueueWorkBatch must be set.
     //
     EVT_DMF_ThreadedBufferQueue_Callback* EvtThreadedBufferQueueWork;
+    // Callback that does work of up to WorkBatchSize work buffers at a time when work is ready.
+    // Either this callback or EvtThreadedBufferQueueWork must be set.
+    //
+    EVT_DMF_ThreadedBufferQueue_BatchCallback* EvtThreadedBufferQueueWorkBatch;
+    // Maximum number of work buffers passed to EvtThreadedBufferQueueWorkBatch at a time
+    // (at most ThreadedBufferQueue_WorkBatchSizeMaximum). Zero means ThreadedBufferQueue_WorkBatchSizeMaximum.
+    //
+    ULONG WorkBatchSize;
     // Optional callback that does work after looping but before thread ends.
     //
     EVT_DMF_Thread_Function* EvtThreadedBufferQueuePost;
@@ -80,6 +113,14 @@ typedef struct
     // buffer-attached resources.
     //
     EVT_DMF_ThreadedBufferQueue_ReuseCleanup* EvtThreadedBufferQueueReuseCleanup;
+    // Number of worker threads that do the work (at most ThreadedBufferQueue_WorkerThreadsMaximum).
+    // Zero means one worker thread.
+    //
+    ULONG NumberOfWorkerThreads;
+    // Optional processor affinity mask of each worker thread (processor group 0).
+    // Zero means the worker thread may run on any processor.
+    //
+    ULONG_PTR WorkerThreadAffinity[ThreadedBufferQueue_WorkerThreadsMaximum];
 } DMF_CONFIG_ThreadedBufferQueue;
 
 // This macro declares the following functions:
@@ -129,6 +170,40 @@ DMF_ThreadedBufferQueue_EnqueueAtHeadAndWait(
     _In_ VOID* ClientBuffer
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_ThreadedBufferQueue_EnqueueWithKey(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG_PTR Key
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_ThreadedBufferQueue_EnqueueWithKeyAndWait(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG_PTR Key
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_ThreadedBufferQueue_EnqueueWithPriority(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG Priority
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_ThreadedBufferQueue_EnqueueWithPriorityAndWait(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG Priority
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -172,5 +247,14 @@ DMF_ThreadedBufferQueue_WorkCompleted(
     _In_ NTSTATUS NtStatus
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_ThreadedBufferQueue_WorkCompletedMultiple(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfClientBuffers) VOID** ClientBuffers,
+    _In_reads_(NumberOfClientBuffers) NTSTATUS* NtStatuses,
+    _In_ ULONG NumberOfClientBuffers
+    );
+
 // eof: Dmf_ThreadedBufferQueue.h
 //
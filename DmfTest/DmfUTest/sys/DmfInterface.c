@@ -258,6 +258,24 @@ Return Value:
                      WDF_NO_OBJECT_ATTRIBUTES,
                      NULL);
 
+    // Tests_QueuedWorkItem
+    // --------------------
+    //
+    DMF_Tests_QueuedWorkItem_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     NULL);
+
+    // Tests_ThreadedBufferQueue
+    // -------------------------
+    //
+    DMF_Tests_ThreadedBufferQueue_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     NULL);
+
     if (isFunctionDriver)
     {
         // Tests_DefaultTarget